@@ -0,0 +1,763 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "acceptor.h"
+#include "connection.h"
+#include "log.h"
+#include "proc.h"
+
+#include <guacamole/error.h>
+#include <guacamole/mem.h>
+#include <guacamole/parser.h>
+#include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
+
+#ifdef ENABLE_SSL
+#include <openssl/ssl.h>
+#include <guacamole/socket-ssl.h>
+#endif
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <fcntl.h>
+#include <sys/epoll.h>
+#endif
+
+/**
+ * Sets TCP_NODELAY on the given newly-accepted connection, avoiding any
+ * latency that would otherwise be added by the OS' networking stack and
+ * Nagle's algorithm.
+ *
+ * @param fd
+ *     The file descriptor of the newly-accepted connection.
+ */
+static void guacd_acceptor_set_nodelay(int fd) {
+    const int SO_TRUE = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,
+            (const void*) &SO_TRUE, sizeof(SO_TRUE));
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+
+/**
+ * A connection that has been accepted, but whose handshake has not yet
+ * progressed far enough for the connection to be routed.
+ */
+typedef struct guacd_handshake guacd_handshake;
+
+struct guacd_handshake {
+
+    /**
+     * The file descriptor of the connection.
+     */
+    int fd;
+
+    /**
+     * The time by which the handshake must be complete, up to and including
+     * the "select" instruction, before the connection is closed.
+     */
+    guac_timestamp deadline;
+
+#ifdef ENABLE_SSL
+    /**
+     * The SSL/TLS session of the connection, if its SSL/TLS handshake is
+     * still in progress. Once the SSL/TLS handshake has completed, the
+     * session is owned by the guac_socket and this will be NULL.
+     */
+    SSL* ssl;
+#endif
+
+    /**
+     * The guac_socket for the connection, or NULL if no data has yet been
+     * read or the SSL/TLS handshake of the connection is still in progress.
+     */
+    guac_socket* socket;
+
+    /**
+     * The guac_parser reading the "select" instruction, or NULL if no data
+     * has yet been read.
+     */
+    guac_parser* parser;
+
+    /**
+     * The handshake of the connection accepted immediately before this
+     * connection, or NULL if this is the oldest handshake in progress.
+     */
+    guacd_handshake* prev;
+
+    /**
+     * The handshake of the connection accepted immediately after this
+     * connection, or NULL if this is the newest handshake in progress.
+     */
+    guacd_handshake* next;
+
+};
+
+/**
+ * A single acceptor thread, accepting connections on its own listening
+ * socket (or a listening socket shared with all other acceptor threads) and
+ * handling the handshakes of those connections.
+ */
+typedef struct guacd_acceptor_worker {
+
+    /**
+     * The guacd_acceptor that this thread is accepting connections for.
+     */
+    guacd_acceptor* acceptor;
+
+    /**
+     * The thread accepting connections.
+     */
+    pthread_t thread;
+
+    /**
+     * The file descriptor of the epoll instance used by this thread.
+     */
+    int epoll_fd;
+
+    /**
+     * The file descriptor of the listening socket that this thread accepts
+     * connections from.
+     */
+    int listen_fd;
+
+    /**
+     * All handshakes in progress, oldest first. As every connection is given
+     * the same amount of time to complete its handshake, this is also the
+     * order that those handshakes will time out.
+     */
+    guacd_handshake* oldest;
+
+    /**
+     * The most recently-accepted connection whose handshake is in progress.
+     */
+    guacd_handshake* newest;
+
+    /**
+     * The number of handshakes in progress.
+     */
+    int pending;
+
+} guacd_acceptor_worker;
+
+/**
+ * Creates an additional listening socket bound to the same address as the
+ * original listening socket of the given guacd_acceptor, relying on
+ * SO_REUSEPORT to allow the kernel to distribute incoming connections between
+ * the sockets.
+ *
+ * @param acceptor
+ *     The guacd_acceptor whose listening socket should be duplicated.
+ *
+ * @return
+ *     The file descriptor of the new listening socket, or -1 if an additional
+ *     listening socket cannot be created.
+ */
+static int guacd_acceptor_listen(guacd_acceptor* acceptor) {
+
+#ifdef SO_REUSEPORT
+
+    int opt_on = 1;
+
+    int fd = socket(acceptor->address.ss_family, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (void*) &opt_on, sizeof(opt_on))
+            || setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (void*) &opt_on, sizeof(opt_on))
+            || bind(fd, (struct sockaddr*) &acceptor->address, acceptor->address_length)
+            || listen(fd, SOMAXCONN)) {
+        guacd_log(GUAC_LOG_DEBUG, "Unable to create additional listening "
+                "socket: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+
+#else
+    return -1;
+#endif
+
+}
+
+/**
+ * Sets or clears O_NONBLOCK on the given file descriptor.
+ *
+ * @param fd
+ *     The file descriptor to modify.
+ *
+ * @param nonblocking
+ *     Non-zero if the file descriptor should be non-blocking, zero if the
+ *     file descriptor should be blocking.
+ */
+static void guacd_acceptor_set_nonblocking(int fd, int nonblocking) {
+
+    int flags = fcntl(fd, F_GETFL);
+    if (nonblocking)
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    else
+        fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+
+}
+
+/**
+ * Removes the given handshake from the list of handshakes in progress and
+ * from the epoll instance of the given acceptor thread. The connection
+ * itself is left untouched.
+ *
+ * @param worker
+ *     The acceptor thread handling the handshake.
+ *
+ * @param handshake
+ *     The handshake to remove.
+ */
+static void guacd_handshake_remove(guacd_acceptor_worker* worker,
+        guacd_handshake* handshake) {
+
+    if (handshake->prev != NULL)
+        handshake->prev->next = handshake->next;
+    else
+        worker->oldest = handshake->next;
+
+    if (handshake->next != NULL)
+        handshake->next->prev = handshake->prev;
+    else
+        worker->newest = handshake->prev;
+
+    worker->pending--;
+
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, handshake->fd, NULL);
+
+}
+
+/**
+ * Abandons the given handshake, closing its connection and freeing all
+ * associated resources.
+ *
+ * @param worker
+ *     The acceptor thread handling the handshake.
+ *
+ * @param handshake
+ *     The handshake to abandon.
+ */
+static void guacd_handshake_free(guacd_acceptor_worker* worker,
+        guacd_handshake* handshake) {
+
+    guacd_handshake_remove(worker, handshake);
+
+    if (handshake->parser != NULL)
+        guac_parser_free(handshake->parser);
+
+    /* Freeing the guac_socket closes the connection */
+    if (handshake->socket != NULL)
+        guac_socket_free(handshake->socket);
+
+    else {
+#ifdef ENABLE_SSL
+        if (handshake->ssl != NULL)
+            SSL_free(handshake->ssl);
+#endif
+        close(handshake->fd);
+    }
+
+    guac_mem_free(handshake);
+
+}
+
+/**
+ * Changes the events that the given acceptor thread will wait for on the
+ * connection of the given handshake.
+ *
+ * @param worker
+ *     The acceptor thread handling the handshake.
+ *
+ * @param handshake
+ *     The handshake whose connection is being waited upon.
+ *
+ * @param events
+ *     The epoll events to wait for, such as EPOLLIN.
+ */
+static void guacd_handshake_wait(guacd_acceptor_worker* worker,
+        guacd_handshake* handshake, uint32_t events) {
+
+    struct epoll_event event = {
+        .events = events,
+        .data.ptr = handshake
+    };
+
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_MOD, handshake->fd, &event);
+
+}
+
+/**
+ * Hands the connection of the given handshake, whose "select" instruction
+ * has been received, to a new connection thread for routing. The handshake
+ * is freed, but its guac_socket and guac_parser become the responsibility of
+ * the new thread.
+ *
+ * @param worker
+ *     The acceptor thread handling the handshake.
+ *
+ * @param handshake
+ *     The handshake whose "select" instruction has been received.
+ */
+static void guacd_handshake_route(guacd_acceptor_worker* worker,
+        guacd_handshake* handshake) {
+
+    guacd_acceptor* acceptor = worker->acceptor;
+
+    guacd_handshake_remove(worker, handshake);
+
+    /* All further I/O for the connection, whether by proxy threads or by the
+     * process it is handed to, is blocking */
+    guacd_acceptor_set_nonblocking(handshake->fd, 0);
+
+    guacd_connection_route_thread_params* params =
+        guac_mem_alloc(sizeof(guacd_connection_route_thread_params));
+
+    params->map = acceptor->map;
+    params->pool = acceptor->pool;
+    params->socket = handshake->socket;
+    params->parser = handshake->parser;
+
+    pthread_t route_thread;
+    if (pthread_create(&route_thread, NULL, guacd_connection_route_thread,
+                params)) {
+        guacd_log(GUAC_LOG_ERROR, "Could not create connection thread.");
+        guac_parser_free(handshake->parser);
+        guac_socket_free(handshake->socket);
+        guac_mem_free(params);
+    }
+    else
+        pthread_detach(route_thread);
+
+    guac_mem_free(handshake);
+
+}
+
+/**
+ * Advances the handshake of the given connection as far as possible without
+ * blocking, routing the connection if its "select" instruction has been
+ * received and abandoning the connection if the handshake has failed.
+ *
+ * @param worker
+ *     The acceptor thread handling the handshake.
+ *
+ * @param handshake
+ *     The handshake to advance.
+ */
+static void guacd_handshake_continue(guacd_acceptor_worker* worker,
+        guacd_handshake* handshake) {
+
+#ifdef ENABLE_SSL
+
+    /* Continue SSL/TLS handshake until complete */
+    if (handshake->ssl != NULL) {
+
+        int retval = SSL_accept(handshake->ssl);
+        if (retval <= 0) {
+
+            int error = SSL_get_error(handshake->ssl, retval);
+            if (error == SSL_ERROR_WANT_READ) {
+                guacd_handshake_wait(worker, handshake, EPOLLIN);
+                return;
+            }
+
+            if (error == SSL_ERROR_WANT_WRITE) {
+                guacd_handshake_wait(worker, handshake, EPOLLOUT);
+                return;
+            }
+
+            guacd_log(GUAC_LOG_ERROR, "Unable to set up SSL/TLS: SSL accept "
+                    "failed");
+            guacd_handshake_free(worker, handshake);
+            return;
+
+        }
+
+        /* Any further data will be read through the guac_socket, which now
+         * owns the SSL/TLS session */
+        handshake->socket = guac_socket_open_secure_session(handshake->ssl);
+        handshake->ssl = NULL;
+        guacd_handshake_wait(worker, handshake, EPOLLIN);
+
+    }
+
+#endif
+
+    /* Buffer space is allocated only once the client has sent something */
+    if (handshake->socket == NULL)
+        handshake->socket = guac_socket_open(handshake->fd);
+
+    if (handshake->parser == NULL)
+        handshake->parser = guac_parser_alloc();
+
+    /* Reset guac_error */
+    guac_error = GUAC_STATUS_SUCCESS;
+    guac_error_message = NULL;
+
+    /* Parse as much of the "select" instruction as has been received */
+    if (guac_parser_expect(handshake->parser, handshake->socket, 0, "select")) {
+
+        /* Continue waiting if the instruction is merely incomplete */
+        if (guac_error == GUAC_STATUS_TIMEOUT
+                || (guac_error == GUAC_STATUS_SEE_ERRNO
+                    && (errno == EAGAIN || errno == EWOULDBLOCK)))
+            return;
+
+        /* Log error */
+        guacd_log_handshake_failure();
+        guacd_log_guac_error(GUAC_LOG_DEBUG,
+                "Error reading \"select\"");
+
+        guacd_handshake_free(worker, handshake);
+        return;
+
+    }
+
+    guacd_handshake_route(worker, handshake);
+
+}
+
+/**
+ * Accepts all connections currently pending on the listening socket of the
+ * given acceptor thread, beginning the handshake of each.
+ *
+ * @param worker
+ *     The acceptor thread that should accept connections.
+ */
+static void guacd_acceptor_accept(guacd_acceptor_worker* worker) {
+
+    guacd_acceptor* acceptor = worker->acceptor;
+
+    for (;;) {
+
+        int fd = accept(worker->listen_fd, NULL, NULL);
+        if (fd < 0) {
+
+            /* Stop once no further connections are pending, including when
+             * another thread sharing the same socket accepted them first */
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR
+                    && errno != ECONNABORTED)
+                guacd_log(GUAC_LOG_ERROR, "Could not accept client "
+                        "connection: %s", strerror(errno));
+
+            if (errno == ECONNABORTED)
+                continue;
+
+            return;
+
+        }
+
+        guacd_acceptor_set_nodelay(fd);
+        guacd_acceptor_set_nonblocking(fd, 1);
+
+        guacd_handshake* handshake = guac_mem_zalloc(sizeof(guacd_handshake));
+        handshake->fd = fd;
+        handshake->deadline = guac_timestamp_current() + GUACD_TIMEOUT;
+
+#ifdef ENABLE_SSL
+        /* If SSL chosen, use it */
+        if (acceptor->ssl_context != NULL) {
+
+            handshake->ssl = SSL_new(acceptor->ssl_context);
+            if (handshake->ssl == NULL) {
+                guacd_log(GUAC_LOG_ERROR, "Unable to set up SSL/TLS");
+                close(fd);
+                guac_mem_free(handshake);
+                continue;
+            }
+
+            SSL_set_fd(handshake->ssl, fd);
+
+        }
+#endif
+
+        struct epoll_event event = {
+            .events = EPOLLIN,
+            .data.ptr = handshake
+        };
+
+        if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, fd, &event)) {
+            guacd_log(GUAC_LOG_ERROR, "Unable to wait for data from client "
+                    "connection: %s", strerror(errno));
+#ifdef ENABLE_SSL
+            if (handshake->ssl != NULL)
+                SSL_free(handshake->ssl);
+#endif
+            close(fd);
+            guac_mem_free(handshake);
+            continue;
+        }
+
+        /* Newly-accepted connections always have the latest deadline */
+        handshake->prev = worker->newest;
+        if (worker->newest != NULL)
+            worker->newest->next = handshake;
+        else
+            worker->oldest = handshake;
+
+        worker->newest = handshake;
+        worker->pending++;
+
+    }
+
+}
+
+/**
+ * Closes the connections of all handshakes that have not completed in time,
+ * as well as the oldest handshakes in excess of
+ * GUACD_ACCEPTOR_MAX_HANDSHAKES.
+ *
+ * @param worker
+ *     The acceptor thread whose handshakes should be checked.
+ */
+static void guacd_acceptor_expire(guacd_acceptor_worker* worker) {
+
+    guac_timestamp now = guac_timestamp_current();
+
+    while (worker->oldest != NULL) {
+
+        if (worker->pending > GUACD_ACCEPTOR_MAX_HANDSHAKES)
+            guacd_log(GUAC_LOG_WARNING, "Too many connections are awaiting "
+                    "their handshake. Closing oldest connection.");
+
+        else if (worker->oldest->deadline <= now) {
+            guac_error = GUAC_STATUS_TIMEOUT;
+            guac_error_message = "Timeout while waiting for \"select\"";
+            guacd_log_handshake_failure();
+        }
+
+        else
+            break;
+
+        guacd_handshake_free(worker, worker->oldest);
+
+    }
+
+}
+
+/**
+ * Accepts connections and advances their handshakes until guacd is shutting
+ * down.
+ *
+ * @param data
+ *     A pointer to the guacd_acceptor_worker representing the current thread.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacd_acceptor_worker_thread(void* data) {
+
+    guacd_acceptor_worker* worker = (guacd_acceptor_worker*) data;
+    struct epoll_event events[GUACD_ACCEPTOR_MAX_EVENTS];
+
+    while (!*worker->acceptor->stop) {
+
+        /* Wake in time to close the oldest connection if its handshake does
+         * not complete */
+        int timeout = GUACD_ACCEPTOR_POLL_INTERVAL;
+        if (worker->oldest != NULL) {
+            guac_timestamp remaining = worker->oldest->deadline
+                - guac_timestamp_current();
+            if (remaining < timeout)
+                timeout = remaining > 0 ? remaining : 0;
+        }
+
+        int count = epoll_wait(worker->epoll_fd, events,
+                GUACD_ACCEPTOR_MAX_EVENTS, timeout);
+
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            guacd_log(GUAC_LOG_ERROR, "Unable to wait for client "
+                    "connections: %s", strerror(errno));
+            break;
+        }
+
+        /* NOTE: Handlers may free only the handshake they were invoked for,
+         * as other events within the same batch may refer to any other
+         * handshake */
+        for (int i = 0; i < count; i++) {
+
+            guacd_handshake* handshake = events[i].data.ptr;
+
+            /* The listening socket is the only file descriptor without an
+             * associated handshake */
+            if (handshake == NULL)
+                guacd_acceptor_accept(worker);
+            else
+                guacd_handshake_continue(worker, handshake);
+
+        }
+
+        guacd_acceptor_expire(worker);
+
+    }
+
+    /* Abandon all handshakes still in progress */
+    while (worker->oldest != NULL)
+        guacd_handshake_free(worker, worker->oldest);
+
+    return NULL;
+
+}
+
+void guacd_acceptor_run(guacd_acceptor* acceptor) {
+
+    guacd_acceptor_worker workers[GUACD_ACCEPTOR_MAX_THREADS];
+
+    /* One thread per processor, within reason */
+    long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (thread_count < 1)
+        thread_count = 1;
+    else if (thread_count > GUACD_ACCEPTOR_MAX_THREADS)
+        thread_count = GUACD_ACCEPTOR_MAX_THREADS;
+
+    guacd_acceptor_set_nonblocking(acceptor->socket_fd, 1);
+
+    int started = 0;
+    int listeners = 1;
+    for (int i = 0; i < thread_count; i++) {
+
+        guacd_acceptor_worker* worker = &workers[i];
+        worker->acceptor = acceptor;
+        worker->oldest = NULL;
+        worker->newest = NULL;
+        worker->pending = 0;
+
+        worker->epoll_fd = epoll_create1(0);
+        if (worker->epoll_fd < 0) {
+            guacd_log(GUAC_LOG_ERROR, "Unable to create epoll instance: %s",
+                    strerror(errno));
+            break;
+        }
+
+        /* Give each thread its own listening socket if possible, falling
+         * back to sharing the original listening socket */
+        worker->listen_fd = (i == 0) ? -1 : guacd_acceptor_listen(acceptor);
+        if (worker->listen_fd != -1) {
+            guacd_acceptor_set_nonblocking(worker->listen_fd, 1);
+            listeners++;
+        }
+        else
+            worker->listen_fd = acceptor->socket_fd;
+
+        struct epoll_event event = {
+#ifdef EPOLLEXCLUSIVE
+            .events = EPOLLIN | EPOLLEXCLUSIVE,
+#else
+            .events = EPOLLIN,
+#endif
+            .data.ptr = NULL
+        };
+
+        if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->listen_fd, &event)
+                || pthread_create(&worker->thread, NULL,
+                    guacd_acceptor_worker_thread, worker)) {
+            guacd_log(GUAC_LOG_ERROR, "Unable to start acceptor thread.");
+            if (worker->listen_fd != acceptor->socket_fd)
+                close(worker->listen_fd);
+            close(worker->epoll_fd);
+            break;
+        }
+
+        started++;
+
+    }
+
+    guacd_log(GUAC_LOG_DEBUG, "Accepting connections using %i thread(s) and "
+            "%i listening socket(s).", started, listeners);
+
+    /* Wait for all threads to stop */
+    for (int i = 0; i < started; i++) {
+
+        guacd_acceptor_worker* worker = &workers[i];
+        pthread_join(worker->thread, NULL);
+
+        if (worker->listen_fd != acceptor->socket_fd)
+            close(worker->listen_fd);
+        close(worker->epoll_fd);
+
+    }
+
+}
+
+#else
+
+void guacd_acceptor_run(guacd_acceptor* acceptor) {
+
+    /* Client */
+    struct sockaddr_in client_addr;
+    socklen_t client_addr_len;
+    int connected_socket_fd;
+
+    while (!*acceptor->stop) {
+
+        pthread_t child_thread;
+
+        /* Accept connection */
+        client_addr_len = sizeof(client_addr);
+        connected_socket_fd = accept(acceptor->socket_fd,
+                (struct sockaddr*) &client_addr, &client_addr_len);
+
+        if (connected_socket_fd < 0) {
+            if (errno == EINTR)
+                guacd_log(GUAC_LOG_DEBUG, "Accepting of further client connection(s) interrupted by signal.");
+            else
+                guacd_log(GUAC_LOG_ERROR, "Could not accept client connection: %s", strerror(errno));
+            continue;
+        }
+
+        guacd_acceptor_set_nodelay(connected_socket_fd);
+
+        /* Create parameters for connection thread */
+        guacd_connection_thread_params* params = guac_mem_alloc(sizeof(guacd_connection_thread_params));
+        if (params == NULL) {
+            guacd_log(GUAC_LOG_ERROR, "Could not create connection thread: %s", strerror(errno));
+            continue;
+        }
+
+        params->map = acceptor->map;
+        params->pool = acceptor->pool;
+        params->connected_socket_fd = connected_socket_fd;
+
+#ifdef ENABLE_SSL
+        params->ssl_context = acceptor->ssl_context;
+#endif
+
+        /* Spawn thread to handle connection */
+        pthread_create(&child_thread, NULL, guacd_connection_thread, params);
+        pthread_detach(child_thread);
+
+    }
+
+}
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUACD_ACCEPTOR_H
+#define GUACD_ACCEPTOR_H
+
+#include "proc-map.h"
+#include "proc-pool.h"
+
+#include <sys/socket.h>
+
+#ifdef ENABLE_SSL
+#include <openssl/ssl.h>
+#endif
+
+/**
+ * The maximum number of threads that will accept connections and perform
+ * their handshakes. Each thread handles the handshakes of any number of
+ * connections concurrently, and a new thread is created for each connection
+ * only once its "select" instruction has been received.
+ */
+#define GUACD_ACCEPTOR_MAX_THREADS 8
+
+/**
+ * The maximum number of connections that each acceptor thread will allow to
+ * be awaiting completion of their handshake at any one time. If further
+ * connections are accepted, the connections that have been waiting longest
+ * are closed.
+ */
+#define GUACD_ACCEPTOR_MAX_HANDSHAKES 1024
+
+/**
+ * The maximum number of events that each acceptor thread will handle per
+ * call to epoll_wait().
+ */
+#define GUACD_ACCEPTOR_MAX_EVENTS 64
+
+/**
+ * The maximum number of milliseconds that an acceptor thread will wait for
+ * events before checking whether guacd is shutting down.
+ */
+#define GUACD_ACCEPTOR_POLL_INTERVAL 1000
+
+/**
+ * The listening socket of guacd, along with everything required to route
+ * the connections accepted on that socket.
+ */
+typedef struct guacd_acceptor {
+
+    /**
+     * The file descriptor of the socket that guacd is listening on.
+     */
+    int socket_fd;
+
+    /**
+     * The address that socket_fd is bound to. If SO_REUSEPORT was set on
+     * socket_fd prior to binding, additional sockets bound to this same
+     * address will be created such that each acceptor thread has its own
+     * listening socket.
+     */
+    struct sockaddr_storage address;
+
+    /**
+     * The length of address, in bytes.
+     */
+    socklen_t address_length;
+
+    /**
+     * The shared map of all connected clients.
+     */
+    guacd_proc_map* map;
+
+    /**
+     * The shared pool of pre-forked processes, or NULL if no processes are
+     * pre-forked.
+     */
+    guacd_proc_pool* pool;
+
+#ifdef ENABLE_SSL
+    /**
+     * SSL context for encrypted connections to guacd. If SSL is not active,
+     * this will be NULL.
+     */
+    SSL_CTX* ssl_context;
+#endif
+
+    /**
+     * Pointer to a flag that becomes non-zero when guacd should stop
+     * accepting connections.
+     */
+    const int* stop;
+
+} guacd_acceptor;
+
+/**
+ * Accepts connections on the socket of the given guacd_acceptor, routing
+ * each connection once its handshake has been received, until the stop flag
+ * of the guacd_acceptor becomes non-zero. Where epoll is available, the
+ * handshakes of all connections are handled by a small, fixed number of
+ * threads, with a new thread being created for each connection only once it
+ * has been routed. Otherwise, a new thread is created for each connection as
+ * soon as it is accepted.
+ *
+ * @param acceptor
+ *     The guacd_acceptor describing the listening socket and how its
+ *     connections should be routed.
+ */
+void guacd_acceptor_run(guacd_acceptor* acceptor);
+
+#endif
@@ -35,7 +35,7 @@ int guacd_conf_parse_args(guacd_config* config, int argc, char** argv) {
 
     /* Parse arguments */
     int opt;
-    while ((opt = getopt(argc, argv, "l:b:p:L:C:K:fv")) != -1) {
+    while ((opt = getopt(argc, argv, "l:b:p:L:P:C:K:Tfv")) != -1) {
 
         /* -l: Bind port */
         if (opt == 'l') {
@@ -79,6 +79,34 @@ int guacd_conf_parse_args(guacd_config* config, int argc, char** argv) {
 
         }
 
+        /* -P: Pre-forked processes, as PROTOCOL:COUNT */
+        else if (opt == 'P') {
+
+            char* protocol = guac_strdup(optarg);
+            char* separator = strchr(protocol, ':');
+
+            int size = -1;
+            if (separator != NULL) {
+                *separator = '\0';
+                size = guacd_parse_prefork_size(separator + 1);
+            }
+
+            if (size < 0 || *protocol == '\0') {
+                fprintf(stderr, "Invalid pre-forked process pool. Pools must be given as PROTOCOL:COUNT, where COUNT is between 0 and %i.\n", GUACD_PREFORK_MAX_SIZE);
+                guac_mem_free(protocol);
+                return 1;
+            }
+
+            if (guacd_conf_set_prefork(config, protocol, size)) {
+                fprintf(stderr, "Pre-forked processes may be configured for no more than %i protocols.\n", GUACD_PREFORK_MAX_PROTOCOLS);
+                guac_mem_free(protocol);
+                return 1;
+            }
+
+            guac_mem_free(protocol);
+
+        }
+
 #ifdef ENABLE_SSL
         /* -C SSL certificate */
         else if (opt == 'C') {
@@ -91,8 +119,13 @@ int guacd_conf_parse_args(guacd_config* config, int argc, char** argv) {
             guac_mem_free(config->key_file);
             config->key_file = guac_strdup(optarg);
         }
+
+        /* -T Kernel TLS */
+        else if (opt == 'T') {
+            config->kernel_tls = 1;
+        }
 #else
-        else if (opt == 'C' || opt == 'K') {
+        else if (opt == 'C' || opt == 'K' || opt == 'T') {
             fprintf(stderr,
                     "This guacd does not have SSL/TLS support compiled in.\n\n"
 
@@ -109,9 +142,11 @@ int guacd_conf_parse_args(guacd_config* config, int argc, char** argv) {
                     " [-b LISTENADDRESS]"
                     " [-p PIDFILE]"
                     " [-L LEVEL]"
+                    " [-P PROTOCOL:COUNT]"
 #ifdef ENABLE_SSL
                     " [-C CERTIFICATE_FILE]"
                     " [-K PEM_FILE]"
+                    " [-T]"
 #endif
                     " [-f]"
                     " [-v]\n", argv[0]);
@@ -93,6 +93,52 @@ static int guacd_conf_callback(const char* section, const char* param, const cha
 
     }
 
+    /* Number of pre-forked processes to keep ready for each protocol */
+    else if (strcmp(section, "prefork") == 0) {
+
+        int size = guacd_parse_prefork_size(value);
+
+        /* Invalid number of processes */
+        if (size < 0) {
+            guacd_conf_parse_error = "Invalid number of pre-forked processes. Values must be between 0 and 64.";
+            return 1;
+        }
+
+        if (guacd_conf_set_prefork(config, param, size)) {
+            guacd_conf_parse_error = "Pre-forked processes may be configured for no more than 16 protocols.";
+            return 1;
+        }
+
+        return 0;
+
+    }
+
+    /* Options related to the metrics exporter */
+    else if (strcmp(section, "metrics") == 0) {
+
+        /* Bind host */
+        if (strcmp(param, "bind_host") == 0) {
+            guac_mem_free(config->metrics_bind_host);
+            config->metrics_bind_host = guac_strdup(value);
+            return 0;
+        }
+
+        /* Bind port */
+        else if (strcmp(param, "bind_port") == 0) {
+            guac_mem_free(config->metrics_bind_port);
+            config->metrics_bind_port = guac_strdup(value);
+            return 0;
+        }
+
+        /* UNIX domain socket */
+        else if (strcmp(param, "socket") == 0) {
+            guac_mem_free(config->metrics_socket);
+            config->metrics_socket = guac_strdup(value);
+            return 0;
+        }
+
+    }
+
     /* SSL-specific options */
     else if (strcmp(section, "ssl") == 0) {
 #ifdef ENABLE_SSL
@@ -109,6 +155,20 @@ static int guacd_conf_callback(const char* section, const char* param, const cha
             config->key_file = guac_strdup(value);
             return 0;
         }
+
+        /* Kernel TLS */
+        else if (strcmp(param, "kernel_tls") == 0) {
+
+            int enabled = guacd_parse_boolean(value);
+            if (enabled == -1) {
+                guacd_conf_parse_error = "Invalid value for kernel_tls. Values must be \"true\" or \"false\".";
+                return 1;
+            }
+
+            config->kernel_tls = enabled;
+            return 0;
+
+        }
 #else
         guacd_conf_parse_error = "SSL support not compiled in";
         return 1;
@@ -184,10 +244,15 @@ guacd_config* guacd_conf_load(void) {
     conf->foreground = 0;
     conf->print_version = 0;
     conf->max_log_level = GUAC_LOG_INFO;
+    conf->prefork_protocols = 0;
+    conf->metrics_bind_host = guac_strdup(GUACD_DEFAULT_METRICS_BIND_HOST);
+    conf->metrics_bind_port = NULL;
+    conf->metrics_socket = NULL;
 
 #ifdef ENABLE_SSL
     conf->cert_file = NULL;
     conf->key_file = NULL;
+    conf->kernel_tls = 0;
 #endif
 
     /* Read configuration from file */
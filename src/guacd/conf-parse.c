@@ -23,8 +23,11 @@
 #include "conf-parse.h"
 
 #include <guacamole/client.h>
+#include <guacamole/mem.h>
+#include <guacamole/string.h>
 
 #include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
 /*
@@ -535,3 +538,48 @@ int guacd_parse_log_level(const char* name) {
 
 }
 
+
+int guacd_parse_prefork_size(const char* value) {
+
+    char* end;
+    long size = strtol(value, &end, 10);
+
+    /* The entire value must be a number within the allowed range */
+    if (*value == '\0' || *end != '\0' || size < 0
+            || size > GUACD_PREFORK_MAX_SIZE)
+        return -1;
+
+    return size;
+
+}
+
+int guacd_parse_boolean(const char* value) {
+
+    if (strcmp(value, "true")  == 0) return 1;
+    if (strcmp(value, "false") == 0) return 0;
+
+    /* Not a boolean value */
+    return -1;
+
+}
+
+int guacd_conf_set_prefork(guacd_config* config, const char* protocol, int size) {
+
+    /* Replace the size of any existing entry for the same protocol */
+    for (int i = 0; i < config->prefork_protocols; i++) {
+        if (strcmp(config->prefork[i].protocol, protocol) == 0) {
+            config->prefork[i].size = size;
+            return 0;
+        }
+    }
+
+    if (config->prefork_protocols == GUACD_PREFORK_MAX_PROTOCOLS)
+        return 1;
+
+    guacd_prefork_config* prefork = &config->prefork[config->prefork_protocols++];
+    prefork->protocol = guac_strdup(protocol);
+    prefork->size = size;
+
+    return 0;
+
+}
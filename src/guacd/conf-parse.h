@@ -20,6 +20,8 @@
 #ifndef _GUACD_CONF_PARSE_H
 #define _GUACD_CONF_PARSE_H
 
+#include "conf.h"
+
 /**
  * The maximum length of a name, in characters.
  */
@@ -53,6 +55,27 @@ int guacd_parse_conf(guacd_param_callback* callback, char* buffer, int length, v
  */
 int guacd_parse_log_level(const char* name);
 
+/**
+ * Parses the given number of pre-forked processes to keep ready for a
+ * protocol, returning that number, or -1 if the value is not a valid number
+ * of processes.
+ */
+int guacd_parse_prefork_size(const char* value);
+
+/**
+ * Parses the given boolean value, returning 1 for "true", 0 for "false", or
+ * -1 if the value is neither.
+ */
+int guacd_parse_boolean(const char* value);
+
+/**
+ * Sets the number of pre-forked processes that should be kept ready for the
+ * given protocol, replacing any number previously set for that protocol.
+ * Returns zero on success, or non-zero if pre-forked processes are already
+ * configured for the maximum number of protocols.
+ */
+int guacd_conf_set_prefork(guacd_config* config, const char* protocol, int size);
+
 /**
  * Human-readable description of the current error, if any.
  */
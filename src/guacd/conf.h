@@ -34,6 +34,42 @@
  */
 #define GUACD_DEFAULT_BIND_PORT "4822"
 
+/**
+ * The host that the metrics exporter should bind to if not otherwise
+ * specified.
+ */
+#define GUACD_DEFAULT_METRICS_BIND_HOST "localhost"
+
+/**
+ * The maximum number of distinct protocols for which guacd may maintain a
+ * pool of pre-forked processes.
+ */
+#define GUACD_PREFORK_MAX_PROTOCOLS 16
+
+/**
+ * The maximum number of pre-forked processes that guacd may maintain for any
+ * single protocol.
+ */
+#define GUACD_PREFORK_MAX_SIZE 64
+
+/**
+ * The number of pre-forked processes that should be kept ready for a
+ * particular protocol.
+ */
+typedef struct guacd_prefork_config {
+
+    /**
+     * The name of the protocol, as would be given in a "select" instruction.
+     */
+    char* protocol;
+
+    /**
+     * The number of processes that should be kept ready for the protocol.
+     */
+    int size;
+
+} guacd_prefork_config;
+
 /**
  * The contents of a guacd configuration file.
  */
@@ -74,6 +110,14 @@ typedef struct guacd_config {
      * SSL private key file.
      */
     char* key_file;
+
+    /**
+     * Whether the kernel should take over encryption of TLS 1.2 sessions
+     * once their handshakes complete (kernel TLS), allowing those
+     * connections to be passed directly to their processes rather than
+     * proxied. Disabled by default.
+     */
+    int kernel_tls;
 #endif
 
     /**
@@ -81,6 +125,35 @@ typedef struct guacd_config {
      */
     guac_client_log_level max_log_level;
 
+    /**
+     * The protocols for which pre-forked processes should be kept ready, and
+     * the number of processes to keep ready for each.
+     */
+    guacd_prefork_config prefork[GUACD_PREFORK_MAX_PROTOCOLS];
+
+    /**
+     * The number of entries within the prefork array.
+     */
+    int prefork_protocols;
+
+    /**
+     * The host that the metrics exporter should bind to.
+     */
+    char* metrics_bind_host;
+
+    /**
+     * The port that the metrics exporter should bind to, or NULL if metrics
+     * should not be exported via TCP.
+     */
+    char* metrics_bind_port;
+
+    /**
+     * The path of the UNIX domain socket that the metrics exporter should
+     * listen on, or NULL if metrics should not be exported via a UNIX domain
+     * socket.
+     */
+    char* metrics_socket;
+
 } guacd_config;
 
 #endif
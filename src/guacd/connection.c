@@ -21,16 +21,21 @@
 
 #include "connection.h"
 #include "log.h"
+#include "metrics.h"
 #include "move-fd.h"
 #include "proc.h"
 #include "proc-map.h"
+#include "proc-pool.h"
 
 #include <guacamole/client.h>
 #include <guacamole/error.h>
+#include <guacamole/mem.h>
 #include <guacamole/parser.h>
 #include <guacamole/plugin.h>
 #include <guacamole/protocol.h>
 #include <guacamole/socket.h>
+#include <guacamole/string.h>
+#include <guacamole/timestamp.h>
 #include <guacamole/user.h>
 
 #ifdef ENABLE_SSL
@@ -142,6 +147,7 @@ void* guacd_connection_io_thread(void* data) {
 
     /* Transfer data from file descriptor to socket */
     while ((length = read(params->fd, buffer, sizeof(buffer))) > 0) {
+
         if (guac_socket_write(params->socket, buffer, length))
             break;
         guac_socket_flush(params->socket);
@@ -161,9 +167,11 @@ void* guacd_connection_io_thread(void* data) {
 
 /**
  * Adds the given socket as a new user to the given process, automatically
- * reading/writing from the socket via read/write threads. The given socket,
- * parser, and any associated resources will be freed unless the user is not
- * added successfully.
+ * reading/writing from the socket via read/write threads. If the socket is an
+ * SSL/TLS socket whose encryption has been offloaded to the kernel, the
+ * underlying file descriptor is instead passed to the process directly. The
+ * given socket, parser, and any associated resources will be freed unless the
+ * user is not added successfully.
  *
  * If adding the user fails for any reason, non-zero is returned. Zero is
  * returned upon success.
@@ -179,10 +187,59 @@ void* guacd_connection_io_thread(void* data) {
  *     The socket associated with the user to be added to the existing
  *     process.
  *
+ * @param routed
+ *     The time at which the given process was selected for the user. This is
+ *     passed to the process along with the user's connection, such that the
+ *     process can report the time taken for the user to receive their first
+ *     frame.
+ *
+ * @param process_type
+ *     A human-readable description of how the given process was obtained,
+ *     for the sake of logging.
+ *
  * @return
  *     Zero if the user was added successfully, non-zero if an error occurred.
  */
-static int guacd_add_user(guacd_proc* proc, guac_parser* parser, guac_socket* socket) {
+static int guacd_add_user(guacd_proc* proc, guac_parser* parser,
+        guac_socket* socket, guac_timestamp routed, const char* process_type) {
+
+    /* Describe how the user was routed, for the process to report along with
+     * the time taken to receive the first frame */
+    guacd_fd_details details = { .routed = routed };
+    guac_strlcpy(details.process_type, process_type,
+            sizeof(details.process_type));
+
+#ifdef ENABLE_SSL
+    /* If kernel TLS was enabled (see the "kernel_tls" option), the kernel
+     * handles all encryption for the user's TLS 1.2 connection, and no part
+     * of the handshake remains buffered, the process can be given that
+     * connection directly rather than through a proxy. Nothing is lost by
+     * bypassing the proxy, as the process itself reports the time taken for
+     * the user to receive their first frame. Any alert received by the
+     * kernel (including close_notify) then fails the process' read() with
+     * EIO, which the process treats as the user disconnecting. If the kernel
+     * cannot handle the connection, it is proxied below as usual. */
+    int ktls_fd = guac_socket_ssl_get_ktls_fd(socket);
+    if (ktls_fd != -1 && guac_parser_length(parser) == 0) {
+
+        if (!guacd_send_fd(proc->fd_socket, ktls_fd, &details)) {
+            guacd_log(GUAC_LOG_ERROR, "Unable to add user.");
+            return 1;
+        }
+
+        guacd_log(GUAC_LOG_DEBUG, "TLS for user of connection \"%s\" is "
+                "handled by the kernel. Connection passed directly to "
+                "process (%s), which will report the time to first frame.",
+                proc->client->connection_id, process_type);
+
+        /* The process now owns the TLS session */
+        guac_socket_ssl_disown(socket);
+        guac_socket_free(socket);
+        guac_parser_free(parser);
+        return 0;
+
+    }
+#endif
 
     int sockets[2];
 
@@ -196,8 +253,10 @@ static int guacd_add_user(guacd_proc* proc, guac_parser* parser, guac_socket* so
     int proc_fd = sockets[1];
 
     /* Send user file descriptor to process */
-    if (!guacd_send_fd(proc->fd_socket, proc_fd)) {
+    if (!guacd_send_fd(proc->fd_socket, proc_fd, &details)) {
         guacd_log(GUAC_LOG_ERROR, "Unable to add user.");
+        close(user_fd);
+        close(proc_fd);
         return 1;
     }
 
@@ -219,44 +278,38 @@ static int guacd_add_user(guacd_proc* proc, guac_parser* parser, guac_socket* so
 }
 
 /**
- * Routes the connection on the given socket according to the Guacamole
- * protocol, adding new users and creating new client processes as needed. If a
- * new process is created, this function blocks until that process terminates,
- * automatically deregistering the process at that point.
+ * Routes the connection on the given socket according to the "select"
+ * instruction already read by the given parser, adding new users and creating
+ * new client processes as needed. If a new process is created, this function
+ * blocks until that process terminates, automatically deregistering the
+ * process at that point.
  *
  * The socket provided will be automatically freed when the connection
- * terminates unless routing fails, in which case non-zero is returned.
+ * terminates unless routing fails, in which case non-zero is returned. The
+ * parser provided is always freed.
  *
  * @param map
  *     The map of existing client processes.
  *
+ * @param pool
+ *     The pool of pre-forked processes to take new processes from, or NULL if
+ *     processes are not pre-forked.
+ *
  * @param socket
  *     The socket associated with the new connection that must be routed to
  *     a new or existing process within the given map.
  *
+ * @param parser
+ *     The guac_parser that read the "select" instruction from the given
+ *     socket, and which may contain further buffered data that must be
+ *     transferred to the process.
+ *
  * @return
  *     Zero if the connection was successfully routed, non-zero if routing has
  *     failed.
  */
-static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
-
-    guac_parser* parser = guac_parser_alloc();
-
-    /* Reset guac_error */
-    guac_error = GUAC_STATUS_SUCCESS;
-    guac_error_message = NULL;
-
-    /* Get protocol from select instruction */
-    if (guac_parser_expect(parser, socket, GUACD_USEC_TIMEOUT, "select")) {
-
-        /* Log error */
-        guacd_log_handshake_failure();
-        guacd_log_guac_error(GUAC_LOG_DEBUG,
-                "Error reading \"select\"");
-
-        guac_parser_free(parser);
-        return 1;
-    }
+static int guacd_route_selected(guacd_proc_map* map, guacd_proc_pool* pool,
+        guac_socket* socket, guac_parser* parser) {
 
     /* Validate args to select */
     if (parser->argc != 1) {
@@ -272,6 +325,8 @@ static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
 
     guacd_proc* proc;
     int new_process;
+    int pre_forked = 0;
+    const char* process_type;
 
     const char* identifier = parser->argv[0];
     const char* protocol = identifier;
@@ -281,6 +336,7 @@ static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
 
         proc = guacd_proc_map_retrieve(map, identifier);
         new_process = 0;
+        process_type = "existing process";
 
         /* Warn and ward off client if requested connection does not exist */
         if (proc == NULL) {
@@ -306,11 +362,23 @@ static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
             protocol = "xorg";
         }
 
-        guacd_log(GUAC_LOG_INFO, "Creating new client for protocol \"%s\"",
-                protocol);
+        /* Use a pre-forked process if one is ready */
+        proc = guacd_proc_pool_take(pool, protocol);
+        if (proc != NULL) {
+            guacd_log(GUAC_LOG_INFO, "Using pre-forked client for protocol "
+                    "\"%s\"", protocol);
+            process_type = "pre-forked process";
+            pre_forked = 1;
+        }
+
+        /* Otherwise, create new process */
+        else {
+            guacd_log(GUAC_LOG_INFO, "Creating new client for protocol \"%s\"",
+                    protocol);
+            proc = guacd_create_proc(protocol);
+            process_type = "new process";
+        }
 
-        /* Create new process */
-        proc = guacd_create_proc(protocol);
         new_process = 1;
 
     }
@@ -323,7 +391,31 @@ static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
     }
 
     /* Add new user (in the case of a new process, this will be the owner */
-    int add_user_failed = guacd_add_user(proc, parser, socket);
+    guac_timestamp routed = guac_timestamp_current();
+    int add_user_failed = guacd_add_user(proc, parser, socket, routed,
+            process_type);
+
+    /* A pre-forked process may have terminated while idle, in which case a
+     * new process must be created after all */
+    if (add_user_failed && pre_forked) {
+
+        guacd_log(GUAC_LOG_WARNING, "Pre-forked client for protocol \"%s\" "
+                "is no longer running. Creating new client.", protocol);
+
+        guacd_proc_pool_discard(proc);
+
+        proc = guacd_create_proc(protocol);
+        if (proc == NULL) {
+            guacd_log_guac_error(GUAC_LOG_INFO, "Connection did not succeed");
+            guac_parser_free(parser);
+            return 1;
+        }
+
+        process_type = "new process";
+        add_user_failed = guacd_add_user(proc, parser, socket, routed,
+                process_type);
+
+    }
 
     /* If new process was created, manage that process */
     if (new_process) {
@@ -359,6 +451,9 @@ static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
         /* Force process to stop and clean up */
         guacd_proc_stop(proc);
 
+        /* Retain any metrics recorded by the process */
+        guacd_metrics_release(proc->metrics);
+
         /* Free skeleton client */
         guac_client_free(proc->client);
 
@@ -368,11 +463,63 @@ static int guacd_route_connection(guacd_proc_map* map, guac_socket* socket) {
 
     }
 
+    /* Parser must likewise be freed if joining an existing process failed */
+    else if (add_user_failed)
+        guac_parser_free(parser);
+
     /* Routing succeeded only if the user was added to a process */
     return add_user_failed;
 
 }
 
+/**
+ * Routes the connection on the given socket according to the Guacamole
+ * protocol, reading the "select" instruction and then behaving as
+ * guacd_route_selected().
+ *
+ * The socket provided will be automatically freed when the connection
+ * terminates unless routing fails, in which case non-zero is returned.
+ *
+ * @param map
+ *     The map of existing client processes.
+ *
+ * @param pool
+ *     The pool of pre-forked processes to take new processes from, or NULL if
+ *     processes are not pre-forked.
+ *
+ * @param socket
+ *     The socket associated with the new connection that must be routed to
+ *     a new or existing process within the given map.
+ *
+ * @return
+ *     Zero if the connection was successfully routed, non-zero if routing has
+ *     failed.
+ */
+static int guacd_route_connection(guacd_proc_map* map, guacd_proc_pool* pool,
+        guac_socket* socket) {
+
+    guac_parser* parser = guac_parser_alloc();
+
+    /* Reset guac_error */
+    guac_error = GUAC_STATUS_SUCCESS;
+    guac_error_message = NULL;
+
+    /* Get protocol from select instruction */
+    if (guac_parser_expect(parser, socket, GUACD_USEC_TIMEOUT, "select")) {
+
+        /* Log error */
+        guacd_log_handshake_failure();
+        guacd_log_guac_error(GUAC_LOG_DEBUG,
+                "Error reading \"select\"");
+
+        guac_parser_free(parser);
+        return 1;
+    }
+
+    return guacd_route_selected(map, pool, socket, parser);
+
+}
+
 void* guacd_connection_thread(void* data) {
 
     guacd_connection_thread_params* params = (guacd_connection_thread_params*) data;
@@ -405,10 +552,26 @@ void* guacd_connection_thread(void* data) {
 #endif
 
     /* Route connection according to Guacamole, creating a new process if needed */
-    if (guacd_route_connection(map, socket))
+    if (guacd_route_connection(map, params->pool, socket))
         guac_socket_free(socket);
 
     free(params);
     return NULL;
 
 }
+
+void* guacd_connection_route_thread(void* data) {
+
+    guacd_connection_route_thread_params* params =
+        (guacd_connection_route_thread_params*) data;
+
+    /* Route connection according to the "select" instruction already read,
+     * creating a new process if needed */
+    if (guacd_route_selected(params->map, params->pool, params->socket,
+                params->parser))
+        guac_socket_free(params->socket);
+
+    guac_mem_free(params);
+    return NULL;
+
+}
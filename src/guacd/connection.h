@@ -21,6 +21,10 @@
 #define GUACD_CONNECTION_H
 
 #include "proc-map.h"
+#include "proc-pool.h"
+
+#include <guacamole/parser.h>
+#include <guacamole/socket.h>
 
 #ifdef ENABLE_SSL
 #include <openssl/ssl.h>
@@ -36,6 +40,12 @@ typedef struct guacd_connection_thread_params {
      */
     guacd_proc_map* map;
 
+    /**
+     * The shared pool of pre-forked processes, or NULL if no processes are
+     * pre-forked.
+     */
+    guacd_proc_pool* pool;
+
 #ifdef ENABLE_SSL
     /**
      * SSL context for encrypted connections to guacd. If SSL is not active,
@@ -72,6 +82,56 @@ typedef struct guacd_connection_thread_params {
  */
 void* guacd_connection_thread(void* data);
 
+/**
+ * Parameters required by each thread routing a connection whose handshake
+ * has already been read up to and including the "select" instruction.
+ */
+typedef struct guacd_connection_route_thread_params {
+
+    /**
+     * The shared map of all connected clients.
+     */
+    guacd_proc_map* map;
+
+    /**
+     * The shared pool of pre-forked processes, or NULL if no processes are
+     * pre-forked.
+     */
+    guacd_proc_pool* pool;
+
+    /**
+     * The guac_socket of the connection being routed. If SSL/TLS is in use,
+     * the SSL/TLS handshake will already have completed.
+     */
+    guac_socket* socket;
+
+    /**
+     * The guac_parser that has read the "select" instruction from the
+     * connection, and which may contain further buffered data that must be
+     * transferred to the process handling the connection.
+     */
+    guac_parser* parser;
+
+} guacd_connection_route_thread_params;
+
+/**
+ * Routes a connection whose "select" instruction has already been read,
+ * behaving identically to guacd_connection_thread() from that point onward.
+ * It is expected that this thread will operate detached. The creating
+ * process need not join on the resulting thread.
+ *
+ * @param data
+ *     A pointer to a guacd_connection_route_thread_params structure
+ *     containing the shared overall map of currently-connected processes, the
+ *     guac_socket of the connection being routed, and the guac_parser that
+ *     read that connection's "select" instruction. The structure, parser, and
+ *     socket are all freed by this thread.
+ *
+ * @return
+ *     Always NULL.
+ */
+void* guacd_connection_route_thread(void* data);
+
 /**
  * Parameters required by the per-connection I/O transfer thread.
  */
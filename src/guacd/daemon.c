@@ -19,12 +19,15 @@
 
 #include "config.h"
 
+#include "acceptor.h"
 #include "conf.h"
 #include "conf-args.h"
 #include "conf-file.h"
 #include "connection.h"
 #include "log.h"
+#include "metrics.h"
 #include "proc-map.h"
+#include "proc-pool.h"
 
 #include <guacamole/mem.h>
 
@@ -311,10 +314,8 @@ int main(int argc, char* argv[]) {
         .ai_protocol = IPPROTO_TCP
     };
 
-    /* Client */
-    struct sockaddr_in client_addr;
-    socklen_t client_addr_len;
-    int connected_socket_fd;
+    /* Listening socket and the connections accepted from it */
+    guacd_acceptor acceptor = { 0 };
 
 #ifdef ENABLE_SSL
     SSL_CTX* ssl_context = NULL;
@@ -394,6 +395,16 @@ int main(int argc, char* argv[]) {
                     strerror(errno));
         }
 
+#ifdef SO_REUSEPORT
+        /* Allow additional sockets to be bound to the same address, such that
+         * each acceptor thread may listen on its own socket */
+        if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT,
+                    (void*) &opt_on, sizeof(opt_on))) {
+            guacd_log(GUAC_LOG_DEBUG, "Unable to set socket options for "
+                    "port reuse: %s", strerror(errno));
+        }
+#endif
+
         /* Attempt to bind socket to address */
         if (bind(socket_fd,
                     current_address->ai_addr,
@@ -404,6 +415,11 @@ int main(int argc, char* argv[]) {
                     (current_address->ai_family == AF_INET) ? "AF_INET" : "AF_INET6",
                     bound_address, bound_port);
 
+            /* Retain bound address for any additional listening sockets */
+            memcpy(&acceptor.address, current_address->ai_addr,
+                    current_address->ai_addrlen);
+            acceptor.address_length = current_address->ai_addrlen;
+
             /* Done if successful bind */
             break;
         }
@@ -449,6 +465,26 @@ int main(int argc, char* argv[]) {
         ssl_context = SSL_CTX_new(TLS_server_method());
 #endif
 
+        /* Allow the kernel to take over encryption once the handshake is
+         * complete, such that connections can be handed directly to their
+         * processes rather than proxied, only if explicitly enabled. OpenSSL
+         * silently continues without kernel TLS if unsupported. */
+        if (config->kernel_tls) {
+#ifdef SSL_OP_ENABLE_KTLS
+            guacd_log(GUAC_LOG_INFO, "Kernel TLS will be used for TLS 1.2 "
+                    "connections where supported.");
+            SSL_CTX_set_options(ssl_context, SSL_OP_ENABLE_KTLS);
+#ifdef SSL_OP_NO_RENEGOTIATION
+            /* Renegotiation would send handshake records along a connection
+             * that only the kernel can then read */
+            SSL_CTX_set_options(ssl_context, SSL_OP_NO_RENEGOTIATION);
+#endif
+#else
+            guacd_log(GUAC_LOG_WARNING, "Kernel TLS is not supported by this "
+                    "version of OpenSSL. All connections will be proxied.");
+#endif
+        }
+
         /* Load key */
         if (config->key_file != NULL) {
             guacd_log(GUAC_LOG_INFO, "Using PEM keyfile %s", config->key_file);
@@ -535,54 +571,34 @@ int main(int argc, char* argv[]) {
     freeaddrinfo(addresses);
 
     /* Listen for connections */
-    if (listen(socket_fd, 5) < 0) {
+    if (listen(socket_fd, SOMAXCONN) < 0) {
         guacd_log(GUAC_LOG_ERROR, "Could not listen on socket: %s", strerror(errno));
         return 3;
     }
 
-    /* Daemon loop */
-    while (!stop_everything) {
-
-        pthread_t child_thread;
-
-        /* Accept connection */
-        client_addr_len = sizeof(client_addr);
-        connected_socket_fd = accept(socket_fd,
-                (struct sockaddr*) &client_addr, &client_addr_len);
-
-        if (connected_socket_fd < 0) {
-            if (errno == EINTR)
-                guacd_log(GUAC_LOG_DEBUG, "Accepting of further client connection(s) interrupted by signal.");
-            else
-                guacd_log(GUAC_LOG_ERROR, "Could not accept client connection: %s", strerror(errno));
-            continue;
-        }
-
-        /* Set TCP_NODELAY to avoid any latency that would otherwise be added by the OS'
-         * networking stack and Nagle's algorithm */
-        const int SO_TRUE = 1;
-        setsockopt(connected_socket_fd, IPPROTO_TCP, TCP_NODELAY,
-                (const void*) &SO_TRUE, sizeof(SO_TRUE));
-
-        /* Create parameters for connection thread */
-        guacd_connection_thread_params* params = guac_mem_alloc(sizeof(guacd_connection_thread_params));
-        if (params == NULL) {
-            guacd_log(GUAC_LOG_ERROR, "Could not create connection thread: %s", strerror(errno));
-            continue;
-        }
+    /* Begin exporting metrics, if configured, before any connection
+     * processes exist */
+    if (guacd_metrics_start(config))
+        exit(EXIT_FAILURE);
 
-        params->map = map;
-        params->connected_socket_fd = connected_socket_fd;
+    /* Begin pre-forking processes for the configured protocols, if any */
+    guacd_proc_pool* pool = guacd_proc_pool_alloc(config);
+    acceptor.socket_fd = socket_fd;
 
+    /* Accept and route connections until stopped */
+    acceptor.map = map;
+    acceptor.pool = pool;
+    acceptor.stop = &stop_everything;
 #ifdef ENABLE_SSL
-        params->ssl_context = ssl_context;
+    acceptor.ssl_context = ssl_context;
 #endif
+    guacd_acceptor_run(&acceptor);
 
-        /* Spawn thread to handle connection */
-        pthread_create(&child_thread, NULL, guacd_connection_thread, params);
-        pthread_detach(child_thread);
+    /* Terminate all pre-forked processes that were never used */
+    guacd_proc_pool_free(pool);
 
-    }
+    /* Stop exporting metrics */
+    guacd_metrics_stop();
 
     /* Stop all connections */
     if (map != NULL) {
@@ -0,0 +1,308 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "first-frame.h"
+
+#include <guacamole/mem.h>
+#include <guacamole/socket.h>
+
+#include <pthread.h>
+#include <sys/types.h>
+
+/**
+ * The data associated with a guac_socket created by
+ * guacd_first_frame_socket().
+ */
+typedef struct guacd_first_frame_data {
+
+    /**
+     * The guac_socket to which all socket operations are delegated.
+     */
+    guac_socket* socket;
+
+    /**
+     * Lock which is acquired while the search state below is being accessed.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * The number of bytes of GUACD_SYNC_INSTRUCTION matched thus far.
+     */
+    int matched;
+
+    /**
+     * Whether the first "sync" instruction has been written, but not
+     * necessarily flushed.
+     */
+    int written;
+
+    /**
+     * Whether the handler has been invoked.
+     */
+    int reported;
+
+    /**
+     * The handler to invoke once the first frame has been flushed.
+     */
+    guacd_first_frame_handler* handler;
+
+    /**
+     * The arbitrary data to pass to the handler.
+     */
+    void* handler_data;
+
+} guacd_first_frame_data;
+
+/**
+ * Callback function which reads only from the wrapped socket.
+ *
+ * @param socket
+ *     The guac_socket being read from.
+ *
+ * @param buf
+ *     The buffer into which data should be read.
+ *
+ * @param count
+ *     The maximum number of bytes to read.
+ *
+ * @return
+ *     The number of bytes read, or -1 if an error occurs.
+ */
+static ssize_t guacd_first_frame_read_handler(guac_socket* socket,
+        void* buf, size_t count) {
+
+    guacd_first_frame_data* data = (guacd_first_frame_data*) socket->data;
+
+    /* Delegate read to wrapped socket */
+    return guac_socket_read(data->socket, buf, count);
+
+}
+
+/**
+ * Callback function which writes the given data to the wrapped socket,
+ * searching that data for the first "sync" instruction if it has not yet been
+ * written.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param buf
+ *     The buffer of data to write.
+ *
+ * @param count
+ *     The number of bytes in the buffer.
+ *
+ * @return
+ *     The number of bytes written, or -1 if an error occurs.
+ */
+static ssize_t guacd_first_frame_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    static const char pattern[] = GUACD_SYNC_INSTRUCTION;
+
+    guacd_first_frame_data* data = (guacd_first_frame_data*) socket->data;
+    const char* buffer = (const char*) buf;
+
+    pthread_mutex_lock(&data->lock);
+
+    for (size_t i = 0; !data->written && i < count; i++) {
+
+        /* The pattern does not overlap with itself except at its first
+         * character, thus a mismatch need only be checked against that
+         * first character */
+        if (buffer[i] == pattern[data->matched]) {
+            if (++data->matched == sizeof(pattern) - 1)
+                data->written = 1;
+        }
+        else
+            data->matched = (buffer[i] == pattern[0]) ? 1 : 0;
+
+    }
+
+    pthread_mutex_unlock(&data->lock);
+
+    /* Delegate write to wrapped socket */
+    if (guac_socket_write(data->socket, buf, count))
+        return -1;
+
+    return count;
+
+}
+
+/**
+ * Callback function which writes the given binary data to the wrapped socket.
+ * Binary data cannot contain instructions and is not searched.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param buf
+ *     The buffer of binary data to write.
+ *
+ * @param count
+ *     The number of bytes in the buffer.
+ *
+ * @return
+ *     The number of bytes written, or -1 if an error occurs.
+ */
+static ssize_t guacd_first_frame_write_binary_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guacd_first_frame_data* data = (guacd_first_frame_data*) socket->data;
+
+    /* Delegate write to wrapped socket */
+    if (guac_socket_write_binary(data->socket, buf, count))
+        return -1;
+
+    return count;
+
+}
+
+/**
+ * Callback function which flushes the wrapped socket, invoking the handler if
+ * this flush is the first to follow the first "sync" instruction.
+ *
+ * @param socket
+ *     The guac_socket being flushed.
+ *
+ * @return
+ *     Zero on success, non-zero if an error occurs.
+ */
+static ssize_t guacd_first_frame_flush_handler(guac_socket* socket) {
+
+    guacd_first_frame_data* data = (guacd_first_frame_data*) socket->data;
+
+    /* Delegate flush to wrapped socket */
+    ssize_t retval = guac_socket_flush(data->socket);
+
+    /* The first frame has been received only once actually flushed */
+    pthread_mutex_lock(&data->lock);
+    int report = data->written && !data->reported && retval == 0;
+    if (report)
+        data->reported = 1;
+    pthread_mutex_unlock(&data->lock);
+
+    if (report)
+        data->handler(data->handler_data);
+
+    return retval;
+
+}
+
+/**
+ * Callback function which begins an instruction on the wrapped socket.
+ *
+ * @param socket
+ *     The guac_socket on which an instruction is beginning.
+ */
+static void guacd_first_frame_lock_handler(guac_socket* socket) {
+    guacd_first_frame_data* data = (guacd_first_frame_data*) socket->data;
+    guac_socket_instruction_begin(data->socket);
+}
+
+/**
+ * Callback function which ends an instruction on the wrapped socket.
+ *
+ * @param socket
+ *     The guac_socket on which an instruction is ending.
+ */
+static void guacd_first_frame_unlock_handler(guac_socket* socket) {
+    guacd_first_frame_data* data = (guacd_first_frame_data*) socket->data;
+    guac_socket_instruction_end(data->socket);
+}
+
+/**
+ * Callback function which waits for data on the wrapped socket.
+ *
+ * @param socket
+ *     The guac_socket being waited upon.
+ *
+ * @param usec_timeout
+ *     The maximum amount of time to wait for data, in microseconds, or a
+ *     negative value to wait indefinitely.
+ *
+ * @return
+ *     Positive if data is available, zero if the timeout elapsed, or negative
+ *     if an error occurs.
+ */
+static int guacd_first_frame_select_handler(guac_socket* socket,
+        int usec_timeout) {
+
+    guacd_first_frame_data* data = (guacd_first_frame_data*) socket->data;
+
+    /* Delegate select to wrapped socket */
+    return guac_socket_select(data->socket, usec_timeout);
+
+}
+
+/**
+ * Callback function which frees the wrapped socket along with all data
+ * associated with the given socket.
+ *
+ * @param socket
+ *     The guac_socket being freed.
+ *
+ * @return
+ *     Always zero.
+ */
+static int guacd_first_frame_free_handler(guac_socket* socket) {
+
+    guacd_first_frame_data* data = (guacd_first_frame_data*) socket->data;
+
+    guac_socket_free(data->socket);
+    pthread_mutex_destroy(&data->lock);
+    guac_mem_free(data);
+
+    return 0;
+
+}
+
+guac_socket* guacd_first_frame_socket(guac_socket* socket,
+        guacd_first_frame_handler* handler, void* data) {
+
+    guacd_first_frame_data* first_frame = guac_mem_alloc(sizeof(guacd_first_frame_data));
+    first_frame->socket = socket;
+    pthread_mutex_init(&first_frame->lock, NULL);
+
+    /* The start of the stream counts as the end of a preceding instruction */
+    first_frame->matched = 1;
+    first_frame->written = 0;
+    first_frame->reported = 0;
+
+    first_frame->handler = handler;
+    first_frame->handler_data = data;
+
+    guac_socket* wrapper = guac_socket_alloc();
+    wrapper->data = first_frame;
+
+    /* Assign handlers */
+    wrapper->read_handler   = guacd_first_frame_read_handler;
+    wrapper->write_handler  = guacd_first_frame_write_handler;
+    wrapper->write_binary_handler = guacd_first_frame_write_binary_handler;
+    wrapper->select_handler = guacd_first_frame_select_handler;
+    wrapper->flush_handler  = guacd_first_frame_flush_handler;
+    wrapper->lock_handler   = guacd_first_frame_lock_handler;
+    wrapper->unlock_handler = guacd_first_frame_unlock_handler;
+    wrapper->free_handler   = guacd_first_frame_free_handler;
+
+    return wrapper;
+
+}
@@ -0,0 +1,68 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUACD_FIRST_FRAME_H
+#define GUACD_FIRST_FRAME_H
+
+#include <guacamole/socket.h>
+
+/**
+ * The sequence of bytes which begins each "sync" instruction (including the
+ * terminator of the preceding instruction). As each frame ends with a "sync"
+ * instruction, the first occurrence of this sequence marks the end of the
+ * first frame sent to a user.
+ */
+#define GUACD_SYNC_INSTRUCTION ";4.sync,"
+
+/**
+ * Handler which is invoked when the first frame has been written to a user's
+ * socket.
+ *
+ * @param data
+ *     The arbitrary data provided to guacd_first_frame_socket().
+ */
+typedef void guacd_first_frame_handler(void* data);
+
+/**
+ * Returns a new guac_socket which behaves identically to the given
+ * guac_socket, except that the given handler is invoked once the first frame
+ * (the first "sync" instruction) written to the new guac_socket has been
+ * flushed to the given guac_socket. The handler is invoked only once, from
+ * whichever thread flushes that frame. As the given guac_socket is the user's
+ * own socket within the connection process, this is the same regardless of
+ * how the user's connection reached that process.
+ *
+ * @param socket
+ *     The guac_socket to which all socket operations should be delegated.
+ *     This guac_socket is freed when the returned guac_socket is freed.
+ *
+ * @param handler
+ *     The handler to invoke once the first frame has been written.
+ *
+ * @param data
+ *     Arbitrary data to pass to the given handler.
+ *
+ * @return
+ *     A newly-allocated guac_socket which wraps the given guac_socket.
+ */
+guac_socket* guacd_first_frame_socket(guac_socket* socket,
+        guacd_first_frame_handler* handler, void* data);
+
+#endif
+
@@ -0,0 +1,662 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "conf.h"
+#include "log.h"
+#include "metrics.h"
+
+#include <guacamole/mem.h>
+#include <guacamole/metrics.h>
+#include <guacamole/string.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Storage for the metrics of a single connection process. All slots reside
+ * within memory that is shared between guacd and its connection processes.
+ */
+typedef struct guacd_metrics_slot {
+
+    /**
+     * Non-zero if this slot has been claimed by a connection process, zero
+     * otherwise. This member is only modified by guacd itself, and only while
+     * guacd_metrics_lock is held.
+     */
+    int in_use;
+
+    /**
+     * The ID of the connection whose process claimed this slot.
+     */
+    char connection_id[GUACD_METRICS_LABEL_LENGTH];
+
+    /**
+     * The name of the protocol used by the connection whose process claimed
+     * this slot.
+     */
+    char protocol[GUACD_METRICS_LABEL_LENGTH];
+
+    /**
+     * The metrics recorded by the connection process.
+     */
+    guac_metrics metrics;
+
+} guacd_metrics_slot;
+
+/**
+ * All slots available for connection processes, or NULL if metrics are not
+ * being recorded.
+ */
+static guacd_metrics_slot* guacd_metrics_slots = NULL;
+
+/**
+ * The combined metrics of all connection processes whose slots have been
+ * released, such that exported totals never decrease.
+ */
+static guac_metrics_summary guacd_metrics_retired;
+
+/**
+ * Lock which guards the in_use flag of all slots and the retired totals.
+ */
+static pthread_mutex_t guacd_metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * The file descriptors of the TCP and UNIX domain sockets listening for
+ * connections to the metrics exporter, or -1 for each socket not in use.
+ */
+static int guacd_metrics_listeners[2] = { -1, -1 };
+
+/**
+ * A pipe whose read end is watched by the exporter thread, and which is
+ * written to signal that the exporter thread should stop.
+ */
+static int guacd_metrics_stop_pipe[2] = { -1, -1 };
+
+/**
+ * The path of the UNIX domain socket created for the metrics exporter, if
+ * any.
+ */
+static char* guacd_metrics_socket_path = NULL;
+
+/**
+ * The thread which accepts and serves connections to the metrics exporter.
+ */
+static pthread_t guacd_metrics_thread;
+
+/**
+ * Writes the given string to the given file as a Prometheus label value,
+ * escaping all characters that have special meaning.
+ *
+ * @param output
+ *     The file to write to.
+ *
+ * @param value
+ *     The label value to write.
+ */
+static void guacd_metrics_write_label(FILE* output, const char* value) {
+
+    for (; *value != '\0'; value++) {
+        switch (*value) {
+
+            case '\\':
+                fputs("\\\\", output);
+                break;
+
+            case '"':
+                fputs("\\\"", output);
+                break;
+
+            case '\n':
+                fputs("\\n", output);
+                break;
+
+            default:
+                fputc(*value, output);
+
+        }
+    }
+
+}
+
+/**
+ * Writes the given summary of all aggregate counters and histograms to the
+ * given file in Prometheus text format.
+ *
+ * @param output
+ *     The file to write to.
+ *
+ * @param summary
+ *     The combined metrics of all connection processes.
+ */
+static void guacd_metrics_write_summary(FILE* output,
+        const guac_metrics_summary* summary) {
+
+    for (int i = 0; i < GUAC_METRICS_COUNTERS; i++) {
+
+        const guac_metrics_descriptor* descriptor =
+            guac_metrics_describe_counter(i);
+
+        fprintf(output, "# HELP %s %s\n# TYPE %s counter\n%s %" PRIu64 "\n",
+                descriptor->name, descriptor->help, descriptor->name,
+                descriptor->name, summary->counters[i]);
+
+    }
+
+    for (int i = 0; i < GUAC_METRICS_HISTOGRAMS; i++) {
+
+        const guac_metrics_descriptor* descriptor =
+            guac_metrics_describe_histogram(i);
+        const guac_metrics_distribution* distribution =
+            &summary->histograms[i];
+
+        fprintf(output, "# HELP %s %s\n# TYPE %s histogram\n",
+                descriptor->name, descriptor->help, descriptor->name);
+
+        /* Prometheus buckets are cumulative, with the final bucket
+         * counting all observations */
+        uint64_t cumulative = 0;
+        for (int bucket = 0; bucket < GUAC_METRICS_BUCKETS - 1; bucket++) {
+            cumulative += distribution->buckets[bucket];
+            fprintf(output, "%s_bucket{le=\"%.9g\"} %" PRIu64 "\n",
+                    descriptor->name,
+                    guac_metrics_bucket_bound(bucket) * descriptor->scale,
+                    cumulative);
+        }
+
+        fprintf(output, "%s_bucket{le=\"+Inf\"} %" PRIu64 "\n",
+                descriptor->name, distribution->count);
+
+        if (descriptor->scale == 1)
+            fprintf(output, "%s_sum %" PRIu64 "\n", descriptor->name,
+                    distribution->sum);
+        else
+            fprintf(output, "%s_sum %.6f\n", descriptor->name,
+                    distribution->sum * descriptor->scale);
+
+        fprintf(output, "%s_count %" PRIu64 "\n", descriptor->name,
+                distribution->count);
+
+    }
+
+}
+
+/**
+ * Writes all metrics to the given file in Prometheus text format.
+ *
+ * @param output
+ *     The file to write to.
+ */
+static void guacd_metrics_write(FILE* output) {
+
+    guac_metrics_summary summary;
+    int processes = 0;
+
+    pthread_mutex_lock(&guacd_metrics_lock);
+
+    /* Totals include both running and terminated processes */
+    summary = guacd_metrics_retired;
+    for (int i = 0; i < GUACD_METRICS_MAX_PROCESSES; i++) {
+        guacd_metrics_slot* slot = &guacd_metrics_slots[i];
+        if (slot->in_use) {
+            guac_metrics_accumulate(&summary, &slot->metrics);
+            processes++;
+        }
+    }
+
+    guacd_metrics_write_summary(output, &summary);
+
+    fprintf(output, "# HELP guacd_connection_processes Connection processes "
+            "currently running, including pre-forked processes.\n"
+            "# TYPE guacd_connection_processes gauge\n"
+            "guacd_connection_processes %i\n", processes);
+
+    fprintf(output, "# HELP guac_user_sent_bytes_total Bytes written to the "
+            "network connection of each connected user.\n"
+            "# TYPE guac_user_sent_bytes_total counter\n");
+
+    for (int i = 0; i < GUACD_METRICS_MAX_PROCESSES; i++) {
+
+        guacd_metrics_slot* slot = &guacd_metrics_slots[i];
+        if (!slot->in_use)
+            continue;
+
+        for (int j = 0; j < GUAC_METRICS_MAX_USERS; j++) {
+
+            guac_metrics_user* user = &slot->metrics.users[j];
+            if (__atomic_load_n(&user->state, __ATOMIC_ACQUIRE)
+                    != GUAC_METRICS_USER_ACTIVE)
+                continue;
+
+            fputs("guac_user_sent_bytes_total{connection=\"", output);
+            guacd_metrics_write_label(output, slot->connection_id);
+            fputs("\",protocol=\"", output);
+            guacd_metrics_write_label(output, slot->protocol);
+            fputs("\",user=\"", output);
+            guacd_metrics_write_label(output, user->user_id);
+            fprintf(output, "\"} %" PRIu64 "\n",
+                    __atomic_load_n(&user->bytes_sent, __ATOMIC_RELAXED));
+
+        }
+
+    }
+
+    pthread_mutex_unlock(&guacd_metrics_lock);
+
+}
+
+/**
+ * Reads the HTTP request sent by a client of the metrics exporter, and
+ * responds with all metrics if the request is a GET request for "/metrics".
+ * The connection is closed once the response has been sent.
+ *
+ * @param fd
+ *     The file descriptor of the connected client.
+ */
+static void guacd_metrics_serve(int fd) {
+
+    char request[GUACD_METRICS_MAX_REQUEST];
+    int length = 0;
+
+    /* Read until the end of the request headers */
+    while (length < (int) sizeof(request) - 1) {
+
+        struct pollfd client = { .fd = fd, .events = POLLIN };
+        if (poll(&client, 1, GUACD_METRICS_REQUEST_TIMEOUT) <= 0)
+            break;
+
+        int received = read(fd, request + length, sizeof(request) - 1 - length);
+        if (received <= 0)
+            break;
+
+        length += received;
+        request[length] = '\0';
+
+        if (strstr(request, "\r\n\r\n") != NULL
+                || strstr(request, "\n\n") != NULL)
+            break;
+
+    }
+
+    request[length] = '\0';
+
+    /* Never block indefinitely on a client that stops reading */
+    struct timeval timeout = {
+        .tv_sec = GUACD_METRICS_REQUEST_TIMEOUT / 1000
+    };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    FILE* output = fdopen(fd, "w");
+    if (output == NULL) {
+        close(fd);
+        return;
+    }
+
+    if (strncmp(request, "GET /metrics ", 13) == 0
+            || strncmp(request, "GET /metrics?", 13) == 0) {
+        fputs("HTTP/1.0 200 OK\r\n"
+                "Content-Type: text/plain; version=0.0.4\r\n"
+                "\r\n", output);
+        guacd_metrics_write(output);
+    }
+
+    else
+        fputs("HTTP/1.0 404 Not Found\r\n"
+                "Content-Type: text/plain\r\n"
+                "\r\n"
+                "Metrics are available at /metrics.\n", output);
+
+    fclose(output);
+
+}
+
+/**
+ * Thread which accepts and serves connections to the metrics exporter until
+ * signalled to stop via guacd_metrics_stop_pipe.
+ *
+ * @param data
+ *     Unused.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacd_metrics_thread_run(void* data) {
+
+    struct pollfd fds[] = {
+        { .fd = guacd_metrics_stop_pipe[0],  .events = POLLIN },
+        { .fd = guacd_metrics_listeners[0], .events = POLLIN },
+        { .fd = guacd_metrics_listeners[1], .events = POLLIN }
+    };
+
+    for (;;) {
+
+        /* Sockets that are not in use (-1) are ignored by poll() */
+        if (poll(fds, sizeof(fds) / sizeof(fds[0]), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            guacd_log(GUAC_LOG_ERROR, "Metrics exporter stopped: %s",
+                    strerror(errno));
+            break;
+        }
+
+        if (fds[0].revents)
+            break;
+
+        for (int i = 1; i < (int) (sizeof(fds) / sizeof(fds[0])); i++) {
+
+            if (!(fds[i].revents & POLLIN))
+                continue;
+
+            int fd = accept(fds[i].fd, NULL, NULL);
+            if (fd < 0) {
+                guacd_log(GUAC_LOG_DEBUG, "Unable to accept connection to "
+                        "metrics exporter: %s", strerror(errno));
+                continue;
+            }
+
+            guacd_metrics_serve(fd);
+
+        }
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Creates a TCP socket listening on the given host and port.
+ *
+ * @param host
+ *     The host to bind to.
+ *
+ * @param port
+ *     The port to bind to.
+ *
+ * @return
+ *     The file descriptor of the listening socket, or -1 if the socket could
+ *     not be created.
+ */
+static int guacd_metrics_listen_tcp(const char* host, const char* port) {
+
+    struct addrinfo* addresses;
+    struct addrinfo hints = {
+        .ai_family   = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+        .ai_protocol = IPPROTO_TCP
+    };
+
+    int retval = getaddrinfo(host, port, &hints, &addresses);
+    if (retval) {
+        guacd_log(GUAC_LOG_ERROR, "Error parsing metrics exporter address "
+                "or port: %s", gai_strerror(retval));
+        return -1;
+    }
+
+    int fd = -1;
+    int opt_on = 1;
+
+    /* Use the first address that can be bound */
+    for (struct addrinfo* current = addresses; current != NULL;
+            current = current->ai_next) {
+
+        fd = socket(current->ai_family, SOCK_STREAM, 0);
+        if (fd < 0)
+            continue;
+
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt_on, sizeof(opt_on));
+
+        if (bind(fd, current->ai_addr, current->ai_addrlen) == 0
+                && listen(fd, SOMAXCONN) == 0)
+            break;
+
+        close(fd);
+        fd = -1;
+
+    }
+
+    if (fd < 0)
+        guacd_log(GUAC_LOG_ERROR, "Unable to bind metrics exporter to host "
+                "%s, port %s: %s", host, port, strerror(errno));
+    else
+        guacd_log(GUAC_LOG_INFO, "Exporting metrics on host %s, port %s",
+                host, port);
+
+    freeaddrinfo(addresses);
+    return fd;
+
+}
+
+/**
+ * Creates a UNIX domain socket listening at the given path. Any file already
+ * present at the given path is replaced.
+ *
+ * @param path
+ *     The path of the socket to create.
+ *
+ * @return
+ *     The file descriptor of the listening socket, or -1 if the socket could
+ *     not be created.
+ */
+static int guacd_metrics_listen_unix(const char* path) {
+
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (guac_strlcpy(address.sun_path, path, sizeof(address.sun_path))
+            >= sizeof(address.sun_path)) {
+        guacd_log(GUAC_LOG_ERROR, "Metrics exporter socket path \"%s\" is "
+                "too long.", path);
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        guacd_log(GUAC_LOG_ERROR, "Error opening metrics exporter socket: %s",
+                strerror(errno));
+        return -1;
+    }
+
+    /* Replace any socket left behind by a previous instance */
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr*) &address, sizeof(address))
+            || listen(fd, SOMAXCONN)) {
+        guacd_log(GUAC_LOG_ERROR, "Unable to bind metrics exporter to "
+                "\"%s\": %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    guacd_log(GUAC_LOG_INFO, "Exporting metrics on \"%s\"", path);
+    return fd;
+
+}
+
+int guacd_metrics_start(guacd_config* config) {
+
+    /* Nothing to do if no exporter is configured */
+    if (config->metrics_bind_port == NULL && config->metrics_socket == NULL)
+        return 0;
+
+    /* Metrics must be visible to guacd after being recorded by the
+     * connection processes it forks */
+    guacd_metrics_slots = mmap(NULL,
+            sizeof(guacd_metrics_slot) * GUACD_METRICS_MAX_PROCESSES,
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (guacd_metrics_slots == MAP_FAILED) {
+        guacd_log(GUAC_LOG_ERROR, "Unable to allocate shared memory for "
+                "metrics: %s", strerror(errno));
+        guacd_metrics_slots = NULL;
+        return 1;
+    }
+
+    if (config->metrics_bind_port != NULL) {
+        guacd_metrics_listeners[0] = guacd_metrics_listen_tcp(
+                config->metrics_bind_host, config->metrics_bind_port);
+        if (guacd_metrics_listeners[0] < 0)
+            goto fail;
+    }
+
+    if (config->metrics_socket != NULL) {
+        guacd_metrics_listeners[1] = guacd_metrics_listen_unix(
+                config->metrics_socket);
+        if (guacd_metrics_listeners[1] < 0)
+            goto fail;
+        guacd_metrics_socket_path = guac_strdup(config->metrics_socket);
+    }
+
+    if (pipe(guacd_metrics_stop_pipe)) {
+        guacd_log(GUAC_LOG_ERROR, "Unable to create pipe for metrics "
+                "exporter: %s", strerror(errno));
+        goto fail;
+    }
+
+    if (pthread_create(&guacd_metrics_thread, NULL,
+                guacd_metrics_thread_run, NULL)) {
+        guacd_log(GUAC_LOG_ERROR, "Unable to start thread for metrics "
+                "exporter.");
+        close(guacd_metrics_stop_pipe[0]);
+        close(guacd_metrics_stop_pipe[1]);
+        guacd_metrics_stop_pipe[0] = guacd_metrics_stop_pipe[1] = -1;
+        goto fail;
+    }
+
+    return 0;
+
+fail:
+
+    for (int i = 0; i < 2; i++) {
+        if (guacd_metrics_listeners[i] >= 0) {
+            close(guacd_metrics_listeners[i]);
+            guacd_metrics_listeners[i] = -1;
+        }
+    }
+
+    if (guacd_metrics_socket_path != NULL) {
+        unlink(guacd_metrics_socket_path);
+        guac_mem_free(guacd_metrics_socket_path);
+        guacd_metrics_socket_path = NULL;
+    }
+
+    munmap(guacd_metrics_slots,
+            sizeof(guacd_metrics_slot) * GUACD_METRICS_MAX_PROCESSES);
+    guacd_metrics_slots = NULL;
+
+    return 1;
+
+}
+
+void guacd_metrics_stop(void) {
+
+    if (guacd_metrics_slots == NULL)
+        return;
+
+    /* Wake and wait for exporter thread */
+    char stop = 0;
+    if (write(guacd_metrics_stop_pipe[1], &stop, sizeof(stop)) == sizeof(stop))
+        pthread_join(guacd_metrics_thread, NULL);
+
+    for (int i = 0; i < 2; i++) {
+        if (guacd_metrics_listeners[i] >= 0) {
+            close(guacd_metrics_listeners[i]);
+            guacd_metrics_listeners[i] = -1;
+        }
+    }
+
+    if (guacd_metrics_socket_path != NULL) {
+        unlink(guacd_metrics_socket_path);
+        guac_mem_free(guacd_metrics_socket_path);
+        guacd_metrics_socket_path = NULL;
+    }
+
+    /* The shared memory itself is intentionally left mapped, as connection
+     * threads may still release their slots while guacd exits */
+
+}
+
+guac_metrics* guacd_metrics_claim(const char* connection_id,
+        const char* protocol) {
+
+    if (guacd_metrics_slots == NULL)
+        return NULL;
+
+    guac_metrics* metrics = NULL;
+
+    pthread_mutex_lock(&guacd_metrics_lock);
+
+    for (int i = 0; i < GUACD_METRICS_MAX_PROCESSES; i++) {
+
+        guacd_metrics_slot* slot = &guacd_metrics_slots[i];
+        if (slot->in_use)
+            continue;
+
+        guac_strlcpy(slot->connection_id, connection_id,
+                sizeof(slot->connection_id));
+        guac_strlcpy(slot->protocol, protocol, sizeof(slot->protocol));
+        guac_metrics_init(&slot->metrics);
+        slot->in_use = 1;
+
+        metrics = &slot->metrics;
+        break;
+
+    }
+
+    pthread_mutex_unlock(&guacd_metrics_lock);
+
+    if (metrics == NULL)
+        guacd_log(GUAC_LOG_DEBUG, "Metrics will not be recorded for "
+                "connection \"%s\", as %i other processes are already "
+                "recording metrics.", connection_id,
+                GUACD_METRICS_MAX_PROCESSES);
+
+    return metrics;
+
+}
+
+void guacd_metrics_release(guac_metrics* metrics) {
+
+    if (metrics == NULL)
+        return;
+
+    pthread_mutex_lock(&guacd_metrics_lock);
+
+    guacd_metrics_slot* slot = (guacd_metrics_slot*) ((char*) metrics
+            - offsetof(guacd_metrics_slot, metrics));
+
+    guac_metrics_accumulate(&guacd_metrics_retired, metrics);
+    slot->in_use = 0;
+
+    pthread_mutex_unlock(&guacd_metrics_lock);
+
+}
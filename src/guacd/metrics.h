@@ -0,0 +1,105 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUACD_METRICS_H
+#define GUACD_METRICS_H
+
+#include "conf.h"
+
+#include <guacamole/metrics.h>
+
+/**
+ * The maximum number of connection processes whose metrics may be recorded
+ * at any one time. Processes created while this many processes are already
+ * recording metrics will not record metrics.
+ */
+#define GUACD_METRICS_MAX_PROCESSES 256
+
+/**
+ * The maximum number of bytes of any connection ID or protocol name included
+ * as a label within exported metrics, including null terminator.
+ */
+#define GUACD_METRICS_LABEL_LENGTH 64
+
+/**
+ * The maximum number of bytes to read from a client of the metrics exporter
+ * while waiting for the end of its HTTP request headers.
+ */
+#define GUACD_METRICS_MAX_REQUEST 4096
+
+/**
+ * The number of milliseconds to wait for a client of the metrics exporter to
+ * send its HTTP request before closing the connection.
+ */
+#define GUACD_METRICS_REQUEST_TIMEOUT 5000
+
+/**
+ * Prepares guacd to record metrics for all connection processes and begins
+ * exporting those metrics in Prometheus text format, as configured within the
+ * given guacd configuration. If the metrics exporter is not configured, this
+ * function has no effect and no metrics are recorded. This function must be
+ * invoked before any connection processes are created.
+ *
+ * @param config
+ *     The guacd configuration describing where metrics should be exported.
+ *
+ * @return
+ *     Zero if metrics are being exported or no exporter is configured,
+ *     non-zero if the configured exporter could not be started.
+ */
+int guacd_metrics_start(guacd_config* config);
+
+/**
+ * Stops exporting metrics, removing any UNIX domain socket created for the
+ * metrics exporter. If metrics are not being exported, this function has no
+ * effect.
+ */
+void guacd_metrics_stop(void);
+
+/**
+ * Reserves storage for the metrics of a new connection process. The returned
+ * storage is shared with all processes forked afterwards, and must be
+ * attached within the connection process using guac_metrics_attach(). The
+ * storage must be released with guacd_metrics_release() once the process has
+ * terminated.
+ *
+ * @param connection_id
+ *     The ID of the connection whose process will record metrics.
+ *
+ * @param protocol
+ *     The name of the protocol used by the connection.
+ *
+ * @return
+ *     Storage for the metrics of the new connection process, or NULL if
+ *     metrics are not being recorded or no storage remains.
+ */
+guac_metrics* guacd_metrics_claim(const char* connection_id,
+        const char* protocol);
+
+/**
+ * Releases storage reserved by guacd_metrics_claim(), retaining the values
+ * recorded within the totals of all future exports.
+ *
+ * @param metrics
+ *     The storage to release, as returned by guacd_metrics_claim(). If NULL,
+ *     this function has no effect.
+ */
+void guacd_metrics_release(guac_metrics* metrics);
+
+#endif
@@ -31,17 +31,19 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
-int guacd_send_fd(int sock, int fd) {
+int guacd_send_fd(int sock, int fd, const guacd_fd_details* details) {
 
     struct msghdr message = {0};
     char message_data[] = {'G'};
 
-    /* Assign data buffer */
-    struct iovec io_vector[1];
+    /* Assign data buffers (payload followed by details) */
+    struct iovec io_vector[2];
     io_vector[0].iov_base = message_data;
     io_vector[0].iov_len  = sizeof(message_data);
+    io_vector[1].iov_base = (void*) details;
+    io_vector[1].iov_len  = sizeof(*details);
     message.msg_iov    = io_vector;
-    message.msg_iovlen = 1;
+    message.msg_iovlen = 2;
 
     /* Assign ancillary data buffer */
     char buffer[CMSG_SPACE(sizeof(fd))] = {0};
@@ -58,23 +60,26 @@ int guacd_send_fd(int sock, int fd) {
     memcpy(CMSG_DATA(control), &fd, sizeof(fd));
 
     /* Send file descriptor */
-    return (sendmsg(sock, &message, 0) == sizeof(message_data));
+    return (sendmsg(sock, &message, 0)
+            == sizeof(message_data) + sizeof(*details));
 
 }
 
-int guacd_recv_fd(int sock) {
+int guacd_recv_fd(int sock, guacd_fd_details* details) {
 
     int fd;
 
     struct msghdr message = {0};
     char message_data[1];
 
-    /* Assign data buffer */
-    struct iovec io_vector[1];
+    /* Assign data buffers (payload followed by details) */
+    struct iovec io_vector[2];
     io_vector[0].iov_base = message_data;
     io_vector[0].iov_len  = sizeof(message_data);
+    io_vector[1].iov_base = details;
+    io_vector[1].iov_len  = sizeof(*details);
     message.msg_iov    = io_vector;
-    message.msg_iovlen = 1;
+    message.msg_iovlen = 2;
 
     /* Assign ancillary data buffer */
     char buffer[CMSG_SPACE(sizeof(fd))];
@@ -82,7 +87,8 @@ int guacd_recv_fd(int sock) {
     message.msg_controllen = sizeof(buffer);
 
     /* Receive file descriptor */
-    if (recvmsg(sock, &message, 0) == sizeof(message_data)) {
+    if (recvmsg(sock, &message, 0)
+            == sizeof(message_data) + sizeof(*details)) {
 
         /* Validate payload */
         if (message_data[0] != 'G') {
@@ -90,6 +96,9 @@ int guacd_recv_fd(int sock) {
             return -1;
         }
 
+        /* Do not trust the sender to terminate the process description */
+        details->process_type[GUACD_PROCESS_TYPE_SIZE - 1] = '\0';
+
         /* Iterate control headers, looking for the sent file descriptor */
         struct cmsghdr* control;
         for (control = CMSG_FIRSTHDR(&message); control != NULL; control = CMSG_NXTHDR(&message, control)) {
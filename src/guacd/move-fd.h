@@ -20,11 +20,42 @@
 #ifndef GUACD_MOVE_FD_H
 #define GUACD_MOVE_FD_H
 
+#include <guacamole/timestamp.h>
+
+/**
+ * The maximum number of bytes in the process description sent along with each
+ * file descriptor, including the null terminator.
+ */
+#define GUACD_PROCESS_TYPE_SIZE 32
+
+/**
+ * Details describing how a user's connection was routed to a process, sent
+ * along with the file descriptor of that connection.
+ */
+typedef struct guacd_fd_details {
+
+    /**
+     * The time at which the process receiving the file descriptor was
+     * selected for the user, used to measure the time taken for the user to
+     * receive their first frame.
+     */
+    guac_timestamp routed;
+
+    /**
+     * A human-readable description of how the process receiving the file
+     * descriptor was obtained, such as "pre-forked process", for the sake of
+     * logging. This value is always null-terminated.
+     */
+    char process_type[GUACD_PROCESS_TYPE_SIZE];
+
+} guacd_fd_details;
+
 /**
  * Sends the given file descriptor along the given socket, allowing the
- * receiving process to use that file descriptor normally. Returns non-zero on
- * success, zero on error, just as a normal call to sendmsg() would. If an
- * error does occur, errno will be set appropriately.
+ * receiving process to use that file descriptor normally. The given details
+ * are sent within the same message. Returns non-zero on success, zero on
+ * error, just as a normal call to sendmsg() would. If an error does occur,
+ * errno will be set appropriately.
  *
  * @param sock
  *     The file descriptor of an open UNIX domain socket along which the file
@@ -33,25 +64,33 @@
  * @param fd
  *     The file descriptor to send along the given UNIX domain socket.
  *
+ * @param details
+ *     The details to send along with the file descriptor.
+ *
  * @return
  *     Non-zero if the send operation succeeded, zero on error.
  */
-int guacd_send_fd(int sock, int fd);
+int guacd_send_fd(int sock, int fd, const guacd_fd_details* details);
 
 /**
  * Waits for a file descriptor on the given socket, returning the received file
- * descriptor. The file descriptor must have been sent via guacd_send_fd. If an
- * error occurs, -1 is returned, and errno will be set appropriately.
+ * descriptor and storing the details sent along with it. The file descriptor
+ * must have been sent via guacd_send_fd. If an error occurs, -1 is returned,
+ * and errno will be set appropriately.
  *
  * @param sock
  *     The file descriptor of an open UNIX domain socket along which the file
  *     descriptor will be sent (by guacd_send_fd()).
  *
+ * @param details
+ *     The guacd_fd_details structure to populate with the details sent along
+ *     with the file descriptor.
+ *
  * @return
  *     The received file descriptor, or -1 if an error occurs preventing
  *     receipt of the file descriptor.
  */
-int guacd_recv_fd(int sock);
+int guacd_recv_fd(int sock, guacd_fd_details* details);
 
 #endif
 
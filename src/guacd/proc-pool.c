@@ -0,0 +1,323 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "conf.h"
+#include "log.h"
+#include "metrics.h"
+#include "proc.h"
+#include "proc-pool.h"
+
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+#include <guacamole/string.h>
+#include <guacamole/timestamp.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+void guacd_proc_pool_discard(guacd_proc* proc) {
+
+    /* Force process to stop and clean up */
+    guacd_proc_stop(proc);
+
+    /* Retain any metrics recorded by the process */
+    guacd_metrics_release(proc->metrics);
+
+    /* Free skeleton client */
+    guac_client_free(proc->client);
+
+    close(proc->fd_socket);
+    guac_mem_free(proc);
+
+}
+
+/**
+ * Returns the protocol within the given pool that should next receive a new
+ * pre-forked process, if any. The lock of the pool MUST be held.
+ *
+ * @param pool
+ *     The pool to search.
+ *
+ * @param now
+ *     The current time.
+ *
+ * @param next_retry
+ *     A pointer to a guac_timestamp which will receive the earliest time that
+ *     a protocol currently waiting to retry may again receive a new process,
+ *     or zero if no protocols are waiting to retry.
+ *
+ * @return
+ *     The protocol which should next receive a new process, or NULL if no
+ *     protocol should currently receive a new process.
+ */
+static guacd_proc_pool_protocol* guacd_proc_pool_next(guacd_proc_pool* pool,
+        guac_timestamp now, guac_timestamp* next_retry) {
+
+    guacd_proc_pool_protocol* next = NULL;
+    *next_retry = 0;
+
+    for (int i = 0; i < pool->protocol_count; i++) {
+
+        guacd_proc_pool_protocol* current = &pool->protocols[i];
+        if (current->idle_count >= current->size)
+            continue;
+
+        /* Skip protocols that recently failed to initialize */
+        if (current->retry_after > now) {
+            if (*next_retry == 0 || current->retry_after < *next_retry)
+                *next_retry = current->retry_after;
+            continue;
+        }
+
+        /* Refill the emptiest pool first */
+        if (next == NULL || current->idle_count < next->idle_count)
+            next = current;
+
+    }
+
+    return next;
+
+}
+
+/**
+ * Waits for the given pool to be modified, or until the given time,
+ * whichever comes first. The lock of the pool MUST be held.
+ *
+ * @param pool
+ *     The pool to wait for.
+ *
+ * @param until
+ *     The time at which to stop waiting, or zero to potentially wait
+ *     indefinitely.
+ */
+static void guacd_proc_pool_wait(guacd_proc_pool* pool, guac_timestamp until) {
+
+    if (until == 0) {
+        pthread_cond_wait(&pool->modified, &pool->lock);
+        return;
+    }
+
+    struct timeval current_time;
+    gettimeofday(&current_time, NULL);
+
+    /* Convert the relative wait into an absolute deadline */
+    guac_timestamp remaining = until - guac_timestamp_current();
+    if (remaining <= 0)
+        return;
+
+    long usec = current_time.tv_usec + (remaining % 1000) * 1000;
+    struct timespec deadline = {
+        .tv_sec  = current_time.tv_sec + remaining / 1000 + usec / 1000000,
+        .tv_nsec = (usec % 1000000) * 1000
+    };
+
+    pthread_cond_timedwait(&pool->modified, &pool->lock, &deadline);
+
+}
+
+/**
+ * Thread which keeps the given pool filled, creating new processes for each
+ * protocol as processes are taken from the pool.
+ *
+ * @param data
+ *     The guacd_proc_pool to fill.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guacd_proc_pool_refill_thread(void* data) {
+
+    guacd_proc_pool* pool = (guacd_proc_pool*) data;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (!pool->stopping) {
+
+        guac_timestamp next_retry;
+        guacd_proc_pool_protocol* protocol = guacd_proc_pool_next(pool,
+                guac_timestamp_current(), &next_retry);
+
+        if (protocol == NULL) {
+            guacd_proc_pool_wait(pool, next_retry);
+            continue;
+        }
+
+        /* The protocol name is never modified or freed while the refill
+         * thread is running, and may safely be used without the lock */
+        const char* name = protocol->protocol;
+        pthread_mutex_unlock(&pool->lock);
+
+        /* Create and fully initialize a process before making it available,
+         * such that taking a process from the pool never waits */
+        guac_timestamp start = guac_timestamp_current();
+        guacd_proc* proc = guacd_create_proc(name);
+        int failed = (proc == NULL || guacd_proc_wait_ready(proc, GUACD_TIMEOUT));
+
+        if (proc != NULL && !failed)
+            guacd_log(GUAC_LOG_DEBUG, "Pre-forked process for protocol \"%s\" "
+                    "(connection \"%s\") ready after %i ms.", name,
+                    proc->client->connection_id,
+                    (int) (guac_timestamp_current() - start));
+
+        pthread_mutex_lock(&pool->lock);
+
+        if (failed) {
+            guacd_log(GUAC_LOG_WARNING, "Unable to pre-fork a process for "
+                    "protocol \"%s\". Retrying in %i seconds.", name,
+                    GUACD_PROC_POOL_RETRY_INTERVAL / 1000);
+            protocol->retry_after = guac_timestamp_current()
+                + GUACD_PROC_POOL_RETRY_INTERVAL;
+        }
+
+        else if (!pool->stopping && protocol->idle_count < protocol->size) {
+            protocol->idle[protocol->idle_count++] = proc;
+            proc = NULL;
+        }
+
+        /* Discard any process that could not be added to the pool */
+        if (proc != NULL) {
+            pthread_mutex_unlock(&pool->lock);
+            guacd_proc_pool_discard(proc);
+            pthread_mutex_lock(&pool->lock);
+        }
+
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+
+}
+
+guacd_proc_pool* guacd_proc_pool_alloc(guacd_config* config) {
+
+    guacd_proc_pool* pool = guac_mem_zalloc(sizeof(guacd_proc_pool));
+
+    for (int i = 0; i < config->prefork_protocols; i++) {
+
+        guacd_prefork_config* prefork = &config->prefork[i];
+        if (prefork->size <= 0)
+            continue;
+
+        guacd_proc_pool_protocol* protocol = &pool->protocols[pool->protocol_count++];
+        protocol->protocol = guac_strdup(prefork->protocol);
+        protocol->size = prefork->size;
+
+        guacd_log(GUAC_LOG_INFO, "Keeping %i pre-forked process(es) ready for "
+                "protocol \"%s\".", protocol->size, protocol->protocol);
+
+    }
+
+    /* No pool is needed if no processes will be pre-forked */
+    if (pool->protocol_count == 0) {
+        guac_mem_free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->modified, NULL);
+
+    if (pthread_create(&pool->refill_thread, NULL,
+                guacd_proc_pool_refill_thread, pool)) {
+
+        guacd_log(GUAC_LOG_ERROR, "Unable to start thread for pre-forking "
+                "processes. Processes will not be pre-forked.");
+
+        pthread_cond_destroy(&pool->modified);
+        pthread_mutex_destroy(&pool->lock);
+
+        for (int i = 0; i < pool->protocol_count; i++)
+            guac_mem_free(pool->protocols[i].protocol);
+
+        guac_mem_free(pool);
+        return NULL;
+
+    }
+
+    return pool;
+
+}
+
+guacd_proc* guacd_proc_pool_take(guacd_proc_pool* pool, const char* protocol) {
+
+    if (pool == NULL)
+        return NULL;
+
+    guacd_proc* proc = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+
+    for (int i = 0; i < pool->protocol_count; i++) {
+
+        guacd_proc_pool_protocol* current = &pool->protocols[i];
+        if (strcmp(current->protocol, protocol) != 0)
+            continue;
+
+        /* Use the oldest process first */
+        if (current->idle_count > 0) {
+            proc = current->idle[0];
+            memmove(current->idle, current->idle + 1,
+                    (current->idle_count - 1) * sizeof(guacd_proc*));
+            current->idle_count--;
+            pthread_cond_signal(&pool->modified);
+        }
+
+        break;
+
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return proc;
+
+}
+
+void guacd_proc_pool_free(guacd_proc_pool* pool) {
+
+    if (pool == NULL)
+        return;
+
+    /* Stop refilling the pool */
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_signal(&pool->modified);
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_join(pool->refill_thread, NULL);
+
+    /* Terminate all processes that never received a user */
+    for (int i = 0; i < pool->protocol_count; i++) {
+
+        guacd_proc_pool_protocol* protocol = &pool->protocols[i];
+        for (int j = 0; j < protocol->idle_count; j++)
+            guacd_proc_pool_discard(protocol->idle[j]);
+
+        guac_mem_free(protocol->protocol);
+
+    }
+
+    pthread_cond_destroy(&pool->modified);
+    pthread_mutex_destroy(&pool->lock);
+    guac_mem_free(pool);
+
+}
@@ -0,0 +1,166 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUACD_PROC_POOL_H
+#define GUACD_PROC_POOL_H
+
+#include "conf.h"
+#include "proc.h"
+
+#include <guacamole/timestamp.h>
+
+#include <pthread.h>
+
+/**
+ * The number of milliseconds to wait before again attempting to pre-fork a
+ * process for a protocol whose process most recently failed to initialize.
+ */
+#define GUACD_PROC_POOL_RETRY_INTERVAL 30000
+
+/**
+ * The set of idle, pre-forked processes maintained for a single protocol.
+ */
+typedef struct guacd_proc_pool_protocol {
+
+    /**
+     * The name of the protocol.
+     */
+    char* protocol;
+
+    /**
+     * The number of processes that should be kept ready.
+     */
+    int size;
+
+    /**
+     * The processes that are ready and waiting for their first user, in the
+     * order they were created.
+     */
+    guacd_proc* idle[GUACD_PREFORK_MAX_SIZE];
+
+    /**
+     * The number of processes within the idle array.
+     */
+    int idle_count;
+
+    /**
+     * The time before which no further processes should be pre-forked for
+     * this protocol, due to a recent failure to initialize a process, or
+     * zero if there is no such restriction.
+     */
+    guac_timestamp retry_after;
+
+} guacd_proc_pool_protocol;
+
+/**
+ * A pool of pre-forked processes which have already loaded the client plugins
+ * for their respective protocols, allowing new connections to skip the cost
+ * of forking and plugin initialization. Processes taken from the pool are
+ * replaced in the background.
+ */
+typedef struct guacd_proc_pool {
+
+    /**
+     * The protocols for which processes are maintained.
+     */
+    guacd_proc_pool_protocol protocols[GUACD_PREFORK_MAX_PROTOCOLS];
+
+    /**
+     * The number of entries within the protocols array.
+     */
+    int protocol_count;
+
+    /**
+     * Lock which guards access to all other members of this structure.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled whenever a process is taken from the pool,
+     * or when the pool is being freed.
+     */
+    pthread_cond_t modified;
+
+    /**
+     * The thread which creates processes to refill the pool.
+     */
+    pthread_t refill_thread;
+
+    /**
+     * Non-zero if the pool is being freed and no further processes should be
+     * created, zero otherwise.
+     */
+    int stopping;
+
+} guacd_proc_pool;
+
+/**
+ * Allocates a new pool of pre-forked processes, as configured within the
+ * given guacd configuration, and begins filling that pool in the background.
+ * If no pre-forked processes are configured, NULL is returned.
+ *
+ * @param config
+ *     The guacd configuration describing the number of processes to keep
+ *     ready for each protocol.
+ *
+ * @return
+ *     A newly-allocated pool of pre-forked processes, or NULL if no
+ *     pre-forked processes are configured or the pool could not be created.
+ */
+guacd_proc_pool* guacd_proc_pool_alloc(guacd_config* config);
+
+/**
+ * Removes and returns a ready, pre-forked process for the given protocol from
+ * the given pool, if any. The pool will be refilled in the background. The
+ * returned process must be managed and freed by the caller exactly as if it
+ * had been returned by guacd_create_proc().
+ *
+ * @param pool
+ *     The pool to take a process from, or NULL if there is no pool.
+ *
+ * @param protocol
+ *     The protocol that the process must have been initialized for.
+ *
+ * @return
+ *     A pre-forked process for the given protocol, or NULL if no such process
+ *     is currently ready.
+ */
+guacd_proc* guacd_proc_pool_take(guacd_proc_pool* pool, const char* protocol);
+
+/**
+ * Stops refilling the given pool, terminates all idle processes within the
+ * pool, and frees the pool.
+ *
+ * @param pool
+ *     The pool to free.
+ */
+void guacd_proc_pool_free(guacd_proc_pool* pool);
+
+/**
+ * Terminates the given child process, waiting for it to exit, and frees all
+ * parent-side resources associated with that process. This function must be
+ * called by the parent process, and only for processes that were never
+ * successfully given a user.
+ *
+ * @param proc
+ *     The process to discard.
+ */
+void guacd_proc_pool_discard(guacd_proc* proc);
+
+#endif
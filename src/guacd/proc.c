@@ -19,7 +19,9 @@
 
 #include "config.h"
 
+#include "first-frame.h"
 #include "log.h"
+#include "metrics.h"
 #include "move-fd.h"
 #include "proc.h"
 #include "proc-map.h"
@@ -31,9 +33,11 @@
 #include <guacamole/plugin.h>
 #include <guacamole/protocol.h>
 #include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
 #include <guacamole/user.h>
 
 #include <errno.h>
+#include <poll.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdlib.h>
@@ -64,8 +68,36 @@ typedef struct guacd_user_thread_params {
      */
     int owner;
 
+    /**
+     * Details describing how the joining user was routed to this process.
+     */
+    guacd_fd_details details;
+
 } guacd_user_thread_params;
 
+/**
+ * Logs the time taken for a user to receive their first frame, measured from
+ * the time the user was routed to this process. As this is measured within
+ * the process itself, the time logged is the same regardless of whether the
+ * user's connection is proxied by guacd or was passed to this process
+ * directly.
+ *
+ * @param data
+ *     A pointer to the guacd_user_thread_params structure of the user that
+ *     has received their first frame.
+ */
+static void guacd_user_first_frame(void* data) {
+
+    guacd_user_thread_params* params = (guacd_user_thread_params*) data;
+
+    guacd_log(GUAC_LOG_INFO, "User of connection \"%s\" received first "
+            "frame %i ms after connecting (%s).",
+            params->proc->client->connection_id,
+            (int) (guac_timestamp_current() - params->details.routed),
+            params->details.process_type);
+
+}
+
 /**
  * Handles a user's entire connection and socket lifecycle.
  *
@@ -89,6 +121,9 @@ static void* guacd_user_thread(void* data) {
     if (socket == NULL)
         return NULL;
 
+    /* Report when the user receives their first frame */
+    socket = guacd_first_frame_socket(socket, guacd_user_first_frame, params);
+
     /* Create skeleton user */
     guac_user* user = guac_user_alloc();
     user->socket = socket;
@@ -128,13 +163,19 @@ static void* guacd_user_thread(void* data) {
  * @param owner
  *     Non-zero if the user is the owner of the connection being joined (they
  *     are the first user to join), or zero otherwise.
+ *
+ * @param details
+ *     The details received along with the given file descriptor, describing
+ *     how the user was routed to this process.
  */
-static void guacd_proc_add_user(guacd_proc* proc, int fd, int owner) {
+static void guacd_proc_add_user(guacd_proc* proc, int fd, int owner,
+        const guacd_fd_details* details) {
 
     guacd_user_thread_params* params = guac_mem_alloc(sizeof(guacd_user_thread_params));
     params->proc = proc;
     params->fd = fd;
     params->owner = owner;
+    params->details = *details;
 
     /* Start user thread */
     pthread_t user_thread;
@@ -308,6 +349,27 @@ static void signal_stop_handler(int signal) {
 
 }
 
+/**
+ * Informs the parent process of the status of initialization of the given
+ * process. This function must be called by the child process.
+ *
+ * @param proc
+ *     The process being initialized.
+ *
+ * @param status
+ *     The status to send, either GUACD_PROC_STATUS_READY or
+ *     GUACD_PROC_STATUS_FAILED.
+ */
+static void guacd_proc_notify(guacd_proc* proc, char status) {
+
+    /* The parent need not be listening, and must never cause the child to
+     * block */
+    if (send(proc->fd_socket, &status, sizeof(status), MSG_DONTWAIT) < 0)
+        guacd_log(GUAC_LOG_DEBUG, "Unable to notify parent of process "
+                "status: %s", strerror(errno));
+
+}
+
 /**
  * Starts protocol-specific handling on the given process by loading the client
  * plugin for that protocol. This function does NOT return. It initializes the
@@ -333,6 +395,9 @@ static void guacd_exec_proc(guacd_proc* proc, const char* protocol) {
         goto cleanup_process;
     }
 
+    /* Record metrics in storage visible to the parent, if any */
+    guac_metrics_attach(proc->metrics);
+
     /* Init client for selected protocol */
     guac_client* client = proc->client;
     if (guac_client_load_plugin(client, protocol)) {
@@ -345,9 +410,13 @@ static void guacd_exec_proc(guacd_proc* proc, const char* protocol) {
             guacd_log_guac_error(GUAC_LOG_ERROR,
                     "Unable to load client plugin");
 
+        guacd_proc_notify(proc, GUACD_PROC_STATUS_FAILED);
         goto cleanup_client;
     }
 
+    /* Users may now be added without waiting for the plugin to load */
+    guacd_proc_notify(proc, GUACD_PROC_STATUS_READY);
+
     /* The first file descriptor is the owner */
     int owner = 1;
 
@@ -363,9 +432,10 @@ static void guacd_exec_proc(guacd_proc* proc, const char* protocol) {
 
     /* Add each received file descriptor as a new user */
     int received_fd;
-    while ((received_fd = guacd_recv_fd(proc->fd_socket)) != -1) {
+    guacd_fd_details details;
+    while ((received_fd = guacd_recv_fd(proc->fd_socket, &details)) != -1) {
 
-        guacd_proc_add_user(proc, received_fd, owner);
+        guacd_proc_add_user(proc, received_fd, owner, &details);
 
         /* Future file descriptors are not owners */
         owner = 0;
@@ -450,12 +520,17 @@ guacd_proc* guacd_create_proc(const char* protocol) {
     /* Init logging */
     proc->client->log_handler = guacd_client_log;
 
+    /* Reserve storage for metrics before forking, such that the storage is
+     * shared with the child */
+    proc->metrics = guacd_metrics_claim(proc->client->connection_id, protocol);
+
     /* Fork */
     proc->pid = fork();
     if (proc->pid < 0) {
         guacd_log(GUAC_LOG_ERROR, "Cannot fork child process: %s", strerror(errno));
         close(parent_socket);
         close(child_socket);
+        guacd_metrics_release(proc->metrics);
         guac_client_free(proc->client);
         guac_mem_free(proc);
         return NULL;
@@ -486,6 +561,32 @@ guacd_proc* guacd_create_proc(const char* protocol) {
 
 }
 
+int guacd_proc_wait_ready(guacd_proc* proc, int msec_timeout) {
+
+    struct pollfd fd_socket = {
+        .fd = proc->fd_socket,
+        .events = POLLIN
+    };
+
+    /* Wait for the child to report its status */
+    int retval;
+    while ((retval = poll(&fd_socket, 1, msec_timeout)) < 0 && errno == EINTR);
+
+    if (retval == 0) {
+        guacd_log(GUAC_LOG_WARNING, "Process for connection \"%s\" did not "
+                "finish initializing within %i ms.",
+                proc->client->connection_id, msec_timeout);
+        return 1;
+    }
+
+    char status;
+    if (retval < 0 || recv(proc->fd_socket, &status, sizeof(status), 0) != 1)
+        return 1;
+
+    return status != GUACD_PROC_STATUS_READY;
+
+}
+
 /**
  * Kill the provided child guacd process. This function must be called by the
  * parent process, and will block until all processes associated with the
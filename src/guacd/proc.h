@@ -21,6 +21,7 @@
 #define GUACD_PROC_H
 
 #include <guacamole/client.h>
+#include <guacamole/metrics.h>
 #include <guacamole/parser.h>
 
 #include <unistd.h>
@@ -46,6 +47,19 @@
  */
 #define GUACD_CLIENT_FREE_TIMEOUT 5
 
+/**
+ * The status byte sent by a child process to its parent along fd_socket once
+ * the client plugin for its protocol has been loaded successfully.
+ */
+#define GUACD_PROC_STATUS_READY 'R'
+
+/**
+ * The status byte sent by a child process to its parent along fd_socket if
+ * the client plugin for its protocol could not be loaded. The child process
+ * exits immediately after sending this status.
+ */
+#define GUACD_PROC_STATUS_FAILED 'F'
+
 /**
  * Process information of the internal remote desktop client.
  */
@@ -76,6 +90,13 @@ typedef struct guacd_proc {
      */
     guac_client* client;
 
+    /**
+     * Storage shared between the parent and child processes which receives
+     * all metrics recorded by the child process, or NULL if metrics are not
+     * being recorded for this process.
+     */
+    guac_metrics* metrics;
+
 } guacd_proc;
 
 /**
@@ -94,6 +115,24 @@ typedef struct guacd_proc {
  */
 guacd_proc* guacd_create_proc(const char* protocol);
 
+/**
+ * Waits for the given child process to finish loading the client plugin for
+ * its protocol, such that users added to the process will not wait for that
+ * initialization. This function must be called by the parent process.
+ *
+ * @param proc
+ *     The process to wait for.
+ *
+ * @param msec_timeout
+ *     The maximum amount of time to wait, in milliseconds.
+ *
+ * @return
+ *     Zero if the process is ready to accept users, non-zero if the process
+ *     failed to initialize or did not finish initializing within the time
+ *     allowed.
+ */
+int guacd_proc_wait_ready(guacd_proc* proc, int msec_timeout);
+
 /**
  * Signals the given process to stop accepting new users and clean up. This
  * will eventually cause the child process to exit.
@@ -0,0 +1,40 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "conf-parse.h"
+
+#include <CUnit/CUnit.h>
+
+/**
+ * Verifies that guacd_parse_boolean() accepts only "true" and "false", such
+ * that options like "kernel_tls" remain disabled unless explicitly enabled.
+ */
+void test_conf__parse_boolean(void) {
+
+    CU_ASSERT_EQUAL(guacd_parse_boolean("true"), 1);
+    CU_ASSERT_EQUAL(guacd_parse_boolean("false"), 0);
+
+    CU_ASSERT_EQUAL(guacd_parse_boolean(""), -1);
+    CU_ASSERT_EQUAL(guacd_parse_boolean("1"), -1);
+    CU_ASSERT_EQUAL(guacd_parse_boolean("yes"), -1);
+    CU_ASSERT_EQUAL(guacd_parse_boolean("TRUE"), -1);
+    CU_ASSERT_EQUAL(guacd_parse_boolean("true "), -1);
+
+}
+
@@ -0,0 +1,175 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "first-frame.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * The number of times the first frame handler has been invoked.
+ */
+static int reports;
+
+/**
+ * Handler which counts the number of times it is invoked.
+ */
+static void count_report(void* data) {
+    reports++;
+}
+
+/**
+ * Opens a guac_socket which reports its first frame using count_report(),
+ * wrapping a buffered guac_socket which writes to a pipe. The read end of
+ * that pipe is stored within the given file descriptor.
+ *
+ * @param read_fd
+ *     Pointer to the int which should receive the read end of the pipe.
+ *
+ * @return
+ *     A newly-allocated guac_socket which must be freed with
+ *     guac_socket_free().
+ */
+static guac_socket* open_socket(int* read_fd) {
+
+    int fds[2];
+    CU_ASSERT_EQUAL_FATAL(pipe(fds), 0);
+
+    /* Never block reading data that has not been written */
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    *read_fd = fds[0];
+
+    reports = 0;
+    return guacd_first_frame_socket(guac_socket_open(fds[1]),
+            count_report, NULL);
+
+}
+
+/**
+ * Verifies that the data read from the given pipe is exactly the given
+ * string, and then closes the pipe.
+ *
+ * @param fd
+ *     The read end of the pipe.
+ *
+ * @param expected
+ *     The data expected to have been written to the pipe.
+ */
+static void verify_written(int fd, const char* expected) {
+
+    char buffer[1024];
+    int length = read(fd, buffer, sizeof(buffer));
+
+    CU_ASSERT_EQUAL(length, strlen(expected));
+    if (length == strlen(expected))
+        CU_ASSERT_NSTRING_EQUAL(buffer, expected, length);
+
+    close(fd);
+
+}
+
+/**
+ * Verifies that the first frame is reported exactly once, only after that
+ * frame has been flushed, and that all data is passed through unchanged.
+ */
+void test_first_frame__report(void) {
+
+    int read_fd;
+    guac_socket* socket = open_socket(&read_fd);
+
+    guac_protocol_send_size(socket, GUAC_DEFAULT_LAYER, 1024, 768);
+    guac_socket_flush(socket);
+    CU_ASSERT_EQUAL(reports, 0);
+
+    /* A written but unflushed frame has not yet been received */
+    guac_protocol_send_sync(socket, 1234, 1);
+    CU_ASSERT_EQUAL(reports, 0);
+
+    guac_socket_flush(socket);
+    CU_ASSERT_EQUAL(reports, 1);
+
+    /* Only the first frame is reported */
+    guac_protocol_send_sync(socket, 5678, 1);
+    guac_socket_flush(socket);
+    CU_ASSERT_EQUAL(reports, 1);
+
+    guac_socket_free(socket);
+
+    verify_written(read_fd, "4.size,1.0,4.1024,3.768;"
+            "4.sync,4.1234,1.1;"
+            "4.sync,4.5678,1.1;");
+
+}
+
+/**
+ * Verifies that a "sync" instruction is found even if it is split across
+ * several writes and flushes, and even if it is the very first instruction.
+ */
+void test_first_frame__split(void) {
+
+    int read_fd;
+    guac_socket* socket = open_socket(&read_fd);
+
+    guac_socket_write_string(socket, "4.size,1.0,1.1,1.1;4.sy");
+    guac_socket_flush(socket);
+    CU_ASSERT_EQUAL(reports, 0);
+
+    guac_socket_write_string(socket, "nc,1.0,1.1;");
+    guac_socket_flush(socket);
+    CU_ASSERT_EQUAL(reports, 1);
+
+    guac_socket_free(socket);
+    verify_written(read_fd, "4.size,1.0,1.1,1.1;4.sync,1.0,1.1;");
+
+    /* The start of the stream behaves as the end of an instruction */
+    socket = open_socket(&read_fd);
+
+    guac_socket_write_string(socket, "4.sync,1.0,1.1;");
+    guac_socket_flush(socket);
+    CU_ASSERT_EQUAL(reports, 1);
+
+    guac_socket_free(socket);
+    verify_written(read_fd, "4.sync,1.0,1.1;");
+
+}
+
+/**
+ * Verifies that data resembling a "sync" instruction within the arguments of
+ * another instruction is not mistaken for the first frame.
+ */
+void test_first_frame__arguments(void) {
+
+    int read_fd;
+    guac_socket* socket = open_socket(&read_fd);
+
+    guac_protocol_send_name(socket, "4.sync,");
+    guac_socket_flush(socket);
+    CU_ASSERT_EQUAL(reports, 0);
+
+    guac_socket_free(socket);
+    verify_written(read_fd, "4.name,7.4.sync,;");
+
+}
+
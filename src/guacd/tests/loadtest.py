@@ -0,0 +1,244 @@
+#!/usr/bin/env python3
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+
+"""
+Load test for the guacd acceptor, holding many idle or half-open connections
+while verifying that a real handshake is still answered promptly.
+
+This is not run by "make check". To reproduce the numbers reported for the
+epoll-based acceptor, build guacd and run it in the foreground on loopback:
+
+    ./configure && make
+    ulimit -n 8192
+    src/guacd/guacd -f -b 127.0.0.1 -l 4822 -L info &
+
+Then, from the same shell (such that $! is the PID of guacd), run this script
+against that guacd:
+
+    python3 src/guacd/tests/loadtest.py --pid $! --clients 3000
+
+The script reports, for the guacd process given with --pid, the number of
+threads and the resident memory (RSS). It reports them at each stage:
+
+1. before connecting;
+2. while holding the given number of connections (one in four of which has
+   sent a partial "select" instruction);
+3. after a real handshake has been routed;
+4. after all connections are closed.
+
+It also reports how quickly the held connections were accepted, and how long
+the real handshake took to be answered.
+
+With --timeout, the script also waits for guacd to close the held connections
+itself (by default, guacd allows 15 seconds for each handshake). It then
+reports how many connections guacd closed.
+
+Without --pid, thread and memory usage are not reported. Reading
+/proc/PID/status requires Linux and permission to inspect the guacd process.
+"""
+
+import argparse
+import resource
+import select
+import socket
+import sys
+import time
+
+
+def process_status(pid):
+    """
+    Returns a description of the thread count and resident memory of the
+    process having the given PID, or an empty string if no PID is given.
+    """
+
+    if pid is None:
+        return ""
+
+    status = {}
+    with open("/proc/%d/status" % pid) as status_file:
+        for line in status_file:
+            key, value = line.split(":", 1)
+            status[key] = value.strip()
+
+    return " (threads=%s, rss=%s)" % (status["Threads"], status["VmRSS"])
+
+
+def report(pid, stage):
+    """
+    Prints the given stage of the test, along with the current thread count
+    and resident memory of guacd.
+    """
+    print("%-32s%s" % (stage, process_status(pid)))
+    sys.stdout.flush()
+
+
+def raise_file_limit(required):
+    """
+    Raises the soft limit on open files to at least the given number, up to
+    the hard limit, exiting with an error if that is not sufficient.
+    """
+
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    if soft < required:
+        if hard != resource.RLIM_INFINITY:
+            required = min(required, hard)
+        resource.setrlimit(resource.RLIMIT_NOFILE, (required, hard))
+        soft = required
+
+    return soft
+
+
+def open_clients(args):
+    """
+    Opens the requested number of connections to guacd, sending a partial
+    "select" instruction along every fourth connection. Returns the list of
+    open sockets and the time taken to open them, in seconds.
+    """
+
+    clients = []
+    start = time.monotonic()
+
+    for i in range(args.clients):
+        client = socket.create_connection((args.host, args.port))
+        if i % 4 == 0:
+            client.sendall(b"6.sel")
+        clients.append(client)
+
+    return clients, time.monotonic() - start
+
+
+def handshake(args):
+    """
+    Performs a real handshake, selecting a connection which does not exist,
+    and returns the reply received (if any) and the time taken to receive it,
+    in seconds.
+    """
+
+    start = time.monotonic()
+    client = socket.create_connection((args.host, args.port))
+    client.settimeout(args.reply_timeout)
+    client.sendall(b"6.select,4.$foo;")
+
+    try:
+        reply = client.recv(100)
+    except socket.timeout:
+        reply = None
+
+    elapsed = time.monotonic() - start
+    client.close()
+
+    return reply, elapsed
+
+
+def count_closed(clients, timeout):
+    """
+    Waits up to the given number of seconds for the given connections to be
+    closed by guacd, returning the number of connections closed.
+    """
+
+    remaining = {client.fileno(): client for client in clients}
+    closed = 0
+    deadline = time.monotonic() + timeout
+
+    poll = select.poll()
+    for fd in remaining:
+        poll.register(fd, select.POLLIN)
+
+    while remaining and time.monotonic() < deadline:
+
+        # Connections closed by guacd become readable, reading any "error"
+        # instruction sent before the connection is closed first
+        for fd, _ in poll.poll(1000):
+            try:
+                data = remaining[fd].recv(4096)
+            except ConnectionResetError:
+                data = b""
+
+            if data == b"":
+                poll.unregister(fd)
+                del remaining[fd]
+                closed += 1
+
+    return closed
+
+
+def main():
+
+    parser = argparse.ArgumentParser(
+        description="Hold many idle or half-open connections to guacd.")
+    parser.add_argument("--host", default="127.0.0.1",
+                        help="address of guacd (default: %(default)s)")
+    parser.add_argument("--port", type=int, default=4822,
+                        help="port of guacd (default: %(default)s)")
+    parser.add_argument("--pid", type=int,
+                        help="PID of guacd, for reporting threads and RSS")
+    parser.add_argument("--clients", type=int, default=3000,
+                        help="number of connections held "
+                             "(default: %(default)s)")
+    parser.add_argument("--hold", type=float, default=2,
+                        help="seconds to hold connections before the real "
+                             "handshake (default: %(default)s)")
+    parser.add_argument("--reply-timeout", type=float, default=10,
+                        help="seconds to wait for the handshake reply "
+                             "(default: %(default)s)")
+    parser.add_argument("--timeout", type=float,
+                        help="additionally wait up to this many seconds for "
+                             "guacd to close the held connections itself")
+    args = parser.parse_args()
+
+    limit = raise_file_limit(args.clients + 64)
+    if limit < args.clients + 16:
+        sys.exit("Open file limit (%d) is too low for %d clients."
+                 % (limit, args.clients))
+
+    report(args.pid, "Before connecting")
+
+    clients, elapsed = open_clients(args)
+    print("Accepted %d connections in %.3f s (%.0f connections/s)"
+          % (len(clients), elapsed, len(clients) / elapsed))
+
+    time.sleep(args.hold)
+    report(args.pid, "Holding %d connections" % len(clients))
+
+    reply, elapsed = handshake(args)
+    if reply is None:
+        print("No reply to handshake within %.0f s" % args.reply_timeout)
+    else:
+        print("Handshake answered in %.3f s: %r" % (elapsed, reply[:60]))
+
+    time.sleep(1)
+    report(args.pid, "After routing handshake")
+
+    if args.timeout is not None:
+        closed = count_closed(clients, args.timeout)
+        print("guacd closed %d of %d connections within %.0f s"
+              % (closed, len(clients), args.timeout))
+
+    for client in clients:
+        client.close()
+
+    time.sleep(2)
+    report(args.pid, "After closing")
+
+    return 0 if reply is not None else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
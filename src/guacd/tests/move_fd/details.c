@@ -0,0 +1,102 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "move-fd.h"
+
+#include <CUnit/CUnit.h>
+
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * Sends one end of a pipe, along with the given details, over a datagram
+ * socket pair as guacd does when adding a user to a process, verifying that
+ * the received file descriptor refers to that same pipe. The details
+ * received are stored in the given structure.
+ *
+ * @param sent
+ *     The details to send.
+ *
+ * @param received
+ *     The structure to populate with the details received.
+ */
+static void send_and_receive(const guacd_fd_details* sent,
+        guacd_fd_details* received) {
+
+    int sockets[2];
+    int pipe_fds[2];
+    char buffer[4];
+
+    CU_ASSERT_EQUAL_FATAL(socketpair(AF_UNIX, SOCK_DGRAM, 0, sockets), 0);
+    CU_ASSERT_EQUAL_FATAL(pipe(pipe_fds), 0);
+
+    CU_ASSERT_TRUE(guacd_send_fd(sockets[0], pipe_fds[1], sent));
+    close(pipe_fds[1]);
+
+    int fd = guacd_recv_fd(sockets[1], received);
+    CU_ASSERT_NOT_EQUAL_FATAL(fd, -1);
+
+    /* The received file descriptor is the write end of the same pipe */
+    CU_ASSERT_EQUAL(write(fd, "test", 4), 4);
+    CU_ASSERT_EQUAL(read(pipe_fds[0], buffer, sizeof(buffer)), 4);
+    CU_ASSERT_NSTRING_EQUAL(buffer, "test", 4);
+
+    close(fd);
+    close(pipe_fds[0]);
+    close(sockets[0]);
+    close(sockets[1]);
+
+}
+
+/**
+ * Verifies that the details sent along with a file descriptor are received
+ * unchanged alongside that file descriptor.
+ */
+void test_move_fd__details(void) {
+
+    guacd_fd_details sent = { .routed = 1234567890123 };
+    strcpy(sent.process_type, "pre-forked process");
+
+    guacd_fd_details received;
+    send_and_receive(&sent, &received);
+
+    CU_ASSERT_EQUAL(received.routed, sent.routed);
+    CU_ASSERT_STRING_EQUAL(received.process_type, "pre-forked process");
+
+}
+
+/**
+ * Verifies that the process description received along with a file
+ * descriptor is always null-terminated, even if the sender failed to
+ * terminate that description.
+ */
+void test_move_fd__unterminated(void) {
+
+    guacd_fd_details sent = { .routed = 0 };
+    memset(sent.process_type, 'x', sizeof(sent.process_type));
+
+    guacd_fd_details received;
+    send_and_receive(&sent, &received);
+
+    CU_ASSERT_EQUAL(strlen(received.process_type),
+            sizeof(received.process_type) - 1);
+
+}
+
@@ -21,17 +21,22 @@
 #include "display.h"
 #include "instructions.h"
 #include "log.h"
+#include "parse.h"
 
 #include <guacamole/client.h>
 #include <guacamole/error.h>
 #include <guacamole/parser.h>
+#include <guacamole/recording.h>
 #include <guacamole/socket.h>
 
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -49,12 +54,22 @@
  * @param socket
  *     The guac_socket through which instructions should be read.
  *
+ * @param start
+ *     The timestamp of the first frame that should be encoded. Frames with
+ *     earlier timestamps still update the display but are not written to
+ *     the video.
+ *
+ * @param end
+ *     The timestamp after which reading should stop, or a negative value if
+ *     all instructions should be read.
+ *
  * @return
  *     Zero on success, non-zero if parsing of Guacamole protocol data through
  *     the given socket fails.
  */
 static int guacenc_read_instructions(guacenc_display* display,
-        const char* path, guac_socket* socket) {
+        const char* path, guac_socket* socket,
+        guac_timestamp start, guac_timestamp end) {
 
     /* Obtain Guacamole protocol parser */
     guac_parser* parser = guac_parser_alloc();
@@ -63,6 +78,24 @@ static int guacenc_read_instructions(guacenc_display* display,
 
     /* Continuously read and handle all instructions */
     while (!guac_parser_read(parser, socket, -1)) {
+
+        /* Skip frames before the requested range, stopping entirely once
+         * the end of that range has been passed */
+        if (strcmp(parser->opcode, "sync") == 0 && parser->argc >= 1) {
+
+            guac_timestamp timestamp =
+                guacenc_parse_timestamp(parser->argv[0]);
+
+            if (end >= 0 && timestamp > end) {
+                guac_parser_free(parser);
+                return 0;
+            }
+
+            if (timestamp < start)
+                continue;
+
+        }
+
         if (guacenc_handle_instruction(display, parser->opcode,
                 parser->argc, parser->argv)) {
             guacenc_log(GUAC_LOG_DEBUG, "Handling of \"%s\" instruction "
@@ -84,8 +117,120 @@ static int guacenc_read_instructions(guacenc_display* display,
 
 }
 
+/**
+ * Reads the timestamp of the first frame of the recording at the given path.
+ * All times given to guacenc are relative to this timestamp.
+ *
+ * @param path
+ *     The path to the file containing the raw Guacamole protocol dump.
+ *
+ * @param timestamp
+ *     Pointer to a guac_timestamp that should receive the timestamp of the
+ *     first "sync" instruction within the recording.
+ *
+ * @return
+ *     Zero on success, non-zero if the recording cannot be read or does not
+ *     contain any frames.
+ */
+static int guacenc_read_first_sync(const char* path,
+        guac_timestamp* timestamp) {
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 1;
+
+    guac_socket* socket = guac_recording_socket_open(fd);
+    if (socket == NULL) {
+        close(fd);
+        return 1;
+    }
+
+    guac_parser* parser = guac_parser_alloc();
+    if (parser == NULL) {
+        guac_socket_free(socket);
+        return 1;
+    }
+
+    /* Read until the first frame boundary */
+    int result = 1;
+    while (!guac_parser_read(parser, socket, -1)) {
+        if (strcmp(parser->opcode, "sync") == 0 && parser->argc >= 1) {
+            *timestamp = guacenc_parse_timestamp(parser->argv[0]);
+            result = 0;
+            break;
+        }
+    }
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+    return result;
+
+}
+
+/**
+ * Repositions the given recording socket at the last keyframe before the
+ * given timestamp, as listed within the index of the recording. If the
+ * recording has no index, or the index lists no such keyframe, the socket
+ * is left unchanged and the recording will be decoded from the beginning.
+ *
+ * @param path
+ *     The path to the file containing the raw Guacamole protocol dump.
+ *
+ * @param socket
+ *     The recording socket to reposition, from which no data has yet been
+ *     read.
+ *
+ * @param timestamp
+ *     The timestamp of the first frame that should be encoded.
+ *
+ * @return
+ *     Zero on success, non-zero if the index lists a keyframe that could not
+ *     be reached.
+ */
+static int guacenc_seek(const char* path, guac_socket* socket,
+        guac_timestamp timestamp) {
+
+    /* Generate index filename */
+    char index_path[4096];
+    int len = snprintf(index_path, sizeof(index_path), "%s%s", path,
+            GUAC_RECORDING_INDEX_SUFFIX);
+
+    if (len >= sizeof(index_path))
+        return 0;
+
+    /* Decode from beginning if there is no index */
+    int index_fd = open(index_path, O_RDONLY);
+    if (index_fd < 0) {
+        guacenc_log(GUAC_LOG_INFO, "%s: No index available. The recording "
+                "will be decoded from the beginning.", path);
+        return 0;
+    }
+
+    /* Decode from beginning if there is no suitable keyframe */
+    uint64_t offset;
+    if (guac_recording_index_find(index_fd, timestamp, &offset)) {
+        close(index_fd);
+        return 0;
+    }
+
+    close(index_fd);
+
+    guacenc_log(GUAC_LOG_DEBUG, "%s: Seeking to keyframe at offset %" PRIu64
+            ".", path, offset);
+
+    if (guac_recording_socket_seek(socket, offset)) {
+        guacenc_log(GUAC_LOG_ERROR, "%s: %s: %s", path,
+                guac_error_message, guac_status_string(guac_error));
+        return 1;
+    }
+
+    return 0;
+
+}
+
 int guacenc_encode(const char* path, const char* out_path, const char* codec,
-        int width, int height, int bitrate, bool force) {
+        int width, int height, int bitrate, bool force,
+        guac_timestamp start, guac_timestamp end) {
 
     /* Open input file */
     int fd = open(path, O_RDONLY);
@@ -121,6 +266,23 @@ int guacenc_encode(const char* path, const char* out_path, const char* codec,
         return 1;
     }
 
+    /* Translate requested range into absolute timestamps */
+    if (start > 0 || end >= 0) {
+
+        guac_timestamp first_sync;
+        if (guacenc_read_first_sync(path, &first_sync)) {
+            guacenc_log(GUAC_LOG_ERROR, "%s: Recording does not contain "
+                    "any frames.", path);
+            close(fd);
+            return 1;
+        }
+
+        start += first_sync;
+        if (end >= 0)
+            end += first_sync;
+
+    }
+
     /* Allocate display for encoding process */
     guacenc_display* display = guacenc_display_alloc(out_path, codec,
             width, height, bitrate);
@@ -129,20 +291,27 @@ int guacenc_encode(const char* path, const char* out_path, const char* codec,
         return 1;
     }
 
-    /* Obtain guac_socket wrapping file descriptor */
-    guac_socket* socket = guac_socket_open(fd);
+    /* Obtain guac_socket reading the (possibly compressed) recording */
+    guac_socket* socket = guac_recording_socket_open(fd);
     if (socket == NULL) {
-        guacenc_log(GUAC_LOG_ERROR, "%s: %s", path,
-                guac_status_string(guac_error));
+        guacenc_log(GUAC_LOG_ERROR, "%s: %s: %s", path,
+                guac_error_message, guac_status_string(guac_error));
         close(fd);
         guacenc_display_free(display);
         return 1;
     }
 
+    /* Skip ahead to the requested starting point, if possible */
+    if (start > 0 && guacenc_seek(path, socket, start)) {
+        guac_socket_free(socket);
+        guacenc_display_free(display);
+        return 1;
+    }
+
     guacenc_log(GUAC_LOG_INFO, "Encoding \"%s\" to \"%s\" ...", path, out_path);
 
     /* Attempt to read all instructions in the file */
-    if (guacenc_read_instructions(display, path, socket)) {
+    if (guacenc_read_instructions(display, path, socket, start, end)) {
         guac_socket_free(socket);
         guacenc_display_free(display);
         return 1;
@@ -154,3 +323,52 @@ int guacenc_encode(const char* path, const char* out_path, const char* codec,
 
 }
 
+
+int guacenc_index(const char* path) {
+
+    /* Generate index filename */
+    char index_path[4096];
+    int len = snprintf(index_path, sizeof(index_path), "%s%s", path,
+            GUAC_RECORDING_INDEX_SUFFIX);
+
+    if (len >= sizeof(index_path)) {
+        guacenc_log(GUAC_LOG_ERROR, "Cannot write index for \"%s\": "
+                "Name too long", path);
+        return 1;
+    }
+
+    /* Open input file */
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        guacenc_log(GUAC_LOG_ERROR, "%s: %s", path, strerror(errno));
+        return 1;
+    }
+
+    /* Replace any existing index */
+    int index_fd = open(index_path, O_CREAT | O_WRONLY | O_TRUNC,
+            S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (index_fd < 0) {
+        guacenc_log(GUAC_LOG_ERROR, "%s: %s", index_path, strerror(errno));
+        close(fd);
+        return 1;
+    }
+
+    guacenc_log(GUAC_LOG_INFO, "Indexing \"%s\" to \"%s\" ...",
+            path, index_path);
+
+    /* Read entire recording, listing each keyframe */
+    int keyframes = guac_recording_index_rebuild(fd, index_fd);
+    close(index_fd);
+
+    if (keyframes < 0) {
+        guacenc_log(GUAC_LOG_ERROR, "%s: %s: %s", path,
+                guac_error_message, guac_status_string(guac_error));
+        return 1;
+    }
+
+    guacenc_log(GUAC_LOG_INFO, "%s: %i keyframe(s) indexed.", path,
+            keyframes);
+
+    return 0;
+
+}
@@ -20,6 +20,8 @@
 #ifndef GUACENC_ENCODE_H
 #define GUACENC_ENCODE_H
 
+#include <guacamole/timestamp.h>
+
 #include <stdbool.h>
 
 /**
@@ -52,12 +54,39 @@
  *     Perform the encoding, even if the input file appears to be an
  *     in-progress recording (has an associated lock).
  *
+ * @param start
+ *     The point in the recording at which encoding should begin, in
+ *     milliseconds relative to the first frame of the recording. If the
+ *     recording has an index, decoding begins at the last keyframe before
+ *     this point rather than at the beginning of the recording.
+ *
+ * @param end
+ *     The point in the recording at which encoding should end, in
+ *     milliseconds relative to the first frame of the recording, or a
+ *     negative value if the entire remainder of the recording should be
+ *     encoded.
+ *
  * @return
  *     Zero on success, non-zero if an error prevented successful encoding of
  *     the video.
  */
 int guacenc_encode(const char* path, const char* out_path, const char* codec,
-        int width, int height, int bitrate, bool force);
+        int width, int height, int bitrate, bool force,
+        guac_timestamp start, guac_timestamp end);
+
+/**
+ * Reads the given Guacamole protocol dump in its entirety, writing a new
+ * index of its keyframes to a file having the same name as the recording
+ * plus GUAC_RECORDING_INDEX_SUFFIX. Any existing index is replaced.
+ *
+ * @param path
+ *     The path to the file containing the raw Guacamole protocol dump.
+ *
+ * @return
+ *     Zero on success, non-zero if the recording could not be read or its
+ *     index could not be written.
+ */
+int guacenc_index(const char* path);
 
 #endif
 
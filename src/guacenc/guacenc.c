@@ -24,6 +24,7 @@
 #include "log.h"
 #include "parse.h"
 
+#include <guacamole/timestamp.h>
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 
@@ -37,13 +38,25 @@ int main(int argc, char* argv[]) {
 
     /* Load defaults */
     bool force = false;
+    bool index = false;
     int width = GUACENC_DEFAULT_WIDTH;
     int height = GUACENC_DEFAULT_HEIGHT;
     int bitrate = GUACENC_DEFAULT_BITRATE;
+    guac_timestamp start = 0;
+    guac_timestamp end = -1;
+
+    /* Options which are only available in long form */
+    static const struct option long_options[] = {
+        { "start", required_argument, NULL, 'S' },
+        { "end",   required_argument, NULL, 'E' },
+        { "index", no_argument,       NULL, 'i' },
+        { NULL,    0,                 NULL, 0   }
+    };
 
     /* Parse arguments */
     int opt;
-    while ((opt = getopt(argc, argv, "s:r:f")) != -1) {
+    while ((opt = getopt_long(argc, argv, "s:r:fi", long_options,
+                    NULL)) != -1) {
 
         /* -s: Dimensions (WIDTHxHEIGHT) */
         if (opt == 's') {
@@ -65,6 +78,26 @@ int main(int argc, char* argv[]) {
         else if (opt == 'f')
             force = true;
 
+        /* -i / --index: Rebuild index instead of encoding */
+        else if (opt == 'i')
+            index = true;
+
+        /* --start: Time to begin encoding ([[HH:]MM:]SS) */
+        else if (opt == 'S') {
+            if (guacenc_parse_time(optarg, &start)) {
+                guacenc_log(GUAC_LOG_ERROR, "Invalid start time.");
+                goto invalid_options;
+            }
+        }
+
+        /* --end: Time to stop encoding ([[HH:]MM:]SS) */
+        else if (opt == 'E') {
+            if (guacenc_parse_time(optarg, &end)) {
+                guacenc_log(GUAC_LOG_ERROR, "Invalid end time.");
+                goto invalid_options;
+            }
+        }
+
         /* Invalid option */
         else {
             goto invalid_options;
@@ -72,6 +105,13 @@ int main(int argc, char* argv[]) {
 
     }
 
+    /* The end of the encoded range may not precede its start */
+    if (end >= 0 && end < start) {
+        guacenc_log(GUAC_LOG_ERROR, "End time must not be before start "
+                "time.");
+        goto invalid_options;
+    }
+
     /* Log start */
     guacenc_log(GUAC_LOG_INFO, "Guacamole video encoder (guacenc) "
             "version " VERSION);
@@ -97,6 +137,24 @@ int main(int argc, char* argv[]) {
 
     guacenc_log(GUAC_LOG_INFO, "%i input file(s) provided.", total_files);
 
+    /* Rebuild indexes rather than encoding, if requested */
+    if (index) {
+
+        for (i = optind; i < argc; i++) {
+            if (guacenc_index(argv[i]))
+                failures++;
+        }
+
+        if (failures != 0)
+            guacenc_log(GUAC_LOG_WARNING, "Indexing failed for %i of %i "
+                    "file(s).", failures, total_files);
+        else
+            guacenc_log(GUAC_LOG_INFO, "All files indexed successfully.");
+
+        return 0;
+
+    }
+
     guacenc_log(GUAC_LOG_INFO, "Video will be encoded at %ix%i "
             "and %i bps.", width, height, bitrate);
 
@@ -119,7 +177,7 @@ int main(int argc, char* argv[]) {
 
         /* Attempt encoding, log granular success/failure at debug level */
         if (guacenc_encode(path, out_path, "mpeg4",
-                    width, height, bitrate, force)) {
+                    width, height, bitrate, force, start, end)) {
             failures++;
             guacenc_log(GUAC_LOG_DEBUG,
                     "%s was NOT successfully encoded.", path);
@@ -148,6 +206,9 @@ invalid_options:
             " [-s WIDTHxHEIGHT]"
             " [-r BITRATE]"
             " [-f]"
+            " [--start [[HH:]MM:]SS]"
+            " [--end [[HH:]MM:]SS]"
+            " [-i | --index]"
             " [FILE]...\n", argv[0]);
 
     return 1;
@@ -69,6 +69,49 @@ int guacenc_parse_dimensions(char* arg, int* width, int* height) {
 
 }
 
+int guacenc_parse_time(const char* arg, guac_timestamp* time) {
+
+    guac_timestamp seconds = 0;
+    int components = 0;
+
+    /* Parse each colon-separated component, most significant first */
+    do {
+
+        char* end;
+
+        /* Each component must be a non-negative decimal number */
+        if (*arg < '0' || *arg > '9')
+            return 1;
+
+        errno = 0;
+        long int value = strtol(arg, &end, 10);
+        if (errno != 0)
+            return 1;
+
+        /* No more than hours, minutes, and seconds may be given, and only
+         * the most significant component may exceed 59 */
+        if (++components > 3 || (components > 1 && value > 59))
+            return 1;
+
+        seconds = seconds * 60 + value;
+
+        /* Stop after last component */
+        if (*end == '\0')
+            break;
+
+        /* Components must be separated by colons */
+        if (*end != ':')
+            return 1;
+
+        arg = end + 1;
+
+    } while (1);
+
+    *time = seconds * 1000;
+    return 0;
+
+}
+
 guac_timestamp guacenc_parse_timestamp(const char* str) {
 
     int sign = 1;
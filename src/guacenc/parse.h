@@ -63,6 +63,25 @@ int guacenc_parse_int(char* arg, int* i);
  */
 int guacenc_parse_dimensions(char* arg, int* width, int* height);
 
+/**
+ * Parses a point in time within a recording, given as a number of seconds
+ * optionally preceded by minutes and hours, separated by colons
+ * ([[HH:]MM:]SS). A value will be stored in the provided guac_timestamp
+ * pointer only if valid.
+ *
+ * @param arg
+ *     The string to parse.
+ *
+ * @param time
+ *     A pointer to the guac_timestamp in which the parsed time should be
+ *     stored, in milliseconds.
+ *
+ * @return
+ *     Zero if parsing was successful, non-zero if the provided string was
+ *     invalid.
+ */
+int guacenc_parse_time(const char* arg, guac_timestamp* time);
+
 /**
  * Parses a guac_timestamp from the given string. The string is assumed to
  * consist solely of decimal digits with an optional leading minus sign. If the
@@ -25,6 +25,7 @@
 #include <guacamole/client.h>
 #include <guacamole/error.h>
 #include <guacamole/parser.h>
+#include <guacamole/recording.h>
 #include <guacamole/socket.h>
 
 #include <sys/stat.h>
@@ -124,11 +125,11 @@ int guaclog_interpret(const char* path, const char* out_path, bool force) {
         return 1;
     }
 
-    /* Obtain guac_socket wrapping file descriptor */
-    guac_socket* socket = guac_socket_open(fd);
+    /* Obtain guac_socket reading the (possibly compressed) recording */
+    guac_socket* socket = guac_recording_socket_open(fd);
     if (socket == NULL) {
-        guaclog_log(GUAC_LOG_ERROR, "%s: %s", path,
-                guac_status_string(guac_error));
+        guaclog_log(GUAC_LOG_ERROR, "%s: %s: %s", path,
+                guac_error_message, guac_status_string(guac_error));
         close(fd);
         guaclog_state_free(state);
         return 1;
@@ -0,0 +1,503 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "base64-kernels.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GUAC_BASE64_KERNEL_NEON
+#endif
+
+/*
+ * NOTE: All kernels within this file MUST produce output that is identical
+ * to that of the scalar kernel, including for inputs that are not a multiple
+ * of the vector width. The unit tests for these kernels verify each supported
+ * variant against the scalar variant.
+ */
+
+/**
+ * The 64 characters used by base64 to represent each possible 6-bit value,
+ * in order of increasing value.
+ */
+static const unsigned char GUAC_BASE64_CHARACTERS[64] = {
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
+    'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd',
+    'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's',
+    't', 'u', 'v', 'w', 'x', 'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7',
+    '8', '9', '+', '/'
+};
+
+/* ---------------- SCALAR ---------------- */
+
+/**
+ * Returns whether the scalar kernel is supported by the current processor.
+ * The scalar kernel does not depend on any processor features and is thus
+ * always supported.
+ *
+ * @return
+ *     Always non-zero.
+ */
+static int guac_base64_kernel_scalar_supported(void) {
+    return 1;
+}
+
+/**
+ * Scalar implementation of guac_base64_kernel_encode, encoding one group of
+ * three bytes at a time through a lookup table.
+ *
+ * @see guac_base64_kernel_encode
+ */
+static size_t guac_base64_encode_scalar(const unsigned char* restrict input,
+        size_t length, char* restrict output) {
+
+    size_t groups = length / 3;
+    for (size_t i = 0; i < groups; i++) {
+
+        /* AAAAAAAA BBBBBBBB CCCCCCCC -> AAAAAA AABBBB BBBBCC CCCCCC */
+        uint32_t value = ((uint32_t) input[0] << 16)
+                       | ((uint32_t) input[1] << 8)
+                       |  (uint32_t) input[2];
+
+        output[0] = GUAC_BASE64_CHARACTERS[ value >> 18        ];
+        output[1] = GUAC_BASE64_CHARACTERS[(value >> 12) & 0x3F];
+        output[2] = GUAC_BASE64_CHARACTERS[(value >>  6) & 0x3F];
+        output[3] = GUAC_BASE64_CHARACTERS[ value        & 0x3F];
+
+        input  += 3;
+        output += 4;
+
+    }
+
+    return groups * 4;
+
+}
+
+const guac_base64_kernel guac_base64_kernel_scalar = {
+    .name      = "scalar",
+    .supported = guac_base64_kernel_scalar_supported,
+    .encode    = guac_base64_encode_scalar
+};
+
+/* ---------------- SSSE3 / AVX2 ---------------- */
+
+#ifdef HAVE_X86_SIMD
+
+/*
+ * The SSSE3 and AVX2 kernels below are based on the approach described by
+ * Wojciech Muła and Daniel Lemire in "Faster Base64 Encoding and Decoding
+ * using AVX2 Instructions": each group of three bytes is shuffled into a
+ * 32-bit lane, the four 6-bit values within each lane are moved into separate
+ * bytes using multiplication as a per-field shift, and each 6-bit value is
+ * then translated into its corresponding character by adding an offset
+ * determined by a 16-entry table lookup.
+ */
+
+/**
+ * Function attribute which allows the compiler to emit SSSE3 instructions
+ * within a function, regardless of the instruction set otherwise targeted.
+ */
+#define GUAC_BASE64_KERNEL_SSSE3 __attribute__((target("ssse3")))
+
+/**
+ * Function attribute which allows the compiler to emit AVX2 instructions
+ * within a function, regardless of the instruction set otherwise targeted.
+ */
+#define GUAC_BASE64_KERNEL_AVX2 __attribute__((target("avx2")))
+
+/**
+ * Returns whether the current processor supports SSSE3.
+ *
+ * @return
+ *     Non-zero if SSSE3 is supported, zero otherwise.
+ */
+static int guac_base64_kernel_ssse3_supported(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+}
+
+/**
+ * Returns whether the current processor supports AVX2.
+ *
+ * @return
+ *     Non-zero if AVX2 is supported, zero otherwise.
+ */
+static int guac_base64_kernel_avx2_supported(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+/**
+ * Splits the first 12 bytes of the given vector (four groups of three bytes)
+ * into sixteen 6-bit values, one per byte, in the order those values appear
+ * within the base64 output.
+ *
+ * @param input
+ *     The vector containing the bytes to split. Only the first 12 bytes are
+ *     used.
+ *
+ * @return
+ *     A vector of sixteen 6-bit values.
+ */
+GUAC_BASE64_KERNEL_SSSE3
+static inline __m128i guac_base64_ssse3_split(__m128i input) {
+
+    /* Arrange each group of bytes ABC as the 32-bit lane BACB */
+    input = _mm_shuffle_epi8(input, _mm_set_epi8(
+                10, 11,  9, 10,
+                 7,  8,  6,  7,
+                 4,  5,  3,  4,
+                 1,  2,  0,  1));
+
+    /* Shift the first and third 6-bit values into place */
+    __m128i t0 = _mm_and_si128(input, _mm_set1_epi32(0x0FC0FC00));
+    __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+
+    /* Shift the second and fourth 6-bit values into place */
+    __m128i t2 = _mm_and_si128(input, _mm_set1_epi32(0x003F03F0));
+    __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+
+    return _mm_or_si128(t1, t3);
+
+}
+
+/**
+ * Translates each of the sixteen 6-bit values within the given vector into
+ * the corresponding base64 character.
+ *
+ * @param values
+ *     A vector of sixteen 6-bit values.
+ *
+ * @return
+ *     A vector of the sixteen corresponding base64 characters.
+ */
+GUAC_BASE64_KERNEL_SSSE3
+static inline __m128i guac_base64_ssse3_translate(__m128i values) {
+
+    /* Reduce each value to an index into the offset table: 0 for 26-51
+     * ('a' - 'z'), 1-10 for 52-61 ('0' - '9'), 11 for 62 ('+'), 12 for 63
+     * ('/'), and 13 for 0-25 ('A' - 'Z') */
+    __m128i index = _mm_subs_epu8(values, _mm_set1_epi8(51));
+    __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), values);
+    index = _mm_or_si128(index, _mm_and_si128(less, _mm_set1_epi8(13)));
+
+    const __m128i offsets = _mm_setr_epi8(
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+            '/' - 63, 'A', 0, 0);
+
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, index), values);
+
+}
+
+/**
+ * SSSE3 implementation of guac_base64_kernel_encode, encoding twelve bytes
+ * at a time.
+ *
+ * @see guac_base64_kernel_encode
+ */
+GUAC_BASE64_KERNEL_SSSE3
+static size_t guac_base64_encode_ssse3(const unsigned char* restrict input,
+        size_t length, char* restrict output) {
+
+    size_t encoded = 0;
+
+    /* Each iteration loads 16 bytes but consumes only 12 */
+    while (length >= 16) {
+
+        __m128i in = _mm_loadu_si128((const __m128i*) input);
+        __m128i out = guac_base64_ssse3_translate(guac_base64_ssse3_split(in));
+        _mm_storeu_si128((__m128i*) output, out);
+
+        input   += 12;
+        length  -= 12;
+        output  += 16;
+        encoded += 16;
+
+    }
+
+    return encoded + guac_base64_encode_scalar(input, length, output);
+
+}
+
+/**
+ * AVX2 variant of guac_base64_ssse3_split(), splitting the first 12 bytes of
+ * each 128-bit lane of the given vector.
+ *
+ * @see guac_base64_ssse3_split
+ */
+GUAC_BASE64_KERNEL_AVX2
+static inline __m256i guac_base64_avx2_split(__m256i input) {
+
+    input = _mm256_shuffle_epi8(input, _mm256_set_epi8(
+                10, 11,  9, 10,
+                 7,  8,  6,  7,
+                 4,  5,  3,  4,
+                 1,  2,  0,  1,
+                10, 11,  9, 10,
+                 7,  8,  6,  7,
+                 4,  5,  3,  4,
+                 1,  2,  0,  1));
+
+    __m256i t0 = _mm256_and_si256(input, _mm256_set1_epi32(0x0FC0FC00));
+    __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+
+    __m256i t2 = _mm256_and_si256(input, _mm256_set1_epi32(0x003F03F0));
+    __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+
+    return _mm256_or_si256(t1, t3);
+
+}
+
+/**
+ * AVX2 variant of guac_base64_ssse3_translate(), translating thirty-two 6-bit
+ * values.
+ *
+ * @see guac_base64_ssse3_translate
+ */
+GUAC_BASE64_KERNEL_AVX2
+static inline __m256i guac_base64_avx2_translate(__m256i values) {
+
+    __m256i index = _mm256_subs_epu8(values, _mm256_set1_epi8(51));
+    __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), values);
+    index = _mm256_or_si256(index, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+
+    const __m256i offsets = _mm256_setr_epi8(
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+            '/' - 63, 'A', 0, 0,
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+            '/' - 63, 'A', 0, 0);
+
+    return _mm256_add_epi8(_mm256_shuffle_epi8(offsets, index), values);
+
+}
+
+/**
+ * AVX2 implementation of guac_base64_kernel_encode, encoding twenty-four
+ * bytes at a time.
+ *
+ * @see guac_base64_kernel_encode
+ */
+GUAC_BASE64_KERNEL_AVX2
+static size_t guac_base64_encode_avx2(const unsigned char* restrict input,
+        size_t length, char* restrict output) {
+
+    size_t encoded = 0;
+
+    /* Each iteration loads 12 bytes into each 128-bit lane (reading 28 bytes
+     * in total) and consumes 24 */
+    while (length >= 28) {
+
+        __m256i in = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) input)),
+                _mm_loadu_si128((const __m128i*) (input + 12)), 1);
+
+        __m256i out = guac_base64_avx2_translate(guac_base64_avx2_split(in));
+        _mm256_storeu_si256((__m256i*) output, out);
+
+        input   += 24;
+        length  -= 24;
+        output  += 32;
+        encoded += 32;
+
+    }
+
+    return encoded + guac_base64_encode_ssse3(input, length, output);
+
+}
+
+/**
+ * Base64 kernel leveraging SSSE3.
+ */
+static const guac_base64_kernel guac_base64_kernel_ssse3 = {
+    .name      = "ssse3",
+    .supported = guac_base64_kernel_ssse3_supported,
+    .encode    = guac_base64_encode_ssse3
+};
+
+/**
+ * Base64 kernel leveraging AVX2.
+ */
+static const guac_base64_kernel guac_base64_kernel_avx2 = {
+    .name      = "avx2",
+    .supported = guac_base64_kernel_avx2_supported,
+    .encode    = guac_base64_encode_avx2
+};
+
+#endif
+
+/* ---------------- NEON ---------------- */
+
+#ifdef GUAC_BASE64_KERNEL_NEON
+
+/**
+ * Returns whether the current processor supports NEON. NEON is a mandatory
+ * part of AArch64, and is thus always supported if this kernel was compiled
+ * at all.
+ *
+ * @return
+ *     Always non-zero.
+ */
+static int guac_base64_kernel_neon_supported(void) {
+    return 1;
+}
+
+/**
+ * NEON implementation of guac_base64_kernel_encode, encoding forty-eight
+ * bytes at a time using de-interleaving loads and a 64-entry table lookup.
+ *
+ * @see guac_base64_kernel_encode
+ */
+static size_t guac_base64_encode_neon(const unsigned char* restrict input,
+        size_t length, char* restrict output) {
+
+    const uint8x16x4_t characters = { {
+        vld1q_u8(GUAC_BASE64_CHARACTERS),
+        vld1q_u8(GUAC_BASE64_CHARACTERS + 16),
+        vld1q_u8(GUAC_BASE64_CHARACTERS + 32),
+        vld1q_u8(GUAC_BASE64_CHARACTERS + 48)
+    } };
+
+    const uint8x16_t mask = vdupq_n_u8(0x3F);
+    size_t encoded = 0;
+
+    while (length >= 48) {
+
+        /* Load the first, second, and third bytes of 16 groups separately */
+        uint8x16x3_t in = vld3q_u8(input);
+        uint8x16x4_t out;
+
+        out.val[0] = vshrq_n_u8(in.val[0], 2);
+        out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4),
+                    vshrq_n_u8(in.val[1], 4)), mask);
+        out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2),
+                    vshrq_n_u8(in.val[2], 6)), mask);
+        out.val[3] = vandq_u8(in.val[2], mask);
+
+        out.val[0] = vqtbl4q_u8(characters, out.val[0]);
+        out.val[1] = vqtbl4q_u8(characters, out.val[1]);
+        out.val[2] = vqtbl4q_u8(characters, out.val[2]);
+        out.val[3] = vqtbl4q_u8(characters, out.val[3]);
+
+        /* Store the four characters of each group interleaved */
+        vst4q_u8((uint8_t*) output, out);
+
+        input   += 48;
+        length  -= 48;
+        output  += 64;
+        encoded += 64;
+
+    }
+
+    return encoded + guac_base64_encode_scalar(input, length, output);
+
+}
+
+/**
+ * Base64 kernel leveraging NEON.
+ */
+static const guac_base64_kernel guac_base64_kernel_neon = {
+    .name      = "neon",
+    .supported = guac_base64_kernel_neon_supported,
+    .encode    = guac_base64_encode_neon
+};
+
+#endif
+
+const guac_base64_kernel* const guac_base64_kernels_all[] = {
+    &guac_base64_kernel_scalar,
+#ifdef HAVE_X86_SIMD
+    &guac_base64_kernel_ssse3,
+    &guac_base64_kernel_avx2,
+#endif
+#ifdef GUAC_BASE64_KERNEL_NEON
+    &guac_base64_kernel_neon,
+#endif
+    NULL
+};
+
+const guac_base64_kernel* guac_base64_kernel_select(void) {
+
+    const guac_base64_kernel* selected = &guac_base64_kernel_scalar;
+
+    /* Prefer the last supported kernel (kernels are listed in order of
+     * increasing preference) */
+    for (const guac_base64_kernel* const* current = guac_base64_kernels_all;
+            *current != NULL; current++) {
+
+        if ((*current)->supported())
+            selected = *current;
+
+    }
+
+    return selected;
+
+}
+
+/**
+ * The kernel used by guac_base64_encode(), as determined by
+ * guac_base64_kernel_select() upon first use.
+ */
+static const guac_base64_kernel* guac_base64_kernel_selected = NULL;
+
+/**
+ * Guarantees that guac_base64_kernel_selected is initialized exactly once.
+ */
+static pthread_once_t guac_base64_kernel_selected_init = PTHREAD_ONCE_INIT;
+
+/**
+ * Initializes guac_base64_kernel_selected. This function MUST be invoked only
+ * through pthread_once() with guac_base64_kernel_selected_init.
+ */
+static void guac_base64_kernel_init(void) {
+    guac_base64_kernel_selected = guac_base64_kernel_select();
+}
+
+size_t guac_base64_encode(const unsigned char* restrict input, size_t length,
+        char* restrict output) {
+
+    pthread_once(&guac_base64_kernel_selected_init, guac_base64_kernel_init);
+    return guac_base64_kernel_selected->encode(input, length, output);
+
+}
+
+void guac_base64_encode_final(const unsigned char* input, size_t length,
+        char* output) {
+
+    /* AAAAAA [AABBBB] [BBBB--] ------ */
+    uint32_t value = (uint32_t) input[0] << 16;
+    if (length > 1)
+        value |= (uint32_t) input[1] << 8;
+
+    output[0] = GUAC_BASE64_CHARACTERS[ value >> 18        ];
+    output[1] = GUAC_BASE64_CHARACTERS[(value >> 12) & 0x3F];
+    output[2] = (length > 1) ? GUAC_BASE64_CHARACTERS[(value >> 6) & 0x3F] : '=';
+    output[3] = '=';
+
+}
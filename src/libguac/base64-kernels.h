@@ -0,0 +1,146 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_BASE64_KERNELS_H
+#define GUAC_BASE64_KERNELS_H
+
+#include <stddef.h>
+
+/**
+ * Encodes the given data as base64, without padding. The data provided must
+ * consist only of complete groups of three bytes, each of which is encoded as
+ * exactly four base64 characters. No null terminator is written.
+ *
+ * @param input
+ *     The data to encode.
+ *
+ * @param length
+ *     The number of bytes of data to encode. This MUST be a multiple of three.
+ *
+ * @param output
+ *     The buffer which should receive the encoded data. This buffer must be
+ *     at least (length / 3 * 4) bytes in size.
+ *
+ * @return
+ *     The number of base64 characters written to the output buffer, which
+ *     will always be exactly (length / 3 * 4).
+ */
+typedef size_t guac_base64_kernel_encode(const unsigned char* restrict input,
+        size_t length, char* restrict output);
+
+/**
+ * Returns whether the processor that the current process is running on
+ * supports the instructions required by a particular base64 kernel.
+ *
+ * @return
+ *     Non-zero if the required instructions are supported, zero otherwise.
+ */
+typedef int guac_base64_kernel_supported(void);
+
+/**
+ * An implementation of the loop which encodes binary data as base64. Each
+ * kernel produces output that is byte-for-byte identical to that of every
+ * other kernel, varying only in the processor features leveraged to produce
+ * that output.
+ */
+typedef struct guac_base64_kernel {
+
+    /**
+     * A human-readable name for this kernel, such as "scalar" or "avx2".
+     */
+    const char* name;
+
+    /**
+     * Returns whether the current processor supports this kernel.
+     */
+    guac_base64_kernel_supported* supported;
+
+    /**
+     * Encodes complete groups of three bytes as base64.
+     */
+    guac_base64_kernel_encode* encode;
+
+} guac_base64_kernel;
+
+/**
+ * Portable, table-driven base64 kernel that does not depend on any particular
+ * processor features. This kernel is always available and is the reference
+ * against which all other kernels are verified.
+ */
+extern const guac_base64_kernel guac_base64_kernel_scalar;
+
+/**
+ * NULL-terminated array of all base64 kernels compiled into libguac, in order
+ * of increasing preference. Not all of these kernels are necessarily
+ * supported by the current processor, and each entry must be checked with its
+ * supported() function before use.
+ */
+extern const guac_base64_kernel* const guac_base64_kernels_all[];
+
+/**
+ * Returns the most preferable base64 kernel that is supported by the current
+ * processor. If no kernels leveraging processor-specific features are
+ * supported, guac_base64_kernel_scalar is returned.
+ *
+ * @return
+ *     The most preferable base64 kernel supported by the current processor.
+ */
+const guac_base64_kernel* guac_base64_kernel_select(void);
+
+/**
+ * Encodes the given data as base64 using the most preferable kernel supported
+ * by the current processor, as determined by guac_base64_kernel_select().
+ * The data provided must consist only of complete groups of three bytes.
+ *
+ * @see guac_base64_kernel_encode
+ *
+ * @param input
+ *     The data to encode.
+ *
+ * @param length
+ *     The number of bytes of data to encode. This MUST be a multiple of three.
+ *
+ * @param output
+ *     The buffer which should receive the encoded data. This buffer must be
+ *     at least (length / 3 * 4) bytes in size.
+ *
+ * @return
+ *     The number of base64 characters written to the output buffer.
+ */
+size_t guac_base64_encode(const unsigned char* restrict input, size_t length,
+        char* restrict output);
+
+/**
+ * Encodes the final, incomplete group of one or two bytes at the end of a
+ * series of base64 data, writing exactly four characters including the
+ * necessary '=' padding.
+ *
+ * @param input
+ *     The bytes to encode.
+ *
+ * @param length
+ *     The number of bytes to encode. This MUST be either 1 or 2.
+ *
+ * @param output
+ *     The buffer which should receive the four encoded characters.
+ */
+void guac_base64_encode_final(const unsigned char* input, size_t length,
+        char* output);
+
+#endif
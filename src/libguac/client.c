@@ -25,7 +25,9 @@
 #include "guacamole/mem.h"
 #include "guacamole/client.h"
 #include "guacamole/error.h"
+#include "guacamole/flag.h"
 #include "guacamole/layer.h"
+#include "guacamole/metrics.h"
 #include "guacamole/plugin.h"
 #include "guacamole/pool.h"
 #include "guacamole/protocol.h"
@@ -48,10 +50,32 @@
 #include <string.h>
 
 /**
- * The number of milliseconds between times that the pending users list will be
- * synchronized and emptied (250 milliseconds aka 1/4 second).
+ * The maximum number of milliseconds that the pending users thread will wait
+ * to be signalled before checking the pending users list and any requests for
+ * resynchronization regardless. The thread is normally woken as soon as there
+ * is work to do, and this interval only bounds the impact of any missed
+ * signal.
  */
-#define GUAC_CLIENT_PENDING_USERS_REFRESH_INTERVAL 250
+#define GUAC_CLIENT_PENDING_USERS_REFRESH_INTERVAL 1000
+
+/**
+ * Bitwise flag set on the __pending_users_state flag of guac_client when at
+ * least one user has been added to the pending users list.
+ */
+#define GUAC_CLIENT_PENDING_USERS_STATE_JOINING 1
+
+/**
+ * Bitwise flag set on the __pending_users_state flag of guac_client when at
+ * least one user has requested that their connection state be
+ * resynchronized.
+ */
+#define GUAC_CLIENT_PENDING_USERS_STATE_RESYNC 2
+
+/**
+ * Bitwise flag set on the __pending_users_state flag of guac_client when the
+ * client is stopping and the pending users thread should terminate.
+ */
+#define GUAC_CLIENT_PENDING_USERS_STATE_STOPPING 4
 
 /**
  * A value that indicates that the pending users timer has yet to be
@@ -228,9 +252,105 @@ promotion_complete:
 }
 
 /**
- * Thread that periodically checks for users that have requested to join the
- * current connection (pending users). The check is performed every
- * GUAC_CLIENT_PENDING_USERS_REFRESH_INTERVAL milliseconds.
+ * Broadcast filter which allows no users to receive data. This function is a
+ * guac_socket_broadcast_filter, and the data provided is ignored.
+ *
+ * @return
+ *     Always zero.
+ */
+static int guac_client_filter_no_users(guac_user* user, void* data) {
+    return 0;
+}
+
+/**
+ * Returns all users whose connection state must be resynchronized to the
+ * list of pending users, such that they are resynchronized when pending users
+ * are next promoted.
+ *
+ * @param client
+ *     The client whose users should be checked for resynchronization.
+ */
+static void guac_client_resync_users(guac_client* client) {
+
+    int requested = 0;
+
+    /* Skip resynchronization entirely if no user requires it */
+    guac_rwlock_acquire_read_lock(&(client->__users_lock));
+    for (guac_user* user = client->__users; user != NULL; user = user->__next) {
+        if (user->__resync) {
+            requested = 1;
+            break;
+        }
+    }
+    guac_rwlock_release_lock(&(client->__users_lock));
+
+    if (!requested)
+        return;
+
+    /* Wait for any instruction currently being broadcast to finish, without
+     * locking the socket of any user (the instruction lock of a user that
+     * leaves the list of users would otherwise never be released) */
+    guac_socket_broadcast_set_filter(guac_client_filter_no_users, NULL);
+    guac_socket_instruction_begin(client->socket);
+
+    guac_rwlock_acquire_write_lock(&(client->__pending_users_lock));
+    guac_rwlock_acquire_write_lock(&(client->__users_lock));
+
+    guac_user* user = client->__users;
+    while (user != NULL) {
+
+        guac_user* next = user->__next;
+
+        if (user->__resync) {
+
+            user->__resync = 0;
+
+            /* Remove from list of users */
+            if (user->__prev != NULL)
+                user->__prev->__next = user->__next;
+            else
+                client->__users = user->__next;
+
+            if (user->__next != NULL)
+                user->__next->__prev = user->__prev;
+
+            /* Add to start of list of pending users */
+            user->__prev = NULL;
+            user->__next = client->__pending_users;
+
+            if (client->__pending_users != NULL)
+                client->__pending_users->__prev = user;
+
+            client->__pending_users = user;
+
+            /* Anything now written to the user will be part of the
+             * resynchronized connection state */
+            guac_socket_queue_resume(user->socket);
+
+            guac_client_log(client, GUAC_LOG_DEBUG, "Resynchronizing "
+                    "connection state of user \"%s\".", user->user_id);
+
+        }
+
+        user = next;
+
+    }
+
+    guac_rwlock_release_lock(&(client->__users_lock));
+    guac_rwlock_release_lock(&(client->__pending_users_lock));
+
+    guac_socket_instruction_end(client->socket);
+    guac_socket_broadcast_set_filter(NULL, NULL);
+
+}
+
+/**
+ * Thread that synchronizes users that have requested to join the current
+ * connection (pending users), as well as users that have requested
+ * resynchronization. The thread sleeps until signalled via the
+ * __pending_users_state flag of the guac_client, such that joining users are
+ * synchronized immediately, checking at least every
+ * GUAC_CLIENT_PENDING_USERS_REFRESH_INTERVAL milliseconds regardless.
  *
  * @param data
  *     A pointer to the guac_client associated with the connection.
@@ -243,8 +363,31 @@ static void* guac_client_pending_users_thread(void* data) {
     guac_client* client = (guac_client*) data;
 
     while (client->state == GUAC_CLIENT_RUNNING) {
+
+        /* Consume all pending signals before handling them, such that any
+         * signal arriving while they are being handled is not lost */
+        if (guac_flag_timedwait_and_lock(&client->__pending_users_state,
+                    GUAC_CLIENT_PENDING_USERS_STATE_JOINING
+                    | GUAC_CLIENT_PENDING_USERS_STATE_RESYNC
+                    | GUAC_CLIENT_PENDING_USERS_STATE_STOPPING,
+                    GUAC_CLIENT_PENDING_USERS_REFRESH_INTERVAL)) {
+
+            int stopping = client->__pending_users_state.value
+                & GUAC_CLIENT_PENDING_USERS_STATE_STOPPING;
+
+            guac_flag_clear(&client->__pending_users_state,
+                    GUAC_CLIENT_PENDING_USERS_STATE_JOINING
+                    | GUAC_CLIENT_PENDING_USERS_STATE_RESYNC);
+            guac_flag_unlock(&client->__pending_users_state);
+
+            if (stopping)
+                break;
+
+        }
+
+        guac_client_resync_users(client);
         guac_client_promote_pending_users(client);
-        guac_timestamp_msleep(GUAC_CLIENT_PENDING_USERS_REFRESH_INTERVAL);
+
     }
 
     return NULL;
@@ -294,6 +437,7 @@ guac_client* guac_client_alloc(void) {
     /* Init locks */
     guac_rwlock_init(&(client->__users_lock));
     guac_rwlock_init(&(client->__pending_users_lock));
+    guac_flag_init(&(client->__pending_users_state));
 
     /* Set up broadcast sockets */
     client->socket = guac_socket_broadcast(client);
@@ -359,6 +503,7 @@ void guac_client_free(guac_client* client) {
     /* Destroy the reentrant read-write locks */
     guac_rwlock_destroy(&(client->__users_lock));
     guac_rwlock_destroy(&(client->__pending_users_lock));
+    guac_flag_destroy(&(client->__pending_users_state));
 
     guac_mem_free(client->connection_id);
     guac_mem_free(client);
@@ -387,6 +532,8 @@ void guac_client_log(guac_client* client, guac_client_log_level level,
 
 void guac_client_stop(guac_client* client) {
     client->state = GUAC_CLIENT_STOPPING;
+    guac_flag_set(&(client->__pending_users_state),
+            GUAC_CLIENT_PENDING_USERS_STATE_STOPPING);
 }
 
 void vguac_client_abort(guac_client* client, guac_protocol_status status,
@@ -460,6 +607,10 @@ static void guac_client_add_pending_user(guac_client* client,
     /* Release the lock */
     guac_rwlock_release_lock(&(client->__pending_users_lock));
 
+    /* Synchronize the new user without waiting for the next periodic check */
+    guac_flag_set(&(client->__pending_users_state),
+            GUAC_CLIENT_PENDING_USERS_STATE_JOINING);
+
 }
 
 int guac_client_add_user(guac_client* client, guac_user* user, int argc, char** argv) {
@@ -492,6 +643,18 @@ int guac_client_add_user(guac_client* client, guac_user* user, int argc, char**
 
 }
 
+void guac_client_resync_user(guac_client* client, guac_user* user) {
+
+    /* The request is handled by the pending users thread */
+    guac_rwlock_acquire_write_lock(&(client->__users_lock));
+    user->__resync = 1;
+    guac_rwlock_release_lock(&(client->__users_lock));
+
+    guac_flag_set(&(client->__pending_users_state),
+            GUAC_CLIENT_PENDING_USERS_STATE_RESYNC);
+
+}
+
 void guac_client_remove_user(guac_client* client, guac_user* user) {
 
     guac_rwlock_acquire_write_lock(&(client->__pending_users_lock));
@@ -632,6 +795,8 @@ int guac_client_end_multiple_frames(guac_client* client, int frames) {
     guac_client_log(client, GUAC_LOG_TRACE, "Server completed "
             "frame %" PRIu64 "ms (%i logical frames)", client->last_sent_timestamp, frames);
 
+    guac_metrics_frame_sent();
+
     return guac_protocol_send_sync(client->socket, client->last_sent_timestamp, frames);
 
 }
@@ -1076,3 +1241,8 @@ int guac_client_supports_webp(guac_client* client) {
 
 }
 
+void guac_client_coalesce_input(guac_client* client, int max_motion_rate) {
+    client->__coalesce_input = 1;
+    client->__max_motion_rate = max_motion_rate;
+}
+
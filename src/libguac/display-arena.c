@@ -0,0 +1,106 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-priv.h"
+#include "guacamole/mem.h"
+
+#include <string.h>
+
+/**
+ * The number of bytes that should be allocated when a guac_display_arena
+ * buffer is first used, regardless of the amount of storage requested. This
+ * avoids repeated reallocation of small buffers as they grow.
+ */
+#define GUAC_DISPLAY_ARENA_MIN_SIZE 4096
+
+void* guac_display_arena_reserve(guac_display_arena_buffer* buffer,
+        size_t count, size_t size) {
+
+    size_t required = guac_mem_ckd_mul_or_die(count, size);
+    if (required <= buffer->size)
+        return buffer->data;
+
+    /* Grow geometrically to amortize the cost of repeated growth */
+    size_t new_size = buffer->size ? guac_mem_ckd_mul_or_die(buffer->size, 2) : GUAC_DISPLAY_ARENA_MIN_SIZE;
+    if (new_size < required)
+        new_size = required;
+
+    buffer->data = guac_mem_realloc_or_die(buffer->data, new_size);
+    memset((char*) buffer->data + buffer->size, 0, new_size - buffer->size);
+
+    buffer->size = new_size;
+    buffer->allocations++;
+
+    return buffer->data;
+
+}
+
+unsigned int guac_display_arena_count(guac_display_arena* arena) {
+
+    unsigned int allocations = arena->plan.allocations
+        + arena->ops.allocations
+        + arena->op_hashes.allocations
+        + arena->op_indexable.allocations
+        + arena->op_lossy.allocations;
+
+    for (int i = 0; i < GUAC_DISPLAY_MAX_BANDS; i++)
+        allocations += arena->search_hits[i].allocations;
+
+    return allocations;
+
+}
+
+void guac_display_arena_reset_count(guac_display_arena* arena) {
+
+    arena->plan.allocations = 0;
+    arena->ops.allocations = 0;
+    arena->op_hashes.allocations = 0;
+    arena->op_indexable.allocations = 0;
+    arena->op_lossy.allocations = 0;
+
+    for (int i = 0; i < GUAC_DISPLAY_MAX_BANDS; i++)
+        arena->search_hits[i].allocations = 0;
+
+}
+
+/**
+ * Frees the storage associated with the given arena buffer, resetting the
+ * buffer to its initial, empty state.
+ *
+ * @param buffer
+ *     The buffer whose storage should be freed.
+ */
+static void guac_display_arena_buffer_free(guac_display_arena_buffer* buffer) {
+    guac_mem_free(buffer->data);
+    buffer->size = 0;
+    buffer->allocations = 0;
+}
+
+void guac_display_arena_free(guac_display_arena* arena) {
+
+    guac_display_arena_buffer_free(&arena->plan);
+    guac_display_arena_buffer_free(&arena->ops);
+    guac_display_arena_buffer_free(&arena->op_hashes);
+    guac_display_arena_buffer_free(&arena->op_indexable);
+    guac_display_arena_buffer_free(&arena->op_lossy);
+
+    for (int i = 0; i < GUAC_DISPLAY_MAX_BANDS; i++)
+        guac_display_arena_buffer_free(&arena->search_hits[i]);
+
+}
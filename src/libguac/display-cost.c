@@ -0,0 +1,377 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "display-plan.h"
+#include "display-priv.h"
+#include "guacamole/client.h"
+#include "guacamole/fifo.h"
+#include "guacamole/metrics.h"
+#include "guacamole/timestamp.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+
+#ifdef HAVE_CLOCK_GETTIME
+#include <time.h>
+#endif
+
+/**
+ * Human-readable names of each guac_display_format, for the sake of logging.
+ */
+static const char* const GUAC_DISPLAY_FORMAT_NAMES[GUAC_DISPLAY_FORMATS] = {
+    [GUAC_DISPLAY_FORMAT_PNG]  = "PNG",
+    [GUAC_DISPLAY_FORMAT_WEBP] = "WebP",
+    [GUAC_DISPLAY_FORMAT_JPEG] = "JPEG"
+};
+
+/**
+ * Human-readable names of each guac_display_region_class, for the sake of
+ * logging.
+ */
+static const char* const GUAC_DISPLAY_REGION_CLASS_NAMES[GUAC_DISPLAY_REGION_CLASSES] = {
+    [GUAC_DISPLAY_REGION_FLAT]     = "flat",
+    [GUAC_DISPLAY_REGION_MIXED]    = "mixed",
+    [GUAC_DISPLAY_REGION_DETAILED] = "detailed"
+};
+
+/**
+ * Incorporates a new measurement into the given moving average. If no
+ * measurements have yet been made, the average is simply replaced.
+ *
+ * @param average
+ *     The moving average to update.
+ *
+ * @param samples
+ *     The number of measurements that have previously contributed to the
+ *     average.
+ *
+ * @param value
+ *     The new measurement.
+ */
+static void guac_display_cost_average(double* average, unsigned int samples,
+        double value) {
+
+    if (samples == 0)
+        *average = value;
+    else
+        *average = (*average * GUAC_DISPLAY_COST_SMOOTHING + value)
+            / (GUAC_DISPLAY_COST_SMOOTHING + 1);
+
+}
+
+uint64_t guac_display_cost_usec(void) {
+
+#ifdef HAVE_CLOCK_GETTIME
+
+    struct timespec current;
+
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &current);
+#else
+    clock_gettime(CLOCK_REALTIME, &current);
+#endif
+
+    return (uint64_t) current.tv_sec * 1000000 + current.tv_nsec / 1000;
+
+#else
+
+    struct timeval current;
+    gettimeofday(&current, NULL);
+
+    return (uint64_t) current.tv_sec * 1000000 + current.tv_usec;
+
+#endif
+
+}
+
+guac_display_region_class guac_display_cost_classify(int png_optimality) {
+
+    /* Content where most pixels repeat their neighbor at least 8:1 */
+    if (png_optimality >= 0x400)
+        return GUAC_DISPLAY_REGION_FLAT;
+
+    /* Content that PNG is still expected to handle reasonably well (the
+     * same threshold used by the static JPEG/WebP heuristics) */
+    if (png_optimality >= 0)
+        return GUAC_DISPLAY_REGION_MIXED;
+
+    return GUAC_DISPLAY_REGION_DETAILED;
+
+}
+
+int guac_display_cost_candidates(int lossy, int opaque, size_t pixels,
+        int webp, guac_display_format* fallback) {
+
+    int candidates = 1 << GUAC_DISPLAY_FORMAT_PNG;
+    *fallback = GUAC_DISPLAY_FORMAT_PNG;
+
+    /* Content that the static heuristics would send as PNG is always sent as
+     * PNG, regardless of measured cost */
+    if (!lossy)
+        return candidates;
+
+    if (opaque && pixels > GUAC_DISPLAY_JPEG_MIN_BITMAP_SIZE) {
+        candidates |= 1 << GUAC_DISPLAY_FORMAT_JPEG;
+        *fallback = GUAC_DISPLAY_FORMAT_JPEG;
+    }
+
+    if (webp) {
+        candidates |= 1 << GUAC_DISPLAY_FORMAT_WEBP;
+        *fallback = GUAC_DISPLAY_FORMAT_WEBP;
+    }
+
+    return candidates;
+
+}
+
+guac_display_format guac_display_cost_select(guac_display* display,
+        guac_display_region_class region_class, size_t pixels, int framerate,
+        int candidates, guac_display_format fallback) {
+
+    guac_display_cost_model* model = &display->cost_model;
+    guac_display_cost_estimate* estimates = model->estimates[region_class];
+
+    /* The time available for this update is the expected time until the
+     * region is next updated, divided up proportionately between all image
+     * data within the current frame */
+    double budget = GUAC_DISPLAY_COST_MAX_BUDGET;
+    if (framerate > 0 && 1000.0 / framerate < budget)
+        budget = 1000.0 / framerate;
+
+    if (model->frame_pixels > pixels)
+        budget = budget * pixels / model->frame_pixels;
+
+    int unmeasured = -1;
+    int fitting = -1;
+    int cheapest = -1;
+    double cheapest_cost = 0;
+
+    for (int format = 0; format < GUAC_DISPLAY_FORMATS; format++) {
+
+        if (!(candidates & (1 << format)))
+            continue;
+
+        guac_display_cost_estimate* estimate = &estimates[format];
+        if (estimate->samples < GUAC_DISPLAY_COST_MIN_SAMPLES) {
+            if (unmeasured == -1)
+                unmeasured = format;
+            continue;
+        }
+
+        /* Expected cost is the time to encode plus the time for the encoded
+         * data to reach the client (transfer time is ignored until the
+         * bandwidth available has actually been measured) */
+        double cost = estimate->usec_per_pixel * pixels / 1000;
+        if (model->link.bandwidth > 0)
+            cost += estimate->bytes_per_pixel * pixels / model->link.bandwidth;
+
+        /* Formats are checked in order of preference */
+        if (fitting == -1 && cost <= budget)
+            fitting = format;
+
+        if (cheapest == -1 || cost < cheapest_cost) {
+            cheapest = format;
+            cheapest_cost = cost;
+        }
+
+    }
+
+    guac_display_format selected;
+
+    /* Rely on the static heuristics until all candidates have been measured,
+     * periodically using an unmeasured format to measure it */
+    if (unmeasured != -1) {
+        if ((model->heuristic + model->explored) % GUAC_DISPLAY_COST_EXPLORE_INTERVAL
+                == GUAC_DISPLAY_COST_EXPLORE_INTERVAL - 1) {
+            selected = unmeasured;
+            model->explored++;
+        }
+        else {
+            selected = fallback;
+            model->heuristic++;
+        }
+    }
+
+    /* Otherwise, prefer the most preferable format that fits within the
+     * budget, falling back to whichever is least costly */
+    else if (fitting != -1)
+        selected = fitting;
+
+    else {
+        selected = cheapest;
+        model->over_budget++;
+    }
+
+    estimates[selected].selected++;
+    return selected;
+
+}
+
+void guac_display_cost_record(guac_display* display, guac_display_format format,
+        guac_display_region_class region_class, size_t pixels, uint64_t usec,
+        size_t bytes) {
+
+    if (pixels == 0)
+        return;
+
+    guac_display_cost_model* model = &display->cost_model;
+    guac_display_cost_estimate* estimate = &model->estimates[region_class][format];
+
+    guac_display_cost_average(&estimate->usec_per_pixel, estimate->samples,
+            (double) usec / pixels);
+
+    guac_display_cost_average(&estimate->bytes_per_pixel, estimate->samples,
+            (double) bytes / pixels);
+
+    estimate->samples++;
+
+    /* Encode times are also exported per format for external monitoring */
+    static const guac_metrics_histogram encode_time[] = {
+        [GUAC_DISPLAY_FORMAT_PNG]  = GUAC_METRICS_ENCODE_PNG_TIME,
+        [GUAC_DISPLAY_FORMAT_WEBP] = GUAC_METRICS_ENCODE_WEBP_TIME,
+        [GUAC_DISPLAY_FORMAT_JPEG] = GUAC_METRICS_ENCODE_JPEG_TIME
+    };
+
+    guac_metrics_observe(encode_time[format], usec);
+
+}
+
+int guac_display_bandwidth_update(guac_display_bandwidth* estimate,
+        size_t bytes, int lag, guac_timestamp now) {
+
+    estimate->window_bytes += bytes;
+
+    if (estimate->window_start == 0) {
+        estimate->window_start = now;
+        estimate->window_lag = lag;
+        return 0;
+    }
+
+    if (now - estimate->window_start < GUAC_DISPLAY_COST_BANDWIDTH_WINDOW)
+        return 0;
+
+    double duration = now - estimate->window_start;
+    int lag_growth = lag - estimate->window_lag;
+
+    /* If the client is falling behind, the data sent during the window took
+     * longer to arrive than the window itself, and the rate that data was
+     * received is a measurement of the bandwidth actually available */
+    if (lag >= GUAC_DISPLAY_COST_SATURATED_LAG && lag_growth > 0) {
+        double sample = estimate->window_bytes / (duration + lag_growth);
+        if (estimate->bandwidth > 0)
+            guac_display_cost_average(&estimate->bandwidth, 1, sample);
+        else
+            estimate->bandwidth = sample;
+    }
+
+    /* Otherwise, the client kept up with everything sent, and the rate that
+     * data was sent is merely a lower bound */
+    else if (lag < GUAC_DISPLAY_COST_SATURATED_LAG && estimate->bandwidth > 0) {
+        double sample = estimate->window_bytes / duration;
+        if (sample > estimate->bandwidth)
+            estimate->bandwidth = sample;
+    }
+
+    estimate->window_bytes = 0;
+    estimate->window_start = now;
+    estimate->window_lag = lag;
+
+    return 1;
+
+}
+
+void guac_display_cost_end_frame(guac_display* display, size_t bytes) {
+
+    guac_client* client = display->client;
+    guac_display_cost_model* model = &display->cost_model;
+
+    /* NOTE: The processing lag must be determined without holding the ops
+     * FIFO lock, as doing so requires acquiring the lock guarding the list of
+     * connected users */
+    int lag = guac_client_get_processing_lag(client);
+    guac_timestamp now = guac_timestamp_current();
+    int report = 0;
+
+    guac_metrics_observe(GUAC_METRICS_PROCESSING_LAG, (uint64_t) lag * 1000);
+
+    guac_fifo_lock(&display->ops);
+
+    guac_display_bandwidth_update(&model->link, bytes, lag, now);
+
+    if (model->last_report == 0)
+        model->last_report = now;
+
+    else if (now - model->last_report >= GUAC_DISPLAY_COST_REPORT_INTERVAL) {
+        model->last_report = now;
+        report = 1;
+    }
+
+    guac_fifo_unlock(&display->ops);
+
+    if (report)
+        guac_display_cost_log(display, GUAC_LOG_DEBUG);
+
+}
+
+void guac_display_cost_log(guac_display* display, guac_client_log_level level) {
+
+    guac_client* client = display->client;
+
+    /* Copy the model such that the lock need not be held while logging */
+    guac_display_cost_model model;
+    guac_fifo_lock(&display->ops);
+    memcpy(&model, &display->cost_model, sizeof(model));
+    guac_fifo_unlock(&display->ops);
+
+    if (model.link.bandwidth > 0)
+        guac_client_log(client, level, "Encoder cost model: estimated "
+                "bandwidth is %i KiB/s. %" PRIu64 " decision(s) used static "
+                "heuristics, %" PRIu64 " measured an unmeasured format, and "
+                "%" PRIu64 " exceeded the time budgeted.",
+                (int) (model.link.bandwidth * 1000 / 1024), model.heuristic,
+                model.explored, model.over_budget);
+    else
+        guac_client_log(client, level, "Encoder cost model: bandwidth not "
+                "yet measured. %" PRIu64 " decision(s) used static "
+                "heuristics, %" PRIu64 " measured an unmeasured format, and "
+                "%" PRIu64 " exceeded the time budgeted.",
+                model.heuristic, model.explored, model.over_budget);
+
+    for (int region_class = 0; region_class < GUAC_DISPLAY_REGION_CLASSES; region_class++) {
+        for (int format = 0; format < GUAC_DISPLAY_FORMATS; format++) {
+
+            guac_display_cost_estimate* estimate = &model.estimates[region_class][format];
+            if (!estimate->selected && !estimate->samples)
+                continue;
+
+            guac_client_log(client, level, "Encoder cost model: %s content "
+                    "as %s: selected %" PRIu64 " time(s), %.3f us/pixel, "
+                    "%.3f bytes/pixel (%u measurement(s)).",
+                    GUAC_DISPLAY_REGION_CLASS_NAMES[region_class],
+                    GUAC_DISPLAY_FORMAT_NAMES[format], estimate->selected,
+                    estimate->usec_per_pixel, estimate->bytes_per_pixel,
+                    estimate->samples);
+
+        }
+    }
+
+}
@@ -25,6 +25,7 @@
 #include "guacamole/fifo.h"
 #include "guacamole/flag.h"
 #include "guacamole/mem.h"
+#include "guacamole/metrics.h"
 #include "guacamole/protocol.h"
 #include "guacamole/rect.h"
 #include "guacamole/rwlock.h"
@@ -322,6 +323,9 @@ void guac_display_end_multiple_frames(guac_display* display, int frames) {
 
     guac_rwlock_acquire_write_lock(&display->last_frame.lock);
 
+    /* Planning is timed only if metrics are actually being recorded */
+    uint64_t plan_start = guac_metrics_enabled() ? guac_display_cost_usec() : 0;
+
     /* PASS 0: Create naive plan, identify minimal dirty rects by comparing the
      * changes between the pending and last frames.
      *
@@ -347,10 +351,13 @@ void guac_display_end_multiple_frames(guac_display* display, int frames) {
         /* PASS 2 (and 3): Index all modified cells by their graphical contents and
          * search the previous frame for occurrences of the same content. Where any
          * draws could instead be represented as copies from the previous frame, do
-         * so instead of sending new image data. */
+         * so instead of sending new image data. Remaining draws of content that
+         * was sent recently are similarly replaced with copies from the tile
+         * cache. */
         GUAC_DISPLAY_PLAN_BEGIN_PHASE();
         PFR_guac_display_plan_index_dirty_cells(plan);
         PFR_LFR_guac_display_plan_rewrite_as_copies(plan);
+        PFR_LFW_guac_display_plan_rewrite_as_cached(plan);
         GUAC_DISPLAY_PLAN_END_PHASE(display, "search", 3, 5);
 
         /* PASS 4 (and 5): Combine adjacent updates in horizontal and vertical
@@ -363,6 +370,10 @@ void guac_display_end_multiple_frames(guac_display* display, int frames) {
         PFW_guac_display_plan_combine_vertically(plan);
         GUAC_DISPLAY_PLAN_END_PHASE(display, "combine", 4, 5);
 
+        /* Note which cells will contain lossy data once the copies and
+         * rectangles within the finalized plan have been drawn */
+        PFW_LFR_guac_display_plan_track_lossy(plan);
+
     }
 
     /*
@@ -380,6 +391,10 @@ void guac_display_end_multiple_frames(guac_display* display, int frames) {
 
     guac_rwlock_release_lock(&display->last_frame.lock);
 
+    if (plan_start)
+        guac_metrics_observe(GUAC_METRICS_FRAME_PLAN_TIME,
+                guac_display_cost_usec() - plan_start);
+
     /* Awaken worker threads to perform the rest of the tasks required for the
      * frame (if any such tasks remain) */
     if (plan != NULL) {
@@ -400,6 +415,13 @@ void guac_display_end_multiple_frames(guac_display* display, int frames) {
         guac_fifo_enqueue(&display->ops, &end_frame_op);
     }
 
+    if (plan_start) {
+        guac_fifo_lock(&display->ops);
+        size_t depth = display->ops.item_count;
+        guac_fifo_unlock(&display->ops);
+        guac_metrics_observe(GUAC_METRICS_OPS_QUEUE_DEPTH, depth);
+    }
+
 finished_with_pending_frame_lock:
     guac_rwlock_release_lock(&display->pending_frame.lock);
 
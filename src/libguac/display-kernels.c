@@ -0,0 +1,754 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "display-kernels.h"
+#include "guacamole/mem.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GUAC_DISPLAY_KERNELS_NEON
+#endif
+
+/*
+ * NOTE: All kernels within this file MUST produce results that are identical
+ * to those of the scalar kernels, including for inputs that are not a
+ * multiple of the vector width. The unit tests for these kernels verify each
+ * supported variant against the scalar variant.
+ */
+
+/* ---------------- SCALAR ---------------- */
+
+/**
+ * Returns whether the scalar kernels are supported by the current processor.
+ * The scalar kernels do not depend on any processor features and are thus
+ * always supported.
+ *
+ * @return
+ *     Always non-zero.
+ */
+static int guac_display_kernels_scalar_supported(void) {
+    return 1;
+}
+
+/**
+ * Scalar implementation of guac_display_kernel_memcmp, comparing one 32-bit
+ * quantity at a time.
+ *
+ * @see guac_display_kernel_memcmp
+ */
+static size_t guac_display_memcmp_scalar(const uint32_t* restrict buffer_a,
+        const uint32_t* restrict buffer_b, size_t count, size_t* pos) {
+
+    /* Locate first difference between the buffers, if any */
+    size_t first = 0;
+    while (first < count) {
+
+        if (*(buffer_a++) != *(buffer_b++))
+            break;
+
+        first++;
+
+    }
+
+    /* If we reached the end without finding any differences, no need to search
+     * further - the buffers are identical */
+    if (first >= count)
+        return 0;
+
+    /* Search through all remaining values in the buffers for the last
+     * difference (which may be identical to the first) */
+    size_t last = first;
+    size_t offset = first + 1;
+    while (offset < count) {
+
+        if (*(buffer_a++) != *(buffer_b++))
+            last = offset;
+
+        offset++;
+
+    }
+
+    /* Final difference found - provide caller with the starting offset and
+     * length (in 32-bit quantities) of differences */
+    *pos = first;
+    return last - first + 1;
+
+}
+
+/**
+ * Scalar implementation of guac_display_kernel_hash_row.
+ *
+ * @see guac_display_kernel_hash_row
+ */
+static void guac_display_hash_row_scalar(const uint32_t* restrict row,
+        uint64_t* restrict cell_hash, size_t length) {
+
+    uint64_t row_hash = 0;
+    for (size_t i = 0; i < length; i++) {
+
+        /* Update hash value for current row segment */
+        row_hash = ((row_hash * 31) << 1) + row[i];
+
+        /* Incorporate row hash value into overall cell hash */
+        cell_hash[i] = ((cell_hash[i] * 31) << 1) + row_hash;
+
+    }
+
+}
+
+/**
+ * Rounds the given value down to the nearest power of two.
+ *
+ * @param value
+ *     The value to round.
+ *
+ * @return
+ *     The power of two that is closest to the given value without exceeding
+ *     that value.
+ */
+static size_t guac_display_round_pot(size_t value) {
+
+    if (value <= 2)
+        return value;
+
+    size_t rounded = 1;
+    while (value >>= 1)
+        rounded <<= 1;
+
+    return rounded;
+
+}
+
+/**
+ * Scalar implementation of guac_display_kernel_is_single_color.
+ *
+ * This function attempts to perform a fast comparison leveraging memcmp() to
+ * reduce the search space, rather than simply looping through each pixel one
+ * at a time. Basic benchmarks show this approach to be roughly twice as fast
+ * as a simple loop for arbitrary buffer lengths and four times as fast for
+ * buffer lengths that are powers of two.
+ *
+ * @see guac_display_kernel_is_single_color
+ */
+static int guac_display_is_single_color_scalar(const unsigned char* restrict buffer,
+        size_t length, uint32_t* restrict color) {
+
+    /* It is vacuously true that all the 32-bit quantities in an empty buffer
+     * are the same */
+    if (length == 0) {
+        *color = 0x00000000;
+        return 1;
+    }
+
+    /* A single 32-bit value is the same as itself */
+    if (length == 4) {
+        *color = ((const uint32_t*) buffer)[0];
+        return 1;
+    }
+
+    /* Simply directly compare if there are only two values */
+    if (length == 8) {
+        uint32_t a = ((const uint32_t*) buffer)[0];
+        uint32_t b = ((const uint32_t*) buffer)[1];
+        if (a == b) {
+            *color = a;
+            return 1;
+        }
+    }
+
+    /* For all other lengths, avoid comparing if finding a match is impossible.
+     * A buffer can consist entirely of the same 32-bit (4-byte) quantity
+     * repeated throughout the buffer only if that buffer's length is a
+     * multiple of 4. */
+    if ((length % 4) != 0)
+        return 0;
+
+    /* A buffer consists entirely of the same 32-bit quantity repeated
+     * throughout if (1) the two halves of the buffer are the same and (2) one
+     * of those halves is known to consist entirely of the same 32-bit quantity
+     * repeated throughout. */
+
+    size_t pot_length = guac_display_round_pot(guac_mem_ckd_sub_or_die(length, 1));
+    size_t remaining_length = guac_mem_ckd_sub_or_die(length, pot_length);
+
+    /* Easiest recursive case: the buffer is already a power of two and can be
+     * split into two very easy-to-compare halves */
+    if (pot_length == remaining_length) {
+        return !memcmp(buffer, buffer + pot_length, pot_length)
+            && guac_display_is_single_color_scalar(buffer, pot_length, color);
+    }
+
+    /* For buffers that can't be split into two power-of-two halves, decide
+     * based on one easy power-of-two case and one not-so-easy case of whatever
+     * remains */
+    uint32_t color_a = 0, color_b = 0;
+    if (guac_display_is_single_color_scalar(buffer, pot_length, &color_a)
+        && guac_display_is_single_color_scalar(buffer + pot_length, remaining_length, &color_b)
+        && color_a == color_b) {
+
+        *color = color_a;
+        return 1;
+
+    }
+
+    return 0;
+
+}
+
+const guac_display_kernels guac_display_kernels_scalar = {
+    .name            = "scalar",
+    .supported       = guac_display_kernels_scalar_supported,
+    .memcmp          = guac_display_memcmp_scalar,
+    .hash_row        = guac_display_hash_row_scalar,
+    .is_single_color = guac_display_is_single_color_scalar
+};
+
+/* ---------------- SSE2 / AVX2 ---------------- */
+
+#ifdef HAVE_X86_SIMD
+
+/**
+ * Function attribute which allows the compiler to emit SSE2 instructions
+ * within a function, regardless of the instruction set otherwise targeted.
+ */
+#define GUAC_DISPLAY_KERNEL_SSE2 __attribute__((target("sse2")))
+
+/**
+ * Function attribute which allows the compiler to emit AVX2 instructions
+ * within a function, regardless of the instruction set otherwise targeted.
+ */
+#define GUAC_DISPLAY_KERNEL_AVX2 __attribute__((target("avx2")))
+
+/**
+ * Returns whether the current processor supports SSE2.
+ *
+ * @return
+ *     Non-zero if SSE2 is supported, zero otherwise.
+ */
+static int guac_display_kernels_sse2_supported(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+/**
+ * Returns whether the current processor supports AVX2.
+ *
+ * @return
+ *     Non-zero if AVX2 is supported, zero otherwise.
+ */
+static int guac_display_kernels_avx2_supported(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+/**
+ * Returns a bitmask with one bit set for each 32-bit lane of the given SSE2
+ * vectors that differs, with the least-significant bit corresponding to the
+ * lowest lane.
+ */
+GUAC_DISPLAY_KERNEL_SSE2
+static inline int guac_display_diff_mask_sse2(const uint32_t* a, const uint32_t* b) {
+    __m128i va = _mm_loadu_si128((const __m128i*) a);
+    __m128i vb = _mm_loadu_si128((const __m128i*) b);
+    return ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(va, vb))) & 0xF;
+}
+
+/**
+ * SSE2 implementation of guac_display_kernel_memcmp, comparing four 32-bit
+ * quantities at a time. Unlike the scalar implementation, the last difference
+ * is located by searching backwards from the end of the buffers.
+ *
+ * @see guac_display_kernel_memcmp
+ */
+GUAC_DISPLAY_KERNEL_SSE2
+static size_t guac_display_memcmp_sse2(const uint32_t* restrict buffer_a,
+        const uint32_t* restrict buffer_b, size_t count, size_t* pos) {
+
+    int mask;
+
+    /* Locate first difference between the buffers, if any */
+    size_t first = 0;
+    for (; first + 4 <= count; first += 4) {
+        if ((mask = guac_display_diff_mask_sse2(buffer_a + first, buffer_b + first)) != 0) {
+            first += __builtin_ctz(mask);
+            break;
+        }
+    }
+
+    if (first + 4 > count) {
+        while (first < count && buffer_a[first] == buffer_b[first])
+            first++;
+    }
+
+    /* The buffers are identical if no difference was found */
+    if (first >= count)
+        return 0;
+
+    /* Locate last difference by searching backwards (a difference is
+     * guaranteed to exist at "first", so this will never search past that
+     * point) */
+    size_t last = count;
+    while (last - first >= 4) {
+        if ((mask = guac_display_diff_mask_sse2(buffer_a + last - 4, buffer_b + last - 4)) != 0) {
+            last = last - 4 + (31 - __builtin_clz(mask));
+            goto found_last;
+        }
+        last -= 4;
+    }
+
+    do {
+        last--;
+    } while (buffer_a[last] == buffer_b[last]);
+
+found_last:
+    *pos = first;
+    return last - first + 1;
+
+}
+
+/**
+ * SSE2 implementation of guac_display_kernel_hash_row. The row hash itself is
+ * inherently sequential and is calculated one pixel at a time, while the cell
+ * hashes are updated two at a time.
+ *
+ * @see guac_display_kernel_hash_row
+ */
+GUAC_DISPLAY_KERNEL_SSE2
+static void guac_display_hash_row_sse2(const uint32_t* restrict row,
+        uint64_t* restrict cell_hash, size_t length) {
+
+    uint64_t row_hash = 0;
+
+    size_t i = 0;
+    for (; i + 2 <= length; i += 2) {
+
+        uint64_t r0 = row_hash = ((row_hash * 31) << 1) + row[i];
+        uint64_t r1 = row_hash = ((row_hash * 31) << 1) + row[i + 1];
+
+        /* cell_hash = cell_hash * 62 + row_hash, where multiplication by 62
+         * is ((cell_hash << 6) - (cell_hash << 1)) */
+        __m128i cells = _mm_loadu_si128((const __m128i*) (cell_hash + i));
+        cells = _mm_sub_epi64(_mm_slli_epi64(cells, 6), _mm_slli_epi64(cells, 1));
+        cells = _mm_add_epi64(cells, _mm_set_epi64x((long long) r1, (long long) r0));
+        _mm_storeu_si128((__m128i*) (cell_hash + i), cells);
+
+    }
+
+    for (; i < length; i++) {
+        row_hash = ((row_hash * 31) << 1) + row[i];
+        cell_hash[i] = ((cell_hash[i] * 31) << 1) + row_hash;
+    }
+
+}
+
+/**
+ * SSE2 implementation of guac_display_kernel_is_single_color, comparing four
+ * 32-bit quantities at a time against the first.
+ *
+ * @see guac_display_kernel_is_single_color
+ */
+GUAC_DISPLAY_KERNEL_SSE2
+static int guac_display_is_single_color_sse2(const unsigned char* restrict buffer,
+        size_t length, uint32_t* restrict color) {
+
+    if (length == 0) {
+        *color = 0x00000000;
+        return 1;
+    }
+
+    if ((length % 4) != 0)
+        return 0;
+
+    const uint32_t* pixels = (const uint32_t*) buffer;
+    size_t count = length / 4;
+    uint32_t first = pixels[0];
+
+    __m128i expected = _mm_set1_epi32((int) first);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i current = _mm_loadu_si128((const __m128i*) (pixels + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(current, expected)) != 0xFFFF)
+            return 0;
+    }
+
+    for (; i < count; i++) {
+        if (pixels[i] != first)
+            return 0;
+    }
+
+    *color = first;
+    return 1;
+
+}
+
+/**
+ * Returns a bitmask with one bit set for each 32-bit lane of the given AVX2
+ * vectors that differs, with the least-significant bit corresponding to the
+ * lowest lane.
+ */
+GUAC_DISPLAY_KERNEL_AVX2
+static inline int guac_display_diff_mask_avx2(const uint32_t* a, const uint32_t* b) {
+    __m256i va = _mm256_loadu_si256((const __m256i*) a);
+    __m256i vb = _mm256_loadu_si256((const __m256i*) b);
+    return ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(va, vb))) & 0xFF;
+}
+
+/**
+ * AVX2 implementation of guac_display_kernel_memcmp, comparing eight 32-bit
+ * quantities at a time. Unlike the scalar implementation, the last difference
+ * is located by searching backwards from the end of the buffers.
+ *
+ * @see guac_display_kernel_memcmp
+ */
+GUAC_DISPLAY_KERNEL_AVX2
+static size_t guac_display_memcmp_avx2(const uint32_t* restrict buffer_a,
+        const uint32_t* restrict buffer_b, size_t count, size_t* pos) {
+
+    int mask;
+
+    /* Locate first difference between the buffers, if any */
+    size_t first = 0;
+    for (; first + 8 <= count; first += 8) {
+        if ((mask = guac_display_diff_mask_avx2(buffer_a + first, buffer_b + first)) != 0) {
+            first += __builtin_ctz(mask);
+            break;
+        }
+    }
+
+    if (first + 8 > count) {
+        while (first < count && buffer_a[first] == buffer_b[first])
+            first++;
+    }
+
+    /* The buffers are identical if no difference was found */
+    if (first >= count)
+        return 0;
+
+    /* Locate last difference by searching backwards (a difference is
+     * guaranteed to exist at "first", so this will never search past that
+     * point) */
+    size_t last = count;
+    while (last - first >= 8) {
+        if ((mask = guac_display_diff_mask_avx2(buffer_a + last - 8, buffer_b + last - 8)) != 0) {
+            last = last - 8 + (31 - __builtin_clz(mask));
+            goto found_last;
+        }
+        last -= 8;
+    }
+
+    do {
+        last--;
+    } while (buffer_a[last] == buffer_b[last]);
+
+found_last:
+    *pos = first;
+    return last - first + 1;
+
+}
+
+/**
+ * AVX2 implementation of guac_display_kernel_hash_row. The row hash itself is
+ * inherently sequential and is calculated one pixel at a time, while the cell
+ * hashes are updated four at a time.
+ *
+ * @see guac_display_kernel_hash_row
+ */
+GUAC_DISPLAY_KERNEL_AVX2
+static void guac_display_hash_row_avx2(const uint32_t* restrict row,
+        uint64_t* restrict cell_hash, size_t length) {
+
+    uint64_t row_hash = 0;
+
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+
+        uint64_t r0 = row_hash = ((row_hash * 31) << 1) + row[i];
+        uint64_t r1 = row_hash = ((row_hash * 31) << 1) + row[i + 1];
+        uint64_t r2 = row_hash = ((row_hash * 31) << 1) + row[i + 2];
+        uint64_t r3 = row_hash = ((row_hash * 31) << 1) + row[i + 3];
+
+        /* cell_hash = cell_hash * 62 + row_hash, where multiplication by 62
+         * is ((cell_hash << 6) - (cell_hash << 1)) */
+        __m256i cells = _mm256_loadu_si256((const __m256i*) (cell_hash + i));
+        cells = _mm256_sub_epi64(_mm256_slli_epi64(cells, 6), _mm256_slli_epi64(cells, 1));
+        cells = _mm256_add_epi64(cells, _mm256_set_epi64x((long long) r3,
+                    (long long) r2, (long long) r1, (long long) r0));
+        _mm256_storeu_si256((__m256i*) (cell_hash + i), cells);
+
+    }
+
+    for (; i < length; i++) {
+        row_hash = ((row_hash * 31) << 1) + row[i];
+        cell_hash[i] = ((cell_hash[i] * 31) << 1) + row_hash;
+    }
+
+}
+
+/**
+ * AVX2 implementation of guac_display_kernel_is_single_color, comparing eight
+ * 32-bit quantities at a time against the first.
+ *
+ * @see guac_display_kernel_is_single_color
+ */
+GUAC_DISPLAY_KERNEL_AVX2
+static int guac_display_is_single_color_avx2(const unsigned char* restrict buffer,
+        size_t length, uint32_t* restrict color) {
+
+    if (length == 0) {
+        *color = 0x00000000;
+        return 1;
+    }
+
+    if ((length % 4) != 0)
+        return 0;
+
+    const uint32_t* pixels = (const uint32_t*) buffer;
+    size_t count = length / 4;
+    uint32_t first = pixels[0];
+
+    __m256i expected = _mm256_set1_epi32((int) first);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i current = _mm256_loadu_si256((const __m256i*) (pixels + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(current, expected)) != -1)
+            return 0;
+    }
+
+    for (; i < count; i++) {
+        if (pixels[i] != first)
+            return 0;
+    }
+
+    *color = first;
+    return 1;
+
+}
+
+/**
+ * Pixel kernels leveraging SSE2.
+ */
+static const guac_display_kernels guac_display_kernels_sse2 = {
+    .name            = "sse2",
+    .supported       = guac_display_kernels_sse2_supported,
+    .memcmp          = guac_display_memcmp_sse2,
+    .hash_row        = guac_display_hash_row_sse2,
+    .is_single_color = guac_display_is_single_color_sse2
+};
+
+/**
+ * Pixel kernels leveraging AVX2.
+ */
+static const guac_display_kernels guac_display_kernels_avx2 = {
+    .name            = "avx2",
+    .supported       = guac_display_kernels_avx2_supported,
+    .memcmp          = guac_display_memcmp_avx2,
+    .hash_row        = guac_display_hash_row_avx2,
+    .is_single_color = guac_display_is_single_color_avx2
+};
+
+#endif
+
+/* ---------------- NEON ---------------- */
+
+#ifdef GUAC_DISPLAY_KERNELS_NEON
+
+/**
+ * Returns whether the current processor supports NEON. NEON is a mandatory
+ * part of AArch64, and is thus always supported if these kernels have been
+ * compiled at all.
+ *
+ * @return
+ *     Always non-zero.
+ */
+static int guac_display_kernels_neon_supported(void) {
+    return 1;
+}
+
+/**
+ * Returns whether any 32-bit lane of the given NEON vectors differs.
+ */
+static inline int guac_display_differs_neon(const uint32_t* a, const uint32_t* b) {
+    return vminvq_u32(vceqq_u32(vld1q_u32(a), vld1q_u32(b))) == 0;
+}
+
+/**
+ * NEON implementation of guac_display_kernel_memcmp, comparing four 32-bit
+ * quantities at a time. Unlike the scalar implementation, the last difference
+ * is located by searching backwards from the end of the buffers.
+ *
+ * @see guac_display_kernel_memcmp
+ */
+static size_t guac_display_memcmp_neon(const uint32_t* restrict buffer_a,
+        const uint32_t* restrict buffer_b, size_t count, size_t* pos) {
+
+    /* Skip past all leading groups of four identical values */
+    size_t first = 0;
+    while (first + 4 <= count && !guac_display_differs_neon(buffer_a + first, buffer_b + first))
+        first += 4;
+
+    /* Pinpoint first difference, if any */
+    while (first < count && buffer_a[first] == buffer_b[first])
+        first++;
+
+    /* The buffers are identical if no difference was found */
+    if (first >= count)
+        return 0;
+
+    /* Skip past all trailing groups of four identical values (a difference is
+     * guaranteed to exist at "first", so this will never search past that
+     * point) */
+    size_t last = count;
+    while (last - first >= 4 && !guac_display_differs_neon(buffer_a + last - 4, buffer_b + last - 4))
+        last -= 4;
+
+    /* Pinpoint last difference */
+    do {
+        last--;
+    } while (buffer_a[last] == buffer_b[last]);
+
+    *pos = first;
+    return last - first + 1;
+
+}
+
+/**
+ * NEON implementation of guac_display_kernel_hash_row. The row hash itself is
+ * inherently sequential and is calculated one pixel at a time, while the cell
+ * hashes are updated two at a time.
+ *
+ * @see guac_display_kernel_hash_row
+ */
+static void guac_display_hash_row_neon(const uint32_t* restrict row,
+        uint64_t* restrict cell_hash, size_t length) {
+
+    uint64_t row_hash = 0;
+    uint64_t row_hashes[2];
+
+    size_t i = 0;
+    for (; i + 2 <= length; i += 2) {
+
+        row_hashes[0] = row_hash = ((row_hash * 31) << 1) + row[i];
+        row_hashes[1] = row_hash = ((row_hash * 31) << 1) + row[i + 1];
+
+        /* cell_hash = cell_hash * 62 + row_hash, where multiplication by 62
+         * is ((cell_hash << 6) - (cell_hash << 1)) */
+        uint64x2_t cells = vld1q_u64(cell_hash + i);
+        cells = vsubq_u64(vshlq_n_u64(cells, 6), vshlq_n_u64(cells, 1));
+        vst1q_u64(cell_hash + i, vaddq_u64(cells, vld1q_u64(row_hashes)));
+
+    }
+
+    for (; i < length; i++) {
+        row_hash = ((row_hash * 31) << 1) + row[i];
+        cell_hash[i] = ((cell_hash[i] * 31) << 1) + row_hash;
+    }
+
+}
+
+/**
+ * NEON implementation of guac_display_kernel_is_single_color, comparing four
+ * 32-bit quantities at a time against the first.
+ *
+ * @see guac_display_kernel_is_single_color
+ */
+static int guac_display_is_single_color_neon(const unsigned char* restrict buffer,
+        size_t length, uint32_t* restrict color) {
+
+    if (length == 0) {
+        *color = 0x00000000;
+        return 1;
+    }
+
+    if ((length % 4) != 0)
+        return 0;
+
+    const uint32_t* pixels = (const uint32_t*) buffer;
+    size_t count = length / 4;
+    uint32_t first = pixels[0];
+
+    uint32x4_t expected = vdupq_n_u32(first);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        if (vminvq_u32(vceqq_u32(vld1q_u32(pixels + i), expected)) == 0)
+            return 0;
+    }
+
+    for (; i < count; i++) {
+        if (pixels[i] != first)
+            return 0;
+    }
+
+    *color = first;
+    return 1;
+
+}
+
+/**
+ * Pixel kernels leveraging NEON.
+ */
+static const guac_display_kernels guac_display_kernels_neon = {
+    .name            = "neon",
+    .supported       = guac_display_kernels_neon_supported,
+    .memcmp          = guac_display_memcmp_neon,
+    .hash_row        = guac_display_hash_row_neon,
+    .is_single_color = guac_display_is_single_color_neon
+};
+
+#endif
+
+const guac_display_kernels* const guac_display_kernels_all[] = {
+    &guac_display_kernels_scalar,
+#ifdef HAVE_X86_SIMD
+    &guac_display_kernels_sse2,
+    &guac_display_kernels_avx2,
+#endif
+#ifdef GUAC_DISPLAY_KERNELS_NEON
+    &guac_display_kernels_neon,
+#endif
+    NULL
+};
+
+const guac_display_kernels* guac_display_kernels_select(void) {
+
+    const guac_display_kernels* selected = &guac_display_kernels_scalar;
+
+    /* Prefer the last supported kernels (kernels are listed in order of
+     * increasing preference) */
+    for (const guac_display_kernels* const* current = guac_display_kernels_all;
+            *current != NULL; current++) {
+
+        if ((*current)->supported())
+            selected = *current;
+
+    }
+
+    return selected;
+
+}
@@ -0,0 +1,172 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_DISPLAY_KERNELS_H
+#define GUAC_DISPLAY_KERNELS_H
+
+#include <stdint.h>
+#include <unistd.h>
+
+/**
+ * Compares two series of 32-bit quantities, determining the overall location
+ * and length of the differences in the two provided buffers. The length and
+ * location determined are the length and location of the smallest contiguous
+ * series of 32-bit quantities that differ between the buffers.
+ *
+ * @param buffer_a
+ *     The first buffer to compare.
+ *
+ * @param buffer_b
+ *     The buffer to compare with buffer_a.
+ *
+ * @param count
+ *     The number of 32-bit quantities in each buffer.
+ *
+ * @param pos
+ *     A pointer to a size_t that should receive the offset of the difference,
+ *     if the two buffers turn out to contain different data. The value of the
+ *     size_t will only be modified if at least one difference is found.
+ *
+ * @return
+ *     The number of 32-bit quantities after and including the offset returned
+ *     via pos that are different between buffer_a and buffer_b, or zero if
+ *     there are no such differences.
+ */
+typedef size_t guac_display_kernel_memcmp(const uint32_t* restrict buffer_a,
+        const uint32_t* restrict buffer_b, size_t count, size_t* pos);
+
+/**
+ * Advances the rolling hashes used to locate 64x64 regions of image data by a
+ * single row of pixels. The hash of each row segment is updated pixel by pixel
+ * from left to right, and the resulting row hash at each position is folded
+ * into the corresponding element of the given array of cell hashes. After 64
+ * rows have been processed, each element of the cell hash array will contain
+ * the hash of the 64x64 region whose bottom-right corner is the pixel at the
+ * same position in the current row.
+ *
+ * @param row
+ *     The row of 32-bit pixels to incorporate into the hashes.
+ *
+ * @param cell_hash
+ *     The array of cell hashes to update, which must contain at least as many
+ *     elements as there are pixels in the row.
+ *
+ * @param length
+ *     The number of pixels in the row.
+ */
+typedef void guac_display_kernel_hash_row(const uint32_t* restrict row,
+        uint64_t* restrict cell_hash, size_t length);
+
+/**
+ * Returns whether the given buffer consists entirely of the same 32-bit
+ * quantity (ie: a single ARGB pixel), repeated throughout the buffer.
+ *
+ * @param buffer
+ *     The buffer to check.
+ *
+ * @param length
+ *     The number of bytes in the buffer.
+ *
+ * @param color
+ *     A pointer to a uint32_t to receive the value of the 32-bit quantity that
+ *     is repeated, if applicable.
+ *
+ * @return
+ *     Non-zero if the same 32-bit quantity is repeated throughout the buffer,
+ *     zero otherwise. If the same value is indeed repeated throughout the
+ *     buffer, that value is stored in the variable pointed to by the "color"
+ *     pointer. If the value is not repeated, the variable pointed to by the
+ *     "color" pointer is left untouched.
+ */
+typedef int guac_display_kernel_is_single_color(const unsigned char* restrict buffer,
+        size_t length, uint32_t* restrict color);
+
+/**
+ * Returns whether the processor that the current process is running on
+ * supports the instructions required by a particular set of pixel kernels.
+ *
+ * @return
+ *     Non-zero if the required instructions are supported, zero otherwise.
+ */
+typedef int guac_display_kernels_supported(void);
+
+/**
+ * A set of implementations of the pixel-level loops ("kernels") that dominate
+ * the cost of building a guac_display_plan. Each set of kernels produces
+ * results that are bit-for-bit identical to those of every other set, varying
+ * only in the processor features leveraged to produce those results.
+ */
+typedef struct guac_display_kernels {
+
+    /**
+     * A human-readable name for this set of kernels, such as "scalar" or
+     * "avx2".
+     */
+    const char* name;
+
+    /**
+     * Returns whether the current processor supports this set of kernels.
+     */
+    guac_display_kernels_supported* supported;
+
+    /**
+     * Locates the differences between two series of pixels.
+     */
+    guac_display_kernel_memcmp* memcmp;
+
+    /**
+     * Advances the rolling hashes used to search for copied image data by one
+     * row.
+     */
+    guac_display_kernel_hash_row* hash_row;
+
+    /**
+     * Tests whether a buffer consists entirely of a single pixel value.
+     */
+    guac_display_kernel_is_single_color* is_single_color;
+
+} guac_display_kernels;
+
+/**
+ * Portable implementations of all pixel kernels that do not depend on any
+ * particular processor features. These kernels are always available and are
+ * the reference against which all other kernels are verified.
+ */
+extern const guac_display_kernels guac_display_kernels_scalar;
+
+/**
+ * NULL-terminated array of all sets of pixel kernels compiled into libguac,
+ * in order of increasing preference. Not all of these kernels are
+ * necessarily supported by the current processor, and each entry must be
+ * checked with its supported() function before use.
+ */
+extern const guac_display_kernels* const guac_display_kernels_all[];
+
+/**
+ * Returns the most preferable set of pixel kernels that is supported by the
+ * current processor. If no kernels leveraging processor-specific features are
+ * supported, guac_display_kernels_scalar is returned.
+ *
+ * @return
+ *     The most preferable set of pixel kernels supported by the current
+ *     processor.
+ */
+const guac_display_kernels* guac_display_kernels_select(void);
+
+#endif
@@ -332,6 +332,16 @@ void guac_display_remove_layer(guac_display_layer* display_layer) {
     if (display_layer->last_frame.next != NULL)
         display_layer->last_frame.next->last_frame.prev = display_layer->last_frame.prev;
 
+    /* Tiles that have yet to be copied from this layer into the tile cache
+     * can no longer be copied */
+    LFW_guac_display_tile_cache_forget_layer(display, display_layer);
+
+    /* Likewise, previews sent to this layer can no longer be refined */
+    LFW_guac_display_forget_refinements(display, display_layer);
+
+    /* Reports of how images were encoded for this layer no longer apply */
+    LFW_guac_display_forget_encoding_reports(display, display_layer);
+
     guac_rwlock_release_lock(&display->last_frame.lock);
 
     /*
@@ -0,0 +1,390 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-plan.h"
+#include "display-priv.h"
+#include "guacamole/display.h"
+#include "guacamole/fifo.h"
+#include "guacamole/mem.h"
+#include "guacamole/rect.h"
+#include "guacamole/rwlock.h"
+
+/**
+ * Returns whether the first rectangle completely covers the second.
+ *
+ * @param outer
+ *     The rectangle that may cover the other rectangle.
+ *
+ * @param inner
+ *     The rectangle that may be covered.
+ *
+ * @return
+ *     Non-zero if the first rectangle completely covers the second, zero
+ *     otherwise.
+ */
+static int guac_display_rect_covers(const guac_rect* outer, const guac_rect* inner) {
+    return outer->left   <= inner->left
+        && outer->top    <= inner->top
+        && outer->right  >= inner->right
+        && outer->bottom >= inner->bottom;
+}
+
+/**
+ * Callback invoked for each cell of a layer that is affected by an update.
+ *
+ * @param layer
+ *     The layer containing the cell.
+ *
+ * @param cell
+ *     The affected cell.
+ *
+ * @param bounds
+ *     The region of the layer covered by the cell, constrained to the bounds
+ *     of the layer.
+ *
+ * @param data
+ *     The arbitrary data provided to guac_display_foreach_cell().
+ */
+typedef void guac_display_cell_callback(guac_display_layer* layer,
+        guac_display_layer_cell* cell, const guac_rect* bounds, void* data);
+
+/**
+ * Invokes the given callback for each cell of the given layer that
+ * intersects the given rectangle. The write lock of the display's
+ * pending_frame.lock MUST be held.
+ *
+ * @param layer
+ *     The layer whose cells should be visited.
+ *
+ * @param rect
+ *     The region of the layer whose cells should be visited.
+ *
+ * @param callback
+ *     The callback to invoke for each cell.
+ *
+ * @param data
+ *     Arbitrary data to provide to the callback.
+ */
+static void PFW_guac_display_foreach_cell(guac_display_layer* layer,
+        const guac_rect* rect, guac_display_cell_callback* callback,
+        void* data) {
+
+    guac_rect layer_bounds = {
+        .left   = 0,
+        .top    = 0,
+        .right  = layer->pending_frame.width,
+        .bottom = layer->pending_frame.height
+    };
+
+    guac_rect affected = *rect;
+    guac_rect_constrain(&affected, &layer_bounds);
+    if (guac_rect_is_empty(&affected))
+        return;
+
+    int left   = affected.left / GUAC_DISPLAY_CELL_SIZE;
+    int top    = affected.top / GUAC_DISPLAY_CELL_SIZE;
+    int right  = GUAC_DISPLAY_CELL_DIMENSION(affected.right);
+    int bottom = GUAC_DISPLAY_CELL_DIMENSION(affected.bottom);
+
+    /* The cells array may lag behind the dimensions of the layer only while a
+     * resize is in progress, but never visit cells that do not exist */
+    if (right > (int) layer->pending_frame_cells_width)
+        right = layer->pending_frame_cells_width;
+
+    if (bottom > (int) layer->pending_frame_cells_height)
+        bottom = layer->pending_frame_cells_height;
+
+    for (int y = top; y < bottom; y++) {
+
+        guac_display_layer_cell* cell = layer->pending_frame_cells
+            + guac_mem_ckd_mul_or_die(y, layer->pending_frame_cells_width) + left;
+
+        for (int x = left; x < right; x++, cell++) {
+
+            guac_rect bounds;
+            guac_rect_init(&bounds, x * GUAC_DISPLAY_CELL_SIZE, y * GUAC_DISPLAY_CELL_SIZE,
+                    GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_CELL_SIZE);
+            guac_rect_constrain(&bounds, &layer_bounds);
+
+            callback(layer, cell, &bounds, data);
+
+        }
+
+    }
+
+}
+
+/**
+ * Marks the given cell as lossy. This function is a
+ * guac_display_cell_callback, and the data provided is ignored.
+ */
+static void guac_display_cell_mark_lossy(guac_display_layer* layer,
+        guac_display_layer_cell* cell, const guac_rect* bounds, void* data) {
+    cell->lossy = 1;
+}
+
+/**
+ * Marks the given cell as no longer lossy if the entirety of the cell is
+ * covered by lossless data. This function is a guac_display_cell_callback,
+ * and the data provided must be the guac_rect covered by lossless data.
+ */
+static void guac_display_cell_clear_lossy(guac_display_layer* layer,
+        guac_display_layer_cell* cell, const guac_rect* bounds, void* data) {
+
+    const guac_rect* lossless = (const guac_rect*) data;
+    if (guac_display_rect_covers(lossless, bounds))
+        cell->lossy = 0;
+
+}
+
+/**
+ * Sets the int pointed to by the given data to non-zero if the given cell is
+ * lossy. This function is a guac_display_cell_callback, and the data provided
+ * must be a pointer to an int.
+ */
+static void guac_display_cell_check_lossy(guac_display_layer* layer,
+        guac_display_layer_cell* cell, const guac_rect* bounds, void* data) {
+
+    int* lossy = (int*) data;
+    if (cell->lossy)
+        *lossy = 1;
+
+}
+
+/**
+ * Returns the layer whose client-side copy of the last frame is stored within
+ * the given buffer, if any. The write lock of the display's pending_frame.lock
+ * MUST be held.
+ *
+ * @param display
+ *     The guac_display to search.
+ *
+ * @param buffer
+ *     The buffer to search for.
+ *
+ * @return
+ *     The layer whose last_frame_buffer is the given buffer, or NULL if the
+ *     buffer is not associated with any layer.
+ */
+static guac_display_layer* PFW_guac_display_find_last_frame_buffer(
+        guac_display* display, const guac_layer* buffer) {
+
+    guac_display_layer* current = display->pending_frame.layers;
+    while (current != NULL) {
+
+        if (current->last_frame_buffer == buffer)
+            return current;
+
+        current = current->pending_frame.next;
+
+    }
+
+    return NULL;
+
+}
+
+void guac_display_report_encoding(guac_display* display,
+        guac_display_layer* layer, const guac_rect* rect, int lossy) {
+
+    guac_fifo_lock(&display->ops);
+
+    guac_display_encoding_report* reports = guac_display_arena_reserve(
+            &display->encoding_reports, display->encoding_report_count + 1,
+            sizeof(guac_display_encoding_report));
+
+    guac_display_encoding_report* report = &reports[display->encoding_report_count++];
+    report->layer = layer;
+    report->rect = *rect;
+    report->lossy = lossy;
+
+    guac_fifo_unlock(&display->ops);
+
+}
+
+void PFW_guac_display_apply_encoding_reports(guac_display* display) {
+
+    guac_fifo_lock(&display->ops);
+
+    /* Reports are applied in the order received, such that a refinement
+     * overrides the preview that preceded it */
+    guac_display_encoding_report* reports = display->encoding_reports.data;
+    for (size_t i = 0; i < display->encoding_report_count; i++) {
+
+        guac_display_encoding_report* report = &reports[i];
+
+        if (report->lossy)
+            PFW_guac_display_foreach_cell(report->layer, &report->rect,
+                    guac_display_cell_mark_lossy, NULL);
+        else
+            PFW_guac_display_foreach_cell(report->layer, &report->rect,
+                    guac_display_cell_clear_lossy, &report->rect);
+
+    }
+
+    display->encoding_report_count = 0;
+
+    guac_fifo_unlock(&display->ops);
+
+}
+
+void LFW_guac_display_forget_encoding_reports(guac_display* display,
+        guac_display_layer* layer) {
+
+    guac_fifo_lock(&display->ops);
+
+    size_t kept = 0;
+    guac_display_encoding_report* reports = display->encoding_reports.data;
+    for (size_t i = 0; i < display->encoding_report_count; i++) {
+        if (reports[i].layer != layer)
+            reports[kept++] = reports[i];
+    }
+
+    display->encoding_report_count = kept;
+
+    guac_fifo_unlock(&display->ops);
+
+}
+
+/**
+ * Returns the number of cells of all layers of the given display that were
+ * last sent using lossy compression. The write lock of the display's
+ * pending_frame.lock MUST be held.
+ *
+ * @param display
+ *     The guac_display whose lossy cells should be counted.
+ *
+ * @return
+ *     The number of cells that were last sent using lossy compression.
+ */
+static size_t PFW_guac_display_count_lossy_cells(guac_display* display) {
+
+    size_t count = 0;
+
+    guac_display_layer* current = display->pending_frame.layers;
+    while (current != NULL) {
+
+        /* Layers whose buffers have been replaced with NULL are never
+         * redrawn, and thus can never be refreshed */
+        if (current->pending_frame.buffer == NULL) {
+            current = current->pending_frame.next;
+            continue;
+        }
+
+        size_t cells = current->pending_frame_cells_width * current->pending_frame_cells_height;
+
+        guac_display_layer_cell* cell = current->pending_frame_cells;
+        for (size_t i = 0; i < cells; i++, cell++) {
+            if (cell->lossy)
+                count++;
+        }
+
+        current = current->pending_frame.next;
+
+    }
+
+    return count;
+
+}
+
+void PFW_LFR_guac_display_plan_track_lossy(guac_display_plan* plan) {
+
+    guac_display* display = plan->display;
+    char* op_lossy = guac_display_arena_reserve(&display->arena.op_lossy,
+            plan->length, sizeof(char));
+
+    /* Determine whether the source of each copy is lossy BEFORE updating any
+     * cells, as the client performs all copies relative to the contents of
+     * the previous frame */
+    guac_display_plan_operation* op = plan->ops;
+    for (size_t i = 0; i < plan->length; i++, op++) {
+
+        int lossy = 0;
+
+        if (op->type == GUAC_DISPLAY_PLAN_OPERATION_COPY) {
+
+            /* Copies from anything other than the last frame of a layer (the
+             * tile cache) are always of data that was sent losslessly */
+            guac_display_layer* source = PFW_guac_display_find_last_frame_buffer(
+                    display, op->src.layer_rect.layer);
+
+            if (source != NULL)
+                PFW_guac_display_foreach_cell(source, &op->src.layer_rect.rect,
+                        guac_display_cell_check_lossy, &lossy);
+
+        }
+
+        op_lossy[i] = lossy;
+
+    }
+
+    op = plan->ops;
+    for (size_t i = 0; i < plan->length; i++, op++) {
+
+        if (op->type != GUAC_DISPLAY_PLAN_OPERATION_COPY
+                && op->type != GUAC_DISPLAY_PLAN_OPERATION_RECT)
+            continue;
+
+        if (op_lossy[i])
+            PFW_guac_display_foreach_cell(op->layer, &op->dest,
+                    guac_display_cell_mark_lossy, NULL);
+        else
+            PFW_guac_display_foreach_cell(op->layer, &op->dest,
+                    guac_display_cell_clear_lossy, &op->dest);
+
+    }
+
+    size_t lossy_cells = PFW_guac_display_count_lossy_cells(display);
+
+    guac_fifo_lock(&display->ops);
+    display->lossy_cells = lossy_cells;
+    guac_fifo_unlock(&display->ops);
+
+}
+
+void guac_display_refresh_lossless(guac_display* display) {
+
+    guac_rwlock_acquire_write_lock(&display->pending_frame.lock);
+
+    /* Incorporate any outstanding encoding reports such that the refresh is
+     * skipped entirely if nothing remains lossy */
+    PFW_guac_display_apply_encoding_reports(display);
+    size_t lossy_cells = PFW_guac_display_count_lossy_cells(display);
+
+    guac_fifo_lock(&display->ops);
+
+    display->lossy_cells = lossy_cells;
+
+    /* A refresh is strictly lower priority than anything else the worker
+     * threads may be doing */
+    int busy = (display->ops.state.value & GUAC_FIFO_STATE_NONEMPTY)
+        || display->active_workers || display->frame_deferred;
+
+    guac_fifo_unlock(&display->ops);
+
+    /* Refresh only between frames, never while the pending frame is partially
+     * drawn (flushing such a frame would send a partial update) */
+    if (lossy_cells && !busy && !display->pending_frame_dirty_excluding_mouse) {
+        display->lossless_refresh = 1;
+        guac_display_end_multiple_frames(display, 0);
+        display->lossless_refresh = 0;
+    }
+
+    guac_rwlock_release_lock(&display->pending_frame.lock);
+
+}
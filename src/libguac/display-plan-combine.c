@@ -239,6 +239,8 @@ static int guac_display_plan_combine_if_improved(guac_display_plan_operation* op
         if (op_b->last_frame > op_a->last_frame)
             op_a->last_frame = op_b->last_frame;
 
+        op_a->lossless |= op_b->lossless;
+
         op_b->type = GUAC_DISPLAY_PLAN_OPERATION_NOP;
 
         return 1;
@@ -17,6 +17,7 @@
  * under the License.
  */
 
+#include "display-kernels.h"
 #include "display-plan.h"
 #include "display-priv.h"
 #include "guacamole/display.h"
@@ -48,9 +49,10 @@ static void guac_display_plan_store_indexed_op(guac_display_plan* plan, uint64_t
     size_t index = GUAC_DISPLAY_PLAN_OPERATION_HASH(hash);
     guac_display_plan_indexed_operation* entry = &(plan->ops_by_hash[index]);
 
-    if (entry->op == NULL) {
+    if (entry->op == NULL || entry->generation != plan->generation) {
         entry->hash = hash;
         entry->op = op;
+        entry->generation = plan->generation;
     }
 
 }
@@ -81,7 +83,7 @@ static guac_display_plan_operation* guac_display_plan_remove_indexed_op(guac_dis
      * between hash values at this second level of hashing. */
 
     guac_display_plan_operation* op = entry->op;
-    if (op != NULL && entry->hash == hash) {
+    if (op != NULL && entry->hash == hash && entry->generation == plan->generation) {
         entry->op = NULL;
         return op;
     }
@@ -165,33 +167,29 @@ static int guac_hash_foreach_image_rect(guac_display_plan* plan,
     int start_y = rect->top    - GUAC_DISPLAY_CELL_SIZE + 1;
     int end_y   = rect->bottom - GUAC_DISPLAY_CELL_SIZE + 1;
 
-    for (y = start_y; y < end_y; y++) {
+    /* Nothing to hash if the region is empty (constraining the region may
+     * have produced negative dimensions) */
+    if (end_x <= start_x)
+        return 0;
+
+    guac_display_kernel_hash_row* hash_row = plan->display->kernels->hash_row;
+    size_t length = end_x - start_x;
 
-        uint64_t* current_cell_hash = cell_hash;
+    for (y = start_y; y < end_y; y++) {
 
         /* Get current row */
-        uint32_t* row = (uint32_t*) data;
+        const uint32_t* row = (const uint32_t*) data;
         data += stride;
 
-        /* Calculate row segment hashes for entire row */
-        uint64_t row_hash = 0;
-        for (x = start_x; x < end_x; x++) {
-
-            /* Get current pixel */
-            uint32_t pixel = *(row++);
-
-            /* Update hash value for current row segment */
-            row_hash = ((row_hash * 31) << 1) + pixel;
-
-            /* Incorporate row hash value into overall cell hash */
-            uint64_t cell_hash = ((*current_cell_hash * 31) << 1) + row_hash;
-            *(current_cell_hash++) = cell_hash;
-
-            /* Invoke callback for every hash generated, breaking out early if
-             * requested */
-            if (y >= rect->top && x >= rect->left)
-                callback(plan, x, y, cell_hash, closure);
+        /* Calculate row segment hashes for entire row, incorporating each row
+         * hash value into the corresponding overall cell hash */
+        hash_row(row, cell_hash, length);
 
+        /* Invoke callback for every hash generated once a full 64x64
+         * rectangle has been evaluated */
+        if (y >= rect->top) {
+            for (x = rect->left; x < end_x; x++)
+                callback(plan, x, y, cell_hash[x - start_x], closure);
         }
 
     } /* end for each row */
@@ -220,45 +218,108 @@ static void guac_display_cell_init_rect(guac_rect* rect, int x, int y) {
 }
 
 /**
- * Callback for guac_hash_foreach_image_rect() which stores the given operation
- * in the ops_by_hash table of the given display plan.
+ * Callback for guac_hash_foreach_image_rect() which stores the hash of the
+ * 64x64 rectangle at the given coordinates within a uint64_t.
  *
  * @param plan
- *     The display plan to store the given operation in.
+ *     The display plan related to the call to guac_hash_foreach_image_rect().
  *
  * @param x
- *     The X coordinate of the upper-left corner of the 64x64 rectangle
- *     modified by the given operation.
+ *     The X coordinate of the upper-left corner of the 64x64 rectangle.
  *
  * @param y
- *     The Y coordinate of the upper-left corner of the 64x64 rectangle
- *     modified by the given operation.
+ *     The Y coordinate of the upper-left corner of the 64x64 rectangle.
  *
  * @param hash
  *     The hash value that applies to the 64x64 rectangle at the given
  *     coordinates.
  *
  * @param closure
- *     A pointer to the guac_display_plan_operation that should be stored
- *     within the ops_by_hash table of the given display plan.
+ *     A pointer to the uint64_t that should receive the hash value.
  */
-static void guac_display_plan_index_op_for_cell(guac_display_plan* plan, int x, int y, uint64_t hash, void* closure) {
-    guac_display_plan_store_indexed_op(plan, hash, (guac_display_plan_operation*) closure);
+static void guac_display_plan_store_cell_hash(guac_display_plan* plan, int x, int y, uint64_t hash, void* closure) {
+    *((uint64_t*) closure) = hash;
 }
 
-void PFR_guac_display_plan_index_dirty_cells(guac_display_plan* plan) {
+/**
+ * The state of a single parallel pass that hashes the contents of each draw
+ * operation within a guac_display_plan, with each band of that pass covering a
+ * contiguous range of operations.
+ */
+typedef struct guac_display_plan_index_pass {
 
-    memset(plan->ops_by_hash, 0, sizeof(plan->ops_by_hash));
+    /**
+     * The plan being indexed.
+     */
+    guac_display_plan* plan;
 
-    guac_display_plan_operation* op = plan->ops;
-    for (int i = 0; i < plan->length; i++) {
+    /**
+     * The total number of bands that the pass has been divided into.
+     */
+    int bands;
+
+    /**
+     * Array containing one element for each operation in the plan. Each
+     * element is set to non-zero if the corresponding operation should be
+     * indexed, or zero if the operation cannot be indexed.
+     */
+    char* indexable;
 
-        if (op->type == GUAC_DISPLAY_PLAN_OPERATION_IMG) {
+    /**
+     * Array containing one element for each operation in the plan, receiving
+     * the hash of each operation that should be indexed.
+     */
+    uint64_t* hashes;
+
+} guac_display_plan_index_pass;
+
+/**
+ * Calculates the hashes of each draw operation within the given band of the
+ * operations of a guac_display_plan. Each band covers a contiguous range of
+ * operations within the plan. This function is a guac_display_band_callback,
+ * and the data provided must be a guac_display_plan_index_pass. As a band
+ * callback running on behalf of the thread planning the frame, the
+ * pending_frame.lock of the display is already held by that thread.
+ *
+ * @param display
+ *     The guac_display that the frame is being planned for.
+ *
+ * @param band
+ *     The index of the band of operations to hash.
+ *
+ * @param data
+ *     The guac_display_plan_index_pass describing the overall pass.
+ */
+static void PFR_guac_display_plan_hash_band(guac_display* display,
+        int band, void* data) {
+
+    guac_display_plan_index_pass* pass = (guac_display_plan_index_pass*) data;
+    guac_display_plan* plan = pass->plan;
+
+    int start = (int) ((size_t) band * plan->length / pass->bands);
+    int end = (int) ((size_t) (band + 1) * plan->length / pass->bands);
+
+    guac_display_plan_operation* op = plan->ops + start;
+    for (int i = start; i < end; i++) {
+
+        pass->indexable[i] = 0;
+
+        /* Updates that must be sent losslessly cannot be replaced with copies
+         * of data that may have been sent lossily */
+        if (op->type == GUAC_DISPLAY_PLAN_OPERATION_IMG && !op->lossless) {
 
             guac_display_layer* layer = op->layer;
 
-            guac_rect layer_bounds;
-            guac_display_layer_get_bounds(layer, &layer_bounds);
+            /* NOTE: The bounds of the layer are read directly rather than
+             * through guac_display_layer_get_bounds(), as this band may be
+             * running within a worker thread that does not itself hold the
+             * pending_frame.lock (it is held by the planning thread) */
+            guac_rect layer_bounds = {
+                .left   = 0,
+                .top    = 0,
+                .right  = layer->pending_frame.width,
+                .bottom = layer->pending_frame.height
+            };
 
             guac_rect cell;
             guac_display_cell_init_rect(&cell, op->dest.left, op->dest.top);
@@ -267,7 +328,8 @@ void PFR_guac_display_plan_index_dirty_cells(guac_display_plan* plan) {
             if (guac_rect_width(&cell) == GUAC_DISPLAY_CELL_SIZE
                     && guac_rect_height(&cell) == GUAC_DISPLAY_CELL_SIZE) {
                 guac_hash_foreach_image_rect(plan, &layer->pending_frame,
-                        &cell, guac_display_plan_index_op_for_cell, op);
+                        &cell, guac_display_plan_store_cell_hash, &pass->hashes[i]);
+                pass->indexable[i] = 1;
             }
 
         }
@@ -278,6 +340,47 @@ void PFR_guac_display_plan_index_dirty_cells(guac_display_plan* plan) {
 
 }
 
+void PFR_guac_display_plan_index_dirty_cells(guac_display_plan* plan) {
+
+    guac_display* display = plan->display;
+
+    /* Implicitly clear all entries stored for previous frames by advancing
+     * to the next generation, clearing the index explicitly only if the
+     * generation counter has wrapped around */
+    if (++plan->generation == 0) {
+        memset(plan->ops_by_hash, 0, sizeof(plan->ops_by_hash));
+        plan->generation = 1;
+    }
+
+    /* Hash the contents of all operations in parallel ... */
+    guac_display_arena* arena = &display->arena;
+    guac_display_plan_index_pass pass = {
+        .plan = plan,
+        .bands = guac_display_band_count(display,
+                (size_t) plan->length * GUAC_DISPLAY_CELL_SIZE * GUAC_DISPLAY_CELL_SIZE,
+                plan->length),
+        .indexable = guac_display_arena_reserve(&arena->op_indexable, plan->length, sizeof(char)),
+        .hashes = guac_display_arena_reserve(&arena->op_hashes, plan->length, sizeof(uint64_t))
+    };
+
+    guac_display_foreach_band(display, pass.bands,
+            PFR_guac_display_plan_hash_band, &pass);
+
+    /* ... then store those hashes in order, such that the first operation
+     * having any particular hash is the operation indexed regardless of how
+     * many bands were used */
+    guac_display_plan_operation* op = plan->ops;
+    for (int i = 0; i < plan->length; i++) {
+
+        if (pass.indexable[i])
+            guac_display_plan_store_indexed_op(plan, pass.hashes[i], op);
+
+        op++;
+
+    }
+
+}
+
 /**
  * Compares two rectangular regions of two arbitrary buffers, returning whether
  * those regions contain identical data.
@@ -406,6 +509,183 @@ static void PFR_LFR_guac_display_plan_find_copies(guac_display_plan* plan,
 
 }
 
+/**
+ * A location within the last frame of a layer whose hash matches the hash of
+ * an operation that was stored within the ops_by_hash table of a
+ * guac_display_plan at the time the location was found.
+ */
+typedef struct guac_display_plan_search_hit {
+
+    /**
+     * The X coordinate of the upper-left corner of the matching 64x64 region.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the matching 64x64 region.
+     */
+    int y;
+
+    /**
+     * The hash of the matching 64x64 region.
+     */
+    uint64_t hash;
+
+} guac_display_plan_search_hit;
+
+/**
+ * The results of searching a single band of a layer for possible copies.
+ */
+typedef struct guac_display_plan_search_band {
+
+    /**
+     * The frame arena buffer providing storage for the hits array. This
+     * buffer is reused by the corresponding band of each frame.
+     */
+    guac_display_arena_buffer* storage;
+
+    /**
+     * All locations found by the band whose hashes match an indexed
+     * operation, in the order they were found.
+     */
+    guac_display_plan_search_hit* hits;
+
+    /**
+     * The number of hits stored within the hits array.
+     */
+    size_t length;
+
+} guac_display_plan_search_band;
+
+/**
+ * The state of a single parallel search of a layer for possible copies, with
+ * each band of that search covering a contiguous range of rows of the search
+ * region.
+ */
+typedef struct guac_display_plan_search {
+
+    /**
+     * The plan whose operations are being searched for.
+     */
+    guac_display_plan* plan;
+
+    /**
+     * The layer being searched.
+     */
+    guac_display_layer* layer;
+
+    /**
+     * The region of the last frame of the layer being searched.
+     */
+    guac_rect region;
+
+    /**
+     * The total number of rows of 64x64 rectangles within the search region,
+     * where each row is identified by the Y coordinate of the upper-left
+     * corner of its rectangles.
+     */
+    int rows;
+
+    /**
+     * The total number of bands that the search has been divided into.
+     */
+    int bands;
+
+    /**
+     * The results of each band.
+     */
+    guac_display_plan_search_band results[GUAC_DISPLAY_MAX_BANDS];
+
+} guac_display_plan_search;
+
+/**
+ * Callback for guac_hash_foreach_image_rect() which records the given location
+ * as a possible copy if the given hash matches an operation currently stored
+ * in the ops_by_hash table of the given display plan. The ops_by_hash table is
+ * not modified.
+ *
+ * @param plan
+ *     The display plan being searched.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the 64x64 region currently
+ *     being checked.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the 64x64 region currently
+ *     being checked.
+ *
+ * @param hash
+ *     The hash value that applies to the 64x64 rectangle at the given
+ *     coordinates.
+ *
+ * @param closure
+ *     A pointer to the guac_display_plan_search_band that should receive any
+ *     hit.
+ */
+static void guac_display_plan_record_hit(guac_display_plan* plan,
+        int x, int y, uint64_t hash, void* closure) {
+
+    guac_display_plan_search_band* results = (guac_display_plan_search_band*) closure;
+
+    size_t index = GUAC_DISPLAY_PLAN_OPERATION_HASH(hash);
+    guac_display_plan_indexed_operation* entry = &(plan->ops_by_hash[index]);
+    if (entry->op == NULL || entry->hash != hash || entry->generation != plan->generation)
+        return;
+
+    /* Grow storage for hits as necessary */
+    results->hits = guac_display_arena_reserve(results->storage,
+            results->length + 1, sizeof(guac_display_plan_search_hit));
+
+    results->hits[results->length++] = (guac_display_plan_search_hit) {
+        .x = x,
+        .y = y,
+        .hash = hash
+    };
+
+}
+
+/**
+ * Searches the given band of the last frame of a layer for any 64x64 regions
+ * whose hashes match operations stored within the ops_by_hash table of the
+ * plan, recording those regions for later verification. This function is a
+ * guac_display_band_callback, and the data provided must be a
+ * guac_display_plan_search. As a band callback running on behalf of the thread
+ * planning the frame, the pending_frame.lock and last_frame.lock of the
+ * display are already held by that thread.
+ *
+ * @param display
+ *     The guac_display that the frame is being planned for.
+ *
+ * @param band
+ *     The index of the band of rows to search.
+ *
+ * @param data
+ *     The guac_display_plan_search describing the overall search.
+ */
+static void PFR_LFR_guac_display_plan_search_band(guac_display* display,
+        int band, void* data) {
+
+    guac_display_plan_search* search = (guac_display_plan_search*) data;
+
+    /* Each band is responsible for the 64x64 rectangles whose upper-left
+     * corners lie within its range of rows, and must therefore hash the
+     * following 63 rows of image data, as well */
+    guac_rect region = search->region;
+    region.top = search->region.top + band * search->rows / search->bands;
+    region.bottom = search->region.top + (band + 1) * search->rows / search->bands
+        + GUAC_DISPLAY_CELL_SIZE - 1;
+
+    guac_display_plan_search_band* results = &search->results[band];
+    *results = (guac_display_plan_search_band) {
+        .storage = &display->arena.search_hits[band]
+    };
+
+    guac_hash_foreach_image_rect(search->plan, &search->layer->last_frame,
+            &region, guac_display_plan_record_hit, results);
+
+}
+
 void PFR_LFR_guac_display_plan_rewrite_as_copies(guac_display_plan* plan) {
 
     guac_display* display = plan->display;
@@ -425,8 +705,41 @@ void PFR_LFR_guac_display_plan_rewrite_as_copies(guac_display_plan* plan) {
              * modified) */
             guac_rect_constrain(&search_region, &current->pending_frame.dirty);
 
-            guac_hash_foreach_image_rect(plan, &current->last_frame, &search_region,
-                    PFR_LFR_guac_display_plan_find_copies, current);
+            int width = guac_rect_width(&search_region);
+            int rows = guac_rect_height(&search_region) - GUAC_DISPLAY_CELL_SIZE + 1;
+
+            /* Hash the search region in parallel, with each band covering
+             * a contiguous range of rows ... */
+            if (width >= GUAC_DISPLAY_CELL_SIZE && rows > 0) {
+
+                guac_display_plan_search search = {
+                    .plan = plan,
+                    .layer = current,
+                    .region = search_region,
+                    .rows = rows,
+                    .bands = guac_display_band_count(display,
+                            (size_t) width * rows, rows)
+                };
+
+                guac_display_foreach_band(display, search.bands,
+                        PFR_LFR_guac_display_plan_search_band, &search);
+
+                /* ... then verify and apply any possible copies found in the
+                 * same order that they would have been found by a serial
+                 * search, such that the resulting plan is identical
+                 * regardless of how many bands were used */
+                for (int band = 0; band < search.bands; band++) {
+
+                    guac_display_plan_search_band* results = &search.results[band];
+                    for (size_t i = 0; i < results->length; i++) {
+                        guac_display_plan_search_hit* hit = &results->hits[i];
+                        PFR_LFR_guac_display_plan_find_copies(plan, hit->x, hit->y, hit->hash, current);
+                    }
+
+                }
+
+            }
+
         }
 
         current = current->last_frame.next;
@@ -17,6 +17,7 @@
  * under the License.
  */
 
+#include "display-kernels.h"
 #include "display-plan.h"
 #include "display-priv.h"
 #include "guacamole/assert.h"
@@ -76,67 +77,292 @@ static void guac_display_plan_mark_dirty(guac_display_layer* layer,
 }
 
 /**
- * Variant of memcmp() which specifically compares series of 32-bit quantities
- * and determines the overall location and length of the differences in the two
- * provided buffers. The length and location determined are the length and
- * location of the smallest contiguous series of 32-bit quantities that differ
- * between the buffers.
+ * Marks the entirety of the given region of the given layer as dirty,
+ * regardless of whether that region has actually changed since the last
+ * frame. The given region must already be within the bounds of the pending
+ * frame of the layer.
  *
- * @param buffer_a
- *     The first buffer to compare.
+ * @param layer
+ *     The layer to mark as dirty.
  *
- * @param buffer_b
- *     The buffer to compare with buffer_a.
+ * @param rect
+ *     The region of the layer that should be marked as dirty.
  *
- * @param count
- *     The number of 32-bit quantities in each buffer.
+ * @return
+ *     The number of cells that were not previously marked as dirty but now
+ *     are.
+ */
+static size_t guac_display_plan_mark_rect_dirty(guac_display_layer* layer,
+        const guac_rect* rect) {
+
+    size_t count = 0;
+
+    for (int y = rect->top; y < rect->bottom; y++) {
+
+        guac_display_layer_cell* cell = layer->pending_frame_cells
+            + guac_mem_ckd_mul_or_die(y / GUAC_DISPLAY_CELL_SIZE, layer->pending_frame_cells_width)
+            + rect->left / GUAC_DISPLAY_CELL_SIZE;
+
+        for (int x = rect->left; x < rect->right; cell++) {
+
+            /* Mark only the portion of the current row within this cell */
+            int width = GUAC_DISPLAY_CELL_SIZE - (x % GUAC_DISPLAY_CELL_SIZE);
+            if (x + width > rect->right)
+                width = rect->right - x;
+
+            guac_display_plan_mark_dirty(layer, cell, &count, x, y, width);
+            x += width;
+
+        }
+
+    }
+
+    return count;
+
+}
+
+/**
+ * Marks as dirty each cell of the given layer that was last sent using lossy
+ * compression and has remained unchanged for at least
+ * GUAC_DISPLAY_LOSSLESS_REFRESH_DELAY milliseconds, such that those cells are
+ * re-sent losslessly. No more cells are marked than the given budget allows.
+ *
+ * @param layer
+ *     The layer whose lossy cells should be marked as dirty.
  *
- * @param pos
- *     A pointer to a size_t that should receive the offset of the difference,
- *     if the two buffers turn out to contain different data. The value of the
- *     size_t will only be modified if at least one difference is found.
+ * @param frame_end
+ *     The time that the frame being planned ended.
+ *
+ * @param budget
+ *     A pointer to the number of cells that may still be marked as dirty as
+ *     part of the current lossless refresh. This value is decremented for
+ *     each cell marked.
+ *
+ * @param refreshed
+ *     The rect to extend to cover each cell marked as dirty.
  *
  * @return
- *     The number of 32-bit quantities after and including the offset returned
- *     via pos that are different between buffer_a and buffer_b, or zero if
- *     there are no such differences.
+ *     The number of cells that were not previously marked as dirty but now
+ *     are.
  */
-static size_t guac_display_memcmp(const uint32_t* restrict buffer_a,
-        const uint32_t* restrict buffer_b, size_t count, size_t* pos) {
+static size_t guac_display_plan_mark_lossy_dirty(guac_display_layer* layer,
+        guac_timestamp frame_end, size_t* budget, guac_rect* refreshed) {
+
+    size_t count = 0;
 
-    /* Locate first difference between the buffers, if any */
-    size_t first = 0;
-    while (first < count) {
+    guac_rect pending_frame_bounds = {
+        .left = 0,
+        .top = 0,
+        .right = layer->pending_frame.width,
+        .bottom = layer->pending_frame.height
+    };
 
-        if (*(buffer_a++) != *(buffer_b++))
-            break;
+    guac_display_layer_cell* cell = layer->pending_frame_cells;
+    for (int y = 0; y < layer->pending_frame_cells_height; y++) {
+        for (int x = 0; x < layer->pending_frame_cells_width; x++, cell++) {
 
-        first++;
+            if (*budget == 0)
+                return count;
 
+            if (!cell->lossy || frame_end - cell->last_frame < GUAC_DISPLAY_LOSSLESS_REFRESH_DELAY)
+                continue;
+
+            guac_rect cell_rect;
+            guac_rect_init(&cell_rect, x * GUAC_DISPLAY_CELL_SIZE, y * GUAC_DISPLAY_CELL_SIZE,
+                    GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_CELL_SIZE);
+
+            guac_rect_constrain(&cell_rect, &pending_frame_bounds);
+            if (guac_rect_is_empty(&cell_rect))
+                continue;
+
+            count += guac_display_plan_mark_rect_dirty(layer, &cell_rect);
+            guac_rect_extend(refreshed, &cell_rect);
+            (*budget)--;
+
+        }
     }
 
-    /* If we reached the end without finding any differences, no need to search
-     * further - the buffers are identical */
-    if (first >= count)
-        return 0;
+    return count;
+
+}
+
+/**
+ * The state of a single parallel search of a layer for modified regions, with
+ * each band of that search covering a contiguous range of rows of cells.
+ */
+typedef struct guac_display_plan_diff {
+
+    /**
+     * The layer being searched.
+     */
+    guac_display_layer* layer;
+
+    /**
+     * The cell-aligned region of the layer being searched.
+     */
+    guac_rect dirty;
 
-    /* Search through all remaining values in the buffers for the last
-     * difference (which may be identical to the first) */
-    size_t last = first;
-    size_t offset = first + 1;
-    while (offset < count) {
+    /**
+     * The total number of rows of cells within the region being searched.
+     */
+    int cell_rows;
 
-        if (*(buffer_a++) != *(buffer_b++))
-            last = offset;
+    /**
+     * The total number of bands that the search has been divided into.
+     */
+    int bands;
 
-        offset++;
+    /**
+     * The number of cells found to be modified by each band.
+     */
+    size_t op_count[GUAC_DISPLAY_MAX_BANDS];
+
+    /**
+     * The refined region found to be modified by each band. This region is
+     * empty if the band found no changes.
+     */
+    guac_rect modified[GUAC_DISPLAY_MAX_BANDS];
+
+} guac_display_plan_diff;
+
+/**
+ * Compares the pending and last frames of a single layer within the rows of
+ * cells covered by the given band, refining the dirty rect of each cell to
+ * more accurately contain only what has actually changed since the last frame.
+ * This function is a guac_display_band_callback, and the data provided must be
+ * a guac_display_plan_diff. As a band callback running on behalf of the thread
+ * planning the frame, the pending_frame.lock and last_frame.lock of the
+ * display are already held by that thread for writing.
+ *
+ * @param display
+ *     The guac_display that the frame is being planned for.
+ *
+ * @param band
+ *     The index of the band of cell rows to compare.
+ *
+ * @param data
+ *     The guac_display_plan_diff describing the overall comparison.
+ */
+static void PFW_LFR_guac_display_plan_diff_band(guac_display* display,
+        int band, void* data) {
+
+    guac_display_plan_diff* diff = (guac_display_plan_diff*) data;
+    guac_display_layer* current = diff->layer;
+    guac_display_kernel_memcmp* memcmp_kernel = display->kernels->memcmp;
+
+    size_t op_count = 0;
+    guac_rect modified = { 0 };
+
+    /* Determine the subset of the dirty rect covered by this band */
+    guac_rect dirty = diff->dirty;
+    dirty.top = diff->dirty.top + GUAC_DISPLAY_CELL_SIZE * (band * diff->cell_rows / diff->bands);
+    dirty.bottom = diff->dirty.top + GUAC_DISPLAY_CELL_SIZE * ((band + 1) * diff->cell_rows / diff->bands);
+    if (dirty.bottom > diff->dirty.bottom)
+        dirty.bottom = diff->dirty.bottom;
+
+    const unsigned char* flushed_row = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(current->last_frame, dirty);
+    unsigned char* buffer_row = GUAC_DISPLAY_LAYER_STATE_MUTABLE_BUFFER(current->pending_frame, dirty);
+
+    guac_display_layer_cell* cell_row = current->pending_frame_cells
+        + guac_mem_ckd_mul_or_die(dirty.top / GUAC_DISPLAY_CELL_SIZE, current->pending_frame_cells_width)
+        + dirty.left / GUAC_DISPLAY_CELL_SIZE;
+
+    /* Loop through the rough modified region, refining the dirty rects of
+     * each cell to more accurately contain only what has actually changed
+     * since last frame */ 
+    for (int corner_y = dirty.top; corner_y < dirty.bottom; corner_y += GUAC_DISPLAY_CELL_SIZE) {
+
+        int height = GUAC_DISPLAY_CELL_SIZE;
+        if (corner_y + height > dirty.bottom)
+            height = dirty.bottom - corner_y;
+
+        /* Iteration through the pending_frame_cells array and the image
+         * buffer is a bit complex here, as the pending_frame_cells array
+         * contains cells that represent 64x64 regions, while the image
+         * buffers contain absolutely all pixels. The outer loop goes
+         * through just the pending cells, while the following loop goes
+         * through the Y coordinates that make up that cell. */
+
+        for (int y_off = 0; y_off < height; y_off++) {
+
+            /* At this point, we need to loop through the horizontal
+             * dimension, comparing the 64-pixel rows of image data in the
+             * current line (corner_y + y_off) that are in each applicable
+             * cell. We jump forward by one cell for each comparison. */
+
+            int y = corner_y + y_off;
+
+            guac_display_layer_cell* current_cell = cell_row;
+            uint32_t* current_flushed = (uint32_t*) flushed_row;
+            uint32_t* current_buffer = (uint32_t*) buffer_row;
+            for (int corner_x = dirty.left; corner_x < dirty.right; corner_x += GUAC_DISPLAY_CELL_SIZE) {
+
+                int width = GUAC_DISPLAY_CELL_SIZE;
+                if (corner_x + width > dirty.right)
+                    width = dirty.right - corner_x;
+
+                /* This SHOULD be impossible, as corner_x would need to
+                 * somehow be outside the bounds of the dirty rect, which
+                 * would have failed the loop condition earlier) */
+                GUAC_ASSERT(width >= 0);
+
+                /* Any line that is completely outside the bounds of the
+                 * previous frame is dirty (nothing to compare against) */
+                if (y >= current->last_frame.height || corner_x >= current->last_frame.width) {
+                    guac_display_plan_mark_dirty(current, current_cell, &op_count, corner_x, y, width);
+                    guac_rect_extend(&modified, &current_cell->dirty);
+                }
+
+                /* All other regions must be processed further to determine
+                 * what portion is dirty */
+                else {
+
+                    /* Only the pixels that are within the bounds of BOTH
+                     * the last_frame and pending_frame are directly
+                     * comparable. Others are inherently dirty by virtue of
+                     * being outside the bounds of last_frame */
+                    int comparable_width = width;
+                    if (corner_x + comparable_width > current->last_frame.width)
+                        comparable_width = current->last_frame.width - corner_x;
+
+                    /* It is impossible for this value to be negative
+                     * because of the last_frame bounds checks that occur
+                     * in the if block prior to this else block */
+                    GUAC_ASSERT(comparable_width >= 0);
+
+                    /* Any region outside the right edge of the previous frame is dirty */
+                    if (width > comparable_width) {
+                        guac_display_plan_mark_dirty(current, current_cell, &op_count, corner_x + comparable_width, y, width - comparable_width);
+                        guac_rect_extend(&modified, &current_cell->dirty);
+                    }
+
+                    /* Mark the relevant region of the cell as dirty if the
+                     * current 64-pixel line has changed in any way */
+                    size_t length, pos;
+                    if ((length = memcmp_kernel(current_buffer, current_flushed, comparable_width, &pos)) != 0) {
+                        guac_display_plan_mark_dirty(current, current_cell, &op_count, corner_x + pos, y, length);
+                        guac_rect_extend(&modified, &current_cell->dirty);
+                    }
+
+                }
+
+                current_flushed += GUAC_DISPLAY_CELL_SIZE;
+                current_buffer += GUAC_DISPLAY_CELL_SIZE;
+                current_cell++;
+
+            }
+
+            flushed_row += current->last_frame.buffer_stride;
+            buffer_row += current->pending_frame.buffer_stride;
+
+        }
+
+        cell_row += current->pending_frame_cells_width;
 
     }
 
-    /* Final difference found - provide caller with the starting offset and
-     * length (in 32-bit quantities) of differences */
-    *pos = first;
-    return last - first + 1;
+    diff->op_count[band] = op_count;
+    diff->modified[band] = modified;
 
 }
 
@@ -145,6 +371,11 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
     guac_display_layer* current;
     guac_timestamp frame_end = guac_timestamp_current();
     size_t op_count = 0;
+    size_t refresh_budget = GUAC_DISPLAY_LOSSLESS_REFRESH_MAX_CELLS;
+
+    /* Note which cells were last sent using lossy compression, now that the
+     * worker threads have finished sending the previous frame */
+    PFW_guac_display_apply_encoding_reports(display);
 
     /* Loop through each layer, searching for modified regions */
     current = display->pending_frame.layers;
@@ -159,6 +390,27 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
             continue;
         }
 
+        /* Regions previously sent only as low-quality previews that were
+         * never refined must be redrawn, even if unchanged */
+        guac_fifo_lock(&display->ops);
+        guac_rect unrefined = current->unrefined;
+        current->unrefined = (guac_rect) { 0 };
+        guac_fifo_unlock(&display->ops);
+
+        if (!guac_rect_is_empty(&unrefined))
+            guac_rect_extend(&current->pending_frame.dirty, &unrefined);
+
+        /* Re-send losslessly any cells that were last sent using lossy
+         * compression and have since stopped changing, if this frame is a
+         * lossless refresh */
+        guac_rect refreshed = { 0 };
+        if (display->lossless_refresh) {
+            op_count += guac_display_plan_mark_lossy_dirty(current, frame_end,
+                    &refresh_budget, &refreshed);
+            if (!guac_rect_is_empty(&refreshed))
+                guac_rect_extend(&current->pending_frame.dirty, &refreshed);
+        }
+
         /* Check only within layer dirty region, skipping the layer if
          * unmodified. This pass should reset and refine that region, but
          * otherwise rely on proper reporting of modified regions by callers of
@@ -192,108 +444,46 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
          * frame is considered dirty) */
         guac_rect_constrain(&dirty, &pending_frame_bounds);
 
-        const unsigned char* flushed_row = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(current->last_frame, dirty);
-        unsigned char* buffer_row = GUAC_DISPLAY_LAYER_STATE_MUTABLE_BUFFER(current->pending_frame, dirty);
-
-        guac_display_layer_cell* cell_row = current->pending_frame_cells
-            + guac_mem_ckd_mul_or_die(dirty.top / GUAC_DISPLAY_CELL_SIZE, current->pending_frame_cells_width)
-            + dirty.left / GUAC_DISPLAY_CELL_SIZE;
-
-        /* Loop through the rough modified region, refining the dirty rects of
-         * each cell to more accurately contain only what has actually changed
-         * since last frame */ 
         current->pending_frame.dirty = (guac_rect) { 0 };
-        for (int corner_y = dirty.top; corner_y < dirty.bottom; corner_y += GUAC_DISPLAY_CELL_SIZE) {
-
-            int height = GUAC_DISPLAY_CELL_SIZE;
-            if (corner_y + height > dirty.bottom)
-                height = dirty.bottom - corner_y;
-
-            /* Iteration through the pending_frame_cells array and the image
-             * buffer is a bit complex here, as the pending_frame_cells array
-             * contains cells that represent 64x64 regions, while the image
-             * buffers contain absolutely all pixels. The outer loop goes
-             * through just the pending cells, while the following loop goes
-             * through the Y coordinates that make up that cell. */
-
-            for (int y_off = 0; y_off < height; y_off++) {
-
-                /* At this point, we need to loop through the horizontal
-                 * dimension, comparing the 64-pixel rows of image data in the
-                 * current line (corner_y + y_off) that are in each applicable
-                 * cell. We jump forward by one cell for each comparison. */
-
-                int y = corner_y + y_off;
-
-                guac_display_layer_cell* current_cell = cell_row;
-                uint32_t* current_flushed = (uint32_t*) flushed_row;
-                uint32_t* current_buffer = (uint32_t*) buffer_row;
-                for (int corner_x = dirty.left; corner_x < dirty.right; corner_x += GUAC_DISPLAY_CELL_SIZE) {
-
-                    int width = GUAC_DISPLAY_CELL_SIZE;
-                    if (corner_x + width > dirty.right)
-                        width = dirty.right - corner_x;
-
-                    /* This SHOULD be impossible, as corner_x would need to
-                     * somehow be outside the bounds of the dirty rect, which
-                     * would have failed the loop condition earlier) */
-                    GUAC_ASSERT(width >= 0);
-
-                    /* Any line that is completely outside the bounds of the
-                     * previous frame is dirty (nothing to compare against) */
-                    if (y >= current->last_frame.height || corner_x >= current->last_frame.width) {
-                        guac_display_plan_mark_dirty(current, current_cell, &op_count, corner_x, y, width);
-                        guac_rect_extend(&current->pending_frame.dirty, &current_cell->dirty);
-                    }
-
-                    /* All other regions must be processed further to determine
-                     * what portion is dirty */
-                    else {
-
-                        /* Only the pixels that are within the bounds of BOTH
-                         * the last_frame and pending_frame are directly
-                         * comparable. Others are inherently dirty by virtue of
-                         * being outside the bounds of last_frame */
-                        int comparable_width = width;
-                        if (corner_x + comparable_width > current->last_frame.width)
-                            comparable_width = current->last_frame.width - corner_x;
-
-                        /* It is impossible for this value to be negative
-                         * because of the last_frame bounds checks that occur
-                         * in the if block prior to this else block */
-                        GUAC_ASSERT(comparable_width >= 0);
-
-                        /* Any region outside the right edge of the previous frame is dirty */
-                        if (width > comparable_width) {
-                            guac_display_plan_mark_dirty(current, current_cell, &op_count, corner_x + comparable_width, y, width - comparable_width);
-                            guac_rect_extend(&current->pending_frame.dirty, &current_cell->dirty);
-                        }
-
-                        /* Mark the relevant region of the cell as dirty if the
-                         * current 64-pixel line has changed in any way */
-                        size_t length, pos;
-                        if ((length = guac_display_memcmp(current_buffer, current_flushed, comparable_width, &pos)) != 0) {
-                            guac_display_plan_mark_dirty(current, current_cell, &op_count, corner_x + pos, y, length);
-                            guac_rect_extend(&current->pending_frame.dirty, &current_cell->dirty);
-                        }
-
-                    }
-
-                    current_flushed += GUAC_DISPLAY_CELL_SIZE;
-                    current_buffer += GUAC_DISPLAY_CELL_SIZE;
-                    current_cell++;
+        if (guac_rect_is_empty(&dirty)) {
+            current = current->pending_frame.next;
+            continue;
+        }
 
-                }
+        /* Compare the pending and last frames in parallel, with each band
+         * covering a contiguous range of rows of cells */
+        guac_display_plan_diff diff = {
+            .layer = current,
+            .dirty = dirty,
+            .cell_rows = GUAC_DISPLAY_CELL_DIMENSION(guac_rect_height(&dirty))
+        };
 
-                flushed_row += current->last_frame.buffer_stride;
-                buffer_row += current->pending_frame.buffer_stride;
+        diff.bands = guac_display_band_count(display,
+                (size_t) guac_rect_width(&dirty) * guac_rect_height(&dirty),
+                diff.cell_rows);
 
-            }
+        guac_display_foreach_band(display, diff.bands,
+                PFW_LFR_guac_display_plan_diff_band, &diff);
 
-            cell_row += current->pending_frame_cells_width;
+        /* Merge the results of each band in order, such that the result is
+         * identical regardless of how many bands were used */
+        for (int band = 0; band < diff.bands; band++) {
+            op_count += diff.op_count[band];
+            if (!guac_rect_is_empty(&diff.modified[band]))
+                guac_rect_extend(&current->pending_frame.dirty, &diff.modified[band]);
+        }
 
+        /* Force redraw of any unrefined region within the bounds of the
+         * pending frame */
+        guac_rect_constrain(&unrefined, &dirty);
+        if (!guac_rect_is_empty(&unrefined)) {
+            op_count += guac_display_plan_mark_rect_dirty(current, &unrefined);
+            guac_rect_extend(&current->pending_frame.dirty, &unrefined);
         }
 
+        if (!guac_rect_is_empty(&refreshed))
+            guac_rect_extend(&current->pending_frame.dirty, &refreshed);
+
         current = current->pending_frame.next;
 
     }
@@ -302,11 +492,14 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
     if (!op_count)
         return NULL;
 
-    guac_display_plan* plan = guac_mem_alloc(sizeof(guac_display_plan));
+    /* Reuse the plan and operations of the previous frame, allocating only
+     * if the previous storage is insufficient */
+    guac_display_arena* arena = &display->arena;
+    guac_display_plan* plan = guac_display_arena_reserve(&arena->plan, 1, sizeof(guac_display_plan));
     plan->display = display;
     plan->frame_end = frame_end;
     plan->length = op_count;
-    plan->ops = guac_mem_alloc(plan->length, sizeof(guac_display_plan_operation));
+    plan->ops = guac_display_arena_reserve(&arena->ops, plan->length, sizeof(guac_display_plan_operation));
 
     /* Convert the dirty rectangles stored in each layer's cells to individual
      * image operations for later optimization */
@@ -315,6 +508,13 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
     current = display->pending_frame.layers;
     while (current != NULL) {
 
+        guac_rect pending_frame_bounds = {
+            .left = 0,
+            .top = 0,
+            .right = current->pending_frame.width,
+            .bottom = current->pending_frame.height
+        };
+
         guac_display_layer_cell* cell = current->pending_frame_cells;
         for (int y = 0; y < current->pending_frame_cells_height; y++) {
             for (int x = 0; x < current->pending_frame_cells_width; x++) {
@@ -334,6 +534,20 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
                     current_op->dirty_size = cell->dirty_size;
                     current_op->last_frame = cell->last_frame;
                     current_op->current_frame = frame_end;
+                    current_op->lossless = 0;
+
+                    /* Cells last sent using lossy compression are redrawn in
+                     * their entirety, such that no lossy remnants remain
+                     * around the modified region. If this frame is a lossless
+                     * refresh, those cells must also be sent losslessly. */
+                    if (cell->lossy) {
+                        guac_rect_init(&current_op->dest, x * GUAC_DISPLAY_CELL_SIZE,
+                                y * GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_CELL_SIZE,
+                                GUAC_DISPLAY_CELL_SIZE);
+                        guac_rect_constrain(&current_op->dest, &pending_frame_bounds);
+                        guac_rect_extend(&current->pending_frame.dirty, &current_op->dest);
+                        current_op->lossless = display->lossless_refresh;
+                    }
 
                     cell->related_op = current_op;
                     cell->dirty_size = 0;
@@ -364,8 +578,24 @@ guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display) {
 }
 
 void guac_display_plan_free(guac_display_plan* plan) {
-    guac_mem_free(plan->ops);
-    guac_mem_free(plan);
+
+    guac_display* display = plan->display;
+    guac_display_arena* arena = &display->arena;
+
+    /* NOTE: The plan itself remains within the arena for reuse by the next
+     * frame. Only the allocation statistics need be dealt with here. */
+
+    unsigned int allocations = guac_display_arena_count(arena);
+    if (allocations)
+        guac_client_log(display->client, GUAC_LOG_DEBUG, "Render planning "
+                "required %u allocation(s) to grow the frame arena.",
+                allocations);
+    else
+        guac_client_log(display->client, GUAC_LOG_TRACE, "Render planning "
+                "required no allocations.");
+
+    guac_display_arena_reset_count(arena);
+
 }
 
 void guac_display_plan_apply(guac_display_plan* plan) {
@@ -373,6 +603,7 @@ void guac_display_plan_apply(guac_display_plan* plan) {
     guac_display* display = plan->display;
     guac_client* client = display->client;
     guac_display_plan_operation* op = plan->ops;
+    size_t image_pixels = 0;
 
     /* Do not allow worker threads to move forward with image encoding until
      * AFTER the non-image instructions have finished being written */
@@ -421,6 +652,7 @@ void guac_display_plan_apply(guac_display_plan* plan) {
 
             /* All other operations should be handled by the workers */
             default:
+                image_pixels += (size_t) guac_rect_width(&op->dest) * guac_rect_height(&op->dest);
                 guac_fifo_enqueue(&display->ops, op);
                 break;
 
@@ -430,6 +662,10 @@ void guac_display_plan_apply(guac_display_plan* plan) {
 
     }
 
+    /* Allow the time budgeted for each image to be divided up based on the
+     * overall size of the frame */
+    display->cost_model.frame_pixels = image_pixels;
+
     guac_fifo_unlock(&display->ops);
 
 }
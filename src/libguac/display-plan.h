@@ -82,6 +82,41 @@
  */
 #define GUAC_DISPLAY_JPEG_MIN_BITMAP_SIZE 4096
 
+/**
+ * Minimum image size (area) for an update to be sent progressively, as a
+ * quickly-encoded, low-quality preview followed by a separate full-quality
+ * refinement. Smaller updates are encoded quickly enough that there is no
+ * benefit to doing so.
+ */
+#define GUAC_DISPLAY_PREVIEW_MIN_SIZE (256 * 256)
+
+/**
+ * The lossy quality (between 0 and 100) of the low-quality previews sent for
+ * updates that are being sent progressively.
+ */
+#define GUAC_DISPLAY_PREVIEW_QUALITY 20
+
+/**
+ * The amount of time that a cell last sent using lossy compression must
+ * remain unchanged before it is automatically re-sent losslessly, in
+ * milliseconds.
+ */
+#define GUAC_DISPLAY_LOSSLESS_REFRESH_DELAY 500
+
+/**
+ * The amount of time that the worker threads must remain idle before cells
+ * last sent using lossy compression are considered for being re-sent
+ * losslessly, in milliseconds.
+ */
+#define GUAC_DISPLAY_LOSSLESS_REFRESH_INTERVAL 100
+
+/**
+ * The maximum number of cells that may be re-sent losslessly as part of a
+ * single lossless refresh. Limiting the size of each refresh ensures that a
+ * refresh cannot significantly delay any newer frame.
+ */
+#define GUAC_DISPLAY_LOSSLESS_REFRESH_MAX_CELLS 64
+
 /**
  * The JPEG compression min block size, as the exponent of a power of two. This
  * defines the optimal rectangle block size factor for JPEG compression.
@@ -141,7 +176,24 @@ typedef enum guac_display_plan_operation_type {
     /**
      * Draw arbitrary image data to the destination rect.
      */
-    GUAC_DISPLAY_PLAN_OPERATION_IMG
+    GUAC_DISPLAY_PLAN_OPERATION_IMG,
+
+    /**
+     * Assist the thread that is currently planning a frame by performing any
+     * outstanding bands of work started by guac_display_foreach_band(). This
+     * operation is never part of a guac_display_plan and is used only to
+     * awaken the display worker threads while a frame is being planned.
+     */
+    GUAC_DISPLAY_PLAN_OPERATION_BANDS,
+
+    /**
+     * Redraw the destination rect at full quality, replacing a low-quality
+     * preview of the same image data that was sent as part of the previous
+     * frame. This operation is never part of a guac_display_plan and is
+     * queued only by the display worker threads after a preview has been
+     * sent. Refinements may be abandoned if a newer frame is waiting.
+     */
+    GUAC_DISPLAY_PLAN_OPERATION_REFINE
 
 } guac_display_plan_operation_type;
 
@@ -205,6 +257,14 @@ typedef struct guac_display_plan_operation {
      */
     guac_timestamp current_frame;
 
+    /**
+     * Non-zero if the image data of this operation must be encoded
+     * losslessly, such as when that data will be reused from the tile cache
+     * by later frames. This value applies only to
+     * GUAC_DISPLAY_PLAN_OPERATION_IMG operations.
+     */
+    int lossless;
+
     union {
 
         /**
@@ -244,6 +304,13 @@ typedef struct guac_display_plan_indexed_operation {
      */
     uint64_t hash;
 
+    /**
+     * The generation of the index that this entry was stored within. Entries
+     * whose generation differs from the current generation of the plan are
+     * stale and are considered to be empty.
+     */
+    unsigned int generation;
+
 } guac_display_plan_indexed_operation;
 
 /**
@@ -278,9 +345,18 @@ typedef struct guac_display_plan {
      */
     size_t length;
 
+    /**
+     * The current generation of ops_by_hash. This value is incremented each
+     * time the plan is indexed, implicitly clearing all entries stored by
+     * previous frames without having to touch each entry.
+     */
+    unsigned int generation;
+
     /**
      * Index of operations in the plan by their image contents. Only operations
      * that can be easily stored without collisions will be represented here.
+     * Only entries whose generation matches the generation of the plan are
+     * valid.
      */
     guac_display_plan_indexed_operation ops_by_hash[GUAC_DISPLAY_PLAN_OPERATION_INDEX_SIZE];
 
@@ -301,7 +377,9 @@ typedef struct guac_display_plan {
  * picked up after the currently-pending frame has finished encoded.
  *
  * The returned guac_display_plan must eventually be manually freed by a call
- * to guac_display_plan_free().
+ * to guac_display_plan_free(). The storage for the plan is taken from the
+ * frame arena of the display and is recycled for the next plan once freed,
+ * and only one plan may exist for a particular display at any given time.
  *
  * IMPORTANT: The calling thread must already hold the write lock for the
  * display's pending_frame.lock, and must at least hold the read lock for the
@@ -319,7 +397,12 @@ typedef struct guac_display_plan {
 guac_display_plan* PFW_LFR_guac_display_plan_create(guac_display* display);
 
 /**
- * Frees all memory associated with the given guac_display_plan.
+ * Frees the given guac_display_plan, returning its storage to the frame arena
+ * of its display such that it may be reused by the next plan. The number of
+ * allocations performed by the arena while producing the plan is logged.
+ *
+ * IMPORTANT: The calling thread must already hold the write lock for the
+ * display's pending_frame.lock.
  *
  * @param plan
  *     The plan to free.
@@ -347,6 +430,24 @@ void PFR_guac_display_plan_rewrite_as_rects(guac_display_plan* plan);
  */
 void PFR_guac_display_plan_index_dirty_cells(guac_display_plan* plan);
 
+/**
+ * Walks through all operations currently in the given guac_display_plan,
+ * replacing draw operations covering entire 64x64 cells with copies from the
+ * display's tile cache wherever the same image data was sent recently and is
+ * still cached. The image data of any such draw operations that cannot be
+ * replaced is stored in the tile cache for future frames. This function must
+ * be invoked after guac_display_plan_index_dirty_cells(), as the hashes
+ * calculated while indexing are reused for lookups within the cache.
+ *
+ * IMPORTANT: The calling thread must already hold the write lock for the
+ * display's last_frame.lock and must at least hold the read lock for the
+ * display's pending_frame.lock.
+ *
+ * @param plan
+ *     The guac_display_plan to rewrite.
+ */
+void PFR_LFW_guac_display_plan_rewrite_as_cached(guac_display_plan* plan);
+
 /**
  * Walks through all operations currently in the given guac_display_plan,
  * replacing draw operations with simple copies wherever draws can be rewritten
@@ -379,6 +480,22 @@ void PFW_guac_display_plan_combine_horizontally(guac_display_plan* plan);
  */
 void PFW_guac_display_plan_combine_vertically(guac_display_plan* plan);
 
+/**
+ * Updates the lossy flag of each cell affected by the operations within the
+ * given guac_display_plan, accounting for updates that will not be encoded by
+ * the worker threads. Cells fully covered by a rectangle or by a copy from
+ * losslessly-sent data are no longer lossy, while cells that receive a copy of
+ * lossy data become lossy. The flags of cells affected by image updates are
+ * instead updated once the worker threads report how those updates were
+ * encoded. This pass must be invoked after all other optimizations have been
+ * performed.
+ *
+ * @param plan
+ *     The guac_display_plan whose effect on the lossy flag of each cell
+ *     should be tracked.
+ */
+void PFW_LFR_guac_display_plan_track_lossy(guac_display_plan* plan);
+
 /**
  * Enqueues all operations from the given plan within the operation FIFO used
  * by the worker threads of the display associated with that plan. The
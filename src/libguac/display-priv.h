@@ -20,10 +20,13 @@
 #ifndef GUAC_DISPLAY_PRIV_H
 #define GUAC_DISPLAY_PRIV_H
 
+#include "display-kernels.h"
 #include "display-plan.h"
 #include "guacamole/client.h"
 #include "guacamole/display.h"
 #include "guacamole/fifo.h"
+#include "guacamole/flag.h"
+#include "guacamole/layer.h"
 #include "guacamole/rect.h"
 #include "guacamole/socket.h"
 
@@ -246,619 +249,2410 @@
 #define GUAC_DISPLAY_RENDER_THREAD_STATE_FRAME_READY 4
 
 /**
- * The state of the mouse cursor, as independently tracked by the render
- * thread. The mouse cursor state may be reported by
- * guac_display_render_thread_notify_user_moved_mouse() to avoid unnecessarily
- * locking the display within instruction handlers (which can otherwise result
- * in delays in handling critical instructions like "sync").
+ * Bitwise flag set on the state of guac_display_bands when all bands of work
+ * started by the most recent call to guac_display_foreach_band() have
+ * completed.
  */
-typedef struct guac_display_render_thread_cursor_state {
+#define GUAC_DISPLAY_BANDS_STATE_COMPLETE 1
 
-    /**
-     * The user that moved or clicked the mouse.
-     *
-     * NOTE: This user is NOT guaranteed to still exist in memory. This may be
-     * a dangling pointer and must be validated before deferencing.
-     */
-    guac_user* user;
+/**
+ * Bitwise flag set on the state of guac_display_snapshots while at least one
+ * snapshot is waiting to be sent.
+ */
+#define GUAC_DISPLAY_SNAPSHOTS_STATE_PENDING 1
 
-    /**
-     * The X coordinate of the mouse cursor.
-     */
-    int x;
+/**
+ * Bitwise flag set on the state of guac_display_snapshots once the display is
+ * stopping. Snapshots that have not yet been sent are discarded, and no
+ * further snapshots are accepted.
+ */
+#define GUAC_DISPLAY_SNAPSHOTS_STATE_STOPPING 2
 
-    /**
-     * The Y coordinate of the mouse cursor.
-     */
-    int y;
+/**
+ * The maximum number of bands that any single call to
+ * guac_display_foreach_band() will divide its work into.
+ */
+#define GUAC_DISPLAY_MAX_BANDS 64
 
-    /**
-     * The mask representing the states of all mouse buttons.
-     */
-    int mask;
+/**
+ * The minimum number of pixels that should be processed by each band of work
+ * performed in parallel while planning a frame. Work involving fewer pixels
+ * than this is not worth the overhead of waking the worker threads.
+ */
+#define GUAC_DISPLAY_BAND_MIN_PIXELS (512 * 512)
 
-} guac_display_render_thread_cursor_state;
+/**
+ * Callback invoked by guac_display_foreach_band() for each band of work. Each
+ * band of work is performed by an arbitrary thread, either a worker thread or
+ * the thread that called guac_display_foreach_band(), and must not depend on
+ * any other band.
+ *
+ * @param display
+ *     The guac_display that the work is being performed for.
+ *
+ * @param band
+ *     The index of the band of work to perform, where the first band is 0.
+ *
+ * @param data
+ *     The arbitrary data that was provided to guac_display_foreach_band().
+ */
+typedef void guac_display_band_callback(guac_display* display, int band, void* data);
 
-struct guac_display_render_thread {
+/**
+ * The state of the bands of work currently being performed in parallel by the
+ * display worker threads on behalf of the thread that is planning a frame.
+ */
+typedef struct guac_display_bands {
 
     /**
-     * The display this render thread should render to.
+     * Flag that guards access to all other members of this structure and
+     * signals completion of all bands via GUAC_DISPLAY_BANDS_STATE_COMPLETE.
+     * The lock of this flag MUST be acquired before accessing or modifying any
+     * other member of this structure.
      */
-    guac_display* display;
+    guac_flag state;
 
     /**
-     * The actual underlying POSIX thread.
+     * The callback to invoke for each band.
      */
-    pthread_t thread;
+    guac_display_band_callback* callback;
 
     /**
-     * Flag representing render state. This flag is used to store whether the
-     * render thread is stopping and whether the current frame has been
-     * modified or is ready.
-     *
-     * @see GUAC_DISPLAY_RENDER_THREAD_STATE_STOPPING
-     * @see GUAC_DISPLAY_RENDER_THREAD_FRAME_MODIFIED
-     * @see GUAC_DISPLAY_RENDER_THREAD_FRAME_READY
+     * The arbitrary data to provide to the callback.
      */
-    guac_flag state;
+    void* data;
 
     /**
-     * The current mouse cursor state, as reported by
-     * guac_display_render_thread_notify_user_moved_mouse().
+     * The total number of bands.
      */
-    guac_display_render_thread_cursor_state cursor_state;
+    int count;
 
     /**
-     * The number of frames that have been explicitly marked as ready since the
-     * last frame sent. This will be zero if explicit frame boundaries are not
-     * currently being used.
+     * The index of the next band that has not yet been claimed by any thread.
      */
-    unsigned int frames;
+    int next;
 
-};
+    /**
+     * The number of bands that have not yet finished.
+     */
+    int remaining;
+
+} guac_display_bands;
 
 /**
- * Approximation of how often a region of a layer is modified, as well as what
- * changes have been made to that region since the last frame. This information
- * is used to help advise future optimizations, such as whether lossy
- * compression is appropriate and whether parts of the layer can be copied from
- * other regions rather than resend image data.
+ * A copy of the state of a single layer or buffer as of the last frame, taken
+ * for the sake of synchronizing joining users.
  */
-typedef struct guac_display_layer_cell {
+typedef struct guac_display_snapshot_layer {
 
     /**
-     * The last time this particular cell was part of a frame (used to
-     * calculate framerate).
+     * The layer or buffer whose state was copied.
      */
-    guac_timestamp last_frame;
+    guac_layer layer;
 
     /**
-     * The region of this cell that has been modified since the last frame was
-     * flushed. If the cell has not been modified at all, this will be an empty
-     * rect.
+     * The buffer containing a copy of the previous frame of this layer, as
+     * used for copies from the previous frame.
      */
-    guac_rect dirty;
+    guac_layer last_frame_buffer;
 
     /**
-     * The rough number of pixels in the dirty rect that have been modified. If
-     * the cell has not been modified at all, this will be zero.
+     * The parent of this layer. This value applies only to visible layers
+     * (layers with a positive index).
      */
-    size_t dirty_size;
+    guac_layer parent;
 
     /**
-     * The display plan operation that is associated with this cell. If a
-     * display plan is not currently being created or optimized, this will be
-     * NULL.
+     * Non-zero if this layer is opaque, zero otherwise.
      */
-    guac_display_plan_operation* related_op;
-
-} guac_display_layer_cell;
-
-/**
- * The state of a Guacamole layer or buffer at some point in time. Within
- * guac_display_layer, copies of this structure are used to represent the
- * previous frame and the current, in-progress frame. The previous and
- * in-progress frames are compared during flush to determine what graphical
- * operations need to be sent to connected clients to efficiently transform the
- * remote display from its previous state to the now-current state.
- *
- * IMPORTANT: The lock of the corresponding guac_display_state must be acquired
- * before reading or modifying the values of any member of this structure.
- */
-typedef struct guac_display_layer_state {
+    int opaque;
 
     /**
-     * The width of this layer in pixels.
+     * The width of this layer, in pixels.
      */
     int width;
 
     /**
-     * The height of this layer in pixels.
+     * The height of this layer, in pixels.
      */
     int height;
 
     /**
-     * The layer which contains this layer. This is only applicable to visible
-     * (non-buffer) layers which are not the default layer.
+     * A copy of the contents of this layer, in the same format as the image
+     * buffers of guac_display_layer_state, with a stride of exactly four
+     * bytes per pixel, or NULL if this layer is empty.
      */
-    const guac_layer* parent;
+    unsigned char* buffer;
 
     /**
-     * The X coordinate of the upper-left corner of this layer, in pixels,
-     * relative to its parent layer. This is only applicable to visible
-     * (non-buffer) layers which are not the default layer.
+     * The X coordinate of this layer relative to its parent.
      */
     int x;
 
     /**
-     * The Y coordinate of the upper-left corner of this layer, in pixels,
-     * relative to its parent layer. This is only applicable to visible
-     * (non-buffer) layers which are not the default layer.
+     * The Y coordinate of this layer relative to its parent.
      */
     int y;
 
     /**
-     * The Z-order of this layer, relative to sibling layers. This is only
-     * applicable to visible (non-buffer) layers which are not the default
-     * layer.
+     * The Z-order of this layer relative to its siblings.
      */
     int z;
 
     /**
-     * The level of opacity applied to this layer. Fully opaque is 255, while
-     * fully transparent is 0. This is only applicable to visible (non-buffer)
-     * layers which are not the default layer.
+     * The opacity of this layer, where 0 is completely transparent and 255 is
+     * completely opaque.
      */
     int opacity;
 
     /**
-     * The number of simultaneous touches that this surface can accept, where 0
-     * indicates that the surface does not support touch events at all.
+     * The maximum number of simultaneous touches supported by this layer.
      */
     int touches;
 
+} guac_display_snapshot_layer;
+
+/**
+ * A consistent copy of the last frame of a guac_display, together with the
+ * sockets of the joining users that must receive that copy. The copy is
+ * encoded and sent in the background, while the queued output of each of
+ * those users is held such that frames rendered in the meantime are sent
+ * only after the snapshot.
+ */
+typedef struct guac_display_snapshot {
+
     /**
-     * Non-zero if all graphical updates for this surface should use lossless
-     * compression, 0 otherwise. By default, newly-created surfaces will use
-     * lossy compression when heuristics determine it is appropriate.
+     * The next snapshot waiting to be sent, or NULL if there is no such
+     * snapshot.
      */
-    int lossless;
+    struct guac_display_snapshot* next;
 
     /**
-     * The raw, 32-bit buffer of ARGB image data. If the layer was allocated as
-     * opaque, the alpha channel of each ARGB pixel will not be considered when
-     * compositing or when encoding images.
-     *
-     * So that large regions of image data can be easily compared, a consistent
-     * value for the alpha channel SHOULD be provided so that each 32-bit pixel
-     * can be compared without having to separately masking the channel.
-     * Optimizations within guac_display, including scroll detection, may
-     * assume that the alpha channel can always be considered when comparing
-     * pixel values for equivalence.
+     * The sockets that the snapshot must be sent to, as returned by
+     * guac_socket_queue_hold(). The output held by each is released when
+     * the socket is freed.
      */
-    unsigned char* buffer;
+    guac_socket** targets;
 
     /**
-     * The width of the image data, in pixels. This is not necessarily the same
-     * as the width of the layer.
+     * The number of sockets within the targets array.
      */
-    int buffer_width;
+    int target_count;
 
     /**
-     * The height of the image data, in pixels. This is not necessarily the
-     * same as the height of the layer.
+     * The state of each layer and buffer, in the same order as the layers of
+     * the last frame.
      */
-    int buffer_height;
+    guac_display_snapshot_layer* layers;
 
     /**
-     * The number of bytes in each row of image data. This is not necessarily
-     * equivalent to 4 * width.
+     * The number of entries within the layers array.
      */
-    size_t buffer_stride;
+    int layer_count;
 
     /**
-     * Non-zero if the image data referenced by the buffer pointer was
-     * allocated externally and should not be automatically freed or managed by
-     * guac_display, zero otherwise.
+     * The buffer backing the client-side tile cache. This value is only
+     * meaningful if tile_cache_image is non-NULL.
      */
-    int buffer_is_external;
+    guac_layer tile_cache_buffer;
 
     /**
-     * The approximate rectangular region containing all pixels within this
-     * layer that have been modified since the frame that occurred before this
-     * frame. If the layer was not modified, this will be an empty rect (zero
-     * width or zero height).
+     * A copy of the contents of the client-side tile cache, with a stride of
+     * exactly four bytes per pixel, or NULL if the tile cache is not in use.
      */
-    guac_rect dirty;
+    unsigned char* tile_cache_image;
 
     /**
-     * Whether this layer should be searched for possible scroll/copy
-     * optimizations.
+     * The width of the client-side tile cache, in pixels.
      */
-    int search_for_copies;
+    int tile_cache_width;
 
-    /* ---------------- LAYER LIST POINTERS ---------------- */
+    /**
+     * The height of the client-side tile cache, in pixels.
+     */
+    int tile_cache_height;
 
     /**
-     * The layer immediately prior to this layer within the list containing
-     * this layer, or NULL if this is the first layer/buffer in the list.
+     * The buffer containing the image of the mouse cursor.
      */
-    guac_display_layer* prev;
+    guac_layer cursor;
 
     /**
-     * The layer immediately following this layer within the list containing
-     * this layer, or NULL if this is the last layer/buffer in the list.
+     * The width of the mouse cursor image, in pixels.
      */
-    guac_display_layer* next;
+    int cursor_width;
 
-} guac_display_layer_state;
+    /**
+     * The height of the mouse cursor image, in pixels.
+     */
+    int cursor_height;
 
-struct guac_display_layer {
+    /**
+     * The X coordinate of the hotspot of the mouse cursor.
+     */
+    int cursor_hotspot_x;
 
     /**
-     * The guac_display instance that allocated this layer/buffer.
+     * The Y coordinate of the hotspot of the mouse cursor.
      */
-    guac_display* display;
+    int cursor_hotspot_y;
 
     /**
-     * The Guacamole layer (or buffer) that this guac_display_layer will draw
-     * to when flushing a frame.
-     *
-     * NOTE: This value is set only during allocation and may safely be
-     * accessed without acquiring the overall layer lock.
+     * The X coordinate of the mouse cursor.
      */
-    const guac_layer* layer;
+    int cursor_x;
 
     /**
-     * Whether the graphical data that will be written to this layer/buffer
-     * will only ever be opaque (no alpha channel). Compositing of graphical
-     * updates can be faster when no alpha channel need be considered.
+     * The Y coordinate of the mouse cursor.
      */
-    int opaque;
+    int cursor_y;
 
-    /* ---------------- LAYER PREVIOUS FRAME STATE ---------------- */
+    /**
+     * The mouse button state.
+     */
+    int cursor_mask;
 
     /**
-     * The state of this layer when the last frame was flushed to connected clients.
-     *
-     * IMPORTANT: The display-level last_frame.lock MUST be acquired before
-     * modifying or reading this member.
+     * The timestamp of the last frame sent by the client.
      */
-    guac_display_layer_state last_frame;
+    guac_timestamp timestamp;
 
     /**
-     * Off-screen buffer storing the contents of the previously-rendered frame
-     * for later use. If graphical updates are recognized as reusing data from
-     * a previous frame, that data will be copied from this buffer. Doing this
-     * simplifies the copy operation (there is no longer any need to perform
-     * those copies in a specific order) and ensures the copies are efficient
-     * on the client side (copying from one part of a graphical surface to
-     * another part of the same surface can be inefficient, particularly if the
-     * regions overlap). In practice, there is ample time between frames for
-     * the client to copy a layer's current contents to an off-screen buffer
-     * while awaiting the next frame.
-     *
-     * NOTE: This value is set only during allocation and may safely be
-     * accessed without acquiring the display-level last_frame.lock.
+     * The number of logical frames combined within the last frame.
      */
-    guac_layer* last_frame_buffer;
+    int frames;
 
-    /* ---------------- LAYER PENDING FRAME STATE ---------------- */
+} guac_display_snapshot;
+
+/**
+ * The snapshots of the display waiting to be sent to joining users, along
+ * with the thread that sends them.
+ */
+typedef struct guac_display_snapshots {
 
     /**
-     * The upcoming state of this layer when the current, in-progress frame is
-     * flushed to connected clients.
-     *
-     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
-     * modifying or reading this member.
+     * Flag that guards access to all other members of this structure, and
+     * signals the arrival of new snapshots via
+     * GUAC_DISPLAY_SNAPSHOTS_STATE_PENDING and the end of the display via
+     * GUAC_DISPLAY_SNAPSHOTS_STATE_STOPPING. The lock of this flag MUST be
+     * acquired before accessing or modifying any other member of this
+     * structure.
      */
-    guac_display_layer_state pending_frame;
+    guac_flag state;
 
     /**
-     * The Cairo context and surface containing the graphical data of the
-     * pending frame. The actual underlying buffer and details of the graphical
-     * surface are also available via pending_frame_raw_context.
-     *
-     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
-     * modifying or reading this member.
+     * The oldest snapshot waiting to be sent, or NULL if there are no such
+     * snapshots.
      */
-    guac_display_layer_cairo_context pending_frame_cairo_context;
+    guac_display_snapshot* head;
 
     /**
-     * The raw underlying buffer and details of the surface containing the
-     * graphical data of the pending frame. A Cairo context and surface backed
-     * by this buffer are also available via pending_frame_cairo_context.
-     *
-     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
-     * modifying or reading this member.
+     * The newest snapshot waiting to be sent, or NULL if there are no such
+     * snapshots.
      */
-    guac_display_layer_raw_context pending_frame_raw_context;
+    guac_display_snapshot* tail;
 
     /**
-     * A two-dimensional array of square tiles representing the nature of
-     * changes made to corresponding regions of the display. This is used both
-     * to track how frequently certain regions are being updated (to help
-     * inform whether lossy compression is appropriate), to track what parts of
-     * the frame have actually changed, and to aid in determining whether
-     * adjacent updated regions should be combined into a single update.
-     *
-     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
-     * modifying or reading this member.
+     * The thread that encodes and sends snapshots.
      */
-    guac_display_layer_cell* pending_frame_cells;
+    pthread_t thread;
 
     /**
-     * The width of the pending_frame_cells array, in cells.
-     *
-     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
-     * modifying or reading this member.
+     * Non-zero if the thread that sends snapshots was successfully started,
+     * zero otherwise.
      */
-    size_t pending_frame_cells_width;
+    int thread_started;
+
+} guac_display_snapshots;
+
+/**
+ * Reusable storage within a guac_display_arena. The storage is grown as
+ * necessary but never shrunk or freed until the arena itself is freed.
+ */
+typedef struct guac_display_arena_buffer {
 
     /**
-     * The height of the pending_frame_cells array, in cells.
-     *
-     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
-     * modifying or reading this member.
+     * The storage currently allocated for this buffer, or NULL if no storage
+     * has yet been allocated.
      */
-    size_t pending_frame_cells_height;
+    void* data;
 
-};
+    /**
+     * The size of the storage currently allocated, in bytes.
+     */
+    size_t size;
 
-typedef struct guac_display_state {
+    /**
+     * The number of times storage has been allocated for this buffer since
+     * the allocation count was last reset by guac_display_arena_reset_count().
+     */
+    unsigned int allocations;
+
+} guac_display_arena_buffer;
+
+/**
+ * Storage that is used while planning each frame and is recycled between
+ * frames, such that a display that has reached a steady state does not need
+ * to allocate any memory to plan a frame. With the exception of the buffers
+ * used by individual bands of work, which are each accessed only by the thread
+ * performing the corresponding band, the contents of the arena may only be
+ * accessed while holding the write lock of the display's pending_frame.lock.
+ */
+typedef struct guac_display_arena {
 
     /**
-     * Lock that guards concurrent access to any member of ANY STRUCTURE that
-     * relates to this guac_display_state, including the members of this
-     * structure. Unless explicitly documented otherwise, this lock MUST be
-     * acquired before accessing or modifying the members of this
-     * guac_display_state or any nested structure.
+     * Storage for the guac_display_plan itself.
      */
-    guac_rwlock lock;
+    guac_display_arena_buffer plan;
 
     /**
-     * The specific point in time that this guac_display_state represents.
+     * Storage for the array of operations within the guac_display_plan.
      */
-    guac_timestamp timestamp;
+    guac_display_arena_buffer ops;
 
     /**
-     * All layers and buffers that were part of the display at the time that
-     * the frame/snapshot represented by this guac_display_state was updated.
-     * 
-     * NOTE: For each guac_display, there are two distinct lists of layers: the
-     * last frame layer list and the pending frame layer list:
-     *
-     * LAST FRAME LAYER LIST
-     *
-     *  - HEAD: display->last_frame.layers
-     *  - NEXT: layer->last_frame.next
-     *  - PREV: layer->last_frame.prev
-     *
-     * PENDING LAYER LIST
-     *
-     *  - HEAD: display->pending_frame.layers
-     *  - NEXT: layer->pending_frame.next
-     *  - PREV: layer->pending_frame.prev
-     *
-     * Existing layers are deleted only at the time a frame is flushed when a
-     * layer in the last frame layer list is found to no longer exist in the
-     * pending frame layer list. The same goes for the addition of new layers:
-     * they are added only during flush when a layer that was not present in
-     * the last frame layer list is found to be present in the pending frame
-     * layer list.
+     * Storage for the hashes of each operation while indexing a
+     * guac_display_plan.
      */
-    guac_display_layer* layers;
+    guac_display_arena_buffer op_hashes;
 
     /**
-     * The X coordinate of the hotspot of the mouse cursor. The cursor image is
-     * stored/updated via the cursor_buffer member of guac_display.
+     * Storage for the flags noting whether each operation may be indexed while
+     * indexing a guac_display_plan.
      */
-    int cursor_hotspot_x;
+    guac_display_arena_buffer op_indexable;
 
     /**
-     * The Y coordinate of the hotspot of the mouse cursor. The cursor image is
-     * stored/updated via the cursor_buffer member of guac_display.
+     * Storage for the flags noting whether the source of each copy operation
+     * was last sent using lossy compression while tracking the effect of a
+     * guac_display_plan on the lossy flag of each cell.
      */
-    int cursor_hotspot_y;
+    guac_display_arena_buffer op_lossy;
 
     /**
-     * The user that moved or clicked the mouse. This is used to ensure we
-     * don't attempt to synchronize an out-of-date mouse position to the user
-     * that is actively moving the mouse.
-     *
-     * NOTE: This user is NOT guaranteed to still exist in memory. This may be
-     * a dangling pointer and must be validated before deferencing.
+     * Storage for the possible copies found by each band while searching for
+     * copies.
      */
-    guac_user* cursor_user;
+    guac_display_arena_buffer search_hits[GUAC_DISPLAY_MAX_BANDS];
+
+} guac_display_arena;
+
+/**
+ * The number of 64x64 tiles in each row of the client-side buffer used by the
+ * tile cache. The buffer is as tall as necessary to store all tiles.
+ */
+#define GUAC_DISPLAY_TILE_CACHE_COLUMNS 16
+
+/**
+ * The maximum number of tiles that may be stored within the tile cache,
+ * regardless of the configured cache size. This limit ensures the client-side
+ * buffer used by the cache never exceeds the maximum size of a guac_display.
+ */
+#define GUAC_DISPLAY_TILE_CACHE_MAX_TILES \
+    (GUAC_DISPLAY_TILE_CACHE_COLUMNS * (GUAC_DISPLAY_MAX_HEIGHT / GUAC_DISPLAY_CELL_SIZE))
+
+/**
+ * The number of bytes of image data in each tile stored within the tile
+ * cache.
+ */
+#define GUAC_DISPLAY_TILE_CACHE_TILE_SIZE \
+    (GUAC_DISPLAY_CELL_SIZE * GUAC_DISPLAY_CELL_SIZE * GUAC_DISPLAY_LAYER_RAW_BPP)
+
+/**
+ * A single slot within the tile cache, each slot storing one 64x64 tile.
+ */
+typedef struct guac_display_tile_cache_entry {
 
     /**
-     * The X coordinate of the mouse cursor.
+     * The hash of the image data stored in this slot, as produced by the same
+     * rolling hash used to search for copies. This value is meaningful only if
+     * the slot is in use.
      */
-    int cursor_x;
+    uint64_t hash;
 
     /**
-     * The Y coordinate of the mouse cursor.
+     * Non-zero if this slot currently contains a tile, zero otherwise.
      */
-    int cursor_y;
+    int in_use;
 
     /**
-     * The mask representing the states of all mouse buttons.
+     * The frame (as counted by the frame member of guac_display_tile_cache)
+     * during which this slot was last used, whether by storing a new tile or
+     * by providing a cached tile. Slots used by the current frame cannot be
+     * evicted, as their contents are referenced by that frame.
      */
-    int cursor_mask;
+    unsigned int used_frame;
 
     /**
-     * The number of logical frames that have been rendered to this display
-     * state since the previous display state.
+     * The frame (as counted by the frame member of guac_display_tile_cache)
+     * during which the tile in this slot was stored. Until that frame has
+     * been sent, the client-side copy of the tile does not yet exist.
      */
-    unsigned int frames;
+    unsigned int stored_frame;
 
-} guac_display_state;
+    /**
+     * The index of the next slot in the same hash bucket, or -1 if there are
+     * no further slots in the bucket.
+     */
+    int bucket_next;
 
-struct guac_display {
+    /**
+     * The index of the slot that was used more recently than this slot, or -1
+     * if this slot is the most recently used.
+     */
+    int lru_prev;
 
-    /* NOTE: Any member of this structure that requires protection against
-     * concurrent access is protected by its own lock. The overall display does
-     * not have nor need a top-level lock. */
+    /**
+     * The index of the slot that was used less recently than this slot, or -1
+     * if this slot is the least recently used.
+     */
+    int lru_next;
+
+} guac_display_tile_cache_entry;
+
+/**
+ * A tile that has been stored within the tile cache for the current frame and
+ * must be copied into the client-side cache buffer once the frame has been
+ * drawn.
+ */
+typedef struct guac_display_tile_cache_store {
 
     /**
-     * The client associated with this display.
+     * The layer containing the tile.
      */
-    guac_client* client;
+    guac_display_layer* layer;
 
-    /* ---------------- DISPLAY FRAME STATES ---------------- */
+    /**
+     * The X coordinate of the upper-left corner of the tile within the layer.
+     */
+    int x;
 
     /**
-     * The state of this display at the time the last frame was sent to
-     * connected users.
+     * The Y coordinate of the upper-left corner of the tile within the layer.
      */
-    guac_display_state last_frame;
+    int y;
 
     /**
-     * The pending state of this display that will become the next frame once
-     * it is sent to connected users.
+     * The index of the slot receiving the tile.
      */
-    guac_display_state pending_frame;
+    int slot;
+
+} guac_display_tile_cache_store;
+
+/**
+ * Least-recently-used cache of 64x64 tiles of image data that have already
+ * been sent to connected clients, indexed by the hashes of those tiles. Cached
+ * tiles are stored client-side within a hidden buffer, with an identical copy
+ * maintained server-side so that matches can be verified and so that the
+ * buffer can be synchronized to joining users.
+ *
+ * The contents of the tile cache are part of the last frame and may only be
+ * accessed while holding the display's last_frame.lock.
+ */
+typedef struct guac_display_tile_cache {
 
     /**
-     * Whether the pending frame has been modified in any way outside of
-     * changing the mouse cursor or moving the mouse. This is used to help
-     * inform whether a frame should be flushed to update connected clients
-     * with respect to mouse cursor changes, or whether those changes can be
-     * safely assumed to be part of a larger frame containing general graphical
-     * updates.
-     *
-     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
-     * modifying or reading this member.
+     * The maximum number of tiles that may be stored within the cache. If
+     * zero, the cache is disabled.
      */
-    int pending_frame_dirty_excluding_mouse;
+    int capacity;
 
-    /* ---------------- WELL-KNOWN LAYERS / BUFFERS ---------------- */
+    /**
+     * The client-side buffer containing all cached tiles, or NULL if the
+     * cache has not yet been allocated.
+     */
+    guac_layer* buffer;
 
     /**
-     * The default layer of the client display.
+     * Server-side copy of the image data within the client-side buffer, laid
+     * out identically with a stride of
+     * GUAC_DISPLAY_TILE_CACHE_COLUMNS * GUAC_DISPLAY_TILE_CACHE_TILE_SIZE
+     * bytes.
      */
-    guac_display_layer* default_layer;
+    unsigned char* image;
 
     /**
-     * The buffer storing the current mouse cursor. The hotspot position within
-     * the cursor is stored within cursor_hotspot_x and cursor_hotspot_y of
-     * guac_display_state.
+     * Array of all slots in the cache, containing one entry per tile.
      */
-    guac_display_layer* cursor_buffer;
+    guac_display_tile_cache_entry* entries;
 
-    /* ---------------- FRAME ENCODING WORKER THREADS ---------------- */
+    /**
+     * Hash table of slots in use, where each element is the index of the
+     * first slot in the corresponding bucket, or -1 if the bucket is empty.
+     */
+    int* buckets;
 
     /**
-     * The number of worker threads in the worker_threads array.
+     * Mask that must be applied to a hash to determine its bucket. The number
+     * of buckets is always this value plus one.
      */
-    int worker_thread_count;
+    uint64_t bucket_mask;
 
     /**
-     * Pool of worker threads that automatically pull from the ops FIFO,
-     * sending corresponding Guacamole instructions to all connected clients.
+     * The index of the most recently used slot.
      */
-    pthread_t* worker_threads;
+    int lru_head;
 
     /**
-     * FIFO of all graphical operations required to transform the remote
-     * display state from the previous frame to the next frame. Operations
-     * added to this FIFO will automatically be pulled and processed by a
-     * worker thread.
+     * The index of the least recently used slot.
      */
-    guac_fifo ops;
+    int lru_tail;
 
     /**
-     * Storage for any items within the ops fifo.
+     * Counter that is incremented for each frame that uses the cache.
      */
-    guac_display_plan_operation ops_items[GUAC_DISPLAY_WORKER_FIFO_SIZE];
+    unsigned int frame;
 
     /**
-     * The current number of active worker threads.
-     *
-     * IMPORTANT: This member must only be accessed or modified while the ops
-     * FIFO is locked.
+     * Tiles stored by the current frame that have not yet been copied into
+     * the client-side buffer. This array contains room for one element per
+     * slot.
      */
-    unsigned int active_workers;
+    guac_display_tile_cache_store* stores;
 
     /**
-     * Whether least one pending frame has been deferred due to the encoding
-     * process being underway for a previous frame at the time it was
-     * completed.
-     *
-     * IMPORTANT: This member must only be accessed or modified while the ops
-     * FIFO is locked.
+     * The number of elements within the stores array.
      */
-    int frame_deferred;
+    int store_count;
 
     /**
-     * The current state of the rendering process. Code that needs to be aware
-     * of whether a frame is currently in the process of being rendered can
-     * monitor the state of this flag, watching for either the
-     * GUAC_DISPLAY_RENDER_STATE_FRAME_IN_PROGRESS or
-     * GUAC_DISPLAY_RENDER_STATE_FRAME_NOT_IN_PROGRESS values.
+     * The total number of draw operations replaced with copies from the
+     * cache.
      */
-    guac_flag render_state;
+    uint64_t hits;
 
-};
+    /**
+     * The total number of draw operations that were eligible to be replaced
+     * by copies from the cache but for which no matching tile was cached.
+     */
+    uint64_t misses;
+
+    /**
+     * The total number of tiles stored within the cache.
+     */
+    uint64_t stores_total;
+
+    /**
+     * The total number of tiles evicted from the cache to make room for
+     * other tiles.
+     */
+    uint64_t evictions;
+
+} guac_display_tile_cache;
 
 /**
- * Allocates and inserts a new element into the given linked list of display
- * layers, associating it with the given layer and surface.
- *
- * @param head
- *     A pointer to the head pointer of the list of layers. The head pointer
- *     will be updated by this function to point to the newly-allocated
- *     display layer.
- *
- * @param layer
- *     The Guacamole layer to associated with the new display layer.
- *
- * @param opaque
- *     Non-zero if the new layer will only ever contain opaque image contents
- *     (the alpha channel should be ignored), zero otherwise.
- *
- * @return
- *     The newly-allocated display layer, which has been associated with the
- *     provided layer and surface.
+ * The number of image formats tracked by the encoder cost model.
  */
-guac_display_layer* guac_display_add_layer(guac_display* display, guac_layer* layer, int opaque);
+#define GUAC_DISPLAY_FORMATS 3
 
 /**
- * Removes the given layer from all linked lists containing that layer and
- * frees all associated memory.
- *
- * @param display_layer
- *     The layer to remove.
+ * The number of classes of image content tracked by the encoder cost model.
  */
-void guac_display_remove_layer(guac_display_layer* display_layer);
+#define GUAC_DISPLAY_REGION_CLASSES 3
 
 /**
- * Resizes the given layer to the given dimensions, including any underlying
- * image buffers.
- *
- * @param layer
- *     The layer to resize.
- *
- * @param width
- *     The new width, in pixels.
- *
- * @param height
- *     The new height, in pixels.
+ * The minimum number of measurements of a particular image format for a
+ * particular class of content before the encoder cost model will rely on
+ * those measurements. Until all candidate formats have been measured this
+ * many times, the static heuristics are used instead.
  */
-void PFW_guac_display_layer_resize(guac_display_layer* layer,
-        int width, int height);
+#define GUAC_DISPLAY_COST_MIN_SAMPLES 4
 
 /**
- * Worker thread that continuously pulls operations from the operation FIFO of
- * the given guac_display, applying those operations by seding corresponding
- * instructions to connected clients.
- *
- * @param data
- *     A pointer to the guac_display.
- *
- * @return
- *     Always NULL.
+ * The number of decisions made using the static heuristics (due to a lack of
+ * measurements) between each decision that instead uses an unmeasured format
+ * to measure it.
  */
-void* guac_display_worker_thread(void* data);
+#define GUAC_DISPLAY_COST_EXPLORE_INTERVAL 16
+
+/**
+ * The weight of the existing value of each moving average maintained by the
+ * encoder cost model, relative to a weight of 1 for each new measurement.
+ */
+#define GUAC_DISPLAY_COST_SMOOTHING 7
+
+/**
+ * The maximum amount of time that may be budgeted for sending any single
+ * update, in milliseconds, regardless of how infrequently the region of that
+ * update changes.
+ */
+#define GUAC_DISPLAY_COST_MAX_BUDGET 1000
+
+/**
+ * The amount of time over which bytes sent are totalled to produce each
+ * measurement of client bandwidth, in milliseconds.
+ */
+#define GUAC_DISPLAY_COST_BANDWIDTH_WINDOW 1000
+
+/**
+ * The processing lag, in milliseconds, above which the connection to the
+ * client is considered saturated, such that the rate at which data is being
+ * sent reflects the bandwidth actually available.
+ */
+#define GUAC_DISPLAY_COST_SATURATED_LAG 20
+
+/**
+ * The interval between each logged report of the statistics of the encoder
+ * cost model, in milliseconds.
+ */
+#define GUAC_DISPLAY_COST_REPORT_INTERVAL 10000
+
+/**
+ * The image formats that may be selected by the encoder cost model, in order
+ * of preference if multiple formats are equally suitable.
+ */
+typedef enum guac_display_format {
+
+    /**
+     * Lossless PNG.
+     */
+    GUAC_DISPLAY_FORMAT_PNG = 0,
+
+    /**
+     * Lossy WebP.
+     */
+    GUAC_DISPLAY_FORMAT_WEBP,
+
+    /**
+     * Lossy JPEG.
+     */
+    GUAC_DISPLAY_FORMAT_JPEG
+
+} guac_display_format;
+
+/**
+ * Broad classes of image content, as determined by the amount of repeated
+ * image data within a region. Each image format performs differently
+ * depending on the class of content being encoded.
+ */
+typedef enum guac_display_region_class {
+
+    /**
+     * Content consisting largely of repeated pixels, such as text and user
+     * interface elements, that compresses well losslessly.
+     */
+    GUAC_DISPLAY_REGION_FLAT = 0,
+
+    /**
+     * Content with a moderate amount of repeated pixels.
+     */
+    GUAC_DISPLAY_REGION_MIXED,
+
+    /**
+     * Content with little repetition, such as photographs and video, that
+     * compresses poorly losslessly.
+     */
+    GUAC_DISPLAY_REGION_DETAILED
+
+} guac_display_region_class;
+
+/**
+ * The measured cost of encoding and sending a particular class of content
+ * using a particular image format.
+ */
+typedef struct guac_display_cost_estimate {
+
+    /**
+     * The moving average of the time required to encode and send each pixel,
+     * in microseconds.
+     */
+    double usec_per_pixel;
+
+    /**
+     * The moving average of the number of bytes sent for each pixel.
+     */
+    double bytes_per_pixel;
+
+    /**
+     * The number of measurements that have contributed to the averages.
+     */
+    unsigned int samples;
+
+    /**
+     * The number of times this format has been selected for this class of
+     * content.
+     */
+    uint64_t selected;
+
+} guac_display_cost_estimate;
+
+/**
+ * Windowed estimate of the bandwidth available to one or more users, derived
+ * from the number of bytes sent and the change in processing lag over each
+ * measurement window.
+ */
+typedef struct guac_display_bandwidth {
+
+    /**
+     * The estimated bandwidth available, in bytes per millisecond, or zero if
+     * no estimate is yet available.
+     */
+    double bandwidth;
+
+    /**
+     * The total number of bytes of image data sent since the start of the
+     * current measurement window.
+     */
+    size_t window_bytes;
+
+    /**
+     * The time that the current measurement window started, or zero if no
+     * window has yet started.
+     */
+    guac_timestamp window_start;
+
+    /**
+     * The processing lag at the start of the current measurement window, in
+     * milliseconds.
+     */
+    int window_lag;
+
+} guac_display_bandwidth;
+
+/**
+ * Online model of the cost of sending image data using each available image
+ * format, used to select the format that best fits both the time available
+ * for each update and the bandwidth available to the client.
+ */
+typedef struct guac_display_cost_model {
+
+    /**
+     * The measured cost of each image format for each class of content,
+     * indexed first by guac_display_region_class and then by
+     * guac_display_format.
+     */
+    guac_display_cost_estimate estimates[GUAC_DISPLAY_REGION_CLASSES][GUAC_DISPLAY_FORMATS];
+
+    /**
+     * The estimated bandwidth available to the client as a whole (the
+     * slowest connected user).
+     */
+    guac_display_bandwidth link;
+
+    /**
+     * The total number of pixels of image data within the frame currently
+     * being sent.
+     */
+    size_t frame_pixels;
+
+    /**
+     * The total number of bytes of image data sent so far as part of the
+     * frame currently being sent.
+     */
+    size_t frame_bytes;
+
+    /**
+     * The number of decisions made using the static heuristics due to a lack
+     * of measurements.
+     */
+    uint64_t heuristic;
+
+    /**
+     * The number of decisions that selected a format purely to measure that
+     * format.
+     */
+    uint64_t explored;
+
+    /**
+     * The number of decisions for which no format was expected to fit within
+     * the time budgeted, such that the least costly format was selected.
+     */
+    uint64_t over_budget;
+
+    /**
+     * The time that the statistics of the model were last logged.
+     */
+    guac_timestamp last_report;
+
+} guac_display_cost_model;
+
+/**
+ * The number of quality tiers that connected users may be divided between.
+ * Lossy image data is encoded separately for each populated tier, at a
+ * quality appropriate for the users within that tier, with tier 0 receiving
+ * the highest quality.
+ */
+#define GUAC_DISPLAY_QUALITY_TIERS 3
+
+/**
+ * The factor by which a user's processing lag and bandwidth must exceed the
+ * thresholds of a better quality tier before that user is moved to that tier.
+ * This prevents users near a threshold from repeatedly moving between tiers.
+ */
+#define GUAC_DISPLAY_TIER_HYSTERESIS 2
+
+/**
+ * The quality tier of a single connected user, along with the measurements
+ * used to select that tier.
+ */
+typedef struct guac_display_viewer {
+
+    /**
+     * The user whose tier is being tracked.
+     */
+    guac_user* user;
+
+    /**
+     * The quality tier that the user currently receives lossy image data
+     * from.
+     */
+    int tier;
+
+    /**
+     * The quality tier that the user will be moved to at the next frame
+     * boundary.
+     */
+    int next_tier;
+
+    /**
+     * The most recently measured processing lag of the user, in
+     * milliseconds.
+     */
+    int lag;
+
+    /**
+     * The estimated bandwidth available to the user.
+     */
+    guac_display_bandwidth link;
+
+    /**
+     * The value of the generation counter of guac_display_tiers when this
+     * user was last seen to be connected.
+     */
+    unsigned int generation;
+
+} guac_display_viewer;
+
+/**
+ * The division of connected users between quality tiers. Tier membership is
+ * recalculated after each frame, but takes effect only at the following frame
+ * boundary, such that every user receives each frame from exactly one tier.
+ */
+typedef struct guac_display_tiers {
+
+    /**
+     * Lock guarding all other members of this structure. This lock may be
+     * acquired while holding the ops FIFO lock or the lock guarding the list
+     * of connected users, but no other lock may be acquired while holding
+     * this lock.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Storage for the array of guac_display_viewer tracking each connected
+     * user.
+     */
+    guac_display_arena_buffer viewers;
+
+    /**
+     * The number of entries currently stored within viewers.
+     */
+    size_t viewer_count;
+
+    /**
+     * Counter incremented each time tier membership is recalculated, used to
+     * detect users that are no longer connected.
+     */
+    unsigned int generation;
+
+    /**
+     * The lossy quality (between 0 and 100) currently used for each tier.
+     */
+    int quality[GUAC_DISPLAY_QUALITY_TIERS];
+
+    /**
+     * The lossy quality that will be used for each tier after the next frame
+     * boundary.
+     */
+    int next_quality[GUAC_DISPLAY_QUALITY_TIERS];
+
+    /**
+     * The number of users currently within each tier.
+     */
+    unsigned int population[GUAC_DISPLAY_QUALITY_TIERS];
+
+    /**
+     * The tier of any user that joined since membership was last calculated.
+     * This is the highest-quality populated tier.
+     */
+    int default_tier;
+
+    /**
+     * The number of bytes of lossy image data sent to each tier as part of
+     * the current frame.
+     */
+    size_t frame_bytes[GUAC_DISPLAY_QUALITY_TIERS];
+
+    /**
+     * The total number of times any user has moved between tiers.
+     */
+    uint64_t moves;
+
+} guac_display_tiers;
+
+/**
+ * The subset of connected users that should receive data written by the
+ * current thread, for use with guac_socket_broadcast_set_filter() and
+ * guac_display_tiers_filter().
+ */
+typedef struct guac_display_tier_filter {
+
+    /**
+     * The guac_display whose quality tiers should be used to filter users.
+     */
+    guac_display* display;
+
+    /**
+     * The tier whose users should receive data.
+     */
+    int tier;
+
+} guac_display_tier_filter;
+
+/**
+ * The state of the mouse cursor, as independently tracked by the render
+ * thread. The mouse cursor state may be reported by
+ * guac_display_render_thread_notify_user_moved_mouse() to avoid unnecessarily
+ * locking the display within instruction handlers (which can otherwise result
+ * in delays in handling critical instructions like "sync").
+ */
+typedef struct guac_display_render_thread_cursor_state {
+
+    /**
+     * The user that moved or clicked the mouse.
+     *
+     * NOTE: This user is NOT guaranteed to still exist in memory. This may be
+     * a dangling pointer and must be validated before deferencing.
+     */
+    guac_user* user;
+
+    /**
+     * The X coordinate of the mouse cursor.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the mouse cursor.
+     */
+    int y;
+
+    /**
+     * The mask representing the states of all mouse buttons.
+     */
+    int mask;
+
+} guac_display_render_thread_cursor_state;
+
+struct guac_display_render_thread {
+
+    /**
+     * The display this render thread should render to.
+     */
+    guac_display* display;
+
+    /**
+     * The actual underlying POSIX thread.
+     */
+    pthread_t thread;
+
+    /**
+     * Flag representing render state. This flag is used to store whether the
+     * render thread is stopping and whether the current frame has been
+     * modified or is ready.
+     *
+     * @see GUAC_DISPLAY_RENDER_THREAD_STATE_STOPPING
+     * @see GUAC_DISPLAY_RENDER_THREAD_FRAME_MODIFIED
+     * @see GUAC_DISPLAY_RENDER_THREAD_FRAME_READY
+     */
+    guac_flag state;
+
+    /**
+     * The current mouse cursor state, as reported by
+     * guac_display_render_thread_notify_user_moved_mouse().
+     */
+    guac_display_render_thread_cursor_state cursor_state;
+
+    /**
+     * The number of frames that have been explicitly marked as ready since the
+     * last frame sent. This will be zero if explicit frame boundaries are not
+     * currently being used.
+     */
+    unsigned int frames;
+
+};
+
+/**
+ * Approximation of how often a region of a layer is modified, as well as what
+ * changes have been made to that region since the last frame. This information
+ * is used to help advise future optimizations, such as whether lossy
+ * compression is appropriate and whether parts of the layer can be copied from
+ * other regions rather than resend image data.
+ */
+typedef struct guac_display_layer_cell {
+
+    /**
+     * The last time this particular cell was part of a frame (used to
+     * calculate framerate).
+     */
+    guac_timestamp last_frame;
+
+    /**
+     * The region of this cell that has been modified since the last frame was
+     * flushed. If the cell has not been modified at all, this will be an empty
+     * rect.
+     */
+    guac_rect dirty;
+
+    /**
+     * The rough number of pixels in the dirty rect that have been modified. If
+     * the cell has not been modified at all, this will be zero.
+     */
+    size_t dirty_size;
+
+    /**
+     * The display plan operation that is associated with this cell. If a
+     * display plan is not currently being created or optimized, this will be
+     * NULL.
+     */
+    guac_display_plan_operation* related_op;
+
+    /**
+     * Whether the contents of this cell were last sent to connected clients
+     * using lossy compression, and thus should eventually be re-sent
+     * losslessly once the cell has stopped changing.
+     */
+    int lossy;
+
+} guac_display_layer_cell;
+
+/**
+ * A report from a worker thread describing how a region of image data was
+ * encoded, allowing the lossy flag of each affected cell to be updated when
+ * the next frame is planned.
+ */
+typedef struct guac_display_encoding_report {
+
+    /**
+     * The layer that received the image data.
+     */
+    guac_display_layer* layer;
+
+    /**
+     * The region of the layer that received the image data.
+     */
+    guac_rect rect;
+
+    /**
+     * Non-zero if the image data was encoded using lossy compression, zero
+     * otherwise.
+     */
+    int lossy;
+
+} guac_display_encoding_report;
+
+/**
+ * The state of a Guacamole layer or buffer at some point in time. Within
+ * guac_display_layer, copies of this structure are used to represent the
+ * previous frame and the current, in-progress frame. The previous and
+ * in-progress frames are compared during flush to determine what graphical
+ * operations need to be sent to connected clients to efficiently transform the
+ * remote display from its previous state to the now-current state.
+ *
+ * IMPORTANT: The lock of the corresponding guac_display_state must be acquired
+ * before reading or modifying the values of any member of this structure.
+ */
+typedef struct guac_display_layer_state {
+
+    /**
+     * The width of this layer in pixels.
+     */
+    int width;
+
+    /**
+     * The height of this layer in pixels.
+     */
+    int height;
+
+    /**
+     * The layer which contains this layer. This is only applicable to visible
+     * (non-buffer) layers which are not the default layer.
+     */
+    const guac_layer* parent;
+
+    /**
+     * The X coordinate of the upper-left corner of this layer, in pixels,
+     * relative to its parent layer. This is only applicable to visible
+     * (non-buffer) layers which are not the default layer.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the upper-left corner of this layer, in pixels,
+     * relative to its parent layer. This is only applicable to visible
+     * (non-buffer) layers which are not the default layer.
+     */
+    int y;
+
+    /**
+     * The Z-order of this layer, relative to sibling layers. This is only
+     * applicable to visible (non-buffer) layers which are not the default
+     * layer.
+     */
+    int z;
+
+    /**
+     * The level of opacity applied to this layer. Fully opaque is 255, while
+     * fully transparent is 0. This is only applicable to visible (non-buffer)
+     * layers which are not the default layer.
+     */
+    int opacity;
+
+    /**
+     * The number of simultaneous touches that this surface can accept, where 0
+     * indicates that the surface does not support touch events at all.
+     */
+    int touches;
+
+    /**
+     * Non-zero if all graphical updates for this surface should use lossless
+     * compression, 0 otherwise. By default, newly-created surfaces will use
+     * lossy compression when heuristics determine it is appropriate.
+     */
+    int lossless;
+
+    /**
+     * The raw, 32-bit buffer of ARGB image data. If the layer was allocated as
+     * opaque, the alpha channel of each ARGB pixel will not be considered when
+     * compositing or when encoding images.
+     *
+     * So that large regions of image data can be easily compared, a consistent
+     * value for the alpha channel SHOULD be provided so that each 32-bit pixel
+     * can be compared without having to separately masking the channel.
+     * Optimizations within guac_display, including scroll detection, may
+     * assume that the alpha channel can always be considered when comparing
+     * pixel values for equivalence.
+     */
+    unsigned char* buffer;
+
+    /**
+     * The width of the image data, in pixels. This is not necessarily the same
+     * as the width of the layer.
+     */
+    int buffer_width;
+
+    /**
+     * The height of the image data, in pixels. This is not necessarily the
+     * same as the height of the layer.
+     */
+    int buffer_height;
+
+    /**
+     * The number of bytes in each row of image data. This is not necessarily
+     * equivalent to 4 * width.
+     */
+    size_t buffer_stride;
+
+    /**
+     * Non-zero if the image data referenced by the buffer pointer was
+     * allocated externally and should not be automatically freed or managed by
+     * guac_display, zero otherwise.
+     */
+    int buffer_is_external;
+
+    /**
+     * The approximate rectangular region containing all pixels within this
+     * layer that have been modified since the frame that occurred before this
+     * frame. If the layer was not modified, this will be an empty rect (zero
+     * width or zero height).
+     */
+    guac_rect dirty;
+
+    /**
+     * Whether this layer should be searched for possible scroll/copy
+     * optimizations.
+     */
+    int search_for_copies;
+
+    /* ---------------- LAYER LIST POINTERS ---------------- */
+
+    /**
+     * The layer immediately prior to this layer within the list containing
+     * this layer, or NULL if this is the first layer/buffer in the list.
+     */
+    guac_display_layer* prev;
+
+    /**
+     * The layer immediately following this layer within the list containing
+     * this layer, or NULL if this is the last layer/buffer in the list.
+     */
+    guac_display_layer* next;
+
+} guac_display_layer_state;
+
+struct guac_display_layer {
+
+    /**
+     * The guac_display instance that allocated this layer/buffer.
+     */
+    guac_display* display;
+
+    /**
+     * The Guacamole layer (or buffer) that this guac_display_layer will draw
+     * to when flushing a frame.
+     *
+     * NOTE: This value is set only during allocation and may safely be
+     * accessed without acquiring the overall layer lock.
+     */
+    const guac_layer* layer;
+
+    /**
+     * Whether the graphical data that will be written to this layer/buffer
+     * will only ever be opaque (no alpha channel). Compositing of graphical
+     * updates can be faster when no alpha channel need be considered.
+     */
+    int opaque;
+
+    /* ---------------- LAYER PREVIOUS FRAME STATE ---------------- */
+
+    /**
+     * The state of this layer when the last frame was flushed to connected clients.
+     *
+     * IMPORTANT: The display-level last_frame.lock MUST be acquired before
+     * modifying or reading this member.
+     */
+    guac_display_layer_state last_frame;
+
+    /**
+     * Off-screen buffer storing the contents of the previously-rendered frame
+     * for later use. If graphical updates are recognized as reusing data from
+     * a previous frame, that data will be copied from this buffer. Doing this
+     * simplifies the copy operation (there is no longer any need to perform
+     * those copies in a specific order) and ensures the copies are efficient
+     * on the client side (copying from one part of a graphical surface to
+     * another part of the same surface can be inefficient, particularly if the
+     * regions overlap). In practice, there is ample time between frames for
+     * the client to copy a layer's current contents to an off-screen buffer
+     * while awaiting the next frame.
+     *
+     * NOTE: This value is set only during allocation and may safely be
+     * accessed without acquiring the display-level last_frame.lock.
+     */
+    guac_layer* last_frame_buffer;
+
+    /* ---------------- LAYER PENDING FRAME STATE ---------------- */
+
+    /**
+     * The upcoming state of this layer when the current, in-progress frame is
+     * flushed to connected clients.
+     *
+     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
+     * modifying or reading this member.
+     */
+    guac_display_layer_state pending_frame;
+
+    /**
+     * The Cairo context and surface containing the graphical data of the
+     * pending frame. The actual underlying buffer and details of the graphical
+     * surface are also available via pending_frame_raw_context.
+     *
+     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
+     * modifying or reading this member.
+     */
+    guac_display_layer_cairo_context pending_frame_cairo_context;
+
+    /**
+     * The raw underlying buffer and details of the surface containing the
+     * graphical data of the pending frame. A Cairo context and surface backed
+     * by this buffer are also available via pending_frame_cairo_context.
+     *
+     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
+     * modifying or reading this member.
+     */
+    guac_display_layer_raw_context pending_frame_raw_context;
+
+    /**
+     * A two-dimensional array of square tiles representing the nature of
+     * changes made to corresponding regions of the display. This is used both
+     * to track how frequently certain regions are being updated (to help
+     * inform whether lossy compression is appropriate), to track what parts of
+     * the frame have actually changed, and to aid in determining whether
+     * adjacent updated regions should be combined into a single update.
+     *
+     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
+     * modifying or reading this member.
+     */
+    guac_display_layer_cell* pending_frame_cells;
+
+    /**
+     * The width of the pending_frame_cells array, in cells.
+     *
+     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
+     * modifying or reading this member.
+     */
+    size_t pending_frame_cells_width;
+
+    /**
+     * The height of the pending_frame_cells array, in cells.
+     *
+     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
+     * modifying or reading this member.
+     */
+    size_t pending_frame_cells_height;
+
+    /**
+     * The region of this layer that was last sent only as a low-quality
+     * preview, the full-quality refinement of which was abandoned in favor of
+     * a newer frame. This region is redrawn in its entirety as part of the
+     * next frame planned, regardless of whether its contents have changed.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO of the display is locked.
+     */
+    guac_rect unrefined;
+
+};
+
+typedef struct guac_display_state {
+
+    /**
+     * Lock that guards concurrent access to any member of ANY STRUCTURE that
+     * relates to this guac_display_state, including the members of this
+     * structure. Unless explicitly documented otherwise, this lock MUST be
+     * acquired before accessing or modifying the members of this
+     * guac_display_state or any nested structure.
+     */
+    guac_rwlock lock;
+
+    /**
+     * The specific point in time that this guac_display_state represents.
+     */
+    guac_timestamp timestamp;
+
+    /**
+     * All layers and buffers that were part of the display at the time that
+     * the frame/snapshot represented by this guac_display_state was updated.
+     * 
+     * NOTE: For each guac_display, there are two distinct lists of layers: the
+     * last frame layer list and the pending frame layer list:
+     *
+     * LAST FRAME LAYER LIST
+     *
+     *  - HEAD: display->last_frame.layers
+     *  - NEXT: layer->last_frame.next
+     *  - PREV: layer->last_frame.prev
+     *
+     * PENDING LAYER LIST
+     *
+     *  - HEAD: display->pending_frame.layers
+     *  - NEXT: layer->pending_frame.next
+     *  - PREV: layer->pending_frame.prev
+     *
+     * Existing layers are deleted only at the time a frame is flushed when a
+     * layer in the last frame layer list is found to no longer exist in the
+     * pending frame layer list. The same goes for the addition of new layers:
+     * they are added only during flush when a layer that was not present in
+     * the last frame layer list is found to be present in the pending frame
+     * layer list.
+     */
+    guac_display_layer* layers;
+
+    /**
+     * The X coordinate of the hotspot of the mouse cursor. The cursor image is
+     * stored/updated via the cursor_buffer member of guac_display.
+     */
+    int cursor_hotspot_x;
+
+    /**
+     * The Y coordinate of the hotspot of the mouse cursor. The cursor image is
+     * stored/updated via the cursor_buffer member of guac_display.
+     */
+    int cursor_hotspot_y;
+
+    /**
+     * The user that moved or clicked the mouse. This is used to ensure we
+     * don't attempt to synchronize an out-of-date mouse position to the user
+     * that is actively moving the mouse.
+     *
+     * NOTE: This user is NOT guaranteed to still exist in memory. This may be
+     * a dangling pointer and must be validated before deferencing.
+     */
+    guac_user* cursor_user;
+
+    /**
+     * The X coordinate of the mouse cursor.
+     */
+    int cursor_x;
+
+    /**
+     * The Y coordinate of the mouse cursor.
+     */
+    int cursor_y;
+
+    /**
+     * The mask representing the states of all mouse buttons.
+     */
+    int cursor_mask;
+
+    /**
+     * The number of logical frames that have been rendered to this display
+     * state since the previous display state.
+     */
+    unsigned int frames;
+
+} guac_display_state;
+
+struct guac_display {
+
+    /* NOTE: Any member of this structure that requires protection against
+     * concurrent access is protected by its own lock. The overall display does
+     * not have nor need a top-level lock. */
+
+    /**
+     * The client associated with this display.
+     */
+    guac_client* client;
+
+    /* ---------------- DISPLAY FRAME STATES ---------------- */
+
+    /**
+     * The state of this display at the time the last frame was sent to
+     * connected users.
+     */
+    guac_display_state last_frame;
+
+    /**
+     * The pending state of this display that will become the next frame once
+     * it is sent to connected users.
+     */
+    guac_display_state pending_frame;
+
+    /**
+     * Whether the pending frame has been modified in any way outside of
+     * changing the mouse cursor or moving the mouse. This is used to help
+     * inform whether a frame should be flushed to update connected clients
+     * with respect to mouse cursor changes, or whether those changes can be
+     * safely assumed to be part of a larger frame containing general graphical
+     * updates.
+     *
+     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
+     * modifying or reading this member.
+     */
+    int pending_frame_dirty_excluding_mouse;
+
+    /**
+     * Whether the frame currently being planned is a lossless refresh, in
+     * which cells last sent using lossy compression that have remained
+     * unchanged for at least GUAC_DISPLAY_LOSSLESS_REFRESH_DELAY milliseconds
+     * are re-sent losslessly.
+     *
+     * IMPORTANT: The display-level pending_frame.lock MUST be acquired before
+     * modifying or reading this member.
+     */
+    int lossless_refresh;
+
+    /* ---------------- WELL-KNOWN LAYERS / BUFFERS ---------------- */
+
+    /**
+     * The default layer of the client display.
+     */
+    guac_display_layer* default_layer;
+
+    /**
+     * The buffer storing the current mouse cursor. The hotspot position within
+     * the cursor is stored within cursor_hotspot_x and cursor_hotspot_y of
+     * guac_display_state.
+     */
+    guac_display_layer* cursor_buffer;
+
+    /* ---------------- TILE CACHE ---------------- */
+
+    /**
+     * Client-side cache of recently-sent tiles of image data. The
+     * last_frame.lock MUST be acquired before accessing this cache, and MUST
+     * be acquired for writing before modifying the cache.
+     */
+    guac_display_tile_cache tile_cache;
+
+    /* ---------------- ENCODER COST MODEL ---------------- */
+
+    /**
+     * The measured cost of each image format, used by the worker threads to
+     * select the format of each image sent.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    guac_display_cost_model cost_model;
+
+    /* ---------------- QUALITY TIERS ---------------- */
+
+    /**
+     * The division of connected users between quality tiers, each of which
+     * receives lossy image data encoded at its own quality. This member is
+     * guarded by its own lock.
+     */
+    guac_display_tiers tiers;
+
+    /* ---------------- FRAME ARENA ---------------- */
+
+    /**
+     * Storage used while planning each frame that is recycled between frames.
+     * The pending_frame.lock MUST be acquired for writing before accessing
+     * this arena, except as noted within guac_display_arena.
+     */
+    guac_display_arena arena;
+
+    /* ---------------- PIXEL KERNELS ---------------- */
+
+    /**
+     * The implementations of the pixel-level loops used when building each
+     * guac_display_plan, as selected for the current processor when the
+     * display was allocated.
+     *
+     * NOTE: This value is set only during allocation and may safely be
+     * accessed without acquiring any lock.
+     */
+    const guac_display_kernels* kernels;
+
+    /* ---------------- FRAME ENCODING WORKER THREADS ---------------- */
+
+    /**
+     * The number of worker threads in the worker_threads array.
+     */
+    int worker_thread_count;
+
+    /**
+     * Pool of worker threads that automatically pull from the ops FIFO,
+     * sending corresponding Guacamole instructions to all connected clients.
+     */
+    pthread_t* worker_threads;
+
+    /**
+     * FIFO of all graphical operations required to transform the remote
+     * display state from the previous frame to the next frame. Operations
+     * added to this FIFO will automatically be pulled and processed by a
+     * worker thread.
+     */
+    guac_fifo ops;
+
+    /**
+     * Storage for any items within the ops fifo.
+     */
+    guac_display_plan_operation ops_items[GUAC_DISPLAY_WORKER_FIFO_SIZE];
+
+    /**
+     * The bands of work currently being performed by the worker threads on
+     * behalf of the thread planning the next frame, if any.
+     */
+    guac_display_bands bands;
+
+    /**
+     * Snapshots of the last frame that are waiting to be sent to joining
+     * users.
+     */
+    guac_display_snapshots snapshots;
+
+    /**
+     * The current number of active worker threads.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    unsigned int active_workers;
+
+    /**
+     * Whether least one pending frame has been deferred due to the encoding
+     * process being underway for a previous frame at the time it was
+     * completed.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    int frame_deferred;
+
+    /**
+     * Storage for the GUAC_DISPLAY_PLAN_OPERATION_REFINE operations that
+     * should follow the current frame, one for each low-quality preview sent
+     * as part of that frame.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    guac_display_arena_buffer refinements;
+
+    /**
+     * The number of operations currently stored within refinements.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    size_t refinement_count;
+
+    /**
+     * Whether the operations currently being processed by the worker threads
+     * are refinements of the previous frame, rather than a new frame.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    int refining;
+
+    /**
+     * Storage for the reports of how each image was encoded by the worker
+     * threads since the last frame was planned.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    guac_display_arena_buffer encoding_reports;
+
+    /**
+     * The number of reports currently stored within encoding_reports.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    size_t encoding_report_count;
+
+    /**
+     * The number of cells that were last sent using lossy compression, as of
+     * the last frame planned. The worker threads will periodically attempt a
+     * lossless refresh while idle if this value is non-zero.
+     *
+     * IMPORTANT: This member must only be accessed or modified while the ops
+     * FIFO is locked.
+     */
+    size_t lossy_cells;
+
+    /**
+     * The current state of the rendering process. Code that needs to be aware
+     * of whether a frame is currently in the process of being rendered can
+     * monitor the state of this flag, watching for either the
+     * GUAC_DISPLAY_RENDER_STATE_FRAME_IN_PROGRESS or
+     * GUAC_DISPLAY_RENDER_STATE_FRAME_NOT_IN_PROGRESS values.
+     */
+    guac_flag render_state;
+
+};
+
+/**
+ * Allocates and inserts a new element into the given linked list of display
+ * layers, associating it with the given layer and surface.
+ *
+ * @param head
+ *     A pointer to the head pointer of the list of layers. The head pointer
+ *     will be updated by this function to point to the newly-allocated
+ *     display layer.
+ *
+ * @param layer
+ *     The Guacamole layer to associated with the new display layer.
+ *
+ * @param opaque
+ *     Non-zero if the new layer will only ever contain opaque image contents
+ *     (the alpha channel should be ignored), zero otherwise.
+ *
+ * @return
+ *     The newly-allocated display layer, which has been associated with the
+ *     provided layer and surface.
+ */
+guac_display_layer* guac_display_add_layer(guac_display* display, guac_layer* layer, int opaque);
+
+/**
+ * Removes the given layer from all linked lists containing that layer and
+ * frees all associated memory.
+ *
+ * @param display_layer
+ *     The layer to remove.
+ */
+void guac_display_remove_layer(guac_display_layer* display_layer);
+
+/**
+ * Resizes the given layer to the given dimensions, including any underlying
+ * image buffers.
+ *
+ * @param layer
+ *     The layer to resize.
+ *
+ * @param width
+ *     The new width, in pixels.
+ *
+ * @param height
+ *     The new height, in pixels.
+ */
+void PFW_guac_display_layer_resize(guac_display_layer* layer,
+        int width, int height);
+
+/**
+ * Worker thread that continuously pulls operations from the operation FIFO of
+ * the given guac_display, applying those operations by seding corresponding
+ * instructions to connected clients.
+ *
+ * @param data
+ *     A pointer to the guac_display.
+ *
+ * @return
+ *     Always NULL.
+ */
+void* guac_display_worker_thread(void* data);
+
+/**
+ * Ensures the given buffer of a guac_display_arena can store at least the
+ * given number of elements of the given size, growing the buffer if
+ * necessary. The existing contents of the buffer are preserved if the buffer
+ * is grown, and any storage added by growing the buffer is zeroed. The buffer
+ * is grown geometrically such that repeated growth is amortized.
+ *
+ * @param buffer
+ *     The buffer to grow, if necessary.
+ *
+ * @param count
+ *     The number of elements that the buffer must be able to store.
+ *
+ * @param size
+ *     The size of each element, in bytes.
+ *
+ * @return
+ *     A pointer to the storage of the buffer, which is at least large enough
+ *     to store the requested number of elements.
+ */
+void* guac_display_arena_reserve(guac_display_arena_buffer* buffer,
+        size_t count, size_t size);
+
+/**
+ * Returns the total number of allocations performed by all buffers within the
+ * given arena since the last call to guac_display_arena_reset_count().
+ *
+ * @param arena
+ *     The arena to query.
+ *
+ * @return
+ *     The total number of allocations performed by the given arena.
+ */
+unsigned int guac_display_arena_count(guac_display_arena* arena);
+
+/**
+ * Resets the allocation counts of all buffers within the given arena to zero.
+ *
+ * @param arena
+ *     The arena whose allocation counts should be reset.
+ */
+void guac_display_arena_reset_count(guac_display_arena* arena);
+
+/**
+ * Frees all storage associated with the given arena. The arena itself is not
+ * freed, but is left in a state where it may be safely reused.
+ *
+ * @param arena
+ *     The arena whose storage should be freed.
+ */
+void guac_display_arena_free(guac_display_arena* arena);
+
+/**
+ * Prepares the tile cache for use by a new frame, allocating the cache if
+ * necessary. Tiles stored by previous frames become available for use by the
+ * new frame.
+ *
+ * IMPORTANT: The calling thread must already hold the write lock for the
+ * display's last_frame.lock.
+ *
+ * @param display
+ *     The guac_display whose tile cache should be prepared.
+ *
+ * @return
+ *     Non-zero if the tile cache is allocated and may be used, zero if the
+ *     cache is disabled.
+ */
+int LFW_guac_display_tile_cache_begin_frame(guac_display* display);
+
+/**
+ * Searches the tile cache for a 64x64 tile of image data that has been sent
+ * by a previous frame and is identical to the given tile. The image data of
+ * each candidate tile is verified, such that tiles that merely share the
+ * same hash are never matched. If found, the tile is marked as used by the
+ * current frame and moved to the most recently used position of the cache.
+ *
+ * IMPORTANT: The calling thread must already hold the write lock for the
+ * display's last_frame.lock.
+ *
+ * @param cache
+ *     The tile cache to search.
+ *
+ * @param hash
+ *     The hash of the image data within the tile.
+ *
+ * @param data
+ *     A pointer to the first byte of the tile.
+ *
+ * @param stride
+ *     The number of bytes in each row of the tile.
+ *
+ * @param pending
+ *     Pointer to an int that should receive a non-zero value if an identical
+ *     tile was stored by the current frame (and thus cannot yet be used), or
+ *     zero otherwise.
+ *
+ * @return
+ *     The slot containing the identical tile, or -1 if no usable identical
+ *     tile is present in the cache.
+ */
+int LFW_guac_display_tile_cache_lookup(guac_display_tile_cache* cache,
+        uint64_t hash, const unsigned char* data, size_t stride, int* pending);
+
+/**
+ * Stores the given 64x64 tile of image data within the least recently used
+ * slot of the tile cache, scheduling that tile to be copied into the
+ * client-side cache buffer once the current frame has been sent. If all slots
+ * are in use by the current frame, the tile is not stored.
+ *
+ * IMPORTANT: The calling thread must already hold the write lock for the
+ * display's last_frame.lock.
+ *
+ * @param cache
+ *     The tile cache to store the tile within.
+ *
+ * @param layer
+ *     The layer containing the tile, from which the client-side copy of the
+ *     tile will be made.
+ *
+ * @param cell
+ *     The bounds of the tile within the layer.
+ *
+ * @param hash
+ *     The hash of the image data within the tile.
+ *
+ * @param data
+ *     A pointer to the first byte of the tile.
+ *
+ * @param stride
+ *     The number of bytes in each row of the tile.
+ *
+ * @return
+ *     The slot that the tile was stored within, or -1 if all slots are in
+ *     use by the current frame.
+ */
+int LFW_guac_display_tile_cache_store(guac_display_tile_cache* cache,
+        guac_display_layer* layer, const guac_rect* cell, uint64_t hash,
+        const unsigned char* data, size_t stride);
+
+/**
+ * Sends the tiles stored within the tile cache by the current frame to the
+ * client-side cache buffer. This function must be invoked only after all
+ * graphical updates of the current frame have been sent.
+ *
+ * IMPORTANT: The calling thread must already hold the read lock for the
+ * display's last_frame.lock, and must be the thread completing the current
+ * frame.
+ *
+ * @param display
+ *     The guac_display whose tile cache should be updated.
+ */
+void LFR_guac_display_tile_cache_flush(guac_display* display);
+
+/**
+ * Removes any tiles stored within the tile cache by the current frame that
+ * have not yet been copied from the given layer, as that layer is being
+ * removed from the display.
+ *
+ * IMPORTANT: The calling thread must already hold the write lock for the
+ * display's last_frame.lock.
+ *
+ * @param display
+ *     The guac_display whose tile cache should be updated.
+ *
+ * @param layer
+ *     The layer being removed.
+ */
+void LFW_guac_display_tile_cache_forget_layer(guac_display* display,
+        guac_display_layer* layer);
+
+/**
+ * Copies the contents of the client-side cache buffer of the tile cache into
+ * the given snapshot, such that the cache buffer can be synchronized with
+ * joining users later. If the tile cache is not in use, the tile cache image
+ * of the snapshot is set to NULL.
+ *
+ * IMPORTANT: The calling thread must already hold the read lock for the
+ * display's last_frame.lock.
+ *
+ * @param display
+ *     The guac_display whose tile cache should be copied.
+ *
+ * @param snapshot
+ *     The snapshot to copy the tile cache into.
+ */
+void LFR_guac_display_tile_cache_snapshot(guac_display* display,
+        guac_display_snapshot* snapshot);
+
+/**
+ * Thread which encodes and sends each snapshot added to the given display by
+ * guac_display_dup_pending(), in order, until the display is stopped.
+ *
+ * @param data
+ *     A pointer to the guac_display.
+ *
+ * @return
+ *     Always NULL.
+ */
+void* guac_display_snapshot_thread(void* data);
+
+/**
+ * Stops the thread that sends snapshots of the given display, discarding any
+ * snapshots that have not yet been sent and releasing the output of all users
+ * that were waiting for those snapshots.
+ *
+ * @param display
+ *     The guac_display whose snapshot thread should be stopped.
+ */
+void guac_display_snapshots_stop(guac_display* display);
+
+/**
+ * Synchronizes the client-side cache buffer of the tile cache with the given
+ * socket, such as that of a joining user.
+ *
+ * IMPORTANT: The calling thread must already hold the read lock for the
+ * display's last_frame.lock.
+ *
+ * @param display
+ *     The guac_display whose tile cache should be synchronized.
+ *
+ * @param socket
+ *     The socket to send the contents of the tile cache over.
+ */
+void LFR_guac_display_tile_cache_dup(guac_display* display, guac_socket* socket);
+
+/**
+ * Frees all resources associated with the tile cache, both server-side and
+ * client-side, logging the statistics of the cache. The maximum capacity of
+ * the cache is not affected, and the cache will be automatically reallocated
+ * when next needed.
+ *
+ * IMPORTANT: The calling thread must already hold the write lock for the
+ * display's last_frame.lock.
+ *
+ * @param display
+ *     The guac_display whose tile cache should be freed.
+ */
+void LFW_guac_display_tile_cache_free(guac_display* display);
+
+/**
+ * Returns the number of bands that work covering the given number of pixels
+ * should be divided into when performed via guac_display_foreach_band(),
+ * taking into account the number of available worker threads and the
+ * overhead of waking those threads. The returned value will be at least 1 and
+ * will never exceed the given maximum.
+ *
+ * @param display
+ *     The guac_display that the work will be performed for.
+ *
+ * @param pixels
+ *     The approximate number of pixels that the work will process.
+ *
+ * @param max_bands
+ *     The maximum number of bands that the work can be divided into, such as
+ *     the number of rows of cells or the number of operations involved.
+ *
+ * @return
+ *     The number of bands that the work should be divided into.
+ */
+int guac_display_band_count(guac_display* display, size_t pixels, int max_bands);
+
+/**
+ * Invokes the given callback once for each of the given number of bands,
+ * distributing those invocations across the display's worker threads and the
+ * calling thread. This function returns only after all invocations have
+ * completed. If the display has only a single worker thread, or if only a
+ * single band is requested, all invocations are performed by the calling
+ * thread.
+ *
+ * Worker threads performing bands of work act on behalf of the calling thread
+ * and acquire no locks. Any locks required by the callback must already be
+ * held by the calling thread, which MUST be the thread planning the next
+ * frame (holding the pending_frame.lock and last_frame.lock for writing).
+ *
+ * @param display
+ *     The guac_display to perform work for.
+ *
+ * @param count
+ *     The number of bands of work to perform. This value must not exceed
+ *     GUAC_DISPLAY_MAX_BANDS.
+ *
+ * @param callback
+ *     The callback to invoke for each band of work.
+ *
+ * @param data
+ *     Arbitrary data to provide to the callback.
+ */
+void guac_display_foreach_band(guac_display* display, int count,
+        guac_display_band_callback* callback, void* data);
+
+/**
+ * Returns the class of content that best describes image data having the
+ * given PNG optimality, as determined by the heuristics of the display worker
+ * threads.
+ *
+ * @param png_optimality
+ *     The approximate optimality of PNG compression for the image data, where
+ *     positive values indicate PNG is likely to perform well and negative
+ *     values indicate the opposite.
+ *
+ * @return
+ *     The class of content that best describes the image data.
+ */
+guac_display_region_class guac_display_cost_classify(int png_optimality);
+
+/**
+ * Determines the image formats that may be used to send an update to a layer
+ * that does not require lossless encoding, along with the format that the
+ * static heuristics would have selected (WebP where supported, followed by
+ * JPEG, followed by PNG). Lossy formats are only candidates if the static
+ * heuristics would consider lossy compression at all, such that the encoder
+ * cost model only ever chooses between formats those heuristics permit.
+ *
+ * @param lossy
+ *     Non-zero if the region is being updated frequently enough, and with
+ *     content that PNG is unlikely to handle well enough, that lossy
+ *     compression may be used, zero otherwise.
+ *
+ * @param opaque
+ *     Non-zero if the layer being updated is opaque, zero otherwise.
+ *
+ * @param pixels
+ *     The number of pixels within the update.
+ *
+ * @param webp
+ *     Non-zero if all connected users support WebP, zero otherwise.
+ *
+ * @param fallback
+ *     Pointer to the guac_display_format that should receive the format the
+ *     static heuristics would have selected.
+ *
+ * @return
+ *     A bitwise OR of (1 << format) for each guac_display_format that may be
+ *     used for the update. GUAC_DISPLAY_FORMAT_PNG is always included.
+ */
+int guac_display_cost_candidates(int lossy, int opaque, size_t pixels,
+        int webp, guac_display_format* fallback);
+
+/**
+ * Selects the image format that is expected to best fit the time available
+ * for sending an update, based on the measured cost of each candidate
+ * format. If any candidate format has not yet been measured sufficiently for
+ * the given class of content, the given fallback format is selected instead,
+ * except for periodic decisions that select the unmeasured format in order to
+ * measure it.
+ *
+ * IMPORTANT: The ops FIFO of the display must be locked.
+ *
+ * @param display
+ *     The guac_display that the update is being sent for.
+ *
+ * @param region_class
+ *     The class of content within the update.
+ *
+ * @param pixels
+ *     The number of pixels within the update.
+ *
+ * @param framerate
+ *     The rate that the region covered by the update has historically been
+ *     updated, in frames per second.
+ *
+ * @param candidates
+ *     A bitwise OR of (1 << format) for each guac_display_format that may be
+ *     used for the update. GUAC_DISPLAY_FORMAT_PNG must always be included.
+ *
+ * @param fallback
+ *     The format that should be selected if the candidate formats have not
+ *     yet been measured sufficiently, as determined by static heuristics.
+ *
+ * @return
+ *     The image format that should be used for the update.
+ */
+guac_display_format guac_display_cost_select(guac_display* display,
+        guac_display_region_class region_class, size_t pixels, int framerate,
+        int candidates, guac_display_format fallback);
+
+/**
+ * Records a measurement of the cost of sending an update using the given
+ * image format.
+ *
+ * IMPORTANT: The ops FIFO of the display must be locked.
+ *
+ * @param display
+ *     The guac_display that the update was sent for.
+ *
+ * @param format
+ *     The image format used.
+ *
+ * @param region_class
+ *     The class of content within the update.
+ *
+ * @param pixels
+ *     The number of pixels within the update.
+ *
+ * @param usec
+ *     The amount of time required to encode and send the update, in
+ *     microseconds.
+ *
+ * @param bytes
+ *     The number of bytes sent for the update.
+ */
+void guac_display_cost_record(guac_display* display, guac_display_format format,
+        guac_display_region_class region_class, size_t pixels, uint64_t usec,
+        size_t bytes);
+
+/**
+ * Updates the bandwidth estimate of the encoder cost model with the number of
+ * bytes sent as part of a frame that has just been completed, periodically
+ * logging the statistics of the model. The ops FIFO of the display must NOT be
+ * locked, as this function will acquire that lock itself.
+ *
+ * @param display
+ *     The guac_display whose frame has just been completed.
+ *
+ * @param bytes
+ *     The number of bytes of image data sent as part of the frame.
+ */
+void guac_display_cost_end_frame(guac_display* display, size_t bytes);
+
+/**
+ * Logs the statistics of the encoder cost model at the given log level,
+ * including the measured cost of each format and the number of times each
+ * format has been selected. The ops FIFO of the display must NOT be locked,
+ * as this function will acquire that lock itself.
+ *
+ * @param display
+ *     The guac_display whose statistics should be logged.
+ *
+ * @param level
+ *     The log level to log the statistics at.
+ */
+void guac_display_cost_log(guac_display* display, guac_client_log_level level);
+
+/**
+ * Adds the given number of bytes to the current measurement window of the
+ * given bandwidth estimate, updating that estimate if the window has
+ * completed.
+ *
+ * @param estimate
+ *     The bandwidth estimate to update.
+ *
+ * @param bytes
+ *     The number of bytes sent since the estimate was last updated.
+ *
+ * @param lag
+ *     The current processing lag of the user or users receiving the data, in
+ *     milliseconds.
+ *
+ * @param now
+ *     The current time.
+ *
+ * @return
+ *     Non-zero if a measurement window completed, zero otherwise.
+ */
+int guac_display_bandwidth_update(guac_display_bandwidth* estimate,
+        size_t bytes, int lag, guac_timestamp now);
+
+/**
+ * Returns the current value of a monotonic clock, in microseconds, for the
+ * sake of measuring encoding times.
+ *
+ * @return
+ *     The current value of a monotonic clock, in microseconds.
+ */
+uint64_t guac_display_cost_usec(void);
+
+/**
+ * Discards any pending refinements of low-quality previews that were sent to
+ * the given layer, as that layer is being removed from the display.
+ *
+ * IMPORTANT: The calling thread must already hold the write lock for the
+ * display's last_frame.lock.
+ *
+ * @param display
+ *     The guac_display whose pending refinements should be updated.
+ *
+ * @param layer
+ *     The layer being removed.
+ */
+void LFW_guac_display_forget_refinements(guac_display* display,
+        guac_display_layer* layer);
+
+/**
+ * Records how the given region of the given layer was encoded by a worker
+ * thread, such that the lossy flag of each affected cell can be updated when
+ * the next frame is planned. The ops FIFO of the display must NOT be locked,
+ * as this function will acquire that lock itself.
+ *
+ * @param display
+ *     The guac_display that the image data was sent for.
+ *
+ * @param layer
+ *     The layer that received the image data.
+ *
+ * @param rect
+ *     The region of the layer that received the image data.
+ *
+ * @param lossy
+ *     Non-zero if the image data was encoded using lossy compression, zero
+ *     otherwise.
+ */
+void guac_display_report_encoding(guac_display* display,
+        guac_display_layer* layer, const guac_rect* rect, int lossy);
+
+/**
+ * Updates the lossy flag of each cell affected by the encoding reports
+ * received from the worker threads since the last frame was planned,
+ * discarding those reports.
+ *
+ * IMPORTANT: The calling thread must already hold the write lock for the
+ * display's pending_frame.lock.
+ *
+ * @param display
+ *     The guac_display whose encoding reports should be applied.
+ */
+void PFW_guac_display_apply_encoding_reports(guac_display* display);
+
+/**
+ * Discards any encoding reports for the given layer, as that layer is being
+ * removed from the display.
+ *
+ * IMPORTANT: The calling thread must already hold the write lock for the
+ * display's last_frame.lock.
+ *
+ * @param display
+ *     The guac_display whose encoding reports should be updated.
+ *
+ * @param layer
+ *     The layer being removed.
+ */
+void LFW_guac_display_forget_encoding_reports(guac_display* display,
+        guac_display_layer* layer);
+
+/**
+ * Plans and sends a frame that re-sends losslessly any cells that were last
+ * sent using lossy compression and have since remained unchanged for at least
+ * GUAC_DISPLAY_LOSSLESS_REFRESH_DELAY milliseconds. The refresh is skipped if
+ * any other frame is pending or in progress. No display locks may be held by
+ * the calling thread.
+ *
+ * @param display
+ *     The guac_display to refresh.
+ */
+void guac_display_refresh_lossless(guac_display* display);
+
+/**
+ * Returns an appropriate quality between 0 and 100 for lossy encoding for a
+ * user or users having the given processing lag.
+ *
+ * @param lag
+ *     The processing lag, in milliseconds.
+ *
+ * @return
+ *     A value between 0 and 100 inclusive which seems appropriate for the
+ *     given processing lag.
+ */
+int guac_display_quality_for_lag(int lag);
+
+/**
+ * Initializes the quality tiers of a newly-allocated guac_display.
+ *
+ * @param tiers
+ *     The guac_display_tiers to initialize.
+ */
+void guac_display_tiers_init(guac_display_tiers* tiers);
+
+/**
+ * Frees all storage associated with the given quality tiers, logging their
+ * statistics.
+ *
+ * @param display
+ *     The guac_display whose quality tiers should be freed.
+ */
+void guac_display_tiers_free(guac_display* display);
+
+/**
+ * Returns which quality tiers currently contain users, storing the lossy
+ * quality of each tier in the provided array.
+ *
+ * @param display
+ *     The guac_display whose quality tiers should be checked.
+ *
+ * @param quality
+ *     An array of GUAC_DISPLAY_QUALITY_TIERS integers that should receive the
+ *     current quality of each tier.
+ *
+ * @return
+ *     A bitwise OR of (1 << tier) for each tier that contains at least one
+ *     user, or zero if tier membership has not yet been calculated.
+ */
+int guac_display_tiers_select(guac_display* display, int* quality);
+
+/**
+ * Returns whether the given user is within the tier described by the given
+ * guac_display_tier_filter. This function is a guac_socket_broadcast_filter.
+ *
+ * @param user
+ *     The user to check.
+ *
+ * @param data
+ *     The guac_display_tier_filter describing the tier.
+ *
+ * @return
+ *     Non-zero if the given user is within the tier, zero otherwise.
+ */
+int guac_display_tiers_filter(guac_user* user, void* data);
+
+/**
+ * Records that the given number of bytes of lossy image data were sent to the
+ * given tier as part of the current frame.
+ *
+ * @param display
+ *     The guac_display that sent the image data.
+ *
+ * @param tier
+ *     The tier that received the image data.
+ *
+ * @param bytes
+ *     The number of bytes sent.
+ */
+void guac_display_tiers_record(guac_display* display, int tier, size_t bytes);
+
+/**
+ * Moves users between tiers as previously decided by
+ * guac_display_tiers_end_frame(). This function must be invoked only at a
+ * frame boundary, while no worker thread is sending image data.
+ *
+ * IMPORTANT: The ops FIFO of the display must be locked.
+ *
+ * @param display
+ *     The guac_display whose users should be moved between tiers.
+ *
+ * @param frame_bytes
+ *     An array of GUAC_DISPLAY_QUALITY_TIERS values that should receive the
+ *     number of bytes of lossy image data sent to each tier as part of the
+ *     frame that just ended.
+ */
+void guac_display_tiers_commit(guac_display* display, size_t* frame_bytes);
+
+/**
+ * Updates the measured processing lag and bandwidth of each connected user
+ * following the end of a frame, deciding which tier each user should be
+ * within once the next frame boundary is reached. The ops FIFO of the display
+ * must NOT be locked.
+ *
+ * @param display
+ *     The guac_display whose frame has just ended.
+ *
+ * @param shared_bytes
+ *     The number of bytes of image data sent to all users as part of the
+ *     frame.
+ *
+ * @param frame_bytes
+ *     An array of GUAC_DISPLAY_QUALITY_TIERS values containing the number of
+ *     bytes of lossy image data sent to each tier as part of the frame, as
+ *     provided by guac_display_tiers_commit().
+ */
+void guac_display_tiers_end_frame(guac_display* display, size_t shared_bytes,
+        const size_t* frame_bytes);
 
 #endif
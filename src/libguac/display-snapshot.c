@@ -0,0 +1,526 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "display-priv.h"
+#include "guacamole/client.h"
+#include "guacamole/display.h"
+#include "guacamole/flag.h"
+#include "guacamole/layer.h"
+#include "guacamole/mem.h"
+#include "guacamole/protocol.h"
+#include "guacamole/rect.h"
+#include "guacamole/rwlock.h"
+#include "guacamole/socket.h"
+#include "guacamole/user.h"
+
+#include <cairo/cairo.h>
+#include <pthread.h>
+#include <string.h>
+
+/**
+ * The state of a call to guac_display_dup_pending() that is holding the
+ * output of each pending user.
+ */
+typedef struct guac_display_snapshot_hold {
+
+    /**
+     * The snapshot receiving the sockets returned by guac_socket_queue_hold().
+     */
+    guac_display_snapshot* snapshot;
+
+    /**
+     * Non-zero if the output of at least one pending user could not be held,
+     * zero otherwise.
+     */
+    int failed;
+
+} guac_display_snapshot_hold;
+
+/**
+ * Callback for guac_client_foreach_pending_user() which holds the output of
+ * the given pending user, adding the socket returned by
+ * guac_socket_queue_hold() to the targets of a snapshot.
+ *
+ * @param user
+ *     The pending user whose output should be held.
+ *
+ * @param data
+ *     The guac_display_snapshot_hold tracking the holds acquired thus far.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_display_snapshot_hold_user(guac_user* user, void* data) {
+
+    guac_display_snapshot_hold* hold = (guac_display_snapshot_hold*) data;
+    guac_display_snapshot* snapshot = hold->snapshot;
+
+    if (hold->failed)
+        return NULL;
+
+    guac_socket* target = guac_socket_queue_hold(user->socket);
+    if (target == NULL) {
+        hold->failed = 1;
+        return NULL;
+    }
+
+    snapshot->targets = guac_mem_realloc(snapshot->targets,
+            snapshot->target_count + 1, sizeof(guac_socket*));
+    snapshot->targets[snapshot->target_count++] = target;
+
+    return NULL;
+
+}
+
+/**
+ * Frees the given snapshot, releasing the held output of all users that were
+ * to receive that snapshot.
+ *
+ * @param snapshot
+ *     The snapshot to free.
+ */
+static void guac_display_snapshot_free(guac_display_snapshot* snapshot) {
+
+    for (int i = 0; i < snapshot->target_count; i++) {
+        if (snapshot->targets[i] != NULL)
+            guac_socket_free(snapshot->targets[i]);
+    }
+
+    for (int i = 0; i < snapshot->layer_count; i++)
+        guac_mem_free(snapshot->layers[i].buffer);
+
+    guac_mem_free(snapshot->tile_cache_image);
+    guac_mem_free(snapshot->layers);
+    guac_mem_free(snapshot->targets);
+    guac_mem_free(snapshot);
+
+}
+
+/**
+ * Copies the state of the last frame of the given display into the given
+ * snapshot.
+ *
+ * IMPORTANT: The calling thread must already hold the read lock for the
+ * display's last_frame.lock, and no frame may be in progress.
+ *
+ * @param display
+ *     The guac_display to copy.
+ *
+ * @param snapshot
+ *     The snapshot that should receive the copy.
+ */
+static void LFR_guac_display_snapshot_copy(guac_display* display,
+        guac_display_snapshot* snapshot) {
+
+    guac_client* client = display->client;
+
+    int layer_count = 0;
+    for (guac_display_layer* current = display->last_frame.layers;
+            current != NULL; current = current->last_frame.next)
+        layer_count++;
+
+    snapshot->layers = guac_mem_zalloc(layer_count,
+            sizeof(guac_display_snapshot_layer));
+    snapshot->layer_count = layer_count;
+
+    guac_display_snapshot_layer* layer = snapshot->layers;
+    for (guac_display_layer* current = display->last_frame.layers;
+            current != NULL; current = current->last_frame.next) {
+
+        /* As in guac_display_dup(), the pending_frame lock must not be
+         * acquired here */
+        guac_rect layer_bounds;
+        guac_rect_init(&layer_bounds, 0, 0,
+                current->last_frame.width, current->last_frame.height);
+
+        layer->layer = *current->layer;
+        layer->last_frame_buffer = *current->last_frame_buffer;
+        layer->opaque = current->opaque;
+        layer->width = guac_rect_width(&layer_bounds);
+        layer->height = guac_rect_height(&layer_bounds);
+
+        /* Copy only the rows of the layer that are actually within bounds,
+         * and only as many bytes of each row as the layer is wide */
+        if (layer->width > 0 && layer->height > 0) {
+
+            size_t stride = (size_t) layer->width * GUAC_DISPLAY_LAYER_RAW_BPP;
+            layer->buffer = guac_mem_alloc(stride, layer->height);
+
+            const unsigned char* row = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(
+                    current->last_frame, layer_bounds);
+
+            for (int y = 0; y < layer->height; y++) {
+                memcpy(layer->buffer + y * stride, row, stride);
+                row += current->last_frame.buffer_stride;
+            }
+
+        }
+
+        layer->parent = (current->last_frame.parent != NULL)
+            ? *current->last_frame.parent : *GUAC_DEFAULT_LAYER;
+        layer->x = current->last_frame.x;
+        layer->y = current->last_frame.y;
+        layer->z = current->last_frame.z;
+        layer->opacity = current->last_frame.opacity;
+        layer->touches = current->last_frame.touches;
+
+        layer++;
+
+    }
+
+    LFR_guac_display_tile_cache_snapshot(display, snapshot);
+
+    guac_display_layer* cursor = display->cursor_buffer;
+    snapshot->cursor = *cursor->layer;
+    snapshot->cursor_width = cursor->last_frame.width;
+    snapshot->cursor_height = cursor->last_frame.height;
+    snapshot->cursor_hotspot_x = display->last_frame.cursor_hotspot_x;
+    snapshot->cursor_hotspot_y = display->last_frame.cursor_hotspot_y;
+    snapshot->cursor_x = display->last_frame.cursor_x;
+    snapshot->cursor_y = display->last_frame.cursor_y;
+    snapshot->cursor_mask = display->last_frame.cursor_mask;
+
+    snapshot->timestamp = client->last_sent_timestamp;
+    snapshot->frames = display->last_frame.frames;
+
+}
+
+/**
+ * Callback function which writes data to every remaining target of a
+ * snapshot. Targets that fail are released immediately such that the
+ * snapshot continues to be sent to all other targets.
+ *
+ * @param socket
+ *     The guac_socket allocated by guac_display_snapshot_send().
+ *
+ * @param buf
+ *     The buffer of data to write.
+ *
+ * @param count
+ *     The number of bytes in the buffer to be written.
+ *
+ * @return
+ *     Always the number of bytes given.
+ */
+static ssize_t guac_display_snapshot_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_display_snapshot* snapshot = (guac_display_snapshot*) socket->data;
+
+    for (int i = 0; i < snapshot->target_count; i++) {
+
+        guac_socket* target = snapshot->targets[i];
+        if (target == NULL)
+            continue;
+
+        if (guac_socket_write(target, buf, count)) {
+            guac_socket_free(target);
+            snapshot->targets[i] = NULL;
+        }
+
+    }
+
+    return count;
+
+}
+
+/**
+ * Callback function which writes an element of binary data to every
+ * remaining target of a snapshot, each framing that element as negotiated
+ * with its own user. Targets that fail are released immediately such that
+ * the snapshot continues to be sent to all other targets.
+ *
+ * @param socket
+ *     The guac_socket allocated by guac_display_snapshot_send().
+ *
+ * @param buf
+ *     The buffer of data to write.
+ *
+ * @param count
+ *     The number of bytes in the buffer to be written.
+ *
+ * @return
+ *     Always the number of bytes given.
+ */
+static ssize_t guac_display_snapshot_write_binary_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_display_snapshot* snapshot = (guac_display_snapshot*) socket->data;
+
+    for (int i = 0; i < snapshot->target_count; i++) {
+
+        guac_socket* target = snapshot->targets[i];
+        if (target == NULL)
+            continue;
+
+        if (guac_socket_write_binary(target, buf, count)) {
+            guac_socket_free(target);
+            snapshot->targets[i] = NULL;
+        }
+
+    }
+
+    return count;
+
+}
+
+/**
+ * Callback function which flushes every remaining target of a snapshot.
+ *
+ * @param socket
+ *     The guac_socket allocated by guac_display_snapshot_send().
+ *
+ * @return
+ *     Always zero.
+ */
+static ssize_t guac_display_snapshot_flush_handler(guac_socket* socket) {
+
+    guac_display_snapshot* snapshot = (guac_display_snapshot*) socket->data;
+
+    for (int i = 0; i < snapshot->target_count; i++) {
+        if (snapshot->targets[i] != NULL)
+            guac_socket_flush(snapshot->targets[i]);
+    }
+
+    return 0;
+
+}
+
+/**
+ * Encodes the given snapshot and sends it to all of its targets. Each image
+ * is encoded only once, regardless of the number of targets.
+ *
+ * @param display
+ *     The guac_display that the snapshot was taken of.
+ *
+ * @param snapshot
+ *     The snapshot to send.
+ */
+static void guac_display_snapshot_send(guac_display* display,
+        guac_display_snapshot* snapshot) {
+
+    guac_client* client = display->client;
+
+    guac_socket* socket = guac_socket_alloc();
+    if (socket == NULL)
+        return;
+
+    socket->data = snapshot;
+    socket->write_handler = guac_display_snapshot_write_handler;
+    socket->write_binary_handler = guac_display_snapshot_write_binary_handler;
+    socket->flush_handler = guac_display_snapshot_flush_handler;
+
+    /* Sync the state of all layers/buffers */
+    for (int i = 0; i < snapshot->layer_count; i++) {
+
+        guac_display_snapshot_layer* layer = &snapshot->layers[i];
+        guac_protocol_send_size(socket, &layer->layer, layer->width, layer->height);
+
+        if (layer->buffer != NULL) {
+
+            cairo_surface_t* rect = cairo_image_surface_create_for_data(
+                    layer->buffer,
+                    layer->opaque ? CAIRO_FORMAT_RGB24 : CAIRO_FORMAT_ARGB32,
+                    layer->width, layer->height,
+                    layer->width * GUAC_DISPLAY_LAYER_RAW_BPP);
+
+            /* Send PNG for rect */
+            guac_client_stream_png(client, socket, GUAC_COMP_OVER,
+                    &layer->layer, 0, 0, rect);
+
+            /* Resync copy of previous frame */
+            guac_protocol_send_copy(socket,
+                    &layer->layer, 0, 0, layer->width, layer->height,
+                    GUAC_COMP_OVER, &layer->last_frame_buffer, 0, 0);
+
+            cairo_surface_destroy(rect);
+
+        }
+
+        /* Resync any properties that are specific to non-buffer layers */
+        if (layer->layer.index > 0) {
+            guac_protocol_send_shade(socket, &layer->layer, layer->opacity);
+            guac_protocol_send_move(socket, &layer->layer, &layer->parent,
+                    layer->x, layer->y, layer->z);
+        }
+
+        /* Resync multitouch support */
+        if (layer->layer.index >= 0)
+            guac_protocol_send_set_int(socket, &layer->layer,
+                    GUAC_PROTOCOL_LAYER_PARAMETER_MULTI_TOUCH, layer->touches);
+
+    }
+
+    /* Sync the contents of the tile cache */
+    if (snapshot->tile_cache_image != NULL) {
+
+        guac_protocol_send_size(socket, &snapshot->tile_cache_buffer,
+                snapshot->tile_cache_width, snapshot->tile_cache_height);
+
+        /* Only tiles from opaque layers are cached */
+        cairo_surface_t* rect = cairo_image_surface_create_for_data(
+                snapshot->tile_cache_image, CAIRO_FORMAT_RGB24,
+                snapshot->tile_cache_width, snapshot->tile_cache_height,
+                snapshot->tile_cache_width * GUAC_DISPLAY_LAYER_RAW_BPP);
+
+        guac_client_stream_png(client, socket, GUAC_COMP_OVER,
+                &snapshot->tile_cache_buffer, 0, 0, rect);
+
+        cairo_surface_destroy(rect);
+
+    }
+
+    /* Synchronize mouse cursor */
+    guac_protocol_send_cursor(socket,
+            snapshot->cursor_hotspot_x, snapshot->cursor_hotspot_y,
+            &snapshot->cursor, 0, 0,
+            snapshot->cursor_width, snapshot->cursor_height);
+
+    /* Synchronize mouse location */
+    guac_protocol_send_mouse(socket, snapshot->cursor_x, snapshot->cursor_y,
+            snapshot->cursor_mask, snapshot->timestamp);
+
+    /* The initial frame synchronizing the newly-joined users is now complete */
+    guac_protocol_send_sync(socket, snapshot->timestamp, snapshot->frames);
+
+    /* Freeing flushes everything written through to the targets */
+    guac_socket_free(socket);
+
+}
+
+void* guac_display_snapshot_thread(void* data) {
+
+    guac_display* display = (guac_display*) data;
+    guac_display_snapshots* snapshots = &display->snapshots;
+
+    for (;;) {
+
+        guac_flag_wait_and_lock(&snapshots->state,
+                GUAC_DISPLAY_SNAPSHOTS_STATE_PENDING
+                | GUAC_DISPLAY_SNAPSHOTS_STATE_STOPPING);
+
+        guac_display_snapshot* snapshot = snapshots->head;
+        if (snapshot != NULL) {
+            snapshots->head = snapshot->next;
+            if (snapshots->head == NULL) {
+                snapshots->tail = NULL;
+                guac_flag_clear(&snapshots->state,
+                        GUAC_DISPLAY_SNAPSHOTS_STATE_PENDING);
+            }
+        }
+
+        int stopping = snapshots->state.value
+            & GUAC_DISPLAY_SNAPSHOTS_STATE_STOPPING;
+
+        guac_flag_unlock(&snapshots->state);
+
+        /* Stop only once all remaining snapshots have been released */
+        if (snapshot == NULL)
+            break;
+
+        if (!stopping)
+            guac_display_snapshot_send(display, snapshot);
+
+        guac_display_snapshot_free(snapshot);
+
+    }
+
+    return NULL;
+
+}
+
+void guac_display_snapshots_stop(guac_display* display) {
+
+    guac_display_snapshots* snapshots = &display->snapshots;
+
+    guac_flag_set(&snapshots->state, GUAC_DISPLAY_SNAPSHOTS_STATE_STOPPING);
+
+    if (snapshots->thread_started) {
+        pthread_join(snapshots->thread, NULL);
+        snapshots->thread_started = 0;
+    }
+
+}
+
+void guac_display_dup_pending(guac_display* display) {
+
+    guac_client* client = display->client;
+
+    guac_display_snapshot* snapshot = guac_mem_zalloc(sizeof(guac_display_snapshot));
+
+    /* Hold the output of each pending user, such that frames sent to those
+     * users after they are promoted follow the snapshot */
+    guac_display_snapshot_hold hold = { .snapshot = snapshot };
+    guac_client_foreach_pending_user(client, guac_display_snapshot_hold_user,
+            &hold);
+
+    /* Fall back to synchronizing all pending users directly if the output of
+     * any of those users cannot be held */
+    if (hold.failed) {
+        guac_display_snapshot_free(snapshot);
+        guac_display_dup(display, client->pending_socket);
+        return;
+    }
+
+    if (snapshot->target_count == 0) {
+        guac_display_snapshot_free(snapshot);
+        return;
+    }
+
+    guac_rwlock_acquire_read_lock(&display->last_frame.lock);
+
+    /* As with guac_display_dup(), the pending users must not receive the
+     * trailing instructions of any frame still in progress */
+    guac_flag_wait_and_lock(&display->render_state,
+            GUAC_DISPLAY_RENDER_STATE_FRAME_NOT_IN_PROGRESS);
+
+    LFR_guac_display_snapshot_copy(display, snapshot);
+
+    guac_flag_unlock(&display->render_state);
+    guac_rwlock_release_lock(&display->last_frame.lock);
+
+    guac_display_snapshots* snapshots = &display->snapshots;
+    guac_flag_lock(&snapshots->state);
+
+    /* Send the snapshot from the current thread if it cannot be sent in the
+     * background */
+    if (!snapshots->thread_started
+            || (snapshots->state.value & GUAC_DISPLAY_SNAPSHOTS_STATE_STOPPING)) {
+        guac_flag_unlock(&snapshots->state);
+        guac_display_snapshot_send(display, snapshot);
+        guac_display_snapshot_free(snapshot);
+        return;
+    }
+
+    if (snapshots->tail != NULL)
+        snapshots->tail->next = snapshot;
+    else
+        snapshots->head = snapshot;
+
+    snapshots->tail = snapshot;
+    guac_flag_set(&snapshots->state, GUAC_DISPLAY_SNAPSHOTS_STATE_PENDING);
+
+    guac_flag_unlock(&snapshots->state);
+
+    guac_client_log(client, GUAC_LOG_DEBUG, "Display snapshot for %i joining "
+            "user(s) will be encoded in the background.",
+            snapshot->target_count);
+
+}
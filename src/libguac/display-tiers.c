@@ -0,0 +1,406 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-priv.h"
+#include "guacamole/client.h"
+#include "guacamole/mem.h"
+#include "guacamole/timestamp.h"
+#include "guacamole/user.h"
+
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <string.h>
+
+/**
+ * The processing lag, in milliseconds, below which a user may be within each
+ * tier.
+ */
+static const int GUAC_DISPLAY_TIER_MAX_LAG[GUAC_DISPLAY_QUALITY_TIERS] = {
+    40, 100, INT_MAX
+};
+
+/**
+ * The bandwidth, in bytes per millisecond, that must be available to a user
+ * for that user to be within each tier (1 MiB/s, 256 KiB/s, and no minimum).
+ * Users whose bandwidth has not been measured are limited only by their
+ * processing lag.
+ */
+static const double GUAC_DISPLAY_TIER_MIN_BANDWIDTH[GUAC_DISPLAY_QUALITY_TIERS] = {
+    1024 * 1024 / 1000.0, 256 * 1024 / 1000.0, 0
+};
+
+/**
+ * The maximum lossy quality (between 0 and 100) used for each tier,
+ * regardless of how well the users within that tier are keeping up.
+ */
+static const int GUAC_DISPLAY_TIER_MAX_QUALITY[GUAC_DISPLAY_QUALITY_TIERS] = {
+    90, 60, 40
+};
+
+/**
+ * The state of a recalculation of tier membership, as provided to
+ * guac_display_tiers_update_viewer() for each connected user.
+ */
+typedef struct guac_display_tiers_update {
+
+    /**
+     * The guac_display whose tiers are being recalculated.
+     */
+    guac_display* display;
+
+    /**
+     * The number of bytes of image data sent to all users as part of the
+     * frame that just ended.
+     */
+    size_t shared_bytes;
+
+    /**
+     * The number of bytes of lossy image data sent to each tier as part of
+     * the frame that just ended.
+     */
+    const size_t* frame_bytes;
+
+    /**
+     * The time that the recalculation began.
+     */
+    guac_timestamp now;
+
+    /**
+     * The generation of this recalculation.
+     */
+    unsigned int generation;
+
+} guac_display_tiers_update;
+
+int guac_display_quality_for_lag(int lag) {
+
+    /* Scale quality linearly from 90 to 30 as lag varies from 20ms to 80ms */
+    int quality = 90 - (lag - 20);
+
+    /* Do not exceed 90 for quality */
+    if (quality > 90)
+        return 90;
+
+    /* Do not go below 30 for quality */
+    if (quality < 30)
+        return 30;
+
+    return quality;
+
+}
+
+/**
+ * Returns the best tier whose thresholds are satisfied by the given
+ * measurements, with those thresholds scaled by the given factor.
+ *
+ * @param lag
+ *     The processing lag of the user, in milliseconds.
+ *
+ * @param bandwidth
+ *     The bandwidth available to the user, in bytes per millisecond, or zero
+ *     if not yet measured.
+ *
+ * @param factor
+ *     The factor by which the thresholds of each tier must be exceeded.
+ *
+ * @return
+ *     The best tier whose scaled thresholds are satisfied.
+ */
+static int guac_display_tiers_classify(int lag, double bandwidth, int factor) {
+
+    for (int tier = 0; tier < GUAC_DISPLAY_QUALITY_TIERS - 1; tier++) {
+
+        if ((double) lag * factor >= GUAC_DISPLAY_TIER_MAX_LAG[tier])
+            continue;
+
+        if (bandwidth > 0 && bandwidth < GUAC_DISPLAY_TIER_MIN_BANDWIDTH[tier] * factor)
+            continue;
+
+        return tier;
+
+    }
+
+    return GUAC_DISPLAY_QUALITY_TIERS - 1;
+
+}
+
+/**
+ * Returns the viewer tracking the given user, or NULL if the user is not yet
+ * being tracked. The lock of the given tiers MUST be held.
+ *
+ * @param tiers
+ *     The guac_display_tiers to search.
+ *
+ * @param user
+ *     The user to search for.
+ *
+ * @return
+ *     The viewer tracking the given user, or NULL if there is no such viewer.
+ */
+static guac_display_viewer* guac_display_tiers_find(guac_display_tiers* tiers,
+        guac_user* user) {
+
+    guac_display_viewer* viewers = tiers->viewers.data;
+    for (size_t i = 0; i < tiers->viewer_count; i++) {
+        if (viewers[i].user == user)
+            return &viewers[i];
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Updates the measurements of the given user and decides which tier that
+ * user should be within after the next frame boundary. This function is a
+ * guac_user_callback, and the data provided must be a
+ * guac_display_tiers_update.
+ *
+ * @param user
+ *     The connected user to update.
+ *
+ * @param data
+ *     The guac_display_tiers_update describing the recalculation.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_display_tiers_update_viewer(guac_user* user, void* data) {
+
+    guac_display_tiers_update* update = (guac_display_tiers_update*) data;
+    guac_display* display = update->display;
+    guac_display_tiers* tiers = &display->tiers;
+    int lag = user->processing_lag;
+
+    pthread_mutex_lock(&tiers->lock);
+
+    /* Begin tracking any newly-joined user within the tier that user has so
+     * far been receiving */
+    guac_display_viewer* viewer = guac_display_tiers_find(tiers, user);
+    if (viewer == NULL) {
+
+        guac_display_viewer* viewers = guac_display_arena_reserve(&tiers->viewers,
+                tiers->viewer_count + 1, sizeof(guac_display_viewer));
+
+        viewer = &viewers[tiers->viewer_count++];
+        memset(viewer, 0, sizeof(guac_display_viewer));
+        viewer->user = user;
+        viewer->tier = viewer->next_tier = tiers->default_tier;
+
+    }
+
+    guac_display_bandwidth_update(&viewer->link, update->shared_bytes
+            + update->frame_bytes[viewer->tier], lag, update->now);
+
+    viewer->lag = lag;
+    viewer->generation = update->generation;
+
+    /* Move to a worse tier as soon as the user stops keeping up, but move to
+     * a better tier only once the user is comfortably keeping up */
+    int previous_tier = viewer->next_tier;
+    int tier = guac_display_tiers_classify(lag, viewer->link.bandwidth, 1);
+    if (tier < viewer->tier) {
+        tier = guac_display_tiers_classify(lag, viewer->link.bandwidth,
+                GUAC_DISPLAY_TIER_HYSTERESIS);
+        if (tier > viewer->tier)
+            tier = viewer->tier;
+    }
+
+    viewer->next_tier = tier;
+    double bandwidth = viewer->link.bandwidth;
+
+    pthread_mutex_unlock(&tiers->lock);
+
+    if (tier != previous_tier)
+        guac_client_log(display->client, GUAC_LOG_DEBUG, "User \"%s\" will "
+                "receive lossy image data from quality tier %i (processing "
+                "lag %ims, bandwidth %i KiB/s).", user->user_id, tier, lag,
+                (int) (bandwidth * 1000 / 1024));
+
+    return NULL;
+
+}
+
+void guac_display_tiers_init(guac_display_tiers* tiers) {
+
+    pthread_mutex_init(&tiers->lock, NULL);
+
+    for (int tier = 0; tier < GUAC_DISPLAY_QUALITY_TIERS; tier++)
+        tiers->quality[tier] = tiers->next_quality[tier] = GUAC_DISPLAY_TIER_MAX_QUALITY[tier];
+
+}
+
+void guac_display_tiers_free(guac_display* display) {
+
+    guac_display_tiers* tiers = &display->tiers;
+
+    guac_client_log(display->client, GUAC_LOG_DEBUG, "Quality tiers: users "
+            "moved between tiers %" PRIu64 " time(s).", tiers->moves);
+
+    pthread_mutex_destroy(&tiers->lock);
+    guac_mem_free(tiers->viewers.data);
+
+}
+
+int guac_display_tiers_select(guac_display* display, int* quality) {
+
+    guac_display_tiers* tiers = &display->tiers;
+    int populated = 0;
+
+    pthread_mutex_lock(&tiers->lock);
+
+    for (int tier = 0; tier < GUAC_DISPLAY_QUALITY_TIERS; tier++) {
+        quality[tier] = tiers->quality[tier];
+        if (tiers->population[tier])
+            populated |= 1 << tier;
+    }
+
+    pthread_mutex_unlock(&tiers->lock);
+
+    return populated;
+
+}
+
+int guac_display_tiers_filter(guac_user* user, void* data) {
+
+    guac_display_tier_filter* filter = (guac_display_tier_filter*) data;
+    guac_display_tiers* tiers = &filter->display->tiers;
+
+    pthread_mutex_lock(&tiers->lock);
+
+    /* Users that joined since tiers were last calculated receive the
+     * highest-quality populated tier */
+    guac_display_viewer* viewer = guac_display_tiers_find(tiers, user);
+    int tier = viewer != NULL ? viewer->tier : tiers->default_tier;
+
+    pthread_mutex_unlock(&tiers->lock);
+
+    return tier == filter->tier;
+
+}
+
+void guac_display_tiers_record(guac_display* display, int tier, size_t bytes) {
+
+    guac_display_tiers* tiers = &display->tiers;
+
+    pthread_mutex_lock(&tiers->lock);
+    tiers->frame_bytes[tier] += bytes;
+    pthread_mutex_unlock(&tiers->lock);
+
+}
+
+void guac_display_tiers_commit(guac_display* display, size_t* frame_bytes) {
+
+    guac_display_tiers* tiers = &display->tiers;
+
+    pthread_mutex_lock(&tiers->lock);
+
+    memset(tiers->population, 0, sizeof(tiers->population));
+
+    /* NOTE: Membership is tallied here rather than when it is decided, such
+     * that the tiers considered populated always match the tiers that users
+     * are actually within */
+    guac_display_viewer* viewers = tiers->viewers.data;
+    for (size_t i = 0; i < tiers->viewer_count; i++) {
+
+        if (viewers[i].tier != viewers[i].next_tier)
+            tiers->moves++;
+
+        viewers[i].tier = viewers[i].next_tier;
+        tiers->population[viewers[i].tier]++;
+
+    }
+
+    /* Users that join before membership is next decided receive the
+     * highest-quality populated tier */
+    tiers->default_tier = 0;
+    for (int tier = GUAC_DISPLAY_QUALITY_TIERS - 1; tier >= 0; tier--) {
+        if (tiers->population[tier])
+            tiers->default_tier = tier;
+    }
+
+    memcpy(tiers->quality, tiers->next_quality, sizeof(tiers->quality));
+
+    memcpy(frame_bytes, tiers->frame_bytes, sizeof(tiers->frame_bytes));
+    memset(tiers->frame_bytes, 0, sizeof(tiers->frame_bytes));
+
+    pthread_mutex_unlock(&tiers->lock);
+
+}
+
+void guac_display_tiers_end_frame(guac_display* display, size_t shared_bytes,
+        const size_t* frame_bytes) {
+
+    guac_display_tiers* tiers = &display->tiers;
+
+    pthread_mutex_lock(&tiers->lock);
+    unsigned int generation = ++tiers->generation;
+    pthread_mutex_unlock(&tiers->lock);
+
+    /* NOTE: The lock of the tiers cannot be held while iterating users, as
+     * the lock guarding the list of users must be acquired first */
+    guac_display_tiers_update update = {
+        .display = display,
+        .shared_bytes = shared_bytes,
+        .frame_bytes = frame_bytes,
+        .now = guac_timestamp_current(),
+        .generation = generation
+    };
+
+    guac_client_foreach_user(display->client, guac_display_tiers_update_viewer, &update);
+
+    pthread_mutex_lock(&tiers->lock);
+
+    int max_lag[GUAC_DISPLAY_QUALITY_TIERS] = { 0 };
+
+    /* Stop tracking users that have left, noting the slowest user that will
+     * be within each tier */
+    size_t kept = 0;
+    guac_display_viewer* viewers = tiers->viewers.data;
+    for (size_t i = 0; i < tiers->viewer_count; i++) {
+
+        guac_display_viewer* viewer = &viewers[i];
+        if (viewer->generation != generation)
+            continue;
+
+        if (viewer->lag > max_lag[viewer->next_tier])
+            max_lag[viewer->next_tier] = viewer->lag;
+
+        viewers[kept++] = *viewer;
+
+    }
+
+    tiers->viewer_count = kept;
+
+    /* Each tier is encoded at the quality appropriate for its slowest user,
+     * but never better than the tier allows */
+    for (int tier = 0; tier < GUAC_DISPLAY_QUALITY_TIERS; tier++) {
+
+        int quality = guac_display_quality_for_lag(max_lag[tier]);
+        if (quality > GUAC_DISPLAY_TIER_MAX_QUALITY[tier])
+            quality = GUAC_DISPLAY_TIER_MAX_QUALITY[tier];
+
+        tiers->next_quality[tier] = quality;
+
+    }
+
+    pthread_mutex_unlock(&tiers->lock);
+
+}
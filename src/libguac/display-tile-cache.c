@@ -0,0 +1,549 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-plan.h"
+#include "display-priv.h"
+#include "guacamole/client.h"
+#include "guacamole/display.h"
+#include "guacamole/layer.h"
+#include "guacamole/mem.h"
+#include "guacamole/metrics.h"
+#include "guacamole/protocol.h"
+#include "guacamole/rect.h"
+#include "guacamole/socket.h"
+
+#include <cairo/cairo.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <string.h>
+
+/**
+ * The number of bytes in each row of image data within the tile cache.
+ */
+#define GUAC_DISPLAY_TILE_CACHE_STRIDE \
+    (GUAC_DISPLAY_TILE_CACHE_COLUMNS * GUAC_DISPLAY_CELL_SIZE * GUAC_DISPLAY_LAYER_RAW_BPP)
+
+/**
+ * Initializes the given rectangle with the bounds of the given slot within
+ * the client-side buffer of the tile cache.
+ *
+ * @param rect
+ *     The rectangle to initialize.
+ *
+ * @param slot
+ *     The index of the slot.
+ */
+static void guac_display_tile_cache_slot_rect(guac_rect* rect, int slot) {
+    guac_rect_init(rect,
+            (slot % GUAC_DISPLAY_TILE_CACHE_COLUMNS) * GUAC_DISPLAY_CELL_SIZE,
+            (slot / GUAC_DISPLAY_TILE_CACHE_COLUMNS) * GUAC_DISPLAY_CELL_SIZE,
+            GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_CELL_SIZE);
+}
+
+/**
+ * Returns a pointer to the first byte of the server-side copy of the image
+ * data stored in the given slot.
+ *
+ * @param cache
+ *     The tile cache containing the slot.
+ *
+ * @param slot
+ *     The index of the slot.
+ *
+ * @return
+ *     A pointer to the first byte of the image data stored in the slot.
+ */
+static unsigned char* guac_display_tile_cache_slot_image(guac_display_tile_cache* cache,
+        int slot) {
+
+    guac_rect rect;
+    guac_display_tile_cache_slot_rect(&rect, slot);
+
+    return cache->image
+        + (size_t) rect.top * GUAC_DISPLAY_TILE_CACHE_STRIDE
+        + (size_t) rect.left * GUAC_DISPLAY_LAYER_RAW_BPP;
+
+}
+
+/**
+ * Allocates the server-side and client-side storage of the tile cache, if not
+ * already allocated and if the cache is enabled.
+ *
+ * @param display
+ *     The guac_display whose tile cache should be allocated.
+ *
+ * @return
+ *     Non-zero if the tile cache is allocated and may be used, zero if the
+ *     cache is disabled.
+ */
+static int LFW_guac_display_tile_cache_init(guac_display* display) {
+
+    guac_display_tile_cache* cache = &display->tile_cache;
+    if (cache->capacity <= 0)
+        return 0;
+
+    if (cache->buffer != NULL)
+        return 1;
+
+    int rows = (cache->capacity + GUAC_DISPLAY_TILE_CACHE_COLUMNS - 1) / GUAC_DISPLAY_TILE_CACHE_COLUMNS;
+    cache->image = guac_mem_zalloc(rows, GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_TILE_CACHE_STRIDE);
+    cache->entries = guac_mem_zalloc(cache->capacity, sizeof(guac_display_tile_cache_entry));
+    cache->stores = guac_mem_alloc(cache->capacity, sizeof(guac_display_tile_cache_store));
+    cache->store_count = 0;
+
+    /* Use at least twice as many buckets as slots to keep chains short */
+    size_t bucket_count = 1;
+    while (bucket_count < (size_t) cache->capacity * 2)
+        bucket_count <<= 1;
+
+    cache->buckets = guac_mem_alloc(bucket_count, sizeof(int));
+    cache->bucket_mask = bucket_count - 1;
+    for (size_t i = 0; i < bucket_count; i++)
+        cache->buckets[i] = -1;
+
+    /* All slots start out unused, ordered arbitrarily */
+    for (int i = 0; i < cache->capacity; i++) {
+        guac_display_tile_cache_entry* entry = &cache->entries[i];
+        entry->bucket_next = -1;
+        entry->lru_prev = i - 1;
+        entry->lru_next = (i + 1 < cache->capacity) ? i + 1 : -1;
+    }
+
+    cache->lru_head = 0;
+    cache->lru_tail = cache->capacity - 1;
+
+    /* Allocate and size client-side storage for all tiles */
+    guac_client* client = display->client;
+    cache->buffer = guac_client_alloc_buffer(client);
+    guac_protocol_send_size(client->socket, cache->buffer,
+            GUAC_DISPLAY_TILE_CACHE_COLUMNS * GUAC_DISPLAY_CELL_SIZE,
+            rows * GUAC_DISPLAY_CELL_SIZE);
+
+    guac_client_log(client, GUAC_LOG_DEBUG, "Allocated tile cache for up to "
+            "%i tiles of image data.", cache->capacity);
+
+    return 1;
+
+}
+
+/**
+ * Moves the given slot to the most recently used position of the LRU list of
+ * the tile cache.
+ *
+ * @param cache
+ *     The tile cache containing the slot.
+ *
+ * @param slot
+ *     The index of the slot to move.
+ */
+static void guac_display_tile_cache_touch(guac_display_tile_cache* cache, int slot) {
+
+    guac_display_tile_cache_entry* entry = &cache->entries[slot];
+    if (cache->lru_head == slot)
+        return;
+
+    /* Unlink from current position (not the head, as checked above) */
+    cache->entries[entry->lru_prev].lru_next = entry->lru_next;
+    if (entry->lru_next != -1)
+        cache->entries[entry->lru_next].lru_prev = entry->lru_prev;
+    else
+        cache->lru_tail = entry->lru_prev;
+
+    /* Relink as head */
+    entry->lru_prev = -1;
+    entry->lru_next = cache->lru_head;
+    cache->entries[cache->lru_head].lru_prev = slot;
+    cache->lru_head = slot;
+
+}
+
+/**
+ * Removes the given slot from the hash table of the tile cache and marks the
+ * slot as unused, moving it to the least recently used position of the LRU
+ * list such that it will be the next slot reused.
+ *
+ * @param cache
+ *     The tile cache containing the slot.
+ *
+ * @param slot
+ *     The index of the slot to remove.
+ */
+static void guac_display_tile_cache_remove(guac_display_tile_cache* cache, int slot) {
+
+    guac_display_tile_cache_entry* entry = &cache->entries[slot];
+    if (!entry->in_use)
+        return;
+
+    /* Unlink from hash bucket */
+    int* next = &cache->buckets[entry->hash & cache->bucket_mask];
+    while (*next != slot)
+        next = &cache->entries[*next].bucket_next;
+
+    *next = entry->bucket_next;
+    entry->bucket_next = -1;
+    entry->in_use = 0;
+
+    /* Move to tail of LRU list */
+    if (cache->lru_tail == slot)
+        return;
+
+    if (entry->lru_prev != -1)
+        cache->entries[entry->lru_prev].lru_next = entry->lru_next;
+    else
+        cache->lru_head = entry->lru_next;
+
+    cache->entries[entry->lru_next].lru_prev = entry->lru_prev;
+
+    entry->lru_next = -1;
+    entry->lru_prev = cache->lru_tail;
+    cache->entries[cache->lru_tail].lru_next = slot;
+    cache->lru_tail = slot;
+
+}
+
+/**
+ * Compares the image data stored in the given slot of the tile cache with the
+ * given 64x64 tile of image data.
+ *
+ * @param cache
+ *     The tile cache containing the slot.
+ *
+ * @param slot
+ *     The index of the slot to compare.
+ *
+ * @param data
+ *     A pointer to the first byte of the tile to compare against.
+ *
+ * @param stride
+ *     The number of bytes in each row of the tile to compare against.
+ *
+ * @return
+ *     Non-zero if the image data is identical, zero otherwise.
+ */
+static int guac_display_tile_cache_matches(guac_display_tile_cache* cache,
+        int slot, const unsigned char* data, size_t stride) {
+
+    const unsigned char* cached = guac_display_tile_cache_slot_image(cache, slot);
+    size_t length = GUAC_DISPLAY_CELL_SIZE * GUAC_DISPLAY_LAYER_RAW_BPP;
+
+    for (int y = 0; y < GUAC_DISPLAY_CELL_SIZE; y++) {
+
+        if (memcmp(cached, data, length))
+            return 0;
+
+        cached += GUAC_DISPLAY_TILE_CACHE_STRIDE;
+        data += stride;
+
+    }
+
+    return 1;
+
+}
+
+int LFW_guac_display_tile_cache_store(guac_display_tile_cache* cache,
+        guac_display_layer* layer, const guac_rect* cell, uint64_t hash,
+        const unsigned char* data, size_t stride) {
+
+    int slot = cache->lru_tail;
+    guac_display_tile_cache_entry* entry = &cache->entries[slot];
+
+    /* Do not evict tiles that are referenced by the current frame */
+    if (entry->in_use && entry->used_frame == cache->frame)
+        return -1;
+
+    if (entry->in_use) {
+        guac_display_tile_cache_remove(cache, slot);
+        cache->evictions++;
+    }
+
+    /* Copy image data server-side immediately ... */
+    unsigned char* cached = guac_display_tile_cache_slot_image(cache, slot);
+    for (int y = 0; y < GUAC_DISPLAY_CELL_SIZE; y++) {
+        memcpy(cached, data, GUAC_DISPLAY_CELL_SIZE * GUAC_DISPLAY_LAYER_RAW_BPP);
+        cached += GUAC_DISPLAY_TILE_CACHE_STRIDE;
+        data += stride;
+    }
+
+    /* ... but only copy client-side once the frame has been drawn */
+    cache->stores[cache->store_count++] = (guac_display_tile_cache_store) {
+        .layer = layer,
+        .x = cell->left,
+        .y = cell->top,
+        .slot = slot
+    };
+
+    size_t bucket = hash & cache->bucket_mask;
+    entry->hash = hash;
+    entry->in_use = 1;
+    entry->used_frame = cache->frame;
+    entry->stored_frame = cache->frame;
+    entry->bucket_next = cache->buckets[bucket];
+    cache->buckets[bucket] = slot;
+
+    guac_display_tile_cache_touch(cache, slot);
+    cache->stores_total++;
+
+    return slot;
+
+}
+
+int LFW_guac_display_tile_cache_lookup(guac_display_tile_cache* cache,
+        uint64_t hash, const unsigned char* data, size_t stride, int* pending) {
+
+    *pending = 0;
+
+    /* Search for a matching tile that has already been sent, verifying the
+     * image data to rule out hash collisions */
+    int slot = cache->buckets[hash & cache->bucket_mask];
+    while (slot != -1) {
+
+        guac_display_tile_cache_entry* entry = &cache->entries[slot];
+        if (entry->hash == hash && guac_display_tile_cache_matches(cache, slot, data, stride)) {
+
+            /* Tiles stored during this frame cannot be used until this frame
+             * has been sent */
+            if (entry->stored_frame == cache->frame)
+                *pending = 1;
+
+            else
+                break;
+
+        }
+
+        slot = entry->bucket_next;
+
+    }
+
+    if (slot == -1) {
+        cache->misses++;
+        return -1;
+    }
+
+    cache->entries[slot].used_frame = cache->frame;
+    guac_display_tile_cache_touch(cache, slot);
+    cache->hits++;
+
+    return slot;
+
+}
+
+int LFW_guac_display_tile_cache_begin_frame(guac_display* display) {
+
+    guac_display_tile_cache* cache = &display->tile_cache;
+
+    if (!LFW_guac_display_tile_cache_init(display))
+        return 0;
+
+    /* Tiles stored by the previous frame have already been copied
+     * client-side by the time the next frame is planned */
+    cache->frame++;
+    cache->store_count = 0;
+
+    return 1;
+
+}
+
+void PFR_LFW_guac_display_plan_rewrite_as_cached(guac_display_plan* plan) {
+
+    guac_display* display = plan->display;
+    guac_display_tile_cache* cache = &display->tile_cache;
+
+    if (!LFW_guac_display_tile_cache_begin_frame(display))
+        return;
+
+    uint64_t hits = cache->hits;
+    uint64_t misses = cache->misses;
+
+    /* Reuse the hashes calculated when indexing the plan (only operations
+     * covering an entire cell are eligible) */
+    const char* indexable = display->arena.op_indexable.data;
+    const uint64_t* hashes = display->arena.op_hashes.data;
+
+    guac_display_plan_operation* op = plan->ops;
+    for (int i = 0; i < plan->length; i++, op++) {
+
+        /* Cached tiles are only considered for draws to opaque layers, as
+         * copies do not replace the contents of transparent regions */
+        guac_display_layer* layer = op->layer;
+        if (op->type != GUAC_DISPLAY_PLAN_OPERATION_IMG || !indexable[i] || !layer->opaque)
+            continue;
+
+        uint64_t hash = hashes[i];
+
+        guac_rect cell;
+        guac_rect_init(&cell,
+                (op->dest.left / GUAC_DISPLAY_CELL_SIZE) * GUAC_DISPLAY_CELL_SIZE,
+                (op->dest.top  / GUAC_DISPLAY_CELL_SIZE) * GUAC_DISPLAY_CELL_SIZE,
+                GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_CELL_SIZE);
+
+        const unsigned char* data = GUAC_DISPLAY_LAYER_STATE_CONST_BUFFER(layer->pending_frame, cell);
+        size_t stride = layer->pending_frame.buffer_stride;
+
+        /* Replace draw with a copy from the cache if found */
+        int pending;
+        int slot = LFW_guac_display_tile_cache_lookup(cache, hash, data, stride, &pending);
+        if (slot != -1) {
+            op->type = GUAC_DISPLAY_PLAN_OPERATION_COPY;
+            op->src.layer_rect.layer = cache->buffer;
+            guac_display_tile_cache_slot_rect(&op->src.layer_rect.rect, slot);
+            op->dest = cell;
+            continue;
+        }
+
+        /* Store only tiles that are not already pending and that are not
+         * part of rapidly-changing content (like video), which would merely
+         * churn the cache */
+        int framerate = INT_MAX;
+        if (op->current_frame > op->last_frame)
+            framerate = 1000 / (op->current_frame - op->last_frame);
+
+        /* Tiles that are stored must be sent losslessly, as the client-side
+         * copy of the tile will be reused verbatim by later frames */
+        if (!pending && framerate < GUAC_DISPLAY_JPEG_FRAMERATE
+                && LFW_guac_display_tile_cache_store(cache, layer, &cell, hash, data, stride) != -1)
+            op->lossless = 1;
+
+    }
+
+    /* Export the effectiveness of the cache for external monitoring */
+    guac_metrics_count(GUAC_METRICS_TILE_CACHE_HITS, cache->hits - hits);
+    guac_metrics_count(GUAC_METRICS_TILE_CACHE_MISSES, cache->misses - misses);
+
+}
+
+void LFR_guac_display_tile_cache_flush(guac_display* display) {
+
+    guac_display_tile_cache* cache = &display->tile_cache;
+    guac_socket* socket = display->client->socket;
+
+    for (int i = 0; i < cache->store_count; i++) {
+
+        guac_display_tile_cache_store* store = &cache->stores[i];
+
+        guac_rect slot_rect;
+        guac_display_tile_cache_slot_rect(&slot_rect, store->slot);
+
+        guac_protocol_send_copy(socket, store->layer->layer,
+                store->x, store->y, GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_CELL_SIZE,
+                GUAC_COMP_OVER, cache->buffer, slot_rect.left, slot_rect.top);
+
+    }
+
+}
+
+void LFW_guac_display_tile_cache_forget_layer(guac_display* display,
+        guac_display_layer* layer) {
+
+    guac_display_tile_cache* cache = &display->tile_cache;
+
+    /* Drop any tiles whose client-side copies would have come from the
+     * removed layer, as those copies will now never be made */
+    int kept = 0;
+    for (int i = 0; i < cache->store_count; i++) {
+
+        guac_display_tile_cache_store* store = &cache->stores[i];
+        if (store->layer == layer)
+            guac_display_tile_cache_remove(cache, store->slot);
+        else
+            cache->stores[kept++] = *store;
+
+    }
+
+    cache->store_count = kept;
+
+}
+
+void LFR_guac_display_tile_cache_dup(guac_display* display, guac_socket* socket) {
+
+    guac_display_tile_cache* cache = &display->tile_cache;
+    if (cache->buffer == NULL)
+        return;
+
+    int width = GUAC_DISPLAY_TILE_CACHE_COLUMNS * GUAC_DISPLAY_CELL_SIZE;
+    int height = (cache->capacity + GUAC_DISPLAY_TILE_CACHE_COLUMNS - 1)
+        / GUAC_DISPLAY_TILE_CACHE_COLUMNS * GUAC_DISPLAY_CELL_SIZE;
+
+    guac_protocol_send_size(socket, cache->buffer, width, height);
+
+    /* Only tiles from opaque layers are cached */
+    cairo_surface_t* rect = cairo_image_surface_create_for_data(cache->image,
+            CAIRO_FORMAT_RGB24, width, height, GUAC_DISPLAY_TILE_CACHE_STRIDE);
+
+    guac_client_stream_png(display->client, socket, GUAC_COMP_OVER,
+            cache->buffer, 0, 0, rect);
+
+    cairo_surface_destroy(rect);
+
+}
+
+void LFR_guac_display_tile_cache_snapshot(guac_display* display,
+        guac_display_snapshot* snapshot) {
+
+    guac_display_tile_cache* cache = &display->tile_cache;
+    if (cache->buffer == NULL) {
+        snapshot->tile_cache_image = NULL;
+        return;
+    }
+
+    int width = GUAC_DISPLAY_TILE_CACHE_COLUMNS * GUAC_DISPLAY_CELL_SIZE;
+    int height = (cache->capacity + GUAC_DISPLAY_TILE_CACHE_COLUMNS - 1)
+        / GUAC_DISPLAY_TILE_CACHE_COLUMNS * GUAC_DISPLAY_CELL_SIZE;
+
+    /* Rows of the cache image are already exactly as wide as the buffer */
+    size_t length = (size_t) height * GUAC_DISPLAY_TILE_CACHE_STRIDE;
+    snapshot->tile_cache_image = guac_mem_alloc(length);
+    memcpy(snapshot->tile_cache_image, cache->image, length);
+
+    snapshot->tile_cache_buffer = *cache->buffer;
+    snapshot->tile_cache_width = width;
+    snapshot->tile_cache_height = height;
+
+}
+
+void LFW_guac_display_tile_cache_free(guac_display* display) {
+
+    guac_display_tile_cache* cache = &display->tile_cache;
+    guac_client* client = display->client;
+
+    if (cache->buffer == NULL)
+        return;
+
+    guac_client_log(client, GUAC_LOG_DEBUG, "Tile cache: %" PRIu64 " hit(s), "
+            "%" PRIu64 " miss(es), %" PRIu64 " tile(s) stored, %" PRIu64
+            " evicted. Approximately %" PRIu64 " KiB of image data did not "
+            "need to be encoded due to cache hits.",
+            cache->hits, cache->misses, cache->stores_total, cache->evictions,
+            cache->hits * GUAC_DISPLAY_TILE_CACHE_TILE_SIZE / 1024);
+
+    guac_protocol_send_dispose(client->socket, cache->buffer);
+    guac_client_free_buffer(client, cache->buffer);
+    cache->buffer = NULL;
+
+    guac_mem_free(cache->image);
+    guac_mem_free(cache->entries);
+    guac_mem_free(cache->buckets);
+    guac_mem_free(cache->stores);
+    cache->store_count = 0;
+
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->stores_total = 0;
+    cache->evictions = 0;
+
+}
@@ -22,7 +22,9 @@
 #include "guacamole/client.h"
 #include "guacamole/display.h"
 #include "guacamole/fifo.h"
+#include "guacamole/flag.h"
 #include "guacamole/layer.h"
+#include "guacamole/mem.h"
 #include "guacamole/protocol-types.h"
 #include "guacamole/protocol.h"
 #include "guacamole/rect.h"
@@ -126,22 +128,7 @@ static void guac_display_layer_clear_non_opaque(guac_display_layer* display_laye
  *     client based on lag measurements.
  */
 static int guac_display_suggest_quality(guac_client* client) {
-
-    int lag = guac_client_get_processing_lag(client);
-
-    /* Scale quality linearly from 90 to 30 as lag varies from 20ms to 80ms */
-    int quality = 90 - (lag - 20);
-
-    /* Do not exceed 90 for quality */
-    if (quality > 90)
-        return 90;
-
-    /* Do not go below 30 for quality */
-    if (quality < 30)
-        return 30;
-
-    return quality;
-
+    return guac_display_quality_for_lag(guac_client_get_processing_lag(client));
 }
 
 /**
@@ -214,7 +201,7 @@ static int LFR_guac_display_layer_png_optimality(guac_display_layer* layer,
 }
 
 /**
- * Returns whether the given rectangle would be optimally encoded as JPEG
+ * Returns whether the given rectangle would be optimally encoded as WebP
  * rather than PNG.
  *
  * @param layer
@@ -228,33 +215,30 @@ static int LFR_guac_display_layer_png_optimality(guac_display_layer* layer,
  *     been being updated within the given layer, in frames per second.
  *
  * @return
- *     Non-zero if the rectangle would be optimally encoded as JPEG, zero
+ *     Non-zero if the rectangle would be optimally encoded as WebP, zero
  *     otherwise.
  */
-static int LFR_guac_display_layer_should_use_jpeg(guac_display_layer* layer,
+static int LFR_guac_display_layer_should_use_webp(guac_display_layer* layer,
         const guac_rect* rect, int framerate) {
 
-    /* Do not use JPEG if lossless quality is required */
-    if (layer->last_frame.lossless)
+    /* Do not use WebP if not supported */
+    if (!guac_client_supports_webp(layer->display->client))
         return 0;
 
-    int rect_width = rect->right - rect->left;
-    int rect_height = rect->bottom - rect->top;
-    int rect_size = rect_width * rect_height;
-
-    /* JPEG is preferred if:
+    /* WebP is preferred if:
      * - frame rate is high enough
-     * - image size is large enough
      * - PNG is not more optimal based on image contents */
     return framerate >= GUAC_DISPLAY_JPEG_FRAMERATE
-        && rect_size > GUAC_DISPLAY_JPEG_MIN_BITMAP_SIZE
         && LFR_guac_display_layer_png_optimality(layer, rect) < 0;
 
 }
 
 /**
- * Returns whether the given rectangle would be optimally encoded as WebP
- * rather than PNG.
+ * Returns whether the given rectangle should be sent progressively, as a
+ * quickly-encoded, low-quality preview followed later by a full-quality
+ * refinement. This is only worthwhile for large regions that are being
+ * updated rapidly, where the time required to encode the region at full
+ * quality would otherwise delay the client from seeing the frame at all.
  *
  * @param layer
  *     The layer to be queried.
@@ -267,35 +251,770 @@ static int LFR_guac_display_layer_should_use_jpeg(guac_display_layer* layer,
  *     been being updated within the given layer, in frames per second.
  *
  * @return
- *     Non-zero if the rectangle would be optimally encoded as WebP, zero
- *     otherwise.
+ *     Non-zero if the rectangle should be sent as a low-quality preview
+ *     followed by a refinement, zero otherwise.
  */
-static int LFR_guac_display_layer_should_use_webp(guac_display_layer* layer,
+static int LFR_guac_display_layer_should_preview(guac_display_layer* layer,
         const guac_rect* rect, int framerate) {
 
-    /* Do not use WebP if not supported */
-    if (!guac_client_supports_webp(layer->display->client))
+    /* Previews are inherently lossy */
+    if (layer->last_frame.lossless)
         return 0;
 
-    /* WebP is preferred if:
-     * - frame rate is high enough
-     * - PNG is not more optimal based on image contents */
+    /* Previews are encoded as WebP or JPEG, and JPEG cannot represent alpha
+     * transparency */
+    if (!layer->opaque && !guac_client_supports_webp(layer->display->client))
+        return 0;
+
+    int rect_width = rect->right - rect->left;
+    int rect_height = rect->bottom - rect->top;
+    int rect_size = rect_width * rect_height;
+
     return framerate >= GUAC_DISPLAY_JPEG_FRAMERATE
-        && LFR_guac_display_layer_png_optimality(layer, rect) < 0;
+        && rect_size >= GUAC_DISPLAY_PREVIEW_MIN_SIZE;
+
+}
+
+/**
+ * The state of a guac_socket that wraps the socket of the guac_client
+ * associated with a guac_display, counting the number of bytes written by a
+ * single display worker thread.
+ */
+typedef struct guac_display_worker_socket_data {
+
+    /**
+     * The guac_socket to which all socket operations should be delegated.
+     */
+    guac_socket* socket;
+
+    /**
+     * The total number of bytes written via the wrapping guac_socket.
+     */
+    size_t written;
+
+} guac_display_worker_socket_data;
+
+/**
+ * Writes the given data to the wrapped socket, counting the number of bytes
+ * written.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param buf
+ *     The buffer containing the data to write.
+ *
+ * @param count
+ *     The number of bytes to write.
+ *
+ * @return
+ *     The number of bytes written, or -1 if an error occurs.
+ */
+static ssize_t guac_display_worker_socket_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_display_worker_socket_data* data = (guac_display_worker_socket_data*) socket->data;
+
+    if (guac_socket_write(data->socket, buf, count))
+        return -1;
+
+    data->written += count;
+    return count;
+
+}
+
+/**
+ * Writes an element of binary data to the wrapped socket, framed as
+ * negotiated with the recipients of that socket, updating the number of bytes
+ * written. The element is counted as if it were base64, such that the sizes
+ * of images measured are comparable regardless of the framing used by each
+ * recipient.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param buf
+ *     The buffer containing the data to write.
+ *
+ * @param count
+ *     The number of bytes to write.
+ *
+ * @return
+ *     The number of bytes written, or -1 if an error occurs.
+ */
+static ssize_t guac_display_worker_socket_write_binary_handler(
+        guac_socket* socket, const void* buf, size_t count) {
+
+    guac_display_worker_socket_data* data = (guac_display_worker_socket_data*) socket->data;
+
+    if (guac_socket_write_binary(data->socket, buf, count))
+        return -1;
+
+    data->written += (count + 2) / 3 * 4;
+    return count;
+
+}
+
+/**
+ * Flushes the wrapped socket.
+ *
+ * @param socket
+ *     The guac_socket being flushed.
+ *
+ * @return
+ *     Zero on success, non-zero if an error occurs.
+ */
+static ssize_t guac_display_worker_socket_flush_handler(guac_socket* socket) {
+    guac_display_worker_socket_data* data = (guac_display_worker_socket_data*) socket->data;
+    return guac_socket_flush(data->socket);
+}
+
+/**
+ * Begins an instruction on the wrapped socket, such that the instruction is
+ * not interleaved with instructions written by other threads.
+ *
+ * @param socket
+ *     The guac_socket that an instruction is being written to.
+ */
+static void guac_display_worker_socket_lock_handler(guac_socket* socket) {
+    guac_display_worker_socket_data* data = (guac_display_worker_socket_data*) socket->data;
+    guac_socket_instruction_begin(data->socket);
+}
+
+/**
+ * Ends an instruction previously begun on the wrapped socket.
+ *
+ * @param socket
+ *     The guac_socket that an instruction was written to.
+ */
+static void guac_display_worker_socket_unlock_handler(guac_socket* socket) {
+    guac_display_worker_socket_data* data = (guac_display_worker_socket_data*) socket->data;
+    guac_socket_instruction_end(data->socket);
+}
+
+/**
+ * Frees the state of the given guac_socket. The wrapped socket is not freed.
+ *
+ * @param socket
+ *     The guac_socket being freed.
+ *
+ * @return
+ *     Always zero.
+ */
+static int guac_display_worker_socket_free_handler(guac_socket* socket) {
+    guac_mem_free(socket->data);
+    return 0;
+}
+
+/**
+ * Allocates a new guac_socket that delegates all writes to the given socket,
+ * counting the number of bytes written. This allows each display worker
+ * thread to measure the size of the images it sends. The returned socket must
+ * eventually be freed with guac_socket_free(), which will not free the
+ * wrapped socket.
+ *
+ * @param wrapped
+ *     The guac_socket to which all writes should be delegated.
+ *
+ * @return
+ *     A newly-allocated guac_socket that wraps the given socket.
+ */
+static guac_socket* guac_display_worker_socket_alloc(guac_socket* wrapped) {
+
+    guac_display_worker_socket_data* data = guac_mem_zalloc(sizeof(guac_display_worker_socket_data));
+    data->socket = wrapped;
+
+    guac_socket* socket = guac_socket_alloc();
+    socket->data = data;
+    socket->write_handler = guac_display_worker_socket_write_handler;
+    socket->write_binary_handler = guac_display_worker_socket_write_binary_handler;
+    socket->flush_handler = guac_display_worker_socket_flush_handler;
+    socket->lock_handler = guac_display_worker_socket_lock_handler;
+    socket->unlock_handler = guac_display_worker_socket_unlock_handler;
+    socket->free_handler = guac_display_worker_socket_free_handler;
+
+    return socket;
+
+}
+
+/**
+ * Returns the total number of bytes written to the given socket, which must
+ * have been allocated with guac_display_worker_socket_alloc().
+ *
+ * @param socket
+ *     The guac_socket to query.
+ *
+ * @return
+ *     The total number of bytes written to the given socket.
+ */
+static size_t guac_display_worker_socket_written(guac_socket* socket) {
+    guac_display_worker_socket_data* data = (guac_display_worker_socket_data*) socket->data;
+    return data->written;
+}
+
+/**
+ * Sends the given Cairo surface as an image having the given lossy format and
+ * quality.
+ *
+ * @param display_layer
+ *     The layer that should receive the image.
+ *
+ * @param socket
+ *     The socket that the image should be written to.
+ *
+ * @param dirty
+ *     The region of the layer that should receive the image.
+ *
+ * @param rect
+ *     The Cairo surface containing the image data.
+ *
+ * @param format
+ *     The lossy image format to use. This must be either
+ *     GUAC_DISPLAY_FORMAT_WEBP or GUAC_DISPLAY_FORMAT_JPEG.
+ *
+ * @param quality
+ *     The lossy quality to use, between 0 and 100 inclusive.
+ */
+static void guac_display_layer_send_lossy(guac_display_layer* display_layer,
+        guac_socket* socket, const guac_rect* dirty, cairo_surface_t* rect,
+        guac_display_format format, int quality) {
+
+    guac_client* client = display_layer->display->client;
+    const guac_layer* layer = display_layer->layer;
+
+    if (format == GUAC_DISPLAY_FORMAT_WEBP)
+        guac_client_stream_webp(client, socket, GUAC_COMP_OVER, layer,
+                dirty->left, dirty->top, rect, quality, 0);
+
+    else
+        guac_client_stream_jpeg(client, socket, GUAC_COMP_OVER, layer,
+                dirty->left, dirty->top, rect, quality);
+
+}
+
+/**
+ * Sends the given Cairo surface as an image having the given lossy format,
+ * encoding that image separately for each populated quality tier at the
+ * quality of that tier, with each encoded image reaching only the users within
+ * the corresponding tier.
+ *
+ * @param display_layer
+ *     The layer that should receive the image.
+ *
+ * @param socket
+ *     The socket of the current worker thread, as allocated with
+ *     guac_display_worker_socket_alloc().
+ *
+ * @param dirty
+ *     The region of the layer that should receive the image.
+ *
+ * @param rect
+ *     The Cairo surface containing the image data.
+ *
+ * @param format
+ *     The lossy image format to use. This must be either
+ *     GUAC_DISPLAY_FORMAT_WEBP or GUAC_DISPLAY_FORMAT_JPEG.
+ *
+ * @param populated
+ *     A bitwise OR of (1 << tier) for each populated tier, as returned by
+ *     guac_display_tiers_select().
+ *
+ * @param quality
+ *     The quality of each tier, as provided by guac_display_tiers_select().
+ *
+ * @return
+ *     The number of tiers that the image was encoded for.
+ */
+static int guac_display_layer_send_tiered(guac_display_layer* display_layer,
+        guac_socket* socket, const guac_rect* dirty, cairo_surface_t* rect,
+        guac_display_format format, int populated, const int* quality) {
+
+    guac_display* display = display_layer->display;
+    int encoded = 0;
+
+    /* Tiers are sent from lowest to highest quality, such that anything
+     * receiving all tiers regardless of filtering (a session recording)
+     * finishes with the highest-quality image */
+    for (int tier = GUAC_DISPLAY_QUALITY_TIERS - 1; tier >= 0; tier--) {
+
+        if (!(populated & (1 << tier)))
+            continue;
+
+        size_t written = guac_display_worker_socket_written(socket);
+
+        guac_display_tier_filter filter = {
+            .display = display,
+            .tier = tier
+        };
+
+        guac_socket_broadcast_set_filter(guac_display_tiers_filter, &filter);
+        guac_display_layer_send_lossy(display_layer, socket, dirty, rect,
+                format, quality[tier]);
+        guac_socket_broadcast_set_filter(NULL, NULL);
+
+        guac_display_tiers_record(display, tier,
+                guac_display_worker_socket_written(socket) - written);
+
+        encoded++;
+
+    }
+
+    return encoded;
+
+}
+
+/**
+ * Sends the contents of the given rectangle of the given layer over the
+ * Guacamole connection, selecting the image format expected to best fit the
+ * time available based on the measured cost of each format. The cost of
+ * sending the image is measured and recorded for future decisions.
+ *
+ * @param display_layer
+ *     The layer containing the image data to send.
+ *
+ * @param socket
+ *     The socket of the current worker thread, as allocated with
+ *     guac_display_worker_socket_alloc().
+ *
+ * @param dirty
+ *     The region of the layer to send.
+ *
+ * @param framerate
+ *     The rate that the region covered by the given rectangle has historically
+ *     been being updated within the given layer, in frames per second.
+ *
+ * @param lossless
+ *     Non-zero if the image data must be sent losslessly regardless of the
+ *     lossless setting of the layer, zero otherwise.
+ *
+ * @return
+ *     Non-zero if the image data was sent using lossy compression, zero
+ *     otherwise.
+ */
+static int LFR_guac_display_layer_send_img(guac_display_layer* display_layer,
+        guac_socket* socket, guac_rect* dirty, int framerate, int lossless) {
+
+    guac_display* display = display_layer->display;
+    guac_client* client = display->client;
+
+    cairo_surface_t* rect = LFR_guac_display_layer_cairo_rect(display_layer, dirty);
+    const guac_layer* layer = display_layer->layer;
+
+    /* Clear relevant rect of destination layer if necessary to ensure fresh
+     * data is not drawn on top of old data for layers with alpha
+     * transparency */
+    guac_display_layer_clear_non_opaque(display_layer, dirty);
+
+    /* Layers that require lossless encoding retain the static heuristics, as
+     * only PNG or lossless WebP are applicable */
+    if (!lossless && display_layer->last_frame.lossless) {
+
+        if (LFR_guac_display_layer_should_use_webp(display_layer, dirty, framerate))
+            guac_client_stream_webp(client, socket, GUAC_COMP_OVER, layer,
+                    dirty->left, dirty->top, rect,
+                    guac_display_suggest_quality(client), 1);
+        else
+            guac_client_stream_png(client, socket, GUAC_COMP_OVER,
+                    layer, dirty->left, dirty->top, rect);
+
+        cairo_surface_destroy(rect);
+        return 0;
+
+    }
+
+    size_t pixels = (size_t) guac_rect_width(dirty) * guac_rect_height(dirty);
+    int optimality = LFR_guac_display_layer_png_optimality(display_layer, dirty);
+    guac_display_region_class region_class = guac_display_cost_classify(optimality);
+
+    /* Determine the formats that may be used, and the format that the static
+     * heuristics would have selected */
+    guac_display_format fallback;
+    int candidates = guac_display_cost_candidates(!lossless
+                && framerate >= GUAC_DISPLAY_JPEG_FRAMERATE && optimality < 0,
+            display_layer->opaque, pixels, guac_client_supports_webp(client),
+            &fallback);
+
+    guac_display_format format = GUAC_DISPLAY_FORMAT_PNG;
+    if (candidates != 1 << GUAC_DISPLAY_FORMAT_PNG) {
+        guac_fifo_lock(&display->ops);
+        format = guac_display_cost_select(display, region_class, pixels,
+                framerate, candidates, fallback);
+        guac_fifo_unlock(&display->ops);
+    }
+
+    size_t written = guac_display_worker_socket_written(socket);
+    uint64_t start = guac_display_cost_usec();
+    int encoded = 1;
+
+    if (format == GUAC_DISPLAY_FORMAT_PNG)
+        guac_client_stream_png(client, socket, GUAC_COMP_OVER,
+                layer, dirty->left, dirty->top, rect);
+
+    else {
+
+        /* Lossy image data is encoded separately for each quality tier only
+         * if users are actually divided between multiple tiers */
+        int quality[GUAC_DISPLAY_QUALITY_TIERS];
+        int populated = guac_display_tiers_select(display, quality);
+
+        if (populated & (populated - 1))
+            encoded = guac_display_layer_send_tiered(display_layer, socket,
+                    dirty, rect, format, populated, quality);
+
+        else if (populated) {
+            int tier = 0;
+            while (!(populated & (1 << tier)))
+                tier++;
+            guac_display_layer_send_lossy(display_layer, socket, dirty, rect,
+                    format, quality[tier]);
+        }
+
+        else
+            guac_display_layer_send_lossy(display_layer, socket, dirty, rect,
+                    format, guac_display_suggest_quality(client));
+
+    }
+
+    /* The cost of each tier's encoding is recorded as the average of all
+     * tiers, as the size of the image sent to each user matters more than
+     * the size of all images combined */
+    uint64_t usec = guac_display_cost_usec() - start;
+    written = (guac_display_worker_socket_written(socket) - written) / encoded;
+
+    guac_fifo_lock(&display->ops);
+    guac_display_cost_record(display, format, region_class, pixels, usec, written);
+    guac_fifo_unlock(&display->ops);
+
+    cairo_surface_destroy(rect);
+    return format != GUAC_DISPLAY_FORMAT_PNG;
+
+}
+
+/**
+ * Sends a low-quality preview of the contents of the given rectangle of the
+ * given layer over the Guacamole connection. The preview is encoded as WebP
+ * if supported by the client, or JPEG otherwise, and must eventually be
+ * replaced by a full-quality refinement.
+ *
+ * @param display_layer
+ *     The layer containing the image data to send.
+ *
+ * @param socket
+ *     The socket of the current worker thread, as allocated with
+ *     guac_display_worker_socket_alloc().
+ *
+ * @param dirty
+ *     The region of the layer to send.
+ */
+static void LFR_guac_display_layer_send_preview(guac_display_layer* display_layer,
+        guac_socket* socket, guac_rect* dirty) {
+
+    guac_client* client = display_layer->display->client;
+
+    cairo_surface_t* rect = LFR_guac_display_layer_cairo_rect(display_layer, dirty);
+    const guac_layer* layer = display_layer->layer;
+
+    guac_display_layer_clear_non_opaque(display_layer, dirty);
+
+    if (guac_client_supports_webp(client))
+        guac_client_stream_webp(client, socket, GUAC_COMP_OVER, layer,
+                dirty->left, dirty->top, rect,
+                GUAC_DISPLAY_PREVIEW_QUALITY, 0);
+
+    else
+        guac_client_stream_jpeg(client, socket, GUAC_COMP_OVER, layer,
+                dirty->left, dirty->top, rect,
+                GUAC_DISPLAY_PREVIEW_QUALITY);
+
+    cairo_surface_destroy(rect);
+
+}
+
+/**
+ * Records that the full-quality refinement of a low-quality preview will not
+ * be sent, such that the region covered by that preview is instead redrawn
+ * as part of the next frame. The ops FIFO of the display MUST be locked.
+ *
+ * @param display
+ *     The guac_display that the preview was sent for.
+ *
+ * @param op
+ *     The GUAC_DISPLAY_PLAN_OPERATION_REFINE operation being abandoned.
+ */
+static void guac_display_abandon_refinement(guac_display* display,
+        const guac_display_plan_operation* op) {
+    guac_rect_extend(&op->layer->unrefined, &op->dest);
+}
+
+/**
+ * Stores a GUAC_DISPLAY_PLAN_OPERATION_REFINE operation that will replace the
+ * low-quality preview just sent for the given operation after the current
+ * frame has ended.
+ *
+ * @param display
+ *     The guac_display that the preview was sent for.
+ *
+ * @param op
+ *     The GUAC_DISPLAY_PLAN_OPERATION_IMG operation that was sent as a
+ *     low-quality preview.
+ */
+static void guac_display_queue_refinement(guac_display* display,
+        const guac_display_plan_operation* op) {
+
+    guac_fifo_lock(&display->ops);
+
+    guac_display_plan_operation* refinements = guac_display_arena_reserve(
+            &display->refinements, display->refinement_count + 1,
+            sizeof(guac_display_plan_operation));
+
+    guac_display_plan_operation* refinement = &refinements[display->refinement_count++];
+    *refinement = *op;
+    refinement->type = GUAC_DISPLAY_PLAN_OPERATION_REFINE;
+
+    guac_fifo_unlock(&display->ops);
+
+}
+
+/**
+ * Begins refining the low-quality previews sent as part of the frame that
+ * just ended, adding the relevant GUAC_DISPLAY_PLAN_OPERATION_REFINE
+ * operations to the ops FIFO. If a newer frame is already waiting to be
+ * rendered, all refinements are abandoned in favor of that frame. The ops FIFO
+ * of the display MUST be locked and MUST be empty.
+ *
+ * @param display
+ *     The guac_display whose previews should be refined.
+ *
+ * @return
+ *     Non-zero if at least one refinement has been added to the ops FIFO,
+ *     zero otherwise.
+ */
+static int guac_display_begin_refinements(guac_display* display) {
+
+    int queued = 0;
+    guac_display_plan_operation* refinements = display->refinements.data;
+
+    for (size_t i = 0; i < display->refinement_count; i++) {
+
+        /* NOTE: As the FIFO is currently empty, enqueuing will never block
+         * unless there are more refinements than the FIFO can hold, in which
+         * case the excess refinements are simply abandoned */
+        if (display->frame_deferred || queued >= GUAC_DISPLAY_WORKER_FIFO_SIZE
+                || !guac_fifo_enqueue(&display->ops, &refinements[i]))
+            guac_display_abandon_refinement(display, &refinements[i]);
+        else
+            queued++;
+
+    }
+
+    display->refinement_count = 0;
+    return queued != 0;
+
+}
+
+void LFW_guac_display_forget_refinements(guac_display* display,
+        guac_display_layer* layer) {
+
+    guac_fifo_lock(&display->ops);
+
+    size_t kept = 0;
+    guac_display_plan_operation* refinements = display->refinements.data;
+    for (size_t i = 0; i < display->refinement_count; i++) {
+        if (refinements[i].layer != layer)
+            refinements[kept++] = refinements[i];
+    }
+
+    display->refinement_count = kept;
+
+    guac_fifo_unlock(&display->ops);
+
+}
+
+/**
+ * Repeatedly claims and performs any bands of work that have not yet been
+ * claimed by another thread, returning once no unclaimed bands remain. If the
+ * final outstanding band is completed by the current thread, the
+ * GUAC_DISPLAY_BANDS_STATE_COMPLETE flag is set.
+ *
+ * @param display
+ *     The guac_display whose outstanding bands of work should be performed.
+ */
+static void guac_display_perform_bands(guac_display* display) {
+
+    guac_display_bands* bands = &display->bands;
+
+    guac_flag_lock(&bands->state);
+    while (bands->next < bands->count) {
+
+        int band = bands->next++;
+        guac_display_band_callback* callback = bands->callback;
+        void* data = bands->data;
+
+        /* Perform work outside of lock such that other threads may claim
+         * other bands concurrently */
+        guac_flag_unlock(&bands->state);
+        callback(display, band, data);
+        guac_flag_lock(&bands->state);
+
+        if (--bands->remaining == 0)
+            guac_flag_set(&bands->state, GUAC_DISPLAY_BANDS_STATE_COMPLETE);
+
+    }
+    guac_flag_unlock(&bands->state);
+
+}
+
+int guac_display_band_count(guac_display* display, size_t pixels, int max_bands) {
+
+    /* Avoid waking worker threads for work that is too small to benefit */
+    size_t count = pixels / GUAC_DISPLAY_BAND_MIN_PIXELS;
+
+    /* There is no benefit to more bands than the number of threads available
+     * to perform them (the worker threads plus the planning thread) */
+    if (count > (size_t) display->worker_thread_count + 1)
+        count = display->worker_thread_count + 1;
+
+    if (count > GUAC_DISPLAY_MAX_BANDS)
+        count = GUAC_DISPLAY_MAX_BANDS;
+
+    if (max_bands < 1)
+        return 1;
+
+    if (count > (size_t) max_bands)
+        count = max_bands;
+
+    if (count < 1)
+        count = 1;
+
+    return count;
+
+}
+
+void guac_display_foreach_band(guac_display* display, int count,
+        guac_display_band_callback* callback, void* data) {
+
+    /* Perform all work directly if there is nothing to parallelize */
+    if (count <= 1 || display->worker_thread_count <= 1) {
+        for (int band = 0; band < count; band++)
+            callback(display, band, data);
+        return;
+    }
+
+    guac_display_bands* bands = &display->bands;
+
+    guac_flag_lock(&bands->state);
+    guac_flag_clear(&bands->state, GUAC_DISPLAY_BANDS_STATE_COMPLETE);
+    bands->callback = callback;
+    bands->data = data;
+    bands->count = count;
+    bands->next = 0;
+    bands->remaining = count;
+    guac_flag_unlock(&bands->state);
+
+    /* Awaken enough worker threads to perform all bands other than the one
+     * that will be performed by the current thread. NOTE: As planning occurs
+     * only while the operation queue is empty and no worker threads are
+     * active, these operations are the only operations in the queue. */
+    guac_display_plan_operation op = {
+        .type = GUAC_DISPLAY_PLAN_OPERATION_BANDS
+    };
+
+    int wakeups = count - 1;
+    if (wakeups > display->worker_thread_count)
+        wakeups = display->worker_thread_count;
+
+    for (int i = 0; i < wakeups; i++) {
+        if (!guac_fifo_enqueue(&display->ops, &op))
+            break;
+    }
+
+    /* Contribute to the work ourselves rather than simply waiting (this also
+     * guarantees progress if the worker threads have been stopped) */
+    guac_display_perform_bands(display);
+
+    guac_flag_wait_and_lock(&bands->state, GUAC_DISPLAY_BANDS_STATE_COMPLETE);
+    guac_flag_unlock(&bands->state);
+
+    /* Discard any wakeups that were not consumed by a worker thread before
+     * all bands were completed, such that the operation queue is once again
+     * empty and only contains operations that are part of the frame */
+    while (guac_fifo_timed_dequeue(&display->ops, &op, 0)) {
+        /* Do nothing - stale wakeups are simply dropped */
+    }
+
+}
+
+/**
+ * Removes the next operation from the ops FIFO of the given display, waiting
+ * for an operation to become available if necessary, and locking the FIFO
+ * once an operation has been removed. While any cells were last sent using
+ * lossy compression, waiting for an operation is interrupted periodically to
+ * re-send those cells losslessly if they have stopped changing.
+ *
+ * @param display
+ *     The guac_display whose ops FIFO should be read.
+ *
+ * @param op
+ *     The location to store the removed operation.
+ *
+ * @return
+ *     Non-zero if an operation was removed and the FIFO is now locked, zero
+ *     if the FIFO has been invalidated.
+ */
+static int guac_display_worker_dequeue_and_lock(guac_display* display,
+        guac_display_plan_operation* op) {
+
+    for (;;) {
+
+        guac_fifo_lock(&display->ops);
+        int lossy = display->lossy_cells || display->encoding_report_count;
+        guac_fifo_unlock(&display->ops);
+
+        if (!lossy)
+            return guac_fifo_dequeue_and_lock(&display->ops, op);
+
+        if (guac_fifo_timed_dequeue_and_lock(&display->ops, op,
+                    GUAC_DISPLAY_LOSSLESS_REFRESH_INTERVAL))
+            return 1;
+
+        if (!guac_fifo_is_valid(&display->ops))
+            return 0;
+
+        /* Re-send lossy cells losslessly now that the worker threads have
+         * been idle for a while */
+        guac_display_refresh_lossless(display);
+
+    }
 
 }
 
 void* guac_display_worker_thread(void* data) {
 
     int framerate;
+    int lossy;
     int has_outstanding_frames = 0;
+    int frame_ended = 0;
+    size_t frame_bytes = 0;
+    size_t tier_bytes[GUAC_DISPLAY_QUALITY_TIERS];
 
     guac_display* display = (guac_display*) data;
     guac_client* client = display->client;
-    guac_socket* socket = client->socket;
+
+    /* Images are sent via a wrapper around the client's socket that measures
+     * the size of each image for the encoder cost model */
+    guac_socket* socket = guac_display_worker_socket_alloc(client->socket);
 
     guac_display_plan_operation op;
-    while (guac_fifo_dequeue_and_lock(&display->ops, &op)) {
+    while (guac_display_worker_dequeue_and_lock(display, &op)) {
+
+        /* Assist with planning if woken for that purpose. Planning is not
+         * part of any frame being rendered, and the thread performing that
+         * planning already holds all locks required. */
+        if (op.type == GUAC_DISPLAY_PLAN_OPERATION_BANDS) {
+            guac_fifo_unlock(&display->ops);
+            guac_display_perform_bands(display);
+            continue;
+        }
 
         /* Notify any watchers of render_state that a frame is now in progress */
         guac_flag_set_and_lock(&display->render_state, GUAC_DISPLAY_RENDER_STATE_FRAME_IN_PROGRESS);
@@ -308,62 +1027,55 @@ void* guac_display_worker_thread(void* data) {
         display->active_workers++;
         guac_fifo_unlock(&display->ops);
 
+        framerate = INT_MAX;
+        if (op.current_frame > op.last_frame)
+            framerate = 1000 / (op.current_frame - op.last_frame);
+
+        size_t written = guac_display_worker_socket_written(socket);
+
         guac_rwlock_acquire_read_lock(&display->last_frame.lock);
         guac_display_layer* display_layer = op.layer;
         switch (op.type) {
 
             case GUAC_DISPLAY_PLAN_OPERATION_IMG:
 
-                framerate = INT_MAX;
-                if (op.current_frame > op.last_frame)
-                    framerate = 1000 / (op.current_frame - op.last_frame);
-
-                guac_rect* dirty = &op.dest;
-
-                /* TODO: Determine whether to use PNG/WebP/JPEG purely
-                 * based on whether lossless encoding is required, the
-                 * expected time until another frame is received (time
-                 * since last frame), and estimated encoding times. The
-                 * time allowed per update should be divided up
-                 * proportionately based on the dirty_size of the update. */
-
-                /* TODO: Stream PNG/WebP/JPEG using progressive encoding such
-                 * that a frame that is currently being encoded can be
-                 * preempted by the next frame, with the connected client then
-                 * simply receiving a lower-quality intermediate frame. If
-                 * necessary, progressive encoding can be achieved by manually
-                 * dividing images into multiple reduced-resolution stages,
-                 * such that each image streamed is actually only one quarter
-                 * the size of the original image. Compositing via Guacamole
-                 * protocol instructions can reassemble those stages. */
-
-                cairo_surface_t* rect = LFR_guac_display_layer_cairo_rect(display_layer, dirty);
-                const guac_layer* layer = display_layer->layer;
-
-                /* Clear relevant rect of destination layer if necessary to
-                 * ensure fresh data is not drawn on top of old data for layers
-                 * with alpha transparency */
-                guac_display_layer_clear_non_opaque(display_layer, dirty);
-
-                /* Prefer WebP when reasonable */
-                if (LFR_guac_display_layer_should_use_webp(display_layer, dirty, framerate))
-                    guac_client_stream_webp(client, socket, GUAC_COMP_OVER, layer,
-                            dirty->left, dirty->top, rect,
-                            guac_display_suggest_quality(client),
-                            display_layer->last_frame.lossless ? 1 : 0);
-
-                /* If not WebP, JPEG is the next best (lossy) choice */
-                else if (display_layer->opaque && LFR_guac_display_layer_should_use_jpeg(display_layer, dirty, framerate))
-                    guac_client_stream_jpeg(client, socket, GUAC_COMP_OVER, layer,
-                            dirty->left, dirty->top, rect,
-                            guac_display_suggest_quality(client));
-
-                /* Use PNG if no lossy formats are appropriate */
+                /* Send large, rapidly-changing updates progressively, such
+                 * that the client receives a quickly-encoded, lower-quality
+                 * intermediate frame that is refined only if a newer frame
+                 * does not arrive first */
+                if (!op.lossless && LFR_guac_display_layer_should_preview(display_layer, &op.dest, framerate)) {
+                    LFR_guac_display_layer_send_preview(display_layer, socket, &op.dest);
+                    guac_display_queue_refinement(display, &op);
+                    lossy = 1;
+                }
+
                 else
-                    guac_client_stream_png(client, socket, GUAC_COMP_OVER,
-                            layer, dirty->left, dirty->top, rect);
+                    lossy = LFR_guac_display_layer_send_img(display_layer, socket,
+                            &op.dest, framerate, op.lossless);
+
+                guac_display_report_encoding(display, display_layer, &op.dest, lossy);
+                break;
+
+            case GUAC_DISPLAY_PLAN_OPERATION_REFINE:
+
+                /* Refinement of an intermediate frame is pointless if a newer
+                 * frame is waiting, and that newer frame will instead redraw
+                 * the affected region */
+                guac_fifo_lock(&display->ops);
+                int abandon = display->frame_deferred;
+                if (abandon)
+                    guac_display_abandon_refinement(display, &op);
+                guac_fifo_unlock(&display->ops);
+
+                /* Refinements replace lossy previews and are therefore always
+                 * sent losslessly, regardless of how rapidly the region has
+                 * been changing */
+                if (!abandon) {
+                    lossy = LFR_guac_display_layer_send_img(display_layer, socket,
+                            &op.dest, framerate, 1);
+                    guac_display_report_encoding(display, display_layer, &op.dest, lossy);
+                }
 
-                cairo_surface_destroy(rect);
                 break;
 
             case GUAC_DISPLAY_PLAN_OPERATION_COPY:
@@ -377,6 +1089,7 @@ void* guac_display_worker_thread(void* data) {
                 break;
 
             case GUAC_DISPLAY_PLAN_OPERATION_NOP:
+            case GUAC_DISPLAY_PLAN_OPERATION_BANDS:
                 /* Do nothing */
                 break;
 
@@ -384,15 +1097,21 @@ void* guac_display_worker_thread(void* data) {
 
         guac_fifo_lock(&display->ops);
 
+        display->cost_model.frame_bytes += guac_display_worker_socket_written(socket) - written;
+
         /* If we're the only active worker and there are no further operations
          * pending, we've reached the end of the frame, and this is the worker
          * that will be sending that boundary to connected users */
         if (!(display->ops.state.value & GUAC_FIFO_STATE_NONEMPTY) && display->active_workers == 1) {
 
+            /* The end of a set of refinements is not the end of a new frame,
+             * but merely an improvement to the previous frame */
+            int refined = display->refining;
+
             /* Update the mouse cursor if it's been changed since the
              * last frame */
             guac_display_layer* cursor = display->cursor_buffer;
-            if (!guac_rect_is_empty(&cursor->last_frame.dirty)) {
+            if (!refined && !guac_rect_is_empty(&cursor->last_frame.dirty)) {
                 guac_protocol_send_cursor(client->socket,
                         display->last_frame.cursor_hotspot_x,
                         display->last_frame.cursor_hotspot_y,
@@ -402,7 +1121,7 @@ void* guac_display_worker_thread(void* data) {
             }
 
             /* Allow connected clients to move forward with rendering */
-            guac_client_end_multiple_frames(client, display->last_frame.frames);
+            guac_client_end_multiple_frames(client, refined ? 0 : display->last_frame.frames);
 
             /* While connected clients moves forward with rendering,
              * commit any changed contents to client-side backing buffer */
@@ -437,17 +1156,38 @@ void* guac_display_worker_thread(void* data) {
 
             }
 
+            /* Copy any newly-cached tiles into the client-side tile cache
+             * now that they have been drawn */
+            if (!refined)
+                LFR_guac_display_tile_cache_flush(display);
+
             /* This is now absolutely everything for the current frame,
              * and it's safe to flush any outstanding data */
             guac_socket_flush(client->socket);
 
-            /* Notify any watchers of render_state that a frame is no longer in progress */
-            guac_flag_set_and_lock(&display->render_state, GUAC_DISPLAY_RENDER_STATE_FRAME_NOT_IN_PROGRESS);
-            guac_flag_clear(&display->render_state, GUAC_DISPLAY_RENDER_STATE_FRAME_IN_PROGRESS);
-            guac_flag_unlock(&display->render_state);
+            /* Follow any low-quality previews with their full-quality
+             * refinements, unless a newer frame is already waiting */
+            display->refining = guac_display_begin_refinements(display);
+
+            /* Notify any watchers of render_state that a frame is no longer in
+             * progress (the frame is still considered in progress while its
+             * previews are being refined) */
+            if (!display->refining) {
+                guac_flag_set_and_lock(&display->render_state, GUAC_DISPLAY_RENDER_STATE_FRAME_NOT_IN_PROGRESS);
+                guac_flag_clear(&display->render_state, GUAC_DISPLAY_RENDER_STATE_FRAME_IN_PROGRESS);
+                guac_flag_unlock(&display->render_state);
+            }
 
             has_outstanding_frames = display->frame_deferred;
 
+            frame_bytes = display->cost_model.frame_bytes;
+            display->cost_model.frame_bytes = 0;
+            frame_ended = 1;
+
+            /* Users may move between quality tiers only here, between
+             * frames */
+            guac_display_tiers_commit(display, tier_bytes);
+
         }
 
         display->active_workers--;
@@ -455,6 +1195,23 @@ void* guac_display_worker_thread(void* data) {
 
         guac_rwlock_release_lock(&display->last_frame.lock);
 
+        /* Update the bandwidth estimate of the encoder cost model now that
+         * no locks are held */
+        if (frame_ended) {
+
+            guac_display_cost_end_frame(display, frame_bytes);
+
+            /* Image data encoded for a specific quality tier reached only the
+             * users within that tier */
+            size_t shared_bytes = frame_bytes;
+            for (int tier = 0; tier < GUAC_DISPLAY_QUALITY_TIERS; tier++)
+                shared_bytes -= tier_bytes[tier];
+
+            guac_display_tiers_end_frame(display, shared_bytes, tier_bytes);
+            frame_ended = 0;
+
+        }
+
         /* Trigger additional flush if frames were completed while we were
          * still processing the previous frame */
         if (has_outstanding_frames) {
@@ -464,6 +1221,7 @@ void* guac_display_worker_thread(void* data) {
 
     }
 
+    guac_socket_free(socket);
     return NULL;
 
 }
@@ -18,6 +18,7 @@
  */
 
 #include "config.h"
+#include "display-kernels.h"
 #include "display-plan.h"
 #include "display-priv.h"
 #include "guacamole/client.h"
@@ -122,6 +123,15 @@ guac_display* guac_display_alloc(guac_client* client) {
     guac_rwlock_init(&display->pending_frame.lock);
     display->last_frame.timestamp = display->pending_frame.timestamp = guac_timestamp_current();
 
+    /* Cache recently-sent tiles client-side by default (the cache itself is
+     * allocated only when first used) */
+    display->tile_cache.capacity = GUAC_DISPLAY_TILE_CACHE_DEFAULT_SIZE / GUAC_DISPLAY_TILE_CACHE_TILE_SIZE;
+
+    /* Use the fastest pixel kernels supported by the current processor */
+    display->kernels = guac_display_kernels_select();
+    guac_client_log(client, GUAC_LOG_DEBUG, "Using \"%s\" pixel kernels "
+            "for display change detection.", display->kernels->name);
+
     /* It's safe to discard const of the default layer here, as
      * guac_display_free_layer() function is specifically written to consider
      * the default layer as const */
@@ -137,6 +147,13 @@ guac_display* guac_display_alloc(guac_client* client) {
     guac_flag_init(&display->render_state);
     guac_flag_set(&display->render_state, GUAC_DISPLAY_RENDER_STATE_FRAME_NOT_IN_PROGRESS);
 
+    /* Init flag used to coordinate worker threads that assist with planning */
+    guac_flag_init(&display->bands.state);
+
+    /* Init flag used to hand snapshots for joining users to the thread that
+     * encodes them */
+    guac_flag_init(&display->snapshots.state);
+
     int cpu_count = guac_display_nproc();
     if (cpu_count <= 0) {
         guac_client_log(client, GUAC_LOG_WARNING, "Number of available "
@@ -148,6 +165,8 @@ guac_display* guac_display_alloc(guac_client* client) {
                 "processor(s) are available.", cpu_count);
     }
 
+    guac_display_tiers_init(&display->tiers);
+
     display->worker_thread_count = cpu_count * GUAC_DISPLAY_CPU_THREAD_FACTOR;
     display->worker_threads = guac_mem_alloc(display->worker_thread_count, sizeof(pthread_t));
     guac_client_log(client, GUAC_LOG_INFO, "Graphical updates will be encoded "
@@ -158,6 +177,16 @@ guac_display* guac_display_alloc(guac_client* client) {
     for (int i = 0; i < display->worker_thread_count; i++)
         pthread_create(&(display->worker_threads[i]), NULL, guac_display_worker_thread, display);
 
+    /* Snapshots for joining users are encoded separately from the worker
+     * threads, as those snapshots are not part of any frame */
+    if (pthread_create(&display->snapshots.thread, NULL,
+                guac_display_snapshot_thread, display) == 0)
+        display->snapshots.thread_started = 1;
+    else
+        guac_client_log(client, GUAC_LOG_WARNING, "Snapshots for joining "
+                "users will be encoded synchronously, as the thread for "
+                "encoding those snapshots could not be started.");
+
     return display;
 
 }
@@ -187,6 +216,9 @@ void guac_display_stop(guac_display* display) {
         guac_mem_free(display->worker_threads);
         display->worker_thread_count = 0;
 
+        /* Release any users still waiting on snapshots */
+        guac_display_snapshots_stop(display);
+
         /* NOTE: The only other reference to the worker_threads AT ALL is in
          * guac_display_create(). Nothing outside of guac_display_create() and
          * guac_display_stop() references worker_threads or worker_thread_count. */
@@ -215,8 +247,20 @@ void guac_display_free(guac_display* display) {
 
     guac_display_stop(display);
 
+    /* Release the tile cache (and log its statistics) while the locks guarding
+     * it still exist */
+    guac_rwlock_acquire_write_lock(&display->last_frame.lock);
+    LFW_guac_display_tile_cache_free(display);
+    guac_rwlock_release_lock(&display->last_frame.lock);
+
+    /* Log the final statistics of the encoder cost model */
+    guac_display_cost_log(display, GUAC_LOG_DEBUG);
+    guac_display_tiers_free(display);
+
     /* All locks, FIFOs, etc. are now unused and can be safely destroyed */
     guac_flag_destroy(&display->render_state);
+    guac_flag_destroy(&display->bands.state);
+    guac_flag_destroy(&display->snapshots.state);
     guac_fifo_destroy(&display->ops);
     guac_rwlock_destroy(&display->last_frame.lock);
     guac_rwlock_destroy(&display->pending_frame.lock);
@@ -231,6 +275,13 @@ void guac_display_free(guac_display* display) {
     while (display->last_frame.layers != NULL)
         guac_display_free_layer(display->last_frame.layers);
 
+    /* Free any storage retained for planning future frames (only after all
+     * layers are freed, as freeing a layer removes any references to that
+     * layer from this storage) */
+    guac_display_arena_free(&display->arena);
+    guac_mem_free(display->refinements.data);
+    guac_mem_free(display->encoding_reports.data);
+
     guac_mem_free(display);
 
 }
@@ -255,8 +306,12 @@ void guac_display_dup(guac_display* display, guac_socket* socket) {
 
         const guac_layer* layer = current->layer;
 
+        /* NOTE: guac_display_layer_get_bounds() cannot be used here, as the
+         * pending_frame lock must not be acquired while the last_frame lock
+         * is held (the reverse of the order used when frames end) */
         guac_rect layer_bounds;
-        guac_display_layer_get_bounds(current, &layer_bounds);
+        guac_rect_init(&layer_bounds, 0, 0,
+                current->last_frame.width, current->last_frame.height);
 
         int width = guac_rect_width(&layer_bounds);
         int height = guac_rect_height(&layer_bounds);
@@ -309,6 +364,9 @@ void guac_display_dup(guac_display* display, guac_socket* socket) {
 
     }
 
+    /* Sync the contents of the tile cache */
+    LFR_guac_display_tile_cache_dup(display, socket);
+
     /* Synchronize mouse cursor */
     guac_display_layer* cursor = display->cursor_buffer;
     guac_protocol_send_cursor(socket,
@@ -333,6 +391,25 @@ void guac_display_dup(guac_display* display, guac_socket* socket) {
 
 }
 
+void guac_display_set_tile_cache_size(guac_display* display, size_t size) {
+
+    guac_rwlock_acquire_write_lock(&display->pending_frame.lock);
+    guac_rwlock_acquire_write_lock(&display->last_frame.lock);
+
+    /* Discard all cached tiles, reallocating the cache at the new size when
+     * next needed */
+    LFW_guac_display_tile_cache_free(display);
+    size_t capacity = size / GUAC_DISPLAY_TILE_CACHE_TILE_SIZE;
+    if (capacity > GUAC_DISPLAY_TILE_CACHE_MAX_TILES)
+        capacity = GUAC_DISPLAY_TILE_CACHE_MAX_TILES;
+
+    display->tile_cache.capacity = capacity;
+
+    guac_rwlock_release_lock(&display->last_frame.lock);
+    guac_rwlock_release_lock(&display->pending_frame.lock);
+
+}
+
 void guac_display_notify_user_left(guac_display* display, guac_user* user) {
     guac_rwlock_acquire_write_lock(&display->pending_frame.lock);
 
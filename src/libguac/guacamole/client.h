@@ -29,6 +29,7 @@
 #include "client-fntypes.h"
 #include "client-types.h"
 #include "client-constants.h"
+#include "flag.h"
 #include "layer-types.h"
 #include "object-types.h"
 #include "pool-types.h"
@@ -188,10 +189,11 @@ struct guac_client {
     guac_rwlock __pending_users_lock;
 
     /**
-     * A timer that will periodically synchronize the list of pending users,
-     * emptying the list once synchronization is complete. Only for internal
-     * use within the client. This will be NULL until the first user joins
-     * the connection, as it is lazily instantiated at that time.
+     * A thread that synchronizes the list of pending users as soon as it is
+     * signalled via __pending_users_state, emptying the list once
+     * synchronization is complete. Only for internal use within the client.
+     * This will be NULL until the first user joins the connection, as it is
+     * lazily instantiated at that time.
      */
     pthread_t __pending_users_thread;
 
@@ -311,6 +313,28 @@ struct guac_client {
      */
     void* __plugin_handle;
 
+    /**
+     * Flag which wakes the pending users thread whenever that thread has work
+     * to do: when users join and are awaiting synchronization, when users
+     * request resynchronization, or when the client is stopping. Only for
+     * internal use within the client.
+     */
+    guac_flag __pending_users_state;
+
+    /**
+     * Non-zero if mouse input from each user should pass through a
+     * guac_input_queue before reaching the user's handlers, as requested with
+     * guac_client_coalesce_input(), zero otherwise.
+     */
+    int __coalesce_input;
+
+    /**
+     * The maximum number of mouse motion events per second that should reach
+     * the handlers of each user if __coalesce_input is set, or zero if mouse
+     * motion should only be merged and not rate limited.
+     */
+    int __max_motion_rate;
+
 };
 
 /**
@@ -477,6 +501,23 @@ int guac_client_add_user(guac_client* client, guac_user* user, int argc, char**
  */
 void guac_client_remove_user(guac_client* client, guac_user* user);
 
+/**
+ * Requests that the connection state of the given user be resynchronized, as
+ * if that user had just joined. The user is returned to the list of pending
+ * users at the next instruction boundary of the broadcast socket, after which
+ * the join_pending_handler of this guac_client brings the user up to date. If
+ * the user's socket was allocated with guac_socket_queue(), that socket
+ * resumes accepting data once the user is pending. This function does not
+ * wait for resynchronization to occur.
+ *
+ * @param client
+ *     The proxy client that the user is connected to.
+ *
+ * @param user
+ *     The user whose connection state should be resynchronized.
+ */
+void guac_client_resync_user(guac_client* client, guac_user* user);
+
 /**
  * Calls the given function on all currently-connected users of the given
  * client. The function will be given a reference to a guac_user and the
@@ -890,6 +931,27 @@ int guac_client_owner_notify_leave(guac_client* client, guac_user* quitter);
  */
 int guac_client_supports_webp(guac_client* client);
 
+/**
+ * Requests that the mouse input of all users of the given client be
+ * coalesced before reaching the mouse handlers of those users. Mouse motion
+ * received while earlier input is still being handled is merged, such that
+ * only the latest pointer location between changes in button state is
+ * handled, and mouse motion is handled at no more than the given rate. Key
+ * events, touch events and button changes are never merged or reordered, and
+ * any input still waiting is handled before any other instruction from the
+ * same user. This function should be called from within the client's init
+ * function, before any users join.
+ *
+ * @param client
+ *     The Guacamole client whose users' input should be coalesced.
+ *
+ * @param max_motion_rate
+ *     The maximum number of mouse motion events per second that should reach
+ *     the mouse handler of each user, or zero if motion should only be merged
+ *     and not rate limited.
+ */
+void guac_client_coalesce_input(guac_client* client, int max_motion_rate);
+
 /**
  * The default Guacamole client layer, layer 0.
  */
@@ -49,6 +49,13 @@
  */
 #define GUAC_DISPLAY_LAYER_RAW_BPP 4
 
+/**
+ * The default amount of client-side memory that each guac_display may use to
+ * cache recently-sent image data, in bytes. This may be overridden with
+ * guac_display_set_tile_cache_size().
+ */
+#define GUAC_DISPLAY_TILE_CACHE_DEFAULT_SIZE (8 * 1024 * 1024)
+
 /**
  * @}
  */
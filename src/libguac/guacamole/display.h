@@ -260,6 +260,46 @@ void guac_display_free(guac_display* display);
  */
 void guac_display_dup(guac_display* display, guac_socket* socket);
 
+/**
+ * Replicates the current remote display state to all pending users of the
+ * client associated with the given display, without waiting for that state
+ * to be encoded. A copy of the last frame is taken immediately, while the
+ * images within that copy are encoded and sent by a background thread.
+ * Anything else sent to each pending user after this function returns, such
+ * as frames sent once that user is promoted, is held until the copy has been
+ * sent to that user, such that no user is made to wait for another user to
+ * join. If the output of any pending user cannot be held, this function
+ * behaves exactly as guac_display_dup() invoked with the pending socket of
+ * the client.
+ *
+ * This function is intended for use within the join_pending_handler of a
+ * guac_client.
+ *
+ * @param display
+ *     The display that should be synchronized to all pending users.
+ */
+void guac_display_dup_pending(guac_display* display);
+
+/**
+ * Sets the maximum amount of client-side memory that the given guac_display
+ * may use to cache recently-sent 64x64 tiles of image data. When tiles of
+ * image data recur (such as when switching back and forth between windows),
+ * cached tiles are copied from client-side memory instead of being encoded
+ * and sent again. Any tiles currently cached are discarded. By default,
+ * GUAC_DISPLAY_TILE_CACHE_DEFAULT_SIZE bytes are used.
+ *
+ * As all users of a connection receive the same graphical updates, each user
+ * will use the given amount of memory for the cache.
+ *
+ * @param display
+ *     The guac_display to configure.
+ *
+ * @param size
+ *     The maximum amount of client-side memory that should be used to cache
+ *     tiles of image data, in bytes, or zero to disable the cache.
+ */
+void guac_display_set_tile_cache_size(guac_display* display, size_t size);
+
 /**
  * Notifies the given guac_display that a specific user has left the connection
  * and need no longer be considered for future updates/events. This SHOULD
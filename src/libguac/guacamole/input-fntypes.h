@@ -0,0 +1,59 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_INPUT_FNTYPES_H
+#define GUAC_INPUT_FNTYPES_H
+
+/**
+ * @addtogroup input
+ * @{
+ */
+
+/**
+ * Function type definitions related to the input coalescing queue
+ * (guac_input_queue).
+ *
+ * @file input-fntypes.h
+ */
+
+#include "input-types.h"
+
+/**
+ * Handler which is invoked by guac_input_queue_handle() and
+ * guac_input_queue_flush() for each input event leaving the queue, in the
+ * order those events were received.
+ *
+ * @param event
+ *     The input event being handled. This event is only valid for the
+ *     duration of the call.
+ *
+ * @param data
+ *     The arbitrary data provided to guac_input_queue_handle() or
+ *     guac_input_queue_flush().
+ */
+typedef void guac_input_event_handler(const guac_input_event* event,
+        void* data);
+
+/**
+ * @}
+ */
+
+#endif
+
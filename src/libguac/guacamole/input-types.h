@@ -0,0 +1,93 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_INPUT_TYPES_H
+#define GUAC_INPUT_TYPES_H
+
+/**
+ * @addtogroup input
+ * @{
+ */
+
+/**
+ * Provides type definitions for input events and the input coalescing queue
+ * (guac_input_queue).
+ *
+ * @file input-types.h
+ */
+
+/**
+ * All event types supported by the guac_input_event structure.
+ */
+typedef enum guac_input_event_type {
+
+    /**
+     * A mouse event, such as mouse movement or press/release of a mouse
+     * button.
+     */
+    GUAC_INPUT_EVENT_MOUSE,
+
+    /**
+     * A key event, such as press/release of a keyboard key.
+     */
+    GUAC_INPUT_EVENT_KEY,
+
+    /**
+     * A touch event, such as movement of an established touch or a change in
+     * touch pressure.
+     */
+    GUAC_INPUT_EVENT_TOUCH
+
+} guac_input_event_type;
+
+/**
+ * Event details specific to GUAC_INPUT_EVENT_MOUSE events.
+ */
+typedef struct guac_input_event_mouse_details guac_input_event_mouse_details;
+
+/**
+ * Event details specific to GUAC_INPUT_EVENT_KEY events.
+ */
+typedef struct guac_input_event_key_details guac_input_event_key_details;
+
+/**
+ * Event details specific to GUAC_INPUT_EVENT_TOUCH events.
+ */
+typedef struct guac_input_event_touch_details guac_input_event_touch_details;
+
+/**
+ * Generic input event that may represent any one of several possible event
+ * types, as dictated by guac_input_event_type.
+ */
+typedef struct guac_input_event guac_input_event;
+
+/**
+ * A thread-safe queue of input events which merges redundant mouse motion
+ * as events are added and which limits the rate at which mouse motion is
+ * handed back out.
+ */
+typedef struct guac_input_queue guac_input_queue;
+
+/**
+ * @}
+ */
+
+#endif
+
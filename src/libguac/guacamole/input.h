@@ -0,0 +1,277 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_INPUT_H
+#define GUAC_INPUT_H
+
+/**
+ * Queueing and coalescing of user input events. Mouse motion which arrives
+ * faster than it can usefully be injected into the remote desktop is merged
+ * while it waits, without ever reordering input or losing a button or key
+ * transition.
+ *
+ * @defgroup input guac_input_queue
+ * @{
+ */
+
+/**
+ * Provides a queue for user input events (guac_input_queue) which merges
+ * consecutive mouse motion and limits the rate of injected motion.
+ *
+ * @file input.h
+ */
+
+#include "input-fntypes.h"
+#include "input-types.h"
+#include "user-types.h"
+
+struct guac_input_event_mouse_details {
+
+    /**
+     * The X coordinate of the mouse pointer, in pixels. This value is not
+     * guaranteed to be within the bounds of the display area.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the mouse pointer, in pixels. This value is not
+     * guaranteed to be within the bounds of the display area.
+     */
+    int y;
+
+    /**
+     * An integer value representing the current state of each button, where
+     * the Nth bit within the integer is set to 1 if and only if the Nth mouse
+     * button is currently pressed. The lowest-order bit is the left mouse
+     * button, followed by the middle button, right button, and finally the up
+     * and down buttons of the scroll wheel.
+     *
+     * @see GUAC_CLIENT_MOUSE_LEFT
+     * @see GUAC_CLIENT_MOUSE_MIDDLE
+     * @see GUAC_CLIENT_MOUSE_RIGHT
+     * @see GUAC_CLIENT_MOUSE_SCROLL_UP
+     * @see GUAC_CLIENT_MOUSE_SCROLL_DOWN
+     */
+    int mask;
+
+};
+
+struct guac_input_event_key_details {
+
+    /**
+     * The X11 keysym of the key that was pressed or released.
+     */
+    int keysym;
+
+    /**
+     * Non-zero if the key was pressed, zero if the key was released.
+     */
+    int pressed;
+
+};
+
+struct guac_input_event_touch_details {
+
+    /**
+     * An arbitrary integer ID which uniquely identifies this contact relative
+     * to other active contacts.
+     */
+    int id;
+
+    /**
+     * The X coordinate of the center of the touch contact within the display
+     * when the event occurred, in pixels. This value is not guaranteed to be
+     * within the bounds of the display area.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the center of the touch contact within the display
+     * when the event occurred, in pixels. This value is not guaranteed to be
+     * within the bounds of the display area.
+     */
+    int y;
+
+    /**
+     * The X radius of the ellipse covering the general area of the touch
+     * contact, in pixels.
+     */
+    int x_radius;
+
+    /**
+     * The Y radius of the ellipse covering the general area of the touch
+     * contact, in pixels.
+     */
+    int y_radius;
+
+    /**
+     * The rough angle of clockwise rotation of the general area of the touch
+     * contact, in degrees.
+     */
+    double angle;
+
+    /**
+     * The relative force exerted by the touch contact, where 0 is no force
+     * (the touch has been lifted) and 1 is maximum force (the maximum amount
+     * of force representable by the device).
+     */
+    double force;
+
+};
+
+struct guac_input_event {
+
+    /**
+     * The type of this event. This value dictates which event details are
+     * relevant.
+     */
+    guac_input_event_type type;
+
+    /**
+     * The user that originated this event. NOTE: If events are handled on a
+     * thread other than the user's input thread, this pointer is not
+     * guaranteed to be valid and MUST NOT be dereferenced without verifying
+     * the pointer is actually still valid.
+     */
+    guac_user* user;
+
+    /**
+     * Event details that are type-specific.
+     */
+    union {
+
+        /**
+         * Event details specific to GUAC_INPUT_EVENT_MOUSE events. This
+         * details structure MUST NOT be used for any other event type. Doing
+         * otherwise may overwrite valid event details.
+         */
+        guac_input_event_mouse_details mouse;
+
+        /**
+         * Event details specific to GUAC_INPUT_EVENT_KEY events. This
+         * details structure MUST NOT be used for any other event type. Doing
+         * otherwise may overwrite valid event details.
+         */
+        guac_input_event_key_details key;
+
+        /**
+         * Event details specific to GUAC_INPUT_EVENT_TOUCH events. This
+         * details structure MUST NOT be used for any other event type. Doing
+         * otherwise may overwrite valid event details.
+         */
+        guac_input_event_touch_details touch;
+
+    } details;
+
+};
+
+/**
+ * Allocates a new, empty guac_input_queue. The returned queue must
+ * eventually be freed with guac_input_queue_free().
+ *
+ * @param max_events
+ *     The maximum number of events that may be waiting within the queue at
+ *     any one time. Once the queue is full, guac_input_queue_enqueue() blocks
+ *     until events are handled. This value must be greater than zero.
+ *
+ * @param max_motion_rate
+ *     The maximum number of mouse motion events per second that should be
+ *     handed out of the queue, or zero if mouse motion should not be rate
+ *     limited. Mouse motion that arrives faster than this rate is merged
+ *     until it may be handled.
+ *
+ * @return
+ *     A newly-allocated, empty guac_input_queue.
+ */
+guac_input_queue* guac_input_queue_alloc(int max_events, int max_motion_rate);
+
+/**
+ * Frees the given guac_input_queue and any events still waiting within it.
+ * No other thread may be using the queue when this function is called.
+ *
+ * @param queue
+ *     The guac_input_queue to free.
+ */
+void guac_input_queue_free(guac_input_queue* queue);
+
+/**
+ * Adds a copy of the given input event to the end of the given queue. If the
+ * event is a mouse event that changes nothing but the pointer location, and
+ * the last event in the queue is also such an event from the same user, the
+ * two are merged, with the new location replacing the old. Key events, touch
+ * events and mouse events that press or release any button are never merged.
+ * If the queue is full, this function blocks until space is available.
+ *
+ * @param queue
+ *     The guac_input_queue to add the event to.
+ *
+ * @param event
+ *     The input event to add. The event is copied, and need not remain valid
+ *     after this function returns.
+ */
+void guac_input_queue_enqueue(guac_input_queue* queue,
+        const guac_input_event* event);
+
+/**
+ * Removes and handles each event within the given queue, in order, until the
+ * queue is empty or until the only remaining event is mouse motion that must
+ * wait to honor the queue's maximum motion rate. The queue is not locked
+ * while the handler runs, so other threads may continue to add events.
+ *
+ * @param queue
+ *     The guac_input_queue to handle events from.
+ *
+ * @param handler
+ *     The handler to invoke for each event removed from the queue.
+ *
+ * @param data
+ *     Arbitrary data to pass to the handler.
+ *
+ * @return
+ *     The number of milliseconds until the mouse motion remaining in the
+ *     queue may be handled, or -1 if the queue is now empty.
+ */
+int guac_input_queue_handle(guac_input_queue* queue,
+        guac_input_event_handler* handler, void* data);
+
+/**
+ * Removes and handles every event within the given queue, in order,
+ * regardless of the queue's maximum motion rate. This should be used where
+ * pending input must take effect before something else happens, such as
+ * before handling any instruction that is not input.
+ *
+ * @param queue
+ *     The guac_input_queue to handle events from.
+ *
+ * @param handler
+ *     The handler to invoke for each event removed from the queue.
+ *
+ * @param data
+ *     Arbitrary data to pass to the handler.
+ */
+void guac_input_queue_flush(guac_input_queue* queue,
+        guac_input_event_handler* handler, void* data);
+
+/**
+ * @}
+ */
+
+#endif
+
@@ -0,0 +1,76 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_METRICS_CONSTANTS_H
+#define GUAC_METRICS_CONSTANTS_H
+
+/**
+ * Constants related to the collection of performance metrics.
+ *
+ * @file metrics-constants.h
+ */
+
+/**
+ * The number of independent copies of each counter and histogram maintained
+ * within a guac_metrics structure. Each thread updates only one copy, chosen
+ * the first time that thread records a metric, such that concurrent threads
+ * rarely update the same memory.
+ */
+#define GUAC_METRICS_SHARDS 8
+
+/**
+ * The number of buckets within each histogram. Bucket N counts values no
+ * greater than 2^N (as returned by guac_metrics_bucket_bound()), with the
+ * final bucket counting all values that exceed the bound of the preceding
+ * bucket.
+ */
+#define GUAC_METRICS_BUCKETS 25
+
+/**
+ * The maximum number of users whose output is tracked individually within a
+ * guac_metrics structure. Output to any further users is still included
+ * within the total output of the connection.
+ */
+#define GUAC_METRICS_MAX_USERS 16
+
+/**
+ * The maximum number of bytes in the ID of any user tracked within a
+ * guac_metrics structure, including the null terminator. Longer IDs are
+ * truncated.
+ */
+#define GUAC_METRICS_USER_ID_LENGTH 64
+
+/**
+ * The state of a guac_metrics_user entry that is not in use.
+ */
+#define GUAC_METRICS_USER_FREE 0
+
+/**
+ * The state of a guac_metrics_user entry that has been claimed for a user but
+ * is not yet completely initialized.
+ */
+#define GUAC_METRICS_USER_CLAIMED 1
+
+/**
+ * The state of a guac_metrics_user entry that is tracking the output of a
+ * connected user.
+ */
+#define GUAC_METRICS_USER_ACTIVE 2
+
+#endif
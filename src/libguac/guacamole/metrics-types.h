@@ -0,0 +1,161 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_METRICS_TYPES_H
+#define GUAC_METRICS_TYPES_H
+
+/**
+ * Type definitions related to the collection of performance metrics.
+ *
+ * @file metrics-types.h
+ */
+
+/**
+ * All counters maintained within a guac_metrics structure. Counters only
+ * ever increase.
+ */
+typedef enum guac_metrics_counter {
+
+    /**
+     * The number of frames sent (the number of "sync" instructions sent to
+     * all connected users).
+     */
+    GUAC_METRICS_FRAMES,
+
+    /**
+     * The number of bytes written to the network connections of all users.
+     */
+    GUAC_METRICS_BYTES_SENT,
+
+    /**
+     * The number of mouse, touch, and key events received from all users.
+     */
+    GUAC_METRICS_INPUT_EVENTS,
+
+    /**
+     * The number of tiles of image data that were found within the tile cache
+     * of a guac_display, and thus were copied client-side rather than being
+     * encoded and sent again.
+     */
+    GUAC_METRICS_TILE_CACHE_HITS,
+
+    /**
+     * The number of tiles of image data that were eligible for the tile cache
+     * of a guac_display but were not found within that cache.
+     */
+    GUAC_METRICS_TILE_CACHE_MISSES,
+
+    /**
+     * The number of counters. This is not itself a counter.
+     */
+    GUAC_METRICS_COUNTERS
+
+} guac_metrics_counter;
+
+/**
+ * All histograms maintained within a guac_metrics structure. Each histogram
+ * tracks the distribution of observed values across exponentially-sized
+ * buckets, as well as the number and sum of those values.
+ */
+typedef enum guac_metrics_histogram {
+
+    /**
+     * The time taken to plan and optimize each frame of a guac_display, in
+     * microseconds.
+     */
+    GUAC_METRICS_FRAME_PLAN_TIME,
+
+    /**
+     * The time taken to encode each PNG image, in microseconds.
+     */
+    GUAC_METRICS_ENCODE_PNG_TIME,
+
+    /**
+     * The time taken to encode each JPEG image, in microseconds.
+     */
+    GUAC_METRICS_ENCODE_JPEG_TIME,
+
+    /**
+     * The time taken to encode each WebP image, in microseconds.
+     */
+    GUAC_METRICS_ENCODE_WEBP_TIME,
+
+    /**
+     * The processing lag of the slowest user, as returned by
+     * guac_client_get_processing_lag() at the end of each frame of a
+     * guac_display, in microseconds.
+     */
+    GUAC_METRICS_PROCESSING_LAG,
+
+    /**
+     * The number of operations queued for the worker threads of a
+     * guac_display (within its "ops" FIFO) once each frame has been planned.
+     */
+    GUAC_METRICS_OPS_QUEUE_DEPTH,
+
+    /**
+     * The time between receiving user input and sending the next frame, in
+     * microseconds. Only the earliest input received prior to each frame is
+     * considered.
+     */
+    GUAC_METRICS_INPUT_LATENCY,
+
+    /**
+     * The number of histograms. This is not itself a histogram.
+     */
+    GUAC_METRICS_HISTOGRAMS
+
+} guac_metrics_histogram;
+
+/**
+ * The distribution of the values observed for a single histogram.
+ */
+typedef struct guac_metrics_distribution guac_metrics_distribution;
+
+/**
+ * A single copy of all counters and histograms, updated by only a subset of
+ * threads.
+ */
+typedef struct guac_metrics_shard guac_metrics_shard;
+
+/**
+ * The output sent to a single user.
+ */
+typedef struct guac_metrics_user guac_metrics_user;
+
+/**
+ * All performance metrics collected within a single process. This structure
+ * contains no pointers and may be safely placed within memory shared between
+ * processes, such that metrics recorded by one process can be read by
+ * another.
+ */
+typedef struct guac_metrics guac_metrics;
+
+/**
+ * The sum of all shards of one or more guac_metrics structures.
+ */
+typedef struct guac_metrics_summary guac_metrics_summary;
+
+/**
+ * The name, description, and units of a counter or histogram, for the sake
+ * of exporting that metric.
+ */
+typedef struct guac_metrics_descriptor guac_metrics_descriptor;
+
+#endif
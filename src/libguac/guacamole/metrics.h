@@ -0,0 +1,312 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_METRICS_H
+#define GUAC_METRICS_H
+
+/**
+ * Collection of performance metrics. Metrics are recorded only while a
+ * guac_metrics structure is attached with guac_metrics_attach(), and the
+ * functions recording metrics otherwise return immediately.
+ *
+ * @file metrics.h
+ */
+
+#include "metrics-constants.h"
+#include "metrics-types.h"
+
+#include <stdint.h>
+
+struct guac_metrics_distribution {
+
+    /**
+     * The number of values observed.
+     */
+    uint64_t count;
+
+    /**
+     * The sum of all values observed.
+     */
+    uint64_t sum;
+
+    /**
+     * The number of values observed within each bucket. Unlike Prometheus
+     * histograms, these counts are not cumulative: each value is counted
+     * only within the first bucket whose bound is not less than that value.
+     */
+    uint64_t buckets[GUAC_METRICS_BUCKETS];
+
+};
+
+struct guac_metrics_shard {
+
+    /**
+     * The value of each counter, indexed by guac_metrics_counter.
+     */
+    uint64_t counters[GUAC_METRICS_COUNTERS];
+
+    /**
+     * The distribution of each histogram, indexed by guac_metrics_histogram.
+     */
+    guac_metrics_distribution histograms[GUAC_METRICS_HISTOGRAMS];
+
+};
+
+struct guac_metrics_user {
+
+    /**
+     * Whether this entry is in use, as GUAC_METRICS_USER_FREE,
+     * GUAC_METRICS_USER_CLAIMED, or GUAC_METRICS_USER_ACTIVE. The remaining
+     * members of this entry should be read only while this is
+     * GUAC_METRICS_USER_ACTIVE.
+     */
+    int state;
+
+    /**
+     * The ID of the user, as assigned by guac_user_alloc().
+     */
+    char user_id[GUAC_METRICS_USER_ID_LENGTH];
+
+    /**
+     * The number of bytes written to the user's network connection.
+     */
+    uint64_t bytes_sent;
+
+};
+
+struct guac_metrics {
+
+    /**
+     * All copies of each counter and histogram. The true value of each
+     * metric is the sum across all shards.
+     */
+    guac_metrics_shard shards[GUAC_METRICS_SHARDS];
+
+    /**
+     * The output sent to each connected user.
+     */
+    guac_metrics_user users[GUAC_METRICS_MAX_USERS];
+
+    /**
+     * The time that the earliest input not yet followed by a frame was
+     * received, in microseconds relative to an arbitrary monotonic clock, or
+     * zero if all input has been followed by a frame.
+     */
+    uint64_t input_pending;
+
+};
+
+struct guac_metrics_summary {
+
+    /**
+     * The total value of each counter, indexed by guac_metrics_counter.
+     */
+    uint64_t counters[GUAC_METRICS_COUNTERS];
+
+    /**
+     * The combined distribution of each histogram, indexed by
+     * guac_metrics_histogram.
+     */
+    guac_metrics_distribution histograms[GUAC_METRICS_HISTOGRAMS];
+
+};
+
+struct guac_metrics_descriptor {
+
+    /**
+     * The name of the metric, following Prometheus naming conventions.
+     */
+    const char* name;
+
+    /**
+     * A human-readable description of the metric.
+     */
+    const char* help;
+
+    /**
+     * The factor that recorded values must be multiplied by to convert them
+     * to the base units implied by the name of the metric (for example,
+     * 0.000001 for a histogram of microseconds whose name ends with
+     * "_seconds").
+     */
+    double scale;
+
+};
+
+/**
+ * Initializes the given guac_metrics structure such that all metrics are
+ * zero and no users are tracked.
+ *
+ * @param metrics
+ *     The guac_metrics structure to initialize.
+ */
+void guac_metrics_init(guac_metrics* metrics);
+
+/**
+ * Begins recording all metrics of the current process within the given
+ * guac_metrics structure, which may be located within memory shared with
+ * another process. This function must be invoked before any other threads
+ * that may record metrics are created.
+ *
+ * @param metrics
+ *     The initialized guac_metrics structure that should receive all metrics
+ *     recorded by the current process, or NULL to stop recording metrics.
+ */
+void guac_metrics_attach(guac_metrics* metrics);
+
+/**
+ * Returns whether metrics are currently being recorded. Callers should check
+ * this before performing any work solely for the sake of recording a metric,
+ * such as measuring elapsed time.
+ *
+ * @return
+ *     Non-zero if a guac_metrics structure is attached, zero otherwise.
+ */
+int guac_metrics_enabled(void);
+
+/**
+ * Adds the given value to the given counter. If no guac_metrics structure is
+ * attached, this function has no effect.
+ *
+ * @param counter
+ *     The counter to increase.
+ *
+ * @param value
+ *     The amount to add to the counter.
+ */
+void guac_metrics_count(guac_metrics_counter counter, uint64_t value);
+
+/**
+ * Records an observation of the given value within the given histogram. If
+ * no guac_metrics structure is attached, this function has no effect.
+ *
+ * @param histogram
+ *     The histogram to record the value within.
+ *
+ * @param value
+ *     The value observed, in the units of the histogram.
+ */
+void guac_metrics_observe(guac_metrics_histogram histogram, uint64_t value);
+
+/**
+ * Notes that user input has been received, such that the time until the next
+ * frame is sent can be recorded within GUAC_METRICS_INPUT_LATENCY. If no
+ * guac_metrics structure is attached, this function has no effect.
+ */
+void guac_metrics_input_received(void);
+
+/**
+ * Notes that a frame has been sent, updating GUAC_METRICS_FRAMES and, if
+ * input has been received since the previous frame,
+ * GUAC_METRICS_INPUT_LATENCY. If no guac_metrics structure is attached, this
+ * function has no effect.
+ */
+void guac_metrics_frame_sent(void);
+
+/**
+ * Begins tracking the output sent to the user having the given ID.
+ *
+ * @param user_id
+ *     The ID of the user.
+ *
+ * @return
+ *     An opaque handle for the user that should be provided to
+ *     guac_metrics_user_sent() and guac_metrics_user_remove(), or -1 if no
+ *     guac_metrics structure is attached or too many users are already
+ *     being tracked.
+ */
+int guac_metrics_user_add(const char* user_id);
+
+/**
+ * Records that the given number of bytes have been written to the network
+ * connection of the given user, increasing both that user's total and
+ * GUAC_METRICS_BYTES_SENT. If no guac_metrics structure is attached, this
+ * function has no effect.
+ *
+ * @param user
+ *     The handle returned by guac_metrics_user_add(), or -1 if the bytes
+ *     should count only toward GUAC_METRICS_BYTES_SENT.
+ *
+ * @param bytes
+ *     The number of bytes written.
+ */
+void guac_metrics_user_sent(int user, uint64_t bytes);
+
+/**
+ * Stops tracking the output sent to the given user. The bytes sent to the
+ * user remain included within GUAC_METRICS_BYTES_SENT.
+ *
+ * @param user
+ *     The handle returned by guac_metrics_user_add(). If -1, this function
+ *     has no effect.
+ */
+void guac_metrics_user_remove(int user);
+
+/**
+ * Adds all counters and histograms of the given guac_metrics structure,
+ * which may be concurrently updated by another thread or process, to the
+ * given summary.
+ *
+ * @param summary
+ *     The summary to add to.
+ *
+ * @param metrics
+ *     The guac_metrics structure whose metrics should be added.
+ */
+void guac_metrics_accumulate(guac_metrics_summary* summary,
+        const guac_metrics* metrics);
+
+/**
+ * Returns the upper bound of the given histogram bucket, in the units of the
+ * histogram. The final bucket has no upper bound.
+ *
+ * @param bucket
+ *     The index of the bucket, which must be less than
+ *     GUAC_METRICS_BUCKETS - 1.
+ *
+ * @return
+ *     The largest value counted within the given bucket.
+ */
+uint64_t guac_metrics_bucket_bound(int bucket);
+
+/**
+ * Returns the name, description, and units of the given counter.
+ *
+ * @param counter
+ *     The counter to describe.
+ *
+ * @return
+ *     The descriptor of the given counter.
+ */
+const guac_metrics_descriptor* guac_metrics_describe_counter(
+        guac_metrics_counter counter);
+
+/**
+ * Returns the name, description, and units of the given histogram.
+ *
+ * @param histogram
+ *     The histogram to describe.
+ *
+ * @return
+ *     The descriptor of the given histogram.
+ */
+const guac_metrics_descriptor* guac_metrics_describe_histogram(
+        guac_metrics_histogram histogram);
+
+#endif
@@ -41,5 +41,14 @@
  */
 #define GUAC_INSTRUCTION_MAX_ELEMENTS 128
 
+/**
+ * The maximum number of elements, including opcodes, across all instructions
+ * returned by a single call to guac_parser_read_batch(). This is large enough
+ * to hold at least several instructions of the maximum number of elements,
+ * and typically hundreds of the small instructions that dominate input from
+ * users.
+ */
+#define GUAC_INSTRUCTION_BATCH_MAX_ELEMENTS 1024
+
 #endif
 
@@ -61,5 +61,11 @@ typedef enum guac_parse_state {
  */
 typedef struct guac_parser guac_parser;
 
+/**
+ * A single instruction parsed by guac_parser_read_batch(), one of potentially
+ * several instructions parsed from the same data received by a guac_parser.
+ */
+typedef struct guac_parser_instruction guac_parser_instruction;
+
 #endif
 
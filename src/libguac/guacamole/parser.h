@@ -30,6 +30,35 @@
 #include "parser-constants.h"
 #include "socket-types.h"
 
+struct guac_parser_instruction {
+
+    /**
+     * The opcode of the instruction.
+     */
+    char* opcode;
+
+    /**
+     * The number of arguments passed to this instruction.
+     */
+    int argc;
+
+    /**
+     * Array of all arguments passed to this instruction.
+     */
+    char** argv;
+
+    /**
+     * Array of the length, in bytes, of each argument passed to this
+     * instruction that was received using binary framing, with -1 in place
+     * of the length of each argument received as text. Arguments received
+     * using binary framing may contain arbitrary bytes, including null
+     * bytes, and are not necessarily valid UTF-8. Binary framing is accepted
+     * only if enabled with guac_parser_enable_binary_framing().
+     */
+    int* argl;
+
+};
+
 struct guac_parser {
 
     /**
@@ -73,6 +102,13 @@ struct guac_parser {
      */
     char* __instructionbuf_unparsed_start;
 
+    /**
+     * Pointer to the first character within the buffer that has not yet been
+     * parsed. This differs from __instructionbuf_unparsed_start only while an
+     * instruction has been partially parsed.
+     */
+    char* __instructionbuf_parse_start;
+
     /**
      * Pointer to the first unused section of the instruction buffer.
      */
@@ -85,6 +121,37 @@ struct guac_parser {
      */
     char __instructionbuf[32768];
 
+    /**
+     * The elements of all instructions returned by the most recent call to
+     * guac_parser_read_batch(), referenced by the guac_parser_instruction
+     * structures populated by that call.
+     */
+    char* __batch_elementv[GUAC_INSTRUCTION_BATCH_MAX_ELEMENTS];
+
+    /**
+     * The length of each element within __batch_elementv that was received
+     * using binary framing, or -1 for each element received as text.
+     */
+    int __batch_elementl[GUAC_INSTRUCTION_BATCH_MAX_ELEMENTS];
+
+    /**
+     * The length of each currently parsed element that was received using
+     * binary framing, or -1 for each element received as text.
+     */
+    int __elementl[GUAC_INSTRUCTION_MAX_ELEMENTS];
+
+    /**
+     * Non-zero if the content of the current element is binary, with its
+     * length given in bytes rather than characters, zero otherwise.
+     */
+    int __element_binary;
+
+    /**
+     * Non-zero if elements using binary framing are accepted, zero if such
+     * elements are a protocol error.
+     */
+    int __binary_framing;
+
 };
 
 /**
@@ -111,6 +178,21 @@ guac_parser* guac_parser_alloc(void);
  */
 int guac_parser_append(guac_parser* parser, void* buffer, int length);
 
+/**
+ * Allows the given parser to accept elements using binary framing, as
+ * negotiated with the "framing" instruction during the Guacamole protocol
+ * handshake. Such elements consist of their length in bytes, followed by a
+ * "#" and exactly that many bytes of arbitrary binary content, rather than
+ * their length in characters, a "." and UTF-8 content. Elements using the
+ * usual text framing continue to be accepted. The lengths of any binary
+ * elements within an instruction are provided via the argl member of each
+ * guac_parser_instruction populated by guac_parser_read_batch().
+ *
+ * @param parser
+ *     The parser that should accept elements using binary framing.
+ */
+void guac_parser_enable_binary_framing(guac_parser* parser);
+
 /**
  * Returns the number of unparsed bytes stored in the given parser's internal
  * buffers.
@@ -158,9 +240,57 @@ void guac_parser_free(guac_parser* parser);
  *         could not be read completely because the timeout elapsed, in
  *         which case guac_error will be set to GUAC_STATUS_INPUT_TIMEOUT
  *         and additional calls to guac_parser_read() will be required.
+ *         Any partial instruction received thus far is retained, thus a
+ *         timeout of zero may be used to parse instructions incrementally
+ *         as data becomes available.
  */
 int guac_parser_read(guac_parser* parser, guac_socket* socket, int usec_timeout);
 
+/**
+ * Reads at least one instruction from the given guac_socket connection, and
+ * then any further instructions that can be parsed from the data already
+ * received, without waiting for further data. This operates identically to
+ * guac_parser_read(), except that every instruction contained within data
+ * received by a single read from the guac_socket is typically parsed by a
+ * single call, rather than one call per instruction.
+ *
+ * The instructions returned remain valid only until the next call to
+ * guac_parser_read(), guac_parser_read_batch(), or guac_parser_expect() for
+ * the same parser. The opcode, argc, and argv members of the guac_parser
+ * itself are not meaningful after this function returns, as any trailing
+ * partial instruction is retained to be completed by a future call.
+ *
+ * If an error occurs reading the first instruction, -1 is returned, and
+ * guac_error is set appropriately. Errors that occur while parsing any
+ * further instructions are instead reported by the next call, such that all
+ * instructions that were successfully parsed prior to the error are
+ * returned.
+ *
+ * @param parser
+ *     The guac_parser to read instruction data from.
+ *
+ * @param socket
+ *     The guac_socket connection to use.
+ *
+ * @param usec_timeout
+ *     The maximum number of microseconds to wait for the first instruction
+ *     before giving up.
+ *
+ * @param instructions
+ *     An array of at least max_instructions guac_parser_instruction
+ *     structures which will receive the instructions read.
+ *
+ * @param max_instructions
+ *     The maximum number of instructions to read. This MUST be at least 1.
+ *
+ * @return
+ *     The number of instructions read, which will be at least 1, or -1 if no
+ *     instruction could be read.
+ */
+int guac_parser_read_batch(guac_parser* parser, guac_socket* socket,
+        int usec_timeout, guac_parser_instruction* instructions,
+        int max_instructions);
+
 /**
  * Reads a single instruction from the given guac_socket. This operates
  * identically to guac_parser_read(), except that an error is returned if
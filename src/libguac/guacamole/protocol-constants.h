@@ -40,6 +40,16 @@
  */
 #define GUACAMOLE_PROTOCOL_VERSION "VERSION_1_5_0"
 
+/**
+ * The name of GUAC_PROTOCOL_FRAMING_TEXT within the "framing" instruction.
+ */
+#define GUAC_PROTOCOL_FRAMING_TEXT_NAME "text"
+
+/**
+ * The name of GUAC_PROTOCOL_FRAMING_BINARY within the "framing" instruction.
+ */
+#define GUAC_PROTOCOL_FRAMING_BINARY_NAME "binary"
+
 /**
  * The maximum number of bytes that should be sent in any one blob instruction
  * to ensure the instruction does not exceed the maximum allowed instruction
@@ -276,6 +276,31 @@ typedef enum guac_line_join_style {
     GUAC_LINE_JOIN_ROUND = 0x2
 } guac_line_join_style;
 
+/**
+ * The ways in which binary data, such as the content of "blob" instructions,
+ * may be framed within the Guacamole protocol.
+ */
+typedef enum guac_protocol_framing {
+
+    /**
+     * Binary data is encoded as base64 within ordinary elements, each
+     * consisting of its length in characters, a ".", and its content. This
+     * framing is supported by all versions of the Guacamole protocol and is
+     * used unless the client requests otherwise.
+     */
+    GUAC_PROTOCOL_FRAMING_TEXT = 0,
+
+    /**
+     * Binary data is sent as-is within binary elements, each consisting of
+     * its length in bytes, a "#", and its content. This framing is used only
+     * if requested by the client with the "framing" instruction during the
+     * handshake and confirmed by the server with a "framing" instruction of
+     * its own.
+     */
+    GUAC_PROTOCOL_FRAMING_BINARY = 1
+
+} guac_protocol_framing;
+
 /**
  * The set of protocol versions known to guacd to handle negotiation or feature
  * support between differing versions of Guacamole clients and guacd.
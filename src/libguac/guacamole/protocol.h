@@ -312,6 +312,28 @@ int guac_protocol_send_nest(guac_socket* socket, int index,
  */
 int guac_protocol_send_nop(guac_socket* socket);
 
+/**
+ * Sends a framing instruction over the given guac_socket connection,
+ * confirming the framing that will be used for binary data sent within the
+ * remainder of the connection in response to a framing instruction received
+ * from the client during the handshake. This instruction must be sent prior
+ * to the ready instruction.
+ *
+ * If an error occurs sending the instruction, a non-zero value is
+ * returned, and guac_error is set appropriately.
+ *
+ * @param socket
+ *     The guac_socket connection to use.
+ *
+ * @param framing
+ *     The framing that will be used for binary data.
+ *
+ * @return
+ *     Zero on success, non-zero on error.
+ */
+int guac_protocol_send_framing(guac_socket* socket,
+        guac_protocol_framing framing);
+
 /**
  * Sends a ready instruction over the given guac_socket connection.
  *
@@ -21,6 +21,10 @@
 #define GUAC_RECORDING_H
 
 #include <guacamole/client.h>
+#include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
+
+#include <stdint.h>
 
 /**
  * Provides functions and structures to be use for session recording.
@@ -48,6 +52,148 @@
  */
 #define GUAC_COMMON_RECORDING_MAX_NAME_LENGTH 2048
 
+/**
+ * The number of bytes of recording data which may wait to be written to the
+ * recording file before the overflow policy of the recording applies.
+ */
+#define GUAC_RECORDING_BUFFER_SIZE 8388608
+
+/**
+ * The maximum amount of time that compressed recording data may remain
+ * buffered within the compressor while the recording is otherwise idle, in
+ * milliseconds. Periodically flushing the compressor ensures that a
+ * recording interrupted by a crash remains readable up to roughly this long
+ * before the crash.
+ */
+#define GUAC_RECORDING_SYNC_INTERVAL 5000
+
+/**
+ * The name of the compression method which writes recordings uncompressed.
+ */
+#define GUAC_RECORDING_COMPRESSION_NONE_NAME "none"
+
+/**
+ * The name of the compression method which writes recordings as gzip
+ * streams.
+ */
+#define GUAC_RECORDING_COMPRESSION_GZIP_NAME "gzip"
+
+/**
+ * The name of the compression method which writes recordings as zstd
+ * streams.
+ */
+#define GUAC_RECORDING_COMPRESSION_ZSTD_NAME "zstd"
+
+/**
+ * The name of the overflow policy which blocks further output until the
+ * recording has caught up.
+ */
+#define GUAC_RECORDING_OVERFLOW_BLOCK_NAME "block"
+
+/**
+ * The name of the overflow policy which discards whole instructions until the
+ * recording has caught up, marking the gap within the recording.
+ */
+#define GUAC_RECORDING_OVERFLOW_DROP_NAME "drop"
+
+/**
+ * The name of the overflow policy which stops the recording entirely.
+ */
+#define GUAC_RECORDING_OVERFLOW_ABORT_NAME "abort"
+
+/**
+ * The suffix appended to the name of a recording file to produce the name of
+ * its index. The index lists the keyframes within the recording, allowing
+ * playback to begin partway through the recording.
+ */
+#define GUAC_RECORDING_INDEX_SUFFIX ".idx"
+
+/**
+ * The message of the "log" instruction which marks the beginning of each
+ * keyframe within a recording. The keyframe itself ends with the following
+ * "sync" instruction.
+ */
+#define GUAC_RECORDING_KEYFRAME_MESSAGE "keyframe"
+
+/**
+ * The compression applied to the contents of a recording file.
+ */
+typedef enum guac_recording_compression {
+
+    /**
+     * The recording is written uncompressed.
+     */
+    GUAC_RECORDING_COMPRESSION_NONE,
+
+    /**
+     * The recording is written as a gzip stream.
+     */
+    GUAC_RECORDING_COMPRESSION_GZIP,
+
+    /**
+     * The recording is written as a zstd stream.
+     */
+    GUAC_RECORDING_COMPRESSION_ZSTD
+
+} guac_recording_compression;
+
+/**
+ * The action taken when recording data is produced faster than it can be
+ * written, and GUAC_RECORDING_BUFFER_SIZE bytes are already waiting.
+ */
+typedef enum guac_recording_overflow {
+
+    /**
+     * Output to the recording (and thus to the connection, if output is
+     * being recorded) blocks until space is available. The recording is
+     * always complete.
+     */
+    GUAC_RECORDING_OVERFLOW_BLOCK,
+
+    /**
+     * Whole instructions are discarded until space is available. A "log"
+     * instruction noting the number of bytes discarded is written where the
+     * gap occurred.
+     */
+    GUAC_RECORDING_OVERFLOW_DROP,
+
+    /**
+     * The recording is ended at the last complete instruction, and all
+     * further recording data is discarded.
+     */
+    GUAC_RECORDING_OVERFLOW_ABORT
+
+} guac_recording_overflow;
+
+/**
+ * Handler which writes a keyframe to a recording: every instruction required
+ * to reproduce the current display state from nothing, as would be sent to a
+ * newly-joined user, ending with a "sync" instruction.
+ *
+ * From the moment the handler begins writing the keyframe until the handler
+ * returns, no other instructions can be written to the recording, and any
+ * other thread writing to the recording (including by writing to the socket
+ * of the guac_client) will block. Handlers must therefore wait for any frame
+ * in progress to be completely sent BEFORE writing anything, and must not
+ * wait for other threads to write to the guac_client once writing has begun.
+ *
+ * @param socket
+ *     The socket of the recording that should receive the keyframe. Only the
+ *     recording receives instructions sent over this socket.
+ *
+ * @param data
+ *     The arbitrary data provided when the handler was assigned with
+ *     guac_recording_set_keyframe_handler().
+ */
+typedef void guac_recording_keyframe_handler(guac_socket* socket, void* data);
+
+/**
+ * The state of the periodic keyframes of a recording, including the thread
+ * writing those keyframes and the index listing them. The contents of this
+ * structure are private to libguac.
+ */
+typedef struct guac_recording_keyframes guac_recording_keyframes;
+
 /**
  * An in-progress session recording, attached to a guac_client instance such
  * that output Guacamole instructions may be dynamically intercepted and
@@ -95,6 +241,12 @@ typedef struct guac_recording {
      */
     int include_keys;
 
+    /**
+     * The state of the periodic keyframes written to this recording, and of
+     * the index listing those keyframes.
+     */
+    guac_recording_keyframes* __keyframes;
+
 } guac_recording;
 
 /**
@@ -106,6 +258,11 @@ typedef struct guac_recording {
  * written. The recording will automatically be closed once the client is
  * freed.
  *
+ * Recording data is written to the file by a dedicated thread, optionally
+ * compressed, such that a slow or stalled file system does not delay the
+ * connection until GUAC_RECORDING_BUFFER_SIZE bytes are waiting. What happens
+ * beyond that point is dictated by the given overflow policy.
+ *
  * @param client
  *     The client whose output should be copied to a recording file.
  *
@@ -152,6 +309,19 @@ typedef struct guac_recording {
  *     Non-zero if writing to an existing file should be allowed, or zero
  *     otherwise.
  *
+ * @param compression
+ *     The name of the compression to apply to the recording file, such as
+ *     GUAC_RECORDING_COMPRESSION_GZIP_NAME, or NULL if the recording should
+ *     not be compressed. If the named compression is unknown or unsupported
+ *     by this build of libguac, a warning is logged and the recording is
+ *     written uncompressed.
+ *
+ * @param overflow
+ *     The name of the policy to apply if recording data cannot be written as
+ *     quickly as it is produced, such as GUAC_RECORDING_OVERFLOW_DROP_NAME,
+ *     or NULL to block (GUAC_RECORDING_OVERFLOW_BLOCK_NAME). If the named
+ *     policy is unknown, a warning is logged and output blocks.
+ *
  * @return
  *     A new guac_recording structure representing the in-progress
  *     recording if the recording file has been successfully created and a
@@ -160,7 +330,138 @@ typedef struct guac_recording {
 guac_recording* guac_recording_create(guac_client* client,
         const char* path, const char* name, int create_path,
         int include_output, int include_mouse, int include_touch,
-        int include_keys, int allow_write_existing);
+        int include_keys, int allow_write_existing,
+        const char* compression, const char* overflow);
+
+/**
+ * Returns a new guac_socket which reads the Guacamole protocol data within
+ * the given recording file, decompressing that data if the file was written
+ * with gzip or zstd compression. The kind of compression, if any, is
+ * detected automatically from the contents of the file. The returned socket
+ * only supports reading, and closes the file descriptor when freed.
+ *
+ * @param fd
+ *     The file descriptor of the recording file to read, positioned at the
+ *     beginning of the file.
+ *
+ * @return
+ *     A new guac_socket which reads the uncompressed contents of the given
+ *     recording, or NULL if the file is compressed using a method not
+ *     supported by this build of libguac, in which case guac_error and
+ *     guac_error_message are set appropriately.
+ */
+guac_socket* guac_recording_socket_open(int fd);
+
+/**
+ * Repositions the given recording socket, as returned by
+ * guac_recording_socket_open(), such that the next data read begins at the
+ * given offset within the uncompressed contents of the recording. This
+ * function may only be invoked before any data has been read from the
+ * socket. Offsets within compressed recordings are reached by decompressing
+ * and discarding all preceding data.
+ *
+ * @param socket
+ *     The recording socket to reposition.
+ *
+ * @param offset
+ *     The offset within the uncompressed recording that should be read next,
+ *     in bytes.
+ *
+ * @return
+ *     Zero if the socket was repositioned successfully, non-zero if the
+ *     recording is shorter than the given offset or an error occurs, in which
+ *     case guac_error and guac_error_message are set appropriately.
+ */
+int guac_recording_socket_seek(guac_socket* socket, uint64_t offset);
+
+/**
+ * Begins writing a keyframe to the given recording every interval
+ * milliseconds, listing each keyframe within an index stored alongside the
+ * recording (the name of the recording file followed by
+ * GUAC_RECORDING_INDEX_SUFFIX). Keyframes are written only while a keyframe
+ * handler has been assigned with guac_recording_set_keyframe_handler(), and
+ * only if the recording includes output. Playback may begin at any keyframe
+ * rather than at the beginning of the recording.
+ *
+ * @param recording
+ *     The recording that should receive keyframes.
+ *
+ * @param interval
+ *     The number of milliseconds between keyframes.
+ *
+ * @return
+ *     Zero if keyframes will be written, non-zero if the index cannot be
+ *     created or keyframes are already enabled, in which case an error is
+ *     logged.
+ */
+int guac_recording_enable_keyframes(guac_recording* recording, int interval);
+
+/**
+ * Assigns the handler which writes keyframes to the given recording,
+ * replacing any previously-assigned handler. If a keyframe is currently being
+ * written by the previous handler, this function waits for that keyframe to
+ * be completed before returning, such that any data associated with the
+ * previous handler may safely be freed afterwards.
+ *
+ * @param recording
+ *     The recording whose keyframe handler should be assigned.
+ *
+ * @param handler
+ *     The handler to invoke to write each keyframe, or NULL if no further
+ *     keyframes should be written until another handler is assigned.
+ *
+ * @param data
+ *     Arbitrary data to pass to the handler.
+ */
+void guac_recording_set_keyframe_handler(guac_recording* recording,
+        guac_recording_keyframe_handler* handler, void* data);
+
+/**
+ * Locates the keyframe within a recording from which playback should begin
+ * to reach the given point in time as quickly as possible, using the index
+ * of that recording: the last keyframe at or before the given timestamp.
+ *
+ * @param index_fd
+ *     The file descriptor of the index to search, positioned at the beginning
+ *     of the index.
+ *
+ * @param timestamp
+ *     The point in time that playback should reach, as would be given within
+ *     the "sync" instructions of the recording.
+ *
+ * @param offset
+ *     Pointer to a uint64_t that should receive the offset of the keyframe
+ *     within the uncompressed recording, suitable for passing to
+ *     guac_recording_socket_seek().
+ *
+ * @return
+ *     Zero if a suitable keyframe was found, non-zero if the index does not
+ *     list any keyframe at or before the given timestamp or cannot be read.
+ */
+int guac_recording_index_find(int index_fd, guac_timestamp timestamp,
+        uint64_t* offset);
+
+/**
+ * Reads an entire recording, writing a new index listing every keyframe that
+ * the recording contains. This allows the index of a recording to be
+ * recreated if it has been lost, or created for a recording whose index was
+ * never written. Recordings written without keyframes produce an empty index,
+ * and can only be played from the beginning.
+ *
+ * @param fd
+ *     The file descriptor of the recording to read, positioned at the
+ *     beginning of the recording. The recording may be compressed. This file
+ *     descriptor is closed by this function.
+ *
+ * @param index_fd
+ *     The file descriptor of the index to write.
+ *
+ * @return
+ *     The number of keyframes listed within the new index, or -1 if the
+ *     recording cannot be read or the index cannot be written, in which case
+ *     guac_error and guac_error_message are set appropriately.
+ */
+int guac_recording_index_rebuild(int fd, int index_fd);
 
 /**
  * Frees the resources associated with the given in-progress recording. Note
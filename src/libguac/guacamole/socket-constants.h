@@ -31,6 +31,13 @@
  */
 #define GUAC_SOCKET_OUTPUT_BUFFER_SIZE 8192
 
+/**
+ * The number of bytes of data stored within each block of the queue of a
+ * socket allocated with guac_socket_queue(). Partially-filled blocks are
+ * written to the underlying socket only when the queued socket is flushed.
+ */
+#define GUAC_SOCKET_QUEUE_BLOCK_SIZE 8192
+
 /**
  * The number of milliseconds to wait between keep-alive pings on a socket
  * with keep-alive enabled.
@@ -38,15 +45,20 @@
 #define GUAC_SOCKET_KEEP_ALIVE_INTERVAL 5000
 
 /**
- * The number of bytes of data to buffer prior to bulk conversion to base64.
+ * The maximum number of bytes of data that may be held back by
+ * guac_socket_write_base64() until enough data is available to form a
+ * complete group of three bytes, or until guac_socket_flush_base64() is
+ * called. Complete groups are always encoded immediately.
  */
-#define GUAC_SOCKET_BASE64_READY_BUFFER_SIZE 768
+#define GUAC_SOCKET_BASE64_READY_BUFFER_SIZE 3
 
 /**
- * The size of the buffer required to hold GUAC_SOCKET_BASE64_READY_BUFFER_SIZE
- * bytes encoded as base64.
+ * The size of the buffer used to hold base64-encoded data prior to writing
+ * that data to a guac_socket which cannot encode base64 directly into its own
+ * buffers. This is large enough to hold the largest blob sent by
+ * guac_protocol_send_blob() in a single chunk.
  */
-#define GUAC_SOCKET_BASE64_ENCODED_BUFFER_SIZE 1024
+#define GUAC_SOCKET_BASE64_ENCODED_BUFFER_SIZE 8192
 
 #endif
 
@@ -27,6 +27,7 @@
  */
 
 #include "socket-types.h"
+#include "user-types.h"
 
 #include <unistd.h>
 
@@ -56,6 +57,55 @@ typedef ssize_t guac_socket_read_handler(guac_socket* socket,
 typedef ssize_t guac_socket_write_handler(guac_socket* socket,
         const void* buf, size_t count);
 
+/**
+ * Handler which encodes data as base64 directly into the write buffers of a
+ * socket, avoiding the intermediate copy that would otherwise be needed to
+ * pass the encoded data through guac_socket_write(). When set within a
+ * guac_socket, a handler of this type will be called by
+ * guac_socket_write_base64() for each run of complete groups of three bytes.
+ * The handler must encode and write all data provided. Padding is never
+ * requested of this handler.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param buf
+ *     The arbitrary buffer containing the data to be encoded and written.
+ *
+ * @param count
+ *     The number of bytes in the buffer. This will always be a multiple of
+ *     three.
+ *
+ * @return
+ *     The number of bytes of data encoded and written (which must be equal to
+ *     count), or -1 if an error occurs.
+ */
+typedef ssize_t guac_socket_write_base64_handler(guac_socket* socket,
+        const void* buf, size_t count);
+
+/**
+ * Handler which writes a complete element of binary data on behalf of a
+ * socket that forwards its data to other sockets, such that each of those
+ * sockets may frame the element as negotiated with its own recipient. When
+ * set within a guac_socket, a handler of this type will be called by
+ * guac_socket_write_binary() in place of writing the element itself.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param buf
+ *     The arbitrary buffer containing the content of the element.
+ *
+ * @param count
+ *     The number of bytes in the buffer.
+ *
+ * @return
+ *     The number of bytes of content written (which must be equal to count),
+ *     or -1 if an error occurs.
+ */
+typedef ssize_t guac_socket_write_binary_handler(guac_socket* socket,
+        const void* buf, size_t count);
+
 /**
  * Generic handler for socket select operations, similar to the POSIX select()
  * function. When guac_socket_select() is called on a guac_socket, its
@@ -112,5 +162,39 @@ typedef void guac_socket_unlock_handler(guac_socket* socket);
  */
 typedef int guac_socket_free_handler(guac_socket* socket);
 
+/**
+ * Handler which determines whether a particular user should receive data
+ * written to a broadcast socket. When set for the current thread using
+ * guac_socket_broadcast_set_filter(), a handler of this type will be called
+ * for each connected user whenever the current thread writes to a socket
+ * allocated with guac_socket_broadcast().
+ *
+ * @param user
+ *     The user that may receive the data being written.
+ *
+ * @param data
+ *     The arbitrary data provided to guac_socket_broadcast_set_filter().
+ *
+ * @return
+ *     Non-zero if the given user should receive the data being written, zero
+ *     otherwise.
+ */
+typedef int guac_socket_broadcast_filter(guac_user* user, void* data);
+
+/**
+ * Handler which is invoked when the queue of a socket allocated with
+ * guac_socket_queue() overflows. The handler is invoked by the thread that
+ * writes queued data to the underlying socket, with no locks held. All data
+ * written to the queued socket will be discarded until
+ * guac_socket_queue_resume() is called.
+ *
+ * @param socket
+ *     The queued guac_socket that overflowed.
+ *
+ * @param data
+ *     The arbitrary data provided to guac_socket_queue().
+ */
+typedef void guac_socket_queue_overflow_handler(guac_socket* socket, void* data);
+
 #endif
 
@@ -79,5 +79,66 @@ typedef struct guac_socket_ssl_data {
  */
 guac_socket* guac_socket_open_secure(SSL_CTX* context, int fd);
 
+/**
+ * Creates a new guac_socket which will use the given, already-established
+ * SSL/TLS session for all communication. This allows the SSL/TLS handshake to
+ * be performed separately, such as on a non-blocking file descriptor, rather
+ * than within guac_socket_open_secure(). The created guac_socket takes
+ * ownership of the given SSL structure, and freeing the guac_socket will
+ * automatically free that structure and close the associated file
+ * descriptor.
+ *
+ * @param ssl
+ *     The SSL structure of an SSL/TLS session whose handshake has completed
+ *     successfully, and which has been associated with a file descriptor via
+ *     SSL_set_fd().
+ *
+ * @return
+ *     A newly-allocated guac_socket which will transparently use the given
+ *     SSL/TLS session for all communication.
+ */
+guac_socket* guac_socket_open_secure_session(SSL* ssl);
+
+/**
+ * Returns the file descriptor underlying the given guac_socket if, and only
+ * if, that guac_socket was created with guac_socket_open_secure() and the
+ * kernel has taken over both encryption and decryption of the TLS session
+ * (kernel TLS, enabled with SSL_OP_ENABLE_KTLS). Such a file descriptor can be
+ * read and written directly with read() and write(), without involving
+ * OpenSSL. If any decrypted data remains buffered within OpenSSL, the file
+ * descriptor alone does not represent the full state of the connection, and
+ * -1 is returned.
+ *
+ * Only TLS 1.2 sessions are eligible. The kernel delivers only application
+ * data through read(), failing with EIO if any other record is received,
+ * such as an alert (including close_notify) or a TLS 1.3 KeyUpdate. For TLS
+ * 1.2 sessions without renegotiation, such records occur only as the
+ * connection is closing, and EIO can be treated as the end of the
+ * connection. TLS 1.3 sessions could be broken mid-connection by a KeyUpdate,
+ * and -1 is always returned for them.
+ *
+ * @param socket
+ *     The guac_socket to check.
+ *
+ * @return
+ *     The file descriptor underlying the given guac_socket if the kernel
+ *     handles all TLS encryption and decryption for that file descriptor,
+ *     -1 otherwise.
+ */
+int guac_socket_ssl_get_ktls_fd(guac_socket* socket);
+
+/**
+ * Relinquishes control over the TLS session of the given guac_socket, such
+ * that freeing the guac_socket will not end that session. This function
+ * should be called only after the file descriptor returned by
+ * guac_socket_ssl_get_ktls_fd() has been passed elsewhere (such as to another
+ * process) and the guac_socket will no longer be used other than to free it.
+ *
+ * @param socket
+ *     The guac_socket whose TLS session is now managed elsewhere. This MUST
+ *     be a guac_socket created with guac_socket_open_secure().
+ */
+void guac_socket_ssl_disown(guac_socket* socket);
+
 #endif
 
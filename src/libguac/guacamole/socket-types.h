@@ -26,6 +26,9 @@
  * @file socket-types.h
  */
 
+#include <stddef.h>
+#include <stdint.h>
+
 /**
  * The core I/O object of Guacamole. guac_socket provides buffered input and
  * output as well as convenience methods for efficiently writing base64 data.
@@ -49,5 +52,41 @@ typedef enum guac_socket_state {
 
 } guac_socket_state;
 
+/**
+ * Statistics describing the queue of a socket allocated with
+ * guac_socket_queue().
+ */
+typedef struct guac_socket_queue_stats {
+
+    /**
+     * The number of bytes currently queued and not yet written to the
+     * underlying socket.
+     */
+    size_t length;
+
+    /**
+     * The largest number of bytes that have been queued at any one time.
+     */
+    size_t max_length;
+
+    /**
+     * The total number of bytes that have been accepted into the queue.
+     */
+    uint64_t queued;
+
+    /**
+     * The total number of bytes that have been discarded due to the queue
+     * overflowing, including any queued data that was discarded when the
+     * overflow occurred.
+     */
+    uint64_t discarded;
+
+    /**
+     * The number of times that the queue has overflowed.
+     */
+    unsigned int overflows;
+
+} guac_socket_queue_stats;
+
 #endif
 
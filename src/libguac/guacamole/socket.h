@@ -53,6 +53,24 @@ struct guac_socket {
      */
     guac_socket_write_handler* write_handler;
 
+    /**
+     * Handler which will be called whenever complete groups of bytes written
+     * via guac_socket_write_base64() are ready to be encoded, if this socket
+     * is able to encode base64 directly into its own buffers. If NULL, data
+     * is instead encoded into __encoded_buf and written with
+     * guac_socket_write().
+     */
+    guac_socket_write_base64_handler* write_base64_handler;
+
+    /**
+     * Handler which will be called whenever an element of binary data is
+     * written via guac_socket_write_binary(), if this socket forwards its
+     * data to other sockets which may each frame that element differently.
+     * If NULL, the element is framed according to whether binary framing
+     * has been enabled for this socket.
+     */
+    guac_socket_write_binary_handler* write_binary_handler;
+
     /**
      * Handler which will be called whenever this socket needs to be flushed.
      */
@@ -98,13 +116,17 @@ struct guac_socket {
     int __ready;
 
     /**
-     * The base64 "ready" buffer. Once this buffer is filled, the data is encoded
-     * as base64 and flushed to the main write buffer.
+     * The base64 "ready" buffer, holding any bytes written via
+     * guac_socket_write_base64() which do not yet form a complete group of
+     * three bytes. These bytes are encoded once the group is completed by a
+     * later write, or with padding by guac_socket_flush_base64().
      */
     unsigned char __ready_buf[GUAC_SOCKET_BASE64_READY_BUFFER_SIZE];
 
     /**
-     * The buffer to hold the result of encoding the ready buffer as base64.
+     * The buffer to hold base64-encoded data prior to writing that data with
+     * guac_socket_write(), used only if this socket has no
+     * write_base64_handler.
      */
     char __encoded_buf[GUAC_SOCKET_BASE64_ENCODED_BUFFER_SIZE];
 
@@ -118,6 +140,12 @@ struct guac_socket {
      */
     pthread_t __keep_alive_thread;
 
+    /**
+     * Whether elements written via guac_socket_write_binary() should be
+     * written as raw binary data, rather than as base64.
+     */
+    int __binary_framing;
+
 };
 
 /**
@@ -146,6 +174,17 @@ void guac_socket_free(guac_socket* socket);
  */
 void guac_socket_require_keep_alive(guac_socket* socket);
 
+/**
+ * Declares that the recipient of data written to the given socket has
+ * negotiated binary framing, such that elements written with
+ * guac_socket_write_binary() are sent as raw binary data rather than base64.
+ * Binary framing is disabled by default.
+ *
+ * @param socket
+ *     The guac_socket whose recipient accepts binary framing.
+ */
+void guac_socket_enable_binary_framing(guac_socket* socket);
+
 /**
  * Marks the beginning of a Guacamole protocol instruction.
  *
@@ -233,6 +272,127 @@ guac_socket* guac_socket_nest(guac_socket* parent, int index);
  */
 guac_socket* guac_socket_tee(guac_socket* primary, guac_socket* secondary);
 
+/**
+ * Allocates and initializes a new guac_socket which queues all written data
+ * in memory, writing that data to the given socket from a dedicated thread
+ * such that writes to the returned socket never block on the underlying
+ * connection. Flushing the returned socket does not wait for queued data to
+ * be written; queued data is written and the underlying socket flushed in
+ * the order that the data was written and flushed. Freeing the returned
+ * guac_socket waits for all queued data to be written but has no effect on
+ * the underlying socket. Reads are delegated to the underlying socket.
+ *
+ * The queue overflows if the amount of queued data would exceed the given
+ * number of bytes, or if the oldest queued data has waited longer than the
+ * given number of milliseconds. When the queue overflows, all queued data
+ * following the first instruction boundary not yet written is discarded, as
+ * is all data written until guac_socket_queue_resume() is called, and the
+ * given overflow handler is invoked. Once writes to the underlying socket
+ * fail, all further writes to the returned socket fail.
+ *
+ * Writes to the returned socket must occur within instructions (between
+ * calls to guac_socket_instruction_begin() and guac_socket_instruction_end())
+ * for the instruction boundaries of the queued data to be known.
+ *
+ * If an error occurs while allocating the guac_socket object, NULL is returned,
+ * and guac_error is set appropriately.
+ *
+ * @param socket
+ *     The guac_socket to which all queued data should be written.
+ *
+ * @param max_bytes
+ *     The maximum number of bytes that may be queued.
+ *
+ * @param max_delay
+ *     The maximum amount of time that queued data may wait to be written to
+ *     the underlying socket, in milliseconds.
+ *
+ * @param handler
+ *     The handler to invoke when the queue overflows, or NULL if data should
+ *     simply be discarded until guac_socket_queue_resume() is called.
+ *
+ * @param data
+ *     Arbitrary data to pass to the given overflow handler.
+ *
+ * @return
+ *     A newly allocated guac_socket object which queues all data written to
+ *     the given socket, or NULL if an error occurs while allocating the
+ *     guac_socket object.
+ */
+guac_socket* guac_socket_queue(guac_socket* socket, size_t max_bytes,
+        int max_delay, guac_socket_queue_overflow_handler* handler,
+        void* data);
+
+/**
+ * Resumes accepting data written to the given socket, which must have been
+ * allocated with guac_socket_queue(), after that socket's queue has
+ * overflowed. Data is again accepted beginning with the next instruction
+ * written. If the given socket was not allocated with guac_socket_queue(),
+ * this function has no effect.
+ *
+ * @param socket
+ *     The queued guac_socket that should again accept data.
+ */
+void guac_socket_queue_resume(guac_socket* socket);
+
+/**
+ * Retrieves statistics describing the queue of the given socket, which must
+ * have been allocated with guac_socket_queue().
+ *
+ * @param socket
+ *     The queued guac_socket whose statistics should be retrieved.
+ *
+ * @param stats
+ *     The guac_socket_queue_stats to populate.
+ *
+ * @return
+ *     Zero if the statistics were retrieved successfully, non-zero if the
+ *     given socket was not allocated with guac_socket_queue().
+ */
+int guac_socket_queue_get_stats(guac_socket* socket,
+        guac_socket_queue_stats* stats);
+
+/**
+ * Credits all data subsequently written by the given socket, which must have
+ * been allocated with guac_socket_queue(), to the given entry within the user
+ * table of the metrics of the current process. If the given socket was not
+ * allocated with guac_socket_queue(), this function has no effect.
+ *
+ * @param socket
+ *     The queued guac_socket whose written data should be credited.
+ *
+ * @param user
+ *     The user table entry to credit, as returned by guac_metrics_user_add(),
+ *     or -1 to credit written data only to the aggregate metrics.
+ */
+void guac_socket_queue_set_metrics_user(guac_socket* socket, int user);
+
+/**
+ * Holds all data written to the given socket, which must have been allocated
+ * with guac_socket_queue(), until the returned socket is freed. Data already
+ * written to the given socket is first written to the underlying socket,
+ * blocking until that data has been sent. Data written to the returned socket
+ * is then written directly to the underlying socket, and thus reaches the
+ * other end of the connection before any held data. This
+ * allows state that takes time to produce, such as the initial contents of
+ * the display of a joining user, to be sent ahead of any updates to that
+ * state that are written while it is being produced.
+ *
+ * While held, the queue continues to accept data up to its maximum size,
+ * but data is not considered to be delayed. Only one hold may exist for a
+ * queue at any given time.
+ *
+ * @param socket
+ *     The queued guac_socket to hold.
+ *
+ * @return
+ *     A new guac_socket which writes directly to the underlying socket and
+ *     which releases the hold when freed with guac_socket_free(), or NULL if
+ *     the given socket was not allocated with guac_socket_queue(), is
+ *     already held, or can no longer be written to.
+ */
+guac_socket* guac_socket_queue_hold(guac_socket* socket);
+
 /**
  * Allocates and initializes a new guac_socket which duplicates all
  * instructions written across the sockets of each connected user of the
@@ -285,6 +445,32 @@ guac_socket* guac_socket_broadcast(guac_client* client);
  */
 guac_socket* guac_socket_broadcast_pending(guac_client* client);
 
+/**
+ * Restricts the users that receive data written by the current thread to any
+ * socket allocated with guac_socket_broadcast(), including any such socket
+ * that has been wrapped by another socket, such as a socket created with
+ * guac_socket_tee(). Only users for which the given filter returns non-zero
+ * will receive data. The filter applies only to writes performed by the
+ * current thread, and remains in effect until replaced or cleared with a
+ * call to this function with a NULL filter.
+ *
+ * The filter must not change while the current thread is in the middle of
+ * writing an instruction, and must not change the result it returns for any
+ * particular user until the current thread has finished writing the
+ * instruction, or the instruction boundaries of affected users may be
+ * corrupted.
+ *
+ * @param filter
+ *     The filter to invoke for each connected user when the current thread
+ *     writes to a broadcast socket, or NULL to broadcast to all connected
+ *     users.
+ *
+ * @param data
+ *     Arbitrary data to pass to the given filter.
+ */
+void guac_socket_broadcast_set_filter(guac_socket_broadcast_filter* filter,
+        void* data);
+
 /**
  * Writes the given unsigned int to the given guac_socket object. The data
  * written may be buffered until the buffer is flushed automatically or
@@ -331,6 +517,33 @@ ssize_t guac_socket_write_string(guac_socket* socket, const char* str);
  */
 ssize_t guac_socket_write_base64(guac_socket* socket, const void* buf, size_t count);
 
+/**
+ * Writes the given binary data to the given guac_socket object as a complete
+ * element of the instruction currently being written, including its length
+ * prefix. If binary framing has been enabled with
+ * guac_socket_enable_binary_framing(), the element is written as its length
+ * in bytes, followed by a "#" and the data itself. Otherwise, the element is
+ * written as the length of the base64 encoding of the data, followed by a "."
+ * and that base64 encoding. Sockets that forward their data to other sockets
+ * leave this choice to each of those sockets.
+ *
+ * If an error occurs while writing, a non-zero value is returned, and
+ * guac_error is set appropriately.
+ *
+ * @param socket
+ *     The guac_socket object to write to.
+ *
+ * @param buf
+ *     A buffer containing the data to write.
+ *
+ * @param count
+ *     The number of bytes to write.
+ *
+ * @return
+ *     Zero on success, or non-zero if an error occurs while writing.
+ */
+ssize_t guac_socket_write_binary(guac_socket* socket, const void* buf, size_t count);
+
 /**
  * Writes the given data to the specified socket. The data written may be
  * buffered until the buffer is flushed automatically or manually.
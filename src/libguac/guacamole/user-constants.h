@@ -64,5 +64,25 @@
  */
 #define GUAC_USER_STREAM_INDEX_MIMETYPE "application/vnd.glyptodon.guacamole.stream-index+json"
 
+/**
+ * The maximum number of bytes that may be queued for any one user before
+ * that user is considered to have fallen behind.
+ */
+#define GUAC_USER_OUTPUT_QUEUE_MAX_BYTES 16777216
+
+/**
+ * The maximum amount of time that data queued for any one user may wait to
+ * be sent, in milliseconds, before that user is considered to have fallen
+ * behind.
+ */
+#define GUAC_USER_OUTPUT_QUEUE_MAX_DELAY 15000
+
+/**
+ * The minimum amount of time between resynchronizations of a user that has
+ * fallen behind, in milliseconds. A user that falls behind again more quickly
+ * than this is disconnected.
+ */
+#define GUAC_USER_OUTPUT_RESYNC_INTERVAL 60000
+
 #endif
 
@@ -29,6 +29,7 @@
  */
 
 #include "client-types.h"
+#include "input-types.h"
 #include "layer-types.h"
 #include "pool-types.h"
 #include "socket-types.h"
@@ -110,6 +111,14 @@ struct guac_user_info {
      */
     const char* name;
 
+    /**
+     * The framing used for binary data, such as the content of "blob"
+     * instructions, in both directions. This will be
+     * GUAC_PROTOCOL_FRAMING_BINARY only if the client requested binary
+     * framing during the handshake.
+     */
+    guac_protocol_framing framing;
+
 };
 
 struct guac_user {
@@ -164,6 +173,14 @@ struct guac_user {
      */
     guac_user* __next;
 
+    /**
+     * Non-zero if this user has fallen so far behind that its connection
+     * state must be resynchronized, zero otherwise. This is currently only
+     * used internally by guac_client. To request resynchronization, use
+     * guac_client_resync_user().
+     */
+    int __resync;
+
     /**
      * The time (in milliseconds) of receipt of the last sync message from
      * the user.
@@ -538,6 +555,15 @@ struct guac_user {
      */
     guac_user_touch_handler* touch_handler;
 
+    /**
+     * The queue through which this user's mouse, key and touch events pass
+     * before reaching the handlers above, or NULL if input is passed to those
+     * handlers as soon as it is received. This queue exists only while the
+     * user's input thread is running, and only if requested by the client
+     * via guac_client_coalesce_input().
+     */
+    guac_input_queue* __input_queue;
+
 };
 
 /**
@@ -0,0 +1,258 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "guacamole/fifo.h"
+#include "guacamole/input.h"
+#include "guacamole/mem.h"
+#include "guacamole/timestamp.h"
+#include "guacamole/user.h"
+
+#include <stddef.h>
+
+/**
+ * A single input event stored within a guac_input_queue, along with whether
+ * that event is pure mouse motion and thus eligible for merging and rate
+ * limiting.
+ */
+typedef struct guac_input_queue_entry {
+
+    /**
+     * The input event itself.
+     */
+    guac_input_event event;
+
+    /**
+     * Non-zero if this event is a mouse event from the same user and with the
+     * same button mask as the mouse event queued before it, such that it does
+     * nothing but move the mouse pointer, zero otherwise.
+     */
+    int motion;
+
+} guac_input_queue_entry;
+
+struct guac_input_queue {
+
+    /**
+     * The underlying FIFO of guac_input_queue_entry. The storage for this
+     * FIFO immediately follows the guac_input_queue structure. The lock of
+     * this FIFO also guards all other members of the queue.
+     */
+    guac_fifo entries;
+
+    /**
+     * The minimum number of milliseconds that must elapse between mouse
+     * motion events handed out of the queue, or zero if mouse motion is not
+     * rate limited.
+     */
+    int motion_interval;
+
+    /**
+     * The time at which a mouse event was last handed out of the queue.
+     */
+    guac_timestamp last_motion;
+
+    /**
+     * The user that originated the most recently queued mouse event, or NULL
+     * if no mouse event has yet been queued.
+     */
+    guac_user* last_mouse_user;
+
+    /**
+     * The button mask of the most recently queued mouse event.
+     */
+    int last_mouse_mask;
+
+};
+
+/**
+ * Returns the entry at the given position within the given queue, relative
+ * to the head of the queue. The queue MUST be locked, and the position MUST
+ * refer to an entry that is actually present.
+ *
+ * @param queue
+ *     The guac_input_queue to retrieve the entry from.
+ *
+ * @param index
+ *     The position of the entry, where 0 is the head of the queue.
+ *
+ * @return
+ *     The entry at the given position.
+ */
+static guac_input_queue_entry* guac_input_queue_entry_at(
+        guac_input_queue* queue, size_t index) {
+
+    guac_fifo* fifo = &queue->entries;
+    guac_input_queue_entry* entries = (guac_input_queue_entry*)
+        ((char*) fifo + fifo->items_offset);
+
+    return &entries[(fifo->head + index) % fifo->max_items];
+
+}
+
+guac_input_queue* guac_input_queue_alloc(int max_events, int max_motion_rate) {
+
+    /* Allocate queue and its entries as a single block */
+    guac_input_queue* queue = guac_mem_zalloc(
+            guac_mem_ckd_add_or_die(sizeof(guac_input_queue),
+                guac_mem_ckd_mul_or_die(max_events,
+                    sizeof(guac_input_queue_entry))));
+
+    guac_fifo_init(&queue->entries, queue + 1, max_events,
+            sizeof(guac_input_queue_entry));
+
+    /* Rates beyond one event per millisecond are effectively unlimited */
+    if (max_motion_rate > 0)
+        queue->motion_interval = 1000 / max_motion_rate;
+
+    return queue;
+
+}
+
+void guac_input_queue_free(guac_input_queue* queue) {
+    guac_fifo_destroy(&queue->entries);
+    guac_mem_free(queue);
+}
+
+void guac_input_queue_enqueue(guac_input_queue* queue,
+        const guac_input_event* event) {
+
+    guac_fifo* fifo = &queue->entries;
+    guac_fifo_lock(fifo);
+
+    /* Merge pure motion into the motion already waiting at the end of the
+     * queue, if any, rather than queueing each intermediate location */
+    if (event->type == GUAC_INPUT_EVENT_MOUSE && fifo->item_count > 0) {
+
+        guac_input_queue_entry* tail = guac_input_queue_entry_at(queue,
+                fifo->item_count - 1);
+
+        if (tail->motion
+                && tail->event.user == event->user
+                && tail->event.details.mouse.mask == event->details.mouse.mask) {
+            tail->event.details.mouse.x = event->details.mouse.x;
+            tail->event.details.mouse.y = event->details.mouse.y;
+            guac_fifo_unlock(fifo);
+            return;
+        }
+
+    }
+
+    guac_fifo_unlock(fifo);
+
+    /* Otherwise, queue as a new event, blocking if necessary until there is
+     * space */
+    guac_input_queue_entry entry = { .event = *event };
+    guac_fifo_enqueue_and_lock(fifo, &entry);
+
+    /* Determine whether the event is pure motion only once it is actually
+     * in place, as other events may have been queued while waiting */
+    if (event->type == GUAC_INPUT_EVENT_MOUSE) {
+
+        guac_input_queue_entry* tail = guac_input_queue_entry_at(queue,
+                fifo->item_count - 1);
+
+        tail->motion = (event->user == queue->last_mouse_user
+                && event->details.mouse.mask == queue->last_mouse_mask);
+
+        queue->last_mouse_user = event->user;
+        queue->last_mouse_mask = event->details.mouse.mask;
+
+    }
+
+    guac_fifo_unlock(fifo);
+
+}
+
+/**
+ * Removes and handles events from the given queue, in order, until the queue
+ * is empty or, if the motion rate is being honored, until the only remaining
+ * event is mouse motion that is not yet permitted to be handled.
+ *
+ * @param queue
+ *     The guac_input_queue to handle events from.
+ *
+ * @param handler
+ *     The handler to invoke for each event removed from the queue.
+ *
+ * @param data
+ *     Arbitrary data to pass to the handler.
+ *
+ * @param limit_motion
+ *     Non-zero if the queue's maximum motion rate should be honored, zero if
+ *     all events should be handled immediately.
+ *
+ * @return
+ *     The number of milliseconds until the mouse motion remaining in the
+ *     queue may be handled, or -1 if the queue is now empty.
+ */
+static int guac_input_queue_dispatch(guac_input_queue* queue,
+        guac_input_event_handler* handler, void* data, int limit_motion) {
+
+    guac_fifo* fifo = &queue->entries;
+    guac_fifo_lock(fifo);
+
+    guac_input_queue_entry entry;
+    while (fifo->item_count > 0) {
+
+        /* Hold back motion only while nothing else is waiting behind it, as
+         * that motion may still absorb further motion and later events must
+         * not be delayed */
+        guac_input_queue_entry* head = guac_input_queue_entry_at(queue, 0);
+        if (limit_motion && head->motion && fifo->item_count == 1
+                && queue->motion_interval > 0) {
+
+            guac_timestamp elapsed = guac_timestamp_current() - queue->last_motion;
+            if (elapsed >= 0 && elapsed < queue->motion_interval) {
+                guac_fifo_unlock(fifo);
+                return queue->motion_interval - elapsed;
+            }
+
+        }
+
+        guac_fifo_timed_dequeue_and_lock(fifo, &entry, 0);
+        guac_fifo_unlock(fifo);
+
+        if (entry.event.type == GUAC_INPUT_EVENT_MOUSE)
+            queue->last_motion = guac_timestamp_current();
+
+        /* Allow further events to be queued while this event is handled */
+        guac_fifo_unlock(fifo);
+        handler(&entry.event, data);
+        guac_fifo_lock(fifo);
+
+    }
+
+    guac_fifo_unlock(fifo);
+    return -1;
+
+}
+
+int guac_input_queue_handle(guac_input_queue* queue,
+        guac_input_event_handler* handler, void* data) {
+    return guac_input_queue_dispatch(queue, handler, data, 1);
+}
+
+void guac_input_queue_flush(guac_input_queue* queue,
+        guac_input_event_handler* handler, void* data) {
+    guac_input_queue_dispatch(queue, handler, data, 0);
+}
+
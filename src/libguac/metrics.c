@@ -0,0 +1,419 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "guacamole/metrics.h"
+#include "guacamole/string.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+
+#ifdef HAVE_CLOCK_GETTIME
+#include <time.h>
+#endif
+
+/**
+ * The guac_metrics structure receiving all metrics recorded by the current
+ * process, or NULL if metrics are not being recorded.
+ */
+static guac_metrics* guac_metrics_current = NULL;
+
+/**
+ * The key used to store the shard assigned to each thread, offset by one
+ * such that a thread not yet assigned a shard has the value NULL.
+ */
+static pthread_key_t guac_metrics_shard_key;
+
+/**
+ * Guards one-time creation of guac_metrics_shard_key.
+ */
+static pthread_once_t guac_metrics_shard_key_init = PTHREAD_ONCE_INIT;
+
+/**
+ * The number of threads that have been assigned a shard.
+ */
+static unsigned int guac_metrics_threads = 0;
+
+/**
+ * The name, description, and units of each counter.
+ */
+static const guac_metrics_descriptor GUAC_METRICS_COUNTER_DESCRIPTORS[GUAC_METRICS_COUNTERS] = {
+
+    [GUAC_METRICS_FRAMES] = {
+        .name  = "guac_frames_total",
+        .help  = "Frames sent to connected users.",
+        .scale = 1
+    },
+
+    [GUAC_METRICS_BYTES_SENT] = {
+        .name  = "guac_sent_bytes_total",
+        .help  = "Bytes written to the network connections of all users.",
+        .scale = 1
+    },
+
+    [GUAC_METRICS_INPUT_EVENTS] = {
+        .name  = "guac_input_events_total",
+        .help  = "Mouse, touch, and key events received from users.",
+        .scale = 1
+    },
+
+    [GUAC_METRICS_TILE_CACHE_HITS] = {
+        .name  = "guac_tile_cache_hits_total",
+        .help  = "Tiles of image data copied from the client-side tile cache instead of being sent.",
+        .scale = 1
+    },
+
+    [GUAC_METRICS_TILE_CACHE_MISSES] = {
+        .name  = "guac_tile_cache_misses_total",
+        .help  = "Tiles of image data eligible for the tile cache but not found within it.",
+        .scale = 1
+    }
+
+};
+
+/**
+ * The name, description, and units of each histogram.
+ */
+static const guac_metrics_descriptor GUAC_METRICS_HISTOGRAM_DESCRIPTORS[GUAC_METRICS_HISTOGRAMS] = {
+
+    [GUAC_METRICS_FRAME_PLAN_TIME] = {
+        .name  = "guac_frame_plan_seconds",
+        .help  = "Time taken to plan and optimize each display frame.",
+        .scale = 0.000001
+    },
+
+    [GUAC_METRICS_ENCODE_PNG_TIME] = {
+        .name  = "guac_encode_png_seconds",
+        .help  = "Time taken to encode each PNG image.",
+        .scale = 0.000001
+    },
+
+    [GUAC_METRICS_ENCODE_JPEG_TIME] = {
+        .name  = "guac_encode_jpeg_seconds",
+        .help  = "Time taken to encode each JPEG image.",
+        .scale = 0.000001
+    },
+
+    [GUAC_METRICS_ENCODE_WEBP_TIME] = {
+        .name  = "guac_encode_webp_seconds",
+        .help  = "Time taken to encode each WebP image.",
+        .scale = 0.000001
+    },
+
+    [GUAC_METRICS_PROCESSING_LAG] = {
+        .name  = "guac_processing_lag_seconds",
+        .help  = "Processing lag of the slowest user at the end of each display frame.",
+        .scale = 0.000001
+    },
+
+    [GUAC_METRICS_OPS_QUEUE_DEPTH] = {
+        .name  = "guac_display_ops_queue_depth",
+        .help  = "Operations queued for display worker threads once each frame is planned.",
+        .scale = 1
+    },
+
+    [GUAC_METRICS_INPUT_LATENCY] = {
+        .name  = "guac_input_to_frame_seconds",
+        .help  = "Time from receiving user input to sending the next frame.",
+        .scale = 0.000001
+    }
+
+};
+
+/**
+ * Returns the current time in microseconds, relative to an arbitrary
+ * monotonic clock where available. The value returned is never zero.
+ *
+ * @return
+ *     The current time in microseconds.
+ */
+static uint64_t guac_metrics_usec(void) {
+
+    uint64_t usec;
+
+#ifdef HAVE_CLOCK_GETTIME
+
+    struct timespec current;
+
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &current);
+#else
+    clock_gettime(CLOCK_REALTIME, &current);
+#endif
+
+    usec = (uint64_t) current.tv_sec * 1000000 + current.tv_nsec / 1000;
+
+#else
+
+    struct timeval current;
+    gettimeofday(&current, NULL);
+
+    usec = (uint64_t) current.tv_sec * 1000000 + current.tv_usec;
+
+#endif
+
+    /* Zero is reserved to represent the absence of a time */
+    return usec ? usec : 1;
+
+}
+
+/**
+ * Creates guac_metrics_shard_key. This function is invoked via
+ * pthread_once().
+ */
+static void guac_metrics_create_shard_key(void) {
+    pthread_key_create(&guac_metrics_shard_key, NULL);
+}
+
+/**
+ * Returns the shard of the given guac_metrics structure that should be
+ * updated by the current thread, assigning shards to threads in round-robin
+ * fashion.
+ *
+ * @param metrics
+ *     The guac_metrics structure being updated.
+ *
+ * @return
+ *     The shard to be updated by the current thread.
+ */
+static guac_metrics_shard* guac_metrics_get_shard(guac_metrics* metrics) {
+
+    pthread_once(&guac_metrics_shard_key_init, guac_metrics_create_shard_key);
+
+    uintptr_t index = (uintptr_t) pthread_getspecific(guac_metrics_shard_key);
+    if (index == 0) {
+        index = __atomic_fetch_add(&guac_metrics_threads, 1, __ATOMIC_RELAXED)
+            % GUAC_METRICS_SHARDS + 1;
+        pthread_setspecific(guac_metrics_shard_key, (void*) index);
+    }
+
+    return &metrics->shards[index - 1];
+
+}
+
+/**
+ * Returns the index of the histogram bucket that counts the given value.
+ *
+ * @param value
+ *     The value observed.
+ *
+ * @return
+ *     The index of the bucket that counts the given value.
+ */
+static int guac_metrics_bucket(uint64_t value) {
+
+    if (value <= 1)
+        return 0;
+
+    /* Smallest N such that value <= 2^N */
+    int bucket = 64 - __builtin_clzll(value - 1);
+    if (bucket > GUAC_METRICS_BUCKETS - 1)
+        return GUAC_METRICS_BUCKETS - 1;
+
+    return bucket;
+
+}
+
+void guac_metrics_init(guac_metrics* metrics) {
+    memset(metrics, 0, sizeof(guac_metrics));
+}
+
+void guac_metrics_attach(guac_metrics* metrics) {
+    guac_metrics_current = metrics;
+}
+
+int guac_metrics_enabled(void) {
+    return guac_metrics_current != NULL;
+}
+
+void guac_metrics_count(guac_metrics_counter counter, uint64_t value) {
+
+    guac_metrics* metrics = guac_metrics_current;
+    if (metrics == NULL)
+        return;
+
+    guac_metrics_shard* shard = guac_metrics_get_shard(metrics);
+    __atomic_fetch_add(&shard->counters[counter], value, __ATOMIC_RELAXED);
+
+}
+
+void guac_metrics_observe(guac_metrics_histogram histogram, uint64_t value) {
+
+    guac_metrics* metrics = guac_metrics_current;
+    if (metrics == NULL)
+        return;
+
+    guac_metrics_shard* shard = guac_metrics_get_shard(metrics);
+    guac_metrics_distribution* distribution = &shard->histograms[histogram];
+
+    __atomic_fetch_add(&distribution->buckets[guac_metrics_bucket(value)], 1,
+            __ATOMIC_RELAXED);
+    __atomic_fetch_add(&distribution->sum, value, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&distribution->count, 1, __ATOMIC_RELAXED);
+
+}
+
+void guac_metrics_input_received(void) {
+
+    guac_metrics* metrics = guac_metrics_current;
+    if (metrics == NULL)
+        return;
+
+    guac_metrics_count(GUAC_METRICS_INPUT_EVENTS, 1);
+
+    /* Only the earliest input since the last frame is timed, thus there is
+     * nothing further to do if input is already pending */
+    if (__atomic_load_n(&metrics->input_pending, __ATOMIC_RELAXED))
+        return;
+
+    uint64_t expected = 0;
+    __atomic_compare_exchange_n(&metrics->input_pending, &expected,
+            guac_metrics_usec(), 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+
+}
+
+void guac_metrics_frame_sent(void) {
+
+    guac_metrics* metrics = guac_metrics_current;
+    if (metrics == NULL)
+        return;
+
+    guac_metrics_count(GUAC_METRICS_FRAMES, 1);
+
+    uint64_t received = __atomic_exchange_n(&metrics->input_pending, 0,
+            __ATOMIC_RELAXED);
+
+    if (received) {
+        uint64_t now = guac_metrics_usec();
+        guac_metrics_observe(GUAC_METRICS_INPUT_LATENCY,
+                now > received ? now - received : 0);
+    }
+
+}
+
+int guac_metrics_user_add(const char* user_id) {
+
+    guac_metrics* metrics = guac_metrics_current;
+    if (metrics == NULL)
+        return -1;
+
+    for (int i = 0; i < GUAC_METRICS_MAX_USERS; i++) {
+
+        guac_metrics_user* user = &metrics->users[i];
+
+        int expected = GUAC_METRICS_USER_FREE;
+        if (!__atomic_compare_exchange_n(&user->state, &expected,
+                    GUAC_METRICS_USER_CLAIMED, 0, __ATOMIC_ACQUIRE,
+                    __ATOMIC_RELAXED))
+            continue;
+
+        guac_strlcpy(user->user_id, user_id, sizeof(user->user_id));
+        __atomic_store_n(&user->bytes_sent, 0, __ATOMIC_RELAXED);
+
+        /* Publish the entry only once it is completely initialized */
+        __atomic_store_n(&user->state, GUAC_METRICS_USER_ACTIVE,
+                __ATOMIC_RELEASE);
+
+        return i;
+
+    }
+
+    return -1;
+
+}
+
+void guac_metrics_user_sent(int user, uint64_t bytes) {
+
+    guac_metrics* metrics = guac_metrics_current;
+    if (metrics == NULL)
+        return;
+
+    guac_metrics_count(GUAC_METRICS_BYTES_SENT, bytes);
+
+    if (user >= 0 && user < GUAC_METRICS_MAX_USERS)
+        __atomic_fetch_add(&metrics->users[user].bytes_sent, bytes,
+                __ATOMIC_RELAXED);
+
+}
+
+void guac_metrics_user_remove(int user) {
+
+    guac_metrics* metrics = guac_metrics_current;
+    if (metrics == NULL || user < 0 || user >= GUAC_METRICS_MAX_USERS)
+        return;
+
+    __atomic_store_n(&metrics->users[user].state, GUAC_METRICS_USER_FREE,
+            __ATOMIC_RELEASE);
+
+}
+
+void guac_metrics_accumulate(guac_metrics_summary* summary,
+        const guac_metrics* metrics) {
+
+    for (int i = 0; i < GUAC_METRICS_SHARDS; i++) {
+
+        const guac_metrics_shard* shard = &metrics->shards[i];
+
+        for (int counter = 0; counter < GUAC_METRICS_COUNTERS; counter++)
+            summary->counters[counter] += __atomic_load_n(
+                    &shard->counters[counter], __ATOMIC_RELAXED);
+
+        for (int histogram = 0; histogram < GUAC_METRICS_HISTOGRAMS; histogram++) {
+
+            const guac_metrics_distribution* src = &shard->histograms[histogram];
+            guac_metrics_distribution* dst = &summary->histograms[histogram];
+
+            /* Buckets are read before the count and sum, such that a
+             * concurrent observation is never reflected within the count
+             * without also being reflected within the buckets */
+            uint64_t bucket_total = 0;
+            for (int bucket = 0; bucket < GUAC_METRICS_BUCKETS; bucket++) {
+                uint64_t value = __atomic_load_n(&src->buckets[bucket],
+                        __ATOMIC_RELAXED);
+                dst->buckets[bucket] += value;
+                bucket_total += value;
+            }
+
+            /* Never report more observations than the buckets contain */
+            uint64_t count = __atomic_load_n(&src->count, __ATOMIC_RELAXED);
+            dst->count += (count < bucket_total) ? count : bucket_total;
+            dst->sum += __atomic_load_n(&src->sum, __ATOMIC_RELAXED);
+
+        }
+
+    }
+
+}
+
+uint64_t guac_metrics_bucket_bound(int bucket) {
+    return (uint64_t) 1 << bucket;
+}
+
+const guac_metrics_descriptor* guac_metrics_describe_counter(
+        guac_metrics_counter counter) {
+    return &GUAC_METRICS_COUNTER_DESCRIPTORS[counter];
+}
+
+const guac_metrics_descriptor* guac_metrics_describe_histogram(
+        guac_metrics_histogram histogram) {
+    return &GUAC_METRICS_HISTOGRAM_DESCRIPTORS[histogram];
+}
@@ -0,0 +1,300 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "parser-kernels.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GUAC_PARSER_KERNEL_NEON
+#endif
+
+/*
+ * NOTE: All kernels within this file MUST produce results that are identical
+ * to those of the scalar kernel, including for buffers that are not a
+ * multiple of the vector width. The unit tests for these kernels verify each
+ * supported variant against the scalar variant.
+ */
+
+/* ---------------- SCALAR ---------------- */
+
+/**
+ * Returns whether the scalar kernel is supported by the current processor.
+ * The scalar kernel does not depend on any processor features and is thus
+ * always supported.
+ *
+ * @return
+ *     Always non-zero.
+ */
+static int guac_parser_kernel_scalar_supported(void) {
+    return 1;
+}
+
+/**
+ * Scalar implementation of guac_parser_kernel_span_ascii, checking one byte
+ * at a time.
+ *
+ * @see guac_parser_kernel_span_ascii
+ */
+static size_t guac_parser_span_ascii_scalar(const unsigned char* data,
+        size_t length) {
+
+    size_t span = 0;
+    while (span < length && data[span] < 0x80)
+        span++;
+
+    return span;
+
+}
+
+const guac_parser_kernel guac_parser_kernel_scalar = {
+    .name       = "scalar",
+    .supported  = guac_parser_kernel_scalar_supported,
+    .span_ascii = guac_parser_span_ascii_scalar
+};
+
+/* ---------------- SSE2 / AVX2 ---------------- */
+
+#ifdef HAVE_X86_SIMD
+
+/**
+ * Function attribute which allows the compiler to emit SSE2 instructions
+ * within a function, regardless of the instruction set otherwise targeted.
+ */
+#define GUAC_PARSER_KERNEL_SSE2 __attribute__((target("sse2")))
+
+/**
+ * Function attribute which allows the compiler to emit AVX2 instructions
+ * within a function, regardless of the instruction set otherwise targeted.
+ */
+#define GUAC_PARSER_KERNEL_AVX2 __attribute__((target("avx2")))
+
+/**
+ * Returns whether the current processor supports SSE2.
+ *
+ * @return
+ *     Non-zero if SSE2 is supported, zero otherwise.
+ */
+static int guac_parser_kernel_sse2_supported(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+/**
+ * Returns whether the current processor supports AVX2.
+ *
+ * @return
+ *     Non-zero if AVX2 is supported, zero otherwise.
+ */
+static int guac_parser_kernel_avx2_supported(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+/**
+ * SSE2 implementation of guac_parser_kernel_span_ascii, checking sixteen
+ * bytes at a time. The most significant bit of each byte is gathered into a
+ * mask, the lowest set bit of which locates the first non-ASCII byte.
+ *
+ * @see guac_parser_kernel_span_ascii
+ */
+GUAC_PARSER_KERNEL_SSE2
+static size_t guac_parser_span_ascii_sse2(const unsigned char* data,
+        size_t length) {
+
+    size_t span = 0;
+
+    while (length - span >= 16) {
+
+        __m128i bytes = _mm_loadu_si128((const __m128i*) (data + span));
+        int mask = _mm_movemask_epi8(bytes);
+        if (mask)
+            return span + __builtin_ctz(mask);
+
+        span += 16;
+
+    }
+
+    return span + guac_parser_span_ascii_scalar(data + span, length - span);
+
+}
+
+/**
+ * AVX2 implementation of guac_parser_kernel_span_ascii, checking
+ * thirty-two bytes at a time.
+ *
+ * @see guac_parser_span_ascii_sse2
+ */
+GUAC_PARSER_KERNEL_AVX2
+static size_t guac_parser_span_ascii_avx2(const unsigned char* data,
+        size_t length) {
+
+    size_t span = 0;
+
+    while (length - span >= 32) {
+
+        __m256i bytes = _mm256_loadu_si256((const __m256i*) (data + span));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(bytes);
+        if (mask)
+            return span + __builtin_ctz(mask);
+
+        span += 32;
+
+    }
+
+    return span + guac_parser_span_ascii_sse2(data + span, length - span);
+
+}
+
+/**
+ * Parser kernel leveraging SSE2.
+ */
+static const guac_parser_kernel guac_parser_kernel_sse2 = {
+    .name       = "sse2",
+    .supported  = guac_parser_kernel_sse2_supported,
+    .span_ascii = guac_parser_span_ascii_sse2
+};
+
+/**
+ * Parser kernel leveraging AVX2.
+ */
+static const guac_parser_kernel guac_parser_kernel_avx2 = {
+    .name       = "avx2",
+    .supported  = guac_parser_kernel_avx2_supported,
+    .span_ascii = guac_parser_span_ascii_avx2
+};
+
+#endif
+
+/* ---------------- NEON ---------------- */
+
+#ifdef GUAC_PARSER_KERNEL_NEON
+
+/**
+ * Returns whether the current processor supports NEON. NEON is a mandatory
+ * part of AArch64, and is thus always supported if this kernel was compiled
+ * at all.
+ *
+ * @return
+ *     Always non-zero.
+ */
+static int guac_parser_kernel_neon_supported(void) {
+    return 1;
+}
+
+/**
+ * NEON implementation of guac_parser_kernel_span_ascii, checking sixteen
+ * bytes at a time. The block containing the first non-ASCII byte is located
+ * using a horizontal maximum, and the byte itself is then located using the
+ * scalar kernel.
+ *
+ * @see guac_parser_kernel_span_ascii
+ */
+static size_t guac_parser_span_ascii_neon(const unsigned char* data,
+        size_t length) {
+
+    size_t span = 0;
+
+    while (length - span >= 16) {
+
+        if (vmaxvq_u8(vld1q_u8(data + span)) >= 0x80)
+            break;
+
+        span += 16;
+
+    }
+
+    return span + guac_parser_span_ascii_scalar(data + span, length - span);
+
+}
+
+/**
+ * Parser kernel leveraging NEON.
+ */
+static const guac_parser_kernel guac_parser_kernel_neon = {
+    .name       = "neon",
+    .supported  = guac_parser_kernel_neon_supported,
+    .span_ascii = guac_parser_span_ascii_neon
+};
+
+#endif
+
+const guac_parser_kernel* const guac_parser_kernels_all[] = {
+    &guac_parser_kernel_scalar,
+#ifdef HAVE_X86_SIMD
+    &guac_parser_kernel_sse2,
+    &guac_parser_kernel_avx2,
+#endif
+#ifdef GUAC_PARSER_KERNEL_NEON
+    &guac_parser_kernel_neon,
+#endif
+    NULL
+};
+
+const guac_parser_kernel* guac_parser_kernel_select(void) {
+
+    const guac_parser_kernel* selected = &guac_parser_kernel_scalar;
+
+    /* Prefer the last supported kernel (kernels are listed in order of
+     * increasing preference) */
+    for (const guac_parser_kernel* const* current = guac_parser_kernels_all;
+            *current != NULL; current++) {
+
+        if ((*current)->supported())
+            selected = *current;
+
+    }
+
+    return selected;
+
+}
+
+/**
+ * The kernel used by guac_parser_span_ascii(), as determined by
+ * guac_parser_kernel_select() upon first use.
+ */
+static const guac_parser_kernel* guac_parser_kernel_selected = NULL;
+
+/**
+ * Guarantees that guac_parser_kernel_selected is initialized exactly once.
+ */
+static pthread_once_t guac_parser_kernel_selected_init = PTHREAD_ONCE_INIT;
+
+/**
+ * Initializes guac_parser_kernel_selected. This function MUST be invoked only
+ * through pthread_once() with guac_parser_kernel_selected_init.
+ */
+static void guac_parser_kernel_init(void) {
+    guac_parser_kernel_selected = guac_parser_kernel_select();
+}
+
+size_t guac_parser_span_ascii(const unsigned char* data, size_t length) {
+
+    pthread_once(&guac_parser_kernel_selected_init, guac_parser_kernel_init);
+    return guac_parser_kernel_selected->span_ascii(data, length);
+
+}
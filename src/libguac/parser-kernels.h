@@ -0,0 +1,122 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_PARSER_KERNELS_H
+#define GUAC_PARSER_KERNELS_H
+
+#include <stddef.h>
+
+/**
+ * Returns the number of bytes at the beginning of the given buffer that are
+ * ASCII characters (bytes whose most significant bit is clear). Each such
+ * byte is a complete, single-byte UTF-8 character, and thus runs of ASCII
+ * content may be skipped by guac_parser without decoding each character.
+ *
+ * @param data
+ *     The buffer to scan.
+ *
+ * @param length
+ *     The number of bytes within the buffer.
+ *
+ * @return
+ *     The number of leading bytes within the buffer that are ASCII, which
+ *     will be equal to length if the entire buffer is ASCII.
+ */
+typedef size_t guac_parser_kernel_span_ascii(const unsigned char* data,
+        size_t length);
+
+/**
+ * Returns whether the processor that the current process is running on
+ * supports the instructions required by a particular parser kernel.
+ *
+ * @return
+ *     Non-zero if the required instructions are supported, zero otherwise.
+ */
+typedef int guac_parser_kernel_supported(void);
+
+/**
+ * An implementation of the loop which scans the content of instruction
+ * elements received by guac_parser. Each kernel produces results that are
+ * identical to those of every other kernel, varying only in the processor
+ * features leveraged to produce those results.
+ */
+typedef struct guac_parser_kernel {
+
+    /**
+     * A human-readable name for this kernel, such as "scalar" or "avx2".
+     */
+    const char* name;
+
+    /**
+     * Returns whether the current processor supports this kernel.
+     */
+    guac_parser_kernel_supported* supported;
+
+    /**
+     * Returns the length of the run of ASCII bytes at the beginning of a
+     * buffer.
+     */
+    guac_parser_kernel_span_ascii* span_ascii;
+
+} guac_parser_kernel;
+
+/**
+ * Portable parser kernel that does not depend on any particular processor
+ * features. This kernel is always available and is the reference against
+ * which all other kernels are verified.
+ */
+extern const guac_parser_kernel guac_parser_kernel_scalar;
+
+/**
+ * NULL-terminated array of all parser kernels compiled into libguac, in order
+ * of increasing preference. Not all of these kernels are necessarily
+ * supported by the current processor, and each entry must be checked with its
+ * supported() function before use.
+ */
+extern const guac_parser_kernel* const guac_parser_kernels_all[];
+
+/**
+ * Returns the most preferable parser kernel that is supported by the current
+ * processor. If no kernels leveraging processor-specific features are
+ * supported, guac_parser_kernel_scalar is returned.
+ *
+ * @return
+ *     The most preferable parser kernel supported by the current processor.
+ */
+const guac_parser_kernel* guac_parser_kernel_select(void);
+
+/**
+ * Returns the number of bytes at the beginning of the given buffer that are
+ * ASCII characters, using the most preferable kernel supported by the current
+ * processor, as determined by guac_parser_kernel_select().
+ *
+ * @see guac_parser_kernel_span_ascii
+ *
+ * @param data
+ *     The buffer to scan.
+ *
+ * @param length
+ *     The number of bytes within the buffer.
+ *
+ * @return
+ *     The number of leading bytes within the buffer that are ASCII.
+ */
+size_t guac_parser_span_ascii(const unsigned char* data, size_t length);
+
+#endif
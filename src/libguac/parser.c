@@ -24,11 +24,19 @@
 #include "guacamole/parser.h"
 #include "guacamole/socket.h"
 #include "guacamole/unicode.h"
+#include "parser-kernels.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
+/**
+ * The minimum number of bytes of element content for which the vectorized
+ * kernels are used to skip ASCII characters. Shorter content, such as the
+ * coordinates within "mouse" instructions, is cheaper to check inline.
+ */
+#define GUAC_PARSER_MIN_KERNEL_SPAN 16
+
 static void guac_parser_reset(guac_parser* parser) {
     parser->opcode = NULL;
     parser->argc = 0;
@@ -47,8 +55,11 @@ guac_parser* guac_parser_alloc(void) {
         return NULL;
     }
 
+    parser->__binary_framing = 0;
+
     /* Init parse start/end markers */
     parser->__instructionbuf_unparsed_start = parser->__instructionbuf;
+    parser->__instructionbuf_parse_start = parser->__instructionbuf;
     parser->__instructionbuf_unparsed_end = parser->__instructionbuf;
 
     guac_parser_reset(parser);
@@ -56,203 +67,338 @@ guac_parser* guac_parser_alloc(void) {
 
 }
 
-int guac_parser_append(guac_parser* parser, void* buffer, int length) {
+/**
+ * Returns the number of bytes at the beginning of the given buffer that are
+ * ASCII characters, checking short buffers inline and longer buffers with the
+ * most preferable kernel supported by the current processor.
+ *
+ * @param data
+ *     The buffer to scan.
+ *
+ * @param length
+ *     The number of bytes within the buffer.
+ *
+ * @return
+ *     The number of leading bytes within the buffer that are ASCII.
+ */
+static size_t guac_parser_skip_ascii(const unsigned char* data, size_t length) {
 
-    char* char_buffer = (char*) buffer;
-    int bytes_parsed = 0;
+    if (length >= GUAC_PARSER_MIN_KERNEL_SPAN)
+        return guac_parser_span_ascii(data, length);
 
-    /* Do not exceed maximum number of elements */
-    if (parser->__elementc == GUAC_INSTRUCTION_MAX_ELEMENTS
-            && parser->state != GUAC_PARSE_COMPLETE) {
-        parser->state = GUAC_PARSE_ERROR;
-        return 0;
-    }
+    size_t span = 0;
+    while (span < length && data[span] < 0x80)
+        span++;
+
+    return span;
+
+}
 
-    /* Parse element length */
-    if (parser->state == GUAC_PARSE_LENGTH) {
+/**
+ * Advances through the content of the element currently being parsed,
+ * stopping after the last character of that content or at the end of the
+ * available data, whichever comes first. Runs of ASCII characters are skipped
+ * in bulk, while all other characters are stepped over individually according
+ * to their UTF-8 length. The number of characters remaining within the
+ * element is updated accordingly.
+ *
+ * @param parser
+ *     The parser whose current element content should be parsed. The parser
+ *     MUST be in the GUAC_PARSE_CONTENT state.
+ *
+ * @param current
+ *     The first byte of content that has not yet been parsed.
+ *
+ * @param end
+ *     The first byte beyond the end of the available data.
+ *
+ * @return
+ *     The first byte that was not parsed, which will be the terminator of the
+ *     current element if all content of the element has been parsed.
+ */
+static char* guac_parser_skip_content(guac_parser* parser, char* current,
+        char* end) {
 
-        int parsed_length = parser->__element_length;
-        while (bytes_parsed < length) {
+    int remaining = parser->__element_length;
+    while (remaining > 0 && current < end) {
 
-            /* Pull next character */
-            char c = *(char_buffer++);
-            bytes_parsed++;
+        /* Skip as much ASCII content as possible (each such byte is a
+         * complete character) */
+        size_t available = end - current;
+        size_t ascii = guac_parser_skip_ascii((unsigned char*) current,
+                available < (size_t) remaining ? available : (size_t) remaining);
 
-            /* If digit, add to length */
-            if (c >= '0' && c <= '9')
-                parsed_length = parsed_length*10 + c - '0';
+        current += ascii;
+        remaining -= ascii;
 
-            /* If period, switch to parsing content */
-            else if (c == '.') {
-                parser->__elementv[parser->__elementc++] = char_buffer;
-                parser->state = GUAC_PARSE_CONTENT;
-                break;
-            }
+        if (remaining == 0 || current == end)
+            break;
 
-            /* If not digit, parse error */
-            else {
-                parser->state = GUAC_PARSE_ERROR;
-                return 0;
-            }
+        /* Step over the multibyte character that ended the ASCII run, if the
+         * full character is present */
+        size_t char_length = guac_utf8_charsize((unsigned char) *current);
+        if (char_length > (size_t) (end - current))
+            break;
 
-        }
+        current += char_length;
+        remaining--;
 
-        /* If too long, parse error */
-        if (parsed_length > GUAC_INSTRUCTION_MAX_LENGTH) {
-            parser->state = GUAC_PARSE_ERROR;
-            return 0;
-        }
+    }
 
-        /* Save length */
-        parser->__element_length = parsed_length;
+    parser->__element_length = remaining;
+    return current;
 
-    } /* end parse length */
+}
 
-    /* Parse element content */
-    if (parser->state == GUAC_PARSE_CONTENT) {
+void guac_parser_enable_binary_framing(guac_parser* parser) {
+    parser->__binary_framing = 1;
+}
 
-        while (bytes_parsed < length && parser->__element_length >= 0) {
+int guac_parser_append(guac_parser* parser, void* buffer, int length) {
 
-            /* Get length of current character */
-            char c = *char_buffer;
-            int char_length = guac_utf8_charsize((unsigned char) c);
+    char* char_buffer = (char*) buffer;
+    char* current = char_buffer;
+    char* end = char_buffer + length;
 
-            /* If full character not present in buffer, stop now */
-            if (char_length + bytes_parsed > length)
-                break;
+    /* Parse as many elements as possible until the instruction is complete or
+     * the available data is exhausted */
+    while (current < end) {
 
-            /* Record character as parsed */
-            bytes_parsed += char_length;
+        /* Parse element length */
+        if (parser->state == GUAC_PARSE_LENGTH) {
 
-            /* If end of element, handle terminator */
-            if (parser->__element_length == 0) {
+            /* Do not exceed maximum number of elements */
+            if (parser->__elementc == GUAC_INSTRUCTION_MAX_ELEMENTS) {
+                parser->state = GUAC_PARSE_ERROR;
+                return 0;
+            }
+
+            int parsed_length = parser->__element_length;
+            while (current < end) {
 
-                *char_buffer = '\0';
+                /* Pull next character */
+                char c = *(current++);
 
-                /* If semicolon, store end-of-instruction */
-                if (c == ';') {
-                    parser->state = GUAC_PARSE_COMPLETE;
-                    parser->opcode = parser->__elementv[0];
-                    parser->argv = &(parser->__elementv[1]);
-                    parser->argc = parser->__elementc - 1;
+                /* If digit, add to length, failing if too long */
+                if (c >= '0' && c <= '9') {
+                    parsed_length = parsed_length*10 + c - '0';
+                    if (parsed_length > GUAC_INSTRUCTION_MAX_LENGTH) {
+                        parser->state = GUAC_PARSE_ERROR;
+                        return 0;
+                    }
+                }
+
+                /* If period, switch to parsing content */
+                else if (c == '.') {
+                    parser->__element_binary = 0;
+                    parser->__elementl[parser->__elementc] = -1;
+                    parser->__elementv[parser->__elementc++] = current;
+                    parser->state = GUAC_PARSE_CONTENT;
                     break;
                 }
 
-                /* If comma, move on to next element */
-                else if (c == ',') {
-                    parser->state = GUAC_PARSE_LENGTH;
+                /* If hash, switch to parsing binary content (if allowed) */
+                else if (c == '#' && parser->__binary_framing) {
+                    parser->__element_binary = 1;
+                    parser->__elementl[parser->__elementc] = parsed_length;
+                    parser->__elementv[parser->__elementc++] = current;
+                    parser->state = GUAC_PARSE_CONTENT;
                     break;
                 }
 
-                /* Otherwise, parse error */
+                /* If not digit, parse error */
                 else {
                     parser->state = GUAC_PARSE_ERROR;
                     return 0;
                 }
 
-            } /* end if end of element */
+            }
 
-            /* Advance to next character */
-            parser->__element_length--;
-            char_buffer += char_length;
+            /* Save length */
+            parser->__element_length = parsed_length;
 
-        }
+        } /* end parse length */
+
+        /* Parse element content */
+        else if (parser->state == GUAC_PARSE_CONTENT) {
+
+            /* Binary content is measured in bytes and need not be
+             * decoded */
+            if (parser->__element_binary) {
+                int available = end - current;
+                int skipped = parser->__element_length < available
+                            ? parser->__element_length : available;
+                current += skipped;
+                parser->__element_length -= skipped;
+            }
+
+            else
+                current = guac_parser_skip_content(parser, current, end);
+
+            /* Stop if the remainder of the element has not yet been
+             * received */
+            if (parser->__element_length > 0 || current == end)
+                break;
+
+            /* Handle terminator at end of element */
+            char c = *current;
+            *(current++) = '\0';
+
+            /* If semicolon, store end-of-instruction */
+            if (c == ';') {
+                parser->state = GUAC_PARSE_COMPLETE;
+                parser->opcode = parser->__elementv[0];
+                parser->argv = &(parser->__elementv[1]);
+                parser->argc = parser->__elementc - 1;
+                break;
+            }
+
+            /* If comma, move on to next element */
+            else if (c == ',')
+                parser->state = GUAC_PARSE_LENGTH;
+
+            /* Otherwise, parse error */
+            else {
+                parser->state = GUAC_PARSE_ERROR;
+                return 0;
+            }
 
-    } /* end parse content */
+        } /* end parse content */
 
-    return bytes_parsed;
+        /* Nothing further can be parsed once complete */
+        else
+            break;
+
+    }
+
+    return current - char_buffer;
 
 }
 
-int guac_parser_read(guac_parser* parser, guac_socket* socket, int usec_timeout) {
+/**
+ * Reads more data into the instruction buffer of the given parser, first
+ * shifting the in-progress instruction to the beginning of the buffer if no
+ * space remains. The contents of any previously-completed instructions are
+ * overwritten if the buffer is shifted.
+ *
+ * @param parser
+ *     The parser whose instruction buffer should receive more data.
+ *
+ * @param socket
+ *     The guac_socket to read data from.
+ *
+ * @param usec_timeout
+ *     The maximum number of microseconds to wait for data to become
+ *     available.
+ *
+ * @return
+ *     Zero if data was read, or -1 if no data could be read, in which case
+ *     guac_error is set appropriately.
+ */
+static int guac_parser_fill(guac_parser* parser, guac_socket* socket,
+        int usec_timeout) {
 
-    char* unparsed_end   = parser->__instructionbuf_unparsed_end;
-    char* unparsed_start = parser->__instructionbuf_unparsed_start;
-    char* instr_start    = parser->__instructionbuf_unparsed_start;
-    char* buffer_end     = parser->__instructionbuf + sizeof(parser->__instructionbuf);
+    char* buffer_end = parser->__instructionbuf + sizeof(parser->__instructionbuf);
 
-    /* Begin next instruction if previous was ended */
-    if (parser->state == GUAC_PARSE_COMPLETE)
-        guac_parser_reset(parser);
+    /* If no space left to read, shift backward if possible */
+    if (parser->__instructionbuf_unparsed_end == buffer_end) {
 
-    while (parser->state != GUAC_PARSE_COMPLETE
-        && parser->state != GUAC_PARSE_ERROR) {
+        char* instr_start = parser->__instructionbuf_unparsed_start;
 
-        /* Add any available data to buffer */
-        int parsed = guac_parser_append(parser, unparsed_start, unparsed_end - unparsed_start);
+        /* Otherwise, no memory to read */
+        if (instr_start == parser->__instructionbuf) {
+            guac_error = GUAC_STATUS_NO_MEMORY;
+            guac_error_message = "Instruction too long";
+            return -1;
+        }
 
-        /* Read more data if not enough data to parse */
-        if (parsed == 0 && parser->state != GUAC_PARSE_ERROR) {
+        /* Shift buffer */
+        int offset = instr_start - parser->__instructionbuf;
+        memmove(parser->__instructionbuf, instr_start, buffer_end - instr_start);
 
-            int retval;
+        /* Update tracking pointers */
+        parser->__instructionbuf_unparsed_start -= offset;
+        parser->__instructionbuf_parse_start -= offset;
+        parser->__instructionbuf_unparsed_end -= offset;
 
-            /* If no space left to read, fail */
-            if (unparsed_end == buffer_end) {
+        /* Update parsed elements, if any */
+        for (int i = 0; i < parser->__elementc; i++)
+            parser->__elementv[i] -= offset;
 
-                /* Shift backward if possible */
-                if (instr_start != parser->__instructionbuf) {
+    }
 
-                    int i;
+    /* No instruction yet? Get more data ... */
+    int retval = guac_socket_select(socket, usec_timeout);
+    if (retval <= 0)
+        return -1;
 
-                    /* Shift buffer */
-                    int offset = instr_start - parser->__instructionbuf;
-                    memmove(parser->__instructionbuf, instr_start,
-                            unparsed_end - instr_start);
+    /* Attempt to fill buffer */
+    retval = guac_socket_read(socket, parser->__instructionbuf_unparsed_end,
+            buffer_end - parser->__instructionbuf_unparsed_end);
 
-                    /* Update tracking pointers */
-                    unparsed_end -= offset;
-                    unparsed_start -= offset;
-                    instr_start = parser->__instructionbuf;
+    /* Set guac_error if read unsuccessful */
+    if (retval < 0) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Error filling instruction buffer";
+        return -1;
+    }
 
-                    /* Update parsed elements, if any */
-                    for (i=0; i < parser->__elementc; i++)
-                        parser->__elementv[i] -= offset;
+    /* EOF */
+    if (retval == 0) {
+        guac_error = GUAC_STATUS_CLOSED;
+        guac_error_message = "End of stream reached while "
+                             "reading instruction";
+        return -1;
+    }
 
-                }
+    /* Update internal buffer */
+    parser->__instructionbuf_unparsed_end += retval;
+    return 0;
 
-                /* Otherwise, no memory to read */
-                else {
-                    guac_error = GUAC_STATUS_NO_MEMORY;
-                    guac_error_message = "Instruction too long";
-                    return -1;
-                }
+}
 
-            }
+/**
+ * Parses as much of the in-progress instruction as possible from the data
+ * already within the instruction buffer of the given parser, beginning a new
+ * instruction first if the previous instruction was completed.
+ *
+ * @param parser
+ *     The parser to advance.
+ */
+static void guac_parser_advance(guac_parser* parser) {
 
-            /* No instruction yet? Get more data ... */
-            retval = guac_socket_select(socket, usec_timeout);
-            if (retval <= 0)
-                return -1;
-           
-            /* Attempt to fill buffer */
-            retval = guac_socket_read(socket, unparsed_end,
-                    buffer_end - unparsed_end);
-
-            /* Set guac_error if read unsuccessful */
-            if (retval < 0) {
-                guac_error = GUAC_STATUS_SEE_ERRNO;
-                guac_error_message = "Error filling instruction buffer";
-                return -1;
-            }
+    /* Begin next instruction if previous was ended */
+    if (parser->state == GUAC_PARSE_COMPLETE) {
+        guac_parser_reset(parser);
+        parser->__instructionbuf_unparsed_start = parser->__instructionbuf_parse_start;
+    }
 
-            /* EOF */
-            if (retval == 0) {
-                guac_error = GUAC_STATUS_CLOSED;
-                guac_error_message = "End of stream reached while "
-                                     "reading instruction";
-                return -1;
-            }
+    parser->__instructionbuf_parse_start += guac_parser_append(parser,
+            parser->__instructionbuf_parse_start,
+            parser->__instructionbuf_unparsed_end - parser->__instructionbuf_parse_start);
 
-            /* Update internal buffer */
-            unparsed_end += retval;
+    /* The next instruction begins wherever this instruction ended */
+    if (parser->state == GUAC_PARSE_COMPLETE)
+        parser->__instructionbuf_unparsed_start = parser->__instructionbuf_parse_start;
 
-        }
+}
 
-        /* If data was parsed, advance buffer */
-        else
-            unparsed_start += parsed;
+int guac_parser_read(guac_parser* parser, guac_socket* socket, int usec_timeout) {
+
+    guac_parser_advance(parser);
+
+    /* Read more data until the instruction is complete. Anything received
+     * thus far is retained if the wait for data times out, such that reading
+     * can resume where it left off. */
+    while (parser->state != GUAC_PARSE_COMPLETE
+        && parser->state != GUAC_PARSE_ERROR) {
+
+        if (guac_parser_fill(parser, socket, usec_timeout))
+            return -1;
 
-    } /* end while parsing data */
+        guac_parser_advance(parser);
+
+    }
 
     /* Fail on error */
     if (parser->state == GUAC_PARSE_ERROR) {
@@ -261,12 +407,75 @@ int guac_parser_read(guac_parser* parser, guac_socket* socket, int usec_timeout)
         return -1;
     }
 
-    parser->__instructionbuf_unparsed_start = unparsed_start;
-    parser->__instructionbuf_unparsed_end = unparsed_end;
     return 0;
 
 }
 
+/**
+ * Copies the element pointers of the instruction most recently completed by
+ * the given parser into the batch storage of that parser, populating the
+ * given guac_parser_instruction accordingly.
+ *
+ * @param parser
+ *     The parser that has just completed an instruction.
+ *
+ * @param instruction
+ *     The guac_parser_instruction to populate.
+ *
+ * @param elements_used
+ *     The number of entries within the batch storage that are already in
+ *     use. This value is updated to include the elements of the copied
+ *     instruction.
+ */
+static void guac_parser_store_instruction(guac_parser* parser,
+        guac_parser_instruction* instruction, int* elements_used) {
+
+    char** elementv = parser->__batch_elementv + *elements_used;
+    memcpy(elementv, parser->__elementv, parser->__elementc * sizeof(char*));
+
+    int* elementl = parser->__batch_elementl + *elements_used;
+    memcpy(elementl, parser->__elementl, parser->__elementc * sizeof(int));
+
+    instruction->opcode = elementv[0];
+    instruction->argv = &(elementv[1]);
+    instruction->argl = &(elementl[1]);
+    instruction->argc = parser->__elementc - 1;
+
+    *elements_used += parser->__elementc;
+
+}
+
+int guac_parser_read_batch(guac_parser* parser, guac_socket* socket,
+        int usec_timeout, guac_parser_instruction* instructions,
+        int max_instructions) {
+
+    /* Wait for the first instruction (the instruction buffer may be shifted
+     * only until this instruction has been read) */
+    if (guac_parser_read(parser, socket, usec_timeout))
+        return -1;
+
+    int elements_used = 0;
+    guac_parser_store_instruction(parser, &instructions[0], &elements_used);
+
+    /* Parse any further complete instructions that have already been
+     * received, stopping before the batch storage could possibly overflow */
+    int count = 1;
+    while (count < max_instructions && elements_used
+            + GUAC_INSTRUCTION_MAX_ELEMENTS <= GUAC_INSTRUCTION_BATCH_MAX_ELEMENTS) {
+
+        guac_parser_advance(parser);
+        if (parser->state != GUAC_PARSE_COMPLETE)
+            break;
+
+        guac_parser_store_instruction(parser, &instructions[count++],
+                &elements_used);
+
+    }
+
+    return count;
+
+}
+
 int guac_parser_expect(guac_parser* parser, guac_socket* socket, int usec_timeout, const char* opcode) {
 
     /* Read next instruction */
@@ -288,7 +497,7 @@ int guac_parser_expect(guac_parser* parser, guac_socket* socket, int usec_timeou
 int guac_parser_length(guac_parser* parser) {
 
     char* unparsed_end   = parser->__instructionbuf_unparsed_end;
-    char* unparsed_start = parser->__instructionbuf_unparsed_start;
+    char* unparsed_start = parser->__instructionbuf_parse_start;
 
     return unparsed_end - unparsed_start;
 
@@ -297,7 +506,7 @@ int guac_parser_length(guac_parser* parser) {
 int guac_parser_shift(guac_parser* parser, void* buffer, int length) {
 
     char* copy_end   = parser->__instructionbuf_unparsed_end;
-    char* copy_start = parser->__instructionbuf_unparsed_start;
+    char* copy_start = parser->__instructionbuf_parse_start;
 
     /* Contain copy region within length */
     if (copy_end - copy_start > length)
@@ -308,6 +517,7 @@ int guac_parser_shift(guac_parser* parser, void* buffer, int length) {
     memcpy(buffer, copy_start, length);
 
     parser->__instructionbuf_unparsed_start = copy_end;
+    parser->__instructionbuf_parse_start = copy_end;
 
     return length;
 
@@ -248,8 +248,6 @@ int guac_protocol_send_audio(guac_socket* socket, const guac_stream* stream,
 int guac_protocol_send_blob(guac_socket* socket, const guac_stream* stream,
         const void* data, int count) {
 
-    int base64_length = (count + 2) / 3 * 4;
-
     int ret_val;
 
     guac_socket_instruction_begin(socket);
@@ -257,10 +255,7 @@ int guac_protocol_send_blob(guac_socket* socket, const guac_stream* stream,
            guac_socket_write_string(socket, "4.blob,")
         || __guac_socket_write_length_int(socket, stream->index)
         || guac_socket_write_string(socket, ",")
-        || guac_socket_write_int(socket, base64_length)
-        || guac_socket_write_string(socket, ".")
-        || guac_socket_write_base64(socket, data, count)
-        || guac_socket_flush_base64(socket)
+        || guac_socket_write_binary(socket, data, count)
         || guac_socket_write_string(socket, ";");
 
     guac_socket_instruction_end(socket);
@@ -1015,6 +1010,25 @@ int guac_protocol_send_push(guac_socket* socket, const guac_layer* layer) {
 
 }
 
+int guac_protocol_send_framing(guac_socket* socket,
+        guac_protocol_framing framing) {
+
+    int ret_val;
+
+    guac_socket_instruction_begin(socket);
+    ret_val =
+           guac_socket_write_string(socket, "7.framing,")
+        || __guac_socket_write_length_string(socket,
+                framing == GUAC_PROTOCOL_FRAMING_BINARY
+                    ? GUAC_PROTOCOL_FRAMING_BINARY_NAME
+                    : GUAC_PROTOCOL_FRAMING_TEXT_NAME)
+        || guac_socket_write_string(socket, ";");
+
+    guac_socket_instruction_end(socket);
+    return ret_val;
+
+}
+
 int guac_protocol_send_ready(guac_socket* socket, const char* id) {
 
     int ret_val;
@@ -0,0 +1,90 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "guacamole/recording.h"
+#include "guacamole/timestamp.h"
+#include "recording-index.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/**
+ * The maximum length of a single line of an index, including newline and
+ * null terminator, in bytes.
+ */
+#define GUAC_RECORDING_INDEX_MAX_LINE_LENGTH 64
+
+int guac_recording_index_write(int index_fd, guac_timestamp timestamp,
+        uint64_t offset) {
+
+    char line[GUAC_RECORDING_INDEX_MAX_LINE_LENGTH];
+    int length = snprintf(line, sizeof(line), "%" PRId64 " %" PRIu64 "\n",
+            (int64_t) timestamp, offset);
+
+    return write(index_fd, line, length) != length;
+
+}
+
+int guac_recording_index_find(int index_fd, guac_timestamp timestamp,
+        uint64_t* offset) {
+
+    /* Read the index through a duplicate descriptor, such that the caller's
+     * descriptor remains open */
+    int read_fd = dup(index_fd);
+    if (read_fd == -1)
+        return 1;
+
+    FILE* index = fdopen(read_fd, "r");
+    if (index == NULL) {
+        close(read_fd);
+        return 1;
+    }
+
+    int found = 0;
+    char line[GUAC_RECORDING_INDEX_MAX_LINE_LENGTH];
+    while (fgets(line, sizeof(line), index) != NULL) {
+
+        int64_t entry_timestamp;
+        uint64_t entry_offset;
+
+        /* Ignore anything that is not a valid entry */
+        if (sscanf(line, "%" SCNd64 " %" SCNu64, &entry_timestamp,
+                    &entry_offset) != 2)
+            continue;
+
+        /* Keyframes are listed in order, so the last keyframe at or before
+         * the timestamp is the best starting point */
+        if (entry_timestamp > timestamp)
+            break;
+
+        *offset = entry_offset;
+        found = 1;
+
+    }
+
+    fclose(index);
+    return !found;
+
+}
+
@@ -0,0 +1,62 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+
+#ifndef GUAC_RECORDING_INDEX_H
+#define GUAC_RECORDING_INDEX_H
+
+/**
+ * Provides functions for writing the index of a session recording. This is
+ * used only internally within libguac, and is not installed along with the
+ * library.
+ *
+ * Each index is a text file containing one line per keyframe, each line
+ * consisting of the timestamp of the keyframe and its offset within the
+ * uncompressed recording, separated by a single space. Lines are ordered by
+ * offset.
+ *
+ * @file recording-index.h
+ */
+
+#include "guacamole/timestamp.h"
+
+#include <stdint.h>
+
+/**
+ * Appends an entry describing a single keyframe to the given index.
+ *
+ * @param index_fd
+ *     The file descriptor of the index to append to.
+ *
+ * @param timestamp
+ *     The timestamp of the "sync" instruction ending the keyframe, or of any
+ *     later point in time prior to the next frame.
+ *
+ * @param offset
+ *     The offset of the keyframe within the uncompressed recording, in bytes.
+ *
+ * @return
+ *     Zero if the entry was written successfully, non-zero otherwise.
+ */
+int guac_recording_index_write(int index_fd, guac_timestamp timestamp,
+        uint64_t offset);
+
+#endif
+
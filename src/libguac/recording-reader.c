@@ -0,0 +1,635 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "guacamole/error.h"
+#include "guacamole/mem.h"
+#include "guacamole/parser.h"
+#include "guacamole/recording.h"
+#include "guacamole/socket.h"
+#include "recording-index.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+/**
+ * The size of the buffer receiving data read from the recording file, in
+ * bytes.
+ */
+#define GUAC_RECORDING_READER_BUFFER_SIZE 65536
+
+/**
+ * The number of bytes at the beginning of a recording file which are
+ * inspected to determine the compression used, if any.
+ */
+#define GUAC_RECORDING_READER_MAGIC_LENGTH 4
+
+/**
+ * The bytes which begin every gzip stream.
+ */
+static const unsigned char GUAC_RECORDING_READER_GZIP_MAGIC[] = { 0x1F, 0x8B };
+
+/**
+ * The bytes which begin every zstd frame.
+ */
+static const unsigned char GUAC_RECORDING_READER_ZSTD_MAGIC[] = {
+    0x28, 0xB5, 0x2F, 0xFD
+};
+
+/**
+ * Data specific to the recording reader implementation of guac_socket.
+ */
+typedef struct guac_recording_reader {
+
+    /**
+     * The file descriptor of the recording file.
+     */
+    int fd;
+
+    /**
+     * The compression used by the recording file.
+     */
+    guac_recording_compression compression;
+
+    /**
+     * Data read from the recording file which has not yet been passed
+     * through the decompressor (or returned, if the recording is not
+     * compressed).
+     */
+    unsigned char buffer[GUAC_RECORDING_READER_BUFFER_SIZE];
+
+    /**
+     * The offset of the first byte within the buffer which has not yet been
+     * consumed.
+     */
+    size_t offset;
+
+    /**
+     * The number of bytes of data within the buffer, including bytes that
+     * have already been consumed.
+     */
+    size_t length;
+
+    /**
+     * The number of bytes of uncompressed recording data returned by the
+     * read handler thus far, including any data skipped through
+     * guac_recording_socket_seek().
+     */
+    uint64_t position;
+
+#ifdef ENABLE_ZLIB
+    /**
+     * The zlib stream used to decompress gzip recordings.
+     */
+    z_stream zlib;
+#endif
+
+#ifdef ENABLE_ZSTD
+    /**
+     * The zstd context used to decompress zstd recordings.
+     */
+    ZSTD_DCtx* zstd;
+#endif
+
+} guac_recording_reader;
+
+/**
+ * Reads more data from the recording file if all data within the buffer of
+ * the given reader has been consumed.
+ *
+ * @param reader
+ *     The reader whose buffer should be refilled.
+ *
+ * @return
+ *     A positive value if unconsumed data is available within the buffer,
+ *     zero if the end of the file has been reached, or a negative value if
+ *     an error occurs.
+ */
+static int guac_recording_reader_fill(guac_recording_reader* reader) {
+
+    if (reader->offset < reader->length)
+        return 1;
+
+    ssize_t length = read(reader->fd, reader->buffer, sizeof(reader->buffer));
+    if (length < 0) {
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Error reading data from recording";
+        return -1;
+    }
+
+    reader->offset = 0;
+    reader->length = length;
+    return length > 0;
+
+}
+
+#ifdef ENABLE_ZLIB
+/**
+ * Decompresses as much buffered gzip data as possible into the given
+ * buffer, without reading from the recording file.
+ *
+ * @param reader
+ *     The reader whose buffered data should be decompressed.
+ *
+ * @param buf
+ *     The buffer to store decompressed data within.
+ *
+ * @param count
+ *     The maximum number of bytes to store within the buffer.
+ *
+ * @return
+ *     The number of bytes stored within the buffer, or -1 if an error
+ *     occurs.
+ */
+static ssize_t guac_recording_reader_gzip(guac_recording_reader* reader,
+        void* buf, size_t count) {
+
+    z_stream* stream = &reader->zlib;
+    stream->next_in = reader->buffer + reader->offset;
+    stream->avail_in = reader->length - reader->offset;
+    stream->next_out = buf;
+    stream->avail_out = count;
+
+    int result = inflate(stream, Z_NO_FLUSH);
+    reader->offset = reader->length - stream->avail_in;
+
+    /* Recordings may consist of several concatenated gzip members */
+    if (result == Z_STREAM_END)
+        inflateReset(stream);
+
+    else if (result != Z_OK && result != Z_BUF_ERROR) {
+        guac_error = GUAC_STATUS_PROTOCOL_ERROR;
+        guac_error_message = "Recording is not valid gzip data";
+        return -1;
+    }
+
+    return count - stream->avail_out;
+
+}
+#endif
+
+#ifdef ENABLE_ZSTD
+/**
+ * Decompresses as much buffered zstd data as possible into the given
+ * buffer, without reading from the recording file.
+ *
+ * @param reader
+ *     The reader whose buffered data should be decompressed.
+ *
+ * @param buf
+ *     The buffer to store decompressed data within.
+ *
+ * @param count
+ *     The maximum number of bytes to store within the buffer.
+ *
+ * @return
+ *     The number of bytes stored within the buffer, or -1 if an error
+ *     occurs.
+ */
+static ssize_t guac_recording_reader_zstd(guac_recording_reader* reader,
+        void* buf, size_t count) {
+
+    ZSTD_inBuffer input = {
+        .src = reader->buffer + reader->offset,
+        .size = reader->length - reader->offset,
+        .pos = 0
+    };
+
+    ZSTD_outBuffer output = { .dst = buf, .size = count, .pos = 0 };
+
+    size_t result = ZSTD_decompressStream(reader->zstd, &output, &input);
+    reader->offset += input.pos;
+
+    if (ZSTD_isError(result)) {
+        guac_error = GUAC_STATUS_PROTOCOL_ERROR;
+        guac_error_message = "Recording is not valid zstd data";
+        return -1;
+    }
+
+    return output.pos;
+
+}
+#endif
+
+/**
+ * Copies as much buffered data as possible into the given buffer, without
+ * reading from the recording file. This function is used only for
+ * recordings that are not compressed.
+ *
+ * @param reader
+ *     The reader whose buffered data should be copied.
+ *
+ * @param buf
+ *     The buffer to copy data into.
+ *
+ * @param count
+ *     The maximum number of bytes to copy.
+ *
+ * @return
+ *     The number of bytes copied.
+ */
+static ssize_t guac_recording_reader_copy(guac_recording_reader* reader,
+        void* buf, size_t count) {
+
+    size_t length = reader->length - reader->offset;
+    if (length > count)
+        length = count;
+
+    memcpy(buf, reader->buffer + reader->offset, length);
+    reader->offset += length;
+    return length;
+
+}
+
+/**
+ * Reads the uncompressed contents of the recording associated with the
+ * given socket, decompressing data from the recording file as necessary.
+ *
+ * @param socket
+ *     The guac_socket being read from.
+ *
+ * @param buf
+ *     The buffer to store data within.
+ *
+ * @param count
+ *     The maximum number of bytes to store within the buffer.
+ *
+ * @return
+ *     The number of bytes stored within the buffer, zero if the end of the
+ *     recording has been reached, or -1 if an error occurs.
+ */
+static ssize_t guac_recording_reader_read_handler(guac_socket* socket,
+        void* buf, size_t count) {
+
+    guac_recording_reader* reader = (guac_recording_reader*) socket->data;
+
+    for (;;) {
+
+        /* Decompressors may have output pending even if nothing remains
+         * within the buffer, so buffered data is always consumed first */
+        ssize_t length;
+        switch (reader->compression) {
+
+#ifdef ENABLE_ZLIB
+            case GUAC_RECORDING_COMPRESSION_GZIP:
+                length = guac_recording_reader_gzip(reader, buf, count);
+                break;
+#endif
+
+#ifdef ENABLE_ZSTD
+            case GUAC_RECORDING_COMPRESSION_ZSTD:
+                length = guac_recording_reader_zstd(reader, buf, count);
+                break;
+#endif
+
+            default:
+                length = guac_recording_reader_copy(reader, buf, count);
+
+        }
+
+        if (length > 0)
+            reader->position += length;
+
+        if (length != 0)
+            return length;
+
+        /* Read more only once nothing more can be produced */
+        int available = guac_recording_reader_fill(reader);
+        if (available <= 0)
+            return available;
+
+    }
+
+}
+
+/**
+ * Frees the decompressor of the given reader, if any.
+ *
+ * @param reader
+ *     The reader whose decompressor should be freed.
+ */
+static void guac_recording_reader_free_decompressor(
+        guac_recording_reader* reader) {
+
+#ifdef ENABLE_ZLIB
+    if (reader->compression == GUAC_RECORDING_COMPRESSION_GZIP)
+        inflateEnd(&reader->zlib);
+#endif
+
+#ifdef ENABLE_ZSTD
+    if (reader->compression == GUAC_RECORDING_COMPRESSION_ZSTD)
+        ZSTD_freeDCtx(reader->zstd);
+#endif
+
+}
+
+/**
+ * Frees all implementation-specific data associated with the given socket,
+ * including the decompressor and file descriptor, but not the socket object
+ * itself.
+ *
+ * @param socket
+ *     The guac_socket whose associated data should be freed.
+ *
+ * @return
+ *     Always zero.
+ */
+static int guac_recording_reader_free_handler(guac_socket* socket) {
+
+    guac_recording_reader* reader = (guac_recording_reader*) socket->data;
+
+    guac_recording_reader_free_decompressor(reader);
+    close(reader->fd);
+
+    guac_mem_free(reader);
+    return 0;
+
+}
+
+/**
+ * Determines the compression used by a recording from the bytes at the
+ * beginning of its file.
+ *
+ * @param magic
+ *     The bytes at the beginning of the recording file.
+ *
+ * @param length
+ *     The number of bytes available, which may be fewer than
+ *     GUAC_RECORDING_READER_MAGIC_LENGTH if the file is very short.
+ *
+ * @return
+ *     The compression used by the recording.
+ */
+static guac_recording_compression guac_recording_reader_detect(
+        const unsigned char* magic, size_t length) {
+
+    if (length >= sizeof(GUAC_RECORDING_READER_GZIP_MAGIC)
+            && memcmp(magic, GUAC_RECORDING_READER_GZIP_MAGIC,
+                sizeof(GUAC_RECORDING_READER_GZIP_MAGIC)) == 0)
+        return GUAC_RECORDING_COMPRESSION_GZIP;
+
+    if (length >= sizeof(GUAC_RECORDING_READER_ZSTD_MAGIC)
+            && memcmp(magic, GUAC_RECORDING_READER_ZSTD_MAGIC,
+                sizeof(GUAC_RECORDING_READER_ZSTD_MAGIC)) == 0)
+        return GUAC_RECORDING_COMPRESSION_ZSTD;
+
+    return GUAC_RECORDING_COMPRESSION_NONE;
+
+}
+
+/**
+ * Initializes the decompressor of the given reader, if the recording is
+ * compressed.
+ *
+ * @param reader
+ *     The reader whose decompressor should be initialized.
+ *
+ * @return
+ *     Zero if the decompressor was initialized successfully or no
+ *     decompressor is needed, non-zero if the compression used by the
+ *     recording is not supported, in which case guac_error and
+ *     guac_error_message are set appropriately.
+ */
+static int guac_recording_reader_init_decompressor(
+        guac_recording_reader* reader) {
+
+    switch (reader->compression) {
+
+        case GUAC_RECORDING_COMPRESSION_NONE:
+            return 0;
+
+#ifdef ENABLE_ZLIB
+        case GUAC_RECORDING_COMPRESSION_GZIP:
+            /* A window of up to 15 bits, plus 32 to detect the gzip header */
+            if (inflateInit2(&reader->zlib, 15 + 32) == Z_OK)
+                return 0;
+            break;
+#endif
+
+#ifdef ENABLE_ZSTD
+        case GUAC_RECORDING_COMPRESSION_ZSTD:
+            reader->zstd = ZSTD_createDCtx();
+            if (reader->zstd != NULL)
+                return 0;
+            break;
+#endif
+
+        default:
+            guac_error = GUAC_STATUS_NOT_SUPPORTED;
+            guac_error_message = "Recording is compressed using a method not "
+                "supported by this build of libguac";
+            return 1;
+
+    }
+
+    guac_error = GUAC_STATUS_NO_MEMORY;
+    guac_error_message = "Unable to initialize recording decompression";
+    return 1;
+
+}
+
+guac_socket* guac_recording_socket_open(int fd) {
+
+    guac_recording_reader* reader = guac_mem_zalloc(sizeof(guac_recording_reader));
+    reader->fd = fd;
+
+    /* Read enough of the file to identify its compression */
+    while (reader->length < GUAC_RECORDING_READER_MAGIC_LENGTH) {
+
+        ssize_t length = read(fd, reader->buffer + reader->length,
+                GUAC_RECORDING_READER_MAGIC_LENGTH - reader->length);
+
+        if (length == 0)
+            break;
+
+        if (length < 0) {
+            guac_error = GUAC_STATUS_SEE_ERRNO;
+            guac_error_message = "Error reading data from recording";
+            guac_mem_free(reader);
+            return NULL;
+        }
+
+        reader->length += length;
+
+    }
+
+    reader->compression = guac_recording_reader_detect(reader->buffer,
+            reader->length);
+
+    if (guac_recording_reader_init_decompressor(reader)) {
+        guac_mem_free(reader);
+        return NULL;
+    }
+
+    guac_socket* socket = guac_socket_alloc();
+    socket->data = reader;
+
+    socket->read_handler = guac_recording_reader_read_handler;
+    socket->free_handler = guac_recording_reader_free_handler;
+
+    return socket;
+
+}
+
+int guac_recording_socket_seek(guac_socket* socket, uint64_t offset) {
+
+    guac_recording_reader* reader = (guac_recording_reader*) socket->data;
+
+    /* Uncompressed recordings can be repositioned directly */
+    struct stat file_stat;
+    if (reader->compression == GUAC_RECORDING_COMPRESSION_NONE
+            && fstat(reader->fd, &file_stat) == 0
+            && S_ISREG(file_stat.st_mode)) {
+
+        if (offset > (uint64_t) file_stat.st_size) {
+            guac_error = GUAC_STATUS_OUT_OF_RANGE;
+            guac_error_message = "Offset is beyond the end of the recording";
+            return 1;
+        }
+
+        if (lseek(reader->fd, offset, SEEK_SET) == -1) {
+            guac_error = GUAC_STATUS_SEE_ERRNO;
+            guac_error_message = "Unable to seek within recording";
+            return 1;
+        }
+
+        /* Anything buffered preceded the new position */
+        reader->offset = reader->length = 0;
+        reader->position = offset;
+        return 0;
+
+    }
+
+    /* Otherwise, skip everything prior to the requested offset */
+    char discard[GUAC_RECORDING_READER_BUFFER_SIZE];
+    while (reader->position < offset) {
+
+        size_t count = sizeof(discard);
+        if (count > offset - reader->position)
+            count = offset - reader->position;
+
+        ssize_t length = guac_recording_reader_read_handler(socket, discard,
+                count);
+
+        if (length < 0)
+            return 1;
+
+        if (length == 0) {
+            guac_error = GUAC_STATUS_OUT_OF_RANGE;
+            guac_error_message = "Offset is beyond the end of the recording";
+            return 1;
+        }
+
+    }
+
+    return 0;
+
+}
+
+/**
+ * Returns whether the instruction most recently read by the given parser is
+ * the "log" instruction marking the beginning of a keyframe.
+ *
+ * @param parser
+ *     The parser that has just read an instruction.
+ *
+ * @return
+ *     Non-zero if the instruction marks the beginning of a keyframe, zero
+ *     otherwise.
+ */
+static int guac_recording_is_keyframe_marker(guac_parser* parser) {
+    return strcmp(parser->opcode, "log") == 0
+        && parser->argc >= 1
+        && strcmp(parser->argv[0], GUAC_RECORDING_KEYFRAME_MESSAGE) == 0;
+}
+
+int guac_recording_index_rebuild(int fd, int index_fd) {
+
+    guac_socket* socket = guac_recording_socket_open(fd);
+    if (socket == NULL) {
+        close(fd);
+        return -1;
+    }
+
+    guac_recording_reader* reader = (guac_recording_reader*) socket->data;
+    guac_parser* parser = guac_parser_alloc();
+
+    int keyframes = 0;
+    int keyframe_pending = 0;
+    uint64_t keyframe_offset = 0;
+    uint64_t instruction_end = 0;
+
+    while (!guac_parser_read(parser, socket, -1)) {
+
+        /* Each instruction begins where the previous instruction ended,
+         * which is everything read thus far minus anything the parser has
+         * buffered but not yet parsed */
+        uint64_t instruction_start = instruction_end;
+        instruction_end = reader->position
+            - (parser->__instructionbuf_unparsed_end
+                    - parser->__instructionbuf_unparsed_start);
+
+        if (guac_recording_is_keyframe_marker(parser)) {
+            keyframe_offset = instruction_start;
+            keyframe_pending = 1;
+        }
+
+        /* Each keyframe is listed once complete */
+        else if (keyframe_pending && strcmp(parser->opcode, "sync") == 0
+                && parser->argc >= 1) {
+
+            guac_timestamp timestamp = strtoll(parser->argv[0], NULL, 10);
+            if (guac_recording_index_write(index_fd, timestamp,
+                        keyframe_offset)) {
+                guac_error = GUAC_STATUS_SEE_ERRNO;
+                guac_error_message = "Unable to write recording index";
+                keyframes = -1;
+                break;
+            }
+
+            keyframe_pending = 0;
+            keyframes++;
+
+        }
+
+    }
+
+    /* Reading should stop only at the end of the recording */
+    if (keyframes != -1 && guac_error != GUAC_STATUS_CLOSED)
+        keyframes = -1;
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+    return keyframes;
+
+}
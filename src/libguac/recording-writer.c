@@ -0,0 +1,1013 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "guacamole/client.h"
+#include "guacamole/mem.h"
+#include "guacamole/recording.h"
+#include "guacamole/socket.h"
+#include "guacamole/timestamp.h"
+#include "recording-writer.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+/**
+ * The number of nanoseconds in a whole second.
+ */
+#define NANOS_PER_SECOND 1000000000L
+
+/**
+ * The ways in which the writer thread may pass data through the compressor.
+ */
+typedef enum guac_recording_writer_mode {
+
+    /**
+     * The data is compressed, but compressed output may remain buffered
+     * within the compressor.
+     */
+    GUAC_RECORDING_WRITER_CONTINUE,
+
+    /**
+     * The data is compressed, and all compressed output is then written to
+     * the file such that everything written thus far can be decompressed.
+     */
+    GUAC_RECORDING_WRITER_SYNC,
+
+    /**
+     * The data is compressed, and the compressed stream is then completed.
+     * No further data may be compressed.
+     */
+    GUAC_RECORDING_WRITER_FINISH
+
+} guac_recording_writer_mode;
+
+/**
+ * Data specific to the recording writer implementation of guac_socket. All
+ * data written to the socket is copied into a ring buffer, from which a
+ * dedicated writer thread compresses and writes that data to the recording
+ * file. Positions within the ring buffer are tracked as the total number of
+ * bytes that have passed through that position since the buffer was
+ * created.
+ */
+typedef struct guac_recording_writer {
+
+    /**
+     * The client whose log should receive any messages regarding problems
+     * writing the recording.
+     */
+    guac_client* client;
+
+    /**
+     * The file descriptor of the recording file.
+     */
+    int fd;
+
+    /**
+     * The compression applied to all data written to the recording file.
+     */
+    guac_recording_compression compression;
+
+    /**
+     * The action taken when the ring buffer is full.
+     */
+    guac_recording_overflow overflow;
+
+    /**
+     * Lock which is acquired when an instruction is being written, and
+     * released when the instruction is finished being written. This lock is
+     * recursive, such that a thread may hold the lock across several
+     * complete instructions (as is done while writing each keyframe).
+     */
+    pthread_mutex_t socket_lock;
+
+    /**
+     * The number of times socket_lock has been acquired by the thread
+     * currently holding that lock. This member is accessed only by the thread
+     * holding socket_lock.
+     */
+    int socket_depth;
+
+    /**
+     * Non-zero if an instruction is currently being written (socket_lock is
+     * held), zero otherwise.
+     */
+    int in_instruction;
+
+    /**
+     * Lock which guards all following members of this structure, except
+     * those used only by the writer thread.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled whenever the writer thread may have
+     * something new to do.
+     */
+    pthread_cond_t readable;
+
+    /**
+     * Condition which is signalled whenever the writer thread has freed
+     * space within the ring buffer.
+     */
+    pthread_cond_t writable;
+
+    /**
+     * The ring buffer, which is GUAC_RECORDING_BUFFER_SIZE bytes in size.
+     */
+    char* buffer;
+
+    /**
+     * The position just past the last byte written to the ring buffer.
+     */
+    uint64_t head;
+
+    /**
+     * The position just past the last complete instruction within the ring
+     * buffer. Unless output blocks when the buffer is full, only data prior
+     * to this position may be taken by the writer thread, as data following
+     * this position may yet be discarded.
+     */
+    uint64_t committed;
+
+    /**
+     * The position just past the last byte taken by the writer thread.
+     */
+    uint64_t tail;
+
+    /**
+     * Non-zero if the remainder of the instruction currently being written
+     * is being discarded, zero otherwise.
+     */
+    int discarding;
+
+    /**
+     * The number of bytes discarded since the last marker was written.
+     */
+    uint64_t discarded;
+
+    /**
+     * Non-zero if a marker noting discarded data must be written before the
+     * next instruction, zero otherwise.
+     */
+    int marker_pending;
+
+    /**
+     * Non-zero if the recording has stopped due to an error or due to the
+     * GUAC_RECORDING_OVERFLOW_ABORT policy, such that all further data is
+     * discarded, zero otherwise.
+     */
+    int stopped;
+
+    /**
+     * Non-zero if the writer thread should complete the recording once all
+     * buffered data has been written, zero otherwise.
+     */
+    int stopping;
+
+    /**
+     * The writer thread.
+     */
+    pthread_t thread;
+
+    /**
+     * Non-zero if data has been passed to the compressor since the
+     * compressor was last flushed. This member is used only by the writer
+     * thread.
+     */
+    int unsynced;
+
+    /**
+     * The time that the compressor was last flushed. This member is used
+     * only by the writer thread.
+     */
+    guac_timestamp last_sync;
+
+    /**
+     * Buffer receiving compressed data before that data is written to the
+     * recording file. This member is used only by the writer thread.
+     */
+    unsigned char out[GUAC_RECORDING_WRITER_CHUNK_SIZE];
+
+#ifdef ENABLE_ZLIB
+    /**
+     * The zlib stream used for gzip compression. This member is used only by
+     * the writer thread.
+     */
+    z_stream zlib;
+#endif
+
+#ifdef ENABLE_ZSTD
+    /**
+     * The zstd context used for zstd compression. This member is used only
+     * by the writer thread.
+     */
+    ZSTD_CCtx* zstd;
+#endif
+
+} guac_recording_writer;
+
+/**
+ * Writes the entire contents of the given buffer to the recording file,
+ * retrying as necessary until the whole buffer is written.
+ *
+ * @param writer
+ *     The writer whose recording file should receive the data.
+ *
+ * @param buf
+ *     The buffer containing the data to write.
+ *
+ * @param count
+ *     The number of bytes to write.
+ *
+ * @return
+ *     Zero if all data was written successfully, non-zero otherwise.
+ */
+static int guac_recording_writer_write_file(guac_recording_writer* writer,
+        const void* buf, size_t count) {
+
+    const char* buffer = buf;
+
+    while (count > 0) {
+
+        ssize_t written = write(writer->fd, buffer, count);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return 1;
+        }
+
+        buffer += written;
+        count -= written;
+
+    }
+
+    return 0;
+
+}
+
+#ifdef ENABLE_ZLIB
+/**
+ * Compresses the given data as gzip, writing the compressed output to the
+ * recording file.
+ *
+ * @param writer
+ *     The writer whose recording file should receive the compressed data.
+ *
+ * @param buf
+ *     The buffer containing the data to compress.
+ *
+ * @param count
+ *     The number of bytes to compress.
+ *
+ * @param mode
+ *     Whether compressed output may remain buffered, must all be written, or
+ *     must be written and the stream completed.
+ *
+ * @return
+ *     Zero if the data was compressed and written successfully, non-zero
+ *     otherwise.
+ */
+static int guac_recording_writer_gzip(guac_recording_writer* writer,
+        const char* buf, size_t count, guac_recording_writer_mode mode) {
+
+    z_stream* stream = &writer->zlib;
+    stream->next_in = (Bytef*) buf;
+    stream->avail_in = count;
+
+    int flush = Z_NO_FLUSH;
+    if (mode == GUAC_RECORDING_WRITER_SYNC)
+        flush = Z_SYNC_FLUSH;
+    else if (mode == GUAC_RECORDING_WRITER_FINISH)
+        flush = Z_FINISH;
+
+    /* Continue until the compressor no longer fills the output buffer */
+    do {
+
+        stream->next_out = writer->out;
+        stream->avail_out = sizeof(writer->out);
+
+        if (deflate(stream, flush) == Z_STREAM_ERROR)
+            return 1;
+
+        size_t length = sizeof(writer->out) - stream->avail_out;
+        if (guac_recording_writer_write_file(writer, writer->out, length))
+            return 1;
+
+    } while (stream->avail_out == 0);
+
+    return 0;
+
+}
+#endif
+
+#ifdef ENABLE_ZSTD
+/**
+ * Compresses the given data as zstd, writing the compressed output to the
+ * recording file.
+ *
+ * @param writer
+ *     The writer whose recording file should receive the compressed data.
+ *
+ * @param buf
+ *     The buffer containing the data to compress.
+ *
+ * @param count
+ *     The number of bytes to compress.
+ *
+ * @param mode
+ *     Whether compressed output may remain buffered, must all be written, or
+ *     must be written and the stream completed.
+ *
+ * @return
+ *     Zero if the data was compressed and written successfully, non-zero
+ *     otherwise.
+ */
+static int guac_recording_writer_zstd(guac_recording_writer* writer,
+        const char* buf, size_t count, guac_recording_writer_mode mode) {
+
+    ZSTD_inBuffer input = { .src = buf, .size = count, .pos = 0 };
+
+    ZSTD_EndDirective directive = ZSTD_e_continue;
+    if (mode == GUAC_RECORDING_WRITER_SYNC)
+        directive = ZSTD_e_flush;
+    else if (mode == GUAC_RECORDING_WRITER_FINISH)
+        directive = ZSTD_e_end;
+
+    for (;;) {
+
+        ZSTD_outBuffer output = {
+            .dst = writer->out,
+            .size = sizeof(writer->out),
+            .pos = 0
+        };
+
+        size_t remaining = ZSTD_compressStream2(writer->zstd, &output,
+                &input, directive);
+
+        if (ZSTD_isError(remaining))
+            return 1;
+
+        if (guac_recording_writer_write_file(writer, writer->out, output.pos))
+            return 1;
+
+        /* Input is fully consumed when continuing, while flushing and
+         * finishing are complete only once nothing remains to be written */
+        if (directive == ZSTD_e_continue ? input.pos == input.size
+                                         : remaining == 0)
+            break;
+
+    }
+
+    return 0;
+
+}
+#endif
+
+/**
+ * Compresses the given data using the compression of the given writer (if
+ * any), writing the result to the recording file.
+ *
+ * @param writer
+ *     The writer whose recording file should receive the data.
+ *
+ * @param buf
+ *     The buffer containing the data to compress.
+ *
+ * @param count
+ *     The number of bytes to compress.
+ *
+ * @param mode
+ *     Whether compressed output may remain buffered, must all be written, or
+ *     must be written and the stream completed.
+ *
+ * @return
+ *     Zero if the data was written successfully, non-zero otherwise.
+ */
+static int guac_recording_writer_compress(guac_recording_writer* writer,
+        const char* buf, size_t count, guac_recording_writer_mode mode) {
+
+    switch (writer->compression) {
+
+#ifdef ENABLE_ZLIB
+        case GUAC_RECORDING_COMPRESSION_GZIP:
+            return guac_recording_writer_gzip(writer, buf, count, mode);
+#endif
+
+#ifdef ENABLE_ZSTD
+        case GUAC_RECORDING_COMPRESSION_ZSTD:
+            return guac_recording_writer_zstd(writer, buf, count, mode);
+#endif
+
+        default:
+            return guac_recording_writer_write_file(writer, buf, count);
+
+    }
+
+}
+
+/**
+ * Waits for the readable condition of the given writer to be signalled, or
+ * for the given number of milliseconds to elapse. The lock of the writer
+ * MUST be held.
+ *
+ * @param writer
+ *     The writer to wait for.
+ *
+ * @param msec_timeout
+ *     The maximum number of milliseconds to wait.
+ */
+static void guac_recording_writer_timedwait(guac_recording_writer* writer,
+        int msec_timeout) {
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    deadline.tv_sec += msec_timeout / 1000;
+    deadline.tv_nsec += (msec_timeout % 1000) * 1000000L;
+    if (deadline.tv_nsec >= NANOS_PER_SECOND) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= NANOS_PER_SECOND;
+    }
+
+    pthread_cond_timedwait(&writer->readable, &writer->lock, &deadline);
+
+}
+
+/**
+ * The thread which takes data from the ring buffer of a recording writer,
+ * compressing and writing that data to the recording file until the writer
+ * is stopping and all remaining data has been written.
+ *
+ * @param data
+ *     The guac_recording_writer whose data should be written.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_recording_writer_thread(void* data) {
+
+    guac_recording_writer* writer = (guac_recording_writer*) data;
+
+    pthread_mutex_lock(&writer->lock);
+
+    for (;;) {
+
+        /* Data may be discarded up until the instruction containing it is
+         * complete, except when output blocks, in which case nothing is ever
+         * discarded */
+        uint64_t end = writer->committed;
+        if (writer->overflow == GUAC_RECORDING_OVERFLOW_BLOCK)
+            end = writer->head;
+
+        if (end == writer->tail) {
+
+            if (writer->stopping)
+                break;
+
+            /* Flush the compressor if it has been holding data for a while */
+            if (writer->unsynced) {
+
+                guac_timestamp elapsed = guac_timestamp_current()
+                    - writer->last_sync;
+
+                if (elapsed < GUAC_RECORDING_SYNC_INTERVAL) {
+                    guac_recording_writer_timedwait(writer,
+                            GUAC_RECORDING_SYNC_INTERVAL - elapsed);
+                    continue;
+                }
+
+                pthread_mutex_unlock(&writer->lock);
+                int failed = guac_recording_writer_compress(writer, NULL, 0,
+                        GUAC_RECORDING_WRITER_SYNC);
+                pthread_mutex_lock(&writer->lock);
+
+                writer->unsynced = 0;
+                writer->last_sync = guac_timestamp_current();
+
+                if (failed)
+                    goto write_failed;
+
+                continue;
+
+            }
+
+            pthread_cond_wait(&writer->readable, &writer->lock);
+            continue;
+
+        }
+
+        /* Take as much contiguous data from the ring buffer as possible */
+        size_t offset = writer->tail % GUAC_RECORDING_BUFFER_SIZE;
+        size_t length = end - writer->tail;
+        if (length > GUAC_RECORDING_BUFFER_SIZE - offset)
+            length = GUAC_RECORDING_BUFFER_SIZE - offset;
+
+        /* Write without holding the lock, such that the ring buffer may
+         * continue to receive data */
+        pthread_mutex_unlock(&writer->lock);
+        int failed = guac_recording_writer_compress(writer,
+                writer->buffer + offset, length,
+                GUAC_RECORDING_WRITER_CONTINUE);
+        pthread_mutex_lock(&writer->lock);
+
+        writer->tail += length;
+        writer->unsynced = (writer->compression != GUAC_RECORDING_COMPRESSION_NONE);
+        pthread_cond_broadcast(&writer->writable);
+
+        if (failed)
+            goto write_failed;
+
+    }
+
+    pthread_mutex_unlock(&writer->lock);
+
+    /* Complete the compressed stream, if any */
+    if (guac_recording_writer_compress(writer, NULL, 0,
+                GUAC_RECORDING_WRITER_FINISH))
+        guac_client_log(writer->client, GUAC_LOG_WARNING, "Recording could "
+                "not be completed: %s", strerror(errno));
+
+    return NULL;
+
+write_failed:
+
+    guac_client_log(writer->client, GUAC_LOG_ERROR, "Recording could not be "
+            "written and has been stopped: %s", strerror(errno));
+
+    /* Discard everything, including data already buffered, such that
+     * nothing waits on the recording */
+    writer->stopped = 1;
+    writer->head = writer->committed = writer->tail;
+    pthread_cond_broadcast(&writer->writable);
+
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+
+}
+
+/**
+ * Copies the given data to the end of the ring buffer of the given writer.
+ * The lock of the writer MUST be held, and the ring buffer MUST have space
+ * for the data.
+ *
+ * @param writer
+ *     The writer whose ring buffer should receive the data.
+ *
+ * @param buf
+ *     The buffer containing the data to copy.
+ *
+ * @param count
+ *     The number of bytes to copy.
+ */
+static void guac_recording_writer_append(guac_recording_writer* writer,
+        const char* buf, size_t count) {
+
+    while (count > 0) {
+
+        size_t offset = writer->head % GUAC_RECORDING_BUFFER_SIZE;
+        size_t length = GUAC_RECORDING_BUFFER_SIZE - offset;
+        if (length > count)
+            length = count;
+
+        memcpy(writer->buffer + offset, buf, length);
+        writer->head += length;
+
+        buf += length;
+        count -= length;
+
+    }
+
+}
+
+/**
+ * Marks all data within the ring buffer of the given writer as complete,
+ * such that the writer thread may write that data. The lock of the writer
+ * MUST be held.
+ *
+ * @param writer
+ *     The writer whose ring buffer contents are complete.
+ */
+static void guac_recording_writer_commit(guac_recording_writer* writer) {
+    writer->committed = writer->head;
+    pthread_cond_signal(&writer->readable);
+}
+
+/**
+ * Writes a "log" instruction noting the amount of data discarded since the
+ * last such instruction, if there is space within the ring buffer. The lock
+ * of the writer MUST be held, and no instruction may be partially written.
+ *
+ * @param writer
+ *     The writer which has discarded data.
+ *
+ * @return
+ *     Non-zero if the marker was written, zero if there is not yet space.
+ */
+static int guac_recording_writer_append_marker(guac_recording_writer* writer) {
+
+    char message[64];
+    snprintf(message, sizeof(message), "Recording discarded %" PRIu64
+            " bytes", writer->discarded);
+
+    char marker[96];
+    int length = snprintf(marker, sizeof(marker), "3.log,%zu.%s;",
+            strlen(message), message);
+
+    if (GUAC_RECORDING_BUFFER_SIZE - (writer->head - writer->tail) < (size_t) length)
+        return 0;
+
+    guac_recording_writer_append(writer, marker, length);
+    guac_recording_writer_commit(writer);
+
+    writer->discarded = 0;
+    writer->marker_pending = 0;
+    return 1;
+
+}
+
+/**
+ * Discards the partially-written instruction at the end of the ring buffer
+ * of the given writer, along with the rest of that instruction, in
+ * accordance with the writer's overflow policy. The lock of the writer MUST
+ * be held.
+ *
+ * @param writer
+ *     The writer whose ring buffer is full.
+ *
+ * @param remaining
+ *     The number of bytes of the current write that could not be added to
+ *     the ring buffer.
+ */
+static void guac_recording_writer_overflow(guac_recording_writer* writer,
+        size_t remaining) {
+
+    writer->discarded += writer->head - writer->committed + remaining;
+    writer->head = writer->committed;
+
+    if (writer->overflow == GUAC_RECORDING_OVERFLOW_ABORT) {
+        guac_client_log(writer->client, GUAC_LOG_WARNING, "Recording is not "
+                "keeping up with the connection and has been stopped.");
+        writer->stopped = 1;
+        return;
+    }
+
+    if (!writer->marker_pending)
+        guac_client_log(writer->client, GUAC_LOG_WARNING, "Recording is not "
+                "keeping up with the connection. Recording data is being "
+                "discarded.");
+
+    writer->marker_pending = 1;
+    writer->discarding = writer->in_instruction;
+
+}
+
+/**
+ * Copies the given data into the ring buffer of the recording writer
+ * associated with the given socket. If the ring buffer is full, this
+ * function either blocks or discards data, as dictated by the overflow
+ * policy of the writer.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param buf
+ *     The buffer containing the data to write.
+ *
+ * @param count
+ *     The number of bytes to write.
+ *
+ * @return
+ *     The number of bytes written, which is always the number of bytes
+ *     requested, as data that cannot be written is discarded.
+ */
+static ssize_t guac_recording_writer_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_recording_writer* writer = (guac_recording_writer*) socket->data;
+    const char* buffer = buf;
+    size_t remaining = count;
+
+    pthread_mutex_lock(&writer->lock);
+
+    /* Discard everything after the recording has stopped, as well as the
+     * remainder of any instruction that did not fit */
+    if (writer->stopped || writer->discarding) {
+        writer->discarded += count;
+        goto done;
+    }
+
+    /* Note any gap before the first instruction that follows it */
+    if (writer->marker_pending && writer->head == writer->committed
+            && !guac_recording_writer_append_marker(writer)) {
+        guac_recording_writer_overflow(writer, remaining);
+        goto done;
+    }
+
+    while (remaining > 0) {
+
+        size_t space = GUAC_RECORDING_BUFFER_SIZE
+            - (writer->head - writer->tail);
+
+        if (space == 0) {
+
+            if (writer->overflow != GUAC_RECORDING_OVERFLOW_BLOCK) {
+                guac_recording_writer_overflow(writer, remaining);
+                goto done;
+            }
+
+            /* Wait for the writer thread to make space */
+            pthread_cond_signal(&writer->readable);
+            pthread_cond_wait(&writer->writable, &writer->lock);
+
+            if (writer->stopped)
+                goto done;
+
+            continue;
+
+        }
+
+        if (space > remaining)
+            space = remaining;
+
+        guac_recording_writer_append(writer, buffer, space);
+        buffer += space;
+        remaining -= space;
+
+    }
+
+    /* Data written outside of any instruction is complete as written */
+    if (!writer->in_instruction)
+        guac_recording_writer_commit(writer);
+
+done:
+    pthread_mutex_unlock(&writer->lock);
+    return count;
+
+}
+
+/**
+ * Flushes the given socket. As all data is written to the recording file by
+ * the writer thread as soon as each instruction is complete, this function
+ * has no effect.
+ *
+ * @param socket
+ *     The guac_socket to flush.
+ *
+ * @return
+ *     Always zero.
+ */
+static ssize_t guac_recording_writer_flush_handler(guac_socket* socket) {
+    return 0;
+}
+
+/**
+ * Acquires exclusive access to the given socket for the duration of an
+ * instruction.
+ *
+ * @param socket
+ *     The guac_socket to which exclusive access is required.
+ */
+static void guac_recording_writer_lock_handler(guac_socket* socket) {
+
+    guac_recording_writer* writer = (guac_recording_writer*) socket->data;
+
+    pthread_mutex_lock(&writer->socket_lock);
+    writer->socket_depth++;
+    writer->in_instruction = 1;
+
+}
+
+/**
+ * Completes the instruction being written to the given socket, allowing the
+ * writer thread to write that instruction, and relinquishes exclusive access
+ * to the socket. If exclusive access was acquired more than once by the
+ * current thread, the instruction is still completed, but the socket remains
+ * exclusively held until access has been relinquished an equal number of
+ * times.
+ *
+ * @param socket
+ *     The guac_socket to which exclusive access is no longer required.
+ */
+static void guac_recording_writer_unlock_handler(guac_socket* socket) {
+
+    guac_recording_writer* writer = (guac_recording_writer*) socket->data;
+
+    pthread_mutex_lock(&writer->lock);
+
+    /* The instruction is complete, whether discarded or not */
+    if (writer->discarding)
+        writer->discarding = 0;
+    else
+        guac_recording_writer_commit(writer);
+
+    writer->socket_depth--;
+    writer->in_instruction = (writer->socket_depth > 0);
+
+    pthread_mutex_unlock(&writer->lock);
+    pthread_mutex_unlock(&writer->socket_lock);
+
+}
+
+/**
+ * Frees the compressor of the given writer, if any.
+ *
+ * @param writer
+ *     The writer whose compressor should be freed.
+ */
+static void guac_recording_writer_free_compressor(
+        guac_recording_writer* writer) {
+
+#ifdef ENABLE_ZLIB
+    if (writer->compression == GUAC_RECORDING_COMPRESSION_GZIP)
+        deflateEnd(&writer->zlib);
+#endif
+
+#ifdef ENABLE_ZSTD
+    if (writer->compression == GUAC_RECORDING_COMPRESSION_ZSTD)
+        ZSTD_freeCCtx(writer->zstd);
+#endif
+
+}
+
+/**
+ * Writes all remaining buffered data to the recording file, completes the
+ * recording, and frees all implementation-specific data associated with the
+ * given socket, but not the socket object itself.
+ *
+ * @param socket
+ *     The guac_socket whose associated data should be freed.
+ *
+ * @return
+ *     Always zero.
+ */
+static int guac_recording_writer_free_handler(guac_socket* socket) {
+
+    guac_recording_writer* writer = (guac_recording_writer*) socket->data;
+
+    /* Wait for remaining data to be written */
+    pthread_mutex_lock(&writer->lock);
+    writer->stopping = 1;
+    pthread_cond_signal(&writer->readable);
+    pthread_mutex_unlock(&writer->lock);
+
+    pthread_join(writer->thread, NULL);
+
+    guac_recording_writer_free_compressor(writer);
+    close(writer->fd);
+
+    pthread_cond_destroy(&writer->writable);
+    pthread_cond_destroy(&writer->readable);
+    pthread_mutex_destroy(&writer->lock);
+    pthread_mutex_destroy(&writer->socket_lock);
+
+    guac_mem_free(writer->buffer);
+    guac_mem_free(writer);
+    return 0;
+
+}
+
+/**
+ * Initializes the compressor of the given writer, if the writer compresses
+ * the recording. If the compressor cannot be initialized, a warning is
+ * logged and the writer instead writes the recording uncompressed.
+ *
+ * @param writer
+ *     The writer whose compressor should be initialized.
+ */
+static void guac_recording_writer_init_compressor(
+        guac_recording_writer* writer) {
+
+    int failed = 0;
+
+#ifdef ENABLE_ZLIB
+    /* A window of 15 bits, plus 16 to produce gzip rather than zlib */
+    if (writer->compression == GUAC_RECORDING_COMPRESSION_GZIP)
+        failed = deflateInit2(&writer->zlib, GUAC_RECORDING_WRITER_GZIP_LEVEL,
+                Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK;
+#endif
+
+#ifdef ENABLE_ZSTD
+    if (writer->compression == GUAC_RECORDING_COMPRESSION_ZSTD) {
+        writer->zstd = ZSTD_createCCtx();
+        failed = writer->zstd == NULL || ZSTD_isError(ZSTD_CCtx_setParameter(
+                    writer->zstd, ZSTD_c_compressionLevel,
+                    GUAC_RECORDING_WRITER_ZSTD_LEVEL));
+        if (failed)
+            ZSTD_freeCCtx(writer->zstd);
+    }
+#endif
+
+    if (failed) {
+        guac_client_log(writer->client, GUAC_LOG_WARNING, "Recording "
+                "compression could not be initialized. The recording will "
+                "not be compressed.");
+        writer->compression = GUAC_RECORDING_COMPRESSION_NONE;
+    }
+
+}
+
+guac_socket* guac_recording_writer_alloc(guac_client* client, int fd,
+        guac_recording_compression compression,
+        guac_recording_overflow overflow) {
+
+    guac_recording_writer* writer = guac_mem_zalloc(sizeof(guac_recording_writer));
+    writer->client = client;
+    writer->fd = fd;
+    writer->compression = compression;
+    writer->overflow = overflow;
+    writer->buffer = guac_mem_alloc(GUAC_RECORDING_BUFFER_SIZE);
+    writer->last_sync = guac_timestamp_current();
+
+    guac_recording_writer_init_compressor(writer);
+
+    /* The writer thread waits using the monotonic clock, which is not
+     * subject to changes in system time */
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&writer->readable, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+
+    pthread_cond_init(&writer->writable, NULL);
+    pthread_mutex_init(&writer->lock, NULL);
+
+    pthread_mutexattr_t socket_lock_attr;
+    pthread_mutexattr_init(&socket_lock_attr);
+    pthread_mutexattr_settype(&socket_lock_attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&writer->socket_lock, &socket_lock_attr);
+    pthread_mutexattr_destroy(&socket_lock_attr);
+
+    if (pthread_create(&writer->thread, NULL, guac_recording_writer_thread,
+                writer)) {
+
+        guac_client_log(client, GUAC_LOG_ERROR, "Unable to start recording "
+                "writer thread.");
+
+        guac_recording_writer_free_compressor(writer);
+        pthread_cond_destroy(&writer->writable);
+        pthread_cond_destroy(&writer->readable);
+        pthread_mutex_destroy(&writer->lock);
+        pthread_mutex_destroy(&writer->socket_lock);
+        guac_mem_free(writer->buffer);
+        guac_mem_free(writer);
+        return NULL;
+
+    }
+
+    guac_socket* socket = guac_socket_alloc();
+    socket->data = writer;
+
+    socket->write_handler  = guac_recording_writer_write_handler;
+    socket->lock_handler   = guac_recording_writer_lock_handler;
+    socket->unlock_handler = guac_recording_writer_unlock_handler;
+    socket->flush_handler  = guac_recording_writer_flush_handler;
+    socket->free_handler   = guac_recording_writer_free_handler;
+
+    return socket;
+
+}
+
+uint64_t guac_recording_writer_tell(guac_socket* socket) {
+
+    guac_recording_writer* writer = (guac_recording_writer*) socket->data;
+
+    pthread_mutex_lock(&writer->lock);
+    uint64_t offset = writer->head;
+    pthread_mutex_unlock(&writer->lock);
+
+    return offset;
+
+}
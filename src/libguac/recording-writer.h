@@ -0,0 +1,104 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_RECORDING_WRITER_H
+#define GUAC_RECORDING_WRITER_H
+
+/**
+ * Provides the guac_socket implementation which writes session recordings
+ * from a dedicated thread. This is used only internally within libguac, and
+ * is not installed along with the library.
+ *
+ * @file recording-writer.h
+ */
+
+#include "guacamole/client.h"
+#include "guacamole/recording.h"
+#include "guacamole/socket.h"
+
+#include <stdint.h>
+
+/**
+ * The number of bytes of compressed data that the writer thread accumulates
+ * before writing that data to the recording file.
+ */
+#define GUAC_RECORDING_WRITER_CHUNK_SIZE 65536
+
+/**
+ * The zlib compression level used for gzip-compressed recordings. Recordings
+ * consist largely of already-compressed image data, so higher levels cost
+ * far more CPU time than they save in space.
+ */
+#define GUAC_RECORDING_WRITER_GZIP_LEVEL 3
+
+/**
+ * The zstd compression level used for zstd-compressed recordings.
+ */
+#define GUAC_RECORDING_WRITER_ZSTD_LEVEL 3
+
+/**
+ * Returns a new guac_socket which writes all data to the given file from a
+ * dedicated thread, buffering up to GUAC_RECORDING_BUFFER_SIZE bytes between
+ * the threads writing to the socket and the file. Freeing the socket writes
+ * all remaining buffered data, completes the compressed stream (if any), and
+ * closes the file.
+ *
+ * @param client
+ *     The client whose log should receive any messages regarding problems
+ *     writing the recording.
+ *
+ * @param fd
+ *     The file descriptor of the recording file to write to.
+ *
+ * @param compression
+ *     The compression to apply to all data written. This compression MUST be
+ *     supported by this build of libguac.
+ *
+ * @param overflow
+ *     The action to take when data is written faster than the file can
+ *     receive it and the buffer is full.
+ *
+ * @return
+ *     A new guac_socket which writes to the given file, or NULL if the
+ *     writer thread could not be started.
+ */
+guac_socket* guac_recording_writer_alloc(guac_client* client, int fd,
+        guac_recording_compression compression,
+        guac_recording_overflow overflow);
+
+/**
+ * Returns the offset within the uncompressed recording at which the next
+ * instruction written to the given recording writer socket will begin. This
+ * function MUST be invoked only between calls to
+ * guac_socket_instruction_begin() and guac_socket_instruction_end() for that
+ * socket, and before any part of the instruction has been written, as the
+ * offset is otherwise not guaranteed to lie between instructions.
+ *
+ * @param socket
+ *     A socket returned by guac_recording_writer_alloc().
+ *
+ * @return
+ *     The offset of the next instruction within the uncompressed recording,
+ *     in bytes.
+ */
+uint64_t guac_recording_writer_tell(guac_socket* socket);
+
+#endif
+
@@ -17,14 +17,20 @@
  * under the License.
  */
 
+#include "config.h"
+
 #include "guacamole/mem.h"
 #include "guacamole/client.h"
 #include "guacamole/error.h"
 #include "guacamole/file.h"
+#include "guacamole/flag.h"
 #include "guacamole/protocol.h"
 #include "guacamole/recording.h"
 #include "guacamole/socket.h"
+#include "guacamole/string.h"
 #include "guacamole/timestamp.h"
+#include "recording-index.h"
+#include "recording-writer.h"
 
 #ifdef __MINGW32__
 #include <direct.h>
@@ -34,15 +40,162 @@
 #include <sys/types.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
+/**
+ * Flag value which is set when the keyframe thread of a recording should
+ * stop.
+ */
+#define GUAC_RECORDING_KEYFRAMES_STOPPING 1
+
+struct guac_recording_keyframes {
+
+    /**
+     * The client being recorded.
+     */
+    guac_client* client;
+
+    /**
+     * The directory containing the recording file.
+     */
+    char* path;
+
+    /**
+     * The name of the recording file within its directory.
+     */
+    char* filename;
+
+    /**
+     * The number of milliseconds between keyframes, or zero if keyframes
+     * have not been enabled.
+     */
+    int interval;
+
+    /**
+     * The file descriptor of the index listing each keyframe, or -1 if
+     * keyframes have not been enabled.
+     */
+    int index_fd;
+
+    /**
+     * The thread writing keyframes at the requested interval.
+     */
+    pthread_t thread;
+
+    /**
+     * Flag which is set to GUAC_RECORDING_KEYFRAMES_STOPPING when the
+     * keyframe thread should stop. The lock of this flag guards the handler
+     * and data below, and is held while each keyframe is written.
+     */
+    guac_flag state;
+
+    /**
+     * The handler which writes each keyframe, or NULL if keyframes should not
+     * currently be written.
+     */
+    guac_recording_keyframe_handler* handler;
+
+    /**
+     * Arbitrary data to pass to the keyframe handler.
+     */
+    void* data;
+
+};
+
+/**
+ * Parses the given name of a recording compression method, as may be
+ * provided to guac_recording_create(). If the method is unknown or not
+ * supported by this build of libguac, a warning is logged and the recording
+ * will not be compressed.
+ *
+ * @param client
+ *     The client whose log should receive any warnings.
+ *
+ * @param name
+ *     The name of the compression method, or NULL for no compression.
+ *
+ * @return
+ *     The compression method having the given name.
+ */
+static guac_recording_compression guac_recording_parse_compression(
+        guac_client* client, const char* name) {
+
+    if (name == NULL || *name == '\0'
+            || strcmp(name, GUAC_RECORDING_COMPRESSION_NONE_NAME) == 0)
+        return GUAC_RECORDING_COMPRESSION_NONE;
+
+    if (strcmp(name, GUAC_RECORDING_COMPRESSION_GZIP_NAME) == 0) {
+#ifdef ENABLE_ZLIB
+        return GUAC_RECORDING_COMPRESSION_GZIP;
+#else
+        guac_client_log(client, GUAC_LOG_WARNING, "Recording compression "
+                "\"%s\" is not supported by this build of libguac. The "
+                "recording will not be compressed.", name);
+        return GUAC_RECORDING_COMPRESSION_NONE;
+#endif
+    }
+
+    if (strcmp(name, GUAC_RECORDING_COMPRESSION_ZSTD_NAME) == 0) {
+#ifdef ENABLE_ZSTD
+        return GUAC_RECORDING_COMPRESSION_ZSTD;
+#else
+        guac_client_log(client, GUAC_LOG_WARNING, "Recording compression "
+                "\"%s\" is not supported by this build of libguac. The "
+                "recording will not be compressed.", name);
+        return GUAC_RECORDING_COMPRESSION_NONE;
+#endif
+    }
+
+    guac_client_log(client, GUAC_LOG_WARNING, "Unknown recording compression "
+            "\"%s\". The recording will not be compressed.", name);
+    return GUAC_RECORDING_COMPRESSION_NONE;
+
+}
+
+/**
+ * Parses the given name of a recording overflow policy, as may be provided
+ * to guac_recording_create(). If the policy is unknown, a warning is logged
+ * and GUAC_RECORDING_OVERFLOW_BLOCK is used.
+ *
+ * @param client
+ *     The client whose log should receive any warnings.
+ *
+ * @param name
+ *     The name of the overflow policy, or NULL for the default policy.
+ *
+ * @return
+ *     The overflow policy having the given name.
+ */
+static guac_recording_overflow guac_recording_parse_overflow(
+        guac_client* client, const char* name) {
+
+    if (name == NULL || *name == '\0'
+            || strcmp(name, GUAC_RECORDING_OVERFLOW_BLOCK_NAME) == 0)
+        return GUAC_RECORDING_OVERFLOW_BLOCK;
+
+    if (strcmp(name, GUAC_RECORDING_OVERFLOW_DROP_NAME) == 0)
+        return GUAC_RECORDING_OVERFLOW_DROP;
+
+    if (strcmp(name, GUAC_RECORDING_OVERFLOW_ABORT_NAME) == 0)
+        return GUAC_RECORDING_OVERFLOW_ABORT;
+
+    guac_client_log(client, GUAC_LOG_WARNING, "Unknown recording overflow "
+            "policy \"%s\". Output will block if the recording falls "
+            "behind.", name);
+    return GUAC_RECORDING_OVERFLOW_BLOCK;
+
+}
+
 guac_recording* guac_recording_create(guac_client* client,
         const char* path, const char* name, int create_path,
         int include_output, int include_mouse, int include_touch,
-        int include_keys, int allow_write_existing) {
+        int include_keys, int allow_write_existing,
+        const char* compression, const char* overflow) {
 
     char filename[GUAC_COMMON_RECORDING_MAX_NAME_LENGTH];
 
@@ -69,14 +222,32 @@ guac_recording* guac_recording_create(guac_client* client,
         return NULL;
     }
 
+    /* Write recording from a dedicated thread */
+    guac_socket* socket = guac_recording_writer_alloc(client, fd,
+            guac_recording_parse_compression(client, compression),
+            guac_recording_parse_overflow(client, overflow));
+    if (socket == NULL) {
+        close(fd);
+        return NULL;
+    }
+
     /* Create recording structure with reference to underlying socket */
     guac_recording* recording = guac_mem_alloc(sizeof(guac_recording));
-    recording->socket = guac_socket_open(fd);
+    recording->socket = socket;
     recording->include_output = include_output;
     recording->include_mouse = include_mouse;
     recording->include_touch = include_touch;
     recording->include_keys = include_keys;
 
+    /* Keyframes remain disabled until guac_recording_enable_keyframes() */
+    guac_recording_keyframes* keyframes = guac_mem_zalloc(sizeof(guac_recording_keyframes));
+    keyframes->client = client;
+    keyframes->path = guac_strdup(path);
+    keyframes->filename = guac_strdup(filename);
+    keyframes->index_fd = -1;
+    guac_flag_init(&keyframes->state);
+    recording->__keyframes = keyframes;
+
     /* Replace client socket with wrapped recording socket only if including
      * output within the recording */
     if (include_output)
@@ -90,8 +261,308 @@ guac_recording* guac_recording_create(guac_client* client,
 
 }
 
+/**
+ * The state of the socket provided to the keyframe handler of a recording,
+ * which delegates all writes to the socket of that recording.
+ */
+typedef struct guac_recording_keyframe_socket_data {
+
+    /**
+     * The socket of the recording receiving the keyframe.
+     */
+    guac_socket* socket;
+
+    /**
+     * Non-zero if the keyframe handler has begun writing the keyframe, in
+     * which case the instruction lock of the recording's socket is held until
+     * the keyframe is complete, zero otherwise.
+     */
+    int started;
+
+    /**
+     * The offset of the beginning of the keyframe within the recording. This
+     * value is only meaningful if started is non-zero.
+     */
+    uint64_t offset;
+
+} guac_recording_keyframe_socket_data;
+
+/**
+ * Begins the keyframe being written through the given keyframe socket, if
+ * not already begun, acquiring the instruction lock of the recording's
+ * socket and marking the beginning of the keyframe. That lock is held until
+ * the keyframe is complete, such that no other instruction can be written to
+ * the recording in the middle of the keyframe.
+ *
+ * The lock is deliberately not acquired until the keyframe handler begins
+ * writing, as handlers first wait for any frame in progress to finish being
+ * sent, and that frame is also written to the recording.
+ *
+ * @param data
+ *     The state of the keyframe socket.
+ */
+static void guac_recording_keyframe_start(guac_recording_keyframe_socket_data* data) {
+
+    if (data->started)
+        return;
+
+    char marker[64];
+    int length = snprintf(marker, sizeof(marker), "3.log,%zu.%s;",
+            strlen(GUAC_RECORDING_KEYFRAME_MESSAGE),
+            GUAC_RECORDING_KEYFRAME_MESSAGE);
+
+    /* Mark the beginning of the keyframe, noting where that is within the
+     * recording while no other instruction can be partially written */
+    guac_socket_instruction_begin(data->socket);
+    data->offset = guac_recording_writer_tell(data->socket);
+    guac_socket_write(data->socket, marker, length);
+    data->started = 1;
+
+}
+
+/**
+ * Writes data to the recording receiving the keyframe, beginning that
+ * keyframe if necessary.
+ *
+ * @param socket
+ *     The keyframe socket being written to.
+ *
+ * @param buf
+ *     The data to write.
+ *
+ * @param count
+ *     The number of bytes to write.
+ *
+ * @return
+ *     The number of bytes written, or -1 if an error occurs.
+ */
+static ssize_t guac_recording_keyframe_socket_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_recording_keyframe_socket_data* data = socket->data;
+    guac_recording_keyframe_start(data);
+
+    if (guac_socket_write(data->socket, buf, count))
+        return -1;
+
+    return count;
+
+}
+
+/**
+ * Flushes the socket of the recording receiving the keyframe.
+ *
+ * @param socket
+ *     The keyframe socket being flushed.
+ *
+ * @return
+ *     Zero on success, non-zero if an error occurs.
+ */
+static ssize_t guac_recording_keyframe_socket_flush_handler(guac_socket* socket) {
+    guac_recording_keyframe_socket_data* data = socket->data;
+    return guac_socket_flush(data->socket);
+}
+
+/**
+ * Begins an instruction within the keyframe, beginning that keyframe if
+ * necessary.
+ *
+ * @param socket
+ *     The keyframe socket that an instruction is being written to.
+ */
+static void guac_recording_keyframe_socket_lock_handler(guac_socket* socket) {
+    guac_recording_keyframe_socket_data* data = socket->data;
+    guac_recording_keyframe_start(data);
+    guac_socket_instruction_begin(data->socket);
+}
+
+/**
+ * Ends an instruction within the keyframe. The instruction lock of the
+ * recording's socket remains held until the keyframe is complete.
+ *
+ * @param socket
+ *     The keyframe socket that an instruction was written to.
+ */
+static void guac_recording_keyframe_socket_unlock_handler(guac_socket* socket) {
+    guac_recording_keyframe_socket_data* data = socket->data;
+    guac_socket_instruction_end(data->socket);
+}
+
+/**
+ * Writes a single keyframe to the given recording using its keyframe
+ * handler, listing that keyframe within the index. The lock of the
+ * keyframe state flag MUST be held, and a keyframe handler MUST be assigned.
+ *
+ * @param recording
+ *     The recording that should receive the keyframe.
+ */
+static void guac_recording_write_keyframe(guac_recording* recording) {
+
+    guac_recording_keyframes* keyframes = recording->__keyframes;
+
+    guac_recording_keyframe_socket_data data = {
+        .socket = recording->socket
+    };
+
+    /* The handler writes through a socket which holds the instruction lock
+     * of the recording from the handler's first write until the keyframe is
+     * complete */
+    guac_socket* socket = guac_socket_alloc();
+    socket->data = &data;
+    socket->write_handler = guac_recording_keyframe_socket_write_handler;
+    socket->flush_handler = guac_recording_keyframe_socket_flush_handler;
+    socket->lock_handler = guac_recording_keyframe_socket_lock_handler;
+    socket->unlock_handler = guac_recording_keyframe_socket_unlock_handler;
+
+    keyframes->handler(socket, keyframes->data);
+    guac_socket_free(socket);
+
+    /* Nothing is recorded if the handler wrote nothing */
+    if (!data.started)
+        return;
+
+    guac_socket_instruction_end(recording->socket);
+    guac_socket_flush(recording->socket);
+
+    /* The keyframe ends with a frame no later than the most recent frame */
+    if (guac_recording_index_write(keyframes->index_fd,
+                keyframes->client->last_sent_timestamp, data.offset))
+        guac_client_log(keyframes->client, GUAC_LOG_WARNING, "Keyframe could "
+                "not be added to the recording index: %s", strerror(errno));
+
+}
+
+/**
+ * The thread which writes a keyframe to a recording at the interval
+ * requested with guac_recording_enable_keyframes(), until the recording is
+ * freed.
+ *
+ * @param data
+ *     The guac_recording that should receive keyframes.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_recording_keyframe_thread(void* data) {
+
+    guac_recording* recording = (guac_recording*) data;
+    guac_recording_keyframes* keyframes = recording->__keyframes;
+
+    for (;;) {
+
+        /* Stop if requested before the next keyframe is due */
+        if (guac_flag_timedwait_and_lock(&keyframes->state,
+                    GUAC_RECORDING_KEYFRAMES_STOPPING, keyframes->interval))
+            break;
+
+        guac_flag_lock(&keyframes->state);
+
+        if (keyframes->state.value & GUAC_RECORDING_KEYFRAMES_STOPPING)
+            break;
+
+        if (keyframes->handler != NULL)
+            guac_recording_write_keyframe(recording);
+
+        guac_flag_unlock(&keyframes->state);
+
+    }
+
+    guac_flag_unlock(&keyframes->state);
+    return NULL;
+
+}
+
+int guac_recording_enable_keyframes(guac_recording* recording, int interval) {
+
+    guac_recording_keyframes* keyframes = recording->__keyframes;
+    guac_client* client = keyframes->client;
+
+    /* Keyframes are meaningless without the output they reproduce */
+    if (!recording->include_output) {
+        guac_client_log(client, GUAC_LOG_WARNING, "Keyframes cannot be "
+                "written to recordings that exclude output.");
+        return 1;
+    }
+
+    if (keyframes->index_fd != -1) {
+        guac_client_log(client, GUAC_LOG_WARNING, "Keyframes have already "
+                "been enabled for this recording.");
+        return 1;
+    }
+
+    char index_name[GUAC_COMMON_RECORDING_MAX_NAME_LENGTH];
+    if (guac_strlcpy(index_name, keyframes->filename, sizeof(index_name))
+                >= sizeof(index_name)
+            || guac_strlcat(index_name, GUAC_RECORDING_INDEX_SUFFIX,
+                sizeof(index_name)) >= sizeof(index_name)) {
+        guac_client_log(client, GUAC_LOG_ERROR, "Recording index could not "
+                "be created: Name too long");
+        return 1;
+    }
+
+    guac_open_how how = {
+        .oflags = O_CREAT | O_WRONLY | O_TRUNC,
+        .mode = S_IRUSR | S_IWUSR | S_IRGRP
+    };
+
+    int index_fd = guac_openat(keyframes->path, index_name, &how);
+    if (index_fd == -1) {
+        guac_client_log(client, GUAC_LOG_ERROR, "Recording index could not "
+                "be created: %s: %s", guac_error_message,
+                guac_status_string(guac_error));
+        return 1;
+    }
+
+    keyframes->index_fd = index_fd;
+    keyframes->interval = interval;
+
+    if (pthread_create(&keyframes->thread, NULL,
+                guac_recording_keyframe_thread, recording)) {
+        guac_client_log(client, GUAC_LOG_ERROR, "Unable to start keyframe "
+                "thread.");
+        close(index_fd);
+        keyframes->index_fd = -1;
+        return 1;
+    }
+
+    guac_client_log(client, GUAC_LOG_DEBUG, "Keyframes will be written to "
+            "the recording every %i milliseconds and listed within \"%s\".",
+            interval, index_name);
+
+    return 0;
+
+}
+
+void guac_recording_set_keyframe_handler(guac_recording* recording,
+        guac_recording_keyframe_handler* handler, void* data) {
+
+    guac_recording_keyframes* keyframes = recording->__keyframes;
+
+    /* Any keyframe being written by the previous handler is written while
+     * this lock is held */
+    guac_flag_lock(&keyframes->state);
+    keyframes->handler = handler;
+    keyframes->data = data;
+    guac_flag_unlock(&keyframes->state);
+
+}
+
 void guac_recording_free(guac_recording* recording) {
 
+    guac_recording_keyframes* keyframes = recording->__keyframes;
+
+    /* Stop writing keyframes */
+    if (keyframes->index_fd != -1) {
+        guac_flag_set(&keyframes->state, GUAC_RECORDING_KEYFRAMES_STOPPING);
+        pthread_join(keyframes->thread, NULL);
+        close(keyframes->index_fd);
+    }
+
+    guac_flag_destroy(&keyframes->state);
+    guac_mem_free(keyframes->path);
+    guac_mem_free(keyframes->filename);
+    guac_mem_free(keyframes);
+
     /* If not including broadcast output, the output socket is not associated
      * with the client, and must be freed manually */
     if (!recording->include_output)
@@ -87,6 +87,163 @@ typedef struct __write_chunk {
 
 } __write_chunk;
 
+/**
+ * The filter restricting the users that receive data written by a particular
+ * thread to a broadcast socket, as set by guac_socket_broadcast_set_filter().
+ */
+typedef struct __broadcast_filter {
+
+    /**
+     * The filter to invoke for each user, or NULL if all users should receive
+     * data.
+     */
+    guac_socket_broadcast_filter* filter;
+
+    /**
+     * The arbitrary data to pass to the filter.
+     */
+    void* data;
+
+} __broadcast_filter;
+
+/**
+ * The callback and data that would normally be provided to
+ * guac_client_foreach_user() by a broadcast socket, along with the filter
+ * that determines which users the callback may be invoked for.
+ */
+typedef struct __filtered_broadcast {
+
+    /**
+     * The filter set for the current thread.
+     */
+    __broadcast_filter* filter;
+
+    /**
+     * The callback to invoke for each user allowed by the filter.
+     */
+    guac_user_callback* callback;
+
+    /**
+     * The arbitrary data to pass to the callback.
+     */
+    void* data;
+
+} __filtered_broadcast;
+
+/**
+ * The key used to store the __broadcast_filter of each thread.
+ */
+static pthread_key_t __broadcast_filter_key;
+
+/**
+ * Guard ensuring __broadcast_filter_key is initialized exactly once.
+ */
+static pthread_once_t __broadcast_filter_key_init = PTHREAD_ONCE_INIT;
+
+/**
+ * Frees the __broadcast_filter of a thread that is exiting.
+ *
+ * @param filter
+ *     The __broadcast_filter to free.
+ */
+static void __broadcast_filter_free(void* filter) {
+    guac_mem_free(filter);
+}
+
+/**
+ * Initializes __broadcast_filter_key. This function must be invoked only
+ * through pthread_once() with __broadcast_filter_key_init.
+ */
+static void __broadcast_filter_key_alloc(void) {
+    pthread_key_create(&__broadcast_filter_key, __broadcast_filter_free);
+}
+
+void guac_socket_broadcast_set_filter(guac_socket_broadcast_filter* filter,
+        void* data) {
+
+    pthread_once(&__broadcast_filter_key_init, __broadcast_filter_key_alloc);
+
+    __broadcast_filter* current = pthread_getspecific(__broadcast_filter_key);
+
+    /* Allocate storage for this thread's filter only once needed */
+    if (current == NULL) {
+
+        if (filter == NULL)
+            return;
+
+        current = guac_mem_alloc(sizeof(__broadcast_filter));
+        pthread_setspecific(__broadcast_filter_key, current);
+
+    }
+
+    current->filter = filter;
+    current->data = data;
+
+}
+
+/**
+ * Callback invoked by guac_client_foreach_user() on behalf of a broadcast
+ * socket whose writing thread has set a filter, invoking the original
+ * callback only for users allowed by that filter.
+ *
+ * @param user
+ *     The user to (possibly) invoke the original callback for.
+ *
+ * @param data
+ *     A pointer to the __filtered_broadcast describing the original callback
+ *     and the filter.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* __filtered_broadcast_callback(guac_user* user, void* data) {
+
+    __filtered_broadcast* broadcast = (__filtered_broadcast*) data;
+    __broadcast_filter* filter = broadcast->filter;
+
+    if (filter->filter(user, filter->data))
+        broadcast->callback(user, broadcast->data);
+
+    return NULL;
+
+}
+
+/**
+ * Invokes the given callback for each connected, non-pending user of the
+ * given client, restricting those users by the filter set for the current
+ * thread with guac_socket_broadcast_set_filter(), if any. This function is a
+ * guac_socket_broadcast_handler.
+ *
+ * @param client
+ *     The guac_client whose users should be broadcast to.
+ *
+ * @param callback
+ *     The callback to invoke for each user.
+ *
+ * @param data
+ *     Arbitrary data to pass to the callback.
+ */
+static void __guac_client_foreach_filtered_user(guac_client* client,
+        guac_user_callback* callback, void* data) {
+
+    pthread_once(&__broadcast_filter_key_init, __broadcast_filter_key_alloc);
+
+    __broadcast_filter* filter = pthread_getspecific(__broadcast_filter_key);
+    if (filter == NULL || filter->filter == NULL) {
+        guac_client_foreach_user(client, callback, data);
+        return;
+    }
+
+    __filtered_broadcast broadcast = {
+        .filter = filter,
+        .callback = callback,
+        .data = data
+    };
+
+    guac_client_foreach_user(client, __filtered_broadcast_callback, &broadcast);
+
+}
+
 /**
  * Callback which handles read requests on the broadcast socket. This callback
  * always fails, as the broadcast socket is write-only; it cannot be read.
@@ -176,6 +333,71 @@ static ssize_t __guac_socket_broadcast_write_handler(guac_socket* socket,
 
 }
 
+/**
+ * Callback invoked by the broadcast handler which writes a given chunk of
+ * data to that user's socket as a complete element of binary data, framed as
+ * negotiated with that user. If the write attempt fails, the user is
+ * signalled to stop with guac_user_stop().
+ *
+ * @param user
+ *     The user that the chunk of data should be written to.
+ *
+ * @param data
+ *     A pointer to a __write_chunk which describes the data to be written.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* __write_binary_chunk_callback(guac_user* user, void* data) {
+
+    __write_chunk* chunk = (__write_chunk*) data;
+
+    /* Attempt write, disconnect on failure */
+    if (guac_socket_write_binary(user->socket, chunk->buffer, chunk->length))
+        guac_user_stop(user);
+
+    return NULL;
+
+}
+
+/**
+ * Socket handler which writes an element of binary data to each of the
+ * sockets of all connected users. This handler will always succeed, but any
+ * failing user-specific writes will invoke guac_user_stop() on the failing
+ * user.
+ *
+ * @param socket
+ *     The socket to which the given data must be written.
+ *
+ * @param buf
+ *     The buffer containing the data to write.
+ *
+ * @param count
+ *     The number of bytes to attempt to write from the given buffer.
+ *
+ * @return
+ *     The number of bytes written, or -1 if an error occurs. This handler will
+ *     always succeed, and thus will always return the exact number of bytes
+ *     specified by count.
+ */
+static ssize_t __guac_socket_broadcast_write_binary_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_socket_broadcast_data* data =
+        (guac_socket_broadcast_data*) socket->data;
+
+    /* Build chunk */
+    __write_chunk chunk;
+    chunk.buffer = buf;
+    chunk.length = count;
+
+    /* Broadcast chunk to the users */
+    data->broadcast_handler(data->client, __write_binary_chunk_callback, &chunk);
+
+    return count;
+
+}
+
 /**
  * Callback which is invoked by the broadcast handler to flush all
  * pending data on the given user's socket. If an error occurs while flushing
@@ -406,6 +628,7 @@ static guac_socket* __guac_socket_init(
     /* Set read/write handlers */
     socket->read_handler   = __guac_socket_broadcast_read_handler;
     socket->write_handler  = __guac_socket_broadcast_write_handler;
+    socket->write_binary_handler = __guac_socket_broadcast_write_binary_handler;
     socket->select_handler = __guac_socket_broadcast_select_handler;
     socket->flush_handler  = __guac_socket_broadcast_flush_handler;
     socket->lock_handler   = __guac_socket_broadcast_lock_handler;
@@ -418,8 +641,9 @@ static guac_socket* __guac_socket_init(
 
 guac_socket* guac_socket_broadcast(guac_client* client) {
 
-    /* Broadcast to all connected non-pending users*/
-    return __guac_socket_init(client, guac_client_foreach_user);
+    /* Broadcast to all connected non-pending users (or the subset allowed by
+     * the filter of the writing thread) */
+    return __guac_socket_init(client, __guac_client_foreach_filtered_user);
 
 }
 
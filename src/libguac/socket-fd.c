@@ -19,6 +19,7 @@
 
 #include "config.h"
 
+#include "base64-kernels.h"
 #include "guacamole/mem.h"
 #include "guacamole/error.h"
 #include "guacamole/socket.h"
@@ -250,6 +251,18 @@ static ssize_t guac_socket_fd_write_buffered(guac_socket* socket,
     const char* current = buf;
     guac_socket_fd_data* data = (guac_socket_fd_data*) socket->data;
 
+    /* Write large blocks of data directly if there is nothing already
+     * buffered that must be written first, rather than copying that data
+     * through the buffer */
+    if (data->written == 0 && count >= sizeof(data->out_buf)) {
+
+        if (guac_socket_fd_write(socket, buf, count))
+            return -1;
+
+        return count;
+
+    }
+
     /* Append to buffer, flush if necessary */
     while (count > 0) {
 
@@ -324,6 +337,70 @@ static ssize_t guac_socket_fd_write_handler(guac_socket* socket,
 
 }
 
+/**
+ * Encodes the provided data as base64 directly into the internal buffer for
+ * future writing, flushing the internal buffer as necessary. The actual write
+ * attempt will occur only upon flush, or when the internal buffer is full.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param buf
+ *     The arbitrary buffer containing the data to be encoded and written.
+ *
+ * @param count
+ *     The number of bytes contained within the buffer. This will always be a
+ *     multiple of three.
+ *
+ * @return
+ *     The number of bytes encoded and written, or -1 if an error occurs.
+ */
+static ssize_t guac_socket_fd_write_base64_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    size_t original_count = count;
+    const unsigned char* current = buf;
+    guac_socket_fd_data* data = (guac_socket_fd_data*) socket->data;
+
+    /* Acquire exclusive access to buffer */
+    pthread_mutex_lock(&(data->buffer_lock));
+
+    while (count > 0) {
+
+        /* Flush if there is no room for even a single encoded group */
+        size_t remaining = sizeof(data->out_buf) - data->written;
+        if (remaining < 4) {
+
+            /* Abort if error occurs during flush */
+            if (guac_socket_fd_flush(socket)) {
+                pthread_mutex_unlock(&(data->buffer_lock));
+                return -1;
+            }
+
+            continue;
+
+        }
+
+        /* Encode as many complete groups as will fit */
+        size_t length = remaining / 4 * 3;
+        if (length > count)
+            length = count;
+
+        data->written += guac_base64_encode(current, length,
+                data->out_buf + data->written);
+
+        current += length;
+        count   -= length;
+
+    }
+
+    /* Relinquish exclusive access to buffer */
+    pthread_mutex_unlock(&(data->buffer_lock));
+
+    return original_count;
+
+}
+
 /**
  * Waits for data on the underlying file descriptor of the given socket to
  * become available such that the next read operation will not block.
@@ -441,6 +518,7 @@ guac_socket* guac_socket_open(int fd) {
     /* Set read/write handlers */
     socket->read_handler   = guac_socket_fd_read_handler;
     socket->write_handler  = guac_socket_fd_write_handler;
+    socket->write_base64_handler = guac_socket_fd_write_base64_handler;
     socket->select_handler = guac_socket_fd_select_handler;
     socket->lock_handler   = guac_socket_fd_lock_handler;
     socket->unlock_handler = guac_socket_fd_unlock_handler;
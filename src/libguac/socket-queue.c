@@ -0,0 +1,1169 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "base64-kernels.h"
+#include "guacamole/error.h"
+#include "guacamole/mem.h"
+#include "guacamole/metrics.h"
+#include "guacamole/socket.h"
+#include "guacamole/timestamp.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * A single block of data within the queue of a queued socket.
+ */
+typedef struct guac_socket_queue_block {
+
+    /**
+     * The next block in the queue, or NULL if this is the last block.
+     */
+    struct guac_socket_queue_block* next;
+
+    /**
+     * The time that the first byte of this block was queued.
+     */
+    guac_timestamp queued;
+
+    /**
+     * The offset of this block within all data queued, counting from the
+     * first byte ever queued.
+     */
+    uint64_t offset;
+
+    /**
+     * Non-zero if this block begins at an instruction boundary, zero
+     * otherwise.
+     */
+    int starts_instruction;
+
+    /**
+     * The number of bytes from the start of this block through the end of
+     * the first instruction that ends within this block, or zero if no
+     * instruction ends within this block.
+     */
+    size_t boundary;
+
+    /**
+     * The number of bytes of data within this block.
+     */
+    size_t length;
+
+    /**
+     * The data within this block.
+     */
+    char data[GUAC_SOCKET_QUEUE_BLOCK_SIZE];
+
+} guac_socket_queue_block;
+
+/**
+ * The possible states of the queue of a queued socket.
+ */
+typedef enum guac_socket_queue_state {
+
+    /**
+     * All data written is being queued.
+     */
+    GUAC_SOCKET_QUEUE_ACCEPTING,
+
+    /**
+     * The queue has overflowed while an instruction was being written, and
+     * the beginning of that instruction is (or may already have been) written
+     * to the underlying socket. Data is queued only until the instruction
+     * ends.
+     */
+    GUAC_SOCKET_QUEUE_OVERFLOWING,
+
+    /**
+     * The queue has overflowed and all data written is being discarded until
+     * guac_socket_queue_resume() is called.
+     */
+    GUAC_SOCKET_QUEUE_DISCARDING
+
+} guac_socket_queue_state;
+
+/**
+ * Data specific to the queued implementation of guac_socket.
+ */
+typedef struct guac_socket_queue_data {
+
+    /**
+     * The guac_socket to which all queued data is written.
+     */
+    guac_socket* socket;
+
+    /**
+     * The maximum number of bytes that may be queued.
+     */
+    size_t max_bytes;
+
+    /**
+     * The maximum amount of time that queued data may wait to be written, in
+     * milliseconds.
+     */
+    int max_delay;
+
+    /**
+     * The handler to invoke when the queue overflows, if any.
+     */
+    guac_socket_queue_overflow_handler* overflow_handler;
+
+    /**
+     * The arbitrary data to pass to overflow_handler.
+     */
+    void* overflow_data;
+
+    /**
+     * Lock which is acquired when an instruction is being written, and
+     * released when the instruction is finished being written.
+     */
+    pthread_mutex_t socket_lock;
+
+    /**
+     * Lock which guards all other members of this structure.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled whenever the writer thread may have
+     * something new to do.
+     */
+    pthread_cond_t modified;
+
+    /**
+     * The thread that writes queued data to the underlying socket.
+     */
+    pthread_t writer;
+
+    /**
+     * The first block in the queue, or NULL if the queue is empty.
+     */
+    guac_socket_queue_block* head;
+
+    /**
+     * The last block in the queue, or NULL if the queue is empty.
+     */
+    guac_socket_queue_block* tail;
+
+    /**
+     * The offset just past the last byte queued, counting from the first
+     * byte ever queued.
+     */
+    uint64_t end;
+
+    /**
+     * The offset just past the last byte taken from the queue by the writer
+     * thread.
+     */
+    uint64_t taken;
+
+    /**
+     * The offset of the most recent instruction boundary.
+     */
+    uint64_t last_boundary;
+
+    /**
+     * The offset just past the last byte that must be written before the
+     * underlying socket is flushed.
+     */
+    uint64_t flush_end;
+
+    /**
+     * Non-zero if the underlying socket must be flushed once all data through
+     * flush_end has been written, zero otherwise.
+     */
+    int flush_pending;
+
+    /**
+     * The time that the first byte of the block currently being written by
+     * the writer thread was queued, or zero if no block is being written.
+     */
+    guac_timestamp writing_since;
+
+    /**
+     * The current state of the queue.
+     */
+    guac_socket_queue_state state;
+
+    /**
+     * Non-zero if the overflow handler must be invoked by the writer thread,
+     * zero otherwise.
+     */
+    int overflow_pending;
+
+    /**
+     * Non-zero if a write to the underlying socket has failed, zero
+     * otherwise.
+     */
+    int failed;
+
+    /**
+     * Non-zero if the writer thread should stop once all queued data has
+     * been written, zero otherwise.
+     */
+    int stopping;
+
+    /**
+     * Statistics describing the queue.
+     */
+    guac_socket_queue_stats stats;
+
+    /**
+     * The entry within the user table of the current process' metrics that
+     * should be credited with all data written, as returned by
+     * guac_metrics_user_add(), or -1 if written data should be credited only
+     * to the aggregate metrics. This value may be read by the writer thread
+     * without holding the lock.
+     */
+    int metrics_user;
+
+    /**
+     * Non-zero if the writer thread must not write anything to the underlying
+     * socket because the queue is held by guac_socket_queue_hold(), zero
+     * otherwise.
+     */
+    int held;
+
+    /**
+     * Non-zero if the writer thread is currently writing to or flushing the
+     * underlying socket without the lock held, zero otherwise.
+     */
+    int writing;
+
+    /**
+     * Condition which is signalled whenever the writer thread finishes
+     * writing to or flushing the underlying socket.
+     */
+    pthread_cond_t idle;
+
+} guac_socket_queue_data;
+
+/**
+ * Frees the given list of blocks.
+ *
+ * @param block
+ *     The first block of the list to free, or NULL if the list is empty.
+ */
+static void guac_socket_queue_free_blocks(guac_socket_queue_block* block) {
+
+    while (block != NULL) {
+        guac_socket_queue_block* next = block->next;
+        guac_mem_free(block);
+        block = next;
+    }
+
+}
+
+/**
+ * Discards all queued data that follows the first instruction boundary that
+ * has not yet been taken by the writer thread, placing the queue into the
+ * GUAC_SOCKET_QUEUE_DISCARDING state. If no such boundary exists (the
+ * instruction currently being written began within data that has already
+ * been taken), the queue is instead placed into the
+ * GUAC_SOCKET_QUEUE_OVERFLOWING state, and nothing is discarded until that
+ * instruction ends. The lock of the queue MUST be held.
+ *
+ * @param data
+ *     The queue that has overflowed.
+ */
+static void guac_socket_queue_overflow(guac_socket_queue_data* data) {
+
+    guac_socket_queue_block* block = data->head;
+    uint64_t cut;
+
+    /* Nothing is queued, and thus the boundary (if any) must be the end of
+     * the data taken by the writer thread */
+    if (block == NULL) {
+
+        if (data->last_boundary != data->end) {
+            data->state = GUAC_SOCKET_QUEUE_OVERFLOWING;
+            return;
+        }
+
+        cut = data->end;
+
+    }
+
+    /* Everything queued may be discarded if the data taken by the writer
+     * thread ends at an instruction boundary */
+    else if (block->starts_instruction) {
+        cut = block->offset;
+        data->head = data->tail = NULL;
+    }
+
+    else {
+
+        /* Locate the first block containing the end of an instruction */
+        while (block != NULL && block->boundary == 0)
+            block = block->next;
+
+        if (block == NULL) {
+            data->state = GUAC_SOCKET_QUEUE_OVERFLOWING;
+            return;
+        }
+
+        /* Discard everything following the end of that instruction */
+        block->length = block->boundary;
+        cut = block->offset + block->length;
+        guac_socket_queue_free_blocks(block->next);
+        block->next = NULL;
+        data->tail = block;
+        block = NULL;
+
+    }
+
+    guac_socket_queue_free_blocks(block);
+
+    data->stats.discarded += data->end - cut;
+    data->stats.length -= data->end - cut;
+    data->end = cut;
+    data->last_boundary = cut;
+
+    if (data->flush_end > cut)
+        data->flush_end = cut;
+
+    data->state = GUAC_SOCKET_QUEUE_DISCARDING;
+    data->overflow_pending = 1;
+    pthread_cond_signal(&data->modified);
+
+}
+
+/**
+ * Returns whether the queue has exceeded either of its limits, such that the
+ * given number of additional bytes should not be queued. The lock of the
+ * queue MUST be held.
+ *
+ * @param data
+ *     The queue to test.
+ *
+ * @param count
+ *     The number of bytes about to be queued.
+ *
+ * @return
+ *     Non-zero if the queue has overflowed, zero otherwise.
+ */
+static int guac_socket_queue_is_full(guac_socket_queue_data* data,
+        size_t count) {
+
+    if (data->stats.length + count > data->max_bytes)
+        return 1;
+
+    /* Data is expected to wait while the queue is held */
+    if (data->held)
+        return 0;
+
+    /* The oldest data not yet written is either the block currently being
+     * written or the first block in the queue */
+    guac_timestamp oldest = data->writing_since;
+    if (oldest == 0 && data->head != NULL)
+        oldest = data->head->queued;
+
+    return oldest != 0
+        && guac_timestamp_current() - oldest > data->max_delay;
+
+}
+
+/**
+ * Returns the block at the end of the queue, first starting a new block if
+ * the current block is full or if the queue is empty. The lock of the queue
+ * MUST be held.
+ *
+ * @param data
+ *     The queue to retrieve the last block of.
+ *
+ * @return
+ *     The block at the end of the queue, which is guaranteed to have space
+ *     for at least one additional byte.
+ */
+static guac_socket_queue_block* guac_socket_queue_tail(
+        guac_socket_queue_data* data) {
+
+    guac_socket_queue_block* block = data->tail;
+
+    /* Start a new block once the current block is full */
+    if (block == NULL || block->length == GUAC_SOCKET_QUEUE_BLOCK_SIZE) {
+
+        block = guac_mem_alloc(sizeof(guac_socket_queue_block));
+        block->next = NULL;
+        block->queued = guac_timestamp_current();
+        block->offset = data->end;
+        block->starts_instruction = (data->last_boundary == data->end);
+        block->boundary = 0;
+        block->length = 0;
+
+        if (data->tail != NULL)
+            data->tail->next = block;
+        else
+            data->head = block;
+
+        data->tail = block;
+
+        /* The previous block (if any) may now be written */
+        pthread_cond_signal(&data->modified);
+
+    }
+
+    return block;
+
+}
+
+/**
+ * Appends the given data to the end of the queue. The lock of the queue MUST
+ * be held.
+ *
+ * @param data
+ *     The queue to append to.
+ *
+ * @param buf
+ *     The buffer containing the data to append.
+ *
+ * @param count
+ *     The number of bytes to append.
+ */
+static void guac_socket_queue_append(guac_socket_queue_data* data,
+        const char* buf, size_t count) {
+
+    while (count > 0) {
+
+        guac_socket_queue_block* block = guac_socket_queue_tail(data);
+
+        size_t length = GUAC_SOCKET_QUEUE_BLOCK_SIZE - block->length;
+        if (length > count)
+            length = count;
+
+        memcpy(block->data + block->length, buf, length);
+        block->length += length;
+        data->end += length;
+
+        buf += length;
+        count -= length;
+
+    }
+
+}
+
+/**
+ * Encodes the given data as base64 directly into the end of the queue. The
+ * lock of the queue MUST be held.
+ *
+ * @param data
+ *     The queue to append to.
+ *
+ * @param buf
+ *     The buffer containing the data to encode and append.
+ *
+ * @param count
+ *     The number of bytes of data to encode. This MUST be a multiple of
+ *     three.
+ */
+static void guac_socket_queue_append_base64(guac_socket_queue_data* data,
+        const unsigned char* buf, size_t count) {
+
+    while (count > 0) {
+
+        guac_socket_queue_block* block = guac_socket_queue_tail(data);
+        size_t remaining = GUAC_SOCKET_QUEUE_BLOCK_SIZE - block->length;
+
+        /* Groups that would straddle two blocks are encoded separately */
+        if (remaining < 4) {
+
+            char encoded[4];
+            guac_base64_encode(buf, 3, encoded);
+            guac_socket_queue_append(data, encoded, sizeof(encoded));
+
+            buf += 3;
+            count -= 3;
+            continue;
+
+        }
+
+        /* Encode as many complete groups as will fit */
+        size_t length = remaining / 4 * 3;
+        if (length > count)
+            length = count;
+
+        size_t encoded = guac_base64_encode(buf, length,
+                block->data + block->length);
+
+        block->length += encoded;
+        data->end += encoded;
+
+        buf += length;
+        count -= length;
+
+    }
+
+}
+
+/**
+ * Returns the block at the head of the queue if the writer thread should
+ * write that block now, removing that block from the queue. Partially-filled
+ * blocks at the end of the queue are written only if data within them has
+ * been flushed, or if the queue is being freed. The lock of the queue MUST
+ * be held.
+ *
+ * @param data
+ *     The queue to take a block from.
+ *
+ * @return
+ *     The block that should be written, or NULL if there is no such block.
+ */
+static guac_socket_queue_block* guac_socket_queue_take(
+        guac_socket_queue_data* data) {
+
+    guac_socket_queue_block* block = data->head;
+    if (block == NULL || data->held)
+        return NULL;
+
+    if (block == data->tail
+            && block->length < GUAC_SOCKET_QUEUE_BLOCK_SIZE
+            && !data->stopping
+            && !(data->flush_pending && data->flush_end > block->offset))
+        return NULL;
+
+    data->head = block->next;
+    if (data->head == NULL)
+        data->tail = NULL;
+
+    data->taken += block->length;
+    data->stats.length -= block->length;
+    data->writing_since = block->queued;
+
+    return block;
+
+}
+
+/**
+ * Thread which writes all queued data to the underlying socket, flushing that
+ * socket as requested, and invoking the overflow handler as needed.
+ *
+ * @param arg
+ *     The queued guac_socket.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_socket_queue_writer_thread(void* arg) {
+
+    guac_socket* socket = (guac_socket*) arg;
+    guac_socket_queue_data* data = (guac_socket_queue_data*) socket->data;
+
+    pthread_mutex_lock(&data->lock);
+
+    for (;;) {
+
+        /* The overflow handler may need to acquire locks that are held while
+         * data is written, and thus must be invoked without the lock held */
+        if (data->overflow_pending) {
+
+            data->overflow_pending = 0;
+            pthread_mutex_unlock(&data->lock);
+
+            if (data->overflow_handler)
+                data->overflow_handler(socket, data->overflow_data);
+
+            pthread_mutex_lock(&data->lock);
+            continue;
+
+        }
+
+        guac_socket_queue_block* block = guac_socket_queue_take(data);
+        if (block != NULL) {
+
+            int failed = data->failed;
+            data->writing = 1;
+            pthread_mutex_unlock(&data->lock);
+
+            if (!failed) {
+                failed = guac_socket_write(data->socket, block->data, block->length);
+                if (!failed)
+                    guac_metrics_user_sent(__atomic_load_n(&data->metrics_user,
+                                __ATOMIC_RELAXED), block->length);
+            }
+
+            guac_mem_free(block);
+            pthread_mutex_lock(&data->lock);
+
+            data->writing_since = 0;
+            data->writing = 0;
+            pthread_cond_broadcast(&data->idle);
+
+            /* Nothing further can be written once writes fail */
+            if (failed && !data->failed) {
+                data->failed = 1;
+                guac_socket_queue_free_blocks(data->head);
+                data->head = data->tail = NULL;
+                data->stats.length = 0;
+            }
+
+            continue;
+
+        }
+
+        /* Flush only once everything preceding the flush has been written */
+        if (data->flush_pending && data->taken >= data->flush_end
+                && !data->held) {
+
+            data->flush_pending = 0;
+            int failed = data->failed;
+            data->writing = 1;
+            pthread_mutex_unlock(&data->lock);
+
+            if (!failed)
+                failed = guac_socket_flush(data->socket);
+
+            pthread_mutex_lock(&data->lock);
+
+            data->writing = 0;
+            pthread_cond_broadcast(&data->idle);
+
+            if (failed)
+                data->failed = 1;
+
+            continue;
+
+        }
+
+        /* Held data must still be written once the hold is released */
+        if (data->stopping && !data->held)
+            break;
+
+        pthread_cond_wait(&data->modified, &data->lock);
+
+    }
+
+    pthread_mutex_unlock(&data->lock);
+    return NULL;
+
+}
+
+/**
+ * Callback function which reads only from the underlying socket.
+ *
+ * @param socket
+ *     The queued socket to read from.
+ *
+ * @param buf
+ *     The buffer to read data into.
+ *
+ * @param count
+ *     The maximum number of bytes to read into the given buffer.
+ *
+ * @return
+ *     The value returned by guac_socket_read() when invoked on the
+ *     underlying socket with the given parameters.
+ */
+static ssize_t __guac_socket_queue_read_handler(guac_socket* socket,
+        void* buf, size_t count) {
+
+    guac_socket_queue_data* data = (guac_socket_queue_data*) socket->data;
+
+    /* Delegate read to wrapped socket */
+    return guac_socket_read(data->socket, buf, count);
+
+}
+
+/**
+ * Queues the given data, or discards that data if the queue has overflowed,
+ * optionally encoding that data as base64.
+ *
+ * @param socket
+ *     The queued socket to write through.
+ *
+ * @param buf
+ *     The buffer of data to write.
+ *
+ * @param count
+ *     The number of bytes in the buffer to be written.
+ *
+ * @param base64
+ *     Non-zero if the data should be encoded as base64 as it is queued, in
+ *     which case count MUST be a multiple of three, zero if the data should
+ *     be queued as-is.
+ *
+ * @return
+ *     The number of bytes written if the write was successful, or -1 if
+ *     writes to the underlying socket have failed.
+ */
+static ssize_t guac_socket_queue_write(guac_socket* socket,
+        const void* buf, size_t count, int base64) {
+
+    guac_socket_queue_data* data = (guac_socket_queue_data*) socket->data;
+
+    /* The number of bytes that will actually be queued */
+    size_t length = base64 ? count / 3 * 4 : count;
+
+    pthread_mutex_lock(&data->lock);
+
+    if (data->failed) {
+        pthread_mutex_unlock(&data->lock);
+        guac_error = GUAC_STATUS_CLOSED;
+        guac_error_message = "Write to underlying socket failed";
+        return -1;
+    }
+
+    if (data->state == GUAC_SOCKET_QUEUE_ACCEPTING
+            && guac_socket_queue_is_full(data, length)) {
+        data->stats.overflows++;
+        guac_socket_queue_overflow(data);
+    }
+
+    if (data->state == GUAC_SOCKET_QUEUE_DISCARDING)
+        data->stats.discarded += length;
+
+    else {
+
+        if (base64)
+            guac_socket_queue_append_base64(data, buf, count);
+        else
+            guac_socket_queue_append(data, buf, count);
+
+        data->stats.queued += length;
+        data->stats.length += length;
+        if (data->stats.length > data->stats.max_length)
+            data->stats.max_length = data->stats.length;
+
+    }
+
+    pthread_mutex_unlock(&data->lock);
+    return count;
+
+}
+
+/**
+ * Callback function which queues the given data, or discards that data if
+ * the queue has overflowed.
+ *
+ * @param socket
+ *     The queued socket to write through.
+ *
+ * @param buf
+ *     The buffer of data to write.
+ *
+ * @param count
+ *     The number of bytes in the buffer to be written.
+ *
+ * @return
+ *     The number of bytes written if the write was successful, or -1 if
+ *     writes to the underlying socket have failed.
+ */
+static ssize_t __guac_socket_queue_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+    return guac_socket_queue_write(socket, buf, count, 0);
+}
+
+/**
+ * Callback function which encodes the given data as base64 directly into the
+ * queue, or discards that data if the queue has overflowed.
+ *
+ * @param socket
+ *     The queued socket to write through.
+ *
+ * @param buf
+ *     The buffer of data to encode and write.
+ *
+ * @param count
+ *     The number of bytes in the buffer to be encoded and written. This will
+ *     always be a multiple of three.
+ *
+ * @return
+ *     The number of bytes written if the write was successful, or -1 if
+ *     writes to the underlying socket have failed.
+ */
+static ssize_t __guac_socket_queue_write_base64_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+    return guac_socket_queue_write(socket, buf, count, 1);
+}
+
+/**
+ * Callback function which requests that the underlying socket be flushed
+ * once all data queued thus far has been written. This function does not
+ * wait for the flush to occur.
+ *
+ * @param socket
+ *     The queued socket to flush.
+ *
+ * @return
+ *     Zero if the flush was requested successfully, or -1 if writes to the
+ *     underlying socket have failed.
+ */
+static ssize_t __guac_socket_queue_flush_handler(guac_socket* socket) {
+
+    guac_socket_queue_data* data = (guac_socket_queue_data*) socket->data;
+
+    pthread_mutex_lock(&data->lock);
+
+    int failed = data->failed;
+    if (!failed) {
+        data->flush_end = data->end;
+        data->flush_pending = 1;
+        pthread_cond_signal(&data->modified);
+    }
+
+    pthread_mutex_unlock(&data->lock);
+
+    return failed ? -1 : 0;
+
+}
+
+/**
+ * Callback function which acquires exclusive access to the queued socket for
+ * the duration of an instruction. The underlying socket is never locked, as
+ * only the writer thread writes to it.
+ *
+ * @param socket
+ *     The queued socket to lock.
+ */
+static void __guac_socket_queue_lock_handler(guac_socket* socket) {
+
+    guac_socket_queue_data* data = (guac_socket_queue_data*) socket->data;
+
+    pthread_mutex_lock(&data->socket_lock);
+
+}
+
+/**
+ * Callback function which records the end of an instruction and relinquishes
+ * exclusive access to the queued socket. If the queue overflowed while the
+ * instruction was being written, data following the end of the instruction
+ * is discarded.
+ *
+ * @param socket
+ *     The queued socket to unlock.
+ */
+static void __guac_socket_queue_unlock_handler(guac_socket* socket) {
+
+    guac_socket_queue_data* data = (guac_socket_queue_data*) socket->data;
+
+    pthread_mutex_lock(&data->lock);
+
+    data->last_boundary = data->end;
+
+    guac_socket_queue_block* tail = data->tail;
+    if (tail != NULL && tail->boundary == 0 && tail->length > 0)
+        tail->boundary = tail->length;
+
+    if (data->state == GUAC_SOCKET_QUEUE_OVERFLOWING)
+        guac_socket_queue_overflow(data);
+
+    pthread_mutex_unlock(&data->lock);
+
+    pthread_mutex_unlock(&data->socket_lock);
+
+}
+
+/**
+ * Callback function which delegates the select operation to the underlying
+ * socket.
+ *
+ * @param socket
+ *     The queued socket to select from.
+ *
+ * @param usec_timeout
+ *     The maximum amount of time to wait for data, in microseconds, or -1 to
+ *     potentially wait forever.
+ *
+ * @return
+ *     The value returned by guac_socket_select() when invoked on the
+ *     underlying socket with the given parameters.
+ */
+static int __guac_socket_queue_select_handler(guac_socket* socket,
+        int usec_timeout) {
+
+    guac_socket_queue_data* data = (guac_socket_queue_data*) socket->data;
+
+    /* Delegate select to wrapped socket */
+    return guac_socket_select(data->socket, usec_timeout);
+
+}
+
+/**
+ * Callback function which waits for all queued data to be written before
+ * freeing all data associated with the queued socket. The underlying socket
+ * is not freed.
+ *
+ * @param socket
+ *     The queued socket to free.
+ *
+ * @return
+ *     Always zero.
+ */
+static int __guac_socket_queue_free_handler(guac_socket* socket) {
+
+    guac_socket_queue_data* data = (guac_socket_queue_data*) socket->data;
+
+    /* Write and flush everything that remains */
+    pthread_mutex_lock(&data->lock);
+    data->flush_end = data->end;
+    data->flush_pending = 1;
+    data->stopping = 1;
+    pthread_cond_signal(&data->modified);
+    pthread_mutex_unlock(&data->lock);
+
+    pthread_join(data->writer, NULL);
+
+    guac_socket_queue_free_blocks(data->head);
+
+    pthread_cond_destroy(&data->idle);
+    pthread_cond_destroy(&data->modified);
+    pthread_mutex_destroy(&data->lock);
+    pthread_mutex_destroy(&data->socket_lock);
+
+    guac_mem_free(data);
+    return 0;
+
+}
+
+/**
+ * Callback function which writes directly to the underlying socket of a held
+ * queue, ahead of all data held within that queue.
+ *
+ * @param socket
+ *     The socket returned by guac_socket_queue_hold().
+ *
+ * @param buf
+ *     The buffer of data to write.
+ *
+ * @param count
+ *     The number of bytes in the buffer to be written.
+ *
+ * @return
+ *     The number of bytes written if the write was successful, or -1 if
+ *     writes to the underlying socket have failed.
+ */
+static ssize_t __guac_socket_queue_hold_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_socket_queue_data* data = (guac_socket_queue_data*) socket->data;
+
+    if (guac_socket_write(data->socket, buf, count)) {
+        pthread_mutex_lock(&data->lock);
+        data->failed = 1;
+        pthread_mutex_unlock(&data->lock);
+        return -1;
+    }
+
+    guac_metrics_user_sent(__atomic_load_n(&data->metrics_user,
+                __ATOMIC_RELAXED), count);
+
+    return count;
+
+}
+
+/**
+ * Callback function which flushes the underlying socket of a held queue.
+ *
+ * @param socket
+ *     The socket returned by guac_socket_queue_hold().
+ *
+ * @return
+ *     Zero if the flush was successful, non-zero otherwise.
+ */
+static ssize_t __guac_socket_queue_hold_flush_handler(guac_socket* socket) {
+
+    guac_socket_queue_data* data = (guac_socket_queue_data*) socket->data;
+    return guac_socket_flush(data->socket);
+
+}
+
+/**
+ * Callback function which releases the hold on a queue, allowing the writer
+ * thread of that queue to write all held data.
+ *
+ * @param socket
+ *     The socket returned by guac_socket_queue_hold().
+ *
+ * @return
+ *     Always zero.
+ */
+static int __guac_socket_queue_hold_free_handler(guac_socket* socket) {
+
+    guac_socket_queue_data* data = (guac_socket_queue_data*) socket->data;
+
+    pthread_mutex_lock(&data->lock);
+    data->held = 0;
+    pthread_cond_signal(&data->modified);
+    pthread_mutex_unlock(&data->lock);
+
+    return 0;
+
+}
+
+guac_socket* guac_socket_queue(guac_socket* socket, size_t max_bytes,
+        int max_delay, guac_socket_queue_overflow_handler* handler,
+        void* data) {
+
+    guac_socket_queue_data* queue = guac_mem_zalloc(sizeof(guac_socket_queue_data));
+    queue->socket = socket;
+    queue->max_bytes = max_bytes;
+    queue->max_delay = max_delay;
+    queue->overflow_handler = handler;
+    queue->overflow_data = data;
+    queue->metrics_user = -1;
+
+    pthread_mutex_init(&queue->socket_lock, NULL);
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->modified, NULL);
+    pthread_cond_init(&queue->idle, NULL);
+
+    /* Associate queue-specific data with new socket */
+    guac_socket* queued = guac_socket_alloc();
+    queued->data = queue;
+
+    /* Assign handlers */
+    queued->read_handler   = __guac_socket_queue_read_handler;
+    queued->write_handler  = __guac_socket_queue_write_handler;
+    queued->write_base64_handler = __guac_socket_queue_write_base64_handler;
+    queued->select_handler = __guac_socket_queue_select_handler;
+    queued->flush_handler  = __guac_socket_queue_flush_handler;
+    queued->lock_handler   = __guac_socket_queue_lock_handler;
+    queued->unlock_handler = __guac_socket_queue_unlock_handler;
+
+    if (pthread_create(&queue->writer, NULL, guac_socket_queue_writer_thread,
+                queued)) {
+
+        guac_socket_free(queued);
+        pthread_cond_destroy(&queue->idle);
+        pthread_cond_destroy(&queue->modified);
+        pthread_mutex_destroy(&queue->lock);
+        pthread_mutex_destroy(&queue->socket_lock);
+        guac_mem_free(queue);
+
+        guac_error = GUAC_STATUS_SEE_ERRNO;
+        guac_error_message = "Unable to start thread for queued socket";
+        return NULL;
+
+    }
+
+    queued->free_handler = __guac_socket_queue_free_handler;
+    return queued;
+
+}
+
+void guac_socket_queue_resume(guac_socket* socket) {
+
+    if (socket->write_handler != __guac_socket_queue_write_handler)
+        return;
+
+    guac_socket_queue_data* data = (guac_socket_queue_data*) socket->data;
+
+    /* Resume only at an instruction boundary, such that no instruction
+     * is only partially queued */
+    pthread_mutex_lock(&data->socket_lock);
+    pthread_mutex_lock(&data->lock);
+
+    if (data->state == GUAC_SOCKET_QUEUE_DISCARDING) {
+        data->state = GUAC_SOCKET_QUEUE_ACCEPTING;
+        data->last_boundary = data->end;
+    }
+
+    pthread_mutex_unlock(&data->lock);
+    pthread_mutex_unlock(&data->socket_lock);
+
+}
+
+int guac_socket_queue_get_stats(guac_socket* socket,
+        guac_socket_queue_stats* stats) {
+
+    if (socket->write_handler != __guac_socket_queue_write_handler)
+        return 1;
+
+    guac_socket_queue_data* data = (guac_socket_queue_data*) socket->data;
+
+    pthread_mutex_lock(&data->lock);
+    *stats = data->stats;
+    pthread_mutex_unlock(&data->lock);
+
+    return 0;
+
+}
+
+void guac_socket_queue_set_metrics_user(guac_socket* socket, int user) {
+
+    if (socket->write_handler != __guac_socket_queue_write_handler)
+        return;
+
+    guac_socket_queue_data* data = (guac_socket_queue_data*) socket->data;
+    __atomic_store_n(&data->metrics_user, user, __ATOMIC_RELAXED);
+
+}
+
+guac_socket* guac_socket_queue_hold(guac_socket* socket) {
+
+    if (socket->write_handler != __guac_socket_queue_write_handler) {
+        guac_error = GUAC_STATUS_INVALID_ARGUMENT;
+        guac_error_message = "Only queued sockets may be held";
+        return NULL;
+    }
+
+    guac_socket_queue_data* data = (guac_socket_queue_data*) socket->data;
+
+    /* Everything written prior to the hold must precede anything written to
+     * the returned socket, including anything still buffered */
+    guac_socket_flush(socket);
+
+    pthread_mutex_lock(&data->lock);
+
+    /* Only data written thus far need be waited for, as anything written
+     * concurrently by other threads may be held (data discarded due to
+     * overflow will never be taken) */
+    uint64_t end = data->end;
+    while (!data->held && !data->failed && !data->stopping
+            && data->taken < end && data->taken < data->end)
+        pthread_cond_wait(&data->idle, &data->lock);
+
+    if (data->held || data->failed || data->stopping) {
+        pthread_mutex_unlock(&data->lock);
+        guac_error = GUAC_STATUS_BUSY;
+        guac_error_message = "Queued socket cannot currently be held";
+        return NULL;
+    }
+
+    /* Wait for the writer thread to finish with the underlying socket, such
+     * that nothing already taken from the queue follows the held data */
+    data->held = 1;
+    while (data->writing)
+        pthread_cond_wait(&data->idle, &data->lock);
+
+    pthread_mutex_unlock(&data->lock);
+
+    guac_socket* held = guac_socket_alloc();
+    if (held == NULL) {
+        pthread_mutex_lock(&data->lock);
+        data->held = 0;
+        pthread_cond_signal(&data->modified);
+        pthread_mutex_unlock(&data->lock);
+        return NULL;
+    }
+
+    /* Data written while held is received by the same recipient */
+    held->__binary_framing = socket->__binary_framing;
+
+    held->data = data;
+    held->write_handler = __guac_socket_queue_hold_write_handler;
+    held->flush_handler = __guac_socket_queue_hold_flush_handler;
+    held->free_handler  = __guac_socket_queue_hold_free_handler;
+
+    return held;
+
+}
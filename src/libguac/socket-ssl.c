@@ -25,6 +25,7 @@
 #include "guacamole/socket.h"
 #include "wait-fd.h"
 
+#include <errno.h>
 #include <pthread.h>
 #include <stdlib.h>
 
@@ -41,8 +42,18 @@ static ssize_t __guac_socket_ssl_read_handler(guac_socket* socket,
 
     /* Record errors in guac_error */
     if (retval <= 0) {
+
+        /* Data available on a non-blocking file descriptor may not yet
+         * amount to a complete TLS record */
+        int error = SSL_get_error(data->ssl, retval);
+        if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+            errno = EAGAIN;
+            retval = -1;
+        }
+
         guac_error = GUAC_STATUS_SEE_ERRNO;
         guac_error_message = "Error reading data from secure socket";
+
     }
 
     return retval;
@@ -71,6 +82,12 @@ static ssize_t __guac_socket_ssl_write_handler(guac_socket* socket,
 static int __guac_socket_ssl_select_handler(guac_socket* socket, int usec_timeout) {
 
     guac_socket_ssl_data* data = (guac_socket_ssl_data*) socket->data;
+
+    /* Data already decrypted by OpenSSL can be read without waiting for the
+     * file descriptor */
+    if (SSL_pending(data->ssl) > 0)
+        return 1;
+
     int retval = guac_wait_for_fd(data->fd, usec_timeout);
 
     /* Properly set guac_error */
@@ -141,14 +158,7 @@ guac_socket* guac_socket_open_secure(SSL_CTX* context, int fd) {
     if (ssl == NULL)
         return NULL;
 
-    /* Allocate socket and associated data */
-    guac_socket* socket = guac_socket_alloc();
-    guac_socket_ssl_data* data = guac_mem_alloc(sizeof(guac_socket_ssl_data));
-
-    /* Init SSL */
-    data->context = context;
-    data->ssl = ssl;
-    SSL_set_fd(data->ssl, fd);
+    SSL_set_fd(ssl, fd);
 
     /* Accept SSL connection, handle errors */
     if (SSL_accept(ssl) <= 0) {
@@ -156,19 +166,31 @@ guac_socket* guac_socket_open_secure(SSL_CTX* context, int fd) {
         guac_error = GUAC_STATUS_INTERNAL_ERROR;
         guac_error_message = "SSL accept failed";
 
-        guac_mem_free(data);
-        guac_socket_free(socket);
         SSL_free(ssl);
         return NULL;
     }
 
+    return guac_socket_open_secure_session(ssl);
+
+}
+
+guac_socket* guac_socket_open_secure_session(SSL* ssl) {
+
+    /* Allocate socket and associated data */
+    guac_socket* socket = guac_socket_alloc();
+    guac_socket_ssl_data* data = guac_mem_alloc(sizeof(guac_socket_ssl_data));
+
+    /* Init SSL */
+    data->context = SSL_get_SSL_CTX(ssl);
+    data->ssl = ssl;
+
     pthread_mutexattr_t lock_attributes;
     pthread_mutexattr_init(&lock_attributes);
     pthread_mutexattr_setpshared(&lock_attributes, PTHREAD_PROCESS_SHARED);
     pthread_mutex_init(&(data->socket_lock), &lock_attributes);
 
     /* Store file descriptor as socket data */
-    data->fd = fd;
+    data->fd = SSL_get_fd(ssl);
     socket->data = data;
 
     /* Set read/write handlers */
@@ -183,3 +205,45 @@ guac_socket* guac_socket_open_secure(SSL_CTX* context, int fd) {
 
 }
 
+int guac_socket_ssl_get_ktls_fd(guac_socket* socket) {
+
+#ifdef SSL_OP_ENABLE_KTLS
+
+    /* Only sockets created with guac_socket_open_secure() use TLS at all */
+    if (socket->read_handler != __guac_socket_ssl_read_handler)
+        return -1;
+
+    guac_socket_ssl_data* data = (guac_socket_ssl_data*) socket->data;
+
+    /* With kernel TLS, any record other than application data causes read()
+     * to fail with EIO. TLS 1.3 peers may send such records (KeyUpdate)
+     * at any time, so only TLS 1.2 sessions are safe to read directly. */
+    if (SSL_version(data->ssl) != TLS1_2_VERSION)
+        return -1;
+
+    /* The kernel must handle both directions of the session */
+    if (!BIO_get_ktls_send(SSL_get_wbio(data->ssl))
+            || !BIO_get_ktls_recv(SSL_get_rbio(data->ssl)))
+        return -1;
+
+    /* Nothing received may remain within OpenSSL's own buffers */
+    if (SSL_has_pending(data->ssl))
+        return -1;
+
+    return data->fd;
+
+#else
+    /* Kernel TLS is not supported by this version of OpenSSL */
+    return -1;
+#endif
+
+}
+
+void guac_socket_ssl_disown(guac_socket* socket) {
+
+    /* Free the session without sending close_notify, leaving the session
+     * intact for whichever process now owns the file descriptor */
+    guac_socket_ssl_data* data = (guac_socket_ssl_data*) socket->data;
+    SSL_set_quiet_shutdown(data->ssl, 1);
+
+}
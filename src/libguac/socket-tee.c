@@ -102,6 +102,41 @@ static ssize_t __guac_socket_tee_write_handler(guac_socket* socket,
 
 }
 
+/**
+ * Callback function which writes the given element of binary data to both
+ * underlying sockets, each framing that element as negotiated with its own
+ * recipient, returning only the result from the primary socket.
+ *
+ * @param socket
+ *     The tee socket to write through.
+ *
+ * @param buf
+ *     The buffer of data to write.
+ *
+ * @param count
+ *     The number of bytes in the buffer to be written.
+ *
+ * @return
+ *     The number of bytes written if the write was successful, or -1 if an
+ *     error occurs.
+ */
+static ssize_t __guac_socket_tee_write_binary_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_socket_tee_data* data = (guac_socket_tee_data*) socket->data;
+
+    /* Write to secondary socket (ignoring result) */
+    guac_socket_write_binary(data->secondary, buf, count);
+
+    /* Delegate write to wrapped socket */
+    if (guac_socket_write_binary(data->primary, buf, count))
+        return -1;
+
+    /* All data written successfully */
+    return count;
+
+}
+
 /**
  * Callback function which flushes both underlying sockets, returning only the
  * result from the primary socket.
@@ -222,6 +257,7 @@ guac_socket* guac_socket_tee(guac_socket* primary, guac_socket* secondary) {
     /* Assign handlers */
     socket->read_handler   = __guac_socket_tee_read_handler;
     socket->write_handler  = __guac_socket_tee_write_handler;
+    socket->write_binary_handler = __guac_socket_tee_write_binary_handler;
     socket->select_handler = __guac_socket_tee_select_handler;
     socket->flush_handler  = __guac_socket_tee_flush_handler;
     socket->lock_handler   = __guac_socket_tee_lock_handler;
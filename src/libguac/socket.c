@@ -19,6 +19,7 @@
 
 #include "config.h"
 
+#include "base64-kernels.h"
 #include "guacamole/mem.h"
 #include "guacamole/error.h"
 #include "guacamole/protocol.h"
@@ -35,14 +36,6 @@
 #include <time.h>
 #include <unistd.h>
 
-char __guac_socket_BASE64_CHARACTERS[64] = {
-    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
-    'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd',
-    'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's',
-    't', 'u', 'v', 'w', 'x', 'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7',
-    '8', '9', '+', '/'
-};
-
 static void* __guac_socket_keep_alive_thread(void* data) {
 
     int old_cancelstate;
@@ -152,6 +145,7 @@ guac_socket* guac_socket_alloc(void) {
     }
 
     socket->__ready = 0;
+    socket->__binary_framing = 0;
     socket->data = NULL;
     socket->state = GUAC_SOCKET_OPEN;
     socket->last_write_timestamp = guac_timestamp_current();
@@ -162,6 +156,8 @@ guac_socket* guac_socket_alloc(void) {
     /* No handlers yet */
     socket->read_handler   = NULL;
     socket->write_handler  = NULL;
+    socket->write_base64_handler = NULL;
+    socket->write_binary_handler = NULL;
     socket->select_handler = NULL;
     socket->free_handler   = NULL;
     socket->flush_handler  = NULL;
@@ -181,6 +177,10 @@ void guac_socket_require_keep_alive(guac_socket* socket) {
 
 }
 
+void guac_socket_enable_binary_framing(guac_socket* socket) {
+    socket->__binary_framing = 1;
+}
+
 void guac_socket_instruction_begin(guac_socket* socket) {
 
     /* Call instruction begin handler if defined */
@@ -239,110 +239,72 @@ ssize_t guac_socket_write_string(guac_socket* socket, const char* str) {
 }
 
 /**
- * Encodes one to three bytes of data as four characters in base64 encoding.
- *
- * This function takes int arguments even though it's working with bytes to
- * allow -1 to be used as distinct sentinel value for missing data.
- *
- * @param a An int holding the first byte of data to encode. Only the
- *          least-significant byte will be used. This will always be inserted
- *          into the output.
+ * Encodes the given data, which must consist only of complete groups of three
+ * bytes, as base64, writing the encoded data to the given socket. If the
+ * socket can encode base64 directly into its own buffers, the data is passed
+ * to its write_base64_handler. Otherwise, the data is encoded into the
+ * socket's __encoded_buf in chunks, each of which is written with
+ * guac_socket_write().
  *
- * @param b An int holding the second byte of data to encode. Only the
- *          least-significant byte will be used. If this is less than zero,
- *          the second and third bytes will be ignored and the last two
- *          characters of the output will be '=' padding characters.
+ * @param socket
+ *     The guac_socket to write to.
  *
- * @param c An int holding the third byte of data to encode. Only the
- *          least-significant byte will be used. If this is less than zero,
- *          the third byte will be ignored and the last character of the
- *          output will be a '=' padding character.
+ * @param buf
+ *     The data to encode and write.
  *
- * @param output Character buffer to hold the output. Exactly four characters
- *               will be written to the buffer starting at this location.
+ * @param count
+ *     The number of bytes of data to encode. This MUST be a multiple of
+ *     three.
  *
- * @return Returns zero.
+ * @return
+ *     Zero on success, or non-zero if an error occurs while writing.
  */
-ssize_t __guac_socket_encode_base64(int a, int b, int c, char* output) {
+static int __guac_socket_write_base64_groups(guac_socket* socket,
+        const unsigned char* buf, size_t count) {
 
-    /* Byte 0:[AAAAAA] AABBBB BBBBCC CCCCCC */
-    output[0] = __guac_socket_BASE64_CHARACTERS[(a & 0xFC) >> 2];
+    if (socket->write_base64_handler) {
 
-    if (b >= 0) {
+        /* Update timestamp of last write */
+        socket->last_write_timestamp = guac_timestamp_current();
 
-        /* Byte 1: AAAAAA [AABBBB] BBBBCC CCCCCC */
-        output[1] = __guac_socket_BASE64_CHARACTERS[((a & 0x03) << 4) | ((b & 0xF0) >> 4)];
+        return socket->write_base64_handler(socket, buf, count) < 0;
 
-        /*
-         * Bytes 2 and 3, zero characters of padding:
-         *
-         * AAAAAA  AABBBB [BBBBCC] CCCCCC
-         * AAAAAA  AABBBB  BBBBCC [CCCCCC]
-         */
-        if (c >= 0) {
-            output[2] = __guac_socket_BASE64_CHARACTERS[((b & 0x0F) << 2) | ((c & 0xC0) >> 6)];
-            output[3] = __guac_socket_BASE64_CHARACTERS[c & 0x3F];
-        }
-
-        /*
-         * Bytes 2 and 3, one character of padding:
-         *
-         * AAAAAA  AABBBB [BBBB--] ------
-         * AAAAAA  AABBBB  BBBB-- [------]
-         */
-        else {
-            output[2] = __guac_socket_BASE64_CHARACTERS[((b & 0x0F) << 2)];
-            output[3] = '=';
-        }
     }
 
-    /*
-     * Bytes 1, 2, and 3, two characters of padding:
-     *
-     * AAAAAA [AA----] ------  ------
-     * AAAAAA  AA---- [------] ------
-     * AAAAAA  AA----  ------ [------]
-     */
-    else {
-        output[1] = __guac_socket_BASE64_CHARACTERS[((a & 0x03) << 4)];
-        output[2] = '=';
-        output[3] = '=';
+    while (count > 0) {
+
+        /* Encode as much as fits within the encoded buffer */
+        size_t length = GUAC_SOCKET_BASE64_ENCODED_BUFFER_SIZE / 4 * 3;
+        if (length > count)
+            length = count;
+
+        size_t encoded = guac_base64_encode(buf, length, socket->__encoded_buf);
+        if (guac_socket_write(socket, socket->__encoded_buf, encoded))
+            return 1;
+
+        buf   += length;
+        count -= length;
+
     }
 
     return 0;
+
 }
 
 ssize_t guac_socket_flush_base64(guac_socket* socket) {
-    const unsigned char* src = socket->__ready_buf;
 
-    int encodedCount = 0;
-    int remaining = socket->__ready;
+    /* Encode any remaining partial group with padding */
+    if (socket->__ready > 0) {
 
-    /* Encode bytes in groups of three */
-    while (remaining > 2) {
-        __guac_socket_encode_base64(src[0], src[1], src[2], socket->__encoded_buf + encodedCount);
+        guac_base64_encode_final(socket->__ready_buf, socket->__ready,
+                socket->__encoded_buf);
 
-        remaining -= 3;
-        src += 3;
-        encodedCount += 4;
-    }
-
-    /* Take care of partial remnants */
-    if (remaining == 2) {
-        __guac_socket_encode_base64(src[0], src[1], -1, socket->__encoded_buf + encodedCount);
-        encodedCount += 4;
-    }
-    else if (remaining == 1) {
-        __guac_socket_encode_base64(src[0], -1, -1, socket->__encoded_buf + encodedCount);
-        encodedCount += 4;
-    }
+        if (guac_socket_write(socket, socket->__encoded_buf, 4))
+            return 1;
 
-    /* Write buffer to socket */
-    int retval = guac_socket_write(socket, socket->__encoded_buf, encodedCount);
-    if (retval < 0)
-        return retval;
+        socket->__ready = 0;
 
-    socket->__ready = 0;
+    }
 
     return 0;
 
@@ -350,35 +312,66 @@ ssize_t guac_socket_flush_base64(guac_socket* socket) {
 
 ssize_t guac_socket_write_base64(guac_socket* socket, const void* buf, size_t count) {
 
-    const unsigned char* src = (const unsigned char*)buf;
-    size_t remaining = count;
-    int len;
-    int retval;
+    const unsigned char* src = (const unsigned char*) buf;
 
-    while (remaining > 0) {
-        /* Fill ready buffer as much as possible */
-        len = GUAC_SOCKET_BASE64_READY_BUFFER_SIZE - socket->__ready;
-        if (remaining < len)
-            len = remaining;
+    /* Complete any partial group left over from a previous write */
+    if (socket->__ready > 0) {
 
-        memcpy(socket->__ready_buf + socket->__ready, src, len);
+        while (socket->__ready < 3 && count > 0) {
+            socket->__ready_buf[socket->__ready++] = *(src++);
+            count--;
+        }
 
-        socket->__ready += len;
-        src += len;
-        remaining -= len;
+        if (socket->__ready < 3)
+            return 0;
+
+        if (__guac_socket_write_base64_groups(socket, socket->__ready_buf, 3))
+            return 1;
+
+        socket->__ready = 0;
 
-        /* Flush ready buffer when full */
-        if (socket->__ready == GUAC_SOCKET_BASE64_READY_BUFFER_SIZE) {
-            retval = guac_socket_flush_base64(socket);
-            if (retval < 0)
-                return retval;
-        }
     }
 
+    /* Encode all complete groups directly from the provided buffer */
+    size_t length = count - count % 3;
+    if (length > 0 && __guac_socket_write_base64_groups(socket, src, length))
+        return 1;
+
+    /* Hold back any trailing partial group until more data is written or the
+     * base64 data is flushed */
+    memcpy(socket->__ready_buf, src + length, count - length);
+    socket->__ready = count - length;
+
     return 0;
 
 }
 
+ssize_t guac_socket_write_binary(guac_socket* socket, const void* buf, size_t count) {
+
+    /* Leave framing to the sockets receiving forwarded data, if any */
+    if (socket->write_binary_handler) {
+
+        /* Update timestamp of last write */
+        socket->last_write_timestamp = guac_timestamp_current();
+
+        return socket->write_binary_handler(socket, buf, count) < 0;
+
+    }
+
+    /* Raw data prefixed with its length in bytes */
+    if (socket->__binary_framing)
+        return guac_socket_write_int(socket, count)
+            || guac_socket_write_string(socket, "#")
+            || guac_socket_write(socket, buf, count);
+
+    /* Base64 prefixed with its length in characters */
+    return guac_socket_write_int(socket, (count + 2) / 3 * 4)
+        || guac_socket_write_string(socket, ".")
+        || guac_socket_write_base64(socket, buf, count)
+        || guac_socket_flush_base64(socket);
+
+}
+
 ssize_t guac_socket_flush(guac_socket* socket) {
 
     /* If handler defined, call it. */
@@ -0,0 +1,157 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Microbenchmark for the guac_display pixel kernels. This is not a unit test
+ * and is not run by "make check". It may be built with "make benchmarks" and
+ * run manually to compare the throughput of each set of kernels supported by
+ * the current processor.
+ */
+
+#include "display-kernels.h"
+#include "guacamole/mem.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * The width of the simulated frame, in pixels.
+ */
+#define BENCH_WIDTH 3840
+
+/**
+ * The height of the simulated frame, in pixels.
+ */
+#define BENCH_HEIGHT 2160
+
+/**
+ * The number of times each kernel is run over the entire simulated frame.
+ */
+#define BENCH_ITERATIONS 20
+
+/**
+ * Returns the current value of a monotonic clock, in seconds.
+ *
+ * @return
+ *     The current value of a monotonic clock, in seconds.
+ */
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+/**
+ * Prints the throughput of a kernel that processed the simulated frame
+ * BENCH_ITERATIONS times within the given number of seconds.
+ *
+ * @param kernels
+ *     The set of kernels being benchmarked.
+ *
+ * @param kernel
+ *     The name of the kernel being benchmarked.
+ *
+ * @param elapsed
+ *     The total number of seconds taken.
+ */
+static void bench_report(const guac_display_kernels* kernels,
+        const char* kernel, double elapsed) {
+
+    double mpixels = (double) BENCH_WIDTH * BENCH_HEIGHT * BENCH_ITERATIONS / 1000000.0;
+    printf("%-8s %-16s %8.2f ms/frame %10.1f Mpx/s\n", kernels->name, kernel,
+            elapsed * 1000.0 / BENCH_ITERATIONS, mpixels / elapsed);
+
+}
+
+int main(void) {
+
+    uint32_t* last_frame = guac_mem_alloc(BENCH_WIDTH, BENCH_HEIGHT, sizeof(uint32_t));
+    uint32_t* pending_frame = guac_mem_alloc(BENCH_WIDTH, BENCH_HEIGHT, sizeof(uint32_t));
+    uint32_t* solid_row = guac_mem_alloc(BENCH_WIDTH, sizeof(uint32_t));
+    uint64_t* cell_hash = guac_mem_zalloc(BENCH_WIDTH, sizeof(uint64_t));
+
+    for (int x = 0; x < BENCH_WIDTH; x++)
+        solid_row[x] = 0xFF336699;
+
+    /* Simulate a frame where each 64-pixel segment differs only in a few
+     * pixels near its middle (the worst case for the difference search) */
+    for (size_t i = 0; i < (size_t) BENCH_WIDTH * BENCH_HEIGHT; i++)
+        last_frame[i] = pending_frame[i] = 0xFF000000 | (i % 251);
+
+    for (size_t i = 32; i < (size_t) BENCH_WIDTH * BENCH_HEIGHT; i += 64)
+        pending_frame[i] ^= 0x00010101;
+
+    volatile size_t sink = 0;
+
+    for (const guac_display_kernels* const* current = guac_display_kernels_all;
+            *current != NULL; current++) {
+
+        const guac_display_kernels* kernels = *current;
+        if (!kernels->supported()) {
+            printf("%-8s (not supported by this processor)\n", kernels->name);
+            continue;
+        }
+
+        /* Frame diff, 64 pixels (one cell) at a time */
+        double start = bench_now();
+        for (int i = 0; i < BENCH_ITERATIONS; i++) {
+            for (size_t offset = 0; offset < (size_t) BENCH_WIDTH * BENCH_HEIGHT; offset += 64) {
+                size_t pos;
+                sink += kernels->memcmp(pending_frame + offset, last_frame + offset, 64, &pos);
+            }
+        }
+        bench_report(kernels, "memcmp", bench_now() - start);
+
+        /* Rolling hash, one full row at a time */
+        start = bench_now();
+        for (int i = 0; i < BENCH_ITERATIONS; i++) {
+            for (int y = 0; y < BENCH_HEIGHT; y++)
+                kernels->hash_row(pending_frame + (size_t) y * BENCH_WIDTH, cell_hash, BENCH_WIDTH);
+        }
+        sink += cell_hash[0];
+        bench_report(kernels, "hash_row", bench_now() - start);
+
+        /* Single-color detection, 64 pixels (one cell) at a time, using
+         * rows that actually consist of a single color (the worst case, as
+         * every pixel must be checked) */
+        start = bench_now();
+        for (int i = 0; i < BENCH_ITERATIONS; i++) {
+            for (int y = 0; y < BENCH_HEIGHT; y++) {
+                for (int x = 0; x < BENCH_WIDTH; x += 64) {
+                    uint32_t color;
+                    sink += kernels->is_single_color((const unsigned char*) (solid_row + x),
+                            64 * sizeof(uint32_t), &color);
+                }
+            }
+        }
+        bench_report(kernels, "is_single_color", bench_now() - start);
+
+    }
+
+    guac_mem_free(last_frame);
+    guac_mem_free(pending_frame);
+    guac_mem_free(solid_row);
+    guac_mem_free(cell_hash);
+
+    return 0;
+
+}
@@ -0,0 +1,230 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-plan.h"
+#include "display-priv.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/mem.h>
+
+/**
+ * The number of pixels within each update considered by these tests. This
+ * is large enough that JPEG is applicable to opaque layers.
+ */
+#define TEST_COST_PIXELS 10000
+
+/**
+ * Records enough measurements of the given format for the given class of
+ * content that the encoder cost model will consider the format measured,
+ * each measurement having the given cost.
+ *
+ * @param display
+ *     The display whose cost model should be updated.
+ *
+ * @param format
+ *     The format that was measured.
+ *
+ * @param region_class
+ *     The class of content that was measured.
+ *
+ * @param usec_per_pixel
+ *     The time taken to encode each pixel, in microseconds.
+ */
+static void measure(guac_display* display, guac_display_format format,
+        guac_display_region_class region_class, int usec_per_pixel) {
+
+    for (int i = 0; i < GUAC_DISPLAY_COST_MIN_SAMPLES; i++)
+        guac_display_cost_record(display, format, region_class,
+                TEST_COST_PIXELS, (uint64_t) usec_per_pixel * TEST_COST_PIXELS,
+                TEST_COST_PIXELS);
+
+}
+
+/**
+ * Test which verifies that lossy formats are candidates only if the static
+ * heuristics would consider lossy compression, and that the fallback format
+ * matches the format those heuristics would select.
+ */
+void test_display__cost_candidates(void) {
+
+    guac_display_format fallback;
+    int png = 1 << GUAC_DISPLAY_FORMAT_PNG;
+    int jpeg = 1 << GUAC_DISPLAY_FORMAT_JPEG;
+    int webp = 1 << GUAC_DISPLAY_FORMAT_WEBP;
+
+    /* Updates that would not be lossy are always PNG */
+    CU_ASSERT_EQUAL(guac_display_cost_candidates(0, 1, TEST_COST_PIXELS, 1, &fallback), png);
+    CU_ASSERT_EQUAL(fallback, GUAC_DISPLAY_FORMAT_PNG);
+
+    CU_ASSERT_EQUAL(guac_display_cost_candidates(0, 1, TEST_COST_PIXELS, 0, &fallback), png);
+    CU_ASSERT_EQUAL(fallback, GUAC_DISPLAY_FORMAT_PNG);
+
+    /* JPEG is applicable only to sufficiently large, opaque updates */
+    CU_ASSERT_EQUAL(guac_display_cost_candidates(1, 1, TEST_COST_PIXELS, 0, &fallback), png | jpeg);
+    CU_ASSERT_EQUAL(fallback, GUAC_DISPLAY_FORMAT_JPEG);
+
+    CU_ASSERT_EQUAL(guac_display_cost_candidates(1, 0, TEST_COST_PIXELS, 0, &fallback), png);
+    CU_ASSERT_EQUAL(fallback, GUAC_DISPLAY_FORMAT_PNG);
+
+    CU_ASSERT_EQUAL(guac_display_cost_candidates(1, 1, GUAC_DISPLAY_JPEG_MIN_BITMAP_SIZE, 0, &fallback), png);
+    CU_ASSERT_EQUAL(fallback, GUAC_DISPLAY_FORMAT_PNG);
+
+    /* WebP is preferred over JPEG wherever supported */
+    CU_ASSERT_EQUAL(guac_display_cost_candidates(1, 1, TEST_COST_PIXELS, 1, &fallback), png | jpeg | webp);
+    CU_ASSERT_EQUAL(fallback, GUAC_DISPLAY_FORMAT_WEBP);
+
+    CU_ASSERT_EQUAL(guac_display_cost_candidates(1, 0, TEST_COST_PIXELS, 1, &fallback), png | webp);
+    CU_ASSERT_EQUAL(fallback, GUAC_DISPLAY_FORMAT_WEBP);
+
+}
+
+/**
+ * Test which verifies that the static heuristics are followed until all
+ * candidate formats have been measured, except for periodic decisions that
+ * select an unmeasured format so that it may be measured.
+ */
+void test_display__cost_explore(void) {
+
+    guac_display* display = guac_mem_zalloc(sizeof(guac_display));
+    guac_display_cost_model* model = &display->cost_model;
+    int candidates = (1 << GUAC_DISPLAY_FORMAT_PNG) | (1 << GUAC_DISPLAY_FORMAT_JPEG);
+
+    /* PNG is measured, but JPEG is not */
+    measure(display, GUAC_DISPLAY_FORMAT_PNG, GUAC_DISPLAY_REGION_DETAILED, 1);
+
+    for (int round = 0; round < 2; round++) {
+
+        for (int i = 0; i < GUAC_DISPLAY_COST_EXPLORE_INTERVAL - 1; i++)
+            CU_ASSERT_EQUAL(guac_display_cost_select(display, GUAC_DISPLAY_REGION_DETAILED,
+                        TEST_COST_PIXELS, 10, candidates, GUAC_DISPLAY_FORMAT_PNG),
+                    GUAC_DISPLAY_FORMAT_PNG);
+
+        CU_ASSERT_EQUAL(guac_display_cost_select(display, GUAC_DISPLAY_REGION_DETAILED,
+                    TEST_COST_PIXELS, 10, candidates, GUAC_DISPLAY_FORMAT_PNG),
+                GUAC_DISPLAY_FORMAT_JPEG);
+
+    }
+
+    CU_ASSERT_EQUAL(model->heuristic, 2 * (GUAC_DISPLAY_COST_EXPLORE_INTERVAL - 1));
+    CU_ASSERT_EQUAL(model->explored, 2);
+    CU_ASSERT_EQUAL(model->over_budget, 0);
+
+    /* Measurements of other classes of content are irrelevant */
+    measure(display, GUAC_DISPLAY_FORMAT_JPEG, GUAC_DISPLAY_REGION_MIXED, 1);
+    CU_ASSERT_EQUAL(guac_display_cost_select(display, GUAC_DISPLAY_REGION_DETAILED,
+                TEST_COST_PIXELS, 10, candidates, GUAC_DISPLAY_FORMAT_PNG),
+            GUAC_DISPLAY_FORMAT_PNG);
+    CU_ASSERT_EQUAL(model->heuristic, 2 * (GUAC_DISPLAY_COST_EXPLORE_INTERVAL - 1) + 1);
+
+    guac_mem_free(display);
+
+}
+
+/**
+ * Test which verifies that, once all candidate formats have been measured,
+ * the most preferable format fitting within the time budgeted is selected.
+ */
+void test_display__cost_select(void) {
+
+    guac_display* display = guac_mem_zalloc(sizeof(guac_display));
+    guac_display_cost_model* model = &display->cost_model;
+    int candidates = (1 << GUAC_DISPLAY_FORMAT_PNG) | (1 << GUAC_DISPLAY_FORMAT_JPEG);
+
+    /* At 10 frames per second, each update is budgeted 100 ms, and encoding
+     * all pixels as PNG will take 20 ms */
+    measure(display, GUAC_DISPLAY_FORMAT_PNG, GUAC_DISPLAY_REGION_DETAILED, 2);
+    measure(display, GUAC_DISPLAY_FORMAT_JPEG, GUAC_DISPLAY_REGION_DETAILED, 1);
+
+    /* PNG is preferred, even if JPEG is cheaper, as long as PNG fits */
+    CU_ASSERT_EQUAL(guac_display_cost_select(display, GUAC_DISPLAY_REGION_DETAILED,
+                TEST_COST_PIXELS, 10, candidates, GUAC_DISPLAY_FORMAT_JPEG),
+            GUAC_DISPLAY_FORMAT_PNG);
+
+    /* At 100 frames per second, only JPEG fits within the 10 ms budgeted */
+    CU_ASSERT_EQUAL(guac_display_cost_select(display, GUAC_DISPLAY_REGION_DETAILED,
+                TEST_COST_PIXELS, 100, candidates, GUAC_DISPLAY_FORMAT_PNG),
+            GUAC_DISPLAY_FORMAT_JPEG);
+
+    /* Formats that are not candidates are never selected */
+    CU_ASSERT_EQUAL(guac_display_cost_select(display, GUAC_DISPLAY_REGION_DETAILED,
+                TEST_COST_PIXELS, 100, 1 << GUAC_DISPLAY_FORMAT_PNG,
+                GUAC_DISPLAY_FORMAT_PNG), GUAC_DISPLAY_FORMAT_PNG);
+
+    CU_ASSERT_EQUAL(model->estimates[GUAC_DISPLAY_REGION_DETAILED][GUAC_DISPLAY_FORMAT_PNG].selected, 2);
+    CU_ASSERT_EQUAL(model->estimates[GUAC_DISPLAY_REGION_DETAILED][GUAC_DISPLAY_FORMAT_JPEG].selected, 1);
+    CU_ASSERT_EQUAL(model->heuristic, 0);
+    CU_ASSERT_EQUAL(model->explored, 0);
+
+    /* The last of these decisions exceeded the budget */
+    CU_ASSERT_EQUAL(model->over_budget, 1);
+
+    guac_mem_free(display);
+
+}
+
+/**
+ * Test which verifies that the time budgeted for an update is the portion of
+ * the frame that the update represents, and that the least costly format is
+ * selected if no format fits.
+ */
+void test_display__cost_budget(void) {
+
+    guac_display* display = guac_mem_zalloc(sizeof(guac_display));
+    guac_display_cost_model* model = &display->cost_model;
+    int candidates = (1 << GUAC_DISPLAY_FORMAT_PNG) | (1 << GUAC_DISPLAY_FORMAT_JPEG);
+
+    measure(display, GUAC_DISPLAY_FORMAT_PNG, GUAC_DISPLAY_REGION_DETAILED, 2);
+    measure(display, GUAC_DISPLAY_FORMAT_JPEG, GUAC_DISPLAY_REGION_DETAILED, 1);
+
+    /* The update is a tenth of a frame, and thus is budgeted 10 ms of the
+     * 100 ms available at 10 frames per second */
+    model->frame_pixels = TEST_COST_PIXELS * 10;
+    CU_ASSERT_EQUAL(guac_display_cost_select(display, GUAC_DISPLAY_REGION_DETAILED,
+                TEST_COST_PIXELS, 10, candidates, GUAC_DISPLAY_FORMAT_PNG),
+            GUAC_DISPLAY_FORMAT_JPEG);
+    CU_ASSERT_EQUAL(model->over_budget, 0);
+
+    /* The update is a hundredth of a frame (1 ms), so neither format fits
+     * and the cheapest is used */
+    model->frame_pixels = TEST_COST_PIXELS * 100;
+    CU_ASSERT_EQUAL(guac_display_cost_select(display, GUAC_DISPLAY_REGION_DETAILED,
+                TEST_COST_PIXELS, 10, candidates, GUAC_DISPLAY_FORMAT_PNG),
+            GUAC_DISPLAY_FORMAT_JPEG);
+    CU_ASSERT_EQUAL(model->over_budget, 1);
+
+    /* Once bandwidth is known, transfer time is included, such that the
+     * format producing less data is cheaper overall (50 bytes/ms) */
+    model->frame_pixels = 0;
+    model->link.bandwidth = 50;
+    measure(display, GUAC_DISPLAY_FORMAT_PNG, GUAC_DISPLAY_REGION_MIXED, 2);
+    for (int i = 0; i < GUAC_DISPLAY_COST_MIN_SAMPLES; i++)
+        guac_display_cost_record(display, GUAC_DISPLAY_FORMAT_JPEG,
+                GUAC_DISPLAY_REGION_MIXED, TEST_COST_PIXELS, TEST_COST_PIXELS,
+                TEST_COST_PIXELS * 10);
+
+    /* Neither PNG (20 ms + 200 ms) nor JPEG (10 ms + 2000 ms) fit within
+     * 100 ms, but PNG is now cheaper */
+    CU_ASSERT_EQUAL(guac_display_cost_select(display, GUAC_DISPLAY_REGION_MIXED,
+                TEST_COST_PIXELS, 10, candidates, GUAC_DISPLAY_FORMAT_JPEG),
+            GUAC_DISPLAY_FORMAT_PNG);
+    CU_ASSERT_EQUAL(model->over_budget, 2);
+
+    guac_mem_free(display);
+
+}
@@ -0,0 +1,77 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-priv.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/display.h>
+#include <guacamole/fifo.h>
+#include <guacamole/rect.h>
+
+/**
+ * The number of layers allocated by each test case, in addition to the
+ * default layer.
+ */
+#define TEST_FREE_LAYERS 4
+
+/**
+ * Test which verifies that a display can be freed while worker threads have
+ * reported how image data was encoded, but before those reports have been
+ * applied to a new frame. Freeing each layer removes that layer's reports, so
+ * the storage of those reports must remain valid until all layers are freed.
+ * When built with a memory error detector, any use of that storage after it
+ * has been freed is reported as a failure.
+ */
+void test_display__free_pending(void) {
+
+    guac_client* client = guac_client_alloc();
+    guac_display* display = guac_display_alloc(client);
+
+    guac_display_layer* layers[TEST_FREE_LAYERS];
+    for (int i = 0; i < TEST_FREE_LAYERS; i++)
+        layers[i] = guac_display_alloc_layer(display, 1);
+
+    /* Report encodings for every layer, alternating between lossy and
+     * lossless, exactly as the worker threads would */
+    guac_rect rect;
+    guac_rect_init(&rect, 0, 0, 64, 64);
+
+    for (int i = 0; i < TEST_FREE_LAYERS; i++) {
+        guac_display_report_encoding(display, layers[i], &rect, i % 2);
+        guac_display_report_encoding(display, guac_display_default_layer(display),
+                &rect, i % 2);
+    }
+
+    guac_fifo_lock(&display->ops);
+    CU_ASSERT_EQUAL(display->encoding_report_count, TEST_FREE_LAYERS * 2);
+    guac_fifo_unlock(&display->ops);
+
+    /* Freeing a layer removes only the reports for that layer */
+    guac_display_free_layer(layers[0]);
+
+    guac_fifo_lock(&display->ops);
+    CU_ASSERT_EQUAL(display->encoding_report_count, TEST_FREE_LAYERS * 2 - 1);
+    guac_fifo_unlock(&display->ops);
+
+    /* Remaining reports are removed as the display frees each layer */
+    guac_display_free(display);
+    guac_client_free(client);
+
+}
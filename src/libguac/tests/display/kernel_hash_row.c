@@ -0,0 +1,126 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-kernels.h"
+
+#include <CUnit/CUnit.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * The number of pixels in each row hashed by the test. This is intentionally
+ * not a multiple of any vector width so that the tail handling of each kernel
+ * is exercised.
+ */
+#define TEST_HASH_ROW_WIDTH 203
+
+/**
+ * The number of rows hashed by the test. This is intentionally larger than
+ * the 64 rows required for each cell hash to become valid.
+ */
+#define TEST_HASH_ROW_HEIGHT 97
+
+/**
+ * Returns the next value from a simple, deterministic pseudo-random sequence.
+ *
+ * @param state
+ *     The current state of the sequence, which will be updated.
+ *
+ * @return
+ *     The next pseudo-random value.
+ */
+static uint32_t next_pixel(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/**
+ * Test which verifies that every supported set of pixel kernels produces
+ * exactly the same rolling hash values as the scalar kernels, for every row
+ * and for every possible row length.
+ */
+void test_display__kernel_hash_row(void) {
+
+    static uint32_t image[TEST_HASH_ROW_HEIGHT][TEST_HASH_ROW_WIDTH];
+    static uint64_t expected[TEST_HASH_ROW_WIDTH];
+    static uint64_t actual[TEST_HASH_ROW_WIDTH];
+
+    uint32_t state = 0x12345678;
+    for (int y = 0; y < TEST_HASH_ROW_HEIGHT; y++) {
+        for (int x = 0; x < TEST_HASH_ROW_WIDTH; x++)
+            image[y][x] = next_pixel(&state);
+    }
+
+    for (const guac_display_kernels* const* kernels = guac_display_kernels_all;
+            *kernels != NULL; kernels++) {
+
+        if (!(*kernels)->supported())
+            continue;
+
+        for (size_t length = 0; length <= TEST_HASH_ROW_WIDTH; length += 7) {
+
+            memset(expected, 0, sizeof(expected));
+            memset(actual, 0, sizeof(actual));
+
+            for (int y = 0; y < TEST_HASH_ROW_HEIGHT; y++) {
+                guac_display_kernels_scalar.hash_row(image[y], expected, length);
+                (*kernels)->hash_row(image[y], actual, length);
+                CU_ASSERT_FALSE(memcmp(expected, actual, sizeof(expected)));
+            }
+
+        }
+
+    }
+
+}
+
+/**
+ * Test which verifies that the rolling hash produced by the pixel kernels
+ * depends only on the contents of each 64x64 region, such that identical
+ * regions at different locations produce identical hashes.
+ */
+void test_display__kernel_hash_row_window(void) {
+
+    static uint32_t image[64][TEST_HASH_ROW_WIDTH];
+    uint64_t hashes[TEST_HASH_ROW_WIDTH] = { 0 };
+
+    uint32_t state = 0x9ABCDEF0;
+    for (int y = 0; y < 64; y++) {
+
+        /* Repeat the same 64 pixels at offset 0 and offset 100, with
+         * arbitrary pixels elsewhere */
+        for (int x = 0; x < TEST_HASH_ROW_WIDTH; x++)
+            image[y][x] = next_pixel(&state);
+
+        memcpy(&image[y][100], &image[y][0], 64 * sizeof(uint32_t));
+
+    }
+
+    const guac_display_kernels* kernels = guac_display_kernels_select();
+    for (int y = 0; y < 64; y++)
+        kernels->hash_row(image[y], hashes, TEST_HASH_ROW_WIDTH);
+
+    /* The hash at each position is the hash of the 64x64 region ending at
+     * that position */
+    CU_ASSERT_EQUAL(hashes[63], hashes[163]);
+    CU_ASSERT_NOT_EQUAL(hashes[63], hashes[164]);
+
+}
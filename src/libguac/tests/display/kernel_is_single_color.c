@@ -0,0 +1,96 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-kernels.h"
+
+#include <CUnit/CUnit.h>
+#include <stdint.h>
+
+/**
+ * The maximum number of pixels to check in each test case. This is
+ * intentionally not a multiple of any vector width so that the tail handling
+ * of each kernel is exercised.
+ */
+#define TEST_SINGLE_COLOR_MAX_COUNT 75
+
+/**
+ * Verifies that the given pixel kernels reach exactly the same conclusion as
+ * the scalar kernels for the given buffer, for every possible length (in
+ * bytes) up to the given number of pixels.
+ *
+ * @param kernels
+ *     The kernels to verify.
+ *
+ * @param buffer
+ *     The buffer to check.
+ *
+ * @param count
+ *     The maximum number of 32-bit pixels to check.
+ */
+static void verify_is_single_color(const guac_display_kernels* kernels,
+        const uint32_t* buffer, size_t count) {
+
+    for (size_t length = 0; length <= count * 4; length++) {
+
+        uint32_t expected_color = 0xDEADBEEF;
+        uint32_t actual_color = 0xDEADBEEF;
+
+        int expected = guac_display_kernels_scalar.is_single_color(
+                (const unsigned char*) buffer, length, &expected_color);
+
+        int actual = kernels->is_single_color(
+                (const unsigned char*) buffer, length, &actual_color);
+
+        CU_ASSERT_EQUAL(!expected, !actual);
+        CU_ASSERT_EQUAL(expected_color, actual_color);
+
+    }
+
+}
+
+/**
+ * Test which verifies that every supported set of pixel kernels determines
+ * whether a buffer consists of a single color identically to the scalar
+ * kernels.
+ */
+void test_display__kernel_is_single_color(void) {
+
+    uint32_t buffer[TEST_SINGLE_COLOR_MAX_COUNT];
+    for (int i = 0; i < TEST_SINGLE_COLOR_MAX_COUNT; i++)
+        buffer[i] = 0xFF336699;
+
+    for (const guac_display_kernels* const* kernels = guac_display_kernels_all;
+            *kernels != NULL; kernels++) {
+
+        if (!(*kernels)->supported())
+            continue;
+
+        /* Entirely one color */
+        verify_is_single_color(*kernels, buffer, TEST_SINGLE_COLOR_MAX_COUNT);
+
+        /* One differing pixel at every possible position */
+        for (int i = 0; i < TEST_SINGLE_COLOR_MAX_COUNT; i++) {
+            buffer[i] = 0xFF336698;
+            verify_is_single_color(*kernels, buffer, TEST_SINGLE_COLOR_MAX_COUNT);
+            buffer[i] = 0xFF336699;
+        }
+
+    }
+
+}
@@ -0,0 +1,109 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-kernels.h"
+
+#include <CUnit/CUnit.h>
+#include <stdint.h>
+
+/**
+ * The maximum number of pixels to compare in each test case. This is
+ * intentionally not a multiple of any vector width so that the tail handling
+ * of each kernel is exercised.
+ */
+#define TEST_MEMCMP_MAX_COUNT 83
+
+/**
+ * Verifies that the given pixel kernels locate exactly the same differences
+ * as the scalar kernels for the given pair of buffers, for every possible
+ * length up to the given count.
+ *
+ * @param kernels
+ *     The kernels to verify.
+ *
+ * @param a
+ *     The first buffer to compare.
+ *
+ * @param b
+ *     The buffer to compare with the first buffer.
+ *
+ * @param count
+ *     The maximum number of 32-bit quantities to compare.
+ */
+static void verify_memcmp(const guac_display_kernels* kernels,
+        const uint32_t* a, const uint32_t* b, size_t count) {
+
+    for (size_t length = 0; length <= count; length++) {
+
+        size_t expected_pos = (size_t) -1;
+        size_t actual_pos = (size_t) -1;
+
+        size_t expected = guac_display_kernels_scalar.memcmp(a, b, length, &expected_pos);
+        size_t actual = kernels->memcmp(a, b, length, &actual_pos);
+
+        CU_ASSERT_EQUAL(expected, actual);
+        CU_ASSERT_EQUAL(expected_pos, actual_pos);
+
+    }
+
+}
+
+/**
+ * Test which verifies that every supported set of pixel kernels locates the
+ * same differences between two rows of pixels as the scalar kernels,
+ * regardless of where and how many differences are present.
+ */
+void test_display__kernel_memcmp(void) {
+
+    uint32_t a[TEST_MEMCMP_MAX_COUNT];
+    uint32_t b[TEST_MEMCMP_MAX_COUNT];
+
+    for (int i = 0; i < TEST_MEMCMP_MAX_COUNT; i++)
+        a[i] = b[i] = 0xFF000000 | (i * 0x010203);
+
+    for (const guac_display_kernels* const* kernels = guac_display_kernels_all;
+            *kernels != NULL; kernels++) {
+
+        if (!(*kernels)->supported())
+            continue;
+
+        /* Identical buffers */
+        verify_memcmp(*kernels, a, b, TEST_MEMCMP_MAX_COUNT);
+
+        /* Single difference at every possible position */
+        for (int i = 0; i < TEST_MEMCMP_MAX_COUNT; i++) {
+            b[i] ^= 0x00000100;
+            verify_memcmp(*kernels, a, b, TEST_MEMCMP_MAX_COUNT);
+            b[i] = a[i];
+        }
+
+        /* Pairs of differences spanning every possible range */
+        for (int i = 0; i < TEST_MEMCMP_MAX_COUNT; i++) {
+            for (int j = i + 1; j < TEST_MEMCMP_MAX_COUNT; j += 3) {
+                b[i] ^= 0x01000000;
+                b[j] ^= 0x00000001;
+                verify_memcmp(*kernels, a, b, TEST_MEMCMP_MAX_COUNT);
+                b[i] = a[i];
+                b[j] = a[j];
+            }
+        }
+
+    }
+
+}
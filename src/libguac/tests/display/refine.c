@@ -0,0 +1,451 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-plan.h"
+#include "display-priv.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/display.h>
+#include <guacamole/fifo.h>
+#include <guacamole/mem.h>
+#include <guacamole/rect.h>
+#include <guacamole/rwlock.h>
+#include <guacamole/socket.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * The width and height of the layer drawn by these tests, in pixels. This is
+ * large enough that updates covering the entire layer will be sent as
+ * previews.
+ */
+#define TEST_REFINE_SIZE 512
+
+/**
+ * The maximum number of "img" instructions recorded by a test_capture.
+ */
+#define TEST_REFINE_MAX_IMAGES 256
+
+/**
+ * All data written to a guac_socket created by test_capture_alloc().
+ */
+typedef struct test_capture {
+
+    /**
+     * Lock which is held while an instruction is being written.
+     */
+    pthread_mutex_t instruction_lock;
+
+    /**
+     * Lock which is held while data is being appended to the buffer.
+     */
+    pthread_mutex_t buffer_lock;
+
+    /**
+     * The data written thus far.
+     */
+    char* buffer;
+
+    /**
+     * The number of bytes written thus far.
+     */
+    size_t length;
+
+    /**
+     * The number of bytes that may be stored within the buffer before the
+     * buffer must be reallocated.
+     */
+    size_t size;
+
+} test_capture;
+
+/**
+ * An "img" instruction that was written to a test_capture.
+ */
+typedef struct test_image {
+
+    /**
+     * The mimetype of the image data.
+     */
+    char mimetype[32];
+
+    /**
+     * The index of the layer receiving the image.
+     */
+    int layer;
+
+    /**
+     * The X coordinate of the upper-left corner of the image.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the image.
+     */
+    int y;
+
+    /**
+     * The number of "sync" instructions that preceded the image.
+     */
+    int syncs;
+
+} test_image;
+
+/**
+ * Write handler which appends all data written to the socket's test_capture.
+ */
+static ssize_t test_capture_write(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    test_capture* capture = (test_capture*) socket->data;
+
+    pthread_mutex_lock(&capture->buffer_lock);
+
+    if (capture->length + count > capture->size) {
+        capture->size = (capture->length + count) * 2;
+        capture->buffer = guac_mem_realloc(capture->buffer, capture->size);
+    }
+
+    memcpy(capture->buffer + capture->length, buf, count);
+    capture->length += count;
+
+    pthread_mutex_unlock(&capture->buffer_lock);
+
+    return count;
+
+}
+
+/**
+ * Lock handler which prevents instructions written by different threads from
+ * being interleaved.
+ */
+static void test_capture_lock(guac_socket* socket) {
+    test_capture* capture = (test_capture*) socket->data;
+    pthread_mutex_lock(&capture->instruction_lock);
+}
+
+/**
+ * Unlock handler which releases the lock acquired by test_capture_lock().
+ */
+static void test_capture_unlock(guac_socket* socket) {
+    test_capture* capture = (test_capture*) socket->data;
+    pthread_mutex_unlock(&capture->instruction_lock);
+}
+
+/**
+ * Free handler which frees the socket's test_capture.
+ */
+static int test_capture_free(guac_socket* socket) {
+
+    test_capture* capture = (test_capture*) socket->data;
+
+    pthread_mutex_destroy(&capture->instruction_lock);
+    pthread_mutex_destroy(&capture->buffer_lock);
+    guac_mem_free(capture->buffer);
+    guac_mem_free(capture);
+
+    return 0;
+
+}
+
+/**
+ * Replaces the socket of the given guac_client with a socket that records
+ * all data written, returning the test_capture receiving that data. The
+ * capture is freed when the guac_client is freed.
+ *
+ * @param client
+ *     The guac_client whose socket should be replaced.
+ *
+ * @return
+ *     The test_capture receiving all data written to the client's socket.
+ */
+static test_capture* test_capture_alloc(guac_client* client) {
+
+    test_capture* capture = guac_mem_zalloc(sizeof(test_capture));
+    pthread_mutex_init(&capture->instruction_lock, NULL);
+    pthread_mutex_init(&capture->buffer_lock, NULL);
+
+    guac_socket* socket = guac_socket_alloc();
+    socket->data = capture;
+    socket->write_handler = test_capture_write;
+    socket->lock_handler = test_capture_lock;
+    socket->unlock_handler = test_capture_unlock;
+    socket->free_handler = test_capture_free;
+
+    guac_socket_free(client->socket);
+    client->socket = socket;
+
+    return capture;
+
+}
+
+/**
+ * Parses the instructions written to the given test_capture, starting at the
+ * given offset, recording each "img" instruction encountered.
+ *
+ * @param capture
+ *     The test_capture containing the instructions to parse.
+ *
+ * @param offset
+ *     The offset of the first instruction to parse.
+ *
+ * @param images
+ *     An array of TEST_REFINE_MAX_IMAGES test_image structures that should
+ *     receive each "img" instruction.
+ *
+ * @return
+ *     The number of "img" instructions parsed.
+ */
+static int test_capture_parse_images(test_capture* capture, size_t offset,
+        test_image* images) {
+
+    int count = 0;
+    int syncs = 0;
+
+    const char* current = capture->buffer + offset;
+    const char* end = capture->buffer + capture->length;
+
+    while (current < end) {
+
+        /* Parse up to the first seven elements of each instruction */
+        const char* values[7];
+        int lengths[7];
+        int elements = 0;
+
+        for (;;) {
+
+            int length = strtol(current, (char**) &current, 10);
+            CU_ASSERT_EQUAL_FATAL(*current, '.');
+
+            if (elements < 7) {
+                values[elements] = current + 1;
+                lengths[elements] = length;
+                elements++;
+            }
+
+            /* All values involved are ASCII, such that the length of each
+             * value in characters is its length in bytes */
+            current += length + 1;
+            if (*(current++) == ';')
+                break;
+
+        }
+
+        if (lengths[0] == 4 && strncmp(values[0], "sync", 4) == 0)
+            syncs++;
+
+        else if (lengths[0] == 3 && strncmp(values[0], "img", 3) == 0) {
+
+            CU_ASSERT_EQUAL_FATAL(elements, 7);
+            CU_ASSERT_FATAL(count < TEST_REFINE_MAX_IMAGES);
+            CU_ASSERT_FATAL(lengths[4] < (int) sizeof(images->mimetype));
+
+            test_image* image = &images[count++];
+            memcpy(image->mimetype, values[4], lengths[4]);
+            image->mimetype[lengths[4]] = '\0';
+            image->layer = atoi(values[3]);
+            image->x = atoi(values[5]);
+            image->y = atoi(values[6]);
+            image->syncs = syncs;
+
+        }
+
+    }
+
+    return count;
+
+}
+
+/**
+ * Draws pixels to the entire given layer that differ from any pixels
+ * previously drawn by a call using a different seed, and that are noisy
+ * enough that PNG will not be considered optimal.
+ *
+ * @param layer
+ *     The layer to draw to.
+ *
+ * @param seed
+ *     An arbitrary value that determines the pixels drawn.
+ */
+static void test_refine_draw(guac_display_layer* layer, unsigned int seed) {
+
+    guac_display_layer_raw_context* context = guac_display_layer_open_raw(layer);
+
+    for (int y = 0; y < TEST_REFINE_SIZE; y++) {
+        uint32_t* row = (uint32_t*) (context->buffer + y * context->stride);
+        for (int x = 0; x < TEST_REFINE_SIZE; x++) {
+            seed = seed * 1103515245 + 12345;
+            row[x] = 0xFF000000 | (seed >> 8);
+        }
+    }
+
+    guac_rect_init(&context->dirty, 0, 0, TEST_REFINE_SIZE, TEST_REFINE_SIZE);
+    context->hint_from = NULL;
+
+    guac_display_layer_close_raw(layer, context);
+
+}
+
+/**
+ * Waits for the worker threads of the given display to finish sending all
+ * frames, including any refinements of those frames.
+ *
+ * @param display
+ *     The display to wait for.
+ */
+static void test_refine_wait(guac_display* display) {
+
+    for (;;) {
+
+        guac_fifo_lock(&display->ops);
+        int idle = !(display->ops.state.value & GUAC_FIFO_STATE_NONEMPTY)
+            && !display->active_workers && !display->refining
+            && !display->frame_deferred;
+        guac_fifo_unlock(&display->ops);
+
+        if (idle)
+            return;
+
+        usleep(1000);
+
+    }
+
+}
+
+/**
+ * Test which verifies that large, rapidly-changing updates are sent as
+ * lossy previews, and that each preview is followed, after the end of the
+ * frame, by a lossless refinement of exactly the same region.
+ */
+void test_display__refine_lossless(void) {
+
+    guac_client* client = guac_client_alloc();
+    test_capture* capture = test_capture_alloc(client);
+    guac_display* display = guac_display_alloc(client);
+
+    guac_display_layer* layer = guac_display_default_layer(display);
+    guac_display_layer_resize(layer, TEST_REFINE_SIZE, TEST_REFINE_SIZE);
+
+    /* Previews are only sent for regions updated frequently, and thus are
+     * not sent for the initial frame */
+    test_refine_draw(layer, 1);
+    guac_display_end_frame(display);
+    test_refine_wait(display);
+
+    size_t offset = capture->length;
+
+    test_refine_draw(layer, 2);
+    guac_display_end_frame(display);
+    test_refine_wait(display);
+
+    test_image images[TEST_REFINE_MAX_IMAGES];
+    int count = test_capture_parse_images(capture, offset, images);
+
+    int previews = 0;
+    for (int i = 0; i < count; i++) {
+
+        /* Every image sent after the frame ended is a refinement */
+        if (images[i].syncs > 0) {
+            CU_ASSERT_STRING_EQUAL(images[i].mimetype, "image/png");
+            continue;
+        }
+
+        if (strcmp(images[i].mimetype, "image/jpeg") != 0)
+            continue;
+
+        /* Every preview is refined losslessly */
+        int refined = 0;
+        for (int j = i + 1; j < count; j++) {
+            if (images[j].syncs > 0
+                    && images[j].layer == images[i].layer
+                    && images[j].x == images[i].x
+                    && images[j].y == images[i].y
+                    && strcmp(images[j].mimetype, "image/png") == 0)
+                refined = 1;
+        }
+
+        CU_ASSERT_TRUE(refined);
+        previews++;
+
+    }
+
+    CU_ASSERT_TRUE(previews > 0);
+
+    /* All refinements have now been sent */
+    CU_ASSERT_EQUAL(display->refinement_count, 0);
+
+    guac_display_free(display);
+    guac_client_free(client);
+
+}
+
+/**
+ * Test which verifies that refinements of previews sent to a layer are
+ * discarded when that layer is freed, while refinements of previews sent to
+ * other layers are retained.
+ */
+void test_display__refine_forget(void) {
+
+    guac_client* client = guac_client_alloc();
+    test_capture_alloc(client);
+    guac_display* display = guac_display_alloc(client);
+
+    guac_display_layer* freed = guac_display_alloc_layer(display, 1);
+    guac_display_layer* kept = guac_display_alloc_layer(display, 1);
+
+    /* Queue refinements that alternate between both layers, as would be
+     * queued by the worker threads while sending previews */
+    guac_fifo_lock(&display->ops);
+
+    guac_display_plan_operation* refinements = guac_display_arena_reserve(
+            &display->refinements, 4, sizeof(guac_display_plan_operation));
+
+    for (int i = 0; i < 4; i++) {
+        refinements[i] = (guac_display_plan_operation) {
+            .layer = (i % 2) ? kept : freed,
+            .type = GUAC_DISPLAY_PLAN_OPERATION_REFINE
+        };
+        guac_rect_init(&refinements[i].dest, i * 64, 0, 64, 64);
+    }
+
+    display->refinement_count = 4;
+    guac_fifo_unlock(&display->ops);
+
+    guac_display_free_layer(freed);
+
+    /* Only the refinements of the remaining layer are kept, in order */
+    guac_fifo_lock(&display->ops);
+    refinements = display->refinements.data;
+    CU_ASSERT_EQUAL(display->refinement_count, 2);
+    CU_ASSERT_PTR_EQUAL(refinements[0].layer, kept);
+    CU_ASSERT_EQUAL(refinements[0].dest.left, 64);
+    CU_ASSERT_PTR_EQUAL(refinements[1].layer, kept);
+    CU_ASSERT_EQUAL(refinements[1].dest.left, 192);
+    display->refinement_count = 0;
+    guac_fifo_unlock(&display->ops);
+
+    guac_display_free(display);
+    guac_client_free(client);
+
+}
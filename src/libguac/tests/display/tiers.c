@@ -0,0 +1,230 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-priv.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/display.h>
+#include <guacamole/fifo.h>
+#include <guacamole/socket.h>
+#include <guacamole/user.h>
+
+#include <unistd.h>
+
+/**
+ * Callback for guac_client_foreach_user() which counts each user, storing the
+ * count within the provided int.
+ *
+ * @param user
+ *     The user being counted.
+ *
+ * @param data
+ *     A pointer to the int to increment.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* test_count_user(guac_user* user, void* data) {
+    (*((int*) data))++;
+    return NULL;
+}
+
+/**
+ * Allocates a new user and adds that user to the given client, waiting until
+ * that user has been promoted from pending and is connected.
+ *
+ * @param client
+ *     The client to add the user to.
+ *
+ * @return
+ *     The newly-allocated, connected user.
+ */
+static guac_user* test_join(guac_client* client) {
+
+    int expected = 1;
+    guac_client_foreach_user(client, test_count_user, &expected);
+
+    guac_user* user = guac_user_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(user);
+    user->client = client;
+    user->socket = guac_socket_alloc();
+    CU_ASSERT_EQUAL_FATAL(guac_client_add_user(client, user, 0, NULL), 0);
+
+    /* Users are promoted from pending asynchronously */
+    int connected = 0;
+    for (int attempt = 0; attempt < 1000 && connected != expected; attempt++) {
+        connected = 0;
+        guac_client_foreach_user(client, test_count_user, &connected);
+        if (connected != expected)
+            usleep(1000);
+    }
+
+    CU_ASSERT_EQUAL_FATAL(connected, expected);
+    return user;
+
+}
+
+/**
+ * Returns the tier that the given user currently receives lossy image data
+ * from, as determined by guac_display_tiers_filter().
+ *
+ * @param display
+ *     The display whose tiers should be checked.
+ *
+ * @param user
+ *     The user to check.
+ *
+ * @return
+ *     The tier of the given user, or -1 if the user is within no tier.
+ */
+static int test_tier_of(guac_display* display, guac_user* user) {
+
+    for (int tier = 0; tier < GUAC_DISPLAY_QUALITY_TIERS; tier++) {
+        guac_display_tier_filter filter = { .display = display, .tier = tier };
+        if (guac_display_tiers_filter(user, &filter))
+            return tier;
+    }
+
+    return -1;
+
+}
+
+/**
+ * Recalculates tier membership exactly as the end of a frame would, without
+ * committing the result.
+ *
+ * @param display
+ *     The display whose tiers should be recalculated.
+ */
+static void test_end_frame(guac_display* display) {
+    size_t frame_bytes[GUAC_DISPLAY_QUALITY_TIERS] = { 0 };
+    guac_display_tiers_end_frame(display, 0, frame_bytes);
+}
+
+/**
+ * Commits any pending changes in tier membership exactly as the next frame
+ * boundary would.
+ *
+ * @param display
+ *     The display whose tiers should be committed.
+ */
+static void test_commit(guac_display* display) {
+    size_t frame_bytes[GUAC_DISPLAY_QUALITY_TIERS];
+    guac_fifo_lock(&display->ops);
+    guac_display_tiers_commit(display, frame_bytes);
+    guac_fifo_unlock(&display->ops);
+}
+
+/**
+ * Verifies that users move to a worse tier as soon as they stop keeping up,
+ * move to a better tier only once they keep up by the hysteresis margin, and
+ * change tiers only when membership is committed. Users that join between
+ * commits must receive the highest-quality populated tier.
+ */
+void test_display__tiers(void) {
+
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    guac_display* display = guac_display_alloc(client);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(display);
+
+    guac_user* fast = test_join(client);
+    guac_user* slow = test_join(client);
+
+    /* Users begin within the best tier */
+    fast->processing_lag = 10;
+    slow->processing_lag = 10;
+    test_end_frame(display);
+    test_commit(display);
+
+    CU_ASSERT_EQUAL(test_tier_of(display, fast), 0);
+    CU_ASSERT_EQUAL(test_tier_of(display, slow), 0);
+
+    /* A user that falls behind moves down immediately, but only once the
+     * move is committed */
+    slow->processing_lag = 150;
+    test_end_frame(display);
+
+    CU_ASSERT_EQUAL(test_tier_of(display, slow), 0);
+
+    test_commit(display);
+
+    CU_ASSERT_EQUAL(test_tier_of(display, fast), 0);
+    CU_ASSERT_EQUAL(test_tier_of(display, slow), 2);
+
+    /* A user that only barely keeps up with a better tier does not move */
+    slow->processing_lag = 60;
+    test_end_frame(display);
+    test_commit(display);
+
+    CU_ASSERT_EQUAL(test_tier_of(display, slow), 2);
+
+    /* A user that keeps up with a better tier by the hysteresis margin moves
+     * up, but no further than that margin allows */
+    slow->processing_lag = 30;
+    test_end_frame(display);
+
+    CU_ASSERT_EQUAL(test_tier_of(display, slow), 2);
+
+    test_commit(display);
+
+    CU_ASSERT_EQUAL(test_tier_of(display, slow), 1);
+
+    slow->processing_lag = 15;
+    test_end_frame(display);
+    test_commit(display);
+
+    CU_ASSERT_EQUAL(test_tier_of(display, slow), 0);
+
+    /* With tier 0 empty, users that join between commits receive the best
+     * populated tier, not the best tier */
+    fast->processing_lag = 50;
+    slow->processing_lag = 50;
+    test_end_frame(display);
+    test_commit(display);
+
+    CU_ASSERT_EQUAL(test_tier_of(display, fast), 1);
+    CU_ASSERT_EQUAL(test_tier_of(display, slow), 1);
+    CU_ASSERT_EQUAL(display->tiers.default_tier, 1);
+
+    guac_user* late = test_join(client);
+
+    CU_ASSERT_EQUAL(test_tier_of(display, late), 1);
+
+    /* Once measured, a late joiner is classified like any other user */
+    late->processing_lag = 10;
+    test_end_frame(display);
+    test_commit(display);
+
+    CU_ASSERT_EQUAL(test_tier_of(display, late), 0);
+    CU_ASSERT_EQUAL(display->tiers.default_tier, 0);
+
+    guac_user* users[] = { fast, slow, late };
+
+    guac_display_free(display);
+    guac_client_free(client);
+
+    for (size_t i = 0; i < sizeof(users) / sizeof(users[0]); i++) {
+        guac_socket_free(users[i]->socket);
+        guac_user_free(users[i]);
+    }
+
+}
@@ -0,0 +1,276 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "display-priv.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/display.h>
+#include <guacamole/rect.h>
+#include <guacamole/rwlock.h>
+
+#include <stdint.h>
+
+/**
+ * The number of bytes in each row of the tiles used by these tests.
+ */
+#define TEST_TILE_STRIDE (GUAC_DISPLAY_CELL_SIZE * GUAC_DISPLAY_LAYER_RAW_BPP)
+
+/**
+ * The number of distinct tiles available to these tests.
+ */
+#define TEST_TILE_COUNT 5
+
+/**
+ * A 64x64 tile of image data.
+ */
+typedef uint32_t test_tile[GUAC_DISPLAY_CELL_SIZE * GUAC_DISPLAY_CELL_SIZE];
+
+/**
+ * Distinct tiles of image data, as initialized by test_tile_cache_alloc().
+ */
+static test_tile tiles[TEST_TILE_COUNT];
+
+/**
+ * The bounds of the cell that all tiles are stored from.
+ */
+static guac_rect cell;
+
+/**
+ * Allocates a new guac_display whose tile cache can hold exactly the given
+ * number of tiles, returning the display with the write locks of both its
+ * pending and last frames held. The returned display must be freed with
+ * test_tile_cache_free().
+ *
+ * @param client
+ *     The guac_client to allocate the display for.
+ *
+ * @param size
+ *     The size of the tile cache, in bytes.
+ *
+ * @return
+ *     A newly-allocated guac_display.
+ */
+static guac_display* test_tile_cache_alloc(guac_client* client, size_t size) {
+
+    /* Each tile differs from all others in only its last pixel, such that
+     * all tiles must be compared in full */
+    for (int i = 0; i < TEST_TILE_COUNT; i++) {
+        for (int j = 0; j < GUAC_DISPLAY_CELL_SIZE * GUAC_DISPLAY_CELL_SIZE; j++)
+            tiles[i][j] = 0xFF000000 | j;
+        tiles[i][GUAC_DISPLAY_CELL_SIZE * GUAC_DISPLAY_CELL_SIZE - 1] = i;
+    }
+
+    guac_rect_init(&cell, 0, 0, GUAC_DISPLAY_CELL_SIZE, GUAC_DISPLAY_CELL_SIZE);
+
+    guac_display* display = guac_display_alloc(client);
+    guac_display_set_tile_cache_size(display, size);
+
+    guac_rwlock_acquire_write_lock(&display->pending_frame.lock);
+    guac_rwlock_acquire_write_lock(&display->last_frame.lock);
+
+    return display;
+
+}
+
+/**
+ * Releases the locks acquired by test_tile_cache_alloc() and frees the given
+ * display.
+ *
+ * @param display
+ *     The display to free.
+ */
+static void test_tile_cache_free(guac_display* display) {
+    guac_rwlock_release_lock(&display->last_frame.lock);
+    guac_rwlock_release_lock(&display->pending_frame.lock);
+    guac_display_free(display);
+}
+
+/**
+ * Stores the given tile within the tile cache of the given display, using
+ * the index of that tile as its hash.
+ *
+ * @param display
+ *     The display whose tile cache should receive the tile.
+ *
+ * @param tile
+ *     The index of the tile to store.
+ *
+ * @return
+ *     The slot that the tile was stored within, or -1 if the tile could not
+ *     be stored.
+ */
+static int store(guac_display* display, int tile) {
+    return LFW_guac_display_tile_cache_store(&display->tile_cache,
+            guac_display_default_layer(display), &cell, tile,
+            (const unsigned char*) tiles[tile], TEST_TILE_STRIDE);
+}
+
+/**
+ * Searches the tile cache of the given display for the given tile, using the
+ * given hash.
+ *
+ * @param display
+ *     The display whose tile cache should be searched.
+ *
+ * @param tile
+ *     The index of the tile to search for.
+ *
+ * @param hash
+ *     The hash to search for.
+ *
+ * @return
+ *     The slot containing the tile, or -1 if the tile was not found.
+ */
+static int lookup(guac_display* display, int tile, uint64_t hash) {
+    int pending;
+    return LFW_guac_display_tile_cache_lookup(&display->tile_cache, hash,
+            (const unsigned char*) tiles[tile], TEST_TILE_STRIDE, &pending);
+}
+
+/**
+ * Test which verifies that the least recently used tile is evicted when a new
+ * tile is stored within a full cache, where using a tile counts as recent
+ * use.
+ */
+void test_display__tile_cache_lru(void) {
+
+    guac_client* client = guac_client_alloc();
+    guac_display* display = test_tile_cache_alloc(client,
+            3 * GUAC_DISPLAY_TILE_CACHE_TILE_SIZE);
+
+    guac_display_tile_cache* cache = &display->tile_cache;
+
+    CU_ASSERT_TRUE_FATAL(LFW_guac_display_tile_cache_begin_frame(display));
+    for (int i = 0; i < 3; i++)
+        CU_ASSERT_NOT_EQUAL(store(display, i), -1);
+
+    /* Using tile 0 makes tile 1 the least recently used */
+    CU_ASSERT_TRUE(LFW_guac_display_tile_cache_begin_frame(display));
+    CU_ASSERT_NOT_EQUAL(lookup(display, 0, 0), -1);
+
+    CU_ASSERT_TRUE(LFW_guac_display_tile_cache_begin_frame(display));
+    CU_ASSERT_NOT_EQUAL(store(display, 3), -1);
+    CU_ASSERT_EQUAL(cache->evictions, 1);
+
+    CU_ASSERT_TRUE(LFW_guac_display_tile_cache_begin_frame(display));
+    CU_ASSERT_EQUAL(lookup(display, 1, 1), -1);
+    CU_ASSERT_NOT_EQUAL(lookup(display, 0, 0), -1);
+    CU_ASSERT_NOT_EQUAL(lookup(display, 2, 2), -1);
+    CU_ASSERT_NOT_EQUAL(lookup(display, 3, 3), -1);
+
+    CU_ASSERT_EQUAL(cache->hits, 4);
+    CU_ASSERT_EQUAL(cache->misses, 1);
+    CU_ASSERT_EQUAL(cache->stores_total, 4);
+
+    test_tile_cache_free(display);
+    guac_client_free(client);
+
+}
+
+/**
+ * Test which verifies that tiles that merely share the same hash are never
+ * treated as identical, and that tiles stored by the current frame are not
+ * used until that frame has been sent.
+ */
+void test_display__tile_cache_collision(void) {
+
+    guac_client* client = guac_client_alloc();
+    guac_display* display = test_tile_cache_alloc(client,
+            3 * GUAC_DISPLAY_TILE_CACHE_TILE_SIZE);
+
+    guac_display_tile_cache* cache = &display->tile_cache;
+
+    CU_ASSERT_TRUE_FATAL(LFW_guac_display_tile_cache_begin_frame(display));
+    int slot = store(display, 0);
+    CU_ASSERT_NOT_EQUAL(slot, -1);
+
+    /* The stored tile is pending until the next frame */
+    int pending;
+    CU_ASSERT_EQUAL(LFW_guac_display_tile_cache_lookup(cache, 0,
+                (const unsigned char*) tiles[0], TEST_TILE_STRIDE, &pending), -1);
+    CU_ASSERT_TRUE(pending);
+
+    CU_ASSERT_TRUE(LFW_guac_display_tile_cache_begin_frame(display));
+
+    /* A different tile with the same hash is not a match */
+    CU_ASSERT_EQUAL(LFW_guac_display_tile_cache_lookup(cache, 0,
+                (const unsigned char*) tiles[1], TEST_TILE_STRIDE, &pending), -1);
+    CU_ASSERT_FALSE(pending);
+
+    /* The same tile with a different hash cannot be found */
+    CU_ASSERT_EQUAL(lookup(display, 0, 1), -1);
+
+    /* The same tile with the same hash is a match */
+    CU_ASSERT_EQUAL(lookup(display, 0, 0), slot);
+
+    CU_ASSERT_EQUAL(cache->hits, 1);
+    CU_ASSERT_EQUAL(cache->misses, 3);
+
+    test_tile_cache_free(display);
+    guac_client_free(client);
+
+}
+
+/**
+ * Test which verifies that the capacity of the tile cache is derived from the
+ * number of bytes allowed, that tiles used by the current frame are never
+ * evicted, and that a size of zero disables the cache.
+ */
+void test_display__tile_cache_budget(void) {
+
+    guac_client* client = guac_client_alloc();
+
+    /* Partial tiles do not count toward capacity */
+    guac_display* display = test_tile_cache_alloc(client,
+            2 * GUAC_DISPLAY_TILE_CACHE_TILE_SIZE + GUAC_DISPLAY_TILE_CACHE_TILE_SIZE / 2);
+
+    guac_display_tile_cache* cache = &display->tile_cache;
+    CU_ASSERT_EQUAL(cache->capacity, 2);
+
+    CU_ASSERT_TRUE_FATAL(LFW_guac_display_tile_cache_begin_frame(display));
+    CU_ASSERT_NOT_EQUAL(store(display, 0), -1);
+    CU_ASSERT_NOT_EQUAL(store(display, 1), -1);
+
+    /* All slots are used by the current frame */
+    CU_ASSERT_EQUAL(store(display, 2), -1);
+    CU_ASSERT_EQUAL(cache->evictions, 0);
+
+    /* Each further tile evicts exactly one older tile */
+    for (int i = 2; i < TEST_TILE_COUNT; i++) {
+        CU_ASSERT_TRUE(LFW_guac_display_tile_cache_begin_frame(display));
+        CU_ASSERT_NOT_EQUAL(store(display, i), -1);
+        CU_ASSERT_EQUAL(cache->evictions, i - 1);
+    }
+
+    test_tile_cache_free(display);
+
+    /* The cache can be disabled entirely */
+    display = test_tile_cache_alloc(client, 0);
+    CU_ASSERT_FALSE(LFW_guac_display_tile_cache_begin_frame(display));
+    test_tile_cache_free(display);
+
+    /* The cache cannot exceed its maximum size */
+    display = test_tile_cache_alloc(client, SIZE_MAX);
+    CU_ASSERT_EQUAL(display->tile_cache.capacity, GUAC_DISPLAY_TILE_CACHE_MAX_TILES);
+    test_tile_cache_free(display);
+
+    guac_client_free(client);
+
+}
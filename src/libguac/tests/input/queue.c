@@ -0,0 +1,293 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <CUnit/CUnit.h>
+#include <guacamole/input.h>
+#include <guacamole/timestamp.h>
+
+#include <stddef.h>
+
+/**
+ * The maximum number of events that may be recorded by test_recorder.
+ */
+#define TEST_MAX_EVENTS 16
+
+/**
+ * The maximum number of events permitted within each test queue.
+ */
+#define TEST_QUEUE_SIZE 8
+
+/**
+ * The maximum mouse motion rate used to verify rate limiting, in events per
+ * second. This corresponds to one motion event every 250 milliseconds.
+ */
+#define TEST_MOTION_RATE 4
+
+/**
+ * A record of the events handed out of a guac_input_queue.
+ */
+typedef struct test_recorder {
+
+    /**
+     * Copies of each event handled, in the order they were handled.
+     */
+    guac_input_event events[TEST_MAX_EVENTS];
+
+    /**
+     * The number of events handled.
+     */
+    int count;
+
+} test_recorder;
+
+/**
+ * guac_input_event_handler which records a copy of each event within the
+ * test_recorder provided as data.
+ *
+ * @param event
+ *     The event being handled.
+ *
+ * @param data
+ *     The test_recorder that should receive a copy of the event.
+ */
+static void test_record_event(const guac_input_event* event, void* data) {
+
+    test_recorder* recorder = (test_recorder*) data;
+
+    if (recorder->count < TEST_MAX_EVENTS)
+        recorder->events[recorder->count] = *event;
+
+    recorder->count++;
+
+}
+
+/**
+ * Adds a mouse event with the given details to the given queue.
+ *
+ * @param queue
+ *     The queue to add the event to.
+ *
+ * @param user
+ *     The user that should be recorded as the origin of the event.
+ *
+ * @param x
+ *     The X coordinate of the mouse pointer.
+ *
+ * @param y
+ *     The Y coordinate of the mouse pointer.
+ *
+ * @param mask
+ *     The button mask of the mouse event.
+ */
+static void test_enqueue_mouse(guac_input_queue* queue, guac_user* user,
+        int x, int y, int mask) {
+
+    guac_input_event event = {
+        .type = GUAC_INPUT_EVENT_MOUSE,
+        .user = user,
+        .details.mouse = { .x = x, .y = y, .mask = mask }
+    };
+
+    guac_input_queue_enqueue(queue, &event);
+
+}
+
+/**
+ * Adds a key event with the given details to the given queue.
+ *
+ * @param queue
+ *     The queue to add the event to.
+ *
+ * @param user
+ *     The user that should be recorded as the origin of the event.
+ *
+ * @param keysym
+ *     The keysym of the key event.
+ *
+ * @param pressed
+ *     Non-zero if the key is pressed, zero if released.
+ */
+static void test_enqueue_key(guac_input_queue* queue, guac_user* user,
+        int keysym, int pressed) {
+
+    guac_input_event event = {
+        .type = GUAC_INPUT_EVENT_KEY,
+        .user = user,
+        .details.key = { .keysym = keysym, .pressed = pressed }
+    };
+
+    guac_input_queue_enqueue(queue, &event);
+
+}
+
+/**
+ * Verifies that the given recorded event is a mouse event with the given
+ * details.
+ *
+ * @param event
+ *     The recorded event to verify.
+ *
+ * @param x
+ *     The expected X coordinate.
+ *
+ * @param y
+ *     The expected Y coordinate.
+ *
+ * @param mask
+ *     The expected button mask.
+ */
+static void test_assert_mouse(const guac_input_event* event,
+        int x, int y, int mask) {
+    CU_ASSERT_EQUAL(event->type, GUAC_INPUT_EVENT_MOUSE);
+    CU_ASSERT_EQUAL(event->details.mouse.x, x);
+    CU_ASSERT_EQUAL(event->details.mouse.y, y);
+    CU_ASSERT_EQUAL(event->details.mouse.mask, mask);
+}
+
+/**
+ * Verifies that consecutive mouse motion is merged into the latest location,
+ * while every change in button state is handled at the location it occurred.
+ */
+void test_input__coalesce() {
+
+    guac_user* user = (guac_user*) &user;
+    test_recorder recorder = { .count = 0 };
+
+    guac_input_queue* queue = guac_input_queue_alloc(TEST_QUEUE_SIZE, 0);
+
+    test_enqueue_mouse(queue, user, 0, 0, 0);
+
+    /* Motion between button changes is merged */
+    test_enqueue_mouse(queue, user, 1, 1, 0);
+    test_enqueue_mouse(queue, user, 2, 2, 0);
+    test_enqueue_mouse(queue, user, 3, 3, 0);
+
+    /* Press is not merged with the motion before it, and motion after the
+     * press does not move the press */
+    test_enqueue_mouse(queue, user, 3, 3, 1);
+    test_enqueue_mouse(queue, user, 4, 4, 1);
+    test_enqueue_mouse(queue, user, 5, 5, 1);
+
+    /* Release is likewise not merged */
+    test_enqueue_mouse(queue, user, 5, 5, 0);
+
+    CU_ASSERT_EQUAL(guac_input_queue_handle(queue, test_record_event,
+                &recorder), -1);
+
+    CU_ASSERT_EQUAL_FATAL(recorder.count, 5);
+    test_assert_mouse(&recorder.events[0], 0, 0, 0);
+    test_assert_mouse(&recorder.events[1], 3, 3, 0);
+    test_assert_mouse(&recorder.events[2], 3, 3, 1);
+    test_assert_mouse(&recorder.events[3], 5, 5, 1);
+    test_assert_mouse(&recorder.events[4], 5, 5, 0);
+
+    guac_input_queue_free(queue);
+
+}
+
+/**
+ * Verifies that key events are never merged and that mouse motion is never
+ * merged across a key event or across events from a different user.
+ */
+void test_input__order() {
+
+    guac_user* user_a = (guac_user*) &user_a;
+    guac_user* user_b = (guac_user*) &user_b;
+    test_recorder recorder = { .count = 0 };
+
+    guac_input_queue* queue = guac_input_queue_alloc(TEST_QUEUE_SIZE, 0);
+
+    test_enqueue_mouse(queue, user_a, 0, 0, 0);
+    test_enqueue_mouse(queue, user_a, 1, 1, 0);
+    test_enqueue_key(queue, user_a, 'a', 1);
+    test_enqueue_key(queue, user_a, 'a', 1);
+    test_enqueue_mouse(queue, user_a, 2, 2, 0);
+    test_enqueue_mouse(queue, user_b, 7, 7, 0);
+    test_enqueue_mouse(queue, user_a, 3, 3, 0);
+    test_enqueue_key(queue, user_a, 'a', 0);
+
+    guac_input_queue_flush(queue, test_record_event, &recorder);
+
+    CU_ASSERT_EQUAL_FATAL(recorder.count, 8);
+    test_assert_mouse(&recorder.events[0], 0, 0, 0);
+    test_assert_mouse(&recorder.events[1], 1, 1, 0);
+    CU_ASSERT_EQUAL(recorder.events[2].type, GUAC_INPUT_EVENT_KEY);
+    CU_ASSERT_EQUAL(recorder.events[3].type, GUAC_INPUT_EVENT_KEY);
+    test_assert_mouse(&recorder.events[4], 2, 2, 0);
+    CU_ASSERT_PTR_EQUAL(recorder.events[5].user, user_b);
+    CU_ASSERT_PTR_EQUAL(recorder.events[6].user, user_a);
+    CU_ASSERT_EQUAL(recorder.events[7].details.key.pressed, 0);
+
+    guac_input_queue_free(queue);
+
+}
+
+/**
+ * Verifies that mouse motion exceeding the maximum motion rate is held back
+ * and merged until the rate permits, that other events are never held back,
+ * and that flushing the queue ignores the rate.
+ */
+void test_input__rate() {
+
+    guac_user* user = (guac_user*) &user;
+    test_recorder recorder = { .count = 0 };
+
+    guac_input_queue* queue = guac_input_queue_alloc(TEST_QUEUE_SIZE,
+            TEST_MOTION_RATE);
+
+    /* The first mouse event is handled immediately */
+    test_enqueue_mouse(queue, user, 0, 0, 0);
+    CU_ASSERT_EQUAL(guac_input_queue_handle(queue, test_record_event,
+                &recorder), -1);
+    CU_ASSERT_EQUAL(recorder.count, 1);
+
+    /* Motion immediately afterwards is held back, absorbing further motion */
+    test_enqueue_mouse(queue, user, 1, 1, 0);
+    int wait = guac_input_queue_handle(queue, test_record_event, &recorder);
+    CU_ASSERT(wait > 0 && wait <= 1000 / TEST_MOTION_RATE);
+    CU_ASSERT_EQUAL(recorder.count, 1);
+
+    test_enqueue_mouse(queue, user, 2, 2, 0);
+
+    /* The held motion is handled once the rate permits */
+    guac_timestamp_msleep(1000 / TEST_MOTION_RATE);
+    CU_ASSERT_EQUAL(guac_input_queue_handle(queue, test_record_event,
+                &recorder), -1);
+    CU_ASSERT_EQUAL_FATAL(recorder.count, 2);
+    test_assert_mouse(&recorder.events[1], 2, 2, 0);
+
+    /* Motion followed by other events is not held back */
+    test_enqueue_mouse(queue, user, 3, 3, 0);
+    test_enqueue_key(queue, user, 'a', 1);
+    CU_ASSERT_EQUAL(guac_input_queue_handle(queue, test_record_event,
+                &recorder), -1);
+    CU_ASSERT_EQUAL_FATAL(recorder.count, 4);
+    test_assert_mouse(&recorder.events[2], 3, 3, 0);
+
+    /* Flushing ignores the rate entirely */
+    test_enqueue_mouse(queue, user, 4, 4, 0);
+    guac_input_queue_flush(queue, test_record_event, &recorder);
+    CU_ASSERT_EQUAL_FATAL(recorder.count, 5);
+    test_assert_mouse(&recorder.events[4], 4, 4, 0);
+
+    guac_input_queue_free(queue);
+
+}
+
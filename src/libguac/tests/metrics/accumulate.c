@@ -0,0 +1,133 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/metrics.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * The number of threads that concurrently record metrics.
+ */
+#define TEST_THREADS 16
+
+/**
+ * The number of values recorded by each thread.
+ */
+#define TEST_ITERATIONS 1000
+
+/**
+ * Thread which repeatedly increments GUAC_METRICS_FRAMES and observes the
+ * values 1 through TEST_ITERATIONS within GUAC_METRICS_FRAME_PLAN_TIME.
+ *
+ * @param data
+ *     Unused.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* record_thread(void* data) {
+
+    for (int i = 1; i <= TEST_ITERATIONS; i++) {
+        guac_metrics_count(GUAC_METRICS_FRAMES, 1);
+        guac_metrics_observe(GUAC_METRICS_FRAME_PLAN_TIME, i);
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Verifies that nothing is recorded while no guac_metrics structure is
+ * attached.
+ */
+void test_metrics__detached(void) {
+
+    guac_metrics metrics;
+    guac_metrics_init(&metrics);
+
+    guac_metrics_attach(NULL);
+    CU_ASSERT_FALSE(guac_metrics_enabled());
+
+    guac_metrics_count(GUAC_METRICS_FRAMES, 1);
+    guac_metrics_observe(GUAC_METRICS_FRAME_PLAN_TIME, 1);
+    CU_ASSERT_EQUAL(guac_metrics_user_add("test"), -1);
+
+    guac_metrics_summary summary;
+    memset(&summary, 0, sizeof(summary));
+    guac_metrics_accumulate(&summary, &metrics);
+
+    CU_ASSERT_EQUAL(summary.counters[GUAC_METRICS_FRAMES], 0);
+    CU_ASSERT_EQUAL(summary.histograms[GUAC_METRICS_FRAME_PLAN_TIME].count, 0);
+
+}
+
+/**
+ * Verifies that values recorded concurrently by many threads are all
+ * reflected once the shards of a guac_metrics structure are accumulated,
+ * and that histogram buckets are assigned by their power-of-two upper bound.
+ */
+void test_metrics__accumulate(void) {
+
+    guac_metrics metrics;
+    guac_metrics_init(&metrics);
+    guac_metrics_attach(&metrics);
+    CU_ASSERT_TRUE(guac_metrics_enabled());
+
+    pthread_t threads[TEST_THREADS];
+    for (int i = 0; i < TEST_THREADS; i++)
+        CU_ASSERT_EQUAL_FATAL(pthread_create(&threads[i], NULL, record_thread, NULL), 0);
+
+    for (int i = 0; i < TEST_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    guac_metrics_attach(NULL);
+
+    guac_metrics_summary summary;
+    memset(&summary, 0, sizeof(summary));
+    guac_metrics_accumulate(&summary, &metrics);
+
+    CU_ASSERT_EQUAL(summary.counters[GUAC_METRICS_FRAMES],
+            TEST_THREADS * TEST_ITERATIONS);
+
+    guac_metrics_distribution* plan_time =
+        &summary.histograms[GUAC_METRICS_FRAME_PLAN_TIME];
+
+    CU_ASSERT_EQUAL(plan_time->count, TEST_THREADS * TEST_ITERATIONS);
+    CU_ASSERT_EQUAL(plan_time->sum,
+            (uint64_t) TEST_THREADS * TEST_ITERATIONS * (TEST_ITERATIONS + 1) / 2);
+
+    /* Each bucket N counts values V where 2^(N-1) < V <= 2^N */
+    CU_ASSERT_EQUAL(plan_time->buckets[0], TEST_THREADS);
+    CU_ASSERT_EQUAL(plan_time->buckets[1], TEST_THREADS);
+    CU_ASSERT_EQUAL(plan_time->buckets[2], TEST_THREADS * 2);
+    CU_ASSERT_EQUAL(plan_time->buckets[3], TEST_THREADS * 4);
+    CU_ASSERT_EQUAL(plan_time->buckets[10], TEST_THREADS * (1000 - 512));
+    CU_ASSERT_EQUAL(plan_time->buckets[11], 0);
+
+    CU_ASSERT_EQUAL(guac_metrics_bucket_bound(0), 1);
+    CU_ASSERT_EQUAL(guac_metrics_bucket_bound(10), 1024);
+
+    /* Accumulating again must add to the existing summary */
+    guac_metrics_accumulate(&summary, &metrics);
+    CU_ASSERT_EQUAL(summary.counters[GUAC_METRICS_FRAMES],
+            2 * TEST_THREADS * TEST_ITERATIONS);
+
+}
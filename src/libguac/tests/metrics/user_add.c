@@ -0,0 +1,75 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/metrics.h>
+#include <string.h>
+
+/**
+ * Verifies that entries within the user table of a guac_metrics structure
+ * are claimed, credited, and released as expected, and that data sent by
+ * each user is also reflected in the aggregate metrics.
+ */
+void test_metrics__user_add(void) {
+
+    guac_metrics metrics;
+    guac_metrics_init(&metrics);
+    guac_metrics_attach(&metrics);
+
+    int first = guac_metrics_user_add("first");
+    int second = guac_metrics_user_add("second");
+
+    CU_ASSERT_NOT_EQUAL_FATAL(first, -1);
+    CU_ASSERT_NOT_EQUAL_FATAL(second, -1);
+    CU_ASSERT_NOT_EQUAL(first, second);
+
+    CU_ASSERT_EQUAL(metrics.users[first].state, GUAC_METRICS_USER_ACTIVE);
+    CU_ASSERT_STRING_EQUAL(metrics.users[first].user_id, "first");
+    CU_ASSERT_STRING_EQUAL(metrics.users[second].user_id, "second");
+
+    guac_metrics_user_sent(first, 100);
+    guac_metrics_user_sent(second, 20);
+    guac_metrics_user_sent(-1, 3);
+
+    CU_ASSERT_EQUAL(metrics.users[first].bytes_sent, 100);
+    CU_ASSERT_EQUAL(metrics.users[second].bytes_sent, 20);
+
+    guac_metrics_summary summary;
+    memset(&summary, 0, sizeof(summary));
+    guac_metrics_accumulate(&summary, &metrics);
+    CU_ASSERT_EQUAL(summary.counters[GUAC_METRICS_BYTES_SENT], 123);
+
+    /* Released entries are reused, starting from a clean slate */
+    guac_metrics_user_remove(first);
+    CU_ASSERT_EQUAL(metrics.users[first].state, GUAC_METRICS_USER_FREE);
+
+    int third = guac_metrics_user_add("third");
+    CU_ASSERT_EQUAL(third, first);
+    CU_ASSERT_EQUAL(metrics.users[third].bytes_sent, 0);
+    CU_ASSERT_STRING_EQUAL(metrics.users[third].user_id, "third");
+
+    /* Users beyond the capacity of the table are tracked only in aggregate */
+    for (int i = 2; i < GUAC_METRICS_MAX_USERS; i++)
+        CU_ASSERT_NOT_EQUAL(guac_metrics_user_add("other"), -1);
+
+    CU_ASSERT_EQUAL(guac_metrics_user_add("overflow"), -1);
+
+    guac_metrics_attach(NULL);
+
+}
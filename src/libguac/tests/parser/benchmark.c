@@ -0,0 +1,236 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Microbenchmark for instruction parsing. This is not a unit test and is not
+ * run by "make check". It may be built with "make benchmarks" and run
+ * manually to compare the throughput of each parser kernel supported by the
+ * current processor, and of guac_parser_append() when parsing the mix of
+ * input events and stream data typically received from a user.
+ */
+
+#include "parser-kernels.h"
+#include "guacamole/mem.h"
+#include "guacamole/parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * The total number of bytes of data scanned or parsed by each benchmark.
+ */
+#define BENCH_TOTAL_LENGTH (256 * 1024 * 1024)
+
+/**
+ * The size of each block of data scanned or parsed at once.
+ */
+#define BENCH_BLOCK_LENGTH 16384
+
+/**
+ * The number of bytes of base64 data within each blob instruction of the
+ * generated input traffic.
+ */
+#define BENCH_BLOB_LENGTH 1024
+
+/**
+ * Returns the current value of a monotonic clock, in seconds.
+ *
+ * @return
+ *     The current value of a monotonic clock, in seconds.
+ */
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+/**
+ * Prints the throughput of a benchmark that processed BENCH_TOTAL_LENGTH
+ * bytes of data within the given number of seconds.
+ *
+ * @param name
+ *     The name of the benchmark.
+ *
+ * @param elapsed
+ *     The total number of seconds taken.
+ */
+static void bench_report(const char* name, double elapsed) {
+    printf("%-40s %10.1f MB/s\n", name,
+            BENCH_TOTAL_LENGTH / elapsed / 1000000.0);
+}
+
+/**
+ * Fills the given buffer with complete instructions resembling the input
+ * received from a typical user: mouse and key events, frame
+ * acknowledgements, and blobs of uploaded stream data.
+ *
+ * @param buffer
+ *     The buffer to fill.
+ *
+ * @param size
+ *     The size of the buffer, in bytes.
+ *
+ * @return
+ *     The number of bytes of the buffer occupied by complete instructions.
+ */
+static size_t bench_generate_input(char* buffer, size_t size) {
+
+    static const char characters[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    char blob[BENCH_BLOB_LENGTH + 1];
+    for (int i = 0; i < BENCH_BLOB_LENGTH; i++)
+        blob[i] = characters[rand() % 64];
+    blob[BENCH_BLOB_LENGTH] = '\0';
+
+    size_t length = 0;
+    for (int i = 0; ; i++) {
+
+        char instruction[BENCH_BLOB_LENGTH + 64];
+        int instruction_length;
+
+        switch (i % 8) {
+
+            case 0:
+                instruction_length = snprintf(instruction, sizeof(instruction),
+                        "4.sync,8.%08i;", i);
+                break;
+
+            case 1:
+            case 2:
+                instruction_length = snprintf(instruction, sizeof(instruction),
+                        "3.key,5.%05i,1.%i;", 65000 + i % 500, i % 2);
+                break;
+
+            case 3:
+                instruction_length = snprintf(instruction, sizeof(instruction),
+                        "4.blob,1.1,%i.%s;", BENCH_BLOB_LENGTH, blob);
+                break;
+
+            default:
+                instruction_length = snprintf(instruction, sizeof(instruction),
+                        "5.mouse,3.%03i,3.%03i,1.0,13.1700000000000;",
+                        i % 1000, (i * 7) % 1000);
+                break;
+
+        }
+
+        if (length + instruction_length > size)
+            return length;
+
+        memcpy(buffer + length, instruction, instruction_length);
+        length += instruction_length;
+
+    }
+
+}
+
+/**
+ * Prepares the given parser to parse a new instruction, as is done
+ * internally by guac_parser_read() after each complete instruction.
+ *
+ * @param parser
+ *     The parser to reset.
+ */
+static void bench_parser_reset(guac_parser* parser) {
+    parser->opcode = NULL;
+    parser->argc = 0;
+    parser->state = GUAC_PARSE_LENGTH;
+    parser->__elementc = 0;
+    parser->__element_length = 0;
+}
+
+int main(void) {
+
+    unsigned char* data = guac_mem_alloc(BENCH_BLOCK_LENGTH);
+    for (int i = 0; i < BENCH_BLOCK_LENGTH; i++)
+        data[i] = 0x20 + rand() % 0x5F;
+
+    volatile size_t sink = 0;
+
+    /* Raw scanning throughput of each kernel */
+    for (const guac_parser_kernel* const* current = guac_parser_kernels_all;
+            *current != NULL; current++) {
+
+        const guac_parser_kernel* kernel = *current;
+        if (!kernel->supported()) {
+            printf("%-8s (not supported by this processor)\n", kernel->name);
+            continue;
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "span_ascii (%s)", kernel->name);
+
+        double start = bench_now();
+        for (size_t done = 0; done < BENCH_TOTAL_LENGTH; done += BENCH_BLOCK_LENGTH)
+            sink += kernel->span_ascii(data, BENCH_BLOCK_LENGTH);
+        bench_report(name, bench_now() - start);
+
+    }
+
+    printf("(guac_parser uses \"%s\")\n", guac_parser_kernel_select()->name);
+
+    /* Parsing of typical input, restoring the block before each pass as
+     * parsing overwrites element terminators */
+    char* input = guac_mem_alloc(BENCH_BLOCK_LENGTH);
+    char* buffer = guac_mem_alloc(BENCH_BLOCK_LENGTH);
+    size_t input_length = bench_generate_input(input, BENCH_BLOCK_LENGTH);
+
+    guac_parser* parser = guac_parser_alloc();
+    size_t instructions = 0;
+
+    double start = bench_now();
+    for (size_t done = 0; done < BENCH_TOTAL_LENGTH; done += input_length) {
+
+        memcpy(buffer, input, input_length);
+
+        char* current = buffer;
+        int remaining = input_length;
+        while (remaining > 0) {
+
+            bench_parser_reset(parser);
+            int parsed = guac_parser_append(parser, current, remaining);
+            if (parser->state != GUAC_PARSE_COMPLETE) {
+                fprintf(stderr, "Generated input could not be parsed.\n");
+                return 1;
+            }
+
+            current += parsed;
+            remaining -= parsed;
+            instructions++;
+
+        }
+
+    }
+
+    double elapsed = bench_now() - start;
+    bench_report("guac_parser_append (mixed input)", elapsed);
+    printf("%-40s %10.1f M/s\n", "instructions parsed",
+            instructions / elapsed / 1000000.0);
+
+    guac_parser_free(parser);
+    guac_mem_free(buffer);
+    guac_mem_free(input);
+    guac_mem_free(data);
+
+    return 0;
+
+}
@@ -0,0 +1,78 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "parser-kernels.h"
+
+#include <CUnit/CUnit.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The number of bytes scanned in each test case. This is intentionally not a
+ * multiple of any vector width so that the tail handling of each kernel is
+ * exercised.
+ */
+#define TEST_PARSER_KERNEL_LENGTH 203
+
+/**
+ * Test which verifies that every supported parser kernel locates the end of
+ * each run of ASCII identically to the scalar kernel, and that the scalar
+ * kernel itself produces correct results.
+ */
+void test_parser__kernels(void) {
+
+    unsigned char data[TEST_PARSER_KERNEL_LENGTH];
+
+    /* Sanity check for scalar kernel */
+    CU_ASSERT_EQUAL(guac_parser_kernel_scalar.span_ascii(
+                (const unsigned char*) "", 0), 0);
+    CU_ASSERT_EQUAL(guac_parser_kernel_scalar.span_ascii(
+                (const unsigned char*) "abc", 3), 3);
+    CU_ASSERT_EQUAL(guac_parser_kernel_scalar.span_ascii(
+                (const unsigned char*) "ab\xc3\xa1", 4), 2);
+
+    for (const guac_parser_kernel* const* kernel = guac_parser_kernels_all;
+            *kernel != NULL; kernel++) {
+
+        if (!(*kernel)->supported())
+            continue;
+
+        /* Every possible position of a single non-ASCII byte, scanned from
+         * every possible alignment and for every possible length */
+        for (size_t position = 0; position <= TEST_PARSER_KERNEL_LENGTH; position++) {
+
+            for (int i = 0; i < TEST_PARSER_KERNEL_LENGTH; i++)
+                data[i] = rand() & 0x7F;
+
+            if (position < TEST_PARSER_KERNEL_LENGTH)
+                data[position] = 0x80 | rand();
+
+            for (size_t offset = 0; offset < 64; offset++) {
+                size_t length = TEST_PARSER_KERNEL_LENGTH - offset;
+                CU_ASSERT_EQUAL_FATAL((*kernel)->span_ascii(data + offset, length),
+                        guac_parser_kernel_scalar.span_ascii(data + offset, length));
+                CU_ASSERT_EQUAL_FATAL((*kernel)->span_ascii(data, offset),
+                        guac_parser_kernel_scalar.span_ascii(data, offset));
+            }
+
+        }
+
+    }
+
+}
@@ -0,0 +1,185 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/error.h>
+#include <guacamole/parser.h>
+#include <guacamole/socket.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * Test string which contains exactly four Unicode characters encoded in UTF-8.
+ * This particular test string uses several characters which encode to multiple
+ * bytes in UTF-8.
+ */
+#define UTF8_4 "\xe7\x8a\xac\xf0\x90\xac\x80z\xc3\xa1"
+
+/**
+ * Writes the given data to the given file descriptor using a single write(),
+ * such that the reader receives that data all at once. The given file
+ * descriptor is automatically closed as a result of calling this function.
+ *
+ * @param fd
+ *     The file descriptor to write to.
+ *
+ * @param data
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes of data to write. This must not exceed PIPE_BUF.
+ */
+static void write_all(int fd, const char* data, size_t length) {
+
+    /* Bail out immediately if write fails (test will fail in parent process
+     * due to failure to read) */
+    if (write(fd, data, length) != (ssize_t) length) {
+        close(fd);
+        return;
+    }
+
+    close(fd);
+
+}
+
+/**
+ * Forks a child process which writes the given data in its entirety to a new
+ * pipe, returning a guac_socket which reads from that pipe.
+ *
+ * @param data
+ *     The data that the child process should write.
+ *
+ * @param length
+ *     The number of bytes of data to write. This must not exceed PIPE_BUF.
+ *
+ * @return
+ *     A new guac_socket which reads the written data.
+ */
+static guac_socket* open_writer(const char* data, size_t length) {
+
+    int fd[2];
+
+    /* Create pipe */
+    CU_ASSERT_EQUAL_FATAL(pipe(fd), 0);
+
+    int read_fd = fd[0];
+    int write_fd = fd[1];
+
+    /* Fork into writer process (child) and reader process (parent) */
+    int childpid;
+    CU_ASSERT_NOT_EQUAL_FATAL((childpid = fork()), -1);
+
+    if (childpid == 0) {
+        close(read_fd);
+        write_all(write_fd, data, length);
+        exit(0);
+    }
+
+    close(write_fd);
+
+    guac_socket* socket = guac_socket_open(read_fd);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    return socket;
+
+}
+
+/**
+ * Tests that guac_parser_read_batch() returns every complete instruction
+ * received at once, leaving any trailing partial instruction to be completed
+ * by later reads, and that a malformed instruction following complete
+ * instructions is reported only after those instructions are returned.
+ */
+void test_parser__read_batch(void) {
+
+    char test_string[] = "4.test,6.a" UTF8_4 "b,5.12345;"
+                         "4.sync,3.123;"
+                         "5.mouse,2.10,2.20,1.1;"
+                         "3.key,5.65307,1.1";
+
+    guac_parser_instruction instructions[4];
+
+    /* All complete instructions should be returned in a single batch */
+    guac_socket* socket = open_writer(test_string, sizeof(test_string) - 1);
+    guac_parser* parser = guac_parser_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser);
+
+    CU_ASSERT_EQUAL_FATAL(guac_parser_read_batch(parser, socket, 1000000,
+                instructions, 4), 3);
+
+    CU_ASSERT_STRING_EQUAL(instructions[0].opcode, "test");
+    CU_ASSERT_EQUAL_FATAL(instructions[0].argc, 2);
+    CU_ASSERT_STRING_EQUAL(instructions[0].argv[0], "a" UTF8_4 "b");
+    CU_ASSERT_STRING_EQUAL(instructions[0].argv[1], "12345");
+
+    CU_ASSERT_STRING_EQUAL(instructions[1].opcode, "sync");
+    CU_ASSERT_EQUAL_FATAL(instructions[1].argc, 1);
+    CU_ASSERT_STRING_EQUAL(instructions[1].argv[0], "123");
+
+    CU_ASSERT_STRING_EQUAL(instructions[2].opcode, "mouse");
+    CU_ASSERT_EQUAL_FATAL(instructions[2].argc, 3);
+    CU_ASSERT_STRING_EQUAL(instructions[2].argv[0], "10");
+    CU_ASSERT_STRING_EQUAL(instructions[2].argv[1], "20");
+    CU_ASSERT_STRING_EQUAL(instructions[2].argv[2], "1");
+
+    /* The trailing partial instruction can never be completed */
+    CU_ASSERT_EQUAL(guac_parser_read_batch(parser, socket, 1000000,
+                instructions, 4), -1);
+    CU_ASSERT_EQUAL(guac_error, GUAC_STATUS_CLOSED);
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+
+    /* Batches should not exceed the requested number of instructions */
+    socket = open_writer(test_string, sizeof(test_string) - 1);
+    parser = guac_parser_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser);
+
+    CU_ASSERT_EQUAL_FATAL(guac_parser_read_batch(parser, socket, 1000000,
+                instructions, 2), 2);
+    CU_ASSERT_STRING_EQUAL(instructions[0].opcode, "test");
+    CU_ASSERT_STRING_EQUAL(instructions[1].opcode, "sync");
+
+    CU_ASSERT_EQUAL_FATAL(guac_parser_read_batch(parser, socket, 1000000,
+                instructions, 2), 1);
+    CU_ASSERT_STRING_EQUAL(instructions[0].opcode, "mouse");
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+
+    /* Malformed data should fail only the batch that begins with it */
+    char malformed[] = "4.sync,3.123;4.sync,3.456;x.invalid;";
+    socket = open_writer(malformed, sizeof(malformed) - 1);
+    parser = guac_parser_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser);
+
+    CU_ASSERT_EQUAL_FATAL(guac_parser_read_batch(parser, socket, 1000000,
+                instructions, 4), 2);
+    CU_ASSERT_STRING_EQUAL(instructions[0].argv[0], "123");
+    CU_ASSERT_STRING_EQUAL(instructions[1].argv[0], "456");
+
+    CU_ASSERT_EQUAL(guac_parser_read_batch(parser, socket, 1000000,
+                instructions, 4), -1);
+    CU_ASSERT_EQUAL(guac_error, GUAC_STATUS_PROTOCOL_ERROR);
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+
+}
@@ -0,0 +1,91 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <CUnit/CUnit.h>
+#include <guacamole/error.h>
+#include <guacamole/parser.h>
+#include <guacamole/socket.h>
+
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Writes the given string to the given file descriptor in its entirety.
+ *
+ * @param fd
+ *     The file descriptor to write to.
+ *
+ * @param str
+ *     The string to write.
+ */
+static void write_string(int fd, const char* str) {
+    size_t length = strlen(str);
+    CU_ASSERT_EQUAL_FATAL(write(fd, str, length), length);
+}
+
+/**
+ * Tests that guac_parser_read() retains any partial instruction received
+ * prior to timing out, such that a later call to guac_parser_read() completes
+ * that instruction once the remainder has been received.
+ */
+void test_parser__read_partial(void) {
+
+    int fd[2];
+    CU_ASSERT_EQUAL_FATAL(pipe(fd), 0);
+
+    guac_socket* socket = guac_socket_open(fd[0]);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    guac_parser* parser = guac_parser_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser);
+
+    /* Nothing at all received yet */
+    CU_ASSERT_NOT_EQUAL(guac_parser_read(parser, socket, 0), 0);
+    CU_ASSERT_EQUAL(guac_error, GUAC_STATUS_TIMEOUT);
+
+    /* Only part of the instruction received, ending mid-element */
+    write_string(fd[1], "6.select,3.r");
+    CU_ASSERT_NOT_EQUAL(guac_parser_read(parser, socket, 0), 0);
+    CU_ASSERT_EQUAL(guac_error, GUAC_STATUS_TIMEOUT);
+
+    /* Remainder of the instruction received, along with part of the next */
+    write_string(fd[1], "dp;4.size,4");
+    CU_ASSERT_EQUAL_FATAL(guac_parser_read(parser, socket, 0), 0);
+    CU_ASSERT_STRING_EQUAL(parser->opcode, "select");
+    CU_ASSERT_EQUAL_FATAL(parser->argc, 1);
+    CU_ASSERT_STRING_EQUAL(parser->argv[0], "rdp");
+
+    /* Next instruction cannot yet be completed */
+    CU_ASSERT_NOT_EQUAL(guac_parser_read(parser, socket, 0), 0);
+    CU_ASSERT_EQUAL(guac_error, GUAC_STATUS_TIMEOUT);
+
+    write_string(fd[1], ".1024,3.768;");
+    CU_ASSERT_EQUAL_FATAL(guac_parser_read(parser, socket, 0), 0);
+    CU_ASSERT_STRING_EQUAL(parser->opcode, "size");
+    CU_ASSERT_EQUAL_FATAL(parser->argc, 2);
+    CU_ASSERT_STRING_EQUAL(parser->argv[0], "1024");
+    CU_ASSERT_STRING_EQUAL(parser->argv[1], "768");
+
+    /* Nothing left over */
+    CU_ASSERT_EQUAL(guac_parser_length(parser), 0);
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+    close(fd[1]);
+
+}
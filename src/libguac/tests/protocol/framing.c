@@ -0,0 +1,328 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/parser.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+#include <guacamole/stream.h>
+#include <guacamole/user.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+/**
+ * The number of bytes of blob data sent in each direction. This is larger
+ * than a single blob instruction may contain, such that the data is split
+ * across multiple blobs, and is not a multiple of three, such that base64
+ * padding is required.
+ */
+#define TEST_FRAMING_DATA_LENGTH 10000
+
+/**
+ * The number of microseconds to wait for each instruction.
+ */
+#define TEST_FRAMING_TIMEOUT 1000000
+
+/**
+ * Arbitrary binary data containing every possible byte value, including the
+ * values of the characters that delimit elements and instructions.
+ */
+static unsigned char test_data[TEST_FRAMING_DATA_LENGTH];
+
+/**
+ * All blob data received by the server from the stand-in client.
+ */
+static unsigned char test_received[TEST_FRAMING_DATA_LENGTH];
+
+/**
+ * The number of bytes within test_received.
+ */
+static int test_received_length;
+
+/**
+ * Whether the stream opened by the stand-in client has been ended.
+ */
+static int test_received_end;
+
+/**
+ * Blob handler for the stream opened by the stand-in client, storing all
+ * received data within test_received.
+ */
+static int test_blob_handler(guac_user* user, guac_stream* stream,
+        void* data, int length) {
+
+    if (test_received_length + length > TEST_FRAMING_DATA_LENGTH)
+        return 1;
+
+    memcpy(test_received + test_received_length, data, length);
+    test_received_length += length;
+    return 0;
+
+}
+
+/**
+ * End handler for the stream opened by the stand-in client.
+ */
+static int test_end_handler(guac_user* user, guac_stream* stream) {
+    test_received_end = 1;
+    return 0;
+}
+
+/**
+ * File handler for the user connected to the stand-in client, receiving the
+ * stream that the stand-in client opens.
+ */
+static int test_file_handler(guac_user* user, guac_stream* stream,
+        char* mimetype, char* filename) {
+
+    stream->blob_handler = test_blob_handler;
+    stream->end_handler = test_end_handler;
+    return 0;
+
+}
+
+/**
+ * Join handler for the connection, which sends all of test_data to the
+ * joining user as a series of blobs.
+ */
+static int test_join_handler(guac_user* user, int argc, char** argv) {
+
+    user->file_handler = test_file_handler;
+
+    guac_stream* stream = guac_user_alloc_stream(user);
+    guac_protocol_send_file(user->socket, stream, "application/octet-stream",
+            "test");
+    guac_protocol_send_blobs(user->socket, stream, test_data,
+            TEST_FRAMING_DATA_LENGTH);
+    guac_protocol_send_end(user->socket, stream);
+    guac_socket_flush(user->socket);
+
+    return 0;
+
+}
+
+/**
+ * Thread which handles the connection of the given user, exactly as a
+ * connection would be handled within guacd.
+ *
+ * @param data
+ *     The guac_user whose connection should be handled.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* test_server_thread(void* data) {
+    guac_user* user = (guac_user*) data;
+    guac_user_handle_connection(user, TEST_FRAMING_TIMEOUT);
+    return NULL;
+}
+
+/**
+ * Reads instructions using the given parser until an instruction having the
+ * given opcode is read, failing the current test if no such instruction is
+ * read.
+ *
+ * @param parser
+ *     The parser to read instructions with.
+ *
+ * @param socket
+ *     The socket to read instructions from.
+ *
+ * @param opcode
+ *     The opcode of the instruction to read.
+ *
+ * @param instruction
+ *     The guac_parser_instruction to populate with the instruction read.
+ */
+static void test_read_until(guac_parser* parser, guac_socket* socket,
+        const char* opcode, guac_parser_instruction* instruction) {
+
+    do {
+        CU_ASSERT_EQUAL_FATAL(guac_parser_read_batch(parser, socket,
+                    TEST_FRAMING_TIMEOUT, instruction, 1), 1);
+    } while (strcmp(instruction->opcode, opcode) != 0);
+
+}
+
+/**
+ * Connects a stand-in client to a connection handled by
+ * guac_user_handle_connection(), negotiating the given framing, and verifies
+ * that blob data is received intact in both directions.
+ *
+ * @param framing
+ *     The framing that the stand-in client should request.
+ */
+static void test_round_trip(guac_protocol_framing framing) {
+
+    int fd[2];
+    CU_ASSERT_EQUAL_FATAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fd), 0);
+
+    test_received_length = 0;
+    test_received_end = 0;
+
+    /* Connection which accepts a single user via the usual handshake */
+    static const char* args[] = { NULL };
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+    client->args = args;
+    client->join_handler = test_join_handler;
+
+    guac_user* user = guac_user_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(user);
+    user->client = client;
+    user->owner = 1;
+    user->socket = guac_socket_open(fd[0]);
+
+    pthread_t server_thread;
+    CU_ASSERT_EQUAL_FATAL(pthread_create(&server_thread, NULL,
+                test_server_thread, user), 0);
+
+    /* Stand-in client */
+    guac_socket* socket = guac_socket_open(fd[1]);
+    guac_parser* parser = guac_parser_alloc();
+    guac_parser_instruction instruction;
+
+    test_read_until(parser, socket, "args", &instruction);
+    CU_ASSERT_STRING_EQUAL(instruction.argv[0], GUACAMOLE_PROTOCOL_VERSION);
+
+    if (framing == GUAC_PROTOCOL_FRAMING_BINARY)
+        guac_socket_write_string(socket, "7.framing,6.binary;");
+
+    guac_socket_write_string(socket, "7.connect,13." GUACAMOLE_PROTOCOL_VERSION ";");
+    guac_socket_flush(socket);
+
+    /* Binary framing must be confirmed before the handshake completes */
+    CU_ASSERT_EQUAL_FATAL(guac_parser_read_batch(parser, socket,
+                TEST_FRAMING_TIMEOUT, &instruction, 1), 1);
+
+    if (framing == GUAC_PROTOCOL_FRAMING_BINARY) {
+
+        CU_ASSERT_STRING_EQUAL_FATAL(instruction.opcode, "framing");
+        CU_ASSERT_EQUAL_FATAL(instruction.argc, 1);
+        CU_ASSERT_STRING_EQUAL(instruction.argv[0], "binary");
+
+        guac_parser_enable_binary_framing(parser);
+        guac_socket_enable_binary_framing(socket);
+
+        CU_ASSERT_EQUAL_FATAL(guac_parser_read_batch(parser, socket,
+                    TEST_FRAMING_TIMEOUT, &instruction, 1), 1);
+
+    }
+
+    CU_ASSERT_STRING_EQUAL_FATAL(instruction.opcode, "ready");
+
+    /* Verify data sent by the join handler, which must be framed as
+     * negotiated */
+    test_read_until(parser, socket, "file", &instruction);
+
+    int received = 0;
+    unsigned char* buffer = malloc(TEST_FRAMING_DATA_LENGTH);
+    for (;;) {
+
+        CU_ASSERT_EQUAL_FATAL(guac_parser_read_batch(parser, socket,
+                    TEST_FRAMING_TIMEOUT, &instruction, 1), 1);
+
+        if (strcmp(instruction.opcode, "end") == 0)
+            break;
+
+        CU_ASSERT_STRING_EQUAL_FATAL(instruction.opcode, "blob");
+        CU_ASSERT_EQUAL_FATAL(instruction.argc, 2);
+
+        int length;
+        if (framing == GUAC_PROTOCOL_FRAMING_BINARY) {
+            length = instruction.argl[1];
+            CU_ASSERT_FATAL(length >= 0);
+        }
+        else {
+            CU_ASSERT_EQUAL_FATAL(instruction.argl[1], -1);
+            length = guac_protocol_decode_base64(instruction.argv[1]);
+        }
+
+        CU_ASSERT_FATAL(received + length <= TEST_FRAMING_DATA_LENGTH);
+        memcpy(buffer + received, instruction.argv[1], length);
+        received += length;
+
+    }
+
+    CU_ASSERT_EQUAL(received, TEST_FRAMING_DATA_LENGTH);
+    CU_ASSERT_EQUAL(memcmp(buffer, test_data, received), 0);
+    free(buffer);
+
+    /* Upload the same data back to the server, framed as negotiated */
+    guac_stream stream = { .index = 0 };
+    guac_socket_write_string(socket, "4.file,1.0,24.application/octet-stream,4.test;");
+    guac_protocol_send_blobs(socket, &stream, test_data, TEST_FRAMING_DATA_LENGTH);
+    guac_socket_write_string(socket, "3.end,1.0;");
+    guac_socket_flush(socket);
+
+    /* Closing the stand-in client's half of the connection ends the
+     * connection once everything sent has been handled */
+    shutdown(fd[1], SHUT_WR);
+    pthread_join(server_thread, NULL);
+
+    CU_ASSERT_EQUAL(test_received_end, 1);
+    CU_ASSERT_EQUAL(test_received_length, TEST_FRAMING_DATA_LENGTH);
+    CU_ASSERT_EQUAL(memcmp(test_received, test_data, TEST_FRAMING_DATA_LENGTH), 0);
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+    guac_socket_free(user->socket);
+    guac_user_free(user);
+    guac_client_free(client);
+
+}
+
+/**
+ * Tests that blob data is exchanged intact with a client that negotiates
+ * binary framing during the handshake, and with a client that does not, and
+ * that elements using binary framing are rejected unless binary framing has
+ * been negotiated.
+ */
+void test_protocol__framing(void) {
+
+    for (int i = 0; i < TEST_FRAMING_DATA_LENGTH; i++)
+        test_data[i] = i * 7 + i / 256;
+
+    test_round_trip(GUAC_PROTOCOL_FRAMING_TEXT);
+    test_round_trip(GUAC_PROTOCOL_FRAMING_BINARY);
+
+    /* Binary elements are a protocol error unless enabled */
+    char binary[] = "4.blob,1.0,3#a;b;";
+
+    guac_parser* parser = guac_parser_alloc();
+    guac_parser_append(parser, binary, sizeof(binary) - 1);
+    CU_ASSERT_EQUAL(parser->state, GUAC_PARSE_ERROR);
+    guac_parser_free(parser);
+
+    char binary_enabled[] = "4.blob,1.0,3#a;b;";
+
+    parser = guac_parser_alloc();
+    guac_parser_enable_binary_framing(parser);
+    CU_ASSERT_EQUAL(guac_parser_append(parser, binary_enabled,
+                sizeof(binary_enabled) - 1), sizeof(binary_enabled) - 1);
+    CU_ASSERT_EQUAL(parser->state, GUAC_PARSE_COMPLETE);
+    CU_ASSERT_EQUAL(parser->argc, 2);
+    CU_ASSERT_NSTRING_EQUAL(parser->argv[1], "a;b", 3);
+    guac_parser_free(parser);
+
+}
@@ -0,0 +1,410 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/parser.h>
+#include <guacamole/protocol.h>
+#include <guacamole/recording.h>
+#include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * A recording containing two keyframes, ending with frames at timestamps 20
+ * and 40 respectively.
+ */
+#define TEST_RECORDING          \
+    "4.sync,2.10;"              \
+    "3.log,8.keyframe;"         \
+    "4.size,1.0,2.64,2.64;"     \
+    "4.sync,2.20;"              \
+    "4.sync,2.30;"              \
+    "3.log,8.keyframe;"         \
+    "4.size,1.0,3.128,3.128;"   \
+    "4.sync,2.40;"
+
+/**
+ * The offset of the first keyframe within TEST_RECORDING.
+ */
+#define TEST_FIRST_KEYFRAME 12
+
+/**
+ * The offset of the second keyframe within TEST_RECORDING.
+ */
+#define TEST_SECOND_KEYFRAME 74
+
+/**
+ * The number of milliseconds between keyframes written by
+ * test_recording__keyframes().
+ */
+#define TEST_KEYFRAME_INTERVAL 20
+
+/**
+ * The number of instructions, excluding the initial "log" and final "sync",
+ * within each keyframe written by test_recording__keyframe_exclusive().
+ */
+#define TEST_KEYFRAME_LENGTH 16
+
+/**
+ * The message of each "log" instruction within the keyframes written by
+ * test_recording__keyframe_exclusive().
+ */
+#define TEST_KEYFRAME_PART "keyframe part"
+
+/**
+ * Writes the given data to a new file at the given path.
+ *
+ * @param path
+ *     The path of the file to create.
+ *
+ * @param data
+ *     The null-terminated data to write.
+ */
+static void write_file(const char* path, const char* data) {
+
+    int fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0600);
+    CU_ASSERT_NOT_EQUAL_FATAL(fd, -1);
+    CU_ASSERT_EQUAL(write(fd, data, strlen(data)), strlen(data));
+    close(fd);
+
+}
+
+/**
+ * Rebuilds the index of the recording at the given path, storing that index
+ * alongside the recording.
+ *
+ * @param path
+ *     The path of the recording.
+ *
+ * @return
+ *     The number of keyframes within the rebuilt index.
+ */
+static int rebuild_index(const char* path) {
+
+    char index_path[256];
+    snprintf(index_path, sizeof(index_path), "%s%s", path,
+            GUAC_RECORDING_INDEX_SUFFIX);
+
+    int fd = open(path, O_RDONLY);
+    CU_ASSERT_NOT_EQUAL_FATAL(fd, -1);
+
+    int index_fd = open(index_path, O_CREAT | O_WRONLY | O_TRUNC, 0600);
+    CU_ASSERT_NOT_EQUAL_FATAL(index_fd, -1);
+
+    int keyframes = guac_recording_index_rebuild(fd, index_fd);
+    close(index_fd);
+
+    return keyframes;
+
+}
+
+/**
+ * Searches the index stored alongside the recording at the given path for
+ * the keyframe preceding the given timestamp.
+ *
+ * @param path
+ *     The path of the recording.
+ *
+ * @param timestamp
+ *     The timestamp to search for.
+ *
+ * @param offset
+ *     Pointer to a uint64_t that receives the offset of the keyframe.
+ *
+ * @return
+ *     The value returned by guac_recording_index_find().
+ */
+static int find_keyframe(const char* path, guac_timestamp timestamp,
+        uint64_t* offset) {
+
+    char index_path[256];
+    snprintf(index_path, sizeof(index_path), "%s%s", path,
+            GUAC_RECORDING_INDEX_SUFFIX);
+
+    int index_fd = open(index_path, O_RDONLY);
+    CU_ASSERT_NOT_EQUAL_FATAL(index_fd, -1);
+
+    int result = guac_recording_index_find(index_fd, timestamp, offset);
+    close(index_fd);
+
+    return result;
+
+}
+
+/**
+ * Verifies that reading the recording at the given path from the given
+ * offset begins with a keyframe.
+ *
+ * @param path
+ *     The path of the recording.
+ *
+ * @param offset
+ *     The offset of the keyframe within the recording.
+ */
+static void verify_keyframe_at(const char* path, uint64_t offset) {
+
+    int fd = open(path, O_RDONLY);
+    CU_ASSERT_NOT_EQUAL_FATAL(fd, -1);
+
+    guac_socket* socket = guac_recording_socket_open(fd);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+    CU_ASSERT_EQUAL_FATAL(guac_recording_socket_seek(socket, offset), 0);
+
+    guac_parser* parser = guac_parser_alloc();
+    CU_ASSERT_EQUAL_FATAL(guac_parser_read(parser, socket, -1), 0);
+    CU_ASSERT_STRING_EQUAL(parser->opcode, "log");
+    CU_ASSERT_EQUAL_FATAL(parser->argc, 1);
+    CU_ASSERT_STRING_EQUAL(parser->argv[0], GUAC_RECORDING_KEYFRAME_MESSAGE);
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+
+}
+
+/**
+ * Verifies that the index of a recording can be rebuilt from the keyframes
+ * within that recording, and that the rebuilt index locates the correct
+ * keyframe for any point in time.
+ */
+void test_recording__index_rebuild(void) {
+
+    char temp_dir[64] = "/tmp/guacamole-server-test_recording.XXXXXX";
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mkdtemp(temp_dir));
+
+    char path[128];
+    snprintf(path, sizeof(path), "%s/recording", temp_dir);
+    write_file(path, TEST_RECORDING);
+
+    CU_ASSERT_EQUAL(rebuild_index(path), 2);
+
+    uint64_t offset;
+
+    /* No keyframe precedes the first keyframe */
+    CU_ASSERT_NOT_EQUAL(find_keyframe(path, 15, &offset), 0);
+
+    CU_ASSERT_EQUAL_FATAL(find_keyframe(path, 20, &offset), 0);
+    CU_ASSERT_EQUAL(offset, TEST_FIRST_KEYFRAME);
+
+    CU_ASSERT_EQUAL_FATAL(find_keyframe(path, 39, &offset), 0);
+    CU_ASSERT_EQUAL(offset, TEST_FIRST_KEYFRAME);
+
+    CU_ASSERT_EQUAL_FATAL(find_keyframe(path, 1000, &offset), 0);
+    CU_ASSERT_EQUAL(offset, TEST_SECOND_KEYFRAME);
+
+    verify_keyframe_at(path, TEST_FIRST_KEYFRAME);
+    verify_keyframe_at(path, TEST_SECOND_KEYFRAME);
+
+    char index_path[256];
+    snprintf(index_path, sizeof(index_path), "%s%s", path,
+            GUAC_RECORDING_INDEX_SUFFIX);
+
+    unlink(index_path);
+    unlink(path);
+    rmdir(temp_dir);
+
+}
+
+/**
+ * Keyframe handler which writes a keyframe consisting of nothing but a frame
+ * boundary.
+ *
+ * @param socket
+ *     The socket of the recording receiving the keyframe.
+ *
+ * @param data
+ *     The guac_client being recorded.
+ */
+static void write_keyframe(guac_socket* socket, void* data) {
+    guac_client* client = (guac_client*) data;
+    guac_protocol_send_sync(socket, client->last_sent_timestamp, 1);
+}
+
+/**
+ * Verifies that keyframes are periodically written to recordings once
+ * enabled, that each keyframe is listed within the index of the recording,
+ * and that the index written during recording matches the index rebuilt
+ * from the finished recording.
+ */
+void test_recording__keyframes(void) {
+
+    char temp_dir[64] = "/tmp/guacamole-server-test_recording.XXXXXX";
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mkdtemp(temp_dir));
+
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    guac_recording* recording = guac_recording_create(client, temp_dir,
+            "recording", 0, 1, 0, 0, 0, 0, NULL, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(recording);
+
+    CU_ASSERT_EQUAL_FATAL(guac_recording_enable_keyframes(recording,
+                TEST_KEYFRAME_INTERVAL), 0);
+    guac_recording_set_keyframe_handler(recording, write_keyframe, client);
+
+    /* Interleave ordinary frames with the keyframes */
+    for (int i = 0; i < 10; i++) {
+        guac_protocol_send_sync(client->socket, guac_timestamp_current(), 1);
+        guac_timestamp_msleep(TEST_KEYFRAME_INTERVAL);
+    }
+
+    guac_recording_set_keyframe_handler(recording, NULL, NULL);
+    guac_recording_free(recording);
+    guac_client_free(client);
+
+    char path[128];
+    snprintf(path, sizeof(path), "%s/recording", temp_dir);
+
+    /* The last keyframe is listed, and is where the index says it is */
+    uint64_t offset;
+    CU_ASSERT_EQUAL_FATAL(find_keyframe(path, INT64_MAX, &offset), 0);
+    verify_keyframe_at(path, offset);
+
+    /* The same keyframe is found after rebuilding the index */
+    uint64_t rebuilt_offset;
+    CU_ASSERT_TRUE(rebuild_index(path) > 0);
+    CU_ASSERT_EQUAL_FATAL(find_keyframe(path, INT64_MAX, &rebuilt_offset), 0);
+    CU_ASSERT_EQUAL(rebuilt_offset, offset);
+
+    char index_path[256];
+    snprintf(index_path, sizeof(index_path), "%s%s", path,
+            GUAC_RECORDING_INDEX_SUFFIX);
+
+    unlink(index_path);
+    unlink(path);
+    rmdir(temp_dir);
+
+}
+
+
+/**
+ * Keyframe handler which writes a keyframe consisting of several "log"
+ * instructions, pausing between each, followed by a frame boundary.
+ *
+ * @param socket
+ *     The socket of the recording receiving the keyframe.
+ *
+ * @param data
+ *     The guac_client being recorded.
+ */
+static void write_slow_keyframe(guac_socket* socket, void* data) {
+
+    guac_client* client = (guac_client*) data;
+
+    for (int i = 0; i < TEST_KEYFRAME_LENGTH; i++) {
+        guac_protocol_send_log(socket, TEST_KEYFRAME_PART);
+        guac_timestamp_msleep(1);
+    }
+
+    guac_protocol_send_sync(socket, client->last_sent_timestamp, 1);
+
+}
+
+/**
+ * Verifies that instructions written to a recording by other threads are
+ * never interleaved with the instructions of a keyframe, even if the
+ * keyframe takes time to write.
+ */
+void test_recording__keyframe_exclusive(void) {
+
+    char temp_dir[64] = "/tmp/guacamole-server-test_recording.XXXXXX";
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mkdtemp(temp_dir));
+
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    guac_recording* recording = guac_recording_create(client, temp_dir,
+            "recording", 0, 1, 0, 0, 0, 0, NULL, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(recording);
+
+    CU_ASSERT_EQUAL_FATAL(guac_recording_enable_keyframes(recording,
+                TEST_KEYFRAME_INTERVAL), 0);
+    guac_recording_set_keyframe_handler(recording, write_slow_keyframe, client);
+
+    /* Continuously write other instructions while keyframes are written */
+    guac_timestamp end = guac_timestamp_current() + TEST_KEYFRAME_INTERVAL * 10;
+    while (guac_timestamp_current() < end)
+        guac_protocol_send_nop(client->socket);
+
+    guac_recording_set_keyframe_handler(recording, NULL, NULL);
+    guac_recording_free(recording);
+    guac_client_free(client);
+
+    char path[128];
+    snprintf(path, sizeof(path), "%s/recording", temp_dir);
+
+    int fd = open(path, O_RDONLY);
+    CU_ASSERT_NOT_EQUAL_FATAL(fd, -1);
+
+    guac_socket* socket = guac_recording_socket_open(fd);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    /* Every keyframe is contiguous: its marker, each of its parts, and its
+     * frame boundary, with nothing in between */
+    int keyframes = 0;
+    int expected = -1;
+    guac_parser* parser = guac_parser_alloc();
+    while (guac_parser_read(parser, socket, 1000000) == 0) {
+
+        int is_part = strcmp(parser->opcode, "log") == 0 && parser->argc == 1
+            && strcmp(parser->argv[0], TEST_KEYFRAME_PART) == 0;
+
+        if (expected == -1) {
+            CU_ASSERT_FALSE(is_part);
+            if (strcmp(parser->opcode, "log") == 0 && parser->argc == 1
+                    && strcmp(parser->argv[0], GUAC_RECORDING_KEYFRAME_MESSAGE) == 0) {
+                expected = TEST_KEYFRAME_LENGTH;
+                keyframes++;
+            }
+        }
+
+        else if (expected > 0) {
+            CU_ASSERT_TRUE(is_part);
+            expected--;
+        }
+
+        else {
+            CU_ASSERT_STRING_EQUAL(parser->opcode, "sync");
+            expected = -1;
+        }
+
+    }
+
+    CU_ASSERT_TRUE(keyframes > 0);
+    CU_ASSERT_EQUAL(expected, -1);
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+
+    char index_path[256];
+    snprintf(index_path, sizeof(index_path), "%s%s", path,
+            GUAC_RECORDING_INDEX_SUFFIX);
+
+    unlink(index_path);
+    unlink(path);
+    rmdir(temp_dir);
+
+}
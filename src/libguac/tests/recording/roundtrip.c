@@ -0,0 +1,125 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/parser.h>
+#include <guacamole/recording.h>
+#include <guacamole/socket.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * The number of key events written to each test recording. This is enough
+ * for compressed data to span many reads of the recording file.
+ */
+#define TEST_KEY_EVENTS 50000
+
+/**
+ * Writes a recording of TEST_KEY_EVENTS key events using the given
+ * compression, and verifies that reading the recording back with
+ * guac_recording_socket_open() produces exactly those events, in order. The
+ * recording is readable regardless of whether this build of libguac supports
+ * the requested compression, as unsupported compression is simply not
+ * applied.
+ *
+ * @param compression
+ *     The name of the compression to apply to the recording, or NULL for
+ *     none.
+ */
+static void verify_roundtrip(const char* compression) {
+
+    char temp_dir[64] = "/tmp/guacamole-server-test_recording.XXXXXX";
+    CU_ASSERT_PTR_NOT_NULL_FATAL(mkdtemp(temp_dir));
+
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    guac_recording* recording = guac_recording_create(client, temp_dir,
+            "recording", 0, 0, 0, 0, 1, 0, compression, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(recording);
+
+    for (int i = 0; i < TEST_KEY_EVENTS; i++)
+        guac_recording_report_key(recording, i, i % 2);
+
+    /* Freeing the recording must write everything that remains buffered */
+    guac_recording_free(recording);
+    guac_client_free(client);
+
+    char path[128];
+    snprintf(path, sizeof(path), "%s/recording", temp_dir);
+
+    int fd = open(path, O_RDONLY);
+    CU_ASSERT_NOT_EQUAL_FATAL(fd, -1);
+
+    guac_socket* socket = guac_recording_socket_open(fd);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    guac_parser* parser = guac_parser_alloc();
+
+    int count = 0;
+    while (!guac_parser_read(parser, socket, -1)) {
+
+        CU_ASSERT_STRING_EQUAL_FATAL(parser->opcode, "key");
+        CU_ASSERT_EQUAL_FATAL(parser->argc, 3);
+        CU_ASSERT_EQUAL_FATAL(atoi(parser->argv[0]), count);
+        CU_ASSERT_EQUAL_FATAL(atoi(parser->argv[1]), count % 2);
+
+        count++;
+
+    }
+
+    CU_ASSERT_EQUAL(count, TEST_KEY_EVENTS);
+
+    guac_parser_free(parser);
+    guac_socket_free(socket);
+
+    unlink(path);
+    rmdir(temp_dir);
+
+}
+
+/**
+ * Verifies that uncompressed recordings written from the recording writer
+ * thread can be read back in full.
+ */
+void test_recording__roundtrip_none(void) {
+    verify_roundtrip(GUAC_RECORDING_COMPRESSION_NONE_NAME);
+}
+
+/**
+ * Verifies that gzip-compressed recordings can be read back in full, with
+ * the compression detected automatically.
+ */
+void test_recording__roundtrip_gzip(void) {
+    verify_roundtrip(GUAC_RECORDING_COMPRESSION_GZIP_NAME);
+}
+
+/**
+ * Verifies that zstd-compressed recordings can be read back in full, with
+ * the compression detected automatically.
+ */
+void test_recording__roundtrip_zstd(void) {
+    verify_roundtrip(GUAC_RECORDING_COMPRESSION_ZSTD_NAME);
+}
+
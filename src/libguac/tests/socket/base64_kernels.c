@@ -0,0 +1,116 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "base64-kernels.h"
+
+#include <CUnit/CUnit.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The maximum number of bytes to encode in each test case. This is
+ * intentionally not a multiple of any vector width so that the tail handling
+ * of each kernel is exercised.
+ */
+#define TEST_BASE64_MAX_LENGTH 201
+
+/**
+ * Verifies that the scalar kernel produces the well-known base64 encoding of
+ * the given data.
+ *
+ * @param input
+ *     The data to encode.
+ *
+ * @param length
+ *     The number of bytes of data to encode. This must be a multiple of
+ *     three.
+ *
+ * @param expected
+ *     The expected base64 encoding of the data.
+ */
+static void verify_known_encoding(const char* input, size_t length,
+        const char* expected) {
+
+    char output[64];
+    size_t encoded = guac_base64_kernel_scalar.encode(
+            (const unsigned char*) input, length, output);
+
+    CU_ASSERT_EQUAL_FATAL(encoded, strlen(expected));
+    CU_ASSERT_NSTRING_EQUAL(output, expected, encoded);
+
+}
+
+/**
+ * Test which verifies that every supported base64 kernel encodes data
+ * identically to the scalar kernel, and that the scalar kernel itself
+ * produces correct output.
+ */
+void test_socket__base64_kernels(void) {
+
+    verify_known_encoding("", 0, "");
+    verify_known_encoding("Man", 3, "TWFu");
+    verify_known_encoding("guacamole", 9, "Z3VhY2Ftb2xl");
+    verify_known_encoding("\xFB\xFF\xBF\x00\x10\x83", 6, "+/+/ABCD");
+
+    unsigned char input[TEST_BASE64_MAX_LENGTH];
+    for (int i = 0; i < TEST_BASE64_MAX_LENGTH; i++)
+        input[i] = rand();
+
+    char expected[TEST_BASE64_MAX_LENGTH / 3 * 4];
+    char actual[TEST_BASE64_MAX_LENGTH / 3 * 4];
+
+    for (const guac_base64_kernel* const* kernel = guac_base64_kernels_all;
+            *kernel != NULL; kernel++) {
+
+        if (!(*kernel)->supported())
+            continue;
+
+        /* Every possible length, including every possible position of the
+         * last group relative to the vector width */
+        for (size_t length = 0; length <= TEST_BASE64_MAX_LENGTH; length += 3) {
+
+            memset(actual, 0, sizeof(actual));
+
+            size_t expected_length = guac_base64_kernel_scalar.encode(
+                    input, length, expected);
+
+            size_t actual_length = (*kernel)->encode(input, length, actual);
+
+            CU_ASSERT_EQUAL_FATAL(expected_length, length / 3 * 4);
+            CU_ASSERT_EQUAL_FATAL(actual_length, expected_length);
+            CU_ASSERT_EQUAL(memcmp(actual, expected, actual_length), 0);
+
+        }
+
+        /* Every possible 6-bit value in every possible position */
+        unsigned char all[48];
+        for (int i = 0; i < 16; i++) {
+            all[i * 3]     = (i * 4) << 2 | (i * 4 + 1) >> 4;
+            all[i * 3 + 1] = (i * 4 + 1) << 4 | (i * 4 + 2) >> 2;
+            all[i * 3 + 2] = (i * 4 + 2) << 6 | (i * 4 + 3);
+        }
+
+        (*kernel)->encode(all, sizeof(all), actual);
+        CU_ASSERT_NSTRING_EQUAL(actual,
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+                64);
+
+    }
+
+}
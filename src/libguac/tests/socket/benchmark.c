@@ -0,0 +1,341 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Microbenchmark for base64 encoding and for the guac_protocol_send_blob()
+ * path that all image and stream data follows. This is not a unit test and is
+ * not run by "make check". It may be built with "make benchmarks" and run
+ * manually to compare the throughput of each base64 kernel supported by the
+ * current processor, and of the blob path against the previous
+ * implementation (a 768-byte staging buffer encoded one group at a time).
+ */
+
+#include "base64-kernels.h"
+#include "guacamole/mem.h"
+#include "guacamole/protocol.h"
+#include "guacamole/socket.h"
+#include "guacamole/stream.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * The total number of bytes of data encoded by each benchmark.
+ */
+#define BENCH_TOTAL_LENGTH (256 * 1024 * 1024)
+
+/**
+ * The size of each blob, which is also the size of each block of data
+ * encoded by the kernel benchmarks.
+ */
+#define BENCH_BLOB_LENGTH GUAC_PROTOCOL_BLOB_MAX_LENGTH
+
+/**
+ * The size of the staging buffer used by the previous implementation of
+ * guac_socket_write_base64().
+ */
+#define BENCH_LEGACY_READY_SIZE 768
+
+/**
+ * Returns the current value of a monotonic clock, in seconds.
+ *
+ * @return
+ *     The current value of a monotonic clock, in seconds.
+ */
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+/**
+ * Prints the throughput of a benchmark that processed BENCH_TOTAL_LENGTH
+ * bytes of data within the given number of seconds.
+ *
+ * @param name
+ *     The name of the benchmark.
+ *
+ * @param elapsed
+ *     The total number of seconds taken.
+ */
+static void bench_report(const char* name, double elapsed) {
+    printf("%-40s %10.1f MB/s\n", name,
+            BENCH_TOTAL_LENGTH / elapsed / 1000000.0);
+}
+
+/**
+ * The state of the previous implementation of guac_socket_write_base64(),
+ * reproduced here as a baseline.
+ */
+typedef struct bench_legacy_state {
+
+    /**
+     * The number of bytes in the ready buffer.
+     */
+    int ready;
+
+    /**
+     * Bytes awaiting encoding.
+     */
+    unsigned char ready_buf[BENCH_LEGACY_READY_SIZE];
+
+    /**
+     * The result of encoding the ready buffer.
+     */
+    char encoded_buf[BENCH_LEGACY_READY_SIZE / 3 * 4];
+
+} bench_legacy_state;
+
+/**
+ * The previous implementation of the per-group base64 encoder, which uses
+ * negative values to denote missing bytes.
+ */
+static void bench_legacy_encode(int a, int b, int c, char* output) {
+
+    static const char characters[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    output[0] = characters[(a & 0xFC) >> 2];
+
+    if (b >= 0) {
+        output[1] = characters[((a & 0x03) << 4) | ((b & 0xF0) >> 4)];
+        if (c >= 0) {
+            output[2] = characters[((b & 0x0F) << 2) | ((c & 0xC0) >> 6)];
+            output[3] = characters[c & 0x3F];
+        }
+        else {
+            output[2] = characters[((b & 0x0F) << 2)];
+            output[3] = '=';
+        }
+    }
+    else {
+        output[1] = characters[((a & 0x03) << 4)];
+        output[2] = '=';
+        output[3] = '=';
+    }
+
+}
+
+/**
+ * The previous implementation of guac_socket_flush_base64().
+ */
+static int bench_legacy_flush_base64(guac_socket* socket,
+        bench_legacy_state* state) {
+
+    const unsigned char* src = state->ready_buf;
+    int encoded = 0;
+    int remaining = state->ready;
+
+    while (remaining > 2) {
+        bench_legacy_encode(src[0], src[1], src[2], state->encoded_buf + encoded);
+        remaining -= 3;
+        src += 3;
+        encoded += 4;
+    }
+
+    if (remaining == 2) {
+        bench_legacy_encode(src[0], src[1], -1, state->encoded_buf + encoded);
+        encoded += 4;
+    }
+    else if (remaining == 1) {
+        bench_legacy_encode(src[0], -1, -1, state->encoded_buf + encoded);
+        encoded += 4;
+    }
+
+    state->ready = 0;
+    return guac_socket_write(socket, state->encoded_buf, encoded);
+
+}
+
+/**
+ * The previous implementation of guac_socket_write_base64().
+ */
+static int bench_legacy_write_base64(guac_socket* socket,
+        bench_legacy_state* state, const unsigned char* src, size_t count) {
+
+    while (count > 0) {
+
+        size_t length = BENCH_LEGACY_READY_SIZE - state->ready;
+        if (count < length)
+            length = count;
+
+        memcpy(state->ready_buf + state->ready, src, length);
+        state->ready += length;
+        src += length;
+        count -= length;
+
+        if (state->ready == BENCH_LEGACY_READY_SIZE
+                && bench_legacy_flush_base64(socket, state))
+            return 1;
+
+    }
+
+    return 0;
+
+}
+
+/**
+ * The previous implementation of guac_protocol_send_blob(), identical to the
+ * current implementation aside from its use of the previous base64 encoder.
+ */
+static int bench_legacy_send_blob(guac_socket* socket,
+        bench_legacy_state* state, const guac_stream* stream,
+        const unsigned char* data, int count) {
+
+    int ret_val;
+
+    guac_socket_instruction_begin(socket);
+    ret_val =
+           guac_socket_write_string(socket, "4.blob,")
+        || guac_socket_write_int(socket, 1)
+        || guac_socket_write_string(socket, ".")
+        || guac_socket_write_int(socket, stream->index)
+        || guac_socket_write_string(socket, ",")
+        || guac_socket_write_int(socket, (count + 2) / 3 * 4)
+        || guac_socket_write_string(socket, ".")
+        || bench_legacy_write_base64(socket, state, data, count)
+        || bench_legacy_flush_base64(socket, state)
+        || guac_socket_write_string(socket, ";");
+    guac_socket_instruction_end(socket);
+
+    return ret_val;
+
+}
+
+/**
+ * Write handler which discards all data, for measuring the cost of the blob
+ * path through a socket that cannot encode base64 directly.
+ */
+static ssize_t bench_null_write(guac_socket* socket, const void* buf,
+        size_t count) {
+    return count;
+}
+
+/**
+ * Returns a new guac_socket which writes to /dev/null, exiting if /dev/null
+ * cannot be opened.
+ *
+ * @return
+ *     A new guac_socket which writes to /dev/null.
+ */
+static guac_socket* bench_open_null(void) {
+
+    int fd = open("/dev/null", O_WRONLY);
+    if (fd < 0) {
+        perror("/dev/null");
+        exit(1);
+    }
+
+    return guac_socket_open(fd);
+
+}
+
+/**
+ * Sends BENCH_TOTAL_LENGTH bytes of the given data as blobs over the given
+ * socket using guac_protocol_send_blob(), reporting the throughput achieved.
+ *
+ * @param name
+ *     The name of the benchmark.
+ *
+ * @param socket
+ *     The socket to send blobs over.
+ *
+ * @param data
+ *     BENCH_BLOB_LENGTH bytes of data to send repeatedly.
+ */
+static void bench_send_blob(const char* name, guac_socket* socket,
+        const unsigned char* data) {
+
+    guac_stream stream = { .index = 1 };
+
+    double start = bench_now();
+    for (size_t sent = 0; sent < BENCH_TOTAL_LENGTH; sent += BENCH_BLOB_LENGTH)
+        guac_protocol_send_blob(socket, &stream, data, BENCH_BLOB_LENGTH);
+    guac_socket_flush(socket);
+    bench_report(name, bench_now() - start);
+
+}
+
+int main(void) {
+
+    unsigned char* data = guac_mem_alloc(BENCH_BLOB_LENGTH);
+    char* encoded = guac_mem_alloc(BENCH_BLOB_LENGTH / 3 * 4);
+
+    for (int i = 0; i < BENCH_BLOB_LENGTH; i++)
+        data[i] = rand();
+
+    volatile size_t sink = 0;
+
+    /* Raw encoding throughput of each kernel */
+    for (const guac_base64_kernel* const* current = guac_base64_kernels_all;
+            *current != NULL; current++) {
+
+        const guac_base64_kernel* kernel = *current;
+        if (!kernel->supported()) {
+            printf("%-8s (not supported by this processor)\n", kernel->name);
+            continue;
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "encode (%s)", kernel->name);
+
+        double start = bench_now();
+        for (size_t done = 0; done < BENCH_TOTAL_LENGTH; done += BENCH_BLOB_LENGTH)
+            sink += kernel->encode(data, BENCH_BLOB_LENGTH, encoded);
+        bench_report(name, bench_now() - start);
+
+    }
+
+    printf("(guac_base64_encode() uses \"%s\")\n",
+            guac_base64_kernel_select()->name);
+
+    guac_stream stream = { .index = 1 };
+    bench_legacy_state state = { .ready = 0 };
+
+    /* The blob path prior to encoding directly into socket buffers */
+    guac_socket* socket = bench_open_null();
+    double start = bench_now();
+    for (size_t sent = 0; sent < BENCH_TOTAL_LENGTH; sent += BENCH_BLOB_LENGTH)
+        bench_legacy_send_blob(socket, &state, &stream, data, BENCH_BLOB_LENGTH);
+    guac_socket_flush(socket);
+    bench_report("send_blob (previous, fd)", bench_now() - start);
+    guac_socket_free(socket);
+
+    /* The current blob path, encoding directly into the fd socket buffer */
+    socket = bench_open_null();
+    bench_send_blob("send_blob (fd)", socket, data);
+    guac_socket_free(socket);
+
+    /* The current blob path through a socket that must be given encoded data
+     * via guac_socket_write() */
+    socket = guac_socket_alloc();
+    socket->write_handler = bench_null_write;
+    bench_send_blob("send_blob (no base64 handler)", socket, data);
+    guac_socket_free(socket);
+
+    guac_mem_free(data);
+    guac_mem_free(encoded);
+
+    return 0;
+
+}
@@ -0,0 +1,275 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+#include <guacamole/socket.h>
+#include <guacamole/user.h>
+
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * The number of users connected to the client used by the test.
+ */
+#define TEST_BROADCAST_USERS 3
+
+/**
+ * The maximum number of bytes retained by each capturing socket.
+ */
+#define TEST_BROADCAST_CAPTURE_SIZE 256
+
+/**
+ * All data written to a socket allocated by test_capture_alloc().
+ */
+typedef struct test_capture {
+
+    /**
+     * The data written thus far, as a null-terminated string.
+     */
+    char data[TEST_BROADCAST_CAPTURE_SIZE];
+
+    /**
+     * The number of bytes written thus far, excluding the null terminator.
+     */
+    size_t length;
+
+} test_capture;
+
+/**
+ * Write handler which appends the given data to the test_capture associated
+ * with the given socket, truncating that data if necessary.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param buf
+ *     The buffer of data to write.
+ *
+ * @param count
+ *     The number of bytes in the buffer.
+ *
+ * @return
+ *     Always the number of bytes given.
+ */
+static ssize_t test_capture_write(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    test_capture* capture = (test_capture*) socket->data;
+
+    size_t length = count;
+    if (length > sizeof(capture->data) - capture->length - 1)
+        length = sizeof(capture->data) - capture->length - 1;
+
+    memcpy(capture->data + capture->length, buf, length);
+    capture->length += length;
+    capture->data[capture->length] = '\0';
+
+    return count;
+
+}
+
+/**
+ * Free handler which frees the test_capture associated with the given socket.
+ *
+ * @param socket
+ *     The guac_socket being freed.
+ *
+ * @return
+ *     Always zero.
+ */
+static int test_capture_free(guac_socket* socket) {
+    guac_mem_free(socket->data);
+    return 0;
+}
+
+/**
+ * Allocates a new guac_socket which stores all data written to it within a
+ * test_capture.
+ *
+ * @return
+ *     A newly-allocated guac_socket.
+ */
+static guac_socket* test_capture_alloc(void) {
+
+    guac_socket* socket = guac_socket_alloc();
+    socket->data = guac_mem_zalloc(sizeof(test_capture));
+    socket->write_handler = test_capture_write;
+    socket->free_handler = test_capture_free;
+
+    return socket;
+
+}
+
+/**
+ * Returns the data written thus far to the given socket, which must have been
+ * allocated by test_capture_alloc(), clearing that data.
+ *
+ * @param socket
+ *     The socket whose data should be returned.
+ *
+ * @return
+ *     The data written to the socket since this function was last invoked,
+ *     as a null-terminated string that remains valid only until the socket
+ *     is next written.
+ */
+static const char* test_capture_take(guac_socket* socket) {
+
+    static char taken[TEST_BROADCAST_CAPTURE_SIZE];
+
+    test_capture* capture = (test_capture*) socket->data;
+    memcpy(taken, capture->data, capture->length + 1);
+
+    capture->length = 0;
+    capture->data[0] = '\0';
+
+    return taken;
+
+}
+
+/**
+ * Callback for guac_client_foreach_user() which counts each user, storing the
+ * count within the provided int.
+ *
+ * @param user
+ *     The user being counted.
+ *
+ * @param data
+ *     A pointer to the int to increment.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* test_count_user(guac_user* user, void* data) {
+    (*((int*) data))++;
+    return NULL;
+}
+
+/**
+ * Broadcast filter which allows only the user given as the filter data to
+ * receive data. This function is a guac_socket_broadcast_filter.
+ *
+ * @param user
+ *     The user to test.
+ *
+ * @param data
+ *     The only user that should receive data.
+ *
+ * @return
+ *     Non-zero if the given user is the user given as the filter data, zero
+ *     otherwise.
+ */
+static int test_filter_single_user(guac_user* user, void* data) {
+    return user == (guac_user*) data;
+}
+
+/**
+ * Writes the given string to the given socket, flushing the socket.
+ *
+ * @param socket
+ *     The socket to write to.
+ *
+ * @param str
+ *     The string to write.
+ */
+static void test_write(guac_socket* socket, const char* str) {
+    guac_socket_instruction_begin(socket);
+    guac_socket_write_string(socket, str);
+    guac_socket_instruction_end(socket);
+    guac_socket_flush(socket);
+}
+
+/**
+ * Verifies that data written to a broadcast socket reaches only the users
+ * allowed by the filter set with guac_socket_broadcast_set_filter(), including
+ * when written through a guac_socket_tee() wrapping that broadcast socket, and
+ * that clearing the filter again broadcasts to all users.
+ */
+void test_socket__broadcast_filter(void) {
+
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    guac_user* users[TEST_BROADCAST_USERS];
+    for (int i = 0; i < TEST_BROADCAST_USERS; i++) {
+        users[i] = guac_user_alloc();
+        CU_ASSERT_PTR_NOT_NULL_FATAL(users[i]);
+        users[i]->client = client;
+        users[i]->socket = test_capture_alloc();
+        CU_ASSERT_EQUAL_FATAL(guac_client_add_user(client, users[i], 0, NULL), 0);
+    }
+
+    /* Broadcasts reach only users that have been promoted from pending, which
+     * happens asynchronously */
+    int connected = 0;
+    for (int attempt = 0; attempt < 1000 && connected != TEST_BROADCAST_USERS; attempt++) {
+        connected = 0;
+        guac_client_foreach_user(client, test_count_user, &connected);
+        if (connected != TEST_BROADCAST_USERS)
+            usleep(1000);
+    }
+
+    CU_ASSERT_EQUAL_FATAL(connected, TEST_BROADCAST_USERS);
+
+    guac_socket* broadcast = guac_socket_broadcast(client);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(broadcast);
+
+    /* Filtered writes reach only the allowed user */
+    guac_socket_broadcast_set_filter(test_filter_single_user, users[1]);
+    test_write(broadcast, "4.test,8.filtered;");
+
+    CU_ASSERT_STRING_EQUAL(test_capture_take(users[0]->socket), "");
+    CU_ASSERT_STRING_EQUAL(test_capture_take(users[1]->socket), "4.test,8.filtered;");
+    CU_ASSERT_STRING_EQUAL(test_capture_take(users[2]->socket), "");
+
+    /* The filter applies to the broadcast socket even when that socket is
+     * written through a tee, while the other side of the tee receives
+     * everything */
+    guac_socket* recording = test_capture_alloc();
+    guac_socket* tee = guac_socket_tee(broadcast, recording);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(tee);
+
+    guac_socket_broadcast_set_filter(test_filter_single_user, users[2]);
+    test_write(tee, "4.test,3.tee;");
+
+    CU_ASSERT_STRING_EQUAL(test_capture_take(users[0]->socket), "");
+    CU_ASSERT_STRING_EQUAL(test_capture_take(users[1]->socket), "");
+    CU_ASSERT_STRING_EQUAL(test_capture_take(users[2]->socket), "4.test,3.tee;");
+    CU_ASSERT_STRING_EQUAL(test_capture_take(recording), "4.test,3.tee;");
+
+    /* Clearing the filter broadcasts to all users once again */
+    guac_socket_broadcast_set_filter(NULL, NULL);
+    test_write(tee, "4.test,3.all;");
+
+    for (int i = 0; i < TEST_BROADCAST_USERS; i++)
+        CU_ASSERT_STRING_EQUAL(test_capture_take(users[i]->socket), "4.test,3.all;");
+
+    CU_ASSERT_STRING_EQUAL(test_capture_take(recording), "4.test,3.all;");
+
+    /* Freeing the tee also frees the broadcast socket */
+    guac_socket_free(tee);
+    guac_client_free(client);
+
+    for (int i = 0; i < TEST_BROADCAST_USERS; i++) {
+        guac_socket_free(users[i]->socket);
+        guac_user_free(users[i]);
+    }
+
+}
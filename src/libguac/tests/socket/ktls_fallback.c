@@ -0,0 +1,206 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/socket.h>
+#include <guacamole/socket-ssl.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * The data written through the TLS session after the handshake completes.
+ */
+#define TEST_KTLS_MESSAGE "4.sync,1.0;"
+
+/**
+ * Generates a new private key and a self-signed certificate for that key,
+ * assigning both to the given SSL_CTX.
+ *
+ * @param context
+ *     The SSL_CTX that should use the generated key and certificate.
+ */
+static void use_generated_certificate(SSL_CTX* context) {
+
+    EVP_PKEY* key = NULL;
+    EVP_PKEY_CTX* key_context = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(key_context);
+    CU_ASSERT_EQUAL_FATAL(EVP_PKEY_keygen_init(key_context), 1);
+    CU_ASSERT_EQUAL_FATAL(EVP_PKEY_CTX_set_ec_paramgen_curve_nid(key_context,
+                NID_X9_62_prime256v1), 1);
+    CU_ASSERT_EQUAL_FATAL(EVP_PKEY_keygen(key_context, &key), 1);
+    EVP_PKEY_CTX_free(key_context);
+
+    X509* cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_set_pubkey(cert, key);
+
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+            (const unsigned char*) "localhost", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    CU_ASSERT_NOT_EQUAL_FATAL(X509_sign(cert, key, EVP_sha256()), 0);
+
+    CU_ASSERT_EQUAL(SSL_CTX_use_certificate(context, cert), 1);
+    CU_ASSERT_EQUAL(SSL_CTX_use_PrivateKey(context, key), 1);
+
+    X509_free(cert);
+    EVP_PKEY_free(key);
+
+}
+
+/**
+ * Connects to the TLS server on the given file descriptor, reading back
+ * TEST_KTLS_MESSAGE once the handshake completes.
+ *
+ * @param data
+ *     A pointer to the int file descriptor of the client end of the
+ *     connection.
+ *
+ * @return
+ *     Non-NULL if TEST_KTLS_MESSAGE was received, NULL otherwise.
+ */
+static void* client_thread(void* data) {
+
+    int fd = *((int*) data);
+    char buffer[sizeof(TEST_KTLS_MESSAGE)] = {0};
+    void* received = NULL;
+
+    SSL_CTX* context = SSL_CTX_new(TLS_client_method());
+    SSL* ssl = SSL_new(context);
+    SSL_set_fd(ssl, fd);
+
+    if (SSL_connect(ssl) == 1
+            && SSL_read(ssl, buffer, sizeof(buffer) - 1)
+                == sizeof(TEST_KTLS_MESSAGE) - 1
+            && strcmp(buffer, TEST_KTLS_MESSAGE) == 0)
+        received = data;
+
+    SSL_free(ssl);
+    SSL_CTX_free(context);
+
+    return received;
+
+}
+
+/**
+ * Verifies that guac_socket_ssl_get_ktls_fd() refuses sockets which are not
+ * TLS sockets at all.
+ */
+void test_socket__ktls_fallback_plain(void) {
+
+    int fds[2];
+    CU_ASSERT_EQUAL_FATAL(pipe(fds), 0);
+
+    guac_socket* socket = guac_socket_open(fds[1]);
+    CU_ASSERT_EQUAL(guac_socket_ssl_get_ktls_fd(socket), -1);
+
+    guac_socket_free(socket);
+    close(fds[0]);
+
+}
+
+/**
+ * Establishes a TLS session over a UNIX domain socket pair with kernel TLS
+ * requested, verifying that guac_socket_ssl_get_ktls_fd() refuses the
+ * resulting socket and that the socket continues to work through OpenSSL.
+ * Kernel TLS is never available for UNIX domain sockets, so this is the case
+ * regardless of the kernel and OpenSSL build.
+ *
+ * @param version
+ *     The TLS protocol version that should be negotiated, such as
+ *     TLS1_2_VERSION.
+ */
+static void verify_fallback(int version) {
+
+    int fds[2];
+    CU_ASSERT_EQUAL_FATAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    SSL_CTX* context = SSL_CTX_new(TLS_server_method());
+    CU_ASSERT_PTR_NOT_NULL_FATAL(context);
+    use_generated_certificate(context);
+
+    SSL_CTX_set_min_proto_version(context, version);
+    SSL_CTX_set_max_proto_version(context, version);
+
+#ifdef SSL_OP_ENABLE_KTLS
+    SSL_CTX_set_options(context, SSL_OP_ENABLE_KTLS);
+#endif
+
+    pthread_t client;
+    CU_ASSERT_EQUAL_FATAL(pthread_create(&client, NULL, client_thread,
+                &fds[1]), 0);
+
+    guac_socket* socket = guac_socket_open_secure(context, fds[0]);
+    CU_ASSERT_PTR_NOT_NULL(socket);
+
+    if (socket != NULL) {
+
+        /* The connection must be proxied as before */
+        CU_ASSERT_EQUAL(guac_socket_ssl_get_ktls_fd(socket), -1);
+
+        /* The session remains usable through OpenSSL */
+        CU_ASSERT_EQUAL(guac_socket_write_string(socket, TEST_KTLS_MESSAGE), 0);
+        CU_ASSERT_EQUAL(guac_socket_flush(socket), 0);
+
+    }
+
+    /* Ensure the client does not wait forever if the handshake failed */
+    else
+        close(fds[0]);
+
+    void* received;
+    pthread_join(client, &received);
+    CU_ASSERT_PTR_NOT_NULL(received);
+
+    if (socket != NULL)
+        guac_socket_free(socket);
+
+    close(fds[1]);
+    SSL_CTX_free(context);
+
+}
+
+/**
+ * Verifies that TLS 1.2 sessions for which kernel TLS was requested but is
+ * unavailable fall back to OpenSSL.
+ */
+void test_socket__ktls_fallback_tls12(void) {
+    verify_fallback(TLS1_2_VERSION);
+}
+
+/**
+ * Verifies that TLS 1.3 sessions fall back to OpenSSL. Such sessions are
+ * never passed on directly, even where kernel TLS is available, as a
+ * KeyUpdate received by the kernel would cause reads to fail.
+ */
+void test_socket__ktls_fallback_tls13(void) {
+#ifdef TLS1_3_VERSION
+    verify_fallback(TLS1_3_VERSION);
+#endif
+}
+
@@ -0,0 +1,168 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+
+#include <pthread.h>
+#include <string.h>
+
+/**
+ * The maximum number of bytes that may be queued by the queued socket under
+ * test.
+ */
+#define TEST_QUEUE_MAX_BYTES 32
+
+/**
+ * In-memory socket which records all data written, blocking each write until
+ * released by the test.
+ */
+typedef struct test_socket_data {
+
+    /**
+     * Lock guarding all other members of this structure.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition signalled whenever any member of this structure changes.
+     */
+    pthread_cond_t modified;
+
+    /**
+     * Non-zero if a write has begun, zero otherwise.
+     */
+    int entered;
+
+    /**
+     * Non-zero if writes may complete, zero if writes must block.
+     */
+    int released;
+
+    /**
+     * All data written thus far.
+     */
+    char written[1024];
+
+    /**
+     * The number of bytes within the written buffer.
+     */
+    size_t length;
+
+} test_socket_data;
+
+/**
+ * Write handler for the in-memory socket, recording the given data once
+ * writes have been released.
+ */
+static ssize_t test_socket_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    test_socket_data* data = (test_socket_data*) socket->data;
+
+    pthread_mutex_lock(&data->lock);
+
+    data->entered = 1;
+    pthread_cond_broadcast(&data->modified);
+
+    while (!data->released)
+        pthread_cond_wait(&data->modified, &data->lock);
+
+    if (data->length + count < sizeof(data->written)) {
+        memcpy(data->written + data->length, buf, count);
+        data->length += count;
+    }
+
+    pthread_mutex_unlock(&data->lock);
+    return count;
+
+}
+
+/**
+ * Overflow handler which counts the number of times it has been invoked.
+ */
+static void test_overflow_handler(guac_socket* socket, void* data) {
+    (*((int*) data))++;
+}
+
+/**
+ * Tests that a queued socket whose underlying socket has stalled discards
+ * data only at instruction boundaries once its queue overflows, invokes its
+ * overflow handler, and resumes queueing complete instructions once
+ * guac_socket_queue_resume() is called.
+ */
+void test_socket__queue_overflow(void) {
+
+    test_socket_data data = { .entered = 0, .released = 0, .length = 0 };
+    pthread_mutex_init(&data.lock, NULL);
+    pthread_cond_init(&data.modified, NULL);
+
+    guac_socket* underlying = guac_socket_alloc();
+    underlying->data = &data;
+    underlying->write_handler = test_socket_write_handler;
+
+    int overflows = 0;
+    guac_socket* socket = guac_socket_queue(underlying, TEST_QUEUE_MAX_BYTES,
+            60000, test_overflow_handler, &overflows);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+    /* Stall the underlying socket while it is writing the first instruction */
+    guac_protocol_send_nop(socket);
+    guac_socket_flush(socket);
+
+    pthread_mutex_lock(&data.lock);
+    while (!data.entered)
+        pthread_cond_wait(&data.modified, &data.lock);
+    pthread_mutex_unlock(&data.lock);
+
+    /* Queue two complete instructions, followed by an instruction that
+     * overflows the queue partway through */
+    guac_protocol_send_nop(socket);
+    guac_protocol_send_nop(socket);
+    guac_protocol_send_name(socket, "overflowing-the-queue");
+
+    /* Everything written after the overflow is discarded until resumed */
+    guac_protocol_send_nop(socket);
+    guac_socket_queue_resume(socket);
+    guac_protocol_send_name(socket, "resumed");
+    guac_socket_flush(socket);
+
+    guac_socket_queue_stats stats;
+    CU_ASSERT_EQUAL(guac_socket_queue_get_stats(socket, &stats), 0);
+    CU_ASSERT_EQUAL(stats.overflows, 1);
+    CU_ASSERT_EQUAL(stats.length, strlen("4.name,7.resumed;"));
+
+    pthread_mutex_lock(&data.lock);
+    data.released = 1;
+    pthread_cond_broadcast(&data.modified);
+    pthread_mutex_unlock(&data.lock);
+
+    /* Freeing the queued socket waits for all queued data to be written */
+    guac_socket_free(socket);
+
+    data.written[data.length] = '\0';
+    CU_ASSERT_STRING_EQUAL(data.written, "3.nop;4.name,7.resumed;");
+    CU_ASSERT_EQUAL(overflows, 1);
+
+    guac_socket_free(underlying);
+    pthread_cond_destroy(&data.modified);
+    pthread_mutex_destroy(&data.lock);
+
+}
@@ -0,0 +1,214 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <CUnit/CUnit.h>
+#include <guacamole/mem.h>
+#include <guacamole/socket.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * The total number of bytes of data written as base64 by each test case.
+ */
+#define TEST_DATA_LENGTH 20000
+
+/**
+ * The sizes of the individual writes used to write the test data, repeated
+ * as necessary. These sizes are chosen such that writes both complete and
+ * leave behind partial groups of three bytes, and such that some writes
+ * exceed the size of any internal buffer.
+ */
+static const size_t TEST_WRITE_SIZES[] = { 1, 2, 5, 3, 7000, 4, 6048, 11 };
+
+/**
+ * Buffer which receives all data written to a guac_socket created by
+ * test_memory_socket().
+ */
+typedef struct test_memory_socket_data {
+
+    /**
+     * The data written thus far.
+     */
+    char buffer[TEST_DATA_LENGTH / 3 * 4 + 4];
+
+    /**
+     * The number of bytes written thus far.
+     */
+    size_t length;
+
+} test_memory_socket_data;
+
+/**
+ * Write handler which appends all data written to the socket's
+ * test_memory_socket_data.
+ */
+static ssize_t test_memory_socket_write(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    test_memory_socket_data* data = (test_memory_socket_data*) socket->data;
+
+    if (data->length + count > sizeof(data->buffer))
+        return -1;
+
+    memcpy(data->buffer + data->length, buf, count);
+    data->length += count;
+
+    return count;
+
+}
+
+/**
+ * Encodes the given data as base64 one byte at a time, independently of the
+ * implementation being tested.
+ *
+ * @param input
+ *     The data to encode.
+ *
+ * @param length
+ *     The number of bytes of data to encode.
+ *
+ * @param output
+ *     The buffer which should receive the encoded data.
+ *
+ * @return
+ *     The number of characters written to the output buffer.
+ */
+static size_t reference_encode(const unsigned char* input, size_t length,
+        char* output) {
+
+    static const char characters[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    size_t written = 0;
+    for (size_t i = 0; i < length; i += 3) {
+
+        size_t remaining = length - i;
+        unsigned int a = input[i];
+        unsigned int b = remaining > 1 ? input[i + 1] : 0;
+        unsigned int c = remaining > 2 ? input[i + 2] : 0;
+
+        output[written++] = characters[a >> 2];
+        output[written++] = characters[((a & 0x03) << 4) | (b >> 4)];
+        output[written++] = remaining > 1 ? characters[((b & 0x0F) << 2) | (c >> 6)] : '=';
+        output[written++] = remaining > 2 ? characters[c & 0x3F] : '=';
+
+    }
+
+    return written;
+
+}
+
+/**
+ * Writes the given data to the given socket as base64 using a series of
+ * writes of varying sizes, followed by a flush of the base64 data.
+ *
+ * @param socket
+ *     The socket to write to.
+ *
+ * @param input
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes of data to write.
+ */
+static void write_in_pieces(guac_socket* socket, const unsigned char* input,
+        size_t length) {
+
+    size_t piece = 0;
+    while (length > 0) {
+
+        size_t size = TEST_WRITE_SIZES[piece++ % (sizeof(TEST_WRITE_SIZES)
+                / sizeof(TEST_WRITE_SIZES[0]))];
+
+        if (size > length)
+            size = length;
+
+        CU_ASSERT_EQUAL(guac_socket_write_base64(socket, input, size), 0);
+
+        input += size;
+        length -= size;
+
+    }
+
+    CU_ASSERT_EQUAL(guac_socket_flush_base64(socket), 0);
+    CU_ASSERT_EQUAL(guac_socket_flush(socket), 0);
+
+}
+
+/**
+ * Test which verifies that guac_socket_write_base64() produces correctly
+ * encoded and padded data regardless of how that data is divided across
+ * writes, both for sockets which encode directly into their own buffers and
+ * for sockets which do not.
+ */
+void test_socket__write_base64(void) {
+
+    unsigned char* input = guac_mem_alloc(TEST_DATA_LENGTH);
+    for (int i = 0; i < TEST_DATA_LENGTH; i++)
+        input[i] = rand();
+
+    char* expected = guac_mem_alloc(TEST_DATA_LENGTH / 3 * 4 + 4);
+    char* actual = guac_mem_alloc(TEST_DATA_LENGTH / 3 * 4 + 4);
+
+    /* Verify data lengths that leave 0, 1, and 2 bytes in the final group */
+    for (size_t length = TEST_DATA_LENGTH - 2; length <= TEST_DATA_LENGTH; length++) {
+
+        size_t expected_length = reference_encode(input, length, expected);
+
+        /* Socket without any handler for encoding base64 directly */
+        test_memory_socket_data* data = guac_mem_zalloc(sizeof(test_memory_socket_data));
+        guac_socket* socket = guac_socket_alloc();
+        socket->data = data;
+        socket->write_handler = test_memory_socket_write;
+
+        write_in_pieces(socket, input, length);
+
+        CU_ASSERT_EQUAL(data->length, expected_length);
+        CU_ASSERT_EQUAL(memcmp(data->buffer, expected, expected_length), 0);
+
+        guac_socket_free(socket);
+        guac_mem_free(data);
+
+        /* File descriptor socket, which encodes directly into its buffer */
+        FILE* file = tmpfile();
+        CU_ASSERT_PTR_NOT_NULL_FATAL(file);
+
+        socket = guac_socket_open(dup(fileno(file)));
+        CU_ASSERT_PTR_NOT_NULL_FATAL(socket);
+
+        write_in_pieces(socket, input, length);
+        guac_socket_free(socket);
+
+        rewind(file);
+        size_t actual_length = fread(actual, 1, TEST_DATA_LENGTH / 3 * 4 + 4, file);
+        fclose(file);
+
+        CU_ASSERT_EQUAL(actual_length, expected_length);
+        CU_ASSERT_EQUAL(memcmp(actual, expected, expected_length), 0);
+
+    }
+
+    guac_mem_free(actual);
+    guac_mem_free(expected);
+    guac_mem_free(input);
+
+}
@@ -21,6 +21,8 @@
 
 #include "guacamole/mem.h"
 #include "guacamole/client.h"
+#include "guacamole/input.h"
+#include "guacamole/metrics.h"
 #include "guacamole/object.h"
 #include "guacamole/protocol.h"
 #include "guacamole/stream.h"
@@ -30,11 +32,58 @@
 #include "user-handlers.h"
 
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * The number of slots within each opcode index. This MUST be a power of two,
+ * and should be several times larger than the number of handlers within any
+ * handler map, such that a collision-free seed is found quickly.
+ */
+#define GUAC_USER_OPCODE_INDEX_SIZE 64
+
+/**
+ * The maximum number of seeds tried when building an opcode index. If no seed
+ * results in a collision-free index, handlers are instead located by
+ * comparing against each opcode in turn.
+ */
+#define GUAC_USER_OPCODE_INDEX_MAX_SEEDS 65536
+
+/**
+ * A perfect hash table which locates the handler of any opcode within a
+ * handler map using a single string comparison.
+ */
+typedef struct __guac_opcode_index {
+
+    /**
+     * The NULL-terminated handler map being indexed.
+     */
+    __guac_instruction_handler_mapping* map;
+
+    /**
+     * The seed for __guac_opcode_hash() which maps every opcode within the
+     * handler map to a different slot.
+     */
+    uint32_t seed;
+
+    /**
+     * Non-zero if a seed was found for which no opcodes within the handler map
+     * share the same slot, zero if handlers must be located by comparing
+     * against each opcode in turn.
+     */
+    int perfect;
+
+    /**
+     * The handler mapping of the opcode whose hash selects each slot, or NULL
+     * if no opcode within the handler map selects that slot.
+     */
+    __guac_instruction_handler_mapping* slots[GUAC_USER_OPCODE_INDEX_SIZE];
+
+} __guac_opcode_index;
+
 /* Guacamole instruction handler map */
 
 __guac_instruction_handler_mapping __guac_instruction_handler_map[] = {
@@ -48,7 +97,7 @@ __guac_instruction_handler_mapping __guac_instruction_handler_map[] = {
    {"file",       __guac_handle_file},
    {"pipe",       __guac_handle_pipe},
    {"ack",        __guac_handle_ack},
-   {"blob",       __guac_handle_blob},
+   {"blob",       __guac_handle_blob, __guac_handle_binary_blob},
    {"end",        __guac_handle_end},
    {"get",        __guac_handle_get},
    {"put",        __guac_handle_put},
@@ -67,9 +116,158 @@ __guac_instruction_handler_mapping __guac_handshake_handler_map[] = {
     {"image",    __guac_handshake_image_handler},
     {"timezone", __guac_handshake_timezone_handler},
     {"name",     __guac_handshake_name_handler},
+    {"framing",  __guac_handshake_framing_handler},
     {NULL,       NULL}
 };
 
+/**
+ * Index of the handlers within __guac_instruction_handler_map.
+ */
+static __guac_opcode_index __guac_instruction_opcode_index = {
+    .map = __guac_instruction_handler_map
+};
+
+/**
+ * Index of the handlers within __guac_handshake_handler_map.
+ */
+static __guac_opcode_index __guac_handshake_opcode_index = {
+    .map = __guac_handshake_handler_map
+};
+
+/**
+ * Guarantees that the opcode indexes are built exactly once.
+ */
+static pthread_once_t __guac_opcode_indexes_init = PTHREAD_ONCE_INIT;
+
+/**
+ * Hashes the given opcode using a seeded variant of 32-bit FNV-1a.
+ *
+ * @param opcode
+ *     The opcode to hash.
+ *
+ * @param seed
+ *     An arbitrary value which varies the resulting hash.
+ *
+ * @return
+ *     The hash of the given opcode.
+ */
+static uint32_t __guac_opcode_hash(const char* opcode, uint32_t seed) {
+
+    uint32_t hash = 2166136261u ^ seed;
+    for (; *opcode != '\0'; opcode++) {
+        hash ^= (unsigned char) *opcode;
+        hash *= 16777619u;
+    }
+
+    /* Mix the upper bits into the lower bits used to select a slot */
+    return hash ^ (hash >> 16);
+
+}
+
+/**
+ * Searches for a seed which maps every opcode within the handler map of the
+ * given index to a different slot, populating the index with that seed and
+ * the resulting slots.
+ *
+ * @param index
+ *     The index to build.
+ */
+static void __guac_opcode_index_build(__guac_opcode_index* index) {
+
+    for (uint32_t seed = 0; seed < GUAC_USER_OPCODE_INDEX_MAX_SEEDS; seed++) {
+
+        memset(index->slots, 0, sizeof(index->slots));
+
+        __guac_instruction_handler_mapping* current = index->map;
+        while (current->opcode != NULL) {
+
+            __guac_instruction_handler_mapping** slot = &index->slots[
+                __guac_opcode_hash(current->opcode, seed)
+                    & (GUAC_USER_OPCODE_INDEX_SIZE - 1)];
+
+            if (*slot != NULL)
+                break;
+
+            *slot = current;
+            current++;
+
+        }
+
+        /* Stop at the first seed without collisions */
+        if (current->opcode == NULL) {
+            index->seed = seed;
+            index->perfect = 1;
+            return;
+        }
+
+    }
+
+    index->perfect = 0;
+
+}
+
+/**
+ * Builds all opcode indexes. This function MUST be invoked only through
+ * pthread_once() with __guac_opcode_indexes_init.
+ */
+static void __guac_opcode_indexes_build(void) {
+    __guac_opcode_index_build(&__guac_instruction_opcode_index);
+    __guac_opcode_index_build(&__guac_handshake_opcode_index);
+}
+
+/**
+ * Locates the handler mapping of the given opcode within the given handler
+ * map, using the index of that map if one exists.
+ *
+ * @param map
+ *     The NULL-terminated handler map to search.
+ *
+ * @param opcode
+ *     The opcode to locate.
+ *
+ * @return
+ *     The handler mapping of the given opcode, or NULL if the handler map
+ *     contains no such opcode.
+ */
+static __guac_instruction_handler_mapping* __guac_find_opcode_handler(
+        __guac_instruction_handler_mapping* map, const char* opcode) {
+
+    pthread_once(&__guac_opcode_indexes_init, __guac_opcode_indexes_build);
+
+    __guac_opcode_index* index = NULL;
+    if (map == __guac_instruction_handler_map)
+        index = &__guac_instruction_opcode_index;
+    else if (map == __guac_handshake_handler_map)
+        index = &__guac_handshake_opcode_index;
+
+    /* The only opcode that can possibly match is the opcode occupying the
+     * slot selected by the hash */
+    if (index != NULL && index->perfect) {
+
+        __guac_instruction_handler_mapping* mapping = index->slots[
+            __guac_opcode_hash(opcode, index->seed)
+                & (GUAC_USER_OPCODE_INDEX_SIZE - 1)];
+
+        if (mapping != NULL && strcmp(opcode, mapping->opcode) == 0)
+            return mapping;
+
+        return NULL;
+
+    }
+
+    /* Otherwise, compare against each defined instruction */
+    for (__guac_instruction_handler_mapping* current = map;
+            current->opcode != NULL; current++) {
+
+        if (strcmp(opcode, current->opcode) == 0)
+            return current;
+
+    }
+
+    return NULL;
+
+}
+
 /**
  * Parses a 64-bit integer from the given string. It is assumed that the string
  * will contain only decimal digits, with an optional leading minus sign.
@@ -163,6 +361,28 @@ int __guac_handle_sync(guac_user* user, int argc, char** argv) {
 }
 
 int __guac_handle_touch(guac_user* user, int argc, char** argv) {
+
+    guac_metrics_input_received();
+
+    /* Defer to the user's input queue if input is being coalesced */
+    if (user->__input_queue != NULL) {
+        guac_input_event event = {
+            .type = GUAC_INPUT_EVENT_TOUCH,
+            .user = user,
+            .details.touch = {
+                .id       = atoi(argv[0]),
+                .x        = atoi(argv[1]),
+                .y        = atoi(argv[2]),
+                .x_radius = atoi(argv[3]),
+                .y_radius = atoi(argv[4]),
+                .angle    = atof(argv[5]),
+                .force    = atof(argv[6])
+            }
+        };
+        guac_input_queue_enqueue(user->__input_queue, &event);
+        return 0;
+    }
+
     if (user->touch_handler)
         return user->touch_handler(
             user,
@@ -175,9 +395,28 @@ int __guac_handle_touch(guac_user* user, int argc, char** argv) {
             atof(argv[6])  /* force */
         );
     return 0;
+
 }
 
 int __guac_handle_mouse(guac_user* user, int argc, char** argv) {
+
+    guac_metrics_input_received();
+
+    /* Defer to the user's input queue if input is being coalesced */
+    if (user->__input_queue != NULL) {
+        guac_input_event event = {
+            .type = GUAC_INPUT_EVENT_MOUSE,
+            .user = user,
+            .details.mouse = {
+                .x    = atoi(argv[0]),
+                .y    = atoi(argv[1]),
+                .mask = atoi(argv[2])
+            }
+        };
+        guac_input_queue_enqueue(user->__input_queue, &event);
+        return 0;
+    }
+
     if (user->mouse_handler)
         return user->mouse_handler(
             user,
@@ -186,9 +425,27 @@ int __guac_handle_mouse(guac_user* user, int argc, char** argv) {
             atoi(argv[2])  /* mask */
         );
     return 0;
+
 }
 
 int __guac_handle_key(guac_user* user, int argc, char** argv) {
+
+    guac_metrics_input_received();
+
+    /* Defer to the user's input queue if input is being coalesced */
+    if (user->__input_queue != NULL) {
+        guac_input_event event = {
+            .type = GUAC_INPUT_EVENT_KEY,
+            .user = user,
+            .details.key = {
+                .keysym  = atoi(argv[0]),
+                .pressed = atoi(argv[1])
+            }
+        };
+        guac_input_queue_enqueue(user->__input_queue, &event);
+        return 0;
+    }
+
     if (user->key_handler)
         return user->key_handler(
             user,
@@ -196,6 +453,7 @@ int __guac_handle_key(guac_user* user, int argc, char** argv) {
             atoi(argv[1])  /* pressed */
         );
     return 0;
+
 }
 
 /**
@@ -512,6 +770,34 @@ int __guac_handle_blob(guac_user* user, int argc, char** argv) {
     return 0;
 }
 
+int __guac_handle_binary_blob(guac_user* user, int argc, char** argv,
+        const int* argl) {
+
+    /* Blobs sent as text are base64, as would be the case without binary
+     * framing */
+    if (argc < 2 || argl[1] < 0)
+        return __guac_handle_blob(user, argc, argv);
+
+    int stream_index = atoi(argv[0]);
+    guac_stream* stream = __get_open_input_stream(user, stream_index);
+
+    /* Fail if no such stream */
+    if (stream == NULL)
+        return 0;
+
+    /* Call stream handler if defined */
+    if (stream->blob_handler)
+        return stream->blob_handler(user, stream, argv[1], argl[1]);
+
+    /* Fall back to global handler if defined */
+    if (user->blob_handler)
+        return user->blob_handler(user, stream, argv[1], argl[1]);
+
+    guac_protocol_send_ack(user->socket, stream,
+            "File transfer unsupported", GUAC_PROTOCOL_STATUS_UNSUPPORTED);
+    return 0;
+}
+
 int __guac_handle_end(guac_user* user, int argc, char** argv) {
 
     int result = 0;
@@ -720,6 +1006,20 @@ int __guac_handshake_timezone_handler(guac_user* user, int argc, char** argv) {
     
 }
 
+int __guac_handshake_framing_handler(guac_user* user, int argc, char** argv) {
+
+    /* Use binary framing only if the client supports it, falling back to the
+     * text framing supported by all clients */
+    user->info.framing = GUAC_PROTOCOL_FRAMING_TEXT;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], GUAC_PROTOCOL_FRAMING_BINARY_NAME) == 0)
+            user->info.framing = GUAC_PROTOCOL_FRAMING_BINARY;
+    }
+
+    return 0;
+
+}
+
 char** guac_copy_mimetypes(char** mimetypes, int count) {
 
     int i;
@@ -758,17 +1058,21 @@ void guac_free_mimetypes(char** mimetypes) {
 }
 
 int __guac_user_call_opcode_handler(__guac_instruction_handler_mapping* map,
-        guac_user* user, const char* opcode, int argc, char** argv) {
+        guac_user* user, const char* opcode, int argc, char** argv,
+        const int* argl) {
 
-    /* For each defined instruction */
-    __guac_instruction_handler_mapping* current = map;
-    while (current->opcode != NULL) {
+    /* If recognized, call handler */
+    __guac_instruction_handler_mapping* mapping =
+        __guac_find_opcode_handler(map, opcode);
 
-        /* If recognized, call handler */
-        if (strcmp(opcode, current->opcode) == 0)
-            return current->handler(user, argc, argv);
+    if (mapping != NULL) {
+
+        /* Use binary handler only if binary framing may be in use */
+        if (argl != NULL && mapping->binary_handler != NULL)
+            return mapping->binary_handler(user, argc, argv, argl);
+
+        return mapping->handler(user, argc, argv);
 
-        current++;
     }
 
     /* If unrecognized, log and ignore */
@@ -778,3 +1082,57 @@ int __guac_user_call_opcode_handler(__guac_instruction_handler_mapping* map,
 
 }
 
+void __guac_user_handle_input_event(const guac_input_event* event,
+        void* data) {
+
+    int* result = (int*) data;
+    guac_user* user = event->user;
+    int retval = 0;
+
+    switch (event->type) {
+
+        /* Mouse event */
+        case GUAC_INPUT_EVENT_MOUSE:
+            if (user->mouse_handler)
+                retval = user->mouse_handler(user,
+                        event->details.mouse.x,
+                        event->details.mouse.y,
+                        event->details.mouse.mask);
+            break;
+
+        /* Keyboard event */
+        case GUAC_INPUT_EVENT_KEY:
+            if (user->key_handler)
+                retval = user->key_handler(user,
+                        event->details.key.keysym,
+                        event->details.key.pressed);
+            break;
+
+        /* Touch event */
+        case GUAC_INPUT_EVENT_TOUCH:
+            if (user->touch_handler)
+                retval = user->touch_handler(user,
+                        event->details.touch.id,
+                        event->details.touch.x,
+                        event->details.touch.y,
+                        event->details.touch.x_radius,
+                        event->details.touch.y_radius,
+                        event->details.touch.angle,
+                        event->details.touch.force);
+            break;
+
+    }
+
+    if (retval)
+        *result = retval;
+
+}
+
+int __guac_user_input_may_wait(const char* opcode) {
+    return strcmp(opcode, "mouse") == 0
+        || strcmp(opcode, "key") == 0
+        || strcmp(opcode, "touch") == 0
+        || strcmp(opcode, "sync") == 0
+        || strcmp(opcode, "nop") == 0;
+}
+
@@ -29,6 +29,7 @@
  */
 
 #include "guacamole/client.h"
+#include "guacamole/input.h"
 #include "guacamole/timestamp.h"
 
 /**
@@ -51,6 +52,29 @@
  */
 typedef int __guac_instruction_handler(guac_user* user, int argc, char** argv);
 
+/**
+ * Internal handler for Guacamole instructions whose arguments may have been
+ * received using binary framing.
+ *
+ * @param user
+ *     The user that sent the instruction.
+ *
+ * @param argc
+ *     The number of arguments in argv.
+ *
+ * @param argv
+ *     The arguments included with the instruction, excluding the opcode.
+ *
+ * @param argl
+ *     The length, in bytes, of each argument in argv that was received using
+ *     binary framing, or -1 for each argument that was received as text.
+ *
+ * @return
+ *     Zero if the instruction was successfully handled, non-zero otherwise.
+ */
+typedef int __guac_binary_instruction_handler(guac_user* user, int argc,
+        char** argv, const int* argl);
+
 /**
  * Structure mapping an instruction opcode to an instruction handler.
  */
@@ -66,6 +90,13 @@ typedef struct __guac_instruction_handler_mapping {
      */
     __guac_instruction_handler* handler;
 
+    /**
+     * The handler to invoke in place of the above handler for instructions
+     * that were received from a user that negotiated binary framing, or NULL
+     * if the above handler should always be invoked.
+     */
+    __guac_binary_instruction_handler* binary_handler;
+
 } __guac_instruction_handler_mapping;
 
 /**
@@ -145,6 +176,14 @@ __guac_instruction_handler __guac_handle_ack;
  */
 __guac_instruction_handler __guac_handle_blob;
 
+/**
+ * Internal initial handler for the blob instruction as received from a user
+ * that negotiated binary framing, in which case the blob data may be either
+ * raw binary data or base64. The client's blob handler will be invoked if
+ * defined.
+ */
+__guac_binary_instruction_handler __guac_handle_binary_blob;
+
 /**
  * Internal initial handler for the end instruction. When a end instruction
  * is received, this handler will be called. The client's end handler will
@@ -229,6 +268,13 @@ __guac_instruction_handler __guac_handshake_name_handler;
  */
 __guac_instruction_handler __guac_handshake_timezone_handler;
 
+/**
+ * Internal handler function that is called when the framing instruction is
+ * received during the handshake process, specifying the ways that the client
+ * is able to frame binary data.
+ */
+__guac_instruction_handler __guac_handshake_framing_handler;
+
 /**
  * Instruction handler mapping table. This is a NULL-terminated array of
  * __guac_instruction_handler_mapping structures, each mapping an opcode
@@ -278,11 +324,12 @@ char** guac_copy_mimetypes(char** mimetypes, int count);
 
 /**
  * Call the appropriate handler defined by the given user for the given
- * instruction. A comparison is made between the instruction opcode and the
- * initial handler lookup table defined in the map that is provided to this
- * function. If an entry for the instruction is found in the provided map,
- * the handler defined in that map will be called and the value returned.  If
- * no match is found, it is silently ignored.
+ * instruction. The instruction opcode is located within the initial handler
+ * lookup table defined in the map that is provided to this function, using a
+ * perfect hash of the opcodes within that map where the map is one of the
+ * maps defined by libguac. If an entry for the instruction is found in the
+ * provided map, the handler defined in that map will be called and the value
+ * returned.  If no match is found, it is silently ignored.
  *
  * @param map
  *     The array that holds the opcode to handler mappings.
@@ -300,10 +347,52 @@ char** guac_copy_mimetypes(char** mimetypes, int count);
  * @param argv
  *     An array of all arguments which are part of the instruction.
  *
+ * @param argl
+ *     An array of the length, in bytes, of each argument that was received
+ *     using binary framing, with -1 for each argument received as text, or
+ *     NULL if binary framing is not in use. If non-NULL, the binary handler
+ *     for the instruction is invoked in place of its usual handler, if such
+ *     a handler is defined.
+ *
  * @return
  *     Zero if the instruction was handled successfully, or non-zero otherwise.
  */
 int __guac_user_call_opcode_handler(__guac_instruction_handler_mapping* map,
-        guac_user* user, const char* opcode, int argc, char** argv);
+        guac_user* user, const char* opcode, int argc, char** argv,
+        const int* argl);
+
+/**
+ * Passes the given input event, which has left the input queue of the user
+ * that originated it, to the mouse, key or touch handler of that user. This
+ * function is a guac_input_event_handler, and the data provided must be a
+ * pointer to an int that will be set to the non-zero value returned by the
+ * user's handler if that handler fails. The int is left untouched if the
+ * handler succeeds.
+ *
+ * @param event
+ *     The input event to handle.
+ *
+ * @param data
+ *     A pointer to an int which receives the value returned by the user's
+ *     handler if that handler fails.
+ */
+void __guac_user_handle_input_event(const guac_input_event* event,
+        void* data);
+
+/**
+ * Returns whether the instruction having the given opcode may be handled
+ * while input remains waiting within the user's input queue. Only input
+ * itself and instructions which do not interact with the remote desktop may
+ * be handled before earlier input; any other instruction requires that
+ * waiting input be handled first.
+ *
+ * @param opcode
+ *     The opcode of the instruction to test.
+ *
+ * @return
+ *     Non-zero if the instruction may be handled while input is waiting,
+ *     zero if waiting input must be handled first.
+ */
+int __guac_user_input_may_wait(const char* opcode);
 
 #endif
@@ -22,16 +22,34 @@
 #include "guacamole/mem.h"
 #include "guacamole/client.h"
 #include "guacamole/error.h"
+#include "guacamole/input.h"
+#include "guacamole/metrics.h"
 #include "guacamole/parser.h"
 #include "guacamole/protocol.h"
 #include "guacamole/socket.h"
+#include "guacamole/timestamp.h"
 #include "guacamole/user.h"
 #include "user-handlers.h"
 
+#include <inttypes.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * The maximum number of instructions that the user input thread will handle
+ * for each batch of instructions read from the user.
+ */
+#define GUAC_USER_INPUT_BATCH_SIZE 64
+
+/**
+ * The maximum number of input events that may wait within the input queue
+ * of a user whose input is being coalesced. The queue is drained after each
+ * batch of instructions, leaving behind at most one held-back mouse motion
+ * event, so a queue of this size never fills.
+ */
+#define GUAC_USER_INPUT_QUEUE_SIZE (GUAC_USER_INPUT_BATCH_SIZE + 1)
+
 /**
  * Parameters required by the user input thread.
  */
@@ -115,6 +133,123 @@ static void guac_user_log_handshake_failure(guac_user* user) {
 
 }
 
+/**
+ * The state of the output queue of a user, as provided to
+ * guac_user_output_overflow().
+ */
+typedef struct guac_user_output {
+
+    /**
+     * The user whose output is queued.
+     */
+    guac_user* user;
+
+    /**
+     * The time that the connection state of the user was last
+     * resynchronized after the queue overflowed, or zero if no such
+     * resynchronization has occurred.
+     */
+    guac_timestamp last_resync;
+
+} guac_user_output;
+
+/**
+ * Handles overflow of the output queue of a user that is not keeping up with
+ * the data being sent. The user's connection state is resynchronized, unless
+ * resynchronization is not possible or the user has fallen behind again
+ * shortly after the last resynchronization, in which case the user is
+ * disconnected. This function is a guac_socket_queue_overflow_handler, and
+ * the data provided must be a guac_user_output.
+ *
+ * @param socket
+ *     The queued socket of the user.
+ *
+ * @param data
+ *     The guac_user_output describing the user's output queue.
+ */
+static void guac_user_output_overflow(guac_socket* socket, void* data) {
+
+    guac_user_output* output = (guac_user_output*) data;
+    guac_user* user = output->user;
+    guac_client* client = user->client;
+
+    guac_timestamp now = guac_timestamp_current();
+
+    /* Resynchronize via the pending join handler (which brings joining users
+     * up to date with the current connection state), if possible */
+    if (client->join_pending_handler != NULL && (output->last_resync == 0
+                || now - output->last_resync >= GUAC_USER_OUTPUT_RESYNC_INTERVAL)) {
+
+        guac_user_log(user, GUAC_LOG_WARNING, "User is not keeping up with "
+                "the connection. Queued data has been discarded, and the "
+                "user will be resynchronized.");
+
+        output->last_resync = now;
+        guac_client_resync_user(client, user);
+        return;
+
+    }
+
+    guac_user_log(user, GUAC_LOG_WARNING, "User is not keeping up with the "
+            "connection and will be disconnected.");
+    guac_user_stop(user);
+
+}
+
+/**
+ * Hands any input waiting within the input queue of the given user to that
+ * user's handlers. If any handler fails, the failure is logged and the user
+ * is stopped.
+ *
+ * @param user
+ *     The user whose queued input should be handled. The input queue of this
+ *     user MUST NOT be NULL.
+ *
+ * @param flush
+ *     Non-zero if all queued input should be handled, including any mouse
+ *     motion held back to honor the client's maximum motion rate, zero
+ *     otherwise.
+ *
+ * @param wait
+ *     A pointer to an int which receives the number of milliseconds until
+ *     held-back mouse motion may be handled, or -1 if no input remains
+ *     queued.
+ *
+ * @return
+ *     Zero if all handled input was handled successfully, non-zero if a
+ *     handler failed and the user has been stopped.
+ */
+static int guac_user_handle_queued_input(guac_user* user, int flush,
+        int* wait) {
+
+    /* Reset guac_error and guac_error_message (user/client handlers are not
+     * guaranteed to set these) */
+    guac_error = GUAC_STATUS_SUCCESS;
+    guac_error_message = NULL;
+
+    int result = 0;
+    *wait = -1;
+
+    if (flush)
+        guac_input_queue_flush(user->__input_queue,
+                __guac_user_handle_input_event, &result);
+    else
+        *wait = guac_input_queue_handle(user->__input_queue,
+                __guac_user_handle_input_event, &result);
+
+    if (result) {
+        guac_user_log_guac_error(user, GUAC_LOG_WARNING,
+                "User connection aborted");
+        guac_user_log(user, GUAC_LOG_DEBUG, "Failing instruction handler "
+                "in user was an input handler");
+        guac_user_stop(user);
+        return 1;
+    }
+
+    return 0;
+
+}
+
 /**
  * The thread which handles all user input, calling event handlers for received
  * instructions.
@@ -138,11 +273,31 @@ static void* guac_user_input_thread(void* data) {
     guac_client* client = user->client;
     guac_socket* socket = user->socket;
 
+    guac_parser_instruction instructions[GUAC_USER_INPUT_BATCH_SIZE];
+
+    /* Number of milliseconds until queued mouse motion may be handled, if
+     * any such motion is being held back */
+    int input_wait = -1;
+
     /* Guacamole user input loop */
     while (client->state == GUAC_CLIENT_RUNNING && user->active) {
 
-        /* Read instruction, stop on error */
-        if (guac_parser_read(parser, socket, usec_timeout)) {
+        /* Wait no longer than any held-back mouse motion can wait */
+        int batch_timeout = usec_timeout;
+        if (input_wait >= 0 && input_wait * 1000 < batch_timeout)
+            batch_timeout = input_wait * 1000;
+
+        /* Read all instructions received thus far, stop on error */
+        int count = guac_parser_read_batch(parser, socket, batch_timeout,
+                instructions, GUAC_USER_INPUT_BATCH_SIZE);
+
+        /* A timeout while motion is held back merely means that motion can
+         * now be handled */
+        if (count < 0 && guac_error == GUAC_STATUS_TIMEOUT
+                && batch_timeout < usec_timeout)
+            count = 0;
+
+        if (count < 0) {
 
             if (guac_error == GUAC_STATUS_TIMEOUT)
                 guac_user_abort(user, GUAC_PROTOCOL_STATUS_CLIENT_TIMEOUT, "User is not responding.");
@@ -157,32 +312,79 @@ static void* guac_user_input_thread(void* data) {
             return NULL;
         }
 
-        /* Reset guac_error and guac_error_message (user/client handlers are not
-         * guaranteed to set these) */
-        guac_error = GUAC_STATUS_SUCCESS;
-        guac_error_message = NULL;
+        for (int i = 0; i < count; i++) {
 
-        /* Call handler, stop on error */
-        if (__guac_user_call_opcode_handler(__guac_instruction_handler_map, 
-                user, parser->opcode, parser->argc, parser->argv)) {
+            /* Instructions received after the user or connection has begun
+             * stopping are ignored */
+            if (client->state != GUAC_CLIENT_RUNNING || !user->active)
+                break;
 
-            /* Log error */
-            guac_user_log_guac_error(user, GUAC_LOG_WARNING,
-                    "User connection aborted");
+            guac_parser_instruction* instruction = &instructions[i];
 
-            /* Log handler details */
-            guac_user_log(user, GUAC_LOG_DEBUG, "Failing instruction handler in user was \"%s\"", parser->opcode);
+            /* Any input still queued must take effect before anything other
+             * than further input */
+            if (user->__input_queue != NULL
+                    && !__guac_user_input_may_wait(instruction->opcode)
+                    && guac_user_handle_queued_input(user, 1, &input_wait))
+                return NULL;
+
+            /* Arguments may be binary only if binary framing was negotiated */
+            const int* argl = NULL;
+            if (user->info.framing == GUAC_PROTOCOL_FRAMING_BINARY)
+                argl = instruction->argl;
+
+            /* Reset guac_error and guac_error_message (user/client handlers
+             * are not guaranteed to set these) */
+            guac_error = GUAC_STATUS_SUCCESS;
+            guac_error_message = NULL;
+
+            /* Call handler, stop on error */
+            if (__guac_user_call_opcode_handler(__guac_instruction_handler_map,
+                    user, instruction->opcode, instruction->argc,
+                    instruction->argv, argl)) {
+
+                /* Log error */
+                guac_user_log_guac_error(user, GUAC_LOG_WARNING,
+                        "User connection aborted");
+
+                /* Log handler details */
+                guac_user_log(user, GUAC_LOG_DEBUG, "Failing instruction handler in user was \"%s\"", instruction->opcode);
+
+                guac_user_stop(user);
+                return NULL;
+            }
 
-            guac_user_stop(user);
-            return NULL;
         }
 
+        /* Hand queued input to the user's handlers, holding back only the
+         * mouse motion that would exceed the client's maximum motion rate */
+        if (user->__input_queue != NULL
+                && client->state == GUAC_CLIENT_RUNNING && user->active
+                && guac_user_handle_queued_input(user, 0, &input_wait))
+            return NULL;
+
     }
 
     return NULL;
 
 }
 
+/**
+ * Frees the input queue of the given user, if any, discarding any input still
+ * waiting within that queue. The user's input thread MUST NOT be running.
+ *
+ * @param user
+ *     The user whose input queue should be freed.
+ */
+static void guac_user_free_input_queue(guac_user* user) {
+
+    if (user->__input_queue != NULL) {
+        guac_input_queue_free(user->__input_queue);
+        user->__input_queue = NULL;
+    }
+
+}
+
 /**
  * Starts the input/output threads of a new user. This function will block
  * until the user disconnects. If an error prevents the input/output threads
@@ -213,15 +415,25 @@ static int guac_user_start(guac_parser* parser, guac_user* user,
 
     pthread_t input_thread;
 
+    /* Route input through a coalescing queue if requested by the client */
+    guac_client* client = user->client;
+    if (client->__coalesce_input)
+        user->__input_queue = guac_input_queue_alloc(
+                GUAC_USER_INPUT_QUEUE_SIZE, client->__max_motion_rate);
+
     if (pthread_create(&input_thread, NULL, guac_user_input_thread, (void*) &params)) {
         guac_user_log(user, GUAC_LOG_ERROR, "Unable to start input thread");
         guac_user_stop(user);
+        guac_user_free_input_queue(user);
         return -1;
     }
 
     /* Wait for I/O threads */
     pthread_join(input_thread, NULL);
 
+    /* Input left queued when the user stopped is discarded */
+    guac_user_free_input_queue(user);
+
     /* Explicitly signal disconnect */
     guac_protocol_send_disconnect(user->socket);
     guac_socket_flush(user->socket);
@@ -268,7 +480,7 @@ static int __guac_user_handshake(guac_user* user, guac_parser* parser,
         
         /* Run instruction handler for opcode with arguments. */
         if (__guac_user_call_opcode_handler(__guac_handshake_handler_map, user,
-                parser->opcode, parser->argc, parser->argv)) {
+                parser->opcode, parser->argc, parser->argv, NULL)) {
             
             guac_user_log_handshake_failure(user);
             guac_user_log_guac_error(user, GUAC_LOG_DEBUG,
@@ -299,6 +511,7 @@ int guac_user_handle_connection(guac_user* user, int usec_timeout) {
     user->info.video_mimetypes = NULL;
     user->info.name = NULL;
     user->info.timezone = NULL;
+    user->info.framing = GUAC_PROTOCOL_FRAMING_TEXT;
     
     /* Count number of arguments. */
     int num_args;
@@ -324,6 +537,13 @@ int guac_user_handle_connection(guac_user* user, int usec_timeout) {
         return 1;
     }
 
+    /* Confirm binary framing, if requested, before any binary data can be
+     * sent */
+    if (user->info.framing == GUAC_PROTOCOL_FRAMING_BINARY) {
+        guac_protocol_send_framing(socket, GUAC_PROTOCOL_FRAMING_BINARY);
+        guac_parser_enable_binary_framing(parser);
+    }
+
     /* Acknowledge connection availability */
     guac_protocol_send_ready(socket, client->connection_id);
     guac_socket_flush(socket);
@@ -335,6 +555,27 @@ int guac_user_handle_connection(guac_user* user, int usec_timeout) {
         return 1;
     }
     
+    /* Queue all output to the user such that a slow user cannot block anything
+     * writing to that user (including writes to the broadcast socket) */
+    guac_user_output output = { .user = user };
+    guac_socket* queued = guac_socket_queue(socket,
+            GUAC_USER_OUTPUT_QUEUE_MAX_BYTES, GUAC_USER_OUTPUT_QUEUE_MAX_DELAY,
+            guac_user_output_overflow, &output);
+
+    /* Track data sent to each user individually if metrics are recorded */
+    int metrics_user = guac_metrics_user_add(user->user_id);
+
+    if (queued != NULL) {
+        guac_socket_queue_set_metrics_user(queued, metrics_user);
+        user->socket = queued;
+    }
+    else
+        guac_user_log_guac_error(user, GUAC_LOG_WARNING, "Output to user "
+                "cannot be queued");
+
+    if (user->info.framing == GUAC_PROTOCOL_FRAMING_BINARY)
+        guac_socket_enable_binary_framing(user->socket);
+
     /* Attempt to join user to connection. */
     if (guac_client_add_user(client, user, (parser->argc - 1), parser->argv + 1))
         guac_client_log(client, GUAC_LOG_ERROR, "User \"%s\" could NOT "
@@ -367,6 +608,24 @@ int guac_user_handle_connection(guac_user* user, int usec_timeout) {
 
     }
     
+    /* Wait for all queued output to be sent */
+    if (queued != NULL) {
+
+        guac_socket_queue_stats stats;
+        guac_socket_queue_get_stats(queued, &stats);
+        guac_user_log(user, GUAC_LOG_DEBUG, "Output queue: at most %zu "
+                "byte(s) queued at once, %" PRIu64 " byte(s) queued in "
+                "total, %" PRIu64 " byte(s) discarded across %u overflow(s).",
+                stats.max_length, stats.queued, stats.discarded,
+                stats.overflows);
+
+        user->socket = socket;
+        guac_socket_free(queued);
+
+    }
+
+    guac_metrics_user_remove(metrics_user);
+
     /* Free mimetype character arrays. */
     guac_free_mimetypes((char **) user->info.audio_mimetypes);
     guac_free_mimetypes((char **) user->info.image_mimetypes);
@@ -173,7 +173,7 @@ void guac_user_free_object(guac_user* user, guac_object* object) {
 int guac_user_handle_instruction(guac_user* user, const char* opcode, int argc, char** argv) {
 
     return __guac_user_call_opcode_handler(__guac_instruction_handler_map,
-            user, opcode, argc, argv);
+            user, opcode, argc, argv, NULL);
 
 }
 
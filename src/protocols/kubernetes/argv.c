@@ -52,10 +52,8 @@ int guac_kubernetes_argv_callback(guac_user* user, const char* mimetype,
                     kubernetes_client->settings->resolution);
     }
 
-    /* Update Kubernetes terminal size */
-    guac_kubernetes_resize(client,
-            guac_terminal_get_rows(terminal),
-            guac_terminal_get_columns(terminal));
+    /* Any resulting change in terminal size is sent to Kubernetes by
+     * guac_kubernetes_terminal_resize_handler() once applied */
 
     return 0;
 
@@ -82,14 +82,18 @@ int guac_kubernetes_user_size_handler(guac_user* user, int width, int height) {
     if (terminal == NULL)
         return 0;
 
-    /* Resize terminal */
+    /* Resize terminal (the Kubernetes terminal window size is updated once
+     * the resize is applied) */
     guac_terminal_resize(terminal, width, height);
 
+    return 0;
+}
+
+void guac_kubernetes_terminal_resize_handler(guac_client* client,
+        int columns, int rows) {
+
     /* Update Kubernetes terminal window size if connected */
-    guac_kubernetes_resize(client,
-            guac_terminal_get_rows(terminal),
-            guac_terminal_get_columns(terminal));
+    guac_kubernetes_resize(client, rows, columns);
 
-    return 0;
 }
 
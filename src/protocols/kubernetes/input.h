@@ -20,6 +20,8 @@
 #ifndef GUAC_KUBERNETES_INPUT_H
 #define GUAC_KUBERNETES_INPUT_H
 
+#include "terminal/terminal.h"
+
 #include <guacamole/user.h>
 
 /**
@@ -40,5 +42,12 @@ guac_user_mouse_handler guac_kubernetes_user_mouse_handler;
  */
 guac_user_size_handler guac_kubernetes_user_size_handler;
 
+/**
+ * Handler for terminal resizes. Called by the terminal whenever a resize
+ * changes its number of rows or columns, sending the new size to the
+ * Kubernetes pod.
+ */
+guac_terminal_resize_handler guac_kubernetes_terminal_resize_handler;
+
 #endif
 
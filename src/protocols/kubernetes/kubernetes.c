@@ -21,6 +21,7 @@
 
 #include "argv.h"
 #include "client.h"
+#include "input.h"
 #include "io.h"
 #include "kubernetes.h"
 #include "ssl.h"
@@ -195,6 +196,20 @@ static void* guac_kubernetes_input_thread(void* data) {
 
 }
 
+/**
+ * Writes a keyframe to the session recording, copying the current state of
+ * the terminal.
+ *
+ * @param socket
+ *     The socket of the recording that should receive the keyframe.
+ *
+ * @param data
+ *     The guac_terminal of the Kubernetes connection.
+ */
+static void guac_kubernetes_write_keyframe(guac_socket* socket, void* data) {
+    guac_terminal_write_keyframe((guac_terminal*) data, socket);
+}
+
 void* guac_kubernetes_client_thread(void* data) {
 
     guac_client* client = (guac_client*) data;
@@ -238,7 +253,15 @@ void* guac_kubernetes_client_thread(void* data) {
                 !settings->recording_exclude_mouse,
                 0, /* Touch events not supported */
                 settings->recording_include_keys,
-                settings->recording_write_existing);
+                settings->recording_write_existing,
+                settings->recording_compression,
+                settings->recording_overflow);
+
+        /* Write keyframes periodically, if requested */
+        if (kubernetes_client->recording != NULL
+                && settings->recording_keyframe_interval > 0)
+            guac_recording_enable_keyframes(kubernetes_client->recording,
+                    settings->recording_keyframe_interval * 1000);
     }
 
     /* Create terminal options with required parameters */
@@ -249,6 +272,7 @@ void* guac_kubernetes_client_thread(void* data) {
     options->clipboard_buffer_size = settings->clipboard_buffer_size;
     options->disable_copy = settings->disable_copy;
     options->max_scrollback = settings->max_scrollback;
+    options->scrollback_spill_path = settings->scrollback_spill_path;
     options->font_name = settings->font_name;
     options->font_size = settings->font_size;
     options->color_scheme = settings->color_scheme;
@@ -268,6 +292,15 @@ void* guac_kubernetes_client_thread(void* data) {
         goto fail;
     }
 
+    /* Update the pod terminal size whenever the terminal is resized */
+    guac_terminal_set_resize_handler(kubernetes_client->term,
+            guac_kubernetes_terminal_resize_handler);
+
+    /* Keyframes copy the terminal */
+    if (kubernetes_client->recording != NULL)
+        guac_recording_set_keyframe_handler(kubernetes_client->recording,
+                guac_kubernetes_write_keyframe, kubernetes_client->term);
+
     /* Send current values of exposed arguments to owner only */
     guac_client_for_owner(client, guac_kubernetes_send_current_argv,
             kubernetes_client);
@@ -369,9 +402,17 @@ void* guac_kubernetes_client_thread(void* data) {
 fail:
 
     /* Kill and free terminal, if allocated */
-    if (kubernetes_client->term != NULL)
+    if (kubernetes_client->term != NULL) {
+
+        /* Stop writing keyframes from the terminal */
+        if (kubernetes_client->recording != NULL)
+            guac_recording_set_keyframe_handler(kubernetes_client->recording,
+                    NULL, NULL);
+
         guac_terminal_free(kubernetes_client->term);
 
+    }
+
     /* Clean up recording, if in progress */
     if (kubernetes_client->recording != NULL)
         guac_recording_free(kubernetes_client->recording);
@@ -53,9 +53,13 @@ const char* GUAC_KUBERNETES_CLIENT_ARGS[] = {
     "recording-include-keys",
     "create-recording-path",
     "recording-write-existing",
+    "recording-compression",
+    "recording-overflow",
+    "recording-keyframe-interval",
     "read-only",
     "backspace",
     "scrollback",
+    "scrollback-spill-path",
     "func-keys-and-keypad",
     "clipboard-buffer-size",
     "disable-copy",
@@ -226,6 +230,25 @@ enum KUBERNETES_ARGS_IDX {
      */
     IDX_RECORDING_WRITE_EXISTING,
 
+    /**
+     * The compression to apply to the recording file ("none", "gzip", or
+     * "zstd"). The recording is not compressed by default.
+     */
+    IDX_RECORDING_COMPRESSION,
+
+    /**
+     * What to do if the recording falls too far behind the connection
+     * ("block", "drop", or "abort"). Output blocks by default.
+     */
+    IDX_RECORDING_OVERFLOW,
+
+    /**
+     * The number of seconds between keyframes written to the recording,
+     * allowing playback to begin partway through. Keyframes are not written
+     * by default.
+     */
+    IDX_RECORDING_KEYFRAME_INTERVAL,
+
     /**
      * "true" if this connection should be read-only (user input should be
      * dropped), "false" or blank otherwise.
@@ -249,6 +272,13 @@ enum KUBERNETES_ARGS_IDX {
      */
     IDX_SCROLLBACK,
 
+    /**
+     * The directory in which a temporary file should be created to hold the
+     * compacted rows of scrollback which are not currently displayed. If
+     * omitted, those rows are held in memory.
+     */
+    IDX_SCROLLBACK_SPILL_PATH,
+
     /**
      * The maximum number of bytes to allow within the clipboard.
      */
@@ -351,6 +381,11 @@ guac_kubernetes_settings* guac_kubernetes_parse_args(guac_user* user,
         guac_user_parse_args_int(user, GUAC_KUBERNETES_CLIENT_ARGS, argv,
                 IDX_SCROLLBACK, GUAC_TERMINAL_DEFAULT_MAX_SCROLLBACK);
 
+    /* Read directory for undisplayed scrollback, if any */
+    settings->scrollback_spill_path =
+        guac_user_parse_args_string(user, GUAC_KUBERNETES_CLIENT_ARGS, argv,
+                IDX_SCROLLBACK_SPILL_PATH, NULL);
+
     /* Read font name */
     settings->font_name =
         guac_user_parse_args_string(user, GUAC_KUBERNETES_CLIENT_ARGS, argv,
@@ -426,6 +461,21 @@ guac_kubernetes_settings* guac_kubernetes_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_KUBERNETES_CLIENT_ARGS, argv,
                 IDX_RECORDING_WRITE_EXISTING, false);
 
+    /* Parse recording compression */
+    settings->recording_compression =
+        guac_user_parse_args_string(user, GUAC_KUBERNETES_CLIENT_ARGS, argv,
+                IDX_RECORDING_COMPRESSION, NULL);
+
+    /* Parse recording overflow policy */
+    settings->recording_overflow =
+        guac_user_parse_args_string(user, GUAC_KUBERNETES_CLIENT_ARGS, argv,
+                IDX_RECORDING_OVERFLOW, NULL);
+
+    /* Parse recording keyframe interval */
+    settings->recording_keyframe_interval =
+        guac_user_parse_args_int(user, GUAC_KUBERNETES_CLIENT_ARGS, argv,
+                IDX_RECORDING_KEYFRAME_INTERVAL, 0);
+
     /* Parse backspace key code */
     settings->backspace =
         guac_user_parse_args_int(user, GUAC_KUBERNETES_CLIENT_ARGS, argv,
@@ -494,6 +544,9 @@ void guac_kubernetes_settings_free(guac_kubernetes_settings* settings) {
     guac_mem_free(settings->font_name);
     guac_mem_free(settings->color_scheme);
 
+    /* Free scrollback settings */
+    guac_mem_free(settings->scrollback_spill_path);
+
     /* Free typescript settings */
     guac_mem_free(settings->typescript_name);
     guac_mem_free(settings->typescript_path);
@@ -501,6 +554,8 @@ void guac_kubernetes_settings_free(guac_kubernetes_settings* settings) {
     /* Free screen recording settings */
     guac_mem_free(settings->recording_name);
     guac_mem_free(settings->recording_path);
+    guac_mem_free(settings->recording_compression);
+    guac_mem_free(settings->recording_overflow);
 
     /* Free overall structure */
     guac_mem_free(settings);
@@ -39,6 +39,7 @@
 #include <guacamole/argv.h>
 #include <guacamole/audio.h>
 #include <guacamole/client.h>
+#include <guacamole/input.h>
 #include <guacamole/mem.h>
 #include <guacamole/recording.h>
 #include <guacamole/rwlock.h>
@@ -130,11 +131,11 @@ static int guac_rdp_join_pending_handler(guac_client* client) {
     /* Bring user up to date with any registered static channels */
     guac_rdp_pipe_svc_send_pipes(client, broadcast_socket);
 
-    /* Synchronize with current display */
-    if (rdp_client->display != NULL) {
-        guac_display_dup(rdp_client->display, broadcast_socket);
-        guac_socket_flush(broadcast_socket);
-    }
+    /* Synchronize with current display, encoding the current display state
+     * in the background such that the connection is not stalled while users
+     * join */
+    if (rdp_client->display != NULL)
+        guac_display_dup_pending(rdp_client->display);
 
     guac_rwlock_release_lock(&(rdp_client->lock));
 
@@ -207,8 +208,8 @@ int guac_client_init(guac_client* client, int argc, char** argv) {
 
     /* Create queue for input events (to avoid RDP I/O blocking processing of
      * further Guacamole instructions) and associated signalling handle */
-    guac_fifo_init(&rdp_client->input_events, &rdp_client->input_events_items,
-            GUAC_RDP_INPUT_EVENT_QUEUE_SIZE, sizeof(guac_rdp_input_event));
+    rdp_client->input_events = guac_input_queue_alloc(
+            GUAC_RDP_INPUT_EVENT_QUEUE_SIZE, GUAC_RDP_MAX_MOTION_RATE);
 
     rdp_client->input_event_queued = CreateEvent(NULL, TRUE, FALSE, NULL);
 
@@ -260,7 +261,7 @@ int guac_rdp_client_free_handler(guac_client* client) {
     pthread_join(rdp_client->client_thread, NULL);
 
     /* Clean up event queue and associated signalling handle */
-    guac_fifo_destroy(&rdp_client->input_events);
+    guac_input_queue_free(rdp_client->input_events);
     CloseHandle(rdp_client->input_event_queued);
 
     /* Free parsed settings */
@@ -32,6 +32,7 @@
 #include <guacamole/assert.h>
 #include <guacamole/client.h>
 #include <guacamole/display.h>
+#include <guacamole/input.h>
 #include <guacamole/recording.h>
 #include <guacamole/rwlock.h>
 #include <guacamole/user.h>
@@ -50,11 +51,11 @@
  *     The mouse event to process.
  */
 static void guac_rdp_handle_mouse_event(guac_rdp_client* rdp_client,
-        const guac_rdp_input_event* event) {
+        const guac_input_event* event) {
 
     /* This function exclusively processes mouse events, and it's on the caller
      * to ensure only mouse events are provided */
-    GUAC_ASSERT(event->type == GUAC_RDP_INPUT_EVENT_MOUSE);
+    GUAC_ASSERT(event->type == GUAC_INPUT_EVENT_MOUSE);
 
     guac_user* user = event->user;
     int x = event->details.mouse.x;
@@ -168,11 +169,11 @@ complete:
  *     The key event to process.
  */
 static void guac_rdp_handle_key_event(guac_rdp_client* rdp_client,
-        const guac_rdp_input_event* event) {
+        const guac_input_event* event) {
 
     /* This function exclusively processes key events, and it's on the caller
      * to ensure only key events are provided */
-    GUAC_ASSERT(event->type == GUAC_RDP_INPUT_EVENT_KEY);
+    GUAC_ASSERT(event->type == GUAC_INPUT_EVENT_KEY);
 
     int keysym = event->details.key.keysym;
     int pressed = event->details.key.pressed;
@@ -209,11 +210,11 @@ complete:
  *     The touch event to process.
  */
 static void guac_rdp_handle_touch_event(guac_rdp_client* rdp_client,
-        const guac_rdp_input_event* event) {
+        const guac_input_event* event) {
 
     /* This function exclusively processes touch. events, and it's on the
      * caller to ensure only touch. events are provided */
-    GUAC_ASSERT(event->type == GUAC_RDP_INPUT_EVENT_TOUCH);
+    GUAC_ASSERT(event->type == GUAC_INPUT_EVENT_TOUCH);
 
     int id = event->details.touch.id;
     int x = event->details.touch.x;
@@ -243,42 +244,59 @@ complete:
 
 }
 
-void guac_rdp_input_event_enqueue(guac_rdp_client* rdp_client,
-        const guac_rdp_input_event* input_event) {
+/**
+ * Processes a single input event of any type, updating client state and
+ * sending any associated RDP PDUs. This function is a
+ * guac_input_event_handler, and the data provided must be the
+ * guac_rdp_client associated with the RDP session receiving the event.
+ *
+ * @param event
+ *     The input event to process.
+ *
+ * @param data
+ *     The RDP client instance that should be updated and used to send any
+ *     PDUs associated with the event.
+ */
+static void guac_rdp_handle_input_event(const guac_input_event* event,
+        void* data) {
 
-    guac_fifo_enqueue_and_lock(&rdp_client->input_events, input_event);
-    SetEvent(rdp_client->input_event_queued);
-    guac_fifo_unlock(&rdp_client->input_events);
+    guac_rdp_client* rdp_client = (guac_rdp_client*) data;
 
-}
+    switch (event->type) {
 
-void guac_rdp_handle_input_events(guac_rdp_client* rdp_client) {
+        /* Mouse event */
+        case GUAC_INPUT_EVENT_MOUSE:
+            guac_rdp_handle_mouse_event(rdp_client, event);
+            break;
 
-    guac_fifo_lock(&rdp_client->input_events);
+        /* Keyboard event */
+        case GUAC_INPUT_EVENT_KEY:
+            guac_rdp_handle_key_event(rdp_client, event);
+            break;
 
-    guac_rdp_input_event input_event;
-    while (guac_fifo_timed_dequeue(&rdp_client->input_events, &input_event, 0)) {
-        switch (input_event.type) {
+        /* Touch event */
+        case GUAC_INPUT_EVENT_TOUCH:
+            guac_rdp_handle_touch_event(rdp_client, event);
+            break;
 
-            /* Mouse event */
-            case GUAC_RDP_INPUT_EVENT_MOUSE:
-                guac_rdp_handle_mouse_event(rdp_client, &input_event);
-                break;
+    }
 
-            /* Keyboard event */
-            case GUAC_RDP_INPUT_EVENT_KEY:
-                guac_rdp_handle_key_event(rdp_client, &input_event);
-                break;
+}
 
-            /* Touch event */
-            case GUAC_RDP_INPUT_EVENT_TOUCH:
-                guac_rdp_handle_touch_event(rdp_client, &input_event);
-                break;
+void guac_rdp_input_event_enqueue(guac_rdp_client* rdp_client,
+        const guac_input_event* input_event) {
 
-        }
-    }
+    guac_input_queue_enqueue(rdp_client->input_events, input_event);
+    SetEvent(rdp_client->input_event_queued);
+
+}
+
+int guac_rdp_handle_input_events(guac_rdp_client* rdp_client) {
 
-    ResetEvent(rdp_client->input_event_queued);
-    guac_fifo_unlock(&rdp_client->input_events);
+    /* NOTE: The input_event_queued handle is reset only after waiting (see
+     * rdp_guac_client_wait_for_events()), such that any event queued while
+     * these events are handled is guaranteed to wake the next wait */
+    return guac_input_queue_handle(rdp_client->input_events,
+            guac_rdp_handle_input_event, rdp_client);
 
 }
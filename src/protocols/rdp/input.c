@@ -29,6 +29,7 @@
 #include <freerdp/input.h>
 #include <guacamole/client.h>
 #include <guacamole/display.h>
+#include <guacamole/input.h>
 #include <guacamole/recording.h>
 #include <guacamole/rwlock.h>
 #include <guacamole/user.h>
@@ -40,8 +41,8 @@ int guac_rdp_user_mouse_handler(guac_user* user, int x, int y, int mask) {
     guac_client* client = user->client;
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
 
-    guac_rdp_input_event mouse_event = {
-        .type = GUAC_RDP_INPUT_EVENT_MOUSE,
+    guac_input_event mouse_event = {
+        .type = GUAC_INPUT_EVENT_MOUSE,
         .user = user,
         .details.mouse = {
             .x = x,
@@ -61,8 +62,8 @@ int guac_rdp_user_touch_handler(guac_user* user, int id, int x, int y,
     guac_client* client = user->client;
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
 
-    guac_rdp_input_event touch_event = {
-        .type = GUAC_RDP_INPUT_EVENT_TOUCH,
+    guac_input_event touch_event = {
+        .type = GUAC_INPUT_EVENT_TOUCH,
         .user = user,
         .details.touch = {
             .id = id,
@@ -85,8 +86,8 @@ int guac_rdp_user_key_handler(guac_user* user, int keysym, int pressed) {
     guac_client* client = user->client;
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
 
-    guac_rdp_input_event key_event = {
-        .type = GUAC_RDP_INPUT_EVENT_KEY,
+    guac_input_event key_event = {
+        .type = GUAC_INPUT_EVENT_KEY,
         .user = user,
         .details.key = {
             .keysym = keysym,
@@ -497,6 +497,20 @@ static int guac_rdp_handle_events(guac_rdp_client* rdp_client) {
 
 }
 
+/**
+ * Writes a keyframe to the session recording, copying the current state of
+ * the guac_display of the RDP connection.
+ *
+ * @param socket
+ *     The socket of the recording that should receive the keyframe.
+ *
+ * @param data
+ *     The guac_display of the current RDP connection.
+ */
+static void guac_rdp_write_keyframe(guac_socket* socket, void* data) {
+    guac_display_dup((guac_display*) data, socket);
+}
+
 /**
  * Connects to an RDP server as described by the guac_rdp_settings structure
  * associated with the given client, allocating and freeing all objects
@@ -529,6 +543,11 @@ static int guac_rdp_handle_connection(guac_client* client) {
     /* Create display */
     rdp_client->display = guac_display_alloc(client);
 
+    /* Keyframes copy the display of the current connection */
+    if (rdp_client->recording != NULL)
+        guac_recording_set_keyframe_handler(rdp_client->recording,
+                guac_rdp_write_keyframe, rdp_client->display);
+
     guac_display_layer* default_layer = guac_display_default_layer(rdp_client->display);
     guac_display_layer_resize(default_layer, rdp_client->settings->width, rdp_client->settings->height);
 
@@ -536,6 +555,10 @@ static int guac_rdp_handle_connection(guac_client* client) {
      * heuristics) */
     guac_display_layer_set_lossless(default_layer, settings->lossless);
 
+    /* Size the cache of recently-sent tiles as requested */
+    guac_display_set_tile_cache_size(rdp_client->display,
+            (size_t) settings->tile_cache_size * 1024);
+
     rdp_client->current_surface = default_layer;
 
     rdp_client->available_svc = guac_common_list_alloc();
@@ -607,6 +630,10 @@ static int guac_rdp_handle_connection(guac_client* client) {
 
     rdp_client->render_thread = guac_display_render_thread_create(rdp_client->display);
 
+    /* Number of milliseconds until queued mouse motion may be sent, if any
+     * such motion is being held back */
+    int input_wait = -1;
+
     /* Handle messages from RDP server while client is running */
     while (client->state == GUAC_CLIENT_RUNNING
             && !guac_rdp_disp_reconnect_needed(rdp_client->disp)) {
@@ -614,9 +641,14 @@ static int guac_rdp_handle_connection(guac_client* client) {
         /* Update remote display size */
         guac_rdp_disp_update_size(rdp_client->disp, settings, rdp_inst);
 
+        /* Wait no longer than any held-back mouse motion can wait */
+        int wait_timeout = GUAC_RDP_MESSAGE_CHECK_INTERVAL;
+        if (input_wait >= 0 && input_wait < wait_timeout)
+            wait_timeout = input_wait;
+
         /* Wait for data and construct a reasonable frame */
 
-        int wait_result = rdp_guac_client_wait_for_events(client, GUAC_RDP_MESSAGE_CHECK_INTERVAL);
+        int wait_result = rdp_guac_client_wait_for_events(client, wait_timeout);
         if (wait_result < 0)
             break;
 
@@ -646,7 +678,7 @@ static int guac_rdp_handle_connection(guac_client* client) {
         }
 
         /* Handle any input events that have been received */
-        guac_rdp_handle_input_events(rdp_client);
+        input_wait = guac_rdp_handle_input_events(rdp_client);
 
         /* Close connection cleanly if server is disconnecting */
         if (connection_closing)
@@ -676,6 +708,10 @@ static int guac_rdp_handle_connection(guac_client* client) {
     guac_display_render_thread_destroy(rdp_client->render_thread);
     rdp_client->render_thread = NULL;
 
+    /* Stop writing keyframes from the display that is about to be freed */
+    if (rdp_client->recording != NULL)
+        guac_recording_set_keyframe_handler(rdp_client->recording, NULL, NULL);
+
     /* Remove reference to FreeRDP's GDI buffer so that it can be safely freed
      * prior to freeing the guac_display */
     guac_display_layer_raw_context* context = guac_display_layer_open_raw(default_layer);
@@ -932,7 +968,15 @@ void* guac_rdp_client_thread(void* data) {
                 !settings->recording_exclude_mouse,
                 !settings->recording_exclude_touch,
                 settings->recording_include_keys,
-                settings->recording_write_existing);
+                settings->recording_write_existing,
+                settings->recording_compression,
+                settings->recording_overflow);
+
+        /* Write keyframes periodically, if requested */
+        if (rdp_client->recording != NULL
+                && settings->recording_keyframe_interval > 0)
+            guac_recording_enable_keyframes(rdp_client->recording,
+                    settings->recording_keyframe_interval * 1000);
     }
 
     /* Continue handling connections until error or client disconnect */
@@ -44,7 +44,7 @@
 #include <guacamole/audio.h>
 #include <guacamole/client.h>
 #include <guacamole/display.h>
-#include <guacamole/fifo.h>
+#include <guacamole/input.h>
 #include <guacamole/rwlock.h>
 #include <guacamole/recording.h>
 #include <winpr/wtypes.h>
@@ -71,6 +71,13 @@
  */
 #define GUAC_RDP_INPUT_EVENT_QUEUE_SIZE 4096
 
+/**
+ * The maximum number of mouse motion events per second to send to the RDP
+ * server. Motion received from users faster than this is merged within the
+ * input event queue, such that only the latest pointer location is sent.
+ */
+#define GUAC_RDP_MAX_MOTION_RATE 120
+
 /**
  * RDP-specific client data.
  */
@@ -138,14 +145,11 @@ typedef struct guac_rdp_client {
      * time within Guacamole's event handlers. If an attempt to send an RDP
      * event to the RDP server takes a noticable amount of time, that time will
      * otherwise block handling of Guacamole events, including critical events
-     * like "sync" (resulting in miscalculation of processing lag).
-     */
-    guac_fifo input_events;
-
-    /**
-     * Storage for the input_events queue (see above).
+     * like "sync" (resulting in miscalculation of processing lag). Mouse
+     * motion that accumulates within this queue is merged, and is sent no
+     * faster than GUAC_RDP_MAX_MOTION_RATE.
      */
-    guac_rdp_input_event input_events_items[GUAC_RDP_INPUT_EVENT_QUEUE_SIZE];
+    guac_input_queue* input_events;
 
     /**
      * FreeRDP event handle that is set with SetEvent() when at least one input
@@ -302,17 +306,21 @@ void* guac_rdp_client_thread(void* data);
  *     The input event to add to the queue.
  */
 void guac_rdp_input_event_enqueue(guac_rdp_client* rdp_client,
-        const guac_rdp_input_event* input_event);
+        const guac_input_event* input_event);
 
 /**
  * Processes all events that have been enqueued with
- * guac_rdp_input_event_enqueue(), clearing the event queue and the state of
- * the input_event_queued handle. Events are processed in the order they are
- * received.
+ * guac_rdp_input_event_enqueue(), in the order they were received. Mouse
+ * motion which would exceed GUAC_RDP_MAX_MOTION_RATE is left within the
+ * queue until it may be sent.
  *
  * @param rdp_client
  *     The RDP client instance whose queued input events should be processed.
+ *
+ * @return
+ *     The number of milliseconds until mouse motion left within the queue may
+ *     be sent, or -1 if the queue is now empty.
  */
-void guac_rdp_handle_input_events(guac_rdp_client* rdp_client);
+int guac_rdp_handle_input_events(guac_rdp_client* rdp_client);
 
 #endif
@@ -127,6 +127,9 @@ const char* GUAC_RDP_CLIENT_ARGS[] = {
     "recording-include-keys",
     "create-recording-path",
     "recording-write-existing",
+    "recording-compression",
+    "recording-overflow",
+    "recording-keyframe-interval",
     "resize-method",
     "enable-audio-input",
     "enable-touch",
@@ -151,6 +154,7 @@ const char* GUAC_RDP_CLIENT_ARGS[] = {
     "wol-wait-time",
 
     "force-lossless",
+    "tile-cache-size",
     "normalize-clipboard",
     NULL
 };
@@ -593,6 +597,25 @@ enum RDP_ARGS_IDX {
      */
     IDX_RECORDING_WRITE_EXISTING,
 
+    /**
+     * The compression to apply to the recording file ("none", "gzip", or
+     * "zstd"). The recording is not compressed by default.
+     */
+    IDX_RECORDING_COMPRESSION,
+
+    /**
+     * What to do if the recording falls too far behind the connection
+     * ("block", "drop", or "abort"). Output blocks by default.
+     */
+    IDX_RECORDING_OVERFLOW,
+
+    /**
+     * The number of seconds between keyframes written to the recording,
+     * allowing playback to begin partway through. Keyframes are not written
+     * by default.
+     */
+    IDX_RECORDING_KEYFRAME_INTERVAL,
+
     /**
      * The method to use to apply screen size changes requested by the user.
      * Valid values are blank, "display-update", and "reconnect".
@@ -719,6 +742,13 @@ enum RDP_ARGS_IDX {
      */
     IDX_FORCE_LOSSLESS,
 
+    /**
+     * The maximum amount of client-side memory that may be used to cache
+     * recently-sent tiles of image data, in kilobytes, or "0" to disable the
+     * cache. By default, GUAC_RDP_DEFAULT_TILE_CACHE_SIZE is used.
+     */
+    IDX_TILE_CACHE_SIZE,
+
     /**
      * Controls whether the text content of the clipboard should be
      * automatically normalized to use a particular line ending format. Valid
@@ -904,6 +934,19 @@ guac_rdp_settings* guac_rdp_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
                 IDX_FORCE_LOSSLESS, 0);
 
+    /* Tile cache size */
+    settings->tile_cache_size =
+        guac_user_parse_args_int(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_TILE_CACHE_SIZE, GUAC_RDP_DEFAULT_TILE_CACHE_SIZE);
+
+    /* Use default tile cache size if given one is invalid */
+    if (settings->tile_cache_size < 0) {
+        settings->tile_cache_size = GUAC_RDP_DEFAULT_TILE_CACHE_SIZE;
+        guac_user_log(user, GUAC_LOG_WARNING, "Invalid tile cache size: "
+                "\"%s\". Using the default size: %i KiB.",
+                argv[IDX_TILE_CACHE_SIZE], settings->tile_cache_size);
+    }
+
     /* Domain */
     settings->domain =
         guac_user_parse_args_string(user, GUAC_RDP_CLIENT_ARGS, argv,
@@ -1215,6 +1258,21 @@ guac_rdp_settings* guac_rdp_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
                 IDX_RECORDING_WRITE_EXISTING, 0);
 
+    /* Parse recording compression */
+    settings->recording_compression =
+        guac_user_parse_args_string(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_RECORDING_COMPRESSION, NULL);
+
+    /* Parse recording overflow policy */
+    settings->recording_overflow =
+        guac_user_parse_args_string(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_RECORDING_OVERFLOW, NULL);
+
+    /* Parse recording keyframe interval */
+    settings->recording_keyframe_interval =
+        guac_user_parse_args_int(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_RECORDING_KEYFRAME_INTERVAL, 0);
+
     /* No resize method */
     if (strcmp(argv[IDX_RESIZE_METHOD], "") == 0) {
         guac_user_log(user, GUAC_LOG_INFO, "Resize method: none");
@@ -1404,6 +1462,8 @@ void guac_rdp_settings_free(guac_rdp_settings* settings) {
     guac_mem_free(settings->preconnection_blob);
     guac_mem_free(settings->recording_name);
     guac_mem_free(settings->recording_path);
+    guac_mem_free(settings->recording_compression);
+    guac_mem_free(settings->recording_overflow);
     guac_mem_free(settings->remote_app);
     guac_mem_free(settings->remote_app_args);
     guac_mem_free(settings->remote_app_dir);
@@ -24,6 +24,7 @@
 
 #include <freerdp/freerdp.h>
 #include <guacamole/client.h>
+#include <guacamole/display-constants.h>
 #include <guacamole/user.h>
 
 /**
@@ -77,6 +78,12 @@
  */
 #define GUAC_RDP_DEFAULT_RECORDING_NAME "recording"
 
+/**
+ * The default maximum amount of client-side memory that may be used to cache
+ * recently-sent tiles of image data, in kilobytes.
+ */
+#define GUAC_RDP_DEFAULT_TILE_CACHE_SIZE (GUAC_DISPLAY_TILE_CACHE_DEFAULT_SIZE / 1024)
+
 /**
  * The number of entries contained within the OrderSupport BYTE array
  * referenced by the rdpSettings structure. This value is defined by the RDP
@@ -217,6 +224,13 @@ typedef struct guac_rdp_settings {
      */
     int lossless;
 
+    /**
+     * The maximum amount of client-side memory that may be used to cache
+     * recently-sent tiles of image data, in kilobytes, or zero if the cache
+     * is disabled.
+     */
+    int tile_cache_size;
+
     /**
      * Whether audio is enabled.
      */
@@ -595,6 +609,24 @@ typedef struct guac_rdp_settings {
      */
     int recording_write_existing;
 
+    /**
+     * The name of the compression to apply to the recording file, or NULL if
+     * the recording should not be compressed.
+     */
+    char* recording_compression;
+
+    /**
+     * The name of the policy to apply if the recording cannot keep up with
+     * the connection, or NULL if output should block.
+     */
+    char* recording_overflow;
+
+    /**
+     * The number of seconds between keyframes written to the recording, or
+     * zero if keyframes should not be written.
+     */
+    int recording_keyframe_interval;
+
     /** 
      * The method to apply when the user's display changes size.
      */
@@ -54,15 +54,8 @@ int guac_ssh_argv_callback(guac_user* user, const char* mimetype,
                     ssh_client->settings->resolution);
     }
 
-    /* Update SSH pty size if connected */
-    int term_width = guac_terminal_get_columns(terminal);
-    int term_height = guac_terminal_get_rows(terminal);
-    if (ssh_client->term_channel != NULL) {
-        pthread_mutex_lock(&(ssh_client->term_channel_lock));
-        libssh2_channel_request_pty_size(ssh_client->term_channel,
-                term_width, term_height);
-        pthread_mutex_unlock(&(ssh_client->term_channel_lock));
-    }
+    /* Any resulting change in terminal size is sent to the SSH server by
+     * guac_ssh_terminal_resize_handler() once applied */
 
     return 0;
 
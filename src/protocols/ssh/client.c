@@ -78,6 +78,9 @@ int guac_client_init(guac_client* client) {
     client->free_handler = guac_ssh_client_free_handler;
     client->leave_handler = guac_ssh_user_leave_handler;
 
+    /* Merge mouse motion arriving faster than the terminal can render it */
+    guac_client_coalesce_input(client, GUAC_TERMINAL_MAX_MOTION_RATE);
+
     /* Register handlers for argument values that may be sent after the handshake */
     guac_argv_register(GUAC_SSH_ARGV_COLOR_SCHEME, guac_ssh_argv_callback, NULL, GUAC_ARGV_OPTION_ECHO);
     guac_argv_register(GUAC_SSH_ARGV_FONT_NAME, guac_ssh_argv_callback, NULL, GUAC_ARGV_OPTION_ECHO);
@@ -113,6 +116,12 @@ int guac_ssh_client_free_handler(guac_client* client) {
 
         /* Wait ssh_client_thread to finish before freeing the terminal */
         pthread_join(ssh_client->client_thread, NULL);
+
+        /* Stop writing keyframes from the terminal */
+        if (ssh_client->recording != NULL)
+            guac_recording_set_keyframe_handler(ssh_client->recording,
+                    NULL, NULL);
+
         guac_terminal_free(ssh_client->term);
     }
 
@@ -19,6 +19,7 @@
 
 #include "config.h"
 
+#include "input.h"
 #include "ssh.h"
 #include "terminal/terminal.h"
 
@@ -79,18 +80,24 @@ int guac_ssh_user_size_handler(guac_user* user, int width, int height) {
     if (terminal == NULL)
         return 0;
 
-    /* Resize terminal */
+    /* Resize terminal (the SSH pty is updated once the resize is applied) */
     guac_terminal_resize(terminal, width, height);
 
+    return 0;
+}
+
+void guac_ssh_terminal_resize_handler(guac_client* client,
+        int columns, int rows) {
+
+    guac_ssh_client* ssh_client = (guac_ssh_client*) client->data;
+
     /* Update SSH pty size if connected */
     if (ssh_client->term_channel != NULL) {
         pthread_mutex_lock(&(ssh_client->term_channel_lock));
         libssh2_channel_request_pty_size(ssh_client->term_channel,
-                guac_terminal_get_columns(terminal),
-                guac_terminal_get_rows(terminal));
+                columns, rows);
         pthread_mutex_unlock(&(ssh_client->term_channel_lock));
     }
 
-    return 0;
 }
 
@@ -20,6 +20,8 @@
 #ifndef GUAC_SSH_INPUT_H
 #define GUAC_SSH_INPUT_H
 
+#include "terminal/terminal.h"
+
 #include <guacamole/user.h>
 
 /**
@@ -37,5 +39,12 @@ guac_user_key_handler guac_ssh_user_key_handler;
  */
 guac_user_size_handler guac_ssh_user_size_handler;
 
+/**
+ * Handler for terminal resizes. Called by the terminal whenever a resize
+ * changes its number of rows or columns, updating the size of the SSH pty
+ * accordingly.
+ */
+guac_terminal_resize_handler guac_ssh_terminal_resize_handler;
+
 #endif
 
@@ -67,12 +67,16 @@ const char* GUAC_SSH_CLIENT_ARGS[] = {
     "recording-include-keys",
     "create-recording-path",
     "recording-write-existing",
+    "recording-compression",
+    "recording-overflow",
+    "recording-keyframe-interval",
     "read-only",
     "server-alive-interval",
     "backspace",
     "func-keys-and-keypad",
     "terminal-type",
     "scrollback",
+    "scrollback-spill-path",
     "locale",
     "timezone",
     "clipboard-buffer-size",
@@ -264,6 +268,25 @@ enum SSH_ARGS_IDX {
      */
     IDX_RECORDING_WRITE_EXISTING,
 
+    /**
+     * The compression to apply to the recording file ("none", "gzip", or
+     * "zstd"). The recording is not compressed by default.
+     */
+    IDX_RECORDING_COMPRESSION,
+
+    /**
+     * What to do if the recording falls too far behind the connection
+     * ("block", "drop", or "abort"). Output blocks by default.
+     */
+    IDX_RECORDING_OVERFLOW,
+
+    /**
+     * The number of seconds between keyframes written to the recording,
+     * allowing playback to begin partway through. Keyframes are not written
+     * by default.
+     */
+    IDX_RECORDING_KEYFRAME_INTERVAL,
+
     /**
      * "true" if this connection should be read-only (user input should be
      * dropped), "false" or blank otherwise.
@@ -301,6 +324,13 @@ enum SSH_ARGS_IDX {
      */
     IDX_SCROLLBACK,
 
+    /**
+     * The directory in which a temporary file should be created to hold the
+     * compacted rows of scrollback which are not currently displayed. If
+     * omitted, those rows are held in memory.
+     */
+    IDX_SCROLLBACK_SPILL_PATH,
+
     /**
      * The locale that should be forwarded to the remote system via the LANG
      * environment variable. By default, no locale is forwarded. This setting
@@ -423,6 +453,11 @@ guac_ssh_settings* guac_ssh_parse_args(guac_user* user,
         guac_user_parse_args_int(user, GUAC_SSH_CLIENT_ARGS, argv,
                 IDX_SCROLLBACK, GUAC_TERMINAL_DEFAULT_MAX_SCROLLBACK);
 
+    /* Read directory for undisplayed scrollback, if any */
+    settings->scrollback_spill_path =
+        guac_user_parse_args_string(user, GUAC_SSH_CLIENT_ARGS, argv,
+                IDX_SCROLLBACK_SPILL_PATH, NULL);
+
     /* Read font name */
     settings->font_name =
         guac_user_parse_args_string(user, GUAC_SSH_CLIENT_ARGS, argv,
@@ -544,6 +579,21 @@ guac_ssh_settings* guac_ssh_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_SSH_CLIENT_ARGS, argv,
                 IDX_RECORDING_WRITE_EXISTING, false);
 
+    /* Parse recording compression */
+    settings->recording_compression =
+        guac_user_parse_args_string(user, GUAC_SSH_CLIENT_ARGS, argv,
+                IDX_RECORDING_COMPRESSION, NULL);
+
+    /* Parse recording overflow policy */
+    settings->recording_overflow =
+        guac_user_parse_args_string(user, GUAC_SSH_CLIENT_ARGS, argv,
+                IDX_RECORDING_OVERFLOW, NULL);
+
+    /* Parse recording keyframe interval */
+    settings->recording_keyframe_interval =
+        guac_user_parse_args_int(user, GUAC_SSH_CLIENT_ARGS, argv,
+                IDX_RECORDING_KEYFRAME_INTERVAL, 0);
+
     /* Parse server alive interval */
     settings->server_alive_interval =
         guac_user_parse_args_int(user, GUAC_SSH_CLIENT_ARGS, argv,
@@ -665,6 +715,9 @@ void guac_ssh_settings_free(guac_ssh_settings* settings) {
     /* Free SFTP settings */
     guac_mem_free(settings->sftp_root_directory);
 
+    /* Free scrollback settings */
+    guac_mem_free(settings->scrollback_spill_path);
+
     /* Free typescript settings */
     guac_mem_free(settings->typescript_name);
     guac_mem_free(settings->typescript_path);
@@ -672,6 +725,8 @@ void guac_ssh_settings_free(guac_ssh_settings* settings) {
     /* Free screen recording settings */
     guac_mem_free(settings->recording_name);
     guac_mem_free(settings->recording_path);
+    guac_mem_free(settings->recording_compression);
+    guac_mem_free(settings->recording_overflow);
 
     /* Free terminal emulator type. */
     guac_mem_free(settings->terminal_type);
@@ -22,6 +22,7 @@
 #include "argv.h"
 #include "common-ssh/sftp.h"
 #include "common-ssh/ssh.h"
+#include "input.h"
 #include "settings.h"
 #include "sftp.h"
 #include "ssh.h"
@@ -223,6 +224,20 @@ void* ssh_input_thread(void* data) {
 
 }
 
+/**
+ * Writes a keyframe to the session recording, copying the current state of
+ * the terminal.
+ *
+ * @param socket
+ *     The socket of the recording that should receive the keyframe.
+ *
+ * @param data
+ *     The guac_terminal of the SSH connection.
+ */
+static void guac_ssh_write_keyframe(guac_socket* socket, void* data) {
+    guac_terminal_write_keyframe((guac_terminal*) data, socket);
+}
+
 void* ssh_client_thread(void* data) {
 
     guac_client* client = (guac_client*) data;
@@ -286,7 +301,15 @@ void* ssh_client_thread(void* data) {
                 !settings->recording_exclude_mouse,
                 0, /* Touch events not supported */
                 settings->recording_include_keys,
-                settings->recording_write_existing);
+                settings->recording_write_existing,
+                settings->recording_compression,
+                settings->recording_overflow);
+
+        /* Write keyframes periodically, if requested */
+        if (ssh_client->recording != NULL
+                && settings->recording_keyframe_interval > 0)
+            guac_recording_enable_keyframes(ssh_client->recording,
+                    settings->recording_keyframe_interval * 1000);
     }
 
     /* Create terminal options with required parameters */
@@ -297,6 +320,7 @@ void* ssh_client_thread(void* data) {
     options->clipboard_buffer_size = settings->clipboard_buffer_size;
     options->disable_copy = settings->disable_copy;
     options->max_scrollback = settings->max_scrollback;
+    options->scrollback_spill_path = settings->scrollback_spill_path;
     options->font_name = settings->font_name;
     options->font_size = settings->font_size;
     options->color_scheme = settings->color_scheme;
@@ -316,6 +340,15 @@ void* ssh_client_thread(void* data) {
         return NULL;
     }
 
+    /* Update the SSH pty whenever the terminal is resized */
+    guac_terminal_set_resize_handler(ssh_client->term,
+            guac_ssh_terminal_resize_handler);
+
+    /* Keyframes copy the terminal */
+    if (ssh_client->recording != NULL)
+        guac_recording_set_keyframe_handler(ssh_client->recording,
+                guac_ssh_write_keyframe, ssh_client->term);
+
     /* Send current values of exposed arguments to owner only */
     guac_client_for_owner(client, guac_ssh_send_current_argv, ssh_client);
 
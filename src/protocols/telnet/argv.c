@@ -53,11 +53,8 @@ int guac_telnet_argv_callback(guac_user* user, const char* mimetype,
                     telnet_client->settings->resolution);
     }
 
-    /* Update terminal window size if connected */
-    if (telnet_client->telnet != NULL && telnet_client->naws_enabled)
-        guac_telnet_send_naws(telnet_client->telnet,
-                guac_terminal_get_columns(terminal),
-                guac_terminal_get_rows(terminal));
+    /* Any resulting change in terminal size is sent to the telnet server by
+     * guac_telnet_terminal_resize_handler() once applied */
 
     return 0;
 
@@ -83,6 +83,9 @@ int guac_client_init(guac_client* client) {
     client->free_handler = guac_telnet_client_free_handler;
     client->leave_handler = guac_telnet_user_leave_handler;
 
+    /* Merge mouse motion arriving faster than the terminal can render it */
+    guac_client_coalesce_input(client, GUAC_TERMINAL_MAX_MOTION_RATE);
+
     /* Register handlers for argument values that may be sent after the handshake */
     guac_argv_register(GUAC_TELNET_ARGV_COLOR_SCHEME, guac_telnet_argv_callback, NULL, GUAC_ARGV_OPTION_ECHO);
     guac_argv_register(GUAC_TELNET_ARGV_FONT_NAME, guac_telnet_argv_callback, NULL, GUAC_ARGV_OPTION_ECHO);
@@ -131,15 +131,21 @@ int guac_telnet_user_size_handler(guac_user* user, int width, int height) {
     if (terminal == NULL)
         return 0;
 
-    /* Resize terminal */
+    /* Resize terminal (the window size is sent once the resize is
+     * applied) */
     guac_terminal_resize(terminal, width, height);
 
+    return 0;
+}
+
+void guac_telnet_terminal_resize_handler(guac_client* client,
+        int columns, int rows) {
+
+    guac_telnet_client* telnet_client = (guac_telnet_client*) client->data;
+
     /* Update terminal window size if connected */
     if (telnet_client->telnet != NULL && telnet_client->naws_enabled)
-        guac_telnet_send_naws(telnet_client->telnet,
-                guac_terminal_get_columns(terminal),
-                guac_terminal_get_rows(terminal));
+        guac_telnet_send_naws(telnet_client->telnet, columns, rows);
 
-    return 0;
 }
 
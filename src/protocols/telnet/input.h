@@ -20,6 +20,8 @@
 #ifndef GUAC_TELNET_INPUT_H
 #define GUAC_TELNET_INPUT_H
 
+#include "terminal/terminal.h"
+
 #include <guacamole/user.h>
 
 /**
@@ -40,5 +42,12 @@ guac_user_mouse_handler guac_telnet_user_mouse_handler;
  */
 guac_user_size_handler guac_telnet_user_size_handler;
 
+/**
+ * Handler for terminal resizes. Called by the terminal whenever a resize
+ * changes its number of rows or columns, sending the new window size to the
+ * telnet server if NAWS has been negotiated.
+ */
+guac_terminal_resize_handler guac_telnet_terminal_resize_handler;
+
 #endif
 
@@ -133,6 +133,13 @@ typedef struct guac_telnet_settings {
      */
     int max_scrollback;
 
+    /**
+     * The directory in which a temporary file should be created to hold the
+     * rows of scrollback which are not currently displayed, or NULL if those
+     * rows should be held in memory.
+     */
+    char* scrollback_spill_path;
+
     /**
      * The name of the font to use for display rendering.
      */
@@ -254,6 +261,24 @@ typedef struct guac_telnet_settings {
      */
     bool recording_write_existing;
 
+    /**
+     * The name of the compression to apply to the recording file, or NULL if
+     * the recording should not be compressed.
+     */
+    char* recording_compression;
+
+    /**
+     * The name of the policy to apply if the recording cannot keep up with
+     * the connection, or NULL if output should block.
+     */
+    char* recording_overflow;
+
+    /**
+     * The number of seconds between keyframes written to the recording, or
+     * zero if keyframes should not be written.
+     */
+    int recording_keyframe_interval;
+
     /**
      * The ASCII code, as an integer, that the telnet client will use when the
      * backspace key is pressed.  By default, this is 127, ASCII delete, if
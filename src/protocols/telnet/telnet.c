@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include "argv.h"
+#include "input.h"
 #include "telnet.h"
 #include "terminal/terminal.h"
 
@@ -483,6 +484,20 @@ static int __guac_telnet_wait(int socket_fd) {
 
 }
 
+/**
+ * Writes a keyframe to the session recording, copying the current state of
+ * the terminal.
+ *
+ * @param socket
+ *     The socket of the recording that should receive the keyframe.
+ *
+ * @param data
+ *     The guac_terminal of the telnet connection.
+ */
+static void guac_telnet_write_keyframe(guac_socket* socket, void* data) {
+    guac_terminal_write_keyframe((guac_terminal*) data, socket);
+}
+
 void* guac_telnet_client_thread(void* data) {
 
     guac_client* client = (guac_client*) data;
@@ -537,7 +552,15 @@ void* guac_telnet_client_thread(void* data) {
                 !settings->recording_exclude_mouse,
                 0, /* Touch events not supported */
                 settings->recording_include_keys,
-                settings->recording_write_existing);
+                settings->recording_write_existing,
+                settings->recording_compression,
+                settings->recording_overflow);
+
+        /* Write keyframes periodically, if requested */
+        if (telnet_client->recording != NULL
+                && settings->recording_keyframe_interval > 0)
+            guac_recording_enable_keyframes(telnet_client->recording,
+                    settings->recording_keyframe_interval * 1000);
     }
 
     /* Create terminal options with required parameters */
@@ -548,6 +571,7 @@ void* guac_telnet_client_thread(void* data) {
     options->clipboard_buffer_size = settings->clipboard_buffer_size;
     options->disable_copy = settings->disable_copy;
     options->max_scrollback = settings->max_scrollback;
+    options->scrollback_spill_path = settings->scrollback_spill_path;
     options->font_name = settings->font_name;
     options->font_size = settings->font_size;
     options->color_scheme = settings->color_scheme;
@@ -567,6 +591,15 @@ void* guac_telnet_client_thread(void* data) {
         return NULL;
     }
 
+    /* Send the new window size whenever the terminal is resized */
+    guac_terminal_set_resize_handler(telnet_client->term,
+            guac_telnet_terminal_resize_handler);
+
+    /* Keyframes copy the terminal */
+    if (telnet_client->recording != NULL)
+        guac_recording_set_keyframe_handler(telnet_client->recording,
+                guac_telnet_write_keyframe, telnet_client->term);
+
     /* Send current values of exposed arguments to owner only */
     guac_client_for_owner(client, guac_telnet_send_current_argv,
             telnet_client);
@@ -79,7 +79,6 @@ static void* guac_vnc_sync_pending_user_audio(guac_user* user, void* data) {
 static int guac_vnc_join_pending_handler(guac_client* client) {
 
     guac_vnc_client* vnc_client = (guac_vnc_client*) client->data;
-    guac_socket* broadcast_socket = client->pending_socket;
 
 #ifdef ENABLE_PULSE
     /* Synchronize any audio stream for each pending user */
@@ -88,11 +87,11 @@ static int guac_vnc_join_pending_handler(guac_client* client) {
             client, guac_vnc_sync_pending_user_audio, vnc_client->audio);
 #endif
 
-    /* Synchronize with current display */
-    if (vnc_client->display != NULL) {
-        guac_display_dup(vnc_client->display, broadcast_socket);
-        guac_socket_flush(broadcast_socket);
-    }
+    /* Synchronize with current display, encoding the current display state
+     * in the background such that the connection is not stalled while users
+     * join */
+    if (vnc_client->display != NULL)
+        guac_display_dup_pending(vnc_client->display);
 
     return 0;
 
@@ -121,6 +120,9 @@ int guac_client_init(guac_client* client) {
     client->leave_handler = guac_vnc_user_leave_handler;
     client->free_handler = guac_vnc_client_free_handler;
 
+    /* Merge mouse motion arriving faster than it is useful to send */
+    guac_client_coalesce_input(client, GUAC_VNC_MAX_MOTION_RATE);
+
     return 0;
 }
 
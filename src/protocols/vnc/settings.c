@@ -89,6 +89,9 @@ const char* GUAC_VNC_CLIENT_ARGS[] = {
     "recording-include-keys",
     "create-recording-path",
     "recording-write-existing",
+    "recording-compression",
+    "recording-overflow",
+    "recording-keyframe-interval",
     "clipboard-buffer-size",
     "disable-copy",
     "disable-paste",
@@ -103,6 +106,7 @@ const char* GUAC_VNC_CLIENT_ARGS[] = {
     "force-lossless",
     "compress-level",
     "quality-level",
+    "tile-cache-size",
     NULL
 };
 
@@ -365,6 +369,25 @@ enum VNC_ARGS_IDX {
      */
     IDX_RECORDING_WRITE_EXISTING,
 
+    /**
+     * The compression to apply to the recording file ("none", "gzip", or
+     * "zstd"). The recording is not compressed by default.
+     */
+    IDX_RECORDING_COMPRESSION,
+
+    /**
+     * What to do if the recording falls too far behind the connection
+     * ("block", "drop", or "abort"). Output blocks by default.
+     */
+    IDX_RECORDING_OVERFLOW,
+
+    /**
+     * The number of seconds between keyframes written to the recording,
+     * allowing playback to begin partway through. Keyframes are not written
+     * by default.
+     */
+    IDX_RECORDING_KEYFRAME_INTERVAL,
+
     /**
      * The maximum number of bytes to allow within the clipboard.
      */
@@ -439,6 +462,13 @@ enum VNC_ARGS_IDX {
      */
     IDX_QUALITY_LEVEL,
 
+    /**
+     * The maximum amount of client-side memory that may be used to cache
+     * recently-sent tiles of image data, in kilobytes, or "0" to disable the
+     * cache. By default, GUAC_VNC_DEFAULT_TILE_CACHE_SIZE is used.
+     */
+    IDX_TILE_CACHE_SIZE,
+
     VNC_ARGS_COUNT
 };
 
@@ -523,6 +553,19 @@ guac_vnc_settings* guac_vnc_parse_args(guac_user* user,
         guac_user_parse_args_int(user, GUAC_VNC_CLIENT_ARGS, argv,
                 IDX_QUALITY_LEVEL, -1);
 
+    /* Tile cache size */
+    settings->tile_cache_size =
+        guac_user_parse_args_int(user, GUAC_VNC_CLIENT_ARGS, argv,
+                IDX_TILE_CACHE_SIZE, GUAC_VNC_DEFAULT_TILE_CACHE_SIZE);
+
+    /* Use default tile cache size if given one is invalid */
+    if (settings->tile_cache_size < 0) {
+        settings->tile_cache_size = GUAC_VNC_DEFAULT_TILE_CACHE_SIZE;
+        guac_user_log(user, GUAC_LOG_WARNING, "Invalid tile cache size: "
+                "\"%s\". Using the default size: %i KiB.",
+                argv[IDX_TILE_CACHE_SIZE], settings->tile_cache_size);
+    }
+
 #ifdef ENABLE_VNC_REPEATER
     /* Set repeater parameters if specified */
     settings->dest_host =
@@ -686,6 +729,21 @@ guac_vnc_settings* guac_vnc_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_VNC_CLIENT_ARGS, argv,
                 IDX_RECORDING_WRITE_EXISTING, false);
 
+    /* Parse recording compression */
+    settings->recording_compression =
+        guac_user_parse_args_string(user, GUAC_VNC_CLIENT_ARGS, argv,
+                IDX_RECORDING_COMPRESSION, NULL);
+
+    /* Parse recording overflow policy */
+    settings->recording_overflow =
+        guac_user_parse_args_string(user, GUAC_VNC_CLIENT_ARGS, argv,
+                IDX_RECORDING_OVERFLOW, NULL);
+
+    /* Parse recording keyframe interval */
+    settings->recording_keyframe_interval =
+        guac_user_parse_args_int(user, GUAC_VNC_CLIENT_ARGS, argv,
+                IDX_RECORDING_KEYFRAME_INTERVAL, 0);
+
     /* Parse clipboard copy disable flag */
     settings->disable_copy =
         guac_user_parse_args_boolean(user, GUAC_VNC_CLIENT_ARGS, argv,
@@ -766,6 +824,8 @@ void guac_vnc_settings_free(guac_vnc_settings* settings) {
     guac_mem_free(settings->password);
     guac_mem_free(settings->recording_name);
     guac_mem_free(settings->recording_path);
+    guac_mem_free(settings->recording_compression);
+    guac_mem_free(settings->recording_overflow);
     guac_mem_free(settings->username);
 
 #ifdef ENABLE_VNC_REPEATER
@@ -20,6 +20,8 @@
 #ifndef __GUAC_VNC_SETTINGS_H
 #define __GUAC_VNC_SETTINGS_H
 
+#include <guacamole/display-constants.h>
+
 #include <stdbool.h>
 
 /**
@@ -32,6 +34,12 @@
  */
 #define GUAC_VNC_DEFAULT_SFTP_TIMEOUT 10
 
+/**
+ * The default maximum amount of client-side memory that may be used to cache
+ * recently-sent tiles of image data, in kilobytes.
+ */
+#define GUAC_VNC_DEFAULT_TILE_CACHE_SIZE (GUAC_DISPLAY_TILE_CACHE_DEFAULT_SIZE / 1024)
+
 /**
  * VNC-specific client data.
  */
@@ -101,6 +109,13 @@ typedef struct guac_vnc_settings {
       */
     int quality_level;
 
+    /**
+     * The maximum amount of client-side memory that may be used to cache
+     * recently-sent tiles of image data, in kilobytes, or zero if the cache
+     * is disabled.
+     */
+    int tile_cache_size;
+
 #ifdef ENABLE_VNC_REPEATER
     /**
      * The VNC host to connect to, if using a repeater.
@@ -315,6 +330,24 @@ typedef struct guac_vnc_settings {
      * Disabled by default.
      */
     bool recording_write_existing;
+
+    /**
+     * The name of the compression to apply to the recording file, or NULL if
+     * the recording should not be compressed.
+     */
+    char* recording_compression;
+
+    /**
+     * The name of the policy to apply if the recording cannot keep up with
+     * the connection, or NULL if output should block.
+     */
+    char* recording_overflow;
+
+    /**
+     * The number of seconds between keyframes written to the recording, or
+     * zero if keyframes should not be written.
+     */
+    int recording_keyframe_interval;
     
     /**
      * Whether or not to send the magic Wake-on-LAN (WoL) packet prior to
@@ -346,6 +346,20 @@ static rfbBool guac_vnc_handle_messages(guac_client* client) {
 
 }
 
+/**
+ * Writes a keyframe to the session recording, copying the current state of
+ * the guac_display of the VNC connection.
+ *
+ * @param socket
+ *     The socket of the recording that should receive the keyframe.
+ *
+ * @param data
+ *     The guac_display of the VNC connection.
+ */
+static void guac_vnc_write_keyframe(guac_socket* socket, void* data) {
+    guac_display_dup((guac_display*) data, socket);
+}
+
 void* guac_vnc_client_thread(void* data) {
 
     guac_client* client = (guac_client*) data;
@@ -587,18 +601,35 @@ void* guac_vnc_client_thread(void* data) {
                 !settings->recording_exclude_mouse,
                 0, /* Touch events not supported */
                 settings->recording_include_keys,
-                settings->recording_write_existing);
+                settings->recording_write_existing,
+                settings->recording_compression,
+                settings->recording_overflow);
+
+        /* Write keyframes periodically, if requested */
+        if (vnc_client->recording != NULL
+                && settings->recording_keyframe_interval > 0)
+            guac_recording_enable_keyframes(vnc_client->recording,
+                    settings->recording_keyframe_interval * 1000);
     }
 
     /* Create display */
     vnc_client->display = guac_display_alloc(client);
     guac_display_layer_resize(guac_display_default_layer(vnc_client->display), rfb_client->width, rfb_client->height);
 
+    /* Keyframes copy the display (the recording is freed first) */
+    if (vnc_client->recording != NULL)
+        guac_recording_set_keyframe_handler(vnc_client->recording,
+                guac_vnc_write_keyframe, vnc_client->display);
+
     /* Use lossless compression only if requested (otherwise, use default
      * heuristics) */
     guac_display_layer_set_lossless(guac_display_default_layer(vnc_client->display),
             settings->lossless);
 
+    /* Size the cache of recently-sent tiles as requested */
+    guac_display_set_tile_cache_size(vnc_client->display,
+            (size_t) settings->tile_cache_size * 1024);
+
     /* If compression and display quality have been configured, set those. */
     if (settings->compress_level >= 0 && settings->compress_level <= 9)
         rfb_client->appData.compressLevel = settings->compress_level;
@@ -50,6 +50,13 @@
  */
 #define GUAC_VNC_SCREEN_ID 1
 
+/**
+ * The maximum number of mouse motion events per second to send to the VNC
+ * server. Motion received from users faster than this is merged, such that
+ * only the latest pointer location is sent.
+ */
+#define GUAC_VNC_MAX_MOTION_RATE 120
+
 /**
  * VNC-specific client data.
  */
@@ -39,6 +39,9 @@ int guac_client_init(guac_client* client) {
     client->leave_handler = guac_xorg_user_leave_handler;
     client->free_handler = guac_xorg_client_free_handler;
 
+    /* Merge mouse motion arriving faster than it is useful to inject */
+    guac_client_coalesce_input(client, GUAC_XORG_MAX_MOTION_RATE);
+
     return 0;
 }
 
@@ -34,6 +34,13 @@
 #include <pthread.h>
 #include <time.h>
 
+/**
+ * The maximum number of mouse motion events per second to inject into the X
+ * server. Motion received from users faster than this is merged, such that
+ * only the latest pointer location is injected.
+ */
+#define GUAC_XORG_MAX_MOTION_RATE 120
+
 typedef struct guac_xorg_client {
 
     guac_xorg_settings* settings;
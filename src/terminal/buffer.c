@@ -19,6 +19,8 @@
 
 #include "terminal/buffer.h"
 #include "terminal/common.h"
+#include "terminal/compact-row.h"
+#include "terminal/spill-file.h"
 #include "terminal/terminal.h"
 
 #include <guacamole/assert.h>
@@ -36,15 +38,27 @@
 #define GUAC_TERMINAL_BUFFER_ROW_MIN_SIZE 256
 
 /**
- * A single variable-length row of terminal data.
+ * A single variable-length row of terminal data. Each row is stored either
+ * decoded, as an array of guac_terminal_char, or in the compact form
+ * produced by guac_terminal_compact_row_encode(). Rows are decoded as soon as
+ * they are accessed, and are returned to compact form by
+ * guac_terminal_buffer_compact() once they are no longer being displayed.
  */
 typedef struct guac_terminal_buffer_row {
 
     /**
-     * Array of guac_terminal_char representing the contents of the row.
+     * Array of guac_terminal_char representing the contents of the row, or
+     * NULL if the row is not currently decoded.
      */
     guac_terminal_char* characters;
 
+    /**
+     * The contents of the row in compact form, or NULL if the row is decoded
+     * or empty. If the row has been spilled, this points within the spill
+     * file of the buffer.
+     */
+    unsigned char* encoded;
+
     /**
      * The length of this row in characters. This is the number of initialized
      * characters in the buffer, usually equal to the number of characters
@@ -64,6 +78,12 @@ typedef struct guac_terminal_buffer_row {
      */
     bool wrapped_row;
 
+    /**
+     * Whether the compact form of this row is stored within the spill file
+     * of the buffer (as opposed to the heap).
+     */
+    bool spilled;
+
 } guac_terminal_buffer_row;
 
 struct guac_terminal_buffer {
@@ -99,6 +119,33 @@ struct guac_terminal_buffer {
      */
     unsigned int available;
 
+    /**
+     * The indices (within the rows array) of all rows that are currently
+     * decoded.
+     */
+    unsigned int* decoded_rows;
+
+    /**
+     * The number of rows within the decoded_rows array.
+     */
+    unsigned int decoded_count;
+
+    /**
+     * The number of elements allocated for the decoded_rows array.
+     */
+    unsigned int decoded_available;
+
+    /**
+     * The file receiving the compact form of rows, or NULL if compact rows
+     * are stored within the heap.
+     */
+    guac_terminal_spill_file* spill;
+
+    /**
+     * The total number of bytes allocated within the heap for compact rows.
+     */
+    size_t encoded_size;
+
 };
 
 guac_terminal_buffer* guac_terminal_buffer_alloc(int rows,
@@ -108,32 +155,50 @@ guac_terminal_buffer* guac_terminal_buffer_alloc(int rows,
     guac_terminal_buffer* buffer =
         guac_mem_alloc(sizeof(guac_terminal_buffer));
 
-    int i;
-    guac_terminal_buffer_row* row;
-
     /* Init scrollback data */
     buffer->default_character = *default_character;
     buffer->available = rows;
     buffer->top = 0;
     buffer->length = 0;
-    buffer->rows = guac_mem_alloc(sizeof(guac_terminal_buffer_row), buffer->available);
 
-    /* Init scrollback rows */
-    row = buffer->rows;
-    for (i=0; i<rows; i++) {
+    /* Rows are allocated only once written (or otherwise accessed) */
+    buffer->rows = guac_mem_zalloc(sizeof(guac_terminal_buffer_row), buffer->available);
+    buffer->decoded_rows = NULL;
+    buffer->decoded_count = 0;
+    buffer->decoded_available = 0;
+    buffer->spill = NULL;
+    buffer->encoded_size = 0;
 
-        /* Allocate row  */
-        row->available = GUAC_TERMINAL_BUFFER_ROW_MIN_SIZE;
-        row->length = 0;
-        row->wrapped_row = false;
-        row->characters = guac_mem_alloc(sizeof(guac_terminal_char), row->available);
+    return buffer;
 
-        /* Next row */
-        row++;
+}
 
+/**
+ * Frees the compact form of the given row, if any.
+ *
+ * @param buffer
+ *     The buffer containing the row.
+ *
+ * @param row
+ *     The row whose compact form should be freed.
+ */
+static void guac_terminal_buffer_row_free_encoded(guac_terminal_buffer* buffer,
+        guac_terminal_buffer_row* row) {
+
+    if (row->encoded == NULL)
+        return;
+
+    size_t size = guac_terminal_compact_row_size(row->encoded);
+
+    if (row->spilled)
+        guac_terminal_spill_file_release(buffer->spill, row->encoded, size);
+    else {
+        buffer->encoded_size -= size;
+        guac_mem_free(row->encoded);
     }
 
-    return buffer;
+    row->encoded = NULL;
+    row->spilled = false;
 
 }
 
@@ -145,23 +210,158 @@ void guac_terminal_buffer_free(guac_terminal_buffer* buffer) {
     /* Free all rows */
     for (i=0; i<buffer->available; i++) {
         guac_mem_free(row->characters);
+        guac_terminal_buffer_row_free_encoded(buffer, row);
         row++;
     }
 
+    /* Free spill file only after all rows within it are released */
+    if (buffer->spill != NULL)
+        guac_terminal_spill_file_free(buffer->spill);
+
     /* Free actual buffer */
+    guac_mem_free(buffer->decoded_rows);
     guac_mem_free(buffer->rows);
     guac_mem_free(buffer);
 
 }
 
+int guac_terminal_buffer_enable_spill(guac_terminal_buffer* buffer,
+        const char* path) {
+
+    /* Only one spill file is needed */
+    if (buffer->spill != NULL)
+        return 0;
+
+    buffer->spill = guac_terminal_spill_file_alloc(path);
+    if (buffer->spill == NULL)
+        return 1;
+
+    return 0;
+
+}
+
 void guac_terminal_buffer_reset(guac_terminal_buffer* buffer) {
     buffer->top = 0;
     buffer->length = 0;
 }
 
 /**
- * Returns the row at the given location. The row returned is guaranteed to be at least the given
- * width.
+ * Rounds the given value up to the nearest possible row length. To avoid
+ * unnecessary, repeated resizing of rows, each row length is rounded up to the
+ * nearest power of two.
+ *
+ * @param value
+ *     The value to round.
+ *
+ * @return
+ *     The power of two that is closest to the given value without exceeding
+ *     that value.
+ */
+static unsigned int guac_terminal_buffer_row_length(int value) {
+
+    GUAC_ASSERT(value >= 0);
+    GUAC_ASSERT(value <= GUAC_TERMINAL_MAX_COLUMNS);
+
+    unsigned int rounded = GUAC_TERMINAL_BUFFER_ROW_MIN_SIZE;
+    while (rounded < value)
+        rounded <<= 1;
+
+    return rounded;
+
+}
+
+/**
+ * Decodes the given row, allocating space for its characters. The row is
+ * recorded as decoded such that guac_terminal_buffer_compact() may later
+ * return it to compact form. Rows which are already decoded are left
+ * untouched.
+ *
+ * @param buffer
+ *     The buffer containing the row.
+ *
+ * @param index
+ *     The index of the row within the rows array of the buffer.
+ */
+static void guac_terminal_buffer_row_decode(guac_terminal_buffer* buffer,
+        unsigned int index) {
+
+    guac_terminal_buffer_row* row = &(buffer->rows[index]);
+    if (row->characters != NULL)
+        return;
+
+    row->available = guac_terminal_buffer_row_length(row->length);
+    row->characters = guac_mem_alloc(sizeof(guac_terminal_char), row->available);
+
+    /* Restore contents, if any, initializing remaining space as
+     * guac_terminal_buffer_row_expand() would */
+    int length = 0;
+    if (row->encoded != NULL) {
+        length = guac_terminal_compact_row_length(row->encoded);
+        guac_terminal_compact_row_decode(row->encoded, row->characters);
+        guac_terminal_buffer_row_free_encoded(buffer, row);
+    }
+
+    for (int i = length; i < row->available; i++)
+        row->characters[i] = buffer->default_character;
+
+    /* Record row as decoded, expanding array as needed */
+    if (buffer->decoded_count == buffer->decoded_available) {
+        buffer->decoded_available = buffer->decoded_available * 2 + 16;
+        buffer->decoded_rows = guac_mem_realloc_or_die(buffer->decoded_rows,
+                sizeof(unsigned int), buffer->decoded_available);
+    }
+
+    buffer->decoded_rows[buffer->decoded_count++] = index;
+
+}
+
+/**
+ * Returns the given row to compact form, freeing the space allocated for its
+ * decoded characters. Empty rows are not stored at all. If the compact row
+ * cannot be stored within the spill file, it is stored within the heap.
+ *
+ * @param buffer
+ *     The buffer containing the row.
+ *
+ * @param row
+ *     The row to encode.
+ */
+static void guac_terminal_buffer_row_encode(guac_terminal_buffer* buffer,
+        guac_terminal_buffer_row* row) {
+
+    unsigned char encoded[GUAC_TERMINAL_COMPACT_ROW_MAX_SIZE];
+
+    if (row->characters == NULL)
+        return;
+
+    if (row->length > 0) {
+
+        size_t size = guac_terminal_compact_row_encode(row->characters,
+                row->length, encoded);
+
+        /* Prefer the spill file, if enabled */
+        if (buffer->spill != NULL) {
+            row->encoded = guac_terminal_spill_file_store(buffer->spill,
+                    encoded, size);
+            row->spilled = (row->encoded != NULL);
+        }
+
+        if (row->encoded == NULL) {
+            row->encoded = guac_mem_alloc(size);
+            memcpy(row->encoded, encoded, size);
+            buffer->encoded_size += size;
+        }
+
+    }
+
+    guac_mem_free(row->characters);
+    row->characters = NULL;
+    row->available = 0;
+
+}
+
+/**
+ * Returns the row at the given location, decoding that row if necessary.
  *
  * @param buffer
  *     The buffer to retrieve a row from.
@@ -181,32 +381,58 @@ static guac_terminal_buffer_row* guac_terminal_buffer_get_row(guac_terminal_buff
 
     /* Normalize row index into a scrollback buffer index */
     unsigned int index = (buffer->top + row) % buffer->available;
+
+    guac_terminal_buffer_row_decode(buffer, index);
     return &(buffer->rows[index]);
 
 }
 
-/**
- * Rounds the given value up to the nearest possible row length. To avoid
- * unnecessary, repeated resizing of rows, each row length is rounded up to the
- * nearest power of two.
- *
- * @param value
- *     The value to round.
- *
- * @return
- *     The power of two that is closest to the given value without exceeding
- *     that value.
- */
-static unsigned int guac_terminal_buffer_row_length(int value) {
+void guac_terminal_buffer_compact(guac_terminal_buffer* buffer,
+        int start_row, int end_row) {
 
-    GUAC_ASSERT(value >= 0);
-    GUAC_ASSERT(value <= GUAC_TERMINAL_MAX_COLUMNS);
+    unsigned int span = end_row - start_row;
 
-    unsigned int rounded = GUAC_TERMINAL_BUFFER_ROW_MIN_SIZE;
-    while (rounded < value)
-        rounded <<= 1;
+    /* Nothing can be compacted if the entire buffer must remain decoded */
+    if (end_row < start_row || span >= buffer->available - 1)
+        return;
 
-    return rounded;
+    /* Index of the first row which must remain decoded */
+    unsigned int first = (buffer->top + buffer->available
+            + (start_row % (int) buffer->available)) % buffer->available;
+
+    unsigned int i = 0;
+    while (i < buffer->decoded_count) {
+
+        unsigned int index = buffer->decoded_rows[i];
+
+        /* Leave rows within the given range decoded */
+        unsigned int offset = (index + buffer->available - first) % buffer->available;
+        if (offset <= span) {
+            i++;
+            continue;
+        }
+
+        /* Encode all other rows, replacing each with the last entry of the
+         * decoded_rows array */
+        guac_terminal_buffer_row_encode(buffer, &(buffer->rows[index]));
+        buffer->decoded_rows[i] = buffer->decoded_rows[--buffer->decoded_count];
+
+    }
+
+}
+
+void guac_terminal_buffer_get_usage(guac_terminal_buffer* buffer,
+        guac_terminal_buffer_usage* usage) {
+
+    usage->rows = sizeof(guac_terminal_buffer_row) * buffer->available;
+    usage->decoded = 0;
+    usage->encoded = buffer->encoded_size;
+    usage->spilled = (buffer->spill != NULL) ? buffer->spill->allocated : 0;
+
+    for (unsigned int i = 0; i < buffer->decoded_count; i++) {
+        guac_terminal_buffer_row* row = &(buffer->rows[buffer->decoded_rows[i]]);
+        usage->decoded += sizeof(guac_terminal_char) * row->available;
+    }
 
 }
 
@@ -523,6 +749,41 @@ void guac_terminal_buffer_set_columns(guac_terminal_buffer* buffer, int row,
 
 }
 
+void guac_terminal_buffer_set_span(guac_terminal_buffer* buffer, int row,
+        int start_column, const guac_terminal_char* characters, int length) {
+
+    /* Do nothing if there's nothing to do or if nothing sanely can be done */
+    if (length <= 0 || start_column < 0 || start_column >= GUAC_TERMINAL_MAX_COLUMNS
+            || row >= GUAC_TERMINAL_MAX_ROWS || row <= -GUAC_TERMINAL_MAX_ROWS)
+        return;
+
+    guac_terminal_buffer_row* buffer_row = guac_terminal_buffer_get_row(buffer, row);
+    if (buffer_row == NULL)
+        return;
+
+    /* Drop any portion of the run lying beyond the maximum row width */
+    if (length > GUAC_TERMINAL_MAX_COLUMNS - start_column)
+        length = GUAC_TERMINAL_MAX_COLUMNS - start_column;
+
+    int end_column = start_column + length - 1;
+
+    guac_terminal_buffer_row_expand(buffer_row, end_column + 1, &buffer->default_character);
+    GUAC_ASSERT(buffer_row->length >= end_column + 1);
+
+    memcpy(&(buffer_row->characters[start_column]), characters,
+            sizeof(guac_terminal_char) * length);
+
+    /* Update length depending on row written */
+    if (characters->value != 0 && row >= buffer->length)
+        buffer->length = row + 1;
+
+    /* Force breaks around destination region (the boundaries between
+     * characters within the run are already intact) */
+    guac_terminal_buffer_force_break(buffer, row, start_column);
+    guac_terminal_buffer_force_break(buffer, row, end_column + 1);
+
+}
+
 void guac_terminal_buffer_set_cursor(guac_terminal_buffer* buffer, int row,
         int column, bool is_cursor) {
 
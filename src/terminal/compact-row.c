@@ -0,0 +1,403 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "terminal/compact-row.h"
+#include "terminal/palette.h"
+#include "terminal/types.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Offset of the total size of the encoded row (uint16_t) within the header.
+ */
+#define GUAC_TERMINAL_COMPACT_ROW_SIZE_OFFSET 0
+
+/**
+ * Offset of the number of characters within the row (uint16_t) within the
+ * header.
+ */
+#define GUAC_TERMINAL_COMPACT_ROW_LENGTH_OFFSET 2
+
+/**
+ * Offset of the number of attribute runs (uint16_t) within the header.
+ */
+#define GUAC_TERMINAL_COMPACT_ROW_RUNS_OFFSET 4
+
+/**
+ * Offset of the number of bytes used to store each codepoint (uint8_t)
+ * within the header.
+ */
+#define GUAC_TERMINAL_COMPACT_ROW_VALUE_SIZE_OFFSET 6
+
+/**
+ * Flag bit within an attribute run denoting bold text.
+ */
+#define GUAC_TERMINAL_COMPACT_ROW_BOLD 0x01
+
+/**
+ * Flag bit within an attribute run denoting half-bright text.
+ */
+#define GUAC_TERMINAL_COMPACT_ROW_HALF_BRIGHT 0x02
+
+/**
+ * Flag bit within an attribute run denoting the cursor.
+ */
+#define GUAC_TERMINAL_COMPACT_ROW_CURSOR 0x04
+
+/**
+ * Flag bit within an attribute run denoting reverse video.
+ */
+#define GUAC_TERMINAL_COMPACT_ROW_REVERSE 0x08
+
+/**
+ * Flag bit within an attribute run denoting underscored text.
+ */
+#define GUAC_TERMINAL_COMPACT_ROW_UNDERSCORE 0x10
+
+/**
+ * Stores the given 16-bit value at the given, possibly unaligned, location.
+ *
+ * @param dst
+ *     The location to write to.
+ *
+ * @param value
+ *     The value to write.
+ */
+static void guac_terminal_compact_row_put16(unsigned char* dst, uint16_t value) {
+    memcpy(dst, &value, sizeof(value));
+}
+
+/**
+ * Reads the 16-bit value stored at the given, possibly unaligned, location.
+ *
+ * @param src
+ *     The location to read from.
+ *
+ * @return
+ *     The value read.
+ */
+static uint16_t guac_terminal_compact_row_get16(const unsigned char* src) {
+    uint16_t value;
+    memcpy(&value, src, sizeof(value));
+    return value;
+}
+
+/**
+ * Stores the given color at the given, possibly unaligned, location, using
+ * 7 bytes.
+ *
+ * @param dst
+ *     The location to write to.
+ *
+ * @param color
+ *     The color to write.
+ *
+ * @return
+ *     The location immediately following the color written.
+ */
+static unsigned char* guac_terminal_compact_row_put_color(unsigned char* dst,
+        const guac_terminal_color* color) {
+
+    int32_t palette_index = color->palette_index;
+    memcpy(dst, &palette_index, sizeof(palette_index));
+    dst += sizeof(palette_index);
+
+    *(dst++) = color->red;
+    *(dst++) = color->green;
+    *(dst++) = color->blue;
+
+    return dst;
+
+}
+
+/**
+ * Reads the color stored at the given, possibly unaligned, location by
+ * guac_terminal_compact_row_put_color().
+ *
+ * @param src
+ *     The location to read from.
+ *
+ * @param color
+ *     The color which should receive the value read.
+ *
+ * @return
+ *     The location immediately following the color read.
+ */
+static const unsigned char* guac_terminal_compact_row_get_color(
+        const unsigned char* src, guac_terminal_color* color) {
+
+    int32_t palette_index;
+    memcpy(&palette_index, src, sizeof(palette_index));
+    src += sizeof(palette_index);
+
+    color->palette_index = palette_index;
+    color->red   = *(src++);
+    color->green = *(src++);
+    color->blue  = *(src++);
+
+    return src;
+
+}
+
+/**
+ * Returns whether the given sets of attributes are identical. Attributes are
+ * compared field by field, as guac_terminal_attributes contains bitfields and
+ * padding that cannot be compared with memcmp().
+ *
+ * @param a
+ *     The first set of attributes to compare.
+ *
+ * @param b
+ *     The second set of attributes to compare.
+ *
+ * @return
+ *     true if the given attributes are identical, false otherwise.
+ */
+static bool guac_terminal_compact_row_same_attributes(
+        const guac_terminal_attributes* a, const guac_terminal_attributes* b) {
+
+    return a->bold == b->bold
+        && a->half_bright == b->half_bright
+        && a->cursor == b->cursor
+        && a->reverse == b->reverse
+        && a->underscore == b->underscore
+        && a->foreground.palette_index == b->foreground.palette_index
+        && a->foreground.red   == b->foreground.red
+        && a->foreground.green == b->foreground.green
+        && a->foreground.blue  == b->foreground.blue
+        && a->background.palette_index == b->background.palette_index
+        && a->background.red   == b->background.red
+        && a->background.green == b->background.green
+        && a->background.blue  == b->background.blue;
+
+}
+
+/**
+ * Stores an attribute run at the given location.
+ *
+ * @param dst
+ *     The location to write to.
+ *
+ * @param count
+ *     The number of characters within the run.
+ *
+ * @param width
+ *     The width of each non-continuation character within the run, or -1 if
+ *     the run contains only GUAC_CHAR_CONTINUATION characters.
+ *
+ * @param attributes
+ *     The attributes shared by all characters within the run.
+ *
+ * @return
+ *     The location immediately following the run written.
+ */
+static unsigned char* guac_terminal_compact_row_put_run(unsigned char* dst,
+        int count, int width, const guac_terminal_attributes* attributes) {
+
+    guac_terminal_compact_row_put16(dst, count);
+    dst += 2;
+
+    *(dst++) = (width < 0) ? 0 : width;
+    *(dst++) = (attributes->bold        ? GUAC_TERMINAL_COMPACT_ROW_BOLD        : 0)
+             | (attributes->half_bright ? GUAC_TERMINAL_COMPACT_ROW_HALF_BRIGHT : 0)
+             | (attributes->cursor      ? GUAC_TERMINAL_COMPACT_ROW_CURSOR      : 0)
+             | (attributes->reverse     ? GUAC_TERMINAL_COMPACT_ROW_REVERSE     : 0)
+             | (attributes->underscore  ? GUAC_TERMINAL_COMPACT_ROW_UNDERSCORE  : 0);
+
+    dst = guac_terminal_compact_row_put_color(dst, &attributes->foreground);
+    dst = guac_terminal_compact_row_put_color(dst, &attributes->background);
+
+    return dst;
+
+}
+
+size_t guac_terminal_compact_row_encode(const guac_terminal_char* characters,
+        int length, unsigned char* encoded) {
+
+    /* Codepoints are stored offset by one such that GUAC_CHAR_CONTINUATION
+     * (-1) is stored as zero */
+    uint32_t max_value = 0;
+    for (int i = 0; i < length; i++) {
+        uint32_t value = (uint32_t) characters[i].value + 1;
+        if (value > max_value)
+            max_value = value;
+    }
+
+    /* Use narrowest storage that can represent all codepoints */
+    int value_size = 4;
+    if (max_value <= UINT8_MAX)
+        value_size = 1;
+    else if (max_value <= UINT16_MAX)
+        value_size = 2;
+
+    unsigned char* values = encoded + GUAC_TERMINAL_COMPACT_ROW_HEADER_SIZE;
+    unsigned char* runs = values + length * value_size;
+    unsigned char* current_run = runs;
+    int run_count = 0;
+
+    /* Store codepoints, grouping characters into runs of attributes */
+    const guac_terminal_char* run_start = characters;
+    int run_length = 0;
+    int run_width = -1;
+    for (int i = 0; i < length; i++) {
+
+        const guac_terminal_char* character = &characters[i];
+        uint32_t value = (uint32_t) character->value + 1;
+
+        switch (value_size) {
+
+            case 1:
+                values[i] = value;
+                break;
+
+            case 2:
+                guac_terminal_compact_row_put16(values + i * 2, value);
+                break;
+
+            default:
+                memcpy(values + i * 4, &value, sizeof(value));
+                break;
+
+        }
+
+        /* Continuations have no applicable width and may thus join any run
+         * having the same attributes (a run consisting only of continuations
+         * has a width of -1 until its first other character is reached) */
+        bool continuation = (character->value == GUAC_CHAR_CONTINUATION);
+
+        /* Extend current run if possible */
+        if (run_length > 0
+                && (continuation || run_width == -1 || character->width == run_width)
+                && guac_terminal_compact_row_same_attributes(
+                    &run_start->attributes, &character->attributes)) {
+
+            if (!continuation)
+                run_width = character->width;
+
+            run_length++;
+            continue;
+
+        }
+
+        /* Otherwise, store current run and begin a new run */
+        if (run_length > 0) {
+            current_run = guac_terminal_compact_row_put_run(current_run,
+                    run_length, run_width, &run_start->attributes);
+            run_count++;
+        }
+
+        run_start = character;
+        run_length = 1;
+        run_width = continuation ? -1 : character->width;
+
+    }
+
+    /* Store final run */
+    if (run_length > 0) {
+        current_run = guac_terminal_compact_row_put_run(current_run,
+                run_length, run_width, &run_start->attributes);
+        run_count++;
+    }
+
+    size_t size = current_run - encoded;
+
+    guac_terminal_compact_row_put16(encoded + GUAC_TERMINAL_COMPACT_ROW_SIZE_OFFSET, size);
+    guac_terminal_compact_row_put16(encoded + GUAC_TERMINAL_COMPACT_ROW_LENGTH_OFFSET, length);
+    guac_terminal_compact_row_put16(encoded + GUAC_TERMINAL_COMPACT_ROW_RUNS_OFFSET, run_count);
+    encoded[GUAC_TERMINAL_COMPACT_ROW_VALUE_SIZE_OFFSET] = value_size;
+
+    return size;
+
+}
+
+size_t guac_terminal_compact_row_size(const unsigned char* encoded) {
+    return guac_terminal_compact_row_get16(encoded + GUAC_TERMINAL_COMPACT_ROW_SIZE_OFFSET);
+}
+
+int guac_terminal_compact_row_length(const unsigned char* encoded) {
+    return guac_terminal_compact_row_get16(encoded + GUAC_TERMINAL_COMPACT_ROW_LENGTH_OFFSET);
+}
+
+void guac_terminal_compact_row_decode(const unsigned char* encoded,
+        guac_terminal_char* characters) {
+
+    int length = guac_terminal_compact_row_length(encoded);
+    int run_count = guac_terminal_compact_row_get16(encoded + GUAC_TERMINAL_COMPACT_ROW_RUNS_OFFSET);
+    int value_size = encoded[GUAC_TERMINAL_COMPACT_ROW_VALUE_SIZE_OFFSET];
+
+    const unsigned char* values = encoded + GUAC_TERMINAL_COMPACT_ROW_HEADER_SIZE;
+    const unsigned char* run = values + length * value_size;
+
+    /* Restore codepoints */
+    for (int i = 0; i < length; i++) {
+
+        uint32_t value;
+        switch (value_size) {
+
+            case 1:
+                value = values[i];
+                break;
+
+            case 2:
+                value = guac_terminal_compact_row_get16(values + i * 2);
+                break;
+
+            default:
+                memcpy(&value, values + i * 4, sizeof(value));
+                break;
+
+        }
+
+        characters[i].value = (int) (value - 1);
+
+    }
+
+    /* Restore attributes and widths of each run */
+    guac_terminal_char* character = characters;
+    for (int i = 0; i < run_count; i++) {
+
+        int count = guac_terminal_compact_row_get16(run);
+        int width = run[2];
+        int flags = run[3];
+
+        guac_terminal_attributes attributes = {
+            .bold        = (flags & GUAC_TERMINAL_COMPACT_ROW_BOLD)        != 0,
+            .half_bright = (flags & GUAC_TERMINAL_COMPACT_ROW_HALF_BRIGHT) != 0,
+            .cursor      = (flags & GUAC_TERMINAL_COMPACT_ROW_CURSOR)      != 0,
+            .reverse     = (flags & GUAC_TERMINAL_COMPACT_ROW_REVERSE)     != 0,
+            .underscore  = (flags & GUAC_TERMINAL_COMPACT_ROW_UNDERSCORE)  != 0
+        };
+
+        run = guac_terminal_compact_row_get_color(run + 4, &attributes.foreground);
+        run = guac_terminal_compact_row_get_color(run, &attributes.background);
+
+        for (int j = 0; j < count; j++, character++) {
+            character->attributes = attributes;
+            character->width = (character->value == GUAC_CHAR_CONTINUATION) ? 0 : width;
+        }
+
+    }
+
+}
+
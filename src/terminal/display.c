@@ -22,18 +22,18 @@
 #include "common/surface.h"
 #include "terminal/common.h"
 #include "terminal/display.h"
+#include "terminal/glyph-atlas.h"
+#include "terminal/glyph-cache.h"
 #include "terminal/palette.h"
 #include "terminal/terminal.h"
 #include "terminal/terminal-priv.h"
 #include "terminal/types.h"
 
-#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
 
 #include <cairo/cairo.h>
-#include <glib-object.h>
 #include <guacamole/assert.h>
 #include <guacamole/client.h>
 #include <guacamole/mem.h>
@@ -107,27 +107,8 @@ int __guac_terminal_set_colors(guac_terminal_display* display,
  */
 int __guac_terminal_set(guac_terminal_display* display, int row, int col, int codepoint) {
 
-    int width;
-
-    int bytes;
-    char utf8[4];
-
-    /* Use foreground color */
-    const guac_terminal_color* color = &display->glyph_foreground;
-
-    /* Use background color */
-    const guac_terminal_color* background = &display->glyph_background;
-
-    cairo_surface_t* surface;
-    cairo_t* cairo;
-    int surface_width, surface_height;
-   
-    PangoLayout* layout;
-    int layout_width, layout_height;
-    int ideal_layout_width, ideal_layout_height;
-
     /* Calculate width in columns */
-    width = wcwidth(codepoint);
+    int width = wcwidth(codepoint);
     if (width < 0)
         width = 1;
 
@@ -135,60 +116,13 @@ int __guac_terminal_set(guac_terminal_display* display, int row, int col, int co
     if (width == 0)
         return 0;
 
-    /* Convert to UTF-8 */
-    bytes = guac_terminal_encode_utf8(codepoint, utf8);
-
-    surface_width = width * display->char_width;
-    surface_height = display->char_height;
-
-    ideal_layout_width = surface_width * PANGO_SCALE;
-    ideal_layout_height = surface_height * PANGO_SCALE;
-
-    /* Prepare surface */
-    surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
-                                         surface_width, surface_height);
-    cairo = cairo_create(surface);
-
-    /* Fill background */
-    cairo_set_source_rgb(cairo,
-            background->red   / 255.0,
-            background->green / 255.0,
-            background->blue  / 255.0);
-
-    cairo_rectangle(cairo, 0, 0, surface_width, surface_height); 
-    cairo_fill(cairo);
-
-    /* Get layout */
-    layout = pango_cairo_create_layout(cairo);
-    pango_layout_set_font_description(layout, display->font_desc);
-    pango_layout_set_text(layout, utf8, bytes);
-    pango_layout_set_alignment(layout, PANGO_ALIGN_CENTER);
+    /* Render glyph only if not recently drawn with the same colors */
+    cairo_surface_t* surface = guac_terminal_glyph_cache_get(
+            display->glyph_cache, codepoint, width,
+            &display->glyph_foreground, &display->glyph_background);
 
-    pango_layout_get_size(layout, &layout_width, &layout_height);
-
-    /* If layout bigger than available space, scale it back */
-    if (layout_width > ideal_layout_width || layout_height > ideal_layout_height) {
-
-        double scale = fmin(ideal_layout_width  / (double) layout_width,
-                            ideal_layout_height / (double) layout_height);
-
-        cairo_scale(cairo, scale, scale);
-
-        /* Update layout to reflect scaled surface */
-        pango_layout_set_width(layout, ideal_layout_width / scale);
-        pango_layout_set_height(layout, ideal_layout_height / scale);
-        pango_cairo_update_layout(cairo, layout);
-
-    }
-
-    /* Draw */
-    cairo_set_source_rgb(cairo,
-            color->red   / 255.0,
-            color->green / 255.0,
-            color->blue  / 255.0);
-
-    cairo_move_to(cairo, 0.0, 0.0);
-    pango_cairo_show_layout(cairo, layout);
+    if (surface == NULL)
+        return 1;
 
     /* Draw */
     guac_common_surface_draw(display->display_surface,
@@ -196,11 +130,6 @@ int __guac_terminal_set(guac_terminal_display* display, int row, int col, int co
         display->char_height * row,
         surface);
 
-    /* Free all */
-    g_object_unref(layout);
-    cairo_destroy(cairo);
-    cairo_surface_destroy(surface);
-
     return 0;
 
 }
@@ -232,6 +161,14 @@ guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
     display->char_width = 0;
     display->char_height = 0;
 
+    /* Glyphs are rendered once the font is loaded */
+    display->glyph_cache = guac_terminal_glyph_cache_alloc(
+            GUAC_TERMINAL_GLYPH_CACHE_DEFAULT_SIZE);
+    display->glyph_cache_warm = false;
+
+    /* Glyphs are drawn directly unless the atlas is enabled */
+    display->glyph_atlas = NULL;
+
     /* Create default surface */
     display->display_layer = guac_client_alloc_layer(client);
     display->select_layer = guac_client_alloc_layer(client);
@@ -260,6 +197,8 @@ guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
     display->width = 0;
     display->height = 0;
     display->operations = NULL;
+    display->operations_storage = NULL;
+    display->pending_scroll = 0;
     display->unflushed_set = false;
 
     /* Initially nothing selected */
@@ -269,6 +208,7 @@ guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
     if (guac_terminal_display_set_font(display, font_name, font_size, dpi)) {
         guac_client_abort(display->client, GUAC_PROTOCOL_STATUS_SERVER_ERROR,
                 "Unable to set initial font \"%s\"", font_name);
+        guac_terminal_glyph_cache_free(display->glyph_cache);
         guac_mem_free(display);
         return NULL;
     }
@@ -279,6 +219,10 @@ guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
 
 void guac_terminal_display_free(guac_terminal_display* display) {
 
+    /* Free all rendered glyphs */
+    guac_terminal_glyph_atlas_free(display->glyph_atlas);
+    guac_terminal_glyph_cache_free(display->glyph_cache);
+
     /* Free font description */
     pango_font_description_free(display->font_desc);
 
@@ -286,15 +230,49 @@ void guac_terminal_display_free(guac_terminal_display* display) {
     guac_mem_free(display->default_palette);
 
     /* Free operations buffers */
-    guac_mem_free(display->operations);
+    guac_mem_free(display->operations_storage);
 
     /* Free display */
     guac_mem_free(display);
 
 }
 
+void guac_terminal_display_enable_glyph_atlas(guac_terminal_display* display,
+        size_t max_size) {
+
+    /* Ignore if already enabled */
+    if (display->glyph_atlas != NULL)
+        return;
+
+    display->glyph_atlas = guac_terminal_glyph_atlas_alloc(display->client,
+            max_size);
+
+    guac_terminal_glyph_atlas_set_font(display->glyph_atlas,
+            display->char_width, display->char_height);
+
+}
+
+/**
+ * Discards all glyphs rendered for the given display, such that the glyph
+ * cache is refilled (and warmed with the default colors) the next time
+ * characters are drawn. This is necessary only to release memory occupied by
+ * glyphs whose colors are no longer in use, as cached glyphs are keyed by
+ * their actual colors rather than their palette indices.
+ *
+ * @param display
+ *     The display whose rendered glyphs should be discarded.
+ */
+static void guac_terminal_display_invalidate_glyphs(
+        guac_terminal_display* display) {
+    guac_terminal_glyph_cache_clear(display->glyph_cache);
+    display->glyph_cache_warm = false;
+}
+
 void guac_terminal_display_reset_palette(guac_terminal_display* display) {
 
+    /* Glyphs rendered with the old palette will likely not be drawn again */
+    guac_terminal_display_invalidate_glyphs(display);
+
     /* Reinitialize palette with default values */
     if (display->default_palette) {
         memcpy(display->palette, *display->default_palette,
@@ -314,6 +292,12 @@ int guac_terminal_display_assign_color(guac_terminal_display* display,
     if (index < 0 || index > 255)
         return 1;
 
+    /* Glyphs rendered with the old color will likely not be drawn again */
+    guac_terminal_color* current = &display->palette[index];
+    if (current->red != color->red || current->green != color->green
+            || current->blue != color->blue)
+        guac_terminal_display_invalidate_glyphs(display);
+
     /* Copy color components */
     display->palette[index].red   = color->red;
     display->palette[index].green = color->green;
@@ -349,9 +333,55 @@ int guac_terminal_display_lookup_color(guac_terminal_display* display,
 
 }
 
+/**
+ * Applies any scrolls deferred by guac_terminal_display_scroll_up(), marking
+ * each character that has scrolled without otherwise changing as a copy and
+ * returning the operations array to the start of its storage.
+ *
+ * @param display
+ *     The terminal display whose deferred scrolls should be applied.
+ */
+static void guac_terminal_display_apply_scroll(guac_terminal_display* display) {
+
+    int amount = display->pending_scroll;
+    if (amount == 0)
+        return;
+
+    /* Rows scrolled into view have been entirely redrawn, thus only the
+     * remaining rows can contain characters that were merely moved */
+    guac_terminal_operation* current = display->operations;
+    for (int row = 0; row < display->height - amount; row++) {
+
+        for (int col = 0; col < display->width; col++) {
+
+            /* If no operation here, set as copy */
+            if (current->type == GUAC_CHAR_NOP) {
+                current->type = GUAC_CHAR_COPY;
+                current->row = row + amount;
+                current->column = col;
+            }
+
+            /* Next column */
+            current++;
+
+        }
+
+    }
+
+    memmove(display->operations_storage, display->operations,
+            guac_mem_ckd_mul_or_die(sizeof(guac_terminal_operation),
+                display->width, display->height));
+
+    display->operations = display->operations_storage;
+    display->pending_scroll = 0;
+
+}
+
 void guac_terminal_display_copy_columns(guac_terminal_display* display, int row,
         int start_column, int end_column, int offset) {
 
+    guac_terminal_display_apply_scroll(display);
+
     /* Ignore operations outside display bounds */
     if (row < 0 || row >= display->height)
         return;
@@ -406,6 +436,8 @@ void guac_terminal_display_copy_columns(guac_terminal_display* display, int row,
 void guac_terminal_display_copy_rows(guac_terminal_display* display,
         int start_row, int end_row, int offset) {
 
+    guac_terminal_display_apply_scroll(display);
+
     /* Fit relevant extents of operation within bounds (NOTE: Because this
      * operation is relative and represents the destination with an offset,
      * there's no need to recalculate the destination region - the offset
@@ -473,6 +505,50 @@ void guac_terminal_display_copy_rows(guac_terminal_display* display,
 
 }
 
+void guac_terminal_display_scroll_up(guac_terminal_display* display,
+        int amount) {
+
+    int width = display->width;
+    int height = display->height;
+
+    if (amount <= 0)
+        return;
+
+    /* Scrolls are deferred within the storage of the operations array until
+     * that storage is exhausted */
+    if (display->pending_scroll + amount > height)
+        guac_terminal_display_apply_scroll(display);
+
+    size_t bottom_offset = guac_mem_ckd_mul_or_die(height - amount, width);
+    size_t bottom_length = guac_mem_ckd_mul_or_die(amount, width);
+    guac_terminal_operation* bottom = &(display->operations[bottom_offset]);
+
+    /* The scroll can be deferred only if the rows remaining at the bottom of
+     * the display will not contain any copies or unchanged characters, which
+     * would otherwise need to be marked as copies from a different row than
+     * the characters above them */
+    bool deferrable = amount < height;
+    for (size_t i = 0; deferrable && i < bottom_length; i++) {
+        if (bottom[i].type != GUAC_CHAR_SET)
+            deferrable = false;
+    }
+
+    if (!deferrable) {
+        guac_terminal_display_copy_rows(display, amount, height - 1, -amount);
+        return;
+    }
+
+    /* As with guac_terminal_display_copy_rows(), the rows at the bottom of
+     * the display retain their operations */
+    memcpy(&(display->operations[guac_mem_ckd_mul_or_die(height, width)]),
+            bottom, guac_mem_ckd_mul_or_die(sizeof(guac_terminal_operation),
+                bottom_length));
+
+    display->operations += bottom_length;
+    display->pending_scroll += amount;
+
+}
+
 void guac_terminal_display_set_columns(guac_terminal_display* display, int row,
         int start_column, int end_column, guac_terminal_char* character) {
 
@@ -484,6 +560,11 @@ void guac_terminal_display_set_columns(guac_terminal_display* display, int row,
     if (row < 0 || row >= display->height)
         return;
 
+    /* Only rows scrolled into view may be set before deferred scrolls are
+     * applied, as only those rows are certain to contain no copies */
+    if (row < display->height - display->pending_scroll)
+        guac_terminal_display_apply_scroll(display);
+
     /* Fit range within bounds */
     start_column = guac_terminal_fit_to_range(start_column, 0, display->width - 1);
     end_column   = guac_terminal_fit_to_range(end_column,   0, display->width - 1);
@@ -517,6 +598,46 @@ void guac_terminal_display_set_columns(guac_terminal_display* display, int row,
 
 }
 
+void guac_terminal_display_set_span(guac_terminal_display* display, int row,
+        int start_column, const guac_terminal_char* characters, int length) {
+
+    /* Ignore operations outside display bounds */
+    if (row < 0 || row >= display->height)
+        return;
+
+    /* Apply deferred scrolls (see guac_terminal_display_set_columns()) */
+    if (row < display->height - display->pending_scroll)
+        guac_terminal_display_apply_scroll(display);
+
+    size_t row_offset = guac_mem_ckd_mul_or_die(row, display->width);
+
+    /* For each character in run */
+    for (int i = 0; i < length; i++) {
+
+        /* Skip empty glyphs and the continuations of multi-column glyphs */
+        const guac_terminal_char* character = &(characters[i]);
+        if (character->value == GUAC_CHAR_CONTINUATION || character->width <= 0)
+            continue;
+
+        int col = guac_terminal_fit_to_range(start_column + i, 0, display->width - 1);
+        guac_terminal_operation* current = &(display->operations[row_offset + col]);
+
+        /* Flush pending copy operation before adding new SET operation (see
+         * guac_terminal_display_set_columns()) */
+        if (current->type == GUAC_CHAR_COPY)
+            guac_terminal_display_flush_operations(display);
+
+        current->type      = GUAC_CHAR_SET;
+        current->character = *character;
+
+    }
+
+    /* Track unflushed SET operations (see guac_terminal_display_set_columns()) */
+    if (row > 0 && row < display->height - 1)
+        display->unflushed_set = true;
+
+}
+
 void guac_terminal_display_resize(guac_terminal_display* display, int width, int height) {
 
     /* Resize display only if dimensions have changed */
@@ -536,14 +657,18 @@ void guac_terminal_display_resize(guac_terminal_display* display, int width, int
         .width = 1
     };
 
-    /* Free old operations buffer */
-    if (display->operations != NULL)
-        guac_mem_free(display->operations);
+    /* Free old operations buffer, discarding any deferred scrolls along
+     * with all other pending operations */
+    if (display->operations_storage != NULL)
+        guac_mem_free(display->operations_storage);
 
-    /* Alloc operations */
-    display->operations = guac_mem_alloc(width, height,
+    /* Alloc operations, leaving room for scrolls to be deferred */
+    display->operations_storage = guac_mem_alloc(width, height, 2,
             sizeof(guac_terminal_operation));
 
+    display->operations = display->operations_storage;
+    display->pending_scroll = 0;
+
     /* Init each operation buffer row */
     guac_terminal_operation* current = display->operations;
     for (int y = 0; y < height; y++) {
@@ -843,11 +968,139 @@ void __guac_terminal_display_flush_clear(guac_terminal_display* display) {
 
 }
 
+/**
+ * Flushes all pending GUAC_CHAR_SET operations using the glyph atlas of the
+ * given display. All glyphs not already within the atlas are first uploaded
+ * together, after which each character is copied from the atlas into place.
+ * Any character which cannot be placed within the atlas, because every slot
+ * is needed by other characters of the same frame, is drawn directly.
+ *
+ * @param display
+ *     The display whose pending GUAC_CHAR_SET operations should be flushed.
+ */
+static void __guac_terminal_display_flush_set_atlas(
+        guac_terminal_display* display) {
+
+    guac_terminal_glyph_atlas* atlas = display->glyph_atlas;
+    guac_terminal_operation* current;
+    int row, col;
+
+    guac_terminal_glyph_atlas_begin_frame(atlas);
+
+    /* Upload all glyphs which are not already within the atlas */
+    current = display->operations;
+    for (row=0; row<display->height; row++) {
+        for (col=0; col<display->width; col++) {
+
+            if (current->type == GUAC_CHAR_SET) {
+
+                int codepoint = current->character.value;
+
+                /* Use space if no glyph */
+                if (!guac_terminal_has_glyph(codepoint))
+                    codepoint = ' ';
+
+                /* Calculate width in columns, ignoring empty glyphs */
+                int width = wcwidth(codepoint);
+                if (width < 0)
+                    width = 1;
+
+                if (width != 0) {
+                    __guac_terminal_set_colors(display,
+                            &(current->character.attributes));
+                    guac_terminal_glyph_atlas_get(atlas, display->glyph_cache,
+                            codepoint, width, &display->glyph_foreground,
+                            &display->glyph_background);
+                }
+
+            }
+
+            current++;
+
+        }
+    }
+
+    /* Send the uploaded glyphs and any pending updates to the display, such
+     * that each glyph can be copied into place immediately */
+    guac_terminal_glyph_atlas_flush(atlas);
+    guac_common_surface_flush(display->display_surface);
+
+    /* Copy each glyph into place */
+    current = display->operations;
+    for (row=0; row<display->height; row++) {
+        for (col=0; col<display->width; col++) {
+
+            if (current->type == GUAC_CHAR_SET) {
+
+                int codepoint = current->character.value;
+
+                /* Use space if no glyph */
+                if (!guac_terminal_has_glyph(codepoint))
+                    codepoint = ' ';
+
+                /* Calculate width in columns, ignoring empty glyphs */
+                int width = wcwidth(codepoint);
+                if (width < 0)
+                    width = 1;
+
+                if (width != 0) {
+
+                    __guac_terminal_set_colors(display,
+                            &(current->character.attributes));
+
+                    guac_terminal_atlas_slot* slot =
+                        guac_terminal_glyph_atlas_find(atlas, codepoint,
+                                width, &display->glyph_foreground,
+                                &display->glyph_background);
+
+                    /* Draw directly only if the atlas was full */
+                    if (slot != NULL)
+                        guac_common_surface_copy(atlas->surface,
+                                slot->x, slot->y,
+                                width * display->char_width,
+                                display->char_height,
+                                display->display_surface,
+                                display->char_width * col,
+                                display->char_height * row);
+                    else
+                        __guac_terminal_set(display, row, col, codepoint);
+
+                }
+
+                /* Mark operation as handled */
+                current->type = GUAC_CHAR_NOP;
+
+            }
+
+            current++;
+
+        }
+    }
+
+    /* Mark that all SET operations have been flushed */
+    display->unflushed_set = 0;
+
+}
+
 void __guac_terminal_display_flush_set(guac_terminal_display* display) {
 
     guac_terminal_operation* current = display->operations;
     int row, col;
 
+    /* Render the most common glyphs in advance if the glyph cache has been
+     * invalidated */
+    if (!display->glyph_cache_warm) {
+        guac_terminal_glyph_cache_warm(display->glyph_cache,
+                &display->default_foreground, &display->default_background);
+        display->glyph_cache_warm = true;
+    }
+
+    /* Copy glyphs from the atlas, if enabled */
+    if (display->glyph_atlas != NULL) {
+        __guac_terminal_display_flush_set_atlas(display);
+        return;
+    }
+
     /* For each operation */
     for (row=0; row<display->height; row++) {
         for (col=0; col<display->width; col++) {
@@ -885,6 +1138,8 @@ void __guac_terminal_display_flush_set(guac_terminal_display* display) {
 }
 void guac_terminal_display_flush_operations(guac_terminal_display* display) {
 
+    guac_terminal_display_apply_scroll(display);
+
     /* Flush operations, copies first, then clears, then sets. */
     __guac_terminal_display_flush_copy(display);
     __guac_terminal_display_flush_clear(display);
@@ -908,6 +1163,10 @@ void guac_terminal_display_dup(
     /* Create default surface */
     guac_common_surface_dup(display->display_surface, client, socket);
 
+    /* Send all glyphs which may later be copied from the atlas */
+    if (display->glyph_atlas != NULL)
+        guac_terminal_glyph_atlas_dup(display->glyph_atlas, client, socket);
+
     /* Select layer is a child of the display layer */
     guac_protocol_send_move(socket, display->select_layer,
             display->display_layer, 0, 0, 0);
@@ -1083,6 +1342,17 @@ int guac_terminal_display_set_font(guac_terminal_display* display,
     /* Atomically replace old font description */
     PangoFontDescription* old_font_desc = display->font_desc;
     display->font_desc = font_desc;
+
+    /* Glyphs rendered with the old font are no longer valid */
+    guac_terminal_glyph_cache_set_font(display->glyph_cache, font_desc,
+            display->char_width, display->char_height);
+    display->glyph_cache_warm = false;
+
+    /* Resize atlas to fit the new character dimensions */
+    if (display->glyph_atlas != NULL)
+        guac_terminal_glyph_atlas_set_font(display->glyph_atlas,
+                display->char_width, display->char_height);
+
     pango_font_description_free(old_font_desc);
 
     return 0;
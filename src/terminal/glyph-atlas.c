@@ -0,0 +1,339 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "common/surface.h"
+#include "terminal/display.h"
+#include "terminal/glyph-atlas.h"
+#include "terminal/glyph-cache.h"
+#include "terminal/palette.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cairo/cairo.h>
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+#include <guacamole/socket.h>
+
+/**
+ * Packs the red, green, and blue components of the given color into a single
+ * 24-bit value.
+ *
+ * @param color
+ *     The color to pack.
+ *
+ * @return
+ *     The given color as packed 24-bit RGB.
+ */
+static uint32_t guac_terminal_atlas_pack_color(const guac_terminal_color* color) {
+    return (color->red << 16) | (color->green << 8) | color->blue;
+}
+
+/**
+ * Returns the hash bucket which contains the slot for the given character
+ * and colors, if present.
+ *
+ * @param codepoint
+ *     The Unicode codepoint of the character.
+ *
+ * @param foreground
+ *     The foreground color of the character, as packed 24-bit RGB.
+ *
+ * @param background
+ *     The background color of the character, as packed 24-bit RGB.
+ *
+ * @return
+ *     The index of the hash bucket for the given character and colors.
+ */
+static unsigned int guac_terminal_atlas_hash(int codepoint,
+        uint32_t foreground, uint32_t background) {
+
+    uint32_t hash = (uint32_t) codepoint * 0x9E3779B1;
+    hash ^= foreground * 0x85EBCA77;
+    hash ^= background * 0xC2B2AE3D;
+    hash ^= hash >> 15;
+
+    return hash & (GUAC_TERMINAL_GLYPH_ATLAS_BUCKETS - 1);
+
+}
+
+/**
+ * Removes the given slot from the recently-drawn list of the given atlas.
+ *
+ * @param atlas
+ *     The atlas containing the slot.
+ *
+ * @param slot
+ *     The slot to remove.
+ */
+static void guac_terminal_atlas_unlink(guac_terminal_glyph_atlas* atlas,
+        guac_terminal_atlas_slot* slot) {
+
+    if (slot->newer != NULL)
+        slot->newer->older = slot->older;
+    else
+        atlas->newest = slot->older;
+
+    if (slot->older != NULL)
+        slot->older->newer = slot->newer;
+    else
+        atlas->oldest = slot->newer;
+
+}
+
+/**
+ * Adds the given slot to the head of the recently-drawn list of the given
+ * atlas, marking it as drawn during the current frame.
+ *
+ * @param atlas
+ *     The atlas containing the slot.
+ *
+ * @param slot
+ *     The slot to add.
+ */
+static void guac_terminal_atlas_link(guac_terminal_glyph_atlas* atlas,
+        guac_terminal_atlas_slot* slot) {
+
+    slot->frame = atlas->frame;
+    slot->newer = NULL;
+    slot->older = atlas->newest;
+
+    if (atlas->newest != NULL)
+        atlas->newest->newer = slot;
+    else
+        atlas->oldest = slot;
+
+    atlas->newest = slot;
+
+}
+
+/**
+ * Removes the glyph held by the given slot from the hash table and
+ * recently-drawn list of the given atlas, such that the slot can be reused.
+ *
+ * @param atlas
+ *     The atlas containing the slot.
+ *
+ * @param slot
+ *     The slot to empty.
+ */
+static void guac_terminal_atlas_evict(guac_terminal_glyph_atlas* atlas,
+        guac_terminal_atlas_slot* slot) {
+
+    unsigned int bucket = guac_terminal_atlas_hash(slot->codepoint,
+            slot->foreground, slot->background);
+
+    guac_terminal_atlas_slot** current = &atlas->buckets[bucket];
+    while (*current != slot)
+        current = &(*current)->next;
+
+    *current = slot->next;
+    guac_terminal_atlas_unlink(atlas, slot);
+
+}
+
+/**
+ * Discards all glyphs within the given atlas, such that every slot is free.
+ *
+ * @param atlas
+ *     The atlas to clear.
+ */
+static void guac_terminal_atlas_clear(guac_terminal_glyph_atlas* atlas) {
+    memset(atlas->buckets, 0, sizeof(atlas->buckets));
+    atlas->newest = NULL;
+    atlas->oldest = NULL;
+    atlas->slots_used = 0;
+}
+
+guac_terminal_glyph_atlas* guac_terminal_glyph_atlas_alloc(guac_client* client,
+        size_t max_size) {
+
+    guac_terminal_glyph_atlas* atlas =
+        guac_mem_zalloc(sizeof(guac_terminal_glyph_atlas));
+
+    atlas->client = client;
+    atlas->max_size = max_size;
+
+    /* Atlas is initially empty, and is sized once character dimensions are
+     * known */
+    atlas->buffer = guac_client_alloc_buffer(client);
+    atlas->surface = guac_common_surface_alloc(client, client->socket,
+            atlas->buffer, 0, 0);
+
+    /* Glyphs must be copied exactly */
+    guac_common_surface_set_lossless(atlas->surface, 1);
+
+    return atlas;
+
+}
+
+void guac_terminal_glyph_atlas_free(guac_terminal_glyph_atlas* atlas) {
+
+    if (atlas == NULL)
+        return;
+
+    guac_common_surface_free(atlas->surface);
+    guac_client_free_buffer(atlas->client, atlas->buffer);
+
+    guac_mem_free(atlas->slots);
+    guac_mem_free(atlas);
+
+}
+
+void guac_terminal_glyph_atlas_set_font(guac_terminal_glyph_atlas* atlas,
+        int char_width, int char_height) {
+
+    /* Glyphs uploaded for any previous font are no longer valid */
+    guac_terminal_atlas_clear(atlas);
+    guac_mem_free(atlas->slots);
+    atlas->slots = NULL;
+    atlas->slot_count = 0;
+
+    /* Every slot can hold a glyph of the maximum width */
+    atlas->slot_width = char_width * GUAC_TERMINAL_MAX_CHAR_WIDTH;
+    atlas->slot_height = char_height;
+
+    if (atlas->slot_width <= 0 || atlas->slot_height <= 0)
+        return;
+
+    /* Fit as many rows of slots as the budget allows */
+    size_t row_size = (size_t) atlas->slot_width * atlas->slot_height
+        * GUAC_TERMINAL_GLYPH_ATLAS_COLUMNS * 4;
+
+    size_t rows = atlas->max_size / row_size;
+    if (rows > GUAC_TERMINAL_GLYPH_ATLAS_MAX_HEIGHT / atlas->slot_height)
+        rows = GUAC_TERMINAL_GLYPH_ATLAS_MAX_HEIGHT / atlas->slot_height;
+
+    atlas->slot_count = rows * GUAC_TERMINAL_GLYPH_ATLAS_COLUMNS;
+    atlas->slots = guac_mem_zalloc(sizeof(guac_terminal_atlas_slot),
+            atlas->slot_count);
+
+    /* Assign each slot its own region of the atlas */
+    for (int i = 0; i < atlas->slot_count; i++) {
+        guac_terminal_atlas_slot* slot = &atlas->slots[i];
+        slot->x = (i % GUAC_TERMINAL_GLYPH_ATLAS_COLUMNS) * atlas->slot_width;
+        slot->y = (i / GUAC_TERMINAL_GLYPH_ATLAS_COLUMNS) * atlas->slot_height;
+    }
+
+    guac_common_surface_resize(atlas->surface,
+            GUAC_TERMINAL_GLYPH_ATLAS_COLUMNS * atlas->slot_width,
+            rows * atlas->slot_height);
+
+}
+
+void guac_terminal_glyph_atlas_begin_frame(guac_terminal_glyph_atlas* atlas) {
+    atlas->frame++;
+}
+
+guac_terminal_atlas_slot* guac_terminal_glyph_atlas_find(
+        guac_terminal_glyph_atlas* atlas, int codepoint, int width,
+        const guac_terminal_color* foreground,
+        const guac_terminal_color* background) {
+
+    uint32_t packed_foreground = guac_terminal_atlas_pack_color(foreground);
+    uint32_t packed_background = guac_terminal_atlas_pack_color(background);
+
+    unsigned int bucket = guac_terminal_atlas_hash(codepoint,
+            packed_foreground, packed_background);
+
+    for (guac_terminal_atlas_slot* current = atlas->buckets[bucket];
+            current != NULL; current = current->next) {
+
+        if (current->codepoint == codepoint
+                && current->width == width
+                && current->foreground == packed_foreground
+                && current->background == packed_background)
+            return current;
+
+    }
+
+    return NULL;
+
+}
+
+guac_terminal_atlas_slot* guac_terminal_glyph_atlas_get(
+        guac_terminal_glyph_atlas* atlas, guac_terminal_glyph_cache* cache,
+        int codepoint, int width, const guac_terminal_color* foreground,
+        const guac_terminal_color* background) {
+
+    /* Reuse previously-uploaded glyph if possible */
+    guac_terminal_atlas_slot* slot = guac_terminal_glyph_atlas_find(atlas,
+            codepoint, width, foreground, background);
+
+    if (slot != NULL) {
+
+        /* Mark as drawn during the current frame */
+        guac_terminal_atlas_unlink(atlas, slot);
+        guac_terminal_atlas_link(atlas, slot);
+
+        atlas->hits++;
+        return slot;
+
+    }
+
+    /* Render glyph before claiming a slot for it */
+    cairo_surface_t* glyph = guac_terminal_glyph_cache_get(cache, codepoint,
+            width, foreground, background);
+
+    if (glyph == NULL)
+        return NULL;
+
+    /* Use a free slot if any remain, otherwise evict the least recently
+     * drawn glyph unless it is still needed by the current frame */
+    if (atlas->slots_used < atlas->slot_count)
+        slot = &atlas->slots[atlas->slots_used++];
+    else if (atlas->oldest != NULL && atlas->oldest->frame != atlas->frame) {
+        slot = atlas->oldest;
+        guac_terminal_atlas_evict(atlas, slot);
+    }
+    else
+        return NULL;
+
+    /* Upload glyph into slot */
+    guac_common_surface_draw(atlas->surface, slot->x, slot->y, glyph);
+
+    slot->codepoint = codepoint;
+    slot->width = width;
+    slot->foreground = guac_terminal_atlas_pack_color(foreground);
+    slot->background = guac_terminal_atlas_pack_color(background);
+
+    unsigned int bucket = guac_terminal_atlas_hash(codepoint,
+            slot->foreground, slot->background);
+
+    slot->next = atlas->buckets[bucket];
+    atlas->buckets[bucket] = slot;
+    guac_terminal_atlas_link(atlas, slot);
+
+    atlas->misses++;
+    return slot;
+
+}
+
+void guac_terminal_glyph_atlas_flush(guac_terminal_glyph_atlas* atlas) {
+    guac_common_surface_flush(atlas->surface);
+}
+
+void guac_terminal_glyph_atlas_dup(guac_terminal_glyph_atlas* atlas,
+        guac_client* client, guac_socket* socket) {
+    guac_common_surface_dup(atlas->surface, client, socket);
+}
@@ -0,0 +1,381 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "terminal/common.h"
+#include "terminal/glyph-cache.h"
+#include "terminal/palette.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cairo/cairo.h>
+#include <glib-object.h>
+#include <guacamole/mem.h>
+#include <pango/pangocairo.h>
+
+/**
+ * Packs the red, green, and blue components of the given color into a single
+ * 24-bit value. The palette index of the color is ignored, as only the actual
+ * color affects the rendered glyph.
+ *
+ * @param color
+ *     The color to pack.
+ *
+ * @return
+ *     The given color as packed 24-bit RGB.
+ */
+static uint32_t guac_terminal_glyph_pack_color(const guac_terminal_color* color) {
+    return (color->red << 16) | (color->green << 8) | color->blue;
+}
+
+/**
+ * Returns the hash bucket which contains the glyph for the given character
+ * and colors, if cached.
+ *
+ * @param codepoint
+ *     The Unicode codepoint of the character.
+ *
+ * @param foreground
+ *     The foreground color of the character, as packed 24-bit RGB.
+ *
+ * @param background
+ *     The background color of the character, as packed 24-bit RGB.
+ *
+ * @return
+ *     The index of the hash bucket for the given character and colors.
+ */
+static unsigned int guac_terminal_glyph_hash(int codepoint,
+        uint32_t foreground, uint32_t background) {
+
+    uint32_t hash = (uint32_t) codepoint * 0x9E3779B1;
+    hash ^= foreground * 0x85EBCA77;
+    hash ^= background * 0xC2B2AE3D;
+    hash ^= hash >> 15;
+
+    return hash & (GUAC_TERMINAL_GLYPH_CACHE_BUCKETS - 1);
+
+}
+
+/**
+ * Removes the given glyph from the recently-drawn list of the given cache.
+ *
+ * @param cache
+ *     The cache containing the glyph.
+ *
+ * @param glyph
+ *     The glyph to remove.
+ */
+static void guac_terminal_glyph_unlink(guac_terminal_glyph_cache* cache,
+        guac_terminal_glyph* glyph) {
+
+    if (glyph->newer != NULL)
+        glyph->newer->older = glyph->older;
+    else
+        cache->newest = glyph->older;
+
+    if (glyph->older != NULL)
+        glyph->older->newer = glyph->newer;
+    else
+        cache->oldest = glyph->newer;
+
+}
+
+/**
+ * Adds the given glyph to the head of the recently-drawn list of the given
+ * cache, marking it as the most recently drawn glyph.
+ *
+ * @param cache
+ *     The cache containing the glyph.
+ *
+ * @param glyph
+ *     The glyph to add.
+ */
+static void guac_terminal_glyph_link(guac_terminal_glyph_cache* cache,
+        guac_terminal_glyph* glyph) {
+
+    glyph->newer = NULL;
+    glyph->older = cache->newest;
+
+    if (cache->newest != NULL)
+        cache->newest->newer = glyph;
+    else
+        cache->oldest = glyph;
+
+    cache->newest = glyph;
+
+}
+
+/**
+ * Removes the given glyph from the given cache entirely, freeing the glyph
+ * and its rendered surface.
+ *
+ * @param cache
+ *     The cache containing the glyph.
+ *
+ * @param glyph
+ *     The glyph to remove.
+ */
+static void guac_terminal_glyph_remove(guac_terminal_glyph_cache* cache,
+        guac_terminal_glyph* glyph) {
+
+    /* Remove from hash bucket */
+    unsigned int bucket = guac_terminal_glyph_hash(glyph->codepoint,
+            glyph->foreground, glyph->background);
+
+    guac_terminal_glyph** current = &cache->buckets[bucket];
+    while (*current != glyph)
+        current = &(*current)->next;
+
+    *current = glyph->next;
+
+    /* Remove from recently-drawn list */
+    guac_terminal_glyph_unlink(cache, glyph);
+
+    cache->size -= glyph->size;
+    cairo_surface_destroy(glyph->surface);
+    guac_mem_free(glyph);
+
+}
+
+/**
+ * Renders the given character using the font of the given cache, exactly as
+ * it should appear within the terminal.
+ *
+ * @param cache
+ *     The cache whose font should be used.
+ *
+ * @param codepoint
+ *     The Unicode codepoint of the character to render.
+ *
+ * @param width
+ *     The width of the character, in columns.
+ *
+ * @param foreground
+ *     The color of the character itself.
+ *
+ * @param background
+ *     The color of the character cells behind the character.
+ *
+ * @return
+ *     A new Cairo image surface containing the rendered character, or NULL
+ *     if the surface could not be created.
+ */
+static cairo_surface_t* guac_terminal_glyph_render(
+        guac_terminal_glyph_cache* cache, int codepoint, int width,
+        const guac_terminal_color* foreground,
+        const guac_terminal_color* background) {
+
+    char utf8[4];
+    int bytes = guac_terminal_encode_utf8(codepoint, utf8);
+
+    int surface_width = width * cache->char_width;
+    int surface_height = cache->char_height;
+
+    int ideal_layout_width = surface_width * PANGO_SCALE;
+    int ideal_layout_height = surface_height * PANGO_SCALE;
+
+    /* Prepare surface */
+    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+            surface_width, surface_height);
+
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(surface);
+        return NULL;
+    }
+
+    cairo_t* cairo = cairo_create(surface);
+
+    /* Fill background */
+    cairo_set_source_rgb(cairo,
+            background->red   / 255.0,
+            background->green / 255.0,
+            background->blue  / 255.0);
+
+    cairo_rectangle(cairo, 0, 0, surface_width, surface_height);
+    cairo_fill(cairo);
+
+    /* Get layout */
+    PangoLayout* layout = pango_cairo_create_layout(cairo);
+    pango_layout_set_font_description(layout, cache->font_desc);
+    pango_layout_set_text(layout, utf8, bytes);
+    pango_layout_set_alignment(layout, PANGO_ALIGN_CENTER);
+
+    int layout_width, layout_height;
+    pango_layout_get_size(layout, &layout_width, &layout_height);
+
+    /* If layout bigger than available space, scale it back */
+    if (layout_width > ideal_layout_width || layout_height > ideal_layout_height) {
+
+        double scale = fmin(ideal_layout_width  / (double) layout_width,
+                            ideal_layout_height / (double) layout_height);
+
+        cairo_scale(cairo, scale, scale);
+
+        /* Update layout to reflect scaled surface */
+        pango_layout_set_width(layout, ideal_layout_width / scale);
+        pango_layout_set_height(layout, ideal_layout_height / scale);
+        pango_cairo_update_layout(cairo, layout);
+
+    }
+
+    /* Draw */
+    cairo_set_source_rgb(cairo,
+            foreground->red   / 255.0,
+            foreground->green / 255.0,
+            foreground->blue  / 255.0);
+
+    cairo_move_to(cairo, 0.0, 0.0);
+    pango_cairo_show_layout(cairo, layout);
+
+    g_object_unref(layout);
+    cairo_destroy(cairo);
+
+    /* Ensure rendered pixels are visible to direct reads of surface data */
+    cairo_surface_flush(surface);
+    return surface;
+
+}
+
+guac_terminal_glyph_cache* guac_terminal_glyph_cache_alloc(size_t max_size) {
+
+    guac_terminal_glyph_cache* cache =
+        guac_mem_zalloc(sizeof(guac_terminal_glyph_cache));
+
+    cache->max_size = max_size;
+    return cache;
+
+}
+
+void guac_terminal_glyph_cache_free(guac_terminal_glyph_cache* cache) {
+
+    if (cache == NULL)
+        return;
+
+    guac_terminal_glyph_cache_clear(cache);
+    guac_mem_free(cache);
+
+}
+
+void guac_terminal_glyph_cache_clear(guac_terminal_glyph_cache* cache) {
+
+    guac_terminal_glyph* current = cache->newest;
+    while (current != NULL) {
+        guac_terminal_glyph* older = current->older;
+        cairo_surface_destroy(current->surface);
+        guac_mem_free(current);
+        current = older;
+    }
+
+    memset(cache->buckets, 0, sizeof(cache->buckets));
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->size = 0;
+
+}
+
+void guac_terminal_glyph_cache_set_font(guac_terminal_glyph_cache* cache,
+        PangoFontDescription* font_desc, int char_width, int char_height) {
+
+    /* Glyphs rendered with any previous font are no longer valid */
+    guac_terminal_glyph_cache_clear(cache);
+
+    cache->font_desc = font_desc;
+    cache->char_width = char_width;
+    cache->char_height = char_height;
+
+}
+
+cairo_surface_t* guac_terminal_glyph_cache_get(guac_terminal_glyph_cache* cache,
+        int codepoint, int width, const guac_terminal_color* foreground,
+        const guac_terminal_color* background) {
+
+    uint32_t packed_foreground = guac_terminal_glyph_pack_color(foreground);
+    uint32_t packed_background = guac_terminal_glyph_pack_color(background);
+
+    unsigned int bucket = guac_terminal_glyph_hash(codepoint,
+            packed_foreground, packed_background);
+
+    /* Reuse previously-rendered glyph if possible */
+    for (guac_terminal_glyph* current = cache->buckets[bucket];
+            current != NULL; current = current->next) {
+
+        if (current->codepoint == codepoint
+                && current->width == width
+                && current->foreground == packed_foreground
+                && current->background == packed_background) {
+
+            /* Mark as most recently drawn */
+            guac_terminal_glyph_unlink(cache, current);
+            guac_terminal_glyph_link(cache, current);
+
+            cache->hits++;
+            return current->surface;
+
+        }
+
+    }
+
+    cache->misses++;
+
+    cairo_surface_t* surface = guac_terminal_glyph_render(cache, codepoint,
+            width, foreground, background);
+
+    if (surface == NULL)
+        return NULL;
+
+    size_t size = (size_t) cairo_image_surface_get_stride(surface)
+        * cairo_image_surface_get_height(surface);
+
+    /* Evict least recently drawn glyphs until the new glyph fits */
+    while (cache->oldest != NULL && cache->size + size > cache->max_size)
+        guac_terminal_glyph_remove(cache, cache->oldest);
+
+    guac_terminal_glyph* glyph = guac_mem_alloc(sizeof(guac_terminal_glyph));
+    glyph->codepoint = codepoint;
+    glyph->width = width;
+    glyph->foreground = packed_foreground;
+    glyph->background = packed_background;
+    glyph->surface = surface;
+    glyph->size = size;
+
+    /* Add to hash bucket and mark as most recently drawn */
+    glyph->next = cache->buckets[bucket];
+    cache->buckets[bucket] = glyph;
+    guac_terminal_glyph_link(cache, glyph);
+
+    cache->size += size;
+    return surface;
+
+}
+
+void guac_terminal_glyph_cache_warm(guac_terminal_glyph_cache* cache,
+        const guac_terminal_color* foreground,
+        const guac_terminal_color* background) {
+
+    for (int codepoint = GUAC_TERMINAL_GLYPH_CACHE_WARM_FIRST;
+            codepoint <= GUAC_TERMINAL_GLYPH_CACHE_WARM_LAST; codepoint++)
+        guac_terminal_glyph_cache_get(cache, codepoint, 1,
+                foreground, background);
+
+}
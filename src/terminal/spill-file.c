@@ -0,0 +1,209 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "terminal/spill-file.h"
+
+#include <guacamole/mem.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * The name of each spill file relative to its directory, as a template
+ * accepted by mkstemp().
+ */
+#define GUAC_TERMINAL_SPILL_FILE_TEMPLATE "guac-scrollback-XXXXXX"
+
+/**
+ * Returns the index of the smallest block size able to contain the given
+ * number of bytes.
+ *
+ * @param size
+ *     The number of bytes that must fit within the block.
+ *
+ * @return
+ *     The index of the smallest suitable block size, which may be
+ *     GUAC_TERMINAL_SPILL_FILE_CLASSES or greater if the given size exceeds
+ *     the size of the largest block.
+ */
+static size_t guac_terminal_spill_file_class(size_t size) {
+
+    if (size == 0)
+        return 0;
+
+    return (size - 1) / GUAC_TERMINAL_SPILL_FILE_BLOCK_ALIGNMENT;
+
+}
+
+/**
+ * Returns the size of the blocks having the given index.
+ *
+ * @param size_class
+ *     The index of the block size, as returned by
+ *     guac_terminal_spill_file_class().
+ *
+ * @return
+ *     The size of each block having the given index, in bytes.
+ */
+static size_t guac_terminal_spill_file_block_size(size_t size_class) {
+    return (size_class + 1) * GUAC_TERMINAL_SPILL_FILE_BLOCK_ALIGNMENT;
+}
+
+/**
+ * Extends the given spill file by one segment, mapping that segment into
+ * memory.
+ *
+ * @param spill
+ *     The spill file to extend.
+ *
+ * @return
+ *     Zero if the spill file was extended successfully, non-zero otherwise.
+ */
+static int guac_terminal_spill_file_grow(guac_terminal_spill_file* spill) {
+
+    off_t offset = (off_t) spill->segment_count * GUAC_TERMINAL_SPILL_FILE_SEGMENT_SIZE;
+    off_t length = offset + GUAC_TERMINAL_SPILL_FILE_SEGMENT_SIZE;
+
+    /* Extend underlying file, reserving the space if possible such that a
+     * full disk is detected here rather than when the mapping is written */
+    if (ftruncate(spill->fd, length))
+        return 1;
+
+#if defined(_POSIX_ADVISORY_INFO) && _POSIX_ADVISORY_INFO > 0
+    if (posix_fallocate(spill->fd, offset, GUAC_TERMINAL_SPILL_FILE_SEGMENT_SIZE))
+        return 1;
+#endif
+
+    void* segment = mmap(NULL, GUAC_TERMINAL_SPILL_FILE_SEGMENT_SIZE,
+            PROT_READ | PROT_WRITE, MAP_SHARED, spill->fd, offset);
+
+    if (segment == MAP_FAILED)
+        return 1;
+
+    /* Add new segment, expanding segment array as needed */
+    if (spill->segment_count == spill->segments_available) {
+        spill->segments_available = spill->segments_available * 2 + 1;
+        spill->segments = guac_mem_realloc_or_die(spill->segments,
+                sizeof(unsigned char*), spill->segments_available);
+    }
+
+    spill->segments[spill->segment_count++] = segment;
+    spill->segment_used = 0;
+
+    return 0;
+
+}
+
+guac_terminal_spill_file* guac_terminal_spill_file_alloc(const char* path) {
+
+    char filename[4096];
+
+    /* Build full path of temporary file */
+    int length = snprintf(filename, sizeof(filename), "%s/%s", path,
+            GUAC_TERMINAL_SPILL_FILE_TEMPLATE);
+
+    if (length < 0 || length >= (int) sizeof(filename)) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+
+    int fd = mkstemp(filename);
+    if (fd == -1)
+        return NULL;
+
+    /* The file is only ever accessed through its descriptor */
+    unlink(filename);
+
+    guac_terminal_spill_file* spill = guac_mem_zalloc(sizeof(guac_terminal_spill_file));
+    spill->fd = fd;
+
+    return spill;
+
+}
+
+void guac_terminal_spill_file_free(guac_terminal_spill_file* spill) {
+
+    for (int i = 0; i < spill->segment_count; i++)
+        munmap(spill->segments[i], GUAC_TERMINAL_SPILL_FILE_SEGMENT_SIZE);
+
+    close(spill->fd);
+
+    guac_mem_free(spill->segments);
+    guac_mem_free(spill);
+
+}
+
+void* guac_terminal_spill_file_store(guac_terminal_spill_file* spill,
+        const void* data, size_t size) {
+
+    size_t size_class = guac_terminal_spill_file_class(size);
+    if (size_class >= GUAC_TERMINAL_SPILL_FILE_CLASSES)
+        return NULL;
+
+    size_t block_size = guac_terminal_spill_file_block_size(size_class);
+    void* block = spill->free_blocks[size_class];
+
+    /* Reuse a released block if possible */
+    if (block != NULL)
+        memcpy(&spill->free_blocks[size_class], block, sizeof(void*));
+
+    /* Otherwise, carve a new block from the end of the file, growing the file
+     * if the current segment is full */
+    else {
+
+        if (spill->segment_count == 0
+                || spill->segment_used + block_size > GUAC_TERMINAL_SPILL_FILE_SEGMENT_SIZE) {
+            if (guac_terminal_spill_file_grow(spill))
+                return NULL;
+        }
+
+        block = spill->segments[spill->segment_count - 1] + spill->segment_used;
+        spill->segment_used += block_size;
+
+    }
+
+    memcpy(block, data, size);
+    spill->allocated += block_size;
+
+    return block;
+
+}
+
+void guac_terminal_spill_file_release(guac_terminal_spill_file* spill,
+        void* data, size_t size) {
+
+    size_t size_class = guac_terminal_spill_file_class(size);
+    size_t block_size = guac_terminal_spill_file_block_size(size_class);
+
+    /* Push block onto free list for its size */
+    memcpy(data, &spill->free_blocks[size_class], sizeof(void*));
+    spill->free_blocks[size_class] = data;
+
+    spill->allocated -= block_size;
+
+}
+
@@ -36,6 +36,12 @@
 #include <stdlib.h>
 #include <wchar.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 /**
  * Response string sent when identification is requested.
  */
@@ -233,12 +239,240 @@ static void guac_terminal_move_cursor(guac_terminal* term, int row, int col) {
 
 }
 
+/**
+ * Returns the number of bytes at the start of the given buffer that
+ * guac_terminal_echo() could only display (or decode as part of a UTF-8
+ * sequence to be displayed), stopping at the first C0 control character or
+ * DEL. Bytes of 0x80 and above are included in the span. SSE2 is part of the
+ * x86-64 baseline and NEON part of the AArch64 baseline, so the vectorized
+ * variants below are selected at compile time; the scalar loop handles the
+ * tail and all other platforms, and all variants return identical results.
+ *
+ * @param data
+ *     The buffer to scan.
+ *
+ * @param length
+ *     The number of bytes within the given buffer.
+ *
+ * @return
+ *     The length of the leading span of non-control bytes.
+ */
+static int guac_terminal_span_printable(const unsigned char* data,
+        int length) {
+
+    int span = 0;
+
+#ifdef __SSE2__
+    const __m128i last_control = _mm_set1_epi8(0x1F);
+    const __m128i del = _mm_set1_epi8(0x7F);
+
+    while (length - span >= 16) {
+
+        /* A byte is a C0 control character if min(byte, 0x1F) == byte */
+        __m128i bytes = _mm_loadu_si128((const __m128i*) (data + span));
+        __m128i stop = _mm_or_si128(
+                _mm_cmpeq_epi8(_mm_min_epu8(bytes, last_control), bytes),
+                _mm_cmpeq_epi8(bytes, del));
+
+        int mask = _mm_movemask_epi8(stop);
+        if (mask)
+            return span + __builtin_ctz(mask);
+
+        span += 16;
+
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    const uint8x16_t first_printable = vdupq_n_u8(0x20);
+    const uint8x16_t del = vdupq_n_u8(0x7F);
+
+    /* Skip whole blocks free of stop bytes, leaving the block containing the
+     * first stop byte (if any) to the scalar loop */
+    while (length - span >= 16) {
+
+        uint8x16_t bytes = vld1q_u8(data + span);
+        uint8x16_t stop = vorrq_u8(vcltq_u8(bytes, first_printable),
+                vceqq_u8(bytes, del));
+
+        if (vmaxvq_u8(stop))
+            break;
+
+        span += 16;
+
+    }
+#endif
+
+    while (span < length && data[span] >= 0x20 && data[span] != 0x7F)
+        span++;
+
+    return span;
+
+}
+
+/**
+ * Decodes the complete, well-formed UTF-8 sequence at the start of the given
+ * buffer, using the same arithmetic as guac_terminal_echo().
+ *
+ * @param buffer
+ *     The buffer containing the UTF-8 sequence to decode.
+ *
+ * @param length
+ *     The number of bytes within the given buffer.
+ *
+ * @param codepoint
+ *     Pointer to an int which receives the decoded codepoint.
+ *
+ * @return
+ *     The length of the decoded sequence in bytes, or zero if the buffer does
+ *     not begin with a complete, well-formed sequence.
+ */
+static int guac_terminal_decode_utf8(const unsigned char* buffer, int length,
+        int* codepoint) {
+
+    unsigned char c = buffer[0];
+    int value;
+    int size;
+
+    /* 1-byte UTF-8 codepoint */
+    if ((c & 0x80) == 0x00) {
+        *codepoint = c;
+        return 1;
+    }
+
+    /* 2-byte UTF-8 codepoint */
+    else if ((c & 0xE0) == 0xC0) {
+        value = c & 0x1F;
+        size = 2;
+    }
+
+    /* 3-byte UTF-8 codepoint */
+    else if ((c & 0xF0) == 0xE0) {
+        value = c & 0x0F;
+        size = 3;
+    }
+
+    /* 4-byte UTF-8 codepoint */
+    else if ((c & 0xF8) == 0xF0) {
+        value = c & 0x07;
+        size = 4;
+    }
+
+    /* Stray continuation or unrecognized prefix */
+    else
+        return 0;
+
+    if (size > length)
+        return 0;
+
+    /* Append each continuation byte */
+    for (int i = 1; i < size; i++) {
+
+        c = buffer[i];
+        if ((c & 0xC0) != 0x80)
+            return 0;
+
+        value = (value << 6) | (c & 0x3F);
+
+    }
+
+    *codepoint = value;
+    return size;
+
+}
+
+int guac_terminal_echo_run(guac_terminal* term, const unsigned char* buffer,
+        int length) {
+
+    /* Characters pending for the current row, allowing for a multi-column
+     * character which begins in the final column */
+    guac_terminal_char span[GUAC_TERMINAL_MAX_COLUMNS + GUAC_TERMINAL_MAX_CHAR_WIDTH];
+    int span_start = 0;
+    int span_length = 0;
+
+    /* Bail out unless received text would be displayed verbatim */
+    if (term->char_handler != guac_terminal_echo
+            || term->pipe_stream != NULL
+            || term->char_mapping[term->active_char_set] != NULL
+            || term->insert_mode
+            || term->utf8_bytes_remaining != 0)
+        return 0;
+
+    length = guac_terminal_span_printable(buffer, length);
+
+    int handled = 0;
+    while (handled < length) {
+
+        int codepoint;
+        int size = guac_terminal_decode_utf8(buffer + handled,
+                length - handled, &codepoint);
+
+        /* Leave malformed data, control characters produced by overlong
+         * sequences, and CSI to guac_terminal_echo() */
+        if (size == 0 || codepoint < 0x20 || codepoint == 0x7F
+                || codepoint == 0x9B)
+            break;
+
+        /* Wrap if necessary, first writing everything pending for the
+         * current row */
+        if (term->cursor_col >= term->term_width) {
+
+            guac_terminal_set_span(term, term->cursor_row, span_start,
+                    span, span_length);
+            span_length = 0;
+
+            /* New line */
+            term->cursor_col = 0;
+            guac_terminal_linefeed(term, true);
+
+        }
+
+        /* ASCII is always a single column wide */
+        int width = 1;
+        if (codepoint >= 0x80) {
+            width = wcwidth(codepoint);
+            if (width < 0)
+                width = 1;
+        }
+
+        /* Append character and any continuations, advancing cursor */
+        if (width > 0) {
+
+            if (span_length == 0)
+                span_start = term->cursor_col;
+
+            guac_terminal_char* current = &(span[span_length]);
+            current->value = codepoint;
+            current->attributes = term->current_attributes;
+            current->width = width;
+
+            for (int i = 1; i < width; i++) {
+                current++;
+                current->value = GUAC_CHAR_CONTINUATION;
+                current->attributes = term->current_attributes;
+                current->width = 0;
+            }
+
+            span_length += width;
+            term->cursor_col += width;
+
+        }
+
+        handled += size;
+
+    }
+
+    guac_terminal_set_span(term, term->cursor_row, span_start,
+            span, span_length);
+
+    return handled;
+
+}
+
 int guac_terminal_echo(guac_terminal* term, unsigned char c) {
 
     int width;
 
-    static int bytes_remaining = 0;
-    static int codepoint = 0;
+    int bytes_remaining = term->utf8_bytes_remaining;
+    int codepoint = term->utf8_codepoint;
 
     const int* char_mapping = term->char_mapping[term->active_char_set];
 
@@ -296,6 +530,10 @@ int guac_terminal_echo(guac_terminal* term, unsigned char c) {
         bytes_remaining = 0;
     }
 
+    /* Store decoder state for the next byte */
+    term->utf8_bytes_remaining = bytes_remaining;
+    term->utf8_codepoint = codepoint;
+
     /* If we need more bytes, wait for more bytes */
     if (bytes_remaining != 0)
         return 0;
@@ -122,6 +122,8 @@ void guac_terminal_reset(guac_terminal* term) {
 
     /* Set current state */
     term->char_handler = guac_terminal_echo; 
+    term->utf8_codepoint = 0;
+    term->utf8_bytes_remaining = 0;
     term->active_char_set = 0;
     term->char_mapping[0] =
     term->char_mapping[1] = NULL;
@@ -252,6 +254,9 @@ guac_terminal_options* guac_terminal_options_create(
     options->font_size = GUAC_TERMINAL_DEFAULT_FONT_SIZE;
     options->color_scheme = GUAC_TERMINAL_DEFAULT_COLOR_SCHEME;
     options->backspace = GUAC_TERMINAL_DEFAULT_BACKSPACE;
+    options->func_keys_and_keypad = NULL;
+    options->glyph_atlas_size = GUAC_TERMINAL_DEFAULT_GLYPH_ATLAS_SIZE;
+    options->scrollback_spill_path = NULL;
 
     return options;
 }
@@ -380,6 +385,7 @@ guac_terminal* guac_terminal_create(guac_client* client,
     term->client = client;
     term->upload_path_handler = NULL;
     term->file_download_handler = NULL;
+    term->resize_handler = NULL;
 
     /* Copy initially-provided color scheme and font details */
     term->color_scheme = guac_strdup(options->color_scheme);
@@ -403,6 +409,14 @@ guac_terminal* guac_terminal_create(guac_client* client,
     term->current_buffer = term->normal_buffer = guac_terminal_buffer_alloc(initial_scrollback, &default_char);
     term->alternate_buffer = guac_terminal_buffer_alloc(GUAC_TERMINAL_MAX_ROWS, &default_char);
 
+    /* Store undisplayed scrollback within a file, if requested */
+    if (options->scrollback_spill_path != NULL
+            && guac_terminal_buffer_enable_spill(term->normal_buffer,
+                options->scrollback_spill_path))
+        guac_client_log(client, GUAC_LOG_WARNING, "Unable to create a file "
+                "for scrollback within \"%s\": %s. Scrollback will be kept in "
+                "memory.", options->scrollback_spill_path, strerror(errno));
+
     /* Init display */
     term->display = guac_terminal_display_alloc(client,
             options->font_name, options->font_size, options->dpi,
@@ -417,6 +431,11 @@ guac_terminal* guac_terminal_create(guac_client* client,
         return NULL;
     }
 
+    /* Draw repeated glyphs from a client-side atlas, if enabled */
+    if (options->glyph_atlas_size > 0)
+        guac_terminal_display_enable_glyph_atlas(term->display,
+                options->glyph_atlas_size);
+
     /* Init common cursor */
     term->cursor = guac_common_cursor_alloc(client);
 
@@ -440,6 +459,12 @@ guac_terminal* guac_terminal_create(guac_client* client,
     term->outer_height = height;
     term->outer_width = width;
 
+    /* No resize is pending until requested */
+    term->requested_height = height;
+    term->requested_width = width;
+    term->resize_pending = false;
+    term->redraw_pending = false;
+
     /* Set rows and columns size */
     term->term_height = rows;
     term->term_width  = columns;
@@ -580,77 +605,6 @@ void guac_terminal_free(guac_terminal* term) {
 
 }
 
-/**
- * Waits for the terminal state to be modified, returning only when the
- * specified timeout has elapsed or a frame flush is desired. Note that the
- * modified flag of the terminal will only be reset if no data remains to be
- * read from STDOUT.
- *
- * @param terminal
- *    The terminal to wait on.
- *
- * @param msec_timeout
- *    The maximum amount of time to wait, in milliseconds.
- *
- * @return
- *    Non-zero if the terminal has been modified, zero if the timeout has
- *    elapsed without the terminal being modified.
- */
-static int guac_terminal_wait(guac_terminal* terminal, int msec_timeout) {
-
-    int retval = guac_flag_timedwait_and_lock(&terminal->modified,
-            GUAC_TERMINAL_MODIFIED, msec_timeout);
-
-    /* Rest terminal modified state */
-    if (retval) {
-        guac_flag_clear(&terminal->modified, GUAC_TERMINAL_MODIFIED);
-        guac_flag_unlock(&terminal->modified);
-    }
-
-    return retval;
-
-}
-
-int guac_terminal_render_frame(guac_terminal* terminal) {
-
-    guac_client* client = terminal->client;
-
-    int wait_result;
-
-    /* Wait for data to be available */
-    wait_result = guac_terminal_wait(terminal, 1000);
-    if (wait_result || !terminal->started) {
-
-        guac_timestamp frame_start = client->last_sent_timestamp;
-
-        do {
-
-            /* Calculate time remaining in frame */
-            guac_timestamp frame_end = guac_timestamp_current();
-            int frame_remaining = frame_start + GUAC_TERMINAL_FRAME_DURATION
-                                - frame_end;
-
-            /* Wait again if frame remaining */
-            if (frame_remaining > 0 || !terminal->started)
-                wait_result = guac_terminal_wait(terminal,
-                        GUAC_TERMINAL_FRAME_TIMEOUT);
-            else
-                break;
-
-        } while (client->state == GUAC_CLIENT_RUNNING
-                && (wait_result > 0 || !terminal->started));
-
-        /* Flush terminal */
-        guac_terminal_lock(terminal);
-        guac_terminal_flush(terminal);
-        guac_terminal_unlock(terminal);
-
-    }
-
-    return 0;
-
-}
-
 int guac_terminal_read_stdin(guac_terminal* terminal, char* c, int size) {
     int stdin_fd = terminal->stdin_pipe_fd[0];
     return read(stdin_fd, c, size);
@@ -812,20 +766,31 @@ void guac_terminal_commit_cursor(guac_terminal* term) {
 
 int guac_terminal_write(guac_terminal* term, const char* buffer, int length) {
 
+    const unsigned char* current = (const unsigned char*) buffer;
+    int remaining = length;
+
     guac_terminal_lock(term);
-    for (int written = 0; written < length; written++) {
 
-        /* Read and advance to next character */
-        char current = *(buffer++);
+    /* Write all data to typescript, if any */
+    if (term->typescript != NULL)
+        guac_terminal_typescript_write_buffer(term->typescript, buffer, length);
+
+    while (remaining > 0) {
 
-        /* Write character to typescript, if any */
-        if (term->typescript != NULL)
-            guac_terminal_typescript_write(term->typescript, current);
+        /* Render any leading run of printable text in bulk */
+        int written = guac_terminal_echo_run(term, current, remaining);
+
+        /* Otherwise, handle the next character and its meaning */
+        if (written == 0) {
+            term->char_handler(term, *current);
+            written = 1;
+        }
 
-        /* Handle character and its meaning */
-        term->char_handler(term, current);
+        current += written;
+        remaining -= written;
 
     }
+
     guac_terminal_unlock(term);
 
     guac_terminal_notify(term);
@@ -846,7 +811,7 @@ void guac_terminal_scroll_up(guac_terminal* term,
     if (start_row == 0 && end_row == term->term_height - 1) {
 
         /* Scroll up visibly */
-        guac_terminal_display_copy_rows(term->display, start_row + amount, end_row, -amount);
+        guac_terminal_display_scroll_up(term->display, amount);
 
         /* Advance and increase buffer length by scroll amount */
         guac_terminal_buffer_scroll_up(term->current_buffer, amount, true);
@@ -1177,6 +1142,44 @@ void guac_terminal_set_columns(guac_terminal* terminal, int row,
 
 }
 
+void guac_terminal_set_span(guac_terminal* terminal, int row,
+        int start_column, const guac_terminal_char* characters, int length) {
+
+    if (length <= 0)
+        return;
+
+    int end_column = start_column + length - 1;
+
+    guac_terminal_display_set_span(terminal->display, row + terminal->scroll_offset,
+            start_column, characters, length);
+
+    guac_terminal_buffer_set_span(terminal->current_buffer, row,
+            start_column, characters, length);
+
+    /* Clear selection if region is modified */
+    guac_terminal_select_touch(terminal, row, start_column, row, end_column);
+
+    /* If visible cursor in current row, preserve state */
+    if (row == terminal->visible_cursor_row
+            && terminal->visible_cursor_col >= start_column
+            && terminal->visible_cursor_col <= end_column) {
+
+        /* Locate the character occupying the cursor's column */
+        int index = terminal->visible_cursor_col - start_column;
+        while (index > 0 && characters[index].value == GUAC_CHAR_CONTINUATION)
+            index--;
+
+        /* Create copy of character with cursor attribute set */
+        guac_terminal_char cursor_character = characters[index];
+        cursor_character.attributes.cursor = true;
+
+        __guac_terminal_set_columns(terminal, row,
+                terminal->visible_cursor_col, terminal->visible_cursor_col, &cursor_character);
+
+    }
+
+}
+
 static void __guac_terminal_redraw_rect(guac_terminal* term, int start_row, int start_col, int end_row, int end_col) {
 
     int row, col;
@@ -1334,13 +1337,28 @@ static void __guac_terminal_resize(guac_terminal* term, int width, int height) {
 
 }
 
-int guac_terminal_resize(guac_terminal* terminal, int width, int height) {
+/**
+ * Applies the size most recently requested via guac_terminal_resize(),
+ * resizing the client display and terminal to those pixel dimensions. The
+ * terminal must already be locked by the current thread.
+ *
+ * @param terminal
+ *     The terminal to resize.
+ *
+ * @return
+ *     Non-zero if the number of rows or columns of the terminal has changed,
+ *     zero otherwise.
+ */
+static int guac_terminal_apply_resize(guac_terminal* terminal) {
 
     guac_terminal_display* display = terminal->display;
     guac_client* client = display->client;
 
-    /* Acquire exclusive access to terminal */
-    guac_terminal_lock(terminal);
+    int width = terminal->requested_width;
+    int height = terminal->requested_height;
+    int changed = 0;
+
+    terminal->resize_pending = false;
 
     /* Calculate available text display area by character size */
     int rows, columns;
@@ -1370,6 +1388,7 @@ int guac_terminal_resize(guac_terminal* terminal, int width, int height) {
 
         /* Reset scroll region */
         terminal->scroll_end = rows - 1;
+        changed = 1;
     }
 
     /* Notify scrollbar of resize */
@@ -1378,6 +1397,61 @@ int guac_terminal_resize(guac_terminal* terminal, int width, int height) {
     guac_terminal_scrollbar_set_bounds(terminal->scrollbar,
             -guac_terminal_get_available_scroll(terminal), 0);
 
+    return changed;
+
+}
+
+/**
+ * Applies any pending resize of the given terminal, invoking the resize
+ * handler of the terminal (if any) if the number of rows or columns changes
+ * as a result, and then performs any pending redraw. This function is invoked
+ * only by the terminal render thread. The terminal must NOT already be locked
+ * by the current thread.
+ *
+ * @param terminal
+ *     The terminal to resize.
+ */
+static void guac_terminal_apply_pending_resize(guac_terminal* terminal) {
+
+    /* Acquire exclusive access to terminal */
+    guac_terminal_lock(terminal);
+
+    /* Only the most recently requested size need be applied */
+    int changed = 0;
+    if (terminal->resize_pending)
+        changed = guac_terminal_apply_resize(terminal);
+
+    /* Redraw only after resizing, such that the entire new area is drawn */
+    if (terminal->redraw_pending) {
+        guac_terminal_redraw_default_layer(terminal);
+        terminal->redraw_pending = false;
+    }
+
+    int columns = terminal->term_width;
+    int rows = terminal->term_height;
+    guac_terminal_resize_handler* resize_handler = terminal->resize_handler;
+
+    /* Release terminal */
+    guac_terminal_unlock(terminal);
+
+    /* Notify of new dimensions only after the terminal has been released, as
+     * the handler may block while informing the remote side */
+    if (changed && resize_handler != NULL)
+        resize_handler(terminal->client, columns, rows);
+
+}
+
+int guac_terminal_resize(guac_terminal* terminal, int width, int height) {
+
+    /* Acquire exclusive access to terminal */
+    guac_terminal_lock(terminal);
+
+    /* Defer the resize until the next frame, replacing any resize which
+     * has been requested but not yet applied */
+    terminal->requested_width = width;
+    terminal->requested_height = height;
+    terminal->resize_pending = true;
+
     /* Release terminal */
     guac_terminal_unlock(terminal);
 
@@ -1386,6 +1460,80 @@ int guac_terminal_resize(guac_terminal* terminal, int width, int height) {
 
 }
 
+/**
+ * Waits for the terminal state to be modified, returning only when the
+ * specified timeout has elapsed or a frame flush is desired. Note that the
+ * modified flag of the terminal will only be reset if no data remains to be
+ * read from STDOUT.
+ *
+ * @param terminal
+ *    The terminal to wait on.
+ *
+ * @param msec_timeout
+ *    The maximum amount of time to wait, in milliseconds.
+ *
+ * @return
+ *    Non-zero if the terminal has been modified, zero if the timeout has
+ *    elapsed without the terminal being modified.
+ */
+static int guac_terminal_wait(guac_terminal* terminal, int msec_timeout) {
+
+    int retval = guac_flag_timedwait_and_lock(&terminal->modified,
+            GUAC_TERMINAL_MODIFIED, msec_timeout);
+
+    /* Rest terminal modified state */
+    if (retval) {
+        guac_flag_clear(&terminal->modified, GUAC_TERMINAL_MODIFIED);
+        guac_flag_unlock(&terminal->modified);
+    }
+
+    return retval;
+
+}
+
+int guac_terminal_render_frame(guac_terminal* terminal) {
+
+    guac_client* client = terminal->client;
+
+    int wait_result;
+
+    /* Wait for data to be available */
+    wait_result = guac_terminal_wait(terminal, 1000);
+    if (wait_result || !terminal->started) {
+
+        guac_timestamp frame_start = client->last_sent_timestamp;
+
+        do {
+
+            /* Calculate time remaining in frame */
+            guac_timestamp frame_end = guac_timestamp_current();
+            int frame_remaining = frame_start + GUAC_TERMINAL_FRAME_DURATION
+                                - frame_end;
+
+            /* Wait again if frame remaining */
+            if (frame_remaining > 0 || !terminal->started)
+                wait_result = guac_terminal_wait(terminal,
+                        GUAC_TERMINAL_FRAME_TIMEOUT);
+            else
+                break;
+
+        } while (client->state == GUAC_CLIENT_RUNNING
+                && (wait_result > 0 || !terminal->started));
+
+        /* Apply only the final size of any burst of resizes */
+        guac_terminal_apply_pending_resize(terminal);
+
+        /* Flush terminal */
+        guac_terminal_lock(terminal);
+        guac_terminal_flush(terminal);
+        guac_terminal_unlock(terminal);
+
+    }
+
+    return 0;
+
+}
+
 void guac_terminal_flush(guac_terminal* terminal) {
 
     /* Flush typescript if in use */
@@ -1402,6 +1550,15 @@ void guac_terminal_flush(guac_terminal* terminal) {
     guac_terminal_display_flush(terminal->display);
     guac_terminal_scrollbar_flush(terminal->scrollbar);
 
+    /* Compact all rows no longer on screen or in view */
+    guac_terminal_buffer_compact(terminal->normal_buffer,
+            terminal->current_buffer == terminal->normal_buffer ? -terminal->scroll_offset : 0,
+            terminal->term_height - 1);
+
+    guac_terminal_buffer_compact(terminal->alternate_buffer,
+            terminal->current_buffer == terminal->alternate_buffer ? -terminal->scroll_offset : 0,
+            terminal->term_height - 1);
+
 }
 
 void guac_terminal_lock(guac_terminal* terminal) {
@@ -2677,6 +2834,22 @@ void guac_terminal_sync_users(
 
 }
 
+void guac_terminal_write_keyframe(guac_terminal* term, guac_socket* socket) {
+
+    guac_client* client = term->client;
+
+    guac_terminal_lock(term);
+
+    /* Copy the display as it stands after the most recent frame */
+    __guac_terminal_sync_socket(client, term, socket);
+    guac_protocol_send_sync(socket, client->last_sent_timestamp, 1);
+
+    guac_terminal_unlock(term);
+
+    guac_socket_flush(socket);
+
+}
+
 void guac_terminal_apply_color_scheme(guac_terminal* terminal,
         const char* color_scheme) {
 
@@ -2724,17 +2897,16 @@ void guac_terminal_apply_font(guac_terminal* terminal, const char* font_name,
     if (guac_terminal_display_set_font(display, font_name, font_size, dpi))
         return;
 
-    /* Resize terminal to fit available region, now that font metrics may be
-     * different */
-    guac_terminal_resize(terminal, terminal->outer_width,
-            terminal->outer_height);
-
-    /* Redraw terminal text and background */
-    guac_terminal_redraw_default_layer(terminal);
-
     /* Acquire exclusive access to terminal */
     guac_terminal_lock(terminal);
 
+    /* Resize terminal to fit available region, now that font metrics may be
+     * different, and redraw terminal text and background using the new font.
+     * Both are deferred to the render thread, such that the resize handler
+     * is always invoked from that thread. */
+    terminal->resize_pending = true;
+    terminal->redraw_pending = true;
+
     /* Update stored copy of font name, if changed */
     if (font_name != NULL)
         terminal->font_name = guac_strdup(font_name);
@@ -2760,6 +2932,11 @@ void guac_terminal_set_file_download_handler(guac_terminal* terminal,
     terminal->file_download_handler = file_download_handler;
 }
 
+void guac_terminal_set_resize_handler(guac_terminal* terminal,
+        guac_terminal_resize_handler* resize_handler) {
+    terminal->resize_handler = resize_handler;
+}
+
 const char* guac_terminal_get_font_name(guac_terminal* terminal) {
     return terminal->font_name;
 }
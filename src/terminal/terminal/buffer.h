@@ -35,6 +35,8 @@
 
 #include "types.h"
 
+#include <stddef.h>
+
 /**
  * A buffer containing a constant number of arbitrary-length rows.
  * New rows can be appended to the buffer, with the oldest row replaced with
@@ -42,6 +44,36 @@
  */
 typedef struct guac_terminal_buffer guac_terminal_buffer;
 
+/**
+ * The amount of memory used by a guac_terminal_buffer, broken down by how
+ * that memory is used.
+ */
+typedef struct guac_terminal_buffer_usage {
+
+    /**
+     * The number of bytes used to track each row, regardless of its contents.
+     */
+    size_t rows;
+
+    /**
+     * The number of bytes used by rows that are currently decoded.
+     */
+    size_t decoded;
+
+    /**
+     * The number of bytes used by rows stored in compact form within the
+     * heap.
+     */
+    size_t encoded;
+
+    /**
+     * The number of bytes used by rows stored in compact form within the
+     * spill file of the buffer, if any.
+     */
+    size_t spilled;
+
+} guac_terminal_buffer_usage;
+
 /**
  * Allocates a new buffer having the given maximum number of rows. New character cells will
  * be initialized to the given character.
@@ -54,6 +86,60 @@ guac_terminal_buffer* guac_terminal_buffer_alloc(int rows,
  */
 void guac_terminal_buffer_free(guac_terminal_buffer* buffer);
 
+/**
+ * Stores the compact form of rows which are not being displayed within a
+ * memory-mapped temporary file created within the given directory, rather
+ * than within the heap. Only rows compacted after this function is called
+ * are affected.
+ *
+ * @param buffer
+ *     The buffer that should store its compact rows within a spill file.
+ *
+ * @param path
+ *     The directory in which the spill file should be created.
+ *
+ * @return
+ *     Zero if the spill file was created successfully, non-zero otherwise,
+ *     in which case errno is set appropriately and compact rows continue to
+ *     be stored within the heap.
+ */
+int guac_terminal_buffer_enable_spill(guac_terminal_buffer* buffer,
+        const char* path);
+
+/**
+ * Returns all decoded rows outside the given range to compact form, such
+ * that they occupy far less memory until next accessed. Any row that is
+ * accessed through the functions of this header is transparently decoded
+ * again, thus pointers previously returned by
+ * guac_terminal_buffer_get_columns() for rows outside the given range are no
+ * longer valid once this function returns.
+ *
+ * @param buffer
+ *     The buffer to compact.
+ *
+ * @param start_row
+ *     The first row of the range which should remain decoded, such as the
+ *     first row currently visible. Negative indices refer to rows within the
+ *     scrollback buffer.
+ *
+ * @param end_row
+ *     The last row of the range which should remain decoded, inclusive.
+ */
+void guac_terminal_buffer_compact(guac_terminal_buffer* buffer,
+        int start_row, int end_row);
+
+/**
+ * Retrieves the amount of memory currently used by the given buffer.
+ *
+ * @param buffer
+ *     The buffer to inspect.
+ *
+ * @param usage
+ *     The structure which should receive the memory usage of the buffer.
+ */
+void guac_terminal_buffer_get_usage(guac_terminal_buffer* buffer,
+        guac_terminal_buffer_usage* usage);
+
 /**
  * Resets the state of the given buffer such that it effectively no longer
  * contains any rows. Space for previous rows, including the data from those
@@ -121,6 +207,14 @@ void guac_terminal_buffer_scroll_down(guac_terminal_buffer* buffer, int amount);
 void guac_terminal_buffer_set_columns(guac_terminal_buffer* buffer, int row,
         int start_column, int end_column, guac_terminal_char* character);
 
+/**
+ * Stores the given run of characters within the given row, one character per
+ * column beginning at the given column. Multi-column characters must be
+ * followed by their GUAC_CHAR_CONTINUATION characters within the run.
+ */
+void guac_terminal_buffer_set_span(guac_terminal_buffer* buffer, int row,
+        int start_column, const guac_terminal_char* characters, int length);
+
 /**
  * Get the char (int ASCII code) at a specific row/col of the display.
  *
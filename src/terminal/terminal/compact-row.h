@@ -0,0 +1,123 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_TERMINAL_COMPACT_ROW_H
+#define GUAC_TERMINAL_COMPACT_ROW_H
+
+/**
+ * A compact, self-describing encoding of a single row of terminal data, used
+ * to store rows of scrollback which are not currently being rendered, selected,
+ * or otherwise accessed. Attributes are stored once for each run of
+ * consecutive characters sharing those attributes, rather than once per
+ * character, and codepoints are stored using the narrowest of 1, 2, or 4 bytes
+ * that can represent every codepoint within the row.
+ *
+ * Encoded rows are laid out as a fixed-size header, followed by the
+ * codepoints of each column, followed by the attribute runs. All values are
+ * stored in host byte order without alignment, as encoded rows never leave
+ * the process that created them.
+ *
+ * @file compact-row.h
+ */
+
+#include "terminal.h"
+#include "types.h"
+
+#include <stddef.h>
+
+/**
+ * The number of bytes occupied by the header of each encoded row.
+ */
+#define GUAC_TERMINAL_COMPACT_ROW_HEADER_SIZE 7
+
+/**
+ * The number of bytes occupied by each attribute run of an encoded row.
+ */
+#define GUAC_TERMINAL_COMPACT_ROW_RUN_SIZE 18
+
+/**
+ * The maximum number of bytes that an encoded row may occupy. This is the
+ * size of a row having the maximum number of columns, a distinct run of
+ * attributes for each column, and 4-byte codepoints.
+ */
+#define GUAC_TERMINAL_COMPACT_ROW_MAX_SIZE                                    \
+    (GUAC_TERMINAL_COMPACT_ROW_HEADER_SIZE                                    \
+     + GUAC_TERMINAL_MAX_COLUMNS * (GUAC_TERMINAL_COMPACT_ROW_RUN_SIZE + 4))
+
+/**
+ * Encodes the given characters as a compact row. The encoding is lossless:
+ * decoding the row with guac_terminal_compact_row_decode() produces exactly
+ * the characters given, except that the width of each GUAC_CHAR_CONTINUATION
+ * character (which is not applicable) is always zero.
+ *
+ * @param characters
+ *     The characters to encode.
+ *
+ * @param length
+ *     The number of characters to encode. This value may not exceed
+ *     GUAC_TERMINAL_MAX_COLUMNS.
+ *
+ * @param encoded
+ *     The buffer which should receive the encoded row. This buffer must be
+ *     at least GUAC_TERMINAL_COMPACT_ROW_MAX_SIZE bytes long.
+ *
+ * @return
+ *     The number of bytes written to the given buffer.
+ */
+size_t guac_terminal_compact_row_encode(const guac_terminal_char* characters,
+        int length, unsigned char* encoded);
+
+/**
+ * Returns the total number of bytes occupied by the given encoded row.
+ *
+ * @param encoded
+ *     The encoded row to inspect.
+ *
+ * @return
+ *     The size of the given encoded row, in bytes.
+ */
+size_t guac_terminal_compact_row_size(const unsigned char* encoded);
+
+/**
+ * Returns the number of characters (columns) within the given encoded row.
+ *
+ * @param encoded
+ *     The encoded row to inspect.
+ *
+ * @return
+ *     The number of characters within the given encoded row.
+ */
+int guac_terminal_compact_row_length(const unsigned char* encoded);
+
+/**
+ * Decodes the given encoded row, storing each of its characters within the
+ * given array.
+ *
+ * @param encoded
+ *     The encoded row to decode.
+ *
+ * @param characters
+ *     The array which should receive the decoded characters. This array must
+ *     have space for at least guac_terminal_compact_row_length() characters.
+ */
+void guac_terminal_compact_row_decode(const unsigned char* encoded,
+        guac_terminal_char* characters);
+
+#endif
+
@@ -27,6 +27,8 @@
  */
 
 #include "common/surface.h"
+#include "glyph-atlas.h"
+#include "glyph-cache.h"
 #include "palette.h"
 #include "types.h"
 
@@ -118,10 +120,27 @@ typedef struct guac_terminal_display {
     guac_client* client;
 
     /**
-     * Array of all operations pending for the visible screen area.
+     * Array of all operations pending for the visible screen area. This array
+     * begins within operations_storage, and is advanced through that storage
+     * by one row for each row scrolled by guac_terminal_display_scroll_up()
+     * until those scrolls are applied.
      */
     guac_terminal_operation* operations;
 
+    /**
+     * The storage backing the operations array, which has room for twice the
+     * height of the screen.
+     */
+    guac_terminal_operation* operations_storage;
+
+    /**
+     * The number of rows scrolled by guac_terminal_display_scroll_up() that
+     * have not yet been applied. Until applied, the NOP operations within all
+     * but the last pending_scroll rows of the operations array actually
+     * represent copies of the characters pending_scroll rows below.
+     */
+    int pending_scroll;
+
     /**
      * The width of the screen, in characters.
      */
@@ -152,6 +171,25 @@ typedef struct guac_terminal_display {
      */
     int char_height;
 
+    /**
+     * Cache of recently-rendered glyphs, allowing characters to be redrawn
+     * without again rendering them with Pango.
+     */
+    guac_terminal_glyph_cache* glyph_cache;
+
+    /**
+     * Whether the glyph cache has been warmed with the printable ASCII
+     * characters in the default colors since it was last invalidated.
+     */
+    bool glyph_cache_warm;
+
+    /**
+     * Client-side atlas of glyphs which have already been sent, allowing
+     * repeated characters to be drawn with "copy" instructions rather than
+     * new image data, or NULL if the atlas is disabled.
+     */
+    guac_terminal_glyph_atlas* glyph_atlas;
+
     /**
      * The current palette.
      */
@@ -247,6 +285,21 @@ guac_terminal_display* guac_terminal_display_alloc(guac_client* client,
  */
 void guac_terminal_display_free(guac_terminal_display* display);
 
+/**
+ * Enables the client-side glyph atlas of the given display. Once enabled,
+ * each distinct glyph is uploaded to an off-screen buffer once, and further
+ * occurrences of that glyph are drawn by copying from that buffer.
+ *
+ * @param display
+ *     The display whose glyph atlas should be enabled.
+ *
+ * @param max_size
+ *     The maximum number of bytes of client memory that the atlas may
+ *     occupy, assuming four bytes per pixel.
+ */
+void guac_terminal_display_enable_glyph_atlas(guac_terminal_display* display,
+        size_t max_size);
+
 /**
  * Resets the palette of the given display to the initial, default color
  * values, as defined by default_palette or GUAC_TERMINAL_INITIAL_PALETTE.
@@ -310,6 +363,24 @@ void guac_terminal_display_copy_columns(guac_terminal_display* display, int row,
 void guac_terminal_display_copy_rows(guac_terminal_display* display,
         int start_row, int end_row, int offset);
 
+/**
+ * Scrolls the entire display up by the given number of rows, with the same
+ * effect as copying all rows beyond the first amount rows upward by that
+ * number of rows with guac_terminal_display_copy_rows(). Where every
+ * character of the rows remaining at the bottom of the display has been
+ * redrawn, as is the case while new output repeatedly scrolls the display,
+ * the copy is deferred, such that a long series of scrolls requires only
+ * occasional copies of the entire display.
+ *
+ * @param display
+ *     The terminal display to scroll.
+ *
+ * @param amount
+ *     The number of rows to scroll up by.
+ */
+void guac_terminal_display_scroll_up(guac_terminal_display* display,
+        int amount);
+
 /**
  * Sets the given range of columns within the given row to the given
  * character.
@@ -317,6 +388,14 @@ void guac_terminal_display_copy_rows(guac_terminal_display* display,
 void guac_terminal_display_set_columns(guac_terminal_display* display, int row,
         int start_column, int end_column, guac_terminal_char* character);
 
+/**
+ * Sets the columns within the given row, beginning at the given column, to
+ * the given run of characters. GUAC_CHAR_CONTINUATION characters within the
+ * run are skipped, being covered by the character preceding them.
+ */
+void guac_terminal_display_set_span(guac_terminal_display* display, int row,
+        int start_column, const guac_terminal_char* characters, int length);
+
 /**
  * Resize the terminal to the given dimensions.
  */
@@ -0,0 +1,357 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_TERMINAL_GLYPH_ATLAS_H
+#define GUAC_TERMINAL_GLYPH_ATLAS_H
+
+/**
+ * An off-screen buffer, maintained both on the server and by each connected
+ * client, containing glyphs which have already been sent. Once a glyph has
+ * been uploaded to the atlas, further occurrences of that glyph are drawn by
+ * copying from the atlas rather than by sending new image data.
+ *
+ * @file glyph-atlas.h
+ */
+
+#include "common/surface.h"
+#include "glyph-cache.h"
+#include "palette.h"
+
+#include <guacamole/client.h>
+#include <guacamole/layer.h>
+#include <guacamole/socket.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The number of hash buckets within each glyph atlas. This value must be a
+ * power of two.
+ */
+#define GUAC_TERMINAL_GLYPH_ATLAS_BUCKETS 1024
+
+/**
+ * The number of glyph slots within each row of the atlas.
+ */
+#define GUAC_TERMINAL_GLYPH_ATLAS_COLUMNS 32
+
+/**
+ * The maximum height of the atlas buffer, in pixels, regardless of the
+ * memory budget. This keeps the atlas within the canvas size limits of
+ * typical browsers.
+ */
+#define GUAC_TERMINAL_GLYPH_ATLAS_MAX_HEIGHT 4096
+
+/**
+ * A single region of the atlas, large enough to hold a glyph of the maximum
+ * possible width, and the glyph that it currently holds, if any.
+ */
+typedef struct guac_terminal_atlas_slot {
+
+    /**
+     * The X coordinate of the upper-left corner of this slot within the
+     * atlas, in pixels.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the upper-left corner of this slot within the
+     * atlas, in pixels.
+     */
+    int y;
+
+    /**
+     * The Unicode codepoint of the character held by this slot.
+     */
+    int codepoint;
+
+    /**
+     * The width of the character held by this slot, in columns.
+     */
+    int width;
+
+    /**
+     * The foreground color of the character held by this slot, as packed
+     * 24-bit RGB.
+     */
+    uint32_t foreground;
+
+    /**
+     * The background color of the character held by this slot, as packed
+     * 24-bit RGB.
+     */
+    uint32_t background;
+
+    /**
+     * The frame during which this slot was last drawn. Slots drawn during
+     * the current frame are never reused until the next frame.
+     */
+    uint64_t frame;
+
+    /**
+     * The next occupied slot within the same hash bucket, or NULL if this is
+     * the last slot in the bucket.
+     */
+    struct guac_terminal_atlas_slot* next;
+
+    /**
+     * The occupied slot which was drawn more recently than this slot, or NULL
+     * if this slot was drawn most recently.
+     */
+    struct guac_terminal_atlas_slot* newer;
+
+    /**
+     * The occupied slot which was drawn less recently than this slot, or NULL
+     * if this slot was drawn least recently.
+     */
+    struct guac_terminal_atlas_slot* older;
+
+} guac_terminal_atlas_slot;
+
+/**
+ * A client-side atlas of glyphs, along with the server-side state needed to
+ * decide which glyphs it holds.
+ */
+typedef struct guac_terminal_glyph_atlas {
+
+    /**
+     * The client whose users receive the atlas.
+     */
+    guac_client* client;
+
+    /**
+     * The off-screen buffer containing the atlas.
+     */
+    guac_layer* buffer;
+
+    /**
+     * The surface backing the atlas buffer.
+     */
+    guac_common_surface* surface;
+
+    /**
+     * The maximum number of bytes of client memory that the atlas buffer may
+     * occupy, assuming four bytes per pixel.
+     */
+    size_t max_size;
+
+    /**
+     * The width of each slot, in pixels.
+     */
+    int slot_width;
+
+    /**
+     * The height of each slot, in pixels.
+     */
+    int slot_height;
+
+    /**
+     * All slots within the atlas.
+     */
+    guac_terminal_atlas_slot* slots;
+
+    /**
+     * The total number of slots within the atlas.
+     */
+    int slot_count;
+
+    /**
+     * The number of slots which have ever held a glyph since the atlas was
+     * last cleared. Slots beyond this point are free.
+     */
+    int slots_used;
+
+    /**
+     * Hash table of all occupied slots, keyed by codepoint and colors.
+     */
+    guac_terminal_atlas_slot* buckets[GUAC_TERMINAL_GLYPH_ATLAS_BUCKETS];
+
+    /**
+     * The most recently drawn slot, or NULL if the atlas is empty.
+     */
+    guac_terminal_atlas_slot* newest;
+
+    /**
+     * The least recently drawn slot, or NULL if the atlas is empty.
+     */
+    guac_terminal_atlas_slot* oldest;
+
+    /**
+     * The current frame, incremented each time the terminal display is
+     * flushed.
+     */
+    uint64_t frame;
+
+    /**
+     * The total number of glyphs drawn from those already within the atlas.
+     */
+    uint64_t hits;
+
+    /**
+     * The total number of glyphs which had to be uploaded to the atlas.
+     */
+    uint64_t misses;
+
+} guac_terminal_glyph_atlas;
+
+/**
+ * Allocates a new glyph atlas within a new off-screen buffer. The atlas
+ * holds no glyphs until its character dimensions are assigned with
+ * guac_terminal_glyph_atlas_set_font().
+ *
+ * @param client
+ *     The client whose users should receive the atlas.
+ *
+ * @param max_size
+ *     The maximum number of bytes of client memory that the atlas buffer may
+ *     occupy, assuming four bytes per pixel.
+ *
+ * @return
+ *     A newly-allocated glyph atlas, which must eventually be freed with
+ *     guac_terminal_glyph_atlas_free().
+ */
+guac_terminal_glyph_atlas* guac_terminal_glyph_atlas_alloc(guac_client* client,
+        size_t max_size);
+
+/**
+ * Frees the given glyph atlas, disposing of its buffer.
+ *
+ * @param atlas
+ *     The glyph atlas to free.
+ */
+void guac_terminal_glyph_atlas_free(guac_terminal_glyph_atlas* atlas);
+
+/**
+ * Assigns the dimensions of the character cells of all future glyphs,
+ * resizing the atlas buffer to fit as many slots as its budget allows and
+ * discarding all glyphs uploaded for any previous font.
+ *
+ * @param atlas
+ *     The glyph atlas whose font is being changed.
+ *
+ * @param char_width
+ *     The width of each character cell, in pixels.
+ *
+ * @param char_height
+ *     The height of each character cell, in pixels.
+ */
+void guac_terminal_glyph_atlas_set_font(guac_terminal_glyph_atlas* atlas,
+        int char_width, int char_height);
+
+/**
+ * Begins a new frame. Slots drawn during previous frames become eligible for
+ * reuse by glyphs uploaded during the new frame.
+ *
+ * @param atlas
+ *     The glyph atlas to update.
+ */
+void guac_terminal_glyph_atlas_begin_frame(guac_terminal_glyph_atlas* atlas);
+
+/**
+ * Locates the slot holding the given character drawn with the given colors,
+ * uploading that character to the atlas using the given glyph cache if it is
+ * not already present. The located slot is marked as drawn during the
+ * current frame.
+ *
+ * @param atlas
+ *     The glyph atlas to search.
+ *
+ * @param cache
+ *     The glyph cache to use to render the character, if it must be
+ *     uploaded.
+ *
+ * @param codepoint
+ *     The Unicode codepoint of the character.
+ *
+ * @param width
+ *     The width of the character, in columns. This must be greater than zero
+ *     and no greater than GUAC_TERMINAL_MAX_CHAR_WIDTH.
+ *
+ * @param foreground
+ *     The color of the character itself.
+ *
+ * @param background
+ *     The color of the character cells behind the character.
+ *
+ * @return
+ *     The slot holding the character, or NULL if the character is not within
+ *     the atlas and cannot be uploaded because every slot has already been
+ *     drawn during the current frame.
+ */
+guac_terminal_atlas_slot* guac_terminal_glyph_atlas_get(
+        guac_terminal_glyph_atlas* atlas, guac_terminal_glyph_cache* cache,
+        int codepoint, int width, const guac_terminal_color* foreground,
+        const guac_terminal_color* background);
+
+/**
+ * Locates the slot holding the given character drawn with the given colors,
+ * without uploading the character if it is not present and without affecting
+ * which glyphs are evicted.
+ *
+ * @param atlas
+ *     The glyph atlas to search.
+ *
+ * @param codepoint
+ *     The Unicode codepoint of the character.
+ *
+ * @param width
+ *     The width of the character, in columns.
+ *
+ * @param foreground
+ *     The color of the character itself.
+ *
+ * @param background
+ *     The color of the character cells behind the character.
+ *
+ * @return
+ *     The slot holding the character, or NULL if the character is not within
+ *     the atlas.
+ */
+guac_terminal_atlas_slot* guac_terminal_glyph_atlas_find(
+        guac_terminal_glyph_atlas* atlas, int codepoint, int width,
+        const guac_terminal_color* foreground,
+        const guac_terminal_color* background);
+
+/**
+ * Sends any glyphs uploaded to the atlas which have not yet been sent.
+ *
+ * @param atlas
+ *     The glyph atlas to flush.
+ */
+void guac_terminal_glyph_atlas_flush(guac_terminal_glyph_atlas* atlas);
+
+/**
+ * Sends the entire atlas over the given socket, such that joining users can
+ * draw glyphs from the atlas exactly as existing users do.
+ *
+ * @param atlas
+ *     The glyph atlas to send.
+ *
+ * @param client
+ *     The client whose users are joining.
+ *
+ * @param socket
+ *     The socket over which the atlas should be sent.
+ */
+void guac_terminal_glyph_atlas_dup(guac_terminal_glyph_atlas* atlas,
+        guac_client* client, guac_socket* socket);
+
+#endif
+
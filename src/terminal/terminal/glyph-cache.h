@@ -0,0 +1,278 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_TERMINAL_GLYPH_CACHE_H
+#define GUAC_TERMINAL_GLYPH_CACHE_H
+
+/**
+ * A bounded cache of fully-rendered glyphs, allowing characters which have
+ * already been drawn with a given combination of colors to be redrawn without
+ * again invoking Pango.
+ *
+ * @file glyph-cache.h
+ */
+
+#include "palette.h"
+
+#include <cairo/cairo.h>
+#include <pango/pangocairo.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The number of hash buckets within each glyph cache. This value must be a
+ * power of two.
+ */
+#define GUAC_TERMINAL_GLYPH_CACHE_BUCKETS 1024
+
+/**
+ * The maximum number of bytes of rendered image data that a glyph cache may
+ * hold by default. Once this limit is reached, the glyphs least recently
+ * drawn are discarded to make room for new glyphs.
+ */
+#define GUAC_TERMINAL_GLYPH_CACHE_DEFAULT_SIZE (4 * 1024 * 1024)
+
+/**
+ * The first codepoint rendered in advance when a glyph cache is warmed.
+ */
+#define GUAC_TERMINAL_GLYPH_CACHE_WARM_FIRST 0x20
+
+/**
+ * The last codepoint rendered in advance when a glyph cache is warmed.
+ */
+#define GUAC_TERMINAL_GLYPH_CACHE_WARM_LAST 0x7E
+
+/**
+ * A single rendered glyph, along with everything that was used to render it.
+ */
+typedef struct guac_terminal_glyph {
+
+    /**
+     * The Unicode codepoint of the character rendered.
+     */
+    int codepoint;
+
+    /**
+     * The width of the rendered character, in columns.
+     */
+    int width;
+
+    /**
+     * The foreground color of the rendered character, as packed 24-bit RGB.
+     */
+    uint32_t foreground;
+
+    /**
+     * The background color of the rendered character, as packed 24-bit RGB.
+     */
+    uint32_t background;
+
+    /**
+     * The rendered character, exactly covering the character cells that it
+     * occupies.
+     */
+    cairo_surface_t* surface;
+
+    /**
+     * The number of bytes of image data within the rendered surface.
+     */
+    size_t size;
+
+    /**
+     * The next glyph within the same hash bucket, or NULL if this is the last
+     * glyph in the bucket.
+     */
+    struct guac_terminal_glyph* next;
+
+    /**
+     * The glyph which was drawn more recently than this glyph, or NULL if
+     * this glyph was drawn most recently.
+     */
+    struct guac_terminal_glyph* newer;
+
+    /**
+     * The glyph which was drawn less recently than this glyph, or NULL if
+     * this glyph was drawn least recently.
+     */
+    struct guac_terminal_glyph* older;
+
+} guac_terminal_glyph;
+
+/**
+ * A cache of rendered glyphs for a single font, bounded by the total size of
+ * the rendered image data.
+ */
+typedef struct guac_terminal_glyph_cache {
+
+    /**
+     * Hash table of all cached glyphs, keyed by codepoint and colors.
+     */
+    guac_terminal_glyph* buckets[GUAC_TERMINAL_GLYPH_CACHE_BUCKETS];
+
+    /**
+     * The most recently drawn glyph, or NULL if the cache is empty.
+     */
+    guac_terminal_glyph* newest;
+
+    /**
+     * The least recently drawn glyph, or NULL if the cache is empty.
+     */
+    guac_terminal_glyph* oldest;
+
+    /**
+     * The total number of bytes of rendered image data currently cached.
+     */
+    size_t size;
+
+    /**
+     * The maximum number of bytes of rendered image data that may be cached.
+     */
+    size_t max_size;
+
+    /**
+     * The description of the font used to render all glyphs. This font
+     * description is owned by the terminal display, not the cache.
+     */
+    PangoFontDescription* font_desc;
+
+    /**
+     * The width of each character cell, in pixels.
+     */
+    int char_width;
+
+    /**
+     * The height of each character cell, in pixels.
+     */
+    int char_height;
+
+    /**
+     * The total number of lookups satisfied by previously-rendered glyphs.
+     */
+    uint64_t hits;
+
+    /**
+     * The total number of lookups which required a glyph to be rendered.
+     */
+    uint64_t misses;
+
+} guac_terminal_glyph_cache;
+
+/**
+ * Allocates a new, empty glyph cache. No glyphs can be rendered until a font
+ * has been assigned with guac_terminal_glyph_cache_set_font().
+ *
+ * @param max_size
+ *     The maximum number of bytes of rendered image data that the cache may
+ *     hold.
+ *
+ * @return
+ *     A newly-allocated glyph cache, which must eventually be freed with
+ *     guac_terminal_glyph_cache_free().
+ */
+guac_terminal_glyph_cache* guac_terminal_glyph_cache_alloc(size_t max_size);
+
+/**
+ * Frees the given glyph cache and all glyphs within it.
+ *
+ * @param cache
+ *     The glyph cache to free.
+ */
+void guac_terminal_glyph_cache_free(guac_terminal_glyph_cache* cache);
+
+/**
+ * Discards all glyphs within the given cache, such that any future lookups
+ * will render their glyphs anew.
+ *
+ * @param cache
+ *     The glyph cache to clear.
+ */
+void guac_terminal_glyph_cache_clear(guac_terminal_glyph_cache* cache);
+
+/**
+ * Assigns the font and character cell dimensions used to render all future
+ * glyphs, discarding all glyphs rendered with any previous font.
+ *
+ * @param cache
+ *     The glyph cache whose font is being changed.
+ *
+ * @param font_desc
+ *     The description of the font to use. This font description must remain
+ *     valid until the font is again changed or the cache is freed.
+ *
+ * @param char_width
+ *     The width of each character cell, in pixels.
+ *
+ * @param char_height
+ *     The height of each character cell, in pixels.
+ */
+void guac_terminal_glyph_cache_set_font(guac_terminal_glyph_cache* cache,
+        PangoFontDescription* font_desc, int char_width, int char_height);
+
+/**
+ * Returns the rendered form of the given character drawn with the given
+ * colors, rendering and caching that character if it has not been rendered
+ * recently. The returned surface is owned by the cache and remains valid only
+ * until the next call to any glyph cache function.
+ *
+ * @param cache
+ *     The glyph cache to search.
+ *
+ * @param codepoint
+ *     The Unicode codepoint of the character to render.
+ *
+ * @param width
+ *     The width of the character, in columns. This must be greater than
+ *     zero.
+ *
+ * @param foreground
+ *     The color of the character itself.
+ *
+ * @param background
+ *     The color of the character cells behind the character.
+ *
+ * @return
+ *     A Cairo image surface exactly covering the character cells occupied by
+ *     the character, or NULL if the character could not be rendered.
+ */
+cairo_surface_t* guac_terminal_glyph_cache_get(guac_terminal_glyph_cache* cache,
+        int codepoint, int width, const guac_terminal_color* foreground,
+        const guac_terminal_color* background);
+
+/**
+ * Renders and caches the printable ASCII characters using the given colors,
+ * such that the most common characters can be drawn immediately. Characters
+ * already within the cache are left untouched.
+ *
+ * @param cache
+ *     The glyph cache to warm.
+ *
+ * @param foreground
+ *     The color that characters will most likely be drawn with.
+ *
+ * @param background
+ *     The color that will most likely be behind those characters.
+ */
+void guac_terminal_glyph_cache_warm(guac_terminal_glyph_cache* cache,
+        const guac_terminal_color* foreground,
+        const guac_terminal_color* background);
+
+#endif
+
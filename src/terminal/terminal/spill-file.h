@@ -0,0 +1,171 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_TERMINAL_SPILL_FILE_H
+#define GUAC_TERMINAL_SPILL_FILE_H
+
+/**
+ * Storage for compact rows of scrollback within a memory-mapped temporary
+ * file, rather than within the heap. As the file is mapped shared, the pages
+ * holding rows which are not accessed may be written back and reclaimed by
+ * the kernel as needed, rather than remaining resident for the life of the
+ * connection.
+ *
+ * @file spill-file.h
+ */
+
+#include <stddef.h>
+
+/**
+ * The number of bytes mapped at a time as the spill file grows. Blocks never
+ * span mappings, and mappings are never moved once created, so pointers to
+ * stored data remain valid until that data is released.
+ */
+#define GUAC_TERMINAL_SPILL_FILE_SEGMENT_SIZE (4 * 1024 * 1024)
+
+/**
+ * The granularity of block sizes within a spill file, in bytes. Each block is
+ * a multiple of this size, and is aligned to this size within the file.
+ */
+#define GUAC_TERMINAL_SPILL_FILE_BLOCK_ALIGNMENT 32
+
+/**
+ * The size of the largest block that may be allocated within a spill file.
+ * This is sufficient for the largest possible compact row.
+ */
+#define GUAC_TERMINAL_SPILL_FILE_MAX_BLOCK_SIZE 32768
+
+/**
+ * The number of distinct block sizes.
+ */
+#define GUAC_TERMINAL_SPILL_FILE_CLASSES \
+    (GUAC_TERMINAL_SPILL_FILE_MAX_BLOCK_SIZE / GUAC_TERMINAL_SPILL_FILE_BLOCK_ALIGNMENT)
+
+/**
+ * A memory-mapped temporary file from which fixed-size blocks may be
+ * allocated and released.
+ */
+typedef struct guac_terminal_spill_file {
+
+    /**
+     * The file descriptor of the temporary file. The file is unlinked as soon
+     * as it is created, and thus disappears once closed.
+     */
+    int fd;
+
+    /**
+     * Array of all mappings of the file, each
+     * GUAC_TERMINAL_SPILL_FILE_SEGMENT_SIZE bytes long.
+     */
+    unsigned char** segments;
+
+    /**
+     * The number of mappings within the segments array.
+     */
+    int segment_count;
+
+    /**
+     * The number of elements allocated for the segments array.
+     */
+    int segments_available;
+
+    /**
+     * The number of bytes of the most recent segment that have been handed
+     * out as blocks. Released blocks are reused through the free lists rather
+     * than by decreasing this value.
+     */
+    size_t segment_used;
+
+    /**
+     * The first released block of each size, or NULL if there are no released
+     * blocks of that size. Each released block contains a pointer to the next
+     * released block of the same size.
+     */
+    void* free_blocks[GUAC_TERMINAL_SPILL_FILE_CLASSES];
+
+    /**
+     * The total number of bytes within blocks that are currently allocated.
+     */
+    size_t allocated;
+
+} guac_terminal_spill_file;
+
+/**
+ * Creates a new, empty spill file within the given directory. The file is
+ * unlinked immediately after creation.
+ *
+ * @param path
+ *     The directory that should contain the spill file.
+ *
+ * @return
+ *     A newly-allocated spill file, or NULL if the file could not be created,
+ *     in which case errno is set appropriately.
+ */
+guac_terminal_spill_file* guac_terminal_spill_file_alloc(const char* path);
+
+/**
+ * Frees the given spill file, unmapping and closing the underlying file.
+ * Pointers to data stored within the spill file are no longer valid after
+ * this function returns.
+ *
+ * @param spill
+ *     The spill file to free.
+ */
+void guac_terminal_spill_file_free(guac_terminal_spill_file* spill);
+
+/**
+ * Copies the given data into a newly-allocated block of the given spill file.
+ *
+ * @param spill
+ *     The spill file that should receive the data.
+ *
+ * @param data
+ *     The data to store.
+ *
+ * @param size
+ *     The number of bytes of data to store. This value may not exceed the
+ *     size of the largest block.
+ *
+ * @return
+ *     A pointer to the stored copy of the data, which remains valid until
+ *     released with guac_terminal_spill_file_release(), or NULL if the spill
+ *     file could not be grown to fit the data.
+ */
+void* guac_terminal_spill_file_store(guac_terminal_spill_file* spill,
+        const void* data, size_t size);
+
+/**
+ * Releases a block previously returned by guac_terminal_spill_file_store(),
+ * allowing its space to be reused.
+ *
+ * @param spill
+ *     The spill file containing the block.
+ *
+ * @param data
+ *     The pointer returned by guac_terminal_spill_file_store().
+ *
+ * @param size
+ *     The number of bytes of data originally given to
+ *     guac_terminal_spill_file_store().
+ */
+void guac_terminal_spill_file_release(guac_terminal_spill_file* spill,
+        void* data, size_t size);
+
+#endif
+
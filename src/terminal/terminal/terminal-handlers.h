@@ -42,6 +42,34 @@
  */
 int guac_terminal_echo(guac_terminal* term, unsigned char c);
 
+/**
+ * Renders the leading run of printable text within the given buffer in bulk,
+ * producing exactly the same result as passing each byte of that run to
+ * guac_terminal_echo(). Only text which guac_terminal_echo() would simply
+ * display is handled: the run ends at the first control character, at the
+ * first byte that is not part of a complete and well-formed UTF-8 sequence,
+ * or immediately if the terminal is not in a state where received text is
+ * displayed verbatim (another character handler is active, a pipe stream is
+ * open, a character set mapping or insert mode is in effect, or a UTF-8
+ * sequence is partially decoded). Any remaining data must be handled by the
+ * terminal's current character handler as usual.
+ *
+ * @param term
+ *     The terminal that received the given data.
+ *
+ * @param buffer
+ *     The data that was received by the given terminal.
+ *
+ * @param length
+ *     The number of bytes within the given buffer.
+ *
+ * @return
+ *     The number of bytes from the start of the given buffer that were
+ *     handled, which may be zero.
+ */
+int guac_terminal_echo_run(guac_terminal* term, const unsigned char* buffer,
+        int length);
+
 /**
  * Handles any characters which follow an ANSI ESC (0x1B) character.
  *
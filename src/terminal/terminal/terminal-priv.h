@@ -87,6 +87,12 @@ struct guac_terminal {
      */
     guac_terminal_file_download_handler* file_download_handler;
 
+    /**
+     * Called whenever the number of rows or columns of the terminal changes
+     * as a result of a resize, or NULL if no such handler has been set.
+     */
+    guac_terminal_resize_handler* resize_handler;
+
     /**
      * Lock which restricts simultaneous access to this terminal via the root
      * guac_terminal_* functions.
@@ -203,6 +209,36 @@ struct guac_terminal {
      */
     int outer_height;
 
+    /**
+     * The width of the space most recently requested via
+     * guac_terminal_resize(), in pixels. Once applied, this will be equal to
+     * outer_width.
+     */
+    int requested_width;
+
+    /**
+     * The height of the space most recently requested via
+     * guac_terminal_resize(), in pixels. Once applied, this will be equal to
+     * outer_height.
+     */
+    int requested_height;
+
+    /**
+     * Whether the requested size has not yet been applied. Resizes are
+     * applied by the render thread prior to flushing each frame, such that a
+     * burst of resize requests (as when the user drags the edge of a browser
+     * window) results in only the final size being applied.
+     */
+    bool resize_pending;
+
+    /**
+     * Whether the entire terminal display must be redrawn once any pending
+     * resize has been applied, as when font metrics have changed. Like
+     * resizes, this redraw is performed by the render thread prior to
+     * flushing the next frame.
+     */
+    bool redraw_pending;
+
     /**
      * The width of the terminal, in pixels.
      */
@@ -294,6 +330,19 @@ struct guac_terminal {
      */
     guac_terminal_char_handler* char_handler;
 
+    /**
+     * The bits of the UTF-8 sequence currently being decoded by
+     * guac_terminal_echo() that have been received thus far.
+     */
+    int utf8_codepoint;
+
+    /**
+     * The number of continuation bytes still required to complete the UTF-8
+     * sequence currently being decoded by guac_terminal_echo(), or zero if no
+     * sequence is in progress.
+     */
+    int utf8_bytes_remaining;
+
     /**
      * The difference between the currently-rendered screen and the current
      * state of the terminal, and the contextual information necessary to
@@ -541,6 +590,31 @@ void guac_terminal_scroll_handler(guac_terminal_scrollbar* scrollbar, int value)
 void guac_terminal_set_columns(guac_terminal* terminal, int row,
         int start_column, int end_column, guac_terminal_char* character);
 
+/**
+ * Sets a contiguous run of columns within the given row to the given
+ * characters, producing the same result as passing each non-continuation
+ * character to guac_terminal_set_columns() in turn. The run must begin with a
+ * non-continuation character, and each multi-column character must be
+ * followed by the corresponding number of GUAC_CHAR_CONTINUATION characters.
+ *
+ * @param terminal
+ *     The terminal to modify.
+ *
+ * @param row
+ *     The row containing the columns to set.
+ *
+ * @param start_column
+ *     The column receiving the first character of the run.
+ *
+ * @param characters
+ *     The characters to store, one per column.
+ *
+ * @param length
+ *     The number of columns within the run.
+ */
+void guac_terminal_set_span(guac_terminal* terminal, int row,
+        int start_column, const guac_terminal_char* characters, int length);
+
 /**
  * Acquires exclusive access to the terminal. Note that enforcing this
  * exclusive access requires that ALL users of the terminal call this
@@ -64,6 +64,12 @@
  */
 #define GUAC_TERMINAL_DEFAULT_DISABLE_COPY false
 
+/**
+ * The default maximum amount of client memory occupied by the glyph atlas of
+ * each terminal, in bytes.
+ */
+#define GUAC_TERMINAL_DEFAULT_GLYPH_ATLAS_SIZE (4 * 1024 * 1024)
+
 /**
  * The absolute maximum number of rows to allow within the display.
  */
@@ -86,6 +92,13 @@
  */
 #define GUAC_TERMINAL_FRAME_TIMEOUT 10
 
+/**
+ * The maximum number of mouse motion events per second to pass to the
+ * terminal. The terminal cannot render the effects of mouse motion (such as
+ * an updated selection) more often than once per frame.
+ */
+#define GUAC_TERMINAL_MAX_MOTION_RATE (1000 / GUAC_TERMINAL_FRAME_DURATION)
+
 /**
  * The maximum number of custom tab stops.
  */
@@ -610,6 +623,24 @@ typedef void guac_terminal_upload_path_handler(guac_client* client, char* path);
  */
 typedef guac_stream* guac_terminal_file_download_handler(guac_client* client, char* filename);
 
+/**
+ * Handler that is invoked whenever the number of rows or columns of the
+ * terminal changes due to a resize. This handler is invoked from the terminal
+ * render thread without the terminal lock held, and is the appropriate place
+ * to inform the remote side of the new terminal size.
+ *
+ * @param client
+ *     The guac_client associated with the resized terminal.
+ *
+ * @param columns
+ *     The new width of the terminal, in characters.
+ *
+ * @param rows
+ *     The new height of the terminal, in characters.
+ */
+typedef void guac_terminal_resize_handler(guac_client* client,
+        int columns, int rows);
+
 /**
  * Configuration options that may be passed when creating a new guac_terminal.
  *
@@ -683,10 +714,26 @@ typedef struct guac_terminal_options {
 
     /**
      * The family of codes (e.g. vt100) which will be used when you push
-     * the function and keypad keys.
+     * the function and keypad keys. If NULL, the default ESC[ codes are used.
      */
     char* func_keys_and_keypad;
 
+    /**
+     * The maximum amount of client memory that may be occupied by the atlas
+     * of glyphs that have already been sent, in bytes. Characters whose
+     * glyphs are within the atlas are drawn by copying from the atlas rather
+     * than by sending new image data. If zero, the atlas is disabled.
+     */
+    int glyph_atlas_size;
+
+    /**
+     * The directory in which a temporary file should be created to hold the
+     * scrollback rows which are not currently displayed, or NULL if those
+     * rows should be held in memory. Scrollback rows are stored in a compact
+     * form in either case.
+     */
+    char* scrollback_spill_path;
+
 } guac_terminal_options;
 
 /**
@@ -776,6 +823,21 @@ void guac_terminal_set_upload_path_handler(guac_terminal* terminal,
 void guac_terminal_set_file_download_handler(guac_terminal* terminal,
         guac_terminal_file_download_handler* file_download_handler);
 
+/**
+ * Sets the resize handler for the given terminal. The resize handler is
+ * invoked whenever a resize changes the number of rows or columns of the
+ * terminal.
+ *
+ * @param terminal
+ *     The terminal to set the resize handler for.
+ *
+ * @param resize_handler
+ *      The handler to be called whenever the number of rows or columns of
+ *      the given terminal changes.
+ */
+void guac_terminal_set_resize_handler(guac_terminal* terminal,
+        guac_terminal_resize_handler* resize_handler);
+
 /**
  * Renders a single frame of terminal data. If data is not yet available,
  * this function will block until data is written.
@@ -1102,7 +1164,26 @@ void guac_terminal_sync_users(
         guac_terminal* term, guac_client* client, guac_socket* socket);
 
 /**
- * Resize the client display and terminal to the given pixel dimensions.
+ * Writes a complete copy of the current terminal display to the given
+ * socket, ending with a "sync" instruction, such that playback of a session
+ * recording may begin at that point. The terminal is locked while the copy
+ * is written, such that the copy always lies between frames.
+ *
+ * @param term
+ *     The terminal whose state should be written.
+ *
+ * @param socket
+ *     The socket of the recording that should receive the terminal state.
+ */
+void guac_terminal_write_keyframe(guac_terminal* term, guac_socket* socket);
+
+/**
+ * Resize the client display and terminal to the given pixel dimensions. The
+ * resize is applied by the terminal render thread prior to the next frame,
+ * and only the most recently requested size is applied if several resizes are
+ * requested within the same frame. If the number of rows or columns changes
+ * as a result, the handler set with guac_terminal_set_resize_handler() is
+ * invoked once the resize has been applied.
  *
  * @param term
  *     The terminal to resize.
@@ -1262,10 +1343,12 @@ void guac_terminal_apply_color_scheme(guac_terminal* terminal,
 const char* guac_terminal_get_color_scheme(guac_terminal* terminal);
 
 /**
- * Alters the font of the terminal. The terminal will automatically be redrawn
- * and resized as necessary. If the terminal size changes, the remote side of
- * the terminal session must be manually informed of that change or graphical
- * artifacts may result.
+ * Alters the font of the terminal. The terminal will automatically be resized
+ * and redrawn as necessary by the terminal render thread prior to the next
+ * frame. If the terminal size changes as a result, the handler set with
+ * guac_terminal_set_resize_handler() is invoked from that thread, and is
+ * responsible for informing the remote side of the terminal session of that
+ * change. If no such handler is set, graphical artifacts may result.
  *
  * @param terminal
  *     The terminal whose font family and/or size are being changed.
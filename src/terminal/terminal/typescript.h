@@ -171,6 +171,23 @@ guac_terminal_typescript* guac_terminal_typescript_alloc(const char* path,
 void guac_terminal_typescript_write(guac_terminal_typescript* typescript,
         char c);
 
+/**
+ * Writes an arbitrary buffer of terminal data to the typescript, flushing and
+ * writing new timestamps if necessary. The typescript produced is identical
+ * to that produced by writing each byte with guac_terminal_typescript_write().
+ *
+ * @param typescript
+ *     The typescript that the given raw terminal data should be written to.
+ *
+ * @param buffer
+ *     The raw terminal data to write to the typescript.
+ *
+ * @param length
+ *     The number of bytes within the given buffer.
+ */
+void guac_terminal_typescript_write_buffer(guac_terminal_typescript* typescript,
+        const char* buffer, int length);
+
 /**
  * Flushes any pending data to the typescript, writing a new timestamp to the
  * timing file if any data was flushed.
@@ -0,0 +1,216 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Microbenchmark for terminal scrollback memory usage. This is not a unit
+ * test and is not run by "make check". It may be built with "make benchmarks"
+ * and run manually to measure the memory occupied by 10k, 100k, and 1M lines
+ * of scrollback, and the time taken to store and later revisit those lines.
+ * If a directory is given as the sole argument, compact rows are stored
+ * within a spill file in that directory rather than within the heap.
+ */
+
+#include "terminal/buffer.h"
+#include "terminal/types.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * The height of the simulated terminal display, in rows.
+ */
+#define BENCH_ROWS 50
+
+/**
+ * The width of the simulated terminal display, in columns.
+ */
+#define BENCH_COLUMNS 160
+
+/**
+ * The minimum number of columns allocated for each row by the original,
+ * uncompacted row storage.
+ */
+#define BENCH_UNCOMPACTED_ROW_SIZE 256
+
+/**
+ * Returns the current value of a monotonic clock, in seconds.
+ *
+ * @return
+ *     The current value of a monotonic clock, in seconds.
+ */
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+/**
+ * Fills the given array with a line of text resembling a typical log file,
+ * with an occasionally colored severity level.
+ *
+ * @param line
+ *     The array to fill, having space for at least BENCH_COLUMNS characters.
+ *
+ * @param index
+ *     The index of the line.
+ *
+ * @param plain
+ *     The default character, providing the attributes of uncolored text.
+ *
+ * @return
+ *     The number of characters within the line.
+ */
+static int bench_generate_line(guac_terminal_char* line, int index,
+        const guac_terminal_char* plain) {
+
+    static const char* messages[] = {
+        "Connection established with 192.168.1.42:4822",
+        "Received 1048576 bytes of data in 12 blocks",
+        "User \"guacadmin\" joined the connection",
+        "Session recording written to /var/lib/guacamole/recordings",
+        "Unable to resolve hostname: temporary failure in name resolution"
+    };
+
+    char text[BENCH_COLUMNS + 1];
+    int length = snprintf(text, sizeof(text),
+            "2024-01-01 12:%02i:%02i.%03i [thread-%02i] %s %s (%i)",
+            (index / 60000) % 60, (index / 1000) % 60, index % 1000, index % 16,
+            index % 7 == 0 ? "ERROR" : "INFO ", messages[index % 5], index);
+
+    if (length > BENCH_COLUMNS)
+        length = BENCH_COLUMNS;
+
+    for (int i = 0; i < length; i++) {
+        line[i] = *plain;
+        line[i].value = text[i];
+    }
+
+    /* Color the severity level of errors bold red */
+    if (index % 7 == 0) {
+        for (int i = 35; i < 40; i++) {
+            line[i].attributes.bold = true;
+            line[i].attributes.foreground.palette_index = 9;
+            line[i].attributes.foreground.red = 0xFF;
+            line[i].attributes.foreground.green = 0x55;
+            line[i].attributes.foreground.blue = 0x55;
+        }
+    }
+
+    return length;
+
+}
+
+/**
+ * Writes the given number of lines to a new buffer as a terminal would,
+ * compacting the buffer after each screenful as if rendering a frame, and
+ * then reads back every line of scrollback, printing the memory used and
+ * time taken.
+ *
+ * @param lines
+ *     The number of lines of scrollback to write.
+ *
+ * @param spill_path
+ *     The directory in which to create a spill file, or NULL to store compact
+ *     rows within the heap.
+ */
+static void bench_scrollback(int lines, const char* spill_path) {
+
+    guac_terminal_char plain = {
+        .value = 0,
+        .attributes = {
+            .foreground = { .palette_index = 7, .red = 0x99, .green = 0x99, .blue = 0x99 },
+            .background = { .palette_index = 0 }
+        },
+        .width = 1
+    };
+
+    guac_terminal_char line[BENCH_COLUMNS];
+    guac_terminal_buffer* buffer = guac_terminal_buffer_alloc(lines + BENCH_ROWS, &plain);
+
+    if (spill_path != NULL && guac_terminal_buffer_enable_spill(buffer, spill_path)) {
+        perror("Unable to create spill file");
+        guac_terminal_buffer_free(buffer);
+        return;
+    }
+
+    double start = bench_now();
+
+    /* Write each line to the bottom row, scrolling up after each line */
+    for (int i = 0; i < lines; i++) {
+
+        int length = bench_generate_line(line, i, &plain);
+        guac_terminal_buffer_set_span(buffer, BENCH_ROWS - 1, 0, line, length);
+        guac_terminal_buffer_scroll_up(buffer, 1, true);
+
+        if (i % BENCH_ROWS == 0)
+            guac_terminal_buffer_compact(buffer, 0, BENCH_ROWS - 1);
+
+    }
+
+    guac_terminal_buffer_compact(buffer, 0, BENCH_ROWS - 1);
+    double write_elapsed = bench_now() - start;
+
+    guac_terminal_buffer_usage usage;
+    guac_terminal_buffer_get_usage(buffer, &usage);
+
+    /* Revisit all scrollback, a screenful at a time, as if scrolling back
+     * through the entire history */
+    start = bench_now();
+    for (int row = -lines; row < 0; row += BENCH_ROWS) {
+
+        for (int i = row; i < row + BENCH_ROWS && i < 0; i++) {
+            guac_terminal_char* characters;
+            guac_terminal_buffer_get_columns(buffer, &characters, NULL, i);
+        }
+
+        guac_terminal_buffer_compact(buffer, row, row + BENCH_ROWS - 1);
+
+    }
+    double read_elapsed = bench_now() - start;
+
+    size_t total = usage.rows + usage.decoded + usage.encoded + usage.spilled;
+    size_t uncompacted = (size_t) (lines + BENCH_ROWS)
+            * BENCH_UNCOMPACTED_ROW_SIZE * sizeof(guac_terminal_char);
+
+    printf("%8i lines: %10.1f MiB (rows %.1f, decoded %.1f, heap %.1f, "
+            "spilled %.1f), %6.1f bytes/line, uncompacted %10.1f MiB, "
+            "write %.3f s, scrollback %.3f s\n",
+            lines, total / 1048576.0, usage.rows / 1048576.0,
+            usage.decoded / 1048576.0, usage.encoded / 1048576.0,
+            usage.spilled / 1048576.0, (double) total / lines,
+            uncompacted / 1048576.0, write_elapsed, read_elapsed);
+
+    guac_terminal_buffer_free(buffer);
+
+}
+
+int main(int argc, char* argv[]) {
+
+    const char* spill_path = (argc > 1) ? argv[1] : NULL;
+
+    bench_scrollback(10000, spill_path);
+    bench_scrollback(100000, spill_path);
+    bench_scrollback(1000000, spill_path);
+
+    return 0;
+
+}
+
@@ -0,0 +1,302 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "terminal/buffer.h"
+#include "terminal/types.h"
+
+#include <CUnit/CUnit.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The number of rows within each buffer tested.
+ */
+#define TEST_BUFFER_ROWS 64
+
+/**
+ * The number of rows written by fill_buffer().
+ */
+#define TEST_BUFFER_FILLED_ROWS 16
+
+/**
+ * The character filling all newly-allocated cells of each buffer tested.
+ */
+static const guac_terminal_char default_char = {
+    .value = 0,
+    .attributes = {
+        .foreground = { .palette_index = 7, .red = 0xC0, .green = 0xC0, .blue = 0xC0 },
+        .background = { .palette_index = 0 }
+    },
+    .width = 1
+};
+
+/**
+ * Returns whether the given characters are identical, ignoring the width of
+ * GUAC_CHAR_CONTINUATION characters (which is not applicable).
+ *
+ * @param a
+ *     The first character to compare.
+ *
+ * @param b
+ *     The second character to compare.
+ *
+ * @return
+ *     true if the given characters are identical, false otherwise.
+ */
+static bool same_char(const guac_terminal_char* a, const guac_terminal_char* b) {
+
+    const guac_terminal_attributes* x = &a->attributes;
+    const guac_terminal_attributes* y = &b->attributes;
+
+    return a->value == b->value
+        && (a->value == GUAC_CHAR_CONTINUATION || a->width == b->width)
+        && x->bold == y->bold
+        && x->half_bright == y->half_bright
+        && x->cursor == y->cursor
+        && x->reverse == y->reverse
+        && x->underscore == y->underscore
+        && x->foreground.palette_index == y->foreground.palette_index
+        && x->foreground.red == y->foreground.red
+        && x->foreground.green == y->foreground.green
+        && x->foreground.blue == y->foreground.blue
+        && x->background.palette_index == y->background.palette_index
+        && x->background.red == y->background.red
+        && x->background.green == y->background.green
+        && x->background.blue == y->background.blue;
+
+}
+
+/**
+ * Writes rows of varied content to the first TEST_BUFFER_FILLED_ROWS rows of
+ * the given buffer, including characters requiring each possible codepoint
+ * width, multi-column characters, and frequently-changing attributes.
+ *
+ * @param buffer
+ *     The buffer to write to.
+ */
+static void fill_buffer(guac_terminal_buffer* buffer) {
+
+    for (int row = 0; row < TEST_BUFFER_FILLED_ROWS; row++) {
+
+        guac_terminal_char c = default_char;
+
+        for (int col = 0; col < 80 + row; col++) {
+
+            /* Vary codepoints across rows: ASCII, 2-byte, and 4-byte */
+            c.value = 'A' + (col % 26);
+            if (row % 4 == 1)
+                c.value = 0x3000 + col;
+            else if (row % 4 == 2 && col % 7 == 0)
+                c.value = 0x1F600 + col;
+
+            /* Change attributes every few columns on odd rows */
+            if (row % 2 == 1) {
+                c.attributes.bold = (col / 3) % 2;
+                c.attributes.underscore = (col / 5) % 2;
+                c.attributes.foreground.palette_index = (col / 4) % 16;
+                c.attributes.foreground.red = col;
+            }
+
+            guac_terminal_buffer_set_columns(buffer, row, col, col, &c);
+
+        }
+
+        /* Add a multi-column character */
+        c.value = 0x4E00;
+        c.width = 2;
+        guac_terminal_buffer_set_columns(buffer, row, 10, 11, &c);
+
+        guac_terminal_buffer_set_wrapped(buffer, row, row % 3 == 0);
+
+    }
+
+}
+
+/**
+ * Copies the current contents of each row written by fill_buffer().
+ *
+ * @param buffer
+ *     The buffer to copy from.
+ *
+ * @param lengths
+ *     Array receiving the length of each row.
+ *
+ * @param wrapped
+ *     Array receiving whether each row is wrapped.
+ *
+ * @return
+ *     An array of the characters of each row, which must be freed with
+ *     free().
+ */
+static guac_terminal_char** copy_rows(guac_terminal_buffer* buffer,
+        int* lengths, bool* wrapped) {
+
+    guac_terminal_char** rows = calloc(TEST_BUFFER_FILLED_ROWS, sizeof(guac_terminal_char*));
+
+    for (int row = 0; row < TEST_BUFFER_FILLED_ROWS; row++) {
+        guac_terminal_char* characters;
+        lengths[row] = guac_terminal_buffer_get_columns(buffer, &characters, &wrapped[row], row);
+        rows[row] = malloc(sizeof(guac_terminal_char) * lengths[row]);
+        memcpy(rows[row], characters, sizeof(guac_terminal_char) * lengths[row]);
+    }
+
+    return rows;
+
+}
+
+/**
+ * Verifies that each row written by fill_buffer() still has the contents
+ * previously copied with copy_rows(), freeing those copies.
+ *
+ * @param buffer
+ *     The buffer to verify.
+ *
+ * @param rows
+ *     The array returned by copy_rows().
+ *
+ * @param lengths
+ *     The lengths of each row, as provided by copy_rows().
+ *
+ * @param wrapped
+ *     Whether each row is wrapped, as provided by copy_rows().
+ */
+static void verify_rows(guac_terminal_buffer* buffer, guac_terminal_char** rows,
+        int* lengths, bool* wrapped) {
+
+    for (int row = 0; row < TEST_BUFFER_FILLED_ROWS; row++) {
+
+        guac_terminal_char* characters;
+        bool is_wrapped;
+        int length = guac_terminal_buffer_get_columns(buffer, &characters, &is_wrapped, row);
+
+        CU_ASSERT_EQUAL(length, lengths[row]);
+        CU_ASSERT_EQUAL(is_wrapped, wrapped[row]);
+
+        for (int col = 0; col < length && col < lengths[row]; col++) {
+            if (!same_char(&characters[col], &rows[row][col])) {
+                CU_FAIL("Character differs after compaction");
+                break;
+            }
+        }
+
+        free(rows[row]);
+
+    }
+
+    free(rows);
+
+}
+
+/**
+ * Verifies that rows outside the range given to guac_terminal_buffer_compact()
+ * are stored in compact form, and are restored exactly when next accessed.
+ */
+void test_buffer__compact_roundtrip(void) {
+
+    int lengths[TEST_BUFFER_FILLED_ROWS];
+    bool wrapped[TEST_BUFFER_FILLED_ROWS];
+    guac_terminal_buffer_usage before, after;
+
+    guac_terminal_buffer* buffer = guac_terminal_buffer_alloc(TEST_BUFFER_ROWS, &default_char);
+    fill_buffer(buffer);
+
+    guac_terminal_char** rows = copy_rows(buffer, lengths, wrapped);
+    guac_terminal_buffer_get_usage(buffer, &before);
+
+    /* Compact everything except the final few rows */
+    guac_terminal_buffer_compact(buffer, TEST_BUFFER_FILLED_ROWS - 4,
+            TEST_BUFFER_FILLED_ROWS - 1);
+    guac_terminal_buffer_get_usage(buffer, &after);
+
+    CU_ASSERT(after.decoded < before.decoded);
+    CU_ASSERT(after.encoded > 0);
+    CU_ASSERT(after.decoded + after.encoded < before.decoded);
+    CU_ASSERT_EQUAL(after.spilled, 0);
+
+    verify_rows(buffer, rows, lengths, wrapped);
+    guac_terminal_buffer_free(buffer);
+
+}
+
+/**
+ * Verifies that rows within the range given to guac_terminal_buffer_compact()
+ * remain decoded, such that pointers to their characters remain valid.
+ */
+void test_buffer__compact_range(void) {
+
+    guac_terminal_buffer* buffer = guac_terminal_buffer_alloc(TEST_BUFFER_ROWS, &default_char);
+    fill_buffer(buffer);
+
+    /* Scroll such that the first rows are within the scrollback buffer */
+    guac_terminal_buffer_scroll_up(buffer, 4, true);
+
+    guac_terminal_char* before;
+    guac_terminal_buffer_get_columns(buffer, &before, NULL, -2);
+
+    /* Keep the two most recent scrollback rows and the first screen row */
+    guac_terminal_buffer_compact(buffer, -2, 0);
+
+    guac_terminal_char* after;
+    guac_terminal_buffer_get_columns(buffer, &after, NULL, -2);
+    CU_ASSERT_PTR_EQUAL(before, after);
+
+    guac_terminal_buffer_usage usage;
+    guac_terminal_buffer_get_usage(buffer, &usage);
+    CU_ASSERT(usage.encoded > 0);
+
+    guac_terminal_buffer_free(buffer);
+
+}
+
+/**
+ * Verifies that compact rows may be stored within a spill file, and are
+ * restored exactly when next accessed.
+ */
+void test_buffer__compact_spill(void) {
+
+    int lengths[TEST_BUFFER_FILLED_ROWS];
+    bool wrapped[TEST_BUFFER_FILLED_ROWS];
+    guac_terminal_buffer_usage usage;
+
+    guac_terminal_buffer* buffer = guac_terminal_buffer_alloc(TEST_BUFFER_ROWS, &default_char);
+    CU_ASSERT_EQUAL_FATAL(guac_terminal_buffer_enable_spill(buffer, "/tmp"), 0);
+
+    fill_buffer(buffer);
+    guac_terminal_char** rows = copy_rows(buffer, lengths, wrapped);
+
+    /* Compact everything (the only row kept decoded was never written) */
+    guac_terminal_buffer_compact(buffer, TEST_BUFFER_FILLED_ROWS,
+            TEST_BUFFER_FILLED_ROWS);
+    guac_terminal_buffer_get_usage(buffer, &usage);
+
+    CU_ASSERT(usage.spilled > 0);
+    CU_ASSERT_EQUAL(usage.encoded, 0);
+    CU_ASSERT_EQUAL(usage.decoded, 0);
+
+    verify_rows(buffer, rows, lengths, wrapped);
+
+    /* All rows are decoded once read, releasing their space */
+    guac_terminal_buffer_get_usage(buffer, &usage);
+    CU_ASSERT_EQUAL(usage.spilled, 0);
+
+    guac_terminal_buffer_free(buffer);
+
+}
+
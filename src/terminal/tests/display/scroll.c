@@ -0,0 +1,255 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "terminal/display.h"
+#include "terminal/terminal.h"
+#include "terminal/terminal-priv.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+
+/**
+ * The width of each terminal tested, in pixels.
+ */
+#define TEST_SCROLL_WIDTH 400
+
+/**
+ * The height of each terminal tested, in pixels.
+ */
+#define TEST_SCROLL_HEIGHT 200
+
+/**
+ * Allocates a new terminal, along with a new guac_client for that terminal,
+ * flushing all operations initially pending for its display. The terminal
+ * is not started, and thus never renders frames.
+ *
+ * @return
+ *     A newly-allocated terminal, which must be freed with test_scroll_free().
+ */
+static guac_terminal* test_scroll_alloc(void) {
+
+    guac_client* client = guac_client_alloc();
+
+    guac_terminal_options* options = guac_terminal_options_create(
+            TEST_SCROLL_WIDTH, TEST_SCROLL_HEIGHT, 96);
+
+    guac_terminal* term = guac_terminal_create(client, options);
+    guac_mem_free(options);
+
+    guac_terminal_lock(term);
+    guac_terminal_display_flush_operations(term->display);
+    guac_terminal_unlock(term);
+
+    return term;
+
+}
+
+/**
+ * Frees the given terminal and its guac_client, stopping that client such
+ * that the render thread of the terminal exits.
+ *
+ * @param term
+ *     The terminal to free.
+ */
+static void test_scroll_free(guac_terminal* term) {
+
+    guac_client* client = term->client;
+
+    guac_client_stop(client);
+    guac_terminal_free(term);
+    guac_client_free(client);
+
+}
+
+/**
+ * Sets every column of the given row of both displays to the same character,
+ * and then sets a few columns of that row to a character that varies with the
+ * given value, as would be done when clearing a newly-scrolled row and
+ * writing text within that row.
+ *
+ * @param a
+ *     The first display to write to.
+ *
+ * @param b
+ *     The second display to write to.
+ *
+ * @param row
+ *     The row to write.
+ *
+ * @param value
+ *     An arbitrary value determining the text written.
+ */
+static void write_row(guac_terminal_display* a, guac_terminal_display* b,
+        int row, int value) {
+
+    guac_terminal_char blank = { .value = ' ', .width = 1 };
+    guac_terminal_char text = { .value = 'A' + value % 26, .width = 1 };
+    int length = 1 + value % (a->width - 1);
+
+    guac_terminal_display_set_columns(a, row, 0, a->width - 1, &blank);
+    guac_terminal_display_set_columns(b, row, 0, b->width - 1, &blank);
+    guac_terminal_display_set_columns(a, row, 0, length - 1, &text);
+    guac_terminal_display_set_columns(b, row, 0, length - 1, &text);
+
+}
+
+/**
+ * Scrolls the first display using guac_terminal_display_scroll_up() and the
+ * second by copying rows with guac_terminal_display_copy_rows().
+ *
+ * @param a
+ *     The display to scroll with guac_terminal_display_scroll_up().
+ *
+ * @param b
+ *     The display to scroll with guac_terminal_display_copy_rows().
+ *
+ * @param amount
+ *     The number of rows to scroll up by.
+ */
+static void scroll(guac_terminal_display* a, guac_terminal_display* b,
+        int amount) {
+    guac_terminal_display_scroll_up(a, amount);
+    guac_terminal_display_copy_rows(b, amount, b->height - 1, -amount);
+}
+
+/**
+ * Verifies that the operations pending for the given displays are identical.
+ * Deferred scrolls are first applied by copying the top-left corner of both
+ * displays onto itself, which (unlike writing a character over a pending
+ * copy) does not flush the pending operations being compared.
+ *
+ * @param a
+ *     The first display to compare.
+ *
+ * @param b
+ *     The second display to compare.
+ */
+static void verify_same(guac_terminal_display* a, guac_terminal_display* b) {
+
+    guac_terminal_display_copy_columns(a, 0, 0, 0, 0);
+    guac_terminal_display_copy_columns(b, 0, 0, 0, 0);
+
+    CU_ASSERT_EQUAL_FATAL(a->width, b->width);
+    CU_ASSERT_EQUAL_FATAL(a->height, b->height);
+    CU_ASSERT_EQUAL(a->pending_scroll, 0);
+
+    int count = a->width * a->height;
+    for (int i = 0; i < count; i++) {
+
+        guac_terminal_operation* x = &a->operations[i];
+        guac_terminal_operation* y = &b->operations[i];
+
+        CU_ASSERT_EQUAL(x->type, y->type);
+
+        if (x->type == GUAC_CHAR_SET) {
+            CU_ASSERT_EQUAL(x->character.value, y->character.value);
+        }
+
+        else if (x->type == GUAC_CHAR_COPY) {
+            CU_ASSERT_EQUAL(x->row, y->row);
+            CU_ASSERT_EQUAL(x->column, y->column);
+        }
+
+    }
+
+}
+
+/**
+ * Verifies that scrolling with guac_terminal_display_scroll_up() results in
+ * exactly the same pending operations as copying rows, both while scrolls are
+ * deferred (including beyond the height of the display) and where the rows at
+ * the bottom of the display prevent the scroll from being deferred.
+ */
+void test_display__scroll_up(void) {
+
+    guac_terminal* term_a = test_scroll_alloc();
+    guac_terminal* term_b = test_scroll_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(term_a);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(term_b);
+
+    guac_terminal_lock(term_a);
+    guac_terminal_lock(term_b);
+
+    guac_terminal_display* a = term_a->display;
+    guac_terminal_display* b = term_b->display;
+    int height = a->height;
+
+    /* Text within an otherwise unchanged final row cannot be deferred */
+    guac_terminal_char text = { .value = 'x', .width = 1 };
+    guac_terminal_display_set_columns(a, height - 1, 2, 5, &text);
+    guac_terminal_display_set_columns(b, height - 1, 2, 5, &text);
+    scroll(a, b, 1);
+    CU_ASSERT_EQUAL(a->pending_scroll, 0);
+
+    /* Once the final row is entirely redrawn, scrolls can be deferred, with
+     * the unchanged characters above becoming copies once applied */
+    guac_terminal_display_flush_operations(a);
+    guac_terminal_display_flush_operations(b);
+    for (int i = 1; i <= 3; i++) {
+        write_row(a, b, height - 1, i);
+        scroll(a, b, 1);
+        CU_ASSERT_EQUAL(a->pending_scroll, i);
+    }
+
+    verify_same(a, b);
+
+    /* Rows which are entirely redrawn can be deferred, for several times the
+     * height of the display and by varying amounts */
+    for (int i = 0; i < height * 3; i++) {
+
+        int amount = 1 + i % 3;
+        for (int row = height - amount; row < height; row++)
+            write_row(a, b, row, i + row);
+
+        scroll(a, b, amount);
+        CU_ASSERT_NOT_EQUAL(a->pending_scroll, 0);
+
+    }
+
+    verify_same(a, b);
+
+    /* Writing above the rows scrolled into view applies deferred scrolls */
+    write_row(a, b, height - 1, 1);
+    scroll(a, b, 1);
+    write_row(a, b, height - 1, 2);
+    scroll(a, b, 1);
+    CU_ASSERT_EQUAL(a->pending_scroll, 2);
+
+    write_row(a, b, height / 2, 3);
+    CU_ASSERT_EQUAL(a->pending_scroll, 0);
+
+    /* Copies of unchanged characters within the final row cannot be
+     * deferred */
+    guac_terminal_display_flush_operations(a);
+    guac_terminal_display_flush_operations(b);
+    guac_terminal_display_copy_columns(a, height - 1, 0, 3, 4);
+    guac_terminal_display_copy_columns(b, height - 1, 0, 3, 4);
+    scroll(a, b, 1);
+    CU_ASSERT_EQUAL(a->pending_scroll, 0);
+
+    verify_same(a, b);
+
+    guac_terminal_unlock(term_b);
+    guac_terminal_unlock(term_a);
+
+    test_scroll_free(term_a);
+    test_scroll_free(term_b);
+
+}
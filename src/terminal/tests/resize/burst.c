@@ -0,0 +1,355 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "terminal/terminal.h"
+#include "terminal/terminal-priv.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+#include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+/**
+ * The initial width of each terminal tested, in pixels.
+ */
+#define TEST_RESIZE_WIDTH 640
+
+/**
+ * The initial height of each terminal tested, in pixels.
+ */
+#define TEST_RESIZE_HEIGHT 480
+
+/**
+ * The number of resizes requested within each burst of resizes.
+ */
+#define TEST_RESIZE_BURST 64
+
+/**
+ * The maximum number of invocations of the resize handler recorded.
+ */
+#define TEST_RESIZE_MAX_CALLS 256
+
+/**
+ * The opcode and opening delimiter of each "sync" instruction, marking the
+ * end of each frame.
+ */
+#define TEST_RESIZE_SYNC "4.sync,"
+
+/**
+ * An invocation of the resize handler.
+ */
+typedef struct test_resize_call {
+
+    /**
+     * The number of frames that had been completely sent when the handler
+     * was invoked.
+     */
+    int frame;
+
+    /**
+     * Whether the handler was invoked from the terminal render thread.
+     */
+    bool render_thread;
+
+    /**
+     * The number of columns passed to the handler.
+     */
+    int columns;
+
+    /**
+     * The number of rows passed to the handler.
+     */
+    int rows;
+
+} test_resize_call;
+
+/**
+ * Lock which must be held while accessing the state below.
+ */
+static pthread_mutex_t state_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * The number of "sync" instructions written to the client socket.
+ */
+static int frames;
+
+/**
+ * The number of characters of TEST_RESIZE_SYNC matched by the most recent
+ * data written to the client socket.
+ */
+static int sync_matched;
+
+/**
+ * Every recorded invocation of the resize handler.
+ */
+static test_resize_call calls[TEST_RESIZE_MAX_CALLS];
+
+/**
+ * The number of entries within calls.
+ */
+static int call_count;
+
+/**
+ * The terminal being tested.
+ */
+static guac_terminal* terminal;
+
+/**
+ * Write handler which counts the "sync" instructions written to the socket,
+ * discarding all other data.
+ */
+static ssize_t test_resize_write(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    const char* data = (const char*) buf;
+    const int length = strlen(TEST_RESIZE_SYNC);
+
+    pthread_mutex_lock(&state_lock);
+
+    for (size_t i = 0; i < count; i++) {
+
+        /* No proper prefix of the opcode is also a suffix, so any mismatch
+         * can only be the start of a new match */
+        if (data[i] == TEST_RESIZE_SYNC[sync_matched])
+            sync_matched++;
+        else
+            sync_matched = (data[i] == TEST_RESIZE_SYNC[0]);
+
+        if (sync_matched == length) {
+            frames++;
+            sync_matched = 0;
+        }
+
+    }
+
+    pthread_mutex_unlock(&state_lock);
+
+    return count;
+
+}
+
+/**
+ * Resize handler which records each invocation.
+ */
+static void test_resize_handler(guac_client* client, int columns, int rows) {
+
+    pthread_mutex_lock(&state_lock);
+
+    if (call_count < TEST_RESIZE_MAX_CALLS) {
+        test_resize_call* call = &calls[call_count++];
+        call->frame = frames;
+        call->render_thread = pthread_equal(pthread_self(), terminal->thread);
+        call->columns = columns;
+        call->rows = rows;
+    }
+
+    pthread_mutex_unlock(&state_lock);
+
+}
+
+/**
+ * Returns the number of frames that have been sent thus far.
+ *
+ * @return
+ *     The number of frames that have been sent thus far.
+ */
+static int get_frames(void) {
+    pthread_mutex_lock(&state_lock);
+    int value = frames;
+    pthread_mutex_unlock(&state_lock);
+    return value;
+}
+
+/**
+ * Returns the number of times the resize handler has been invoked thus far.
+ *
+ * @return
+ *     The number of times the resize handler has been invoked thus far.
+ */
+static int get_call_count(void) {
+    pthread_mutex_lock(&state_lock);
+    int value = call_count;
+    pthread_mutex_unlock(&state_lock);
+    return value;
+}
+
+/**
+ * Waits until at least the given number of frames have been sent.
+ *
+ * @param count
+ *     The number of frames to wait for.
+ */
+static void wait_for_frames(int count) {
+    while (get_frames() < count)
+        guac_timestamp_msleep(1);
+}
+
+/**
+ * Allocates a guac_client whose socket counts frames, and a terminal for that
+ * client whose resizes are recorded. The terminal is not started.
+ *
+ * @return
+ *     A newly-allocated guac_client, which must be freed with
+ *     test_resize_free().
+ */
+static guac_client* test_resize_alloc(void) {
+
+    frames = 0;
+    sync_matched = 0;
+    call_count = 0;
+
+    guac_client* client = guac_client_alloc();
+
+    guac_socket* socket = guac_socket_alloc();
+    socket->write_handler = test_resize_write;
+    guac_socket_free(client->socket);
+    client->socket = socket;
+
+    guac_terminal_options* options = guac_terminal_options_create(
+            TEST_RESIZE_WIDTH, TEST_RESIZE_HEIGHT, 96);
+
+    terminal = guac_terminal_create(client, options);
+    guac_mem_free(options);
+
+    guac_terminal_set_resize_handler(terminal, test_resize_handler);
+    return client;
+
+}
+
+/**
+ * Stops and frees the given client and its terminal.
+ *
+ * @param client
+ *     The client to free.
+ */
+static void test_resize_free(guac_client* client) {
+    guac_client_stop(client);
+    guac_terminal_free(terminal);
+    guac_client_free(client);
+}
+
+/**
+ * Verifies that the resize handler has been invoked from the terminal render
+ * thread at most once per frame, and that the most recent invocation reflects
+ * the current size of the terminal.
+ */
+static void verify_calls(void) {
+
+    pthread_mutex_lock(&state_lock);
+
+    for (int i = 0; i < call_count; i++) {
+        CU_ASSERT_TRUE(calls[i].render_thread);
+        if (i > 0)
+            CU_ASSERT_TRUE(calls[i].frame > calls[i - 1].frame);
+    }
+
+    if (call_count > 0) {
+        CU_ASSERT_EQUAL(calls[call_count - 1].columns,
+                guac_terminal_get_columns(terminal));
+        CU_ASSERT_EQUAL(calls[call_count - 1].rows,
+                guac_terminal_get_rows(terminal));
+    }
+
+    pthread_mutex_unlock(&state_lock);
+
+}
+
+/**
+ * Verifies that a burst of resizes requested within the same frame results
+ * in exactly one resize, that the resize applied is the most recently
+ * requested, and that the resize handler is invoked from the render thread.
+ */
+void test_resize__burst(void) {
+
+    guac_client* client = test_resize_alloc();
+
+    /* Frames are not rendered until the terminal is started, so the entire
+     * burst is guaranteed to fall within the first frame */
+    for (int i = 1; i <= TEST_RESIZE_BURST; i++)
+        guac_terminal_resize(terminal, TEST_RESIZE_WIDTH + i * 64,
+                TEST_RESIZE_HEIGHT + i * 64);
+
+    guac_terminal_start(terminal);
+    wait_for_frames(2);
+
+    CU_ASSERT_EQUAL(get_call_count(), 1);
+    verify_calls();
+
+    guac_terminal_lock(terminal);
+    CU_ASSERT_EQUAL(terminal->outer_width,
+            TEST_RESIZE_WIDTH + TEST_RESIZE_BURST * 64);
+    CU_ASSERT_EQUAL(terminal->outer_height,
+            TEST_RESIZE_HEIGHT + TEST_RESIZE_BURST * 64);
+    guac_terminal_unlock(terminal);
+
+    /* Bursts spanning several frames result in at most one resize per frame,
+     * ending with the most recently requested size */
+    for (int i = TEST_RESIZE_BURST; i > 0; i--) {
+        guac_terminal_resize(terminal, TEST_RESIZE_WIDTH + i * 8,
+                TEST_RESIZE_HEIGHT + i * 8);
+        guac_timestamp_msleep(1);
+    }
+
+    wait_for_frames(get_frames() + 2);
+
+    CU_ASSERT_TRUE(get_call_count() > 1);
+    verify_calls();
+
+    guac_terminal_lock(terminal);
+    CU_ASSERT_EQUAL(terminal->outer_width, TEST_RESIZE_WIDTH + 8);
+    CU_ASSERT_EQUAL(terminal->outer_height, TEST_RESIZE_HEIGHT + 8);
+    guac_terminal_unlock(terminal);
+
+    test_resize_free(client);
+
+}
+
+/**
+ * Verifies that changing the font of the terminal does not itself resize the
+ * terminal, leaving the resize to the render thread such that the resize
+ * handler is never invoked from the thread changing the font.
+ */
+void test_resize__font(void) {
+
+    guac_client* client = test_resize_alloc();
+    guac_terminal_start(terminal);
+    wait_for_frames(1);
+
+    guac_terminal_apply_font(terminal, NULL, 48, 96);
+    wait_for_frames(get_frames() + 2);
+
+    /* The resize and redraw have been applied by the render thread */
+    guac_terminal_lock(terminal);
+    CU_ASSERT_FALSE(terminal->resize_pending);
+    CU_ASSERT_FALSE(terminal->redraw_pending);
+    CU_ASSERT_EQUAL(terminal->font_size, 48);
+    guac_terminal_unlock(terminal);
+
+    /* The larger font results in exactly one resize */
+    CU_ASSERT_EQUAL(get_call_count(), 1);
+    verify_calls();
+
+    test_resize_free(client);
+
+}
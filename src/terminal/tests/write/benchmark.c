@@ -0,0 +1,184 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+/*
+ * Microbenchmark for terminal output. This is not a unit test and is not run
+ * by "make check". It may be built with "make benchmarks" and run manually to
+ * measure the throughput of guac_terminal_write() when displaying a large dump
+ * of text, including the rendering of each frame, as when running "cat" on a
+ * large log file.
+ */
+
+#include "terminal/display.h"
+#include "terminal/glyph-atlas.h"
+#include "terminal/glyph-cache.h"
+#include "terminal/terminal.h"
+#include "terminal/terminal-priv.h"
+
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * The total number of bytes of text written to the terminal.
+ */
+#define BENCH_TOTAL_LENGTH (64 * 1024 * 1024)
+
+/**
+ * The number of bytes of text written to the terminal between each rendered
+ * frame.
+ */
+#define BENCH_FRAME_LENGTH 65536
+
+/**
+ * The width of the simulated terminal display, in pixels.
+ */
+#define BENCH_WIDTH 1920
+
+/**
+ * The height of the simulated terminal display, in pixels.
+ */
+#define BENCH_HEIGHT 1080
+
+/**
+ * Returns the current value of a monotonic clock, in seconds.
+ *
+ * @return
+ *     The current value of a monotonic clock, in seconds.
+ */
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+/**
+ * Fills the given buffer with lines of text resembling a typical log file,
+ * with an occasional colored severity level.
+ *
+ * @param buffer
+ *     The buffer to fill.
+ *
+ * @param size
+ *     The size of the buffer, in bytes.
+ *
+ * @return
+ *     The number of bytes of the buffer occupied by complete lines.
+ */
+static size_t bench_generate_log(char* buffer, size_t size) {
+
+    static const char* levels[] = {
+        "INFO ",
+        "DEBUG",
+        "\x1B[33mWARN \x1B[0m",
+        "\x1B[1;31mERROR\x1B[0m"
+    };
+
+    static const char* messages[] = {
+        "Connection established with 192.168.1.42:4822",
+        "Received 1048576 bytes of data in 12 blocks",
+        "User \"guacadmin\" joined the connection",
+        "Session recording written to /var/lib/guacamole/recordings",
+        "Unable to resolve hostname: temporary failure in name resolution"
+    };
+
+    size_t length = 0;
+    for (int i = 0; ; i++) {
+
+        char line[256];
+        int line_length = snprintf(line, sizeof(line),
+                "2024-01-01 12:%02i:%02i.%03i [thread-%02i] %s %s (%i)\r\n",
+                (i / 60000) % 60, (i / 1000) % 60, i % 1000, i % 16,
+                levels[i % 7 == 0 ? 3 : (i % 5 == 0 ? 2 : i % 2)],
+                messages[i % 5], i);
+
+        if (length + line_length > size)
+            return length;
+
+        memcpy(buffer + length, line, line_length);
+        length += line_length;
+
+    }
+
+}
+
+int main(void) {
+
+    guac_client* client = guac_client_alloc();
+
+    guac_terminal_options* options = guac_terminal_options_create(
+            BENCH_WIDTH, BENCH_HEIGHT, 96);
+
+    /* The terminal is never started, such that frames are rendered only
+     * where explicitly requested below */
+    guac_terminal* term = guac_terminal_create(client, options);
+    guac_mem_free(options);
+
+    if (term == NULL) {
+        fprintf(stderr, "Unable to create terminal.\n");
+        guac_client_free(client);
+        return 1;
+    }
+
+    char* log = guac_mem_alloc(BENCH_FRAME_LENGTH);
+    size_t log_length = bench_generate_log(log, BENCH_FRAME_LENGTH);
+
+    double start = bench_now();
+    size_t written = 0;
+
+    /* Write the entire dump, rendering a frame after each block */
+    while (written < BENCH_TOTAL_LENGTH) {
+
+        guac_terminal_write(term, log, log_length);
+        written += log_length;
+
+        guac_terminal_lock(term);
+        guac_terminal_flush(term);
+        guac_terminal_unlock(term);
+
+    }
+
+    double elapsed = bench_now() - start;
+
+    guac_terminal_glyph_cache* cache = term->display->glyph_cache;
+    printf("%-40s %10.1f MB/s\n", "guac_terminal_write (log dump)",
+            written / elapsed / 1000000.0);
+    printf("%-40s %10" PRIu64 " hits, %" PRIu64 " misses\n", "glyph cache",
+            cache->hits, cache->misses);
+
+    guac_terminal_glyph_atlas* atlas = term->display->glyph_atlas;
+    if (atlas != NULL)
+        printf("%-40s %10" PRIu64 " hits, %" PRIu64 " misses\n",
+                "glyph atlas", atlas->hits, atlas->misses);
+
+    guac_mem_free(log);
+
+    guac_client_stop(client);
+    guac_terminal_free(term);
+    guac_client_free(client);
+
+    return 0;
+
+}
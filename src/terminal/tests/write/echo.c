@@ -0,0 +1,399 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "terminal/buffer.h"
+#include "terminal/display.h"
+#include "terminal/palette.h"
+#include "terminal/terminal.h"
+#include "terminal/terminal-priv.h"
+
+#include <CUnit/CUnit.h>
+#include <guacamole/client.h>
+#include <guacamole/mem.h>
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The width of each terminal tested, in pixels.
+ */
+#define TEST_ECHO_WIDTH 400
+
+/**
+ * The height of each terminal tested, in pixels.
+ */
+#define TEST_ECHO_HEIGHT 200
+
+/**
+ * The number of bytes of random data written by test_write__echo_random().
+ */
+#define TEST_ECHO_RANDOM_LENGTH 16384
+
+/**
+ * Text containing lines far longer than the width of the terminal, including
+ * double-width characters that will not fit within the final column, and
+ * enough lines to scroll.
+ */
+static const char* wrap_text =
+    "The quick brown fox jumps over the lazy dog. The quick brown fox jumps "
+    "over the lazy dog. The quick brown fox jumps over the lazy dog.\r\n"
+    "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\xE3\x81\xAE\xE3\x83\x86\xE3\x82"
+    "\xAD\xE3\x82\xB9\xE3\x83\x88 x\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\xE3"
+    "\x81\xAE\xE3\x83\x86\xE3\x82\xAD\xE3\x82\xB9\xE3\x83\x88 xx\xE6\x97\xA5"
+    "\xE6\x9C\xAC\xE8\xAA\x9E\xE3\x81\xAE\xE3\x83\x86\xE3\x82\xAD\xE3\x82\xB9"
+    "\xE3\x83\x88\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\r\n"
+    "e\xCC\x81 caf\xC3\xA9 na\xC3\xAFve \xF0\x9F\x98\x80 \xE2\x82\xAC 100\r\n"
+    "\x1B[1;31mbold red\x1B[0m plain \x1B[7mreverse\x1B[0m\r\n"
+    "1\r\n2\r\n3\r\n4\r\n5\r\n6\r\n7\r\n8\r\n9\r\n10\r\n11\r\n12\r\n13\r\n"
+    "\x1B[5;10Hoverwritten in the middle of the screen and beyond the edge";
+
+/**
+ * Text which writes within and beyond existing text while insert mode is
+ * enabled, and again once insert mode is disabled.
+ */
+static const char* insert_text =
+    "0123456789012345678901234567890123456789\r\n"
+    "abcdefghijklmnopqrstuvwxyz\r\n"
+    "\x1B[1;5H\x1B[4hINSERTED\x1B[4l"
+    "\x1B[2;3H\x1B[4h\xC3\xA9\xE6\x97\xA5 and a great deal more text, enough"
+    " to push the rest of the row past its end\x1B[4l overwritten";
+
+/**
+ * Text which draws using the DEC special graphics character set, selected
+ * both directly as G0 and via shifting to G1.
+ */
+static const char* charset_text =
+    "\x1B(0lqqqqqqk\r\nx abc x\r\nmqqqqqqj\x1B(B plain\r\n"
+    "\x1B)0\x0Elqk\x0F plain \x0Etqu\x0F\r\n"
+    "\x1B(0" "abcdefghijklmnopqrstuvwxyz0123456789"
+    "abcdefghijklmnopqrstuvwxyz0123456789\x1B(B";
+
+/**
+ * Text containing malformed UTF-8, overlong encodings of control characters,
+ * an encoded CSI, and DEL.
+ */
+static const char* malformed_text =
+    "stray \x80\xBF continuation\r\n"
+    "truncated \xE6\x97 sequence\r\n"
+    "overlong \xC0\x8A newline \xC1\x9B and \xC2\x9B" "1mCSI\x1B[0m\r\n"
+    "del \x7F here \xF8\x88\x80\x80\x80 invalid\r\n";
+
+/**
+ * Allocates a new terminal, along with a new guac_client for that terminal.
+ * The terminal is not started, and thus never renders frames.
+ *
+ * @return
+ *     A newly-allocated terminal, which must be freed with test_echo_free().
+ */
+static guac_terminal* test_echo_alloc(void) {
+
+    guac_client* client = guac_client_alloc();
+
+    guac_terminal_options* options = guac_terminal_options_create(
+            TEST_ECHO_WIDTH, TEST_ECHO_HEIGHT, 96);
+
+    guac_terminal* term = guac_terminal_create(client, options);
+    guac_mem_free(options);
+
+    return term;
+
+}
+
+/**
+ * Frees the given terminal and its guac_client, stopping that client such
+ * that the render thread of the terminal exits.
+ *
+ * @param term
+ *     The terminal to free.
+ */
+static void test_echo_free(guac_terminal* term) {
+
+    guac_client* client = term->client;
+
+    guac_client_stop(client);
+    guac_terminal_free(term);
+    guac_client_free(client);
+
+}
+
+/**
+ * Writes the given data to the given terminal one byte at a time, passing
+ * each byte directly to the current character handler of the terminal and
+ * thus bypassing guac_terminal_echo_run().
+ *
+ * @param term
+ *     The terminal to write to.
+ *
+ * @param data
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes to write.
+ */
+static void write_per_char(guac_terminal* term, const char* data,
+        int length) {
+
+    guac_terminal_lock(term);
+
+    for (int i = 0; i < length; i++)
+        term->char_handler(term, (unsigned char) data[i]);
+
+    guac_terminal_unlock(term);
+
+}
+
+/**
+ * Writes the given data to the given terminal using guac_terminal_write(),
+ * in blocks of the given size.
+ *
+ * @param term
+ *     The terminal to write to.
+ *
+ * @param data
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes to write.
+ *
+ * @param block_size
+ *     The maximum number of bytes to pass to each call to
+ *     guac_terminal_write().
+ */
+static void write_bulk(guac_terminal* term, const char* data, int length,
+        int block_size) {
+
+    while (length > 0) {
+
+        int block_length = length;
+        if (block_length > block_size)
+            block_length = block_size;
+
+        guac_terminal_write(term, data, block_length);
+
+        data += block_length;
+        length -= block_length;
+
+    }
+
+}
+
+/**
+ * Returns whether the given characters are identical.
+ *
+ * @param a
+ *     The first character to compare.
+ *
+ * @param b
+ *     The second character to compare.
+ *
+ * @return
+ *     true if the given characters are identical, false otherwise.
+ */
+static bool same_char(const guac_terminal_char* a, const guac_terminal_char* b) {
+
+    const guac_terminal_attributes* x = &a->attributes;
+    const guac_terminal_attributes* y = &b->attributes;
+
+    return a->value == b->value
+        && a->width == b->width
+        && x->bold == y->bold
+        && x->half_bright == y->half_bright
+        && x->cursor == y->cursor
+        && x->reverse == y->reverse
+        && x->underscore == y->underscore
+        && guac_terminal_colorcmp(&x->foreground, &y->foreground) == 0
+        && guac_terminal_colorcmp(&x->background, &y->background) == 0;
+
+}
+
+/**
+ * Verifies that the two given terminals are in identical states, including
+ * the cursor, the contents of every row of the current buffer (including
+ * scrollback), and every operation pending for the display.
+ *
+ * @param expected
+ *     The terminal whose data was written one byte at a time.
+ *
+ * @param actual
+ *     The terminal whose data was written using guac_terminal_write().
+ */
+static void verify_same(guac_terminal* expected, guac_terminal* actual) {
+
+    CU_ASSERT_EQUAL_FATAL(actual->term_width, expected->term_width);
+    CU_ASSERT_EQUAL_FATAL(actual->term_height, expected->term_height);
+    CU_ASSERT_EQUAL(actual->cursor_row, expected->cursor_row);
+    CU_ASSERT_EQUAL(actual->cursor_col, expected->cursor_col);
+    CU_ASSERT_EQUAL(actual->active_char_set, expected->active_char_set);
+    CU_ASSERT_EQUAL(actual->utf8_bytes_remaining, expected->utf8_bytes_remaining);
+
+    int scroll = guac_terminal_get_available_scroll(expected);
+    CU_ASSERT_EQUAL_FATAL(guac_terminal_get_available_scroll(actual), scroll);
+
+    /* Compare all rows, including scrollback */
+    for (int row = -scroll; row < expected->term_height; row++) {
+
+        guac_terminal_char* expected_chars;
+        guac_terminal_char* actual_chars;
+        bool expected_wrapped;
+        bool actual_wrapped;
+
+        int length = guac_terminal_buffer_get_columns(expected->current_buffer,
+                &expected_chars, &expected_wrapped, row);
+        CU_ASSERT_EQUAL_FATAL(guac_terminal_buffer_get_columns(
+                    actual->current_buffer, &actual_chars, &actual_wrapped,
+                    row), length);
+        CU_ASSERT_EQUAL(actual_wrapped, expected_wrapped);
+
+        for (int column = 0; column < length; column++)
+            CU_ASSERT_TRUE(same_char(&actual_chars[column],
+                        &expected_chars[column]));
+
+    }
+
+    /* Compare everything that will be drawn when the next frame is flushed */
+    guac_terminal_display* expected_display = expected->display;
+    guac_terminal_display* actual_display = actual->display;
+
+    CU_ASSERT_EQUAL_FATAL(actual_display->width, expected_display->width);
+    CU_ASSERT_EQUAL_FATAL(actual_display->height, expected_display->height);
+
+    int count = expected_display->width * expected_display->height;
+    for (int i = 0; i < count; i++) {
+
+        guac_terminal_operation* a = &expected_display->operations[i];
+        guac_terminal_operation* b = &actual_display->operations[i];
+
+        CU_ASSERT_EQUAL(b->type, a->type);
+
+        if (a->type == GUAC_CHAR_SET) {
+            CU_ASSERT_TRUE(same_char(&b->character, &a->character));
+        }
+
+        else if (a->type == GUAC_CHAR_COPY) {
+            CU_ASSERT_EQUAL(b->row, a->row);
+            CU_ASSERT_EQUAL(b->column, a->column);
+        }
+
+    }
+
+}
+
+/**
+ * Writes the given data to a terminal one byte at a time and to other
+ * terminals using guac_terminal_write() in blocks of various sizes,
+ * verifying that all terminals end up in identical states.
+ *
+ * @param data
+ *     The data to write.
+ *
+ * @param length
+ *     The number of bytes to write.
+ */
+static void verify_echo(const char* data, int length) {
+
+    static const int block_sizes[] = { 1, 2, 3, 7, 64, INT_MAX };
+
+    guac_terminal* expected = test_echo_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(expected);
+    write_per_char(expected, data, length);
+
+    int count = sizeof(block_sizes) / sizeof(block_sizes[0]);
+    for (int i = 0; i < count; i++) {
+
+        guac_terminal* actual = test_echo_alloc();
+        CU_ASSERT_PTR_NOT_NULL_FATAL(actual);
+        write_bulk(actual, data, length, block_sizes[i]);
+
+        guac_terminal_lock(expected);
+        verify_same(expected, actual);
+        guac_terminal_unlock(expected);
+
+        test_echo_free(actual);
+
+    }
+
+    test_echo_free(expected);
+
+}
+
+/**
+ * Verifies that text which wraps, scrolls, and contains multi-column and
+ * combining characters is rendered identically whether written in bulk or
+ * one byte at a time.
+ */
+void test_write__echo_wrap(void) {
+    verify_echo(wrap_text, strlen(wrap_text));
+}
+
+/**
+ * Verifies that text written in insert mode is rendered identically whether
+ * written in bulk or one byte at a time.
+ */
+void test_write__echo_insert(void) {
+    verify_echo(insert_text, strlen(insert_text));
+}
+
+/**
+ * Verifies that text written using an alternative character set is rendered
+ * identically whether written in bulk or one byte at a time.
+ */
+void test_write__echo_charset(void) {
+    verify_echo(charset_text, strlen(charset_text));
+}
+
+/**
+ * Verifies that malformed UTF-8 and encoded control characters are handled
+ * identically whether written in bulk or one byte at a time.
+ */
+void test_write__echo_malformed(void) {
+    verify_echo(malformed_text, strlen(malformed_text));
+}
+
+/**
+ * Verifies that arbitrary data, mostly printable but including control
+ * characters and UTF-8 of all lengths, is handled identically whether written
+ * in bulk or one byte at a time. Escape sequences are excluded, as some
+ * request responses or downloads unrelated to rendering.
+ */
+void test_write__echo_random(void) {
+
+    char* data = guac_mem_alloc(TEST_ECHO_RANDOM_LENGTH);
+    srand(0x23);
+
+    for (int i = 0; i < TEST_ECHO_RANDOM_LENGTH; i++) {
+
+        int value = rand() % 256;
+
+        /* Favor printable ASCII, as is typical of terminal output */
+        if (rand() % 4 != 0)
+            value = 0x20 + rand() % 0x5F;
+
+        if (value == 0x1B)
+            value = '[';
+
+        data[i] = (char) value;
+
+    }
+
+    verify_echo(data, TEST_ECHO_RANDOM_LENGTH);
+    guac_mem_free(data);
+
+}
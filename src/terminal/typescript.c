@@ -27,6 +27,7 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <sys/types.h>
@@ -106,6 +107,28 @@ void guac_terminal_typescript_write(guac_terminal_typescript* typescript,
 
 }
 
+void guac_terminal_typescript_write_buffer(guac_terminal_typescript* typescript,
+        const char* buffer, int length) {
+
+    while (length > 0) {
+
+        /* Flush buffer if no space is available */
+        if (typescript->length == sizeof(typescript->buffer))
+            guac_terminal_typescript_flush(typescript);
+
+        /* Append as much data as will fit */
+        int available = sizeof(typescript->buffer) - typescript->length;
+        int chunk = length < available ? length : available;
+        memcpy(typescript->buffer + typescript->length, buffer, chunk);
+
+        typescript->length += chunk;
+        buffer += chunk;
+        length -= chunk;
+
+    }
+
+}
+
 void guac_terminal_typescript_flush(guac_terminal_typescript* typescript) {
 
     /* Do nothing if nothing to flush */